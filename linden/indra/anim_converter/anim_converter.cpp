@@ -0,0 +1,197 @@
+/** 
+ * @file anim_converter.cpp
+ * @brief Command line BVH to .anim batch converter.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "apr_mmap.h"
+
+#include "llapr.h"
+#include "llbvhloader.h"
+#include "lldatapacker.h"
+#include "lldir.h"
+#include "llerrorcontrol.h"
+#include "llthreadpool.h"
+#include "lltimer.h"
+
+// Batch converts BVH motion capture files to the .anim format the viewer
+// uploads.  Uses the same translation table (app_settings/anim.ini) and
+// keyframe reduction as the upload preview.
+//
+// usage: anim-converter [-j threads] [-o output_dir] file.bvh ...
+
+static const S32 DEFAULT_THREADS = 4;
+static const S32 MAX_THREADS = 16;
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "usage: %s [-j threads] [-o output_dir] file.bvh ...\n", name);
+	fprintf(stderr, "  -j threads     worker threads for keyframe reduction (default %d, 0 = none)\n", DEFAULT_THREADS);
+	fprintf(stderr, "  -o output_dir  where to write the .anim files (default: next to each input)\n");
+}
+
+// Converts one file.  The BVH text is parsed straight out of a read only
+// memory map.  Returns the number of bytes written, or -1 on failure.
+static S32 convert_file(const std::string& in_path, const std::string& out_path, LLThreadPool* thread_pool)
+{
+	S32 file_size = 0;
+	LLAPRFile infile;
+	infile.open(in_path, LL_APR_RB, LLAPRFile::global, &file_size);
+	apr_file_t* fp = infile.getFileHandle();
+	if (!fp)
+	{
+		llwarns << "Can't open BVH file: " << in_path << llendl;
+		return -1;
+	}
+	if (file_size <= 0)
+	{
+		llwarns << "Empty BVH file: " << in_path << llendl;
+		return -1;
+	}
+
+	apr_mmap_t* map = NULL;
+	apr_status_t status = apr_mmap_create(&map, fp, 0, (apr_size_t)file_size, APR_MMAP_READ, gAPRPoolp);
+	if (status != APR_SUCCESS || !map)
+	{
+		ll_apr_warn_status(status);
+		llwarns << "Can't map BVH file: " << in_path << llendl;
+		return -1;
+	}
+
+	LLBVHLoader loader((const char*)map->mm, file_size, thread_pool);
+	apr_mmap_delete(map);
+	infile.close();
+
+	if (!loader.isInitialized())
+	{
+		llwarns << in_path << ": " << loader.getStatus() << llendl;
+		return -1;
+	}
+
+	S32 out_size = (S32)loader.getOutputSize();
+	std::vector<U8> out_buffer(out_size);
+	LLDataPackerBinaryBuffer dp(&out_buffer[0], out_size);
+	if (!loader.serialize(dp))
+	{
+		llwarns << "Can't serialize motion: " << in_path << llendl;
+		return -1;
+	}
+
+	LLAPRFile outfile;
+	outfile.open(out_path, LL_APR_WB, LLAPRFile::global);
+	if (!outfile.getFileHandle() || outfile.write(&out_buffer[0], out_size) != out_size)
+	{
+		llwarns << "Can't write animation file: " << out_path << llendl;
+		return -1;
+	}
+	return out_size;
+}
+
+int main(int argc, char **argv)
+{
+	ll_init_apr();
+	LLError::initForApplication(gDirUtilp->getExpandedFilename(LL_PATH_APP_SETTINGS, ""));
+
+	S32 num_threads = DEFAULT_THREADS;
+	std::string out_dir;
+	std::vector<std::string> in_paths;
+	for (S32 i = 1; i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		if (arg == "-j" && i + 1 < argc)
+		{
+			num_threads = llclamp(atoi(argv[++i]), 0, MAX_THREADS);
+		}
+		else if (arg == "-o" && i + 1 < argc)
+		{
+			out_dir = argv[++i];
+		}
+		else if (arg.empty() || arg[0] == '-')
+		{
+			usage(argv[0]);
+			ll_cleanup_apr();
+			return 1;
+		}
+		else
+		{
+			in_paths.push_back(arg);
+		}
+	}
+
+	if (in_paths.empty())
+	{
+		usage(argv[0]);
+		ll_cleanup_apr();
+		return 1;
+	}
+
+	LLThreadPool* thread_pool = new LLThreadPool("BVH Reduce", num_threads);
+
+	S32 converted = 0;
+	S64 in_bytes = 0;
+	S64 out_bytes = 0;
+	LLTimer timer;
+	for (U32 i = 0; i < in_paths.size(); i++)
+	{
+		const std::string& in_path = in_paths[i];
+		std::string out_path;
+		if (out_dir.empty())
+		{
+			std::string::size_type dot = in_path.find_last_of('.');
+			std::string::size_type slash = in_path.find_last_of("/\\");
+			bool has_exten = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+			out_path = (has_exten ? in_path.substr(0, dot) : in_path) + ".anim";
+		}
+		else
+		{
+			out_path = out_dir + gDirUtilp->getDirDelimiter() + gDirUtilp->getBaseFileName(in_path, true) + ".anim";
+		}
+
+		S32 out_size = convert_file(in_path, out_path, thread_pool);
+		if (out_size >= 0)
+		{
+			converted++;
+			in_bytes += LLAPRFile::size(in_path);
+			out_bytes += out_size;
+			llinfos << in_path << " -> " << out_path << " (" << out_size << " bytes)" << llendl;
+		}
+	}
+	F32 seconds = timer.getElapsedTimeF32();
+
+	delete thread_pool;
+
+	llinfos << "Converted " << converted << " of " << in_paths.size() << " files, "
+			<< (in_bytes / 1024) << " KB in, " << (out_bytes / 1024) << " KB out, "
+			<< seconds << " s (" << (seconds > 0.f ? (F32)in_bytes / (1024.f * 1024.f) / seconds : 0.f) << " MB/s)" << llendl;
+
+	ll_cleanup_apr();
+	return converted == (S32)in_paths.size() ? 0 : 1;
+}
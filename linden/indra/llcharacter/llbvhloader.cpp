@@ -34,14 +34,13 @@
 
 #include "llbvhloader.h"
 
-#include <boost/tokenizer.hpp>
-
 #include "lldatapacker.h"
 #include "lldir.h"
 #include "llkeyframemotion.h"
 #include "llquantize.h"
 #include "llstl.h"
 #include "llapr.h"
+#include "llthreadpool.h"
 
 
 using namespace std;
@@ -92,17 +91,6 @@ const char *LLBVHLoader::ST_NO_XLT_EASEOUT	= "Can't get easeOut values.";
 const char *LLBVHLoader::ST_NO_XLT_HAND		= "Can't get hand morph value.";
 const char *LLBVHLoader::ST_NO_XLT_EMOTE		= "Can't read emote name.";
 
-//------------------------------------------------------------------------
-// find_next_whitespace()
-//------------------------------------------------------------------------
-const char *find_next_whitespace(const char *p)
-{
-	while(*p && isspace(*p)) p++;
-	while(*p && !isspace(*p)) p++;
-	return p;
-}
-
-
 //------------------------------------------------------------------------
 // bvhStringToOrder()
 //
@@ -121,10 +109,203 @@ LLQuaternion::Order bvhStringToOrder( char *str )
 	return retVal;
 }
 
+//------------------------------------------------------------------------
+// LLBVHTokenizer
+//
+// Walks a BVH buffer in place, one line at a time.  The buffer does not
+// need to be NUL terminated, so files can be parsed straight out of a
+// memory map.  Empty lines are skipped.
+//------------------------------------------------------------------------
+class LLBVHTokenizer
+{
+public:
+	LLBVHTokenizer(const char* buffer, S32 buffer_size)
+		: mCursor(buffer),
+		  mEnd(buffer + buffer_size),
+		  mLine(buffer),
+		  mLineEnd(buffer),
+		  mLineNumber(0)
+	{
+	}
+
+	// Advances to the next non empty line.  Returns FALSE at the end of the buffer.
+	BOOL nextLine()
+	{
+		while (mCursor < mEnd && (*mCursor == '\r' || *mCursor == '\n'))
+		{
+			if (*mCursor == '\n')
+			{
+				mLineNumber++;
+			}
+			mCursor++;
+		}
+		if (mCursor >= mEnd || *mCursor == '\0')
+		{
+			mLine = mLineEnd = mCursor = mEnd;
+			return FALSE;
+		}
+		mLine = mCursor;
+		while (mCursor < mEnd && *mCursor != '\r' && *mCursor != '\n' && *mCursor != '\0')
+		{
+			mCursor++;
+		}
+		mLineEnd = mCursor;
+		return TRUE;
+	}
+
+	// Returns the first occurrence of token in the current line, or NULL.
+	const char* find(const char* token, const char* from = NULL) const
+	{
+		const S32 len = (S32)strlen(token);		/* Flawfinder: ignore */
+		for (const char* p = from ? from : mLine; p + len <= mLineEnd; p++)
+		{
+			if (*p == *token && !strncmp(p, token, len))
+			{
+				return p;
+			}
+		}
+		return NULL;
+	}
+
+	BOOL contains(const char* token) const { return find(token) != NULL; }
+
+	// Returns the next whitespace separated word in the current line
+	// starting at p and moves p past it.
+	BOOL nextWord(const char*& p, const char*& word, S32& len) const
+	{
+		while (p < mLineEnd && isspace((unsigned char)*p)) p++;
+		word = p;
+		while (p < mLineEnd && !isspace((unsigned char)*p)) p++;
+		len = (S32)(p - word);
+		return len > 0;
+	}
+
+	// Parses a decimal number at p and moves p past it.  The fixed point
+	// values exporters write are converted inline; anything else (exponents,
+	// long mantissas) goes through strtod().
+	BOOL nextFloat(const char*& p, F32& value) const
+	{
+		while (p < mLineEnd && isspace((unsigned char)*p)) p++;
+		const char* start = p;
+
+		BOOL negative = FALSE;
+		if (p < mLineEnd && (*p == '-' || *p == '+'))
+		{
+			negative = (*p == '-');
+			p++;
+		}
+
+		U64 mantissa = 0;
+		S32 digits = 0;
+		S32 decimals = 0;
+		BOOL fraction = FALSE;
+		for (; p < mLineEnd; p++)
+		{
+			if (*p >= '0' && *p <= '9')
+			{
+				mantissa = mantissa * 10 + (U64)(*p - '0');
+				digits++;
+				if (fraction)
+				{
+					decimals++;
+				}
+			}
+			else if (*p == '.' && !fraction)
+			{
+				fraction = TRUE;
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		if (!digits)
+		{
+			p = start;
+			return FALSE;
+		}
+
+		if (digits <= 15 && (p >= mLineEnd || (*p != 'e' && *p != 'E')))
+		{
+			// both operands are exact, so the quotient is correctly rounded
+			static const F64 powers_of_ten[16] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+												   1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+			F64 result = (F64)mantissa / powers_of_ten[decimals];
+			value = (F32)(negative ? -result : result);
+			return TRUE;
+		}
+
+		while (p < mLineEnd && !isspace((unsigned char)*p)) p++;
+		char number[64];		/* Flawfinder: ignore */
+		S32 len = llmin((S32)(p - start), (S32)sizeof(number) - 1);
+		memcpy(number, start, len);		/* Flawfinder: ignore */
+		number[len] = '\0';
+		char* number_end = NULL;
+		value = (F32)strtod(number, &number_end);
+		return number_end != number;
+	}
+
+	// Parses a whole number at p and moves p past it.
+	BOOL nextInt(const char*& p, S32& value) const
+	{
+		while (p < mLineEnd && isspace((unsigned char)*p)) p++;
+		BOOL negative = (p < mLineEnd && *p == '-');
+		if (negative)
+		{
+			p++;
+		}
+		const char* start = p;
+		S32 result = 0;
+		for (; p < mLineEnd && *p >= '0' && *p <= '9'; p++)
+		{
+			result = result * 10 + (*p - '0');
+		}
+		value = negative ? -result : result;
+		return p != start;
+	}
+
+	// Copies the current line into an error message buffer.
+	void copyLine(char* dest, S32 dest_size) const
+	{
+		S32 len = llmin((S32)(mLineEnd - mLine), dest_size - 1);
+		memcpy(dest, mLine, len);		/* Flawfinder: ignore */
+		dest[len] = '\0';
+	}
+
+	const char* getLine() const			{ return mLine; }
+	S32 getLineNumber() const			{ return mLineNumber + 1; }
+
+private:
+	const char*	mCursor;
+	const char*	mEnd;
+	const char*	mLine;
+	const char*	mLineEnd;
+	S32			mLineNumber;
+};
+
+//------------------------------------------------------------------------
+// LLBVHOptimizeJob
+//
+// Runs the keyframe reduction of one joint on a thread pool worker.
+//------------------------------------------------------------------------
+class LLBVHOptimizeJob : public LLThreadPool::Job
+{
+public:
+	LLBVHOptimizeJob(Joint *joint) : mJoint(joint) {}
+
+	// WORKER thread
+	/*virtual*/ void run() { LLBVHLoader::optimizeJoint(mJoint); }
+
+private:
+	Joint*	mJoint;
+};
+
 //-----------------------------------------------------------------------------
 // LLBVHLoader()
 //-----------------------------------------------------------------------------
-LLBVHLoader::LLBVHLoader(const char* buffer)
+LLBVHLoader::LLBVHLoader(const char* buffer, S32 buffer_size, LLThreadPool* thread_pool)
+	: mThreadPool(thread_pool)
 {
 	reset();
 
@@ -146,7 +327,7 @@ LLBVHLoader::LLBVHLoader(const char* buffer)
 
 	char error_text[128];		/* Flawfinder: ignore */
 	S32 error_line;
-	mStatus = loadBVHFile(buffer, error_text, error_line);
+	mStatus = loadBVHFile(buffer, buffer_size, error_text, error_line);
 	if (mStatus != LLBVHLoader::ST_OK)
 	{
 		llwarns << "ERROR: [line: " << getLineNumber() << "] " << mStatus << llendl;
@@ -628,19 +809,13 @@ LLBVHLoader::Status LLBVHLoader::loadTranslationTable(const char *fileName)
 //------------------------------------------------------------------------
 // LLBVHLoader::loadBVHFile()
 //------------------------------------------------------------------------
-LLBVHLoader::Status LLBVHLoader::loadBVHFile(const char *buffer, char* error_text, S32 &err_line)
+LLBVHLoader::Status LLBVHLoader::loadBVHFile(const char *buffer, S32 buffer_size, char* error_text, S32 &err_line)
 {
-	std::string line;
+	LLBVHTokenizer tokens(buffer, buffer_size);
 
 	err_line = 0;
 	error_text[127] = '\0';
 
-	std::string str(buffer);
-	typedef boost::tokenizer<boost::char_separator<char> > tokenizer;
-	boost::char_separator<char> sep("\r\n");
-	tokenizer tokens(str, sep);
-	tokenizer::iterator iter = tokens.begin();
-
 	mLineNumber = 0;
 	mJoints.clear();
 
@@ -649,14 +824,12 @@ LLBVHLoader::Status LLBVHLoader::loadBVHFile(const char *buffer, char* error_tex
 	//--------------------------------------------------------------------
 	// consume  hierarchy
 	//--------------------------------------------------------------------
-	if (iter == tokens.end())
+	if (!tokens.nextLine())
 		return ST_EOF;
-	line = (*(iter++));
-	err_line++;
+	err_line = mLineNumber = tokens.getLineNumber();
 
-	if ( !strstr(line.c_str(), "HIERARCHY") )
+	if ( !tokens.contains("HIERARCHY") )
 	{
-//		llinfos << line << llendl;
 		return ST_NO_HIER;
 	}
 
@@ -668,15 +841,14 @@ LLBVHLoader::Status LLBVHLoader::loadBVHFile(const char *buffer, char* error_tex
 		//----------------------------------------------------------------
 		// get next line
 		//----------------------------------------------------------------
-		if (iter == tokens.end())
+		if (!tokens.nextLine())
 			return ST_EOF;
-		line = (*(iter++));
-		err_line++;
+		err_line = mLineNumber = tokens.getLineNumber();
 
 		//----------------------------------------------------------------
 		// consume }
 		//----------------------------------------------------------------
-		if ( strstr(line.c_str(), "}") )
+		if ( tokens.contains("}") )
 		{
 			if (parent_joints.size() > 0)
 			{
@@ -688,22 +860,22 @@ LLBVHLoader::Status LLBVHLoader::loadBVHFile(const char *buffer, char* error_tex
 		//----------------------------------------------------------------
 		// if MOTION, break out
 		//----------------------------------------------------------------
-		if ( strstr(line.c_str(), "MOTION") )
+		if ( tokens.contains("MOTION") )
 			break;
 
 		//----------------------------------------------------------------
 		// it must be either ROOT or JOINT or EndSite
 		//----------------------------------------------------------------
-		if ( strstr(line.c_str(), "ROOT") )
+		if ( tokens.contains("ROOT") )
 		{
 		}
-		else if ( strstr(line.c_str(), "JOINT") )
+		else if ( tokens.contains("JOINT") )
 		{
 		}
-		else if ( strstr(line.c_str(), "End Site") )
+		else if ( tokens.contains("End Site") )
 		{
-			iter++; // {
-			iter++; //     OFFSET
+			tokens.nextLine(); // {
+			tokens.nextLine(); //     OFFSET
 			S32 depth = 0;
 			for (S32 j = (S32)parent_joints.size() - 1; j >= 0; j--)
 			{
@@ -718,24 +890,27 @@ LLBVHLoader::Status LLBVHLoader::loadBVHFile(const char *buffer, char* error_tex
 		}
 		else
 		{
-			strncpy(error_text, line.c_str(), 127);	/* Flawfinder: ignore */
+			tokens.copyLine(error_text, 128);
 			return ST_NO_JOINT;
 		}
 
 		//----------------------------------------------------------------
 		// get the joint name
 		//----------------------------------------------------------------
-		char jointName[80];	/* Flawfinder: ignore */
-		if ( sscanf(line.c_str(), "%*s %79s", jointName) != 1 )	/* Flawfinder: ignore */
+		const char* p = tokens.getLine();
+		const char* word;
+		S32 word_len;
+		if ( !tokens.nextWord(p, word, word_len) || !tokens.nextWord(p, word, word_len) )
 		{
-			strncpy(error_text, line.c_str(), 127);	/* Flawfinder: ignore */
+			tokens.copyLine(error_text, 128);
 			return ST_NO_NAME;
 		}
+		std::string jointName(word, llmin(word_len, 79));
 
 		//----------------------------------------------------------------
 		// add a set of keyframes for this joint
 		//----------------------------------------------------------------
-		mJoints.push_back( new Joint( jointName ) );
+		mJoints.push_back( new Joint( jointName.c_str() ) );
 		Joint *joint = mJoints.back();
 
 		S32 depth = 1;
@@ -752,19 +927,18 @@ LLBVHLoader::Status LLBVHLoader::loadBVHFile(const char *buffer, char* error_tex
 		//----------------------------------------------------------------
 		// get next line
 		//----------------------------------------------------------------
-		if (iter == tokens.end())
+		if (!tokens.nextLine())
 		{
 			return ST_EOF;
 		}
-		line = (*(iter++));
-		err_line++;
+		err_line = mLineNumber = tokens.getLineNumber();
 
 		//----------------------------------------------------------------
 		// it must be {
 		//----------------------------------------------------------------
-		if ( !strstr(line.c_str(), "{") )
+		if ( !tokens.contains("{") )
 		{
-			strncpy(error_text, line.c_str(), 127);		/*Flawfinder: ignore*/
+			tokens.copyLine(error_text, 128);
 			return ST_NO_OFFSET;
 		}
 		else
@@ -775,58 +949,56 @@ LLBVHLoader::Status LLBVHLoader::loadBVHFile(const char *buffer, char* error_tex
 		//----------------------------------------------------------------
 		// get next line
 		//----------------------------------------------------------------
-		if (iter == tokens.end())
+		if (!tokens.nextLine())
 		{
 			return ST_EOF;
 		}
-		line = (*(iter++));
-		err_line++;
+		err_line = mLineNumber = tokens.getLineNumber();
 
 		//----------------------------------------------------------------
 		// it must be OFFSET
 		//----------------------------------------------------------------
-		if ( !strstr(line.c_str(), "OFFSET") )
+		if ( !tokens.contains("OFFSET") )
 		{
-			strncpy(error_text, line.c_str(), 127);		/*Flawfinder: ignore*/
+			tokens.copyLine(error_text, 128);
 			return ST_NO_OFFSET;
 		}
 
 		//----------------------------------------------------------------
 		// get next line
 		//----------------------------------------------------------------
-		if (iter == tokens.end())
+		if (!tokens.nextLine())
 		{
 			return ST_EOF;
 		}
-		line = (*(iter++));
-		err_line++;
+		err_line = mLineNumber = tokens.getLineNumber();
 
 		//----------------------------------------------------------------
 		// it must be CHANNELS
 		//----------------------------------------------------------------
-		if ( !strstr(line.c_str(), "CHANNELS") )
+		if ( !tokens.contains("CHANNELS") )
 		{
-			strncpy(error_text, line.c_str(), 127);		/*Flawfinder: ignore*/
+			tokens.copyLine(error_text, 128);
 			return ST_NO_CHANNELS;
 		}
 
 		//----------------------------------------------------------------
 		// get rotation order
 		//----------------------------------------------------------------
-		const char *p = line.c_str();
+		p = tokens.getLine();
 		for (S32 i=0; i<3; i++)
 		{
-			p = strstr(p, "rotation");
+			p = tokens.find("rotation", p);
 			if (!p)
 			{
-				strncpy(error_text, line.c_str(), 127);		/*Flawfinder: ignore*/
+				tokens.copyLine(error_text, 128);
 				return ST_NO_ROTATION;
 			}
 
-			const char axis = *(p - 1);
+			const char axis = (p > tokens.getLine()) ? *(p - 1) : 0;
 			if ((axis != 'X') && (axis != 'Y') && (axis != 'Z'))
 			{
-				strncpy(error_text, line.c_str(), 127);		/*Flawfinder: ignore*/
+				tokens.copyLine(error_text, 128);
 				return ST_NO_AXIS;
 			}
 
@@ -839,53 +1011,55 @@ LLBVHLoader::Status LLBVHLoader::loadBVHFile(const char *buffer, char* error_tex
 	//--------------------------------------------------------------------
 	// consume motion
 	//--------------------------------------------------------------------
-	if ( !strstr(line.c_str(), "MOTION") )
+	if ( !tokens.contains("MOTION") )
 	{
-		strncpy(error_text, line.c_str(), 127);		/*Flawfinder: ignore*/
+		tokens.copyLine(error_text, 128);
 		return ST_NO_MOTION;
 	}
 
 	//--------------------------------------------------------------------
 	// get number of frames
 	//--------------------------------------------------------------------
-	if (iter == tokens.end())
+	if (!tokens.nextLine())
 	{
 		return ST_EOF;
 	}
-	line = (*(iter++));
-	err_line++;
+	err_line = mLineNumber = tokens.getLineNumber();
 
-	if ( !strstr(line.c_str(), "Frames:") )
+	const char* p = tokens.find("Frames:");
+	if ( !p )
 	{
-		strncpy(error_text, line.c_str(), 127);	/*Flawfinder: ignore*/
+		tokens.copyLine(error_text, 128);
 		return ST_NO_FRAMES;
 	}
 
-	if ( sscanf(line.c_str(), "Frames: %d", &mNumFrames) != 1 )
+	p += 7; // strlen("Frames:")
+	if ( !tokens.nextInt(p, mNumFrames) || mNumFrames < 0 )
 	{
-		strncpy(error_text, line.c_str(), 127);		/*Flawfinder: ignore*/
+		tokens.copyLine(error_text, 128);
 		return ST_NO_FRAMES;
 	}
 
 	//--------------------------------------------------------------------
 	// get frame time
 	//--------------------------------------------------------------------
-	if (iter == tokens.end())
+	if (!tokens.nextLine())
 	{
 		return ST_EOF;
 	}
-	line = (*(iter++));
-	err_line++;
+	err_line = mLineNumber = tokens.getLineNumber();
 
-	if ( !strstr(line.c_str(), "Frame Time:") )
+	p = tokens.find("Frame Time:");
+	if ( !p )
 	{
-		strncpy(error_text, line.c_str(), 127);		/*Flawfinder: ignore*/
+		tokens.copyLine(error_text, 128);
 		return ST_NO_FRAME_TIME;
 	}
 
-	if ( sscanf(line.c_str(), "Frame Time: %f", &mFrameTime) != 1 )
+	p += 11; // strlen("Frame Time:")
+	if ( !tokens.nextFloat(p, mFrameTime) )
 	{
-		strncpy(error_text, line.c_str(), 127);		/*Flawfinder: ignore*/
+		tokens.copyLine(error_text, 128);
 		return ST_NO_FRAME_TIME;
 	}
 
@@ -898,18 +1072,23 @@ LLBVHLoader::Status LLBVHLoader::loadBVHFile(const char *buffer, char* error_tex
 	//--------------------------------------------------------------------
 	// load frames
 	//--------------------------------------------------------------------
+	for (U32 j=0; j<mJoints.size(); j++)
+	{
+		mJoints[j]->mKeys.reserve(mNumFrames);
+	}
+
 	for (S32 i=0; i<mNumFrames; i++)
 	{
 		// get next line
-		if (iter == tokens.end())
+		if (!tokens.nextLine())
 		{
 			return ST_EOF;
 		}
-		line = (*(iter++));
-		err_line++;
+		err_line = mLineNumber = tokens.getLineNumber();
 
-		// read and store values
-		const char *p = line.c_str();
+		// read and store values: the root joint has 3 position and 3
+		// rotation channels, every other joint 3 rotation channels
+		p = tokens.getLine();
 		for (U32 j=0; j<mJoints.size(); j++)
 		{
 			Joint *joint = mJoints[j];
@@ -919,43 +1098,25 @@ LLBVHLoader::Status LLBVHLoader::loadBVHFile(const char *buffer, char* error_tex
 			// get 3 pos values for root joint only
 			if (j==0)
 			{
-				if ( sscanf(p, "%f %f %f", key.mPos, key.mPos+1, key.mPos+2) != 3 )
+				if ( !tokens.nextFloat(p, key.mPos[0]) ||
+					 !tokens.nextFloat(p, key.mPos[1]) ||
+					 !tokens.nextFloat(p, key.mPos[2]) )
 				{
-					strncpy(error_text, line.c_str(), 127);	/*Flawfinder: ignore*/
+					tokens.copyLine(error_text, 128);
 					return ST_NO_POS;
 				}
 			}
 
-			// skip to next 3 values in the line
-			p = find_next_whitespace(p);
-			if (!p) 
-			{
-				strncpy(error_text, line.c_str(), 127);		/*Flawfinder: ignore*/
-				return ST_NO_ROT;
-			}
-			p = find_next_whitespace(++p);
-			if (!p) 
-			{
-				strncpy(error_text, line.c_str(), 127);		/*Flawfinder: ignore*/
-				return ST_NO_ROT;
-			}
-			p = find_next_whitespace(++p);
-			if (!p)
-			{
-				strncpy(error_text, line.c_str(), 127);		/*Flawfinder: ignore*/
-				return ST_NO_ROT;
-			}
-
 			// get 3 rot values for joint
 			F32 rot[3];
-			if ( sscanf(p, " %f %f %f", rot, rot+1, rot+2) != 3 )
+			if ( !tokens.nextFloat(p, rot[0]) ||
+				 !tokens.nextFloat(p, rot[1]) ||
+				 !tokens.nextFloat(p, rot[2]) )
 			{
-				strncpy(error_text, line.c_str(), 127);		/*Flawfinder: ignore*/
+				tokens.copyLine(error_text, 128);
 				return ST_NO_ROT;
 			}
 
-			p++;
-
 			key.mRot[ joint->mOrder[0]-'X' ] = rot[0];
 			key.mRot[ joint->mOrder[1]-'X' ] = rot[1];
 			key.mRot[ joint->mOrder[2]-'X' ] = rot[2];
@@ -1088,179 +1249,207 @@ void LLBVHLoader::optimize()
 		mEaseOut *= factor;
 	}
 
-	JointVector::iterator ji;
-	for (ji = mJoints.begin(); ji != mJoints.end(); ++ji)
+	if (mThreadPool && mJoints.size() > 1)
 	{
-		Joint *joint = *ji;
-		BOOL pos_changed = FALSE;
-		BOOL rot_changed = FALSE;
+		// joints are reduced independently of each other
+		std::vector<LLBVHOptimizeJob> jobs;
+		jobs.reserve(mJoints.size());
+		for (JointVector::iterator ji = mJoints.begin(); ji != mJoints.end(); ++ji)
+		{
+			jobs.push_back(LLBVHOptimizeJob(*ji));
+		}
+		for (U32 i = 0; i < jobs.size(); i++)
+		{
+			mThreadPool->addJob(&jobs[i]);
+		}
+		mThreadPool->waitForJobs();
+	}
+	else
+	{
+		for (JointVector::iterator ji = mJoints.begin(); ji != mJoints.end(); ++ji)
+		{
+			optimizeJoint(*ji);
+		}
+	}
+}
 
-		if ( ! joint->mIgnore )
+//------------------------------------------------------------------------
+// LLBVHLoader::optimizeJoint()
+//
+// Flags the keys of one joint that can be rebuilt by interpolating their
+// neighbours.  Only touches that joint, so it is safe to run on a worker.
+//------------------------------------------------------------------------
+// static
+void LLBVHLoader::optimizeJoint(Joint *joint)
+{
+	BOOL pos_changed = FALSE;
+	BOOL rot_changed = FALSE;
+
+	if ( ! joint->mIgnore )
+	{
+		joint->mNumPosKeys = 0;
+		joint->mNumRotKeys = 0;
+		LLQuaternion::Order order = bvhStringToOrder( joint->mOrder );
+
+		KeyVector::iterator first_key = joint->mKeys.begin();
+
+		// no keys?
+		if (first_key == joint->mKeys.end())
 		{
-			joint->mNumPosKeys = 0;
-			joint->mNumRotKeys = 0;
-			LLQuaternion::Order order = bvhStringToOrder( joint->mOrder );
+			joint->mIgnore = TRUE;
+			return;
+		}
 
-			KeyVector::iterator first_key = joint->mKeys.begin();
+		LLVector3 first_frame_pos(first_key->mPos);
+		LLQuaternion first_frame_rot = mayaQ( first_key->mRot[0], first_key->mRot[1], first_key->mRot[2], order);
 
-			// no keys?
-			if (first_key == joint->mKeys.end())
-			{
-				joint->mIgnore = TRUE;
-				continue;
-			}
+		// skip first key
+		KeyVector::iterator ki = joint->mKeys.begin();
+		if (joint->mKeys.size() == 1)
+		{
+			// *FIX: use single frame to move pelvis
+			// if only one keyframe force output for this joint
+			rot_changed = TRUE;
+		}
+		else
+		{
+			// if more than one keyframe, use first frame as reference and skip to second
+			first_key->mIgnorePos = TRUE;
+			first_key->mIgnoreRot = TRUE;
+			++ki;
+		}
 
-			LLVector3 first_frame_pos(first_key->mPos);
-			LLQuaternion first_frame_rot = mayaQ( first_key->mRot[0], first_key->mRot[1], first_key->mRot[2], order);
-	
-			// skip first key
-			KeyVector::iterator ki = joint->mKeys.begin();
-			if (joint->mKeys.size() == 1)
+		KeyVector::iterator ki_prev = ki;
+		KeyVector::iterator ki_last_good_pos = ki;
+		KeyVector::iterator ki_last_good_rot = ki;
+		S32 numPosFramesConsidered = 2;
+		S32 numRotFramesConsidered = 2;
+
+		F32 rot_threshold = ROTATION_KEYFRAME_THRESHOLD / llmax((F32)joint->mChildTreeMaxDepth * 0.33f, 1.f);
+
+		double diff_max = 0;
+		KeyVector::iterator ki_max = ki;
+		for (; ki != joint->mKeys.end(); ++ki)
+		{
+			if (ki_prev == ki_last_good_pos)
 			{
-				// *FIX: use single frame to move pelvis
-				// if only one keyframe force output for this joint
-				rot_changed = TRUE;
+				joint->mNumPosKeys++;
+				if (dist_vec(LLVector3(ki_prev->mPos), first_frame_pos) > POSITION_MOTION_THRESHOLD)
+				{
+					pos_changed = TRUE;
+				}
 			}
 			else
 			{
-				// if more than one keyframe, use first frame as reference and skip to second
-				first_key->mIgnorePos = TRUE;
-				first_key->mIgnoreRot = TRUE;
-				++ki;
-			}
-
-			KeyVector::iterator ki_prev = ki;
-			KeyVector::iterator ki_last_good_pos = ki;
-			KeyVector::iterator ki_last_good_rot = ki;
-			S32 numPosFramesConsidered = 2;
-			S32 numRotFramesConsidered = 2;
+				//check position for noticeable effect
+				LLVector3 test_pos(ki_prev->mPos);
+				LLVector3 last_good_pos(ki_last_good_pos->mPos);
+				LLVector3 current_pos(ki->mPos);
+				LLVector3 interp_pos = lerp(current_pos, last_good_pos, 1.f / (F32)numPosFramesConsidered);
 
-			F32 rot_threshold = ROTATION_KEYFRAME_THRESHOLD / llmax((F32)joint->mChildTreeMaxDepth * 0.33f, 1.f);
+				if (dist_vec(current_pos, first_frame_pos) > POSITION_MOTION_THRESHOLD)
+				{
+					pos_changed = TRUE;
+				}
 
-			double diff_max = 0;
-			KeyVector::iterator ki_max = ki;
-			for (; ki != joint->mKeys.end(); ++ki)
-			{
-				if (ki_prev == ki_last_good_pos)
+				if (dist_vec(interp_pos, test_pos) < POSITION_KEYFRAME_THRESHOLD)
 				{
-					joint->mNumPosKeys++;
-					if (dist_vec(LLVector3(ki_prev->mPos), first_frame_pos) > POSITION_MOTION_THRESHOLD)
-					{
-						pos_changed = TRUE;
-					}
+					ki_prev->mIgnorePos = TRUE;
+					numPosFramesConsidered++;
 				}
 				else
 				{
-					//check position for noticeable effect
-					LLVector3 test_pos(ki_prev->mPos);
-					LLVector3 last_good_pos(ki_last_good_pos->mPos);
-					LLVector3 current_pos(ki->mPos);
-					LLVector3 interp_pos = lerp(current_pos, last_good_pos, 1.f / (F32)numPosFramesConsidered);
+					numPosFramesConsidered = 2;
+					ki_last_good_pos = ki_prev;
+					joint->mNumPosKeys++;
+				}
+			}
 
-					if (dist_vec(current_pos, first_frame_pos) > POSITION_MOTION_THRESHOLD)
-					{
-						pos_changed = TRUE;
-					}
+			if (ki_prev == ki_last_good_rot)
+			{
+				joint->mNumRotKeys++;
+				LLQuaternion test_rot = mayaQ( ki_prev->mRot[0], ki_prev->mRot[1], ki_prev->mRot[2], order);
+				F32 x_delta = dist_vec(LLVector3::x_axis * first_frame_rot, LLVector3::x_axis * test_rot);
+				F32 y_delta = dist_vec(LLVector3::y_axis * first_frame_rot, LLVector3::y_axis * test_rot);
+				F32 rot_test = x_delta + y_delta;
 
-					if (dist_vec(interp_pos, test_pos) < POSITION_KEYFRAME_THRESHOLD)
-					{
-						ki_prev->mIgnorePos = TRUE;
-						numPosFramesConsidered++;
-					}
-					else
-					{
-						numPosFramesConsidered = 2;
-						ki_last_good_pos = ki_prev;
-						joint->mNumPosKeys++;
-					}
+				if (rot_test > ROTATION_MOTION_THRESHOLD)
+				{
+					rot_changed = TRUE;
 				}
-
-				if (ki_prev == ki_last_good_rot)
+			}
+			else
+			{
+				//check rotation for noticeable effect
+				LLQuaternion test_rot = mayaQ( ki_prev->mRot[0], ki_prev->mRot[1], ki_prev->mRot[2], order);
+				LLQuaternion last_good_rot = mayaQ( ki_last_good_rot->mRot[0], ki_last_good_rot->mRot[1], ki_last_good_rot->mRot[2], order);
+				LLQuaternion current_rot = mayaQ( ki->mRot[0], ki->mRot[1], ki->mRot[2], order);
+				LLQuaternion interp_rot = lerp(1.f / (F32)numRotFramesConsidered, current_rot, last_good_rot);
+
+				F32 x_delta;
+				F32 y_delta;
+				F32 rot_test;
+				
+				// Test if the rotation has changed significantly since the very first frame.  If false
+				// for all frames, then we'll just throw out this joint's rotation entirely.
+				x_delta = dist_vec(LLVector3::x_axis * first_frame_rot, LLVector3::x_axis * test_rot);
+				y_delta = dist_vec(LLVector3::y_axis * first_frame_rot, LLVector3::y_axis * test_rot);
+				rot_test = x_delta + y_delta;
+				if (rot_test > ROTATION_MOTION_THRESHOLD)
 				{
+					rot_changed = TRUE;
+				}
+				x_delta = dist_vec(LLVector3::x_axis * interp_rot, LLVector3::x_axis * test_rot);
+				y_delta = dist_vec(LLVector3::y_axis * interp_rot, LLVector3::y_axis * test_rot);
+				rot_test = x_delta + y_delta;
+
+				// Draw a line between the last good keyframe and current.  Test the distance between the last frame (current-1, i.e. ki_prev)
+				// and the line.  If it's greater than some threshold, then it represents a significant frame and we want to include it.
+				if (rot_test >= rot_threshold ||
+					(ki+1 == joint->mKeys.end() && numRotFramesConsidered > 2))
+				{
+					// Add the current test keyframe (which is technically the previous key, i.e. ki_prev).
+					numRotFramesConsidered = 2;
+					ki_last_good_rot = ki_prev;
 					joint->mNumRotKeys++;
-					LLQuaternion test_rot = mayaQ( ki_prev->mRot[0], ki_prev->mRot[1], ki_prev->mRot[2], order);
-					F32 x_delta = dist_vec(LLVector3::x_axis * first_frame_rot, LLVector3::x_axis * test_rot);
-					F32 y_delta = dist_vec(LLVector3::y_axis * first_frame_rot, LLVector3::y_axis * test_rot);
-					F32 rot_test = x_delta + y_delta;
 
-					if (rot_test > ROTATION_MOTION_THRESHOLD)
+					// Add another keyframe between the last good keyframe and current, at whatever point was the most "significant" (i.e.
+					// had the largest deviation from the earlier tests).  Note that a more robust approach would be test all intermediate
+					// keyframes against the line between the last good keyframe and current, but we're settling for this other method
+					// because it's significantly faster.
+					if (diff_max > 0)
 					{
-						rot_changed = TRUE;
+						if (ki_max->mIgnoreRot == TRUE)
+						{
+							ki_max->mIgnoreRot = FALSE;
+							joint->mNumRotKeys++;
+						}
+						diff_max = 0;
 					}
 				}
 				else
 				{
-					//check rotation for noticeable effect
-					LLQuaternion test_rot = mayaQ( ki_prev->mRot[0], ki_prev->mRot[1], ki_prev->mRot[2], order);
-					LLQuaternion last_good_rot = mayaQ( ki_last_good_rot->mRot[0], ki_last_good_rot->mRot[1], ki_last_good_rot->mRot[2], order);
-					LLQuaternion current_rot = mayaQ( ki->mRot[0], ki->mRot[1], ki->mRot[2], order);
-					LLQuaternion interp_rot = lerp(1.f / (F32)numRotFramesConsidered, current_rot, last_good_rot);
-
-					F32 x_delta;
-					F32 y_delta;
-					F32 rot_test;
-					
-					// Test if the rotation has changed significantly since the very first frame.  If false
-					// for all frames, then we'll just throw out this joint's rotation entirely.
-					x_delta = dist_vec(LLVector3::x_axis * first_frame_rot, LLVector3::x_axis * test_rot);
-					y_delta = dist_vec(LLVector3::y_axis * first_frame_rot, LLVector3::y_axis * test_rot);
-					rot_test = x_delta + y_delta;
-					if (rot_test > ROTATION_MOTION_THRESHOLD)
-					{
-						rot_changed = TRUE;
-					}
-					x_delta = dist_vec(LLVector3::x_axis * interp_rot, LLVector3::x_axis * test_rot);
-					y_delta = dist_vec(LLVector3::y_axis * interp_rot, LLVector3::y_axis * test_rot);
-					rot_test = x_delta + y_delta;
-
-					// Draw a line between the last good keyframe and current.  Test the distance between the last frame (current-1, i.e. ki_prev)
-					// and the line.  If it's greater than some threshold, then it represents a significant frame and we want to include it.
-					if (rot_test >= rot_threshold ||
-						(ki+1 == joint->mKeys.end() && numRotFramesConsidered > 2))
+					// This keyframe isn't significant enough, throw it away.
+					ki_prev->mIgnoreRot = TRUE;
+					numRotFramesConsidered++;
+					// Store away the keyframe that has the largest deviation from the interpolated line, for insertion later.
+					if (rot_test > diff_max)
 					{
-						// Add the current test keyframe (which is technically the previous key, i.e. ki_prev).
-						numRotFramesConsidered = 2;
-						ki_last_good_rot = ki_prev;
-						joint->mNumRotKeys++;
-
-						// Add another keyframe between the last good keyframe and current, at whatever point was the most "significant" (i.e.
-						// had the largest deviation from the earlier tests).  Note that a more robust approach would be test all intermediate
-						// keyframes against the line between the last good keyframe and current, but we're settling for this other method
-						// because it's significantly faster.
-						if (diff_max > 0)
-						{
-							if (ki_max->mIgnoreRot == TRUE)
-							{
-								ki_max->mIgnoreRot = FALSE;
-								joint->mNumRotKeys++;
-							}
-							diff_max = 0;
-						}
-					}
-					else
-					{
-						// This keyframe isn't significant enough, throw it away.
-						ki_prev->mIgnoreRot = TRUE;
-						numRotFramesConsidered++;
-						// Store away the keyframe that has the largest deviation from the interpolated line, for insertion later.
-						if (rot_test > diff_max)
-						{
-							diff_max = rot_test;
-							ki_max = ki;
-						}
+						diff_max = rot_test;
+						ki_max = ki;
 					}
 				}
-
-				ki_prev = ki;
 			}
-		}	
 
-		// don't output joints with no motion
-		if (!(pos_changed || rot_changed))
-		{
-			//llinfos << "Ignoring joint " << joint->mName << llendl;
-			joint->mIgnore = TRUE;
+			ki_prev = ki;
 		}
+	}	
+
+	// don't output joints with no motion
+	if (!(pos_changed || rot_changed))
+	{
+		//llinfos << "Ignoring joint " << joint->mName << llendl;
+		joint->mIgnore = TRUE;
 	}
 }
 
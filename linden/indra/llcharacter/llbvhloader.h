@@ -41,6 +41,7 @@
 
 const S32 BVH_PARSER_LINE_SIZE = 2048;
 class LLDataPacker;
+class LLThreadPool;
 
 //------------------------------------------------------------------------
 // FileCloser
@@ -194,7 +195,9 @@ class LLBVHLoader
 	friend class LLKeyframeMotion;
 public:
 	// Constructor
-	LLBVHLoader(const char* buffer);
+	// buffer does not need to be NUL terminated.  If a thread pool is
+	// given, keyframe reduction is spread over it one joint per job.
+	LLBVHLoader(const char* buffer, S32 buffer_size, LLThreadPool* thread_pool = NULL);
 	~LLBVHLoader();
 	
 	// Status Codes
@@ -236,7 +239,7 @@ public:
 
 	// Load the specified BVH file.
 	// Returns status code.
-	Status loadBVHFile(const char *buffer, char *error_text, S32 &error_line);
+	Status loadBVHFile(const char *buffer, S32 buffer_size, char *error_text, S32 &error_line);
 
 	// Applies translations to BVH data loaded.
 	void applyTranslations();
@@ -254,6 +257,9 @@ public:
 	// flags redundant keyframe data
 	void optimize();
 
+	// flags redundant keyframe data of a single joint
+	static void optimizeJoint(Joint *joint);
+
 	void reset();
 
 	F32 getDuration() { return mDuration; }
@@ -288,6 +294,7 @@ protected:
 
 	BOOL				mInitialized;
 	Status				mStatus;
+	LLThreadPool*		mThreadPool;
 	// computed values
 	F32	mDuration;
 };
@@ -489,6 +489,15 @@ void LLCharacter::addVisualParam(LLVisualParam *param)
 //-----------------------------------------------------------------------------
 void LLCharacter::updateVisualParams()
 {
+	applyVisualParams();
+}
+
+//-----------------------------------------------------------------------------
+// applyVisualParams()
+//-----------------------------------------------------------------------------
+U32 LLCharacter::applyVisualParams()
+{
+	U32 stages = 0;
 	for (LLVisualParam *param = getFirstVisualParam(); 
 		param;
 		param = getNextVisualParam())
@@ -502,8 +511,10 @@ void LLCharacter::updateVisualParams()
 		if (effective_weight != param->getLastWeight())
 		{
 			param->apply( mSex );
+			stages |= param->getApplyStages();
 		}
 	}
+	return stages;
 }
  
 LLAnimPauseRequest LLCharacter::requestPause()
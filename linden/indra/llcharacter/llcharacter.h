@@ -130,6 +130,10 @@ public:
 	// updates all visual parameters for this character
 	virtual void updateVisualParams();
 
+	// applies visual parameters whose weight changed since they were last
+	// applied, returning the EVisualParamStage bits they dirtied
+	U32 applyVisualParams();
+
 	virtual void addDebugText( const std::string& text ) = 0;
 
 	virtual const LLUUID&	getID() = 0;
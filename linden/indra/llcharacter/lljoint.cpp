@@ -55,6 +55,7 @@ LLJoint::LLJoint()
 	mDirtyFlags = MATRIX_DIRTY | ROTATION_DIRTY | POSITION_DIRTY;
 	mUpdateXform = TRUE;
 	mJointNum = -1;
+	mHierarchySerial = 0;
 	touch();
 }
 
@@ -71,6 +72,7 @@ LLJoint::LLJoint(const std::string &name, LLJoint *parent)
 	mXform.setScale(LLVector3(1.0f, 1.0f, 1.0f));
 	mDirtyFlags = MATRIX_DIRTY | ROTATION_DIRTY | POSITION_DIRTY;
 	mJointNum = 0;
+	mHierarchySerial = 0;
 
 	setName(name);
 	if (parent)
@@ -131,6 +133,19 @@ void LLJoint::touch(U32 flags)
 	}
 }
 
+//-----------------------------------------------------------------------------
+// touchHierarchy()
+// Reparenting changes the tree under every ancestor, so each of them may
+// be the root of a hierarchy that is now out of date.
+//-----------------------------------------------------------------------------
+void LLJoint::touchHierarchy()
+{
+	for (LLJoint* joint = this; joint; joint = joint->mParent)
+	{
+		joint->mHierarchySerial++;
+	}
+}
+
 //-----------------------------------------------------------------------------
 // getRoot()
 //-----------------------------------------------------------------------------
@@ -179,6 +194,7 @@ void LLJoint::addChild(LLJoint* joint)
 	joint->mXform.setParent(&mXform);
 	joint->mParent = this;	
 	joint->touch();
+	touchHierarchy();
 }
 
 
@@ -195,6 +211,7 @@ void LLJoint::removeChild(LLJoint* joint)
 		joint->mXform.setParent(NULL);
 		joint->mParent = NULL;
 		joint->touch();
+		touchHierarchy();
 	}
 }
 
@@ -213,6 +230,7 @@ void LLJoint::removeAllChildren()
 		joint->mXform.setParent(NULL);
 		joint->mParent = NULL;
 		joint->touch();
+		touchHierarchy();
 	}
 }
 
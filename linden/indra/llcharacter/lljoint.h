@@ -100,6 +100,10 @@ public:
 	typedef std::list<LLJoint*> child_list_t;
 	child_list_t mChildren;
 
+	// bumped on a joint and all its ancestors whenever a joint below it
+	// is reparented, see LLJointHierarchy
+	U32				mHierarchySerial;
+
 	// debug statics
 	static S32		sNumTouches;
 	static S32		sNumUpdates;
@@ -115,6 +119,9 @@ public:
 
 	void touch(U32 flags = ALL_DIRTY);
 
+	// invalidates any LLJointHierarchy built over this joint
+	void touchHierarchy();
+
 	// get/set name
 	const std::string& getName() const { return mName; }
 	void setName( const std::string &name ) { mName = name; }
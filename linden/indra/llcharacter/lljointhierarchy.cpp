@@ -0,0 +1,334 @@
+/** 
+ * @file lljointhierarchy.cpp
+ * @brief Joint tree flattened for batched world matrix updates
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "lljointhierarchy.h"
+
+#include "llv4math.h"
+
+//-----------------------------------------------------------------------------
+// LLJointHierarchy()
+//-----------------------------------------------------------------------------
+LLJointHierarchy::LLJointHierarchy()
+	: mRoot(NULL),
+	  mSerial(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+// setRoot()
+//-----------------------------------------------------------------------------
+void LLJointHierarchy::setRoot(LLJoint* root)
+{
+	mRoot = root;
+	mJoints.clear();
+	mParents.clear();
+	mSerial = 0;
+}
+
+//-----------------------------------------------------------------------------
+// getNumJoints()
+//-----------------------------------------------------------------------------
+S32 LLJointHierarchy::getNumJoints()
+{
+	if (mRoot && (mJoints.empty() || mSerial != mRoot->mHierarchySerial))
+	{
+		build();
+	}
+	return (S32)mJoints.size();
+}
+
+//-----------------------------------------------------------------------------
+// build()
+//-----------------------------------------------------------------------------
+void LLJointHierarchy::build()
+{
+	mJoints.clear();
+	mParents.clear();
+	mSerial = mRoot->mHierarchySerial;
+
+	// explicit stack, pushing children in reverse so they come out in the
+	// order updateWorldMatrixChildren() visits them
+	std::vector<std::pair<LLJoint*, S32> > stack;
+	stack.push_back(std::make_pair(mRoot, -1));
+	while (!stack.empty())
+	{
+		LLJoint* joint = stack.back().first;
+		S32 parent = stack.back().second;
+		stack.pop_back();
+
+		S32 index = (S32)mJoints.size();
+		mJoints.push_back(joint);
+		mParents.push_back(parent);
+
+		for (LLJoint::child_list_t::reverse_iterator iter = joint->mChildren.rbegin();
+			 iter != joint->mChildren.rend(); ++iter)
+		{
+			stack.push_back(std::make_pair(*iter, index));
+		}
+	}
+	mSkipped.resize(mJoints.size());
+}
+
+//-----------------------------------------------------------------------------
+// update_world_transform()
+// LLXformMatrix::update().  The SSE path does the quaternion multiply and
+// the rotation of the offset with the same multiplies and adds in the same
+// order as LLQuaternion's operators, so the results are identical.
+//-----------------------------------------------------------------------------
+#if LL_VECTORIZE
+
+static inline void update_world_transform(LLXformMatrix* xform)
+{
+	LLXform* parent = xform->getParent();
+	if (!parent)
+	{
+		xform->update();
+		return;
+	}
+
+	const __m128 neg_w = _mm_setr_ps(0.f, 0.f, 0.f, -0.f);
+	const LLQuaternion& parent_rot = parent->getWorldRotation();
+	const __m128 q = _mm_loadu_ps(parent_rot.mQ);
+
+	// offset *= parent world rotation, see operator*=(LLVector3&, const LLQuaternion&)
+	const LLVector3& pos = xform->getPosition();
+	__m128 a = _mm_setr_ps(pos.mV[VX], pos.mV[VY], pos.mV[VZ], pos.mV[VX]);
+	if (parent->getScaleChildOffset())
+	{
+		const LLVector3& scale = parent->getScale();
+		a = _mm_mul_ps(a, _mm_setr_ps(scale.mV[VX], scale.mV[VY], scale.mV[VZ], scale.mV[VX]));
+	}
+	__m128 t0 = _mm_mul_ps(_mm_xor_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(0, 3, 3, 3)), neg_w), a);
+	__m128 t1 = _mm_mul_ps(_mm_xor_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(1, 0, 2, 1)), neg_w),
+						   _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 0, 2)));
+	__m128 t2 = _mm_mul_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(2, 1, 0, 2)),
+						   _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 0, 2, 1)));
+	const __m128 r = _mm_sub_ps(_mm_add_ps(t0, t1), t2);	// rx ry rz rw
+
+	t0 = _mm_mul_ps(_mm_xor_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(3, 3, 3, 3)), _mm_set1_ps(-0.f)), q);
+	t1 = _mm_mul_ps(r, _mm_shuffle_ps(q, q, _MM_SHUFFLE(3, 3, 3, 3)));
+	t2 = _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(3, 0, 2, 1)), _mm_shuffle_ps(q, q, _MM_SHUFFLE(3, 1, 0, 2)));
+	__m128 t3 = _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(3, 1, 0, 2)), _mm_shuffle_ps(q, q, _MM_SHUFFLE(3, 0, 2, 1)));
+	const LLVector3& parent_pos = parent->getWorldPosition();
+	const __m128 world_pos = _mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_add_ps(t0, t1), t2), t3),
+										_mm_setr_ps(parent_pos.mV[VX], parent_pos.mV[VY], parent_pos.mV[VZ], 0.f));
+
+	// rotation * parent world rotation, see operator*(const LLQuaternion&, const LLQuaternion&)
+	const __m128 b = _mm_loadu_ps(xform->getRotation().mQ);
+	t0 = _mm_mul_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(3, 3, 3, 3)), b);
+	t1 = _mm_mul_ps(_mm_xor_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(0, 2, 1, 0)), neg_w),
+					_mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 3, 3)));
+	t2 = _mm_mul_ps(_mm_xor_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(1, 0, 2, 1)), neg_w),
+					_mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 1, 0, 2)));
+	t3 = _mm_mul_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(2, 1, 0, 2)),
+					_mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 0, 2, 1)));
+	const __m128 world_rot = _mm_sub_ps(_mm_add_ps(_mm_add_ps(t0, t1), t2), t3);
+
+	LL_LLV4MATH_ALIGN_PREFIX F32 out_pos[4] LL_LLV4MATH_ALIGN_POSTFIX;
+	LL_LLV4MATH_ALIGN_PREFIX F32 out_rot[4] LL_LLV4MATH_ALIGN_POSTFIX;
+	_mm_store_ps(out_pos, world_pos);
+	_mm_store_ps(out_rot, world_rot);
+	xform->setWorldTransform(LLVector3(out_pos[VX], out_pos[VY], out_pos[VZ]),
+							 LLQuaternion(out_rot[VX], out_rot[VY], out_rot[VZ], out_rot[VW]));
+}
+
+#else
+
+static inline void update_world_transform(LLXformMatrix* xform)
+{
+	xform->update();
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+// build_world_matrix()
+// The matrix part of LLXformMatrix::updateMatrix().  A joint's world matrix
+// is only ever written by initAll() over an identity, so the column it
+// leaves alone is always zero and one.
+//-----------------------------------------------------------------------------
+static inline void build_world_matrix(LLXformMatrix* xform)
+{
+	xform->getWorldMatrix().initAll(xform->getScale(), xform->getWorldRotation(), xform->getWorldPosition());
+}
+
+//-----------------------------------------------------------------------------
+// build_world_matrices()
+// Four build_world_matrix() at once.  The SSE path does the same multiplies
+// and adds in the same order, so the matrices are identical.
+//-----------------------------------------------------------------------------
+#if LL_VECTORIZE
+
+static void build_world_matrices(LLXformMatrix** xforms)
+{
+	const LLQuaternion& q0 = xforms[0]->getWorldRotation();
+	const LLQuaternion& q1 = xforms[1]->getWorldRotation();
+	const LLQuaternion& q2 = xforms[2]->getWorldRotation();
+	const LLQuaternion& q3 = xforms[3]->getWorldRotation();
+	__m128 x = _mm_loadu_ps(q0.mQ);
+	__m128 y = _mm_loadu_ps(q1.mQ);
+	__m128 z = _mm_loadu_ps(q2.mQ);
+	__m128 w = _mm_loadu_ps(q3.mQ);
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+
+	const LLVector3& s0 = xforms[0]->getScale();
+	const LLVector3& s1 = xforms[1]->getScale();
+	const LLVector3& s2 = xforms[2]->getScale();
+	const LLVector3& s3 = xforms[3]->getScale();
+	const __m128 sx = _mm_setr_ps(s0.mV[VX], s1.mV[VX], s2.mV[VX], s3.mV[VX]);
+	const __m128 sy = _mm_setr_ps(s0.mV[VY], s1.mV[VY], s2.mV[VY], s3.mV[VY]);
+	const __m128 sz = _mm_setr_ps(s0.mV[VZ], s1.mV[VZ], s2.mV[VZ], s3.mV[VZ]);
+
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 two = _mm_set1_ps(2.f);
+	const __m128 xx = _mm_mul_ps(x, x);
+	const __m128 xy = _mm_mul_ps(x, y);
+	const __m128 xz = _mm_mul_ps(x, z);
+	const __m128 xw = _mm_mul_ps(x, w);
+	const __m128 yy = _mm_mul_ps(y, y);
+	const __m128 yz = _mm_mul_ps(y, z);
+	const __m128 yw = _mm_mul_ps(y, w);
+	const __m128 zz = _mm_mul_ps(z, z);
+	const __m128 zw = _mm_mul_ps(z, w);
+
+	// one column of the rotation part at a time, transposed into a row
+	// per joint
+	LLMatrix4& mat0 = xforms[0]->getWorldMatrix();
+	LLMatrix4& mat1 = xforms[1]->getWorldMatrix();
+	LLMatrix4& mat2 = xforms[2]->getWorldMatrix();
+	LLMatrix4& mat3 = xforms[3]->getWorldMatrix();
+	__m128 r0 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+	__m128 r1 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, zw)), sx);
+	__m128 r2 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, yw)), sx);
+	__m128 r3 = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	_mm_storeu_ps(mat0.mMatrix[VX], r0);
+	_mm_storeu_ps(mat1.mMatrix[VX], r1);
+	_mm_storeu_ps(mat2.mMatrix[VX], r2);
+	_mm_storeu_ps(mat3.mMatrix[VX], r3);
+
+	r0 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, zw)), sy);
+	r1 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+	r2 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, xw)), sy);
+	r3 = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	_mm_storeu_ps(mat0.mMatrix[VY], r0);
+	_mm_storeu_ps(mat1.mMatrix[VY], r1);
+	_mm_storeu_ps(mat2.mMatrix[VY], r2);
+	_mm_storeu_ps(mat3.mMatrix[VY], r3);
+
+	r0 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, yw)), sz);
+	r1 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, xw)), sz);
+	r2 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+	r3 = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	_mm_storeu_ps(mat0.mMatrix[VZ], r0);
+	_mm_storeu_ps(mat1.mMatrix[VZ], r1);
+	_mm_storeu_ps(mat2.mMatrix[VZ], r2);
+	_mm_storeu_ps(mat3.mMatrix[VZ], r3);
+
+	for (S32 j = 0; j < 4; j++)
+	{
+		const LLVector3& pos = xforms[j]->getWorldPosition();
+		LLMatrix4& mat = xforms[j]->getWorldMatrix();
+		mat.mMatrix[VW][VX] = pos.mV[VX];
+		mat.mMatrix[VW][VY] = pos.mV[VY];
+		mat.mMatrix[VW][VZ] = pos.mV[VZ];
+	}
+}
+
+#else
+
+static void build_world_matrices(LLXformMatrix** xforms)
+{
+	for (S32 j = 0; j < 4; j++)
+	{
+		build_world_matrix(xforms[j]);
+	}
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+// updateWorldMatrices()
+//-----------------------------------------------------------------------------
+void LLJointHierarchy::updateWorldMatrices()
+{
+	S32 num_joints = getNumJoints();
+	if (!num_joints)
+	{
+		return;
+	}
+
+	LLJoint** joints = &mJoints[0];
+	const S32* parents = &mParents[0];
+	U8* skipped = &mSkipped[0];
+	LLXformMatrix* batch[4];
+	S32 batch_count = 0;
+
+	// a joint that doesn't update its transform hides its whole subtree,
+	// and parents always come first, so their flags are already set and
+	// their world positions and rotations already current
+	for (S32 i = 0; i < num_joints; i++)
+	{
+		LLJoint* joint = joints[i];
+		S32 parent = parents[i];
+		if ((parent >= 0 && skipped[parent]) || !joint->mUpdateXform)
+		{
+			skipped[i] = TRUE;
+			continue;
+		}
+		skipped[i] = FALSE;
+
+		// what LLJoint::updateWorldMatrix() does, with the matrices built
+		// in batches since they don't depend on each other
+		if (joint->mDirtyFlags & LLJoint::MATRIX_DIRTY)
+		{
+			LLJoint::sNumUpdates++;
+			update_world_transform(joint->getXform());
+			joint->mDirtyFlags = 0x0;
+			batch[batch_count++] = joint->getXform();
+			if (batch_count == 4)
+			{
+				build_world_matrices(batch);
+				batch_count = 0;
+			}
+		}
+	}
+
+	for (S32 j = 0; j < batch_count; j++)
+	{
+		build_world_matrix(batch[j]);
+	}
+}
@@ -0,0 +1,74 @@
+/** 
+ * @file lljointhierarchy.h
+ * @brief Joint tree flattened for batched world matrix updates
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLJOINTHIERARCHY_H
+#define LL_LLJOINTHIERARCHY_H
+
+#include <vector>
+
+#include "lljoint.h"
+
+//-----------------------------------------------------------------------------
+// LLJointHierarchy
+// A joint tree flattened into an array with every parent ahead of its
+// children, so the world matrices can be brought up to date in one pass
+// instead of recursing through each joint's child list.  The joints keep
+// their own transforms.  World positions and rotations are brought down
+// the tree in that order; the world matrices only depend on a joint's own
+// world transform, so they are built four at a time along the way.  The
+// array is rebuilt the next time it is used after a joint under the root
+// is reparented.
+//-----------------------------------------------------------------------------
+class LLJointHierarchy
+{
+public:
+	LLJointHierarchy();
+
+	void setRoot(LLJoint* root);
+	LLJoint* getRoot() const	{ return mRoot; }
+
+	// Same result as mRoot->updateWorldMatrixChildren()
+	void updateWorldMatrices();
+
+	S32 getNumJoints();
+
+private:
+	void build();
+
+	LLJoint*				mRoot;
+	std::vector<LLJoint*>	mJoints;	// depth first, mJoints[0] is the root
+	std::vector<S32>		mParents;	// index into mJoints, -1 for the root
+	std::vector<U8>			mSkipped;	// scratch for updateWorldMatrices()
+	U32						mSerial;	// mRoot->mHierarchySerial when built
+};
+
+#endif // LL_LLJOINTHIERARCHY_H
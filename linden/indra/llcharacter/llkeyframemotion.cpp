@@ -35,6 +35,8 @@
 //-----------------------------------------------------------------------------
 #include "linden_common.h"
 
+#include <algorithm>
+
 #include "llmath.h"
 #include "llanimationstates.h"
 #include "llassetstorage.h"
@@ -45,6 +47,7 @@
 #include "llendianswizzle.h"
 #include "llkeyframemotion.h"
 #include "llquantize.h"
+#include "llthreadpool.h"
 #include "llvfile.h"
 #include "m3math.h"
 #include "message.h"
@@ -54,6 +57,13 @@
 //-----------------------------------------------------------------------------
 LLVFS*				LLKeyframeMotion::sVFS = NULL;
 LLKeyframeDataCache::keyframe_data_map_t	LLKeyframeDataCache::sKeyframeDataMap;
+LLThreadPool*		LLKeyframeLoadQueue::sThreadPool = NULL;
+LLKeyframeLoadQueue::LoadJob* volatile LLKeyframeLoadQueue::sCompleted = NULL;
+S32					LLKeyframeLoadQueue::sNumPending = 0;
+U32					LLKeyframeLoadQueue::sNumLoaded = 0;
+U32					LLKeyframeLoadQueue::sNumFailed = 0;
+LLStat				LLKeyframeLoadQueue::sLoadLatencyStat(32);
+LLStat				LLKeyframeLoadQueue::sDecodeTimeStat(32);
 
 //-----------------------------------------------------------------------------
 // Globals
@@ -102,23 +112,23 @@ U32 LLKeyframeMotion::JointMotionList::dumpDiagInfo()
 		if (joint_motion_p->mUsage & LLJointState::SCALE)
 		{
 			llinfos << "\t" << joint_motion_p->mScaleCurve.mNumKeys << " scale keys at " 
-			<< joint_motion_p->mScaleCurve.mNumKeys * sizeof(ScaleKey) << " bytes" << llendl;
+			<< joint_motion_p->mScaleCurve.getMemoryUsage() << " bytes" << llendl;
 
-			total_size += joint_motion_p->mScaleCurve.mNumKeys * sizeof(ScaleKey);
+			total_size += joint_motion_p->mScaleCurve.getMemoryUsage();
 		}
 		if (joint_motion_p->mUsage & LLJointState::ROT)
 		{
 			llinfos << "\t" << joint_motion_p->mRotationCurve.mNumKeys << " rotation keys at " 
-			<< joint_motion_p->mRotationCurve.mNumKeys * sizeof(RotationKey) << " bytes" << llendl;
+			<< joint_motion_p->mRotationCurve.getMemoryUsage() << " bytes" << llendl;
 
-			total_size += joint_motion_p->mRotationCurve.mNumKeys * sizeof(RotationKey);
+			total_size += joint_motion_p->mRotationCurve.getMemoryUsage();
 		}
 		if (joint_motion_p->mUsage & LLJointState::POS)
 		{
 			llinfos << "\t" << joint_motion_p->mPositionCurve.mNumKeys << " position keys at " 
-			<< joint_motion_p->mPositionCurve.mNumKeys * sizeof(PositionKey) << " bytes" << llendl;
+			<< joint_motion_p->mPositionCurve.getMemoryUsage() << " bytes" << llendl;
 
-			total_size += joint_motion_p->mPositionCurve.mNumKeys * sizeof(PositionKey);
+			total_size += joint_motion_p->mPositionCurve.getMemoryUsage();
 		}
 	}
 	llinfos << "Size: " << total_size << " bytes" << llendl;
@@ -133,6 +143,65 @@ U32 LLKeyframeMotion::JointMotionList::dumpDiagInfo()
 //-----------------------------------------------------------------------------
 
 
+//-----------------------------------------------------------------------------
+// is_key_lower_bound()
+//-----------------------------------------------------------------------------
+static inline BOOL is_key_lower_bound(const std::vector<F32>& key_times, S32 index, F32 time)
+{
+	return (index == 0 || key_times[index - 1] < time)
+		&& (index == (S32)key_times.size() || key_times[index] >= time);
+}
+
+//-----------------------------------------------------------------------------
+// find_key()
+// Returns the index of the first key at or after time, or the number of keys
+// if there is none.  Playback mostly stays on a key or moves to the next one,
+// so those are tried before searching.
+//-----------------------------------------------------------------------------
+static S32 find_key(const std::vector<F32>& key_times, F32 time, S32& cursor)
+{
+	S32 num_keys = (S32)key_times.size();
+	S32 index = llclamp(cursor, 0, num_keys);
+	if (!is_key_lower_bound(key_times, index, time))
+	{
+		if (index < num_keys && is_key_lower_bound(key_times, index + 1, time))
+		{
+			index++;
+		}
+		else
+		{
+			index = (S32)(std::lower_bound(key_times.begin(), key_times.end(), time) - key_times.begin());
+		}
+	}
+	cursor = index;
+	return index;
+}
+
+//-----------------------------------------------------------------------------
+// insert_key_time()
+// Returns where a key at time belongs, and whether it replaces a key already
+// there.  Keys almost always arrive in order.
+//-----------------------------------------------------------------------------
+static S32 insert_key_time(std::vector<F32>& key_times, F32 time, BOOL& replace)
+{
+	replace = FALSE;
+	if (key_times.empty() || key_times.back() < time)
+	{
+		key_times.push_back(time);
+		return (S32)key_times.size() - 1;
+	}
+
+	std::vector<F32>::iterator iter = std::lower_bound(key_times.begin(), key_times.end(), time);
+	if (*iter == time)
+	{
+		replace = TRUE;
+		return (S32)(iter - key_times.begin());
+	}
+	S32 index = (S32)(iter - key_times.begin());
+	key_times.insert(iter, time);
+	return index;
+}
+
 //-----------------------------------------------------------------------------
 // ScaleCurve::ScaleCurve()
 //-----------------------------------------------------------------------------
@@ -147,51 +216,41 @@ LLKeyframeMotion::ScaleCurve::ScaleCurve()
 //-----------------------------------------------------------------------------
 LLKeyframeMotion::ScaleCurve::~ScaleCurve() 
 {
-	mKeys.clear();
 	mNumKeys = 0;
 }
 
 //-----------------------------------------------------------------------------
 // getValue()
 //-----------------------------------------------------------------------------
-LLVector3 LLKeyframeMotion::ScaleCurve::getValue(F32 time, F32 duration)
+LLVector3 LLKeyframeMotion::ScaleCurve::getValue(F32 time, F32 duration, S32& cursor) const
 {
 	LLVector3 value;
 
-	if (mKeys.empty())
+	if (mKeyTimes.empty())
 	{
 		value.clearVec();
 		return value;
 	}
 	
-	key_map_t::iterator right = mKeys.lower_bound(time);
-	if (right == mKeys.end())
+	S32 right = find_key(mKeyTimes, time, cursor);
+	if (right == (S32)mKeyTimes.size())
 	{
 		// Past last key
-		--right;
-		value = right->second.mScale;
+		value = mKeyScales[right - 1];
 	}
-	else if (right == mKeys.begin() || right->first == time)
+	else if (right == 0 || mKeyTimes[right] == time)
 	{
 		// Before first key or exactly on a key
-		value = right->second.mScale;
+		value = mKeyScales[right];
 	}
 	else
 	{
 		// Between two keys
-		key_map_t::iterator left = right; --left;
-		F32 index_before = left->first;
-		F32 index_after = right->first;
-		ScaleKey& scale_before = left->second;
-		ScaleKey& scale_after = right->second;
-		if (right == mKeys.end())
-		{
-			scale_after = mLoopInKey;
-			index_after = duration;
-		}
+		F32 index_before = mKeyTimes[right - 1];
+		F32 index_after = mKeyTimes[right];
 
 		F32 u = (time - index_before) / (index_after - index_before);
-		value = interp(u, scale_before, scale_after);
+		value = interp(u, mKeyScales[right - 1], mKeyScales[right]);
 	}
 	return value;
 }
@@ -199,20 +258,46 @@ LLVector3 LLKeyframeMotion::ScaleCurve::getValue(F32 time, F32 duration)
 //-----------------------------------------------------------------------------
 // interp()
 //-----------------------------------------------------------------------------
-LLVector3 LLKeyframeMotion::ScaleCurve::interp(F32 u, ScaleKey& before, ScaleKey& after)
+LLVector3 LLKeyframeMotion::ScaleCurve::interp(F32 u, const LLVector3& before, const LLVector3& after) const
 {
 	switch (mInterpolationType)
 	{
 	case IT_STEP:
-		return before.mScale;
+		return before;
 
 	default:
 	case IT_LINEAR:
 	case IT_SPLINE:
-		return lerp(before.mScale, after.mScale, u);
+		return lerp(before, after, u);
 	}
 }
 
+//-----------------------------------------------------------------------------
+// addKey()
+//-----------------------------------------------------------------------------
+void LLKeyframeMotion::ScaleCurve::addKey(const ScaleKey& key)
+{
+	BOOL replace;
+	S32 index = insert_key_time(mKeyTimes, key.mTime, replace);
+	if (replace)
+	{
+		mKeyScales[index] = key.mScale;
+	}
+	else
+	{
+		mKeyScales.insert(mKeyScales.begin() + index, key.mScale);
+	}
+	mNumKeys = (S32)mKeyTimes.size();
+}
+
+//-----------------------------------------------------------------------------
+// getMemoryUsage()
+//-----------------------------------------------------------------------------
+U32 LLKeyframeMotion::ScaleCurve::getMemoryUsage() const
+{
+	return mKeyTimes.capacity() * sizeof(F32) + mKeyScales.capacity() * sizeof(LLVector3);
+}
+
 //-----------------------------------------------------------------------------
 // RotationCurve::RotationCurve()
 //-----------------------------------------------------------------------------
@@ -227,51 +312,41 @@ LLKeyframeMotion::RotationCurve::RotationCurve()
 //-----------------------------------------------------------------------------
 LLKeyframeMotion::RotationCurve::~RotationCurve()
 {
-	mKeys.clear();
 	mNumKeys = 0;
 }
 
 //-----------------------------------------------------------------------------
 // RotationCurve::getValue()
 //-----------------------------------------------------------------------------
-LLQuaternion LLKeyframeMotion::RotationCurve::getValue(F32 time, F32 duration)
+LLQuaternion LLKeyframeMotion::RotationCurve::getValue(F32 time, F32 duration, S32& cursor) const
 {
 	LLQuaternion value;
 
-	if (mKeys.empty())
+	if (mKeyTimes.empty())
 	{
 		value = LLQuaternion::DEFAULT;
 		return value;
 	}
 	
-	key_map_t::iterator right = mKeys.lower_bound(time);
-	if (right == mKeys.end())
+	S32 right = find_key(mKeyTimes, time, cursor);
+	if (right == (S32)mKeyTimes.size())
 	{
 		// Past last key
-		--right;
-		value = right->second.mRotation;
+		value = mKeyRotations[right - 1];
 	}
-	else if (right == mKeys.begin() || right->first == time)
+	else if (right == 0 || mKeyTimes[right] == time)
 	{
 		// Before first key or exactly on a key
-		value = right->second.mRotation;
+		value = mKeyRotations[right];
 	}
 	else
 	{
 		// Between two keys
-		key_map_t::iterator left = right; --left;
-		F32 index_before = left->first;
-		F32 index_after = right->first;
-		RotationKey& rot_before = left->second;
-		RotationKey& rot_after = right->second;
-		if (right == mKeys.end())
-		{
-			rot_after = mLoopInKey;
-			index_after = duration;
-		}
+		F32 index_before = mKeyTimes[right - 1];
+		F32 index_after = mKeyTimes[right];
 
 		F32 u = (time - index_before) / (index_after - index_before);
-		value = interp(u, rot_before, rot_after);
+		value = interp(u, mKeyRotations[right - 1], mKeyRotations[right]);
 	}
 	return value;
 }
@@ -279,20 +354,45 @@ LLQuaternion LLKeyframeMotion::RotationCurve::getValue(F32 time, F32 duration)
 //-----------------------------------------------------------------------------
 // interp()
 //-----------------------------------------------------------------------------
-LLQuaternion LLKeyframeMotion::RotationCurve::interp(F32 u, RotationKey& before, RotationKey& after)
+LLQuaternion LLKeyframeMotion::RotationCurve::interp(F32 u, const LLQuaternion& before, const LLQuaternion& after) const
 {
 	switch (mInterpolationType)
 	{
 	case IT_STEP:
-		return before.mRotation;
+		return before;
 
 	default:
 	case IT_LINEAR:
 	case IT_SPLINE:
-		return nlerp(u, before.mRotation, after.mRotation);
+		return nlerp(u, before, after);
 	}
 }
 
+//-----------------------------------------------------------------------------
+// addKey()
+//-----------------------------------------------------------------------------
+void LLKeyframeMotion::RotationCurve::addKey(const RotationKey& key)
+{
+	BOOL replace;
+	S32 index = insert_key_time(mKeyTimes, key.mTime, replace);
+	if (replace)
+	{
+		mKeyRotations[index] = key.mRotation;
+	}
+	else
+	{
+		mKeyRotations.insert(mKeyRotations.begin() + index, key.mRotation);
+	}
+	mNumKeys = (S32)mKeyTimes.size();
+}
+
+//-----------------------------------------------------------------------------
+// getMemoryUsage()
+//-----------------------------------------------------------------------------
+U32 LLKeyframeMotion::RotationCurve::getMemoryUsage() const
+{
+	return mKeyTimes.capacity() * sizeof(F32) + mKeyRotations.capacity() * sizeof(LLQuaternion);
+}
 
 //-----------------------------------------------------------------------------
 // PositionCurve::PositionCurve()
@@ -308,51 +408,41 @@ LLKeyframeMotion::PositionCurve::PositionCurve()
 //-----------------------------------------------------------------------------
 LLKeyframeMotion::PositionCurve::~PositionCurve()
 {
-	mKeys.clear();
 	mNumKeys = 0;
 }
 
 //-----------------------------------------------------------------------------
 // PositionCurve::getValue()
 //-----------------------------------------------------------------------------
-LLVector3 LLKeyframeMotion::PositionCurve::getValue(F32 time, F32 duration)
+LLVector3 LLKeyframeMotion::PositionCurve::getValue(F32 time, F32 duration, S32& cursor) const
 {
 	LLVector3 value;
 
-	if (mKeys.empty())
+	if (mKeyTimes.empty())
 	{
 		value.clearVec();
 		return value;
 	}
 	
-	key_map_t::iterator right = mKeys.lower_bound(time);
-	if (right == mKeys.end())
+	S32 right = find_key(mKeyTimes, time, cursor);
+	if (right == (S32)mKeyTimes.size())
 	{
 		// Past last key
-		--right;
-		value = right->second.mPosition;
+		value = mKeyPositions[right - 1];
 	}
-	else if (right == mKeys.begin() || right->first == time)
+	else if (right == 0 || mKeyTimes[right] == time)
 	{
 		// Before first key or exactly on a key
-		value = right->second.mPosition;
+		value = mKeyPositions[right];
 	}
 	else
 	{
 		// Between two keys
-		key_map_t::iterator left = right; --left;
-		F32 index_before = left->first;
-		F32 index_after = right->first;
-		PositionKey& pos_before = left->second;
-		PositionKey& pos_after = right->second;
-		if (right == mKeys.end())
-		{
-			pos_after = mLoopInKey;
-			index_after = duration;
-		}
+		F32 index_before = mKeyTimes[right - 1];
+		F32 index_after = mKeyTimes[right];
 
 		F32 u = (time - index_before) / (index_after - index_before);
-		value = interp(u, pos_before, pos_after);
+		value = interp(u, mKeyPositions[right - 1], mKeyPositions[right]);
 	}
 
 	llassert(value.isFinite());
@@ -363,19 +453,45 @@ LLVector3 LLKeyframeMotion::PositionCurve::getValue(F32 time, F32 duration)
 //-----------------------------------------------------------------------------
 // interp()
 //-----------------------------------------------------------------------------
-LLVector3 LLKeyframeMotion::PositionCurve::interp(F32 u, PositionKey& before, PositionKey& after)
+LLVector3 LLKeyframeMotion::PositionCurve::interp(F32 u, const LLVector3& before, const LLVector3& after) const
 {
 	switch (mInterpolationType)
 	{
 	case IT_STEP:
-		return before.mPosition;
+		return before;
 	default:
 	case IT_LINEAR:
 	case IT_SPLINE:
-		return lerp(before.mPosition, after.mPosition, u);
+		return lerp(before, after, u);
 	}
 }
 
+//-----------------------------------------------------------------------------
+// addKey()
+//-----------------------------------------------------------------------------
+void LLKeyframeMotion::PositionCurve::addKey(const PositionKey& key)
+{
+	BOOL replace;
+	S32 index = insert_key_time(mKeyTimes, key.mTime, replace);
+	if (replace)
+	{
+		mKeyPositions[index] = key.mPosition;
+	}
+	else
+	{
+		mKeyPositions.insert(mKeyPositions.begin() + index, key.mPosition);
+	}
+	mNumKeys = (S32)mKeyTimes.size();
+}
+
+//-----------------------------------------------------------------------------
+// getMemoryUsage()
+//-----------------------------------------------------------------------------
+U32 LLKeyframeMotion::PositionCurve::getMemoryUsage() const
+{
+	return mKeyTimes.capacity() * sizeof(F32) + mKeyPositions.capacity() * sizeof(LLVector3);
+}
+
 
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
@@ -386,7 +502,7 @@ LLVector3 LLKeyframeMotion::PositionCurve::interp(F32 u, PositionKey& before, Po
 //-----------------------------------------------------------------------------
 // JointMotion::update()
 //-----------------------------------------------------------------------------
-void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time, F32 duration)
+void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time, F32 duration, KeyCursor& cursor) const
 {
 	// this value being 0 is the cause of https://jira.lindenlab.com/browse/SL-22678 but I haven't 
 	// managed to get a stack to see how it got here. Testing for 0 here will stop the crash.
@@ -402,7 +518,7 @@ void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time,
 	//-------------------------------------------------------------------------
 	if ((usage & LLJointState::SCALE) && mScaleCurve.mNumKeys)
 	{
-		joint_state->setScale( mScaleCurve.getValue( time, duration ) );
+		joint_state->setScale( mScaleCurve.getValue( time, duration, cursor.mScale ) );
 	}
 
 	//-------------------------------------------------------------------------
@@ -410,7 +526,7 @@ void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time,
 	//-------------------------------------------------------------------------
 	if ((usage & LLJointState::ROT) && mRotationCurve.mNumKeys)
 	{
-		joint_state->setRotation( mRotationCurve.getValue( time, duration ) );
+		joint_state->setRotation( mRotationCurve.getValue( time, duration, cursor.mRotation ) );
 	}
 
 	//-------------------------------------------------------------------------
@@ -418,7 +534,7 @@ void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time,
 	//-------------------------------------------------------------------------
 	if ((usage & LLJointState::POS) && mPositionCurve.mNumKeys)
 	{
-		joint_state->setPosition( mPositionCurve.getValue( time, duration ) );
+		joint_state->setPosition( mPositionCurve.getValue( time, duration, cursor.mPosition ) );
 	}
 }
 
@@ -490,24 +606,16 @@ LLMotion::LLMotionInitStatus LLKeyframeMotion::onInitialize(LLCharacter *charact
 {
 	mCharacter = character;
 	
-	LLUUID* character_id;
-
 	// asset already loaded?
 	switch(mAssetStatus)
 	{
 	case ASSET_NEEDS_FETCH:
-		// request asset
-		mAssetStatus = ASSET_FETCHED;
-
-		character_id = new LLUUID(mCharacter->getID());
-		gAssetStorage->getAssetData(mID,
-						LLAssetType::AT_ANIMATION,
-						onLoadComplete,
-						(void *)character_id,
-						FALSE);
-
-		return STATUS_HOLD;
 	case ASSET_FETCHED:
+		// another instance may have finished loading this asset for us
+		if (LLKeyframeDataCache::getKeyframeData(getID()))
+		{
+			break;
+		}
 		return STATUS_HOLD;
 	case ASSET_FETCH_FAILED:
 		return STATUS_FAILURE;
@@ -524,89 +632,78 @@ LLMotion::LLMotionInitStatus LLKeyframeMotion::onInitialize(LLCharacter *charact
 	if(joint_motion_list)
 	{
 		// motion already existed in cache, so grab it
-		mJointMotionList = joint_motion_list;
-
-		mJointStates.reserve(mJointMotionList->getNumJointMotions());
-		
-		// don't forget to allocate joint states
-		// set up joint states to point to character joints
-		for(U32 i = 0; i < mJointMotionList->getNumJointMotions(); i++)
-		{
-			JointMotion* joint_motion = mJointMotionList->getJointMotion(i);
-			if (LLJoint *joint = mCharacter->getJoint(joint_motion->mJointName))
-			{
-				LLPointer<LLJointState> joint_state = new LLJointState;
-				mJointStates.push_back(joint_state);
-				joint_state->setJoint(joint);
-				joint_state->setUsage(joint_motion->mUsage);
-				joint_state->setPriority(joint_motion->mPriority);
-			}
-			else
-			{
-				// add dummy joint state with no associated joint
-				mJointStates.push_back(new LLJointState);
-			}
-		}
-		mAssetStatus = ASSET_LOADED;
-		setupPose();
+		bindJointMotionList(joint_motion_list);
 		return STATUS_SUCCESS;
 	}
 
-	//-------------------------------------------------------------------------
-	// Load named file by concatenating the character prefix with the motion name.
-	// Load data into a buffer to be parsed.
-	//-------------------------------------------------------------------------
-	U8 *anim_data;
-	S32 anim_file_size;
-
 	if (!sVFS)
 	{
 		llerrs << "Must call LLKeyframeMotion::setVFS() first before loading a keyframe file!" << llendl;
 	}
 
-	BOOL success = FALSE;
-	LLVFile* anim_file = new LLVFile(sVFS, mID, LLAssetType::AT_ANIMATION);
-	if (!anim_file || !anim_file->getSize())
-	{
-		delete anim_file;
-		anim_file = NULL;
-		
-		// request asset over network on next call to load
-		mAssetStatus = ASSET_NEEDS_FETCH;
+	// Try the static vfs on a loader thread, falling back to an asset
+	// request.  The motion controller hears about the result from
+	// LLKeyframeLoadQueue::update().
+	mLoadTimer.reset();
+	mAssetStatus = ASSET_FETCHED;
+	LLKeyframeLoadQueue::requestLoad(sVFS, mID, mCharacter->getID(), TRUE);
 
-		return STATUS_HOLD;
-	}
-	else
-	{
-		anim_file_size = anim_file->getSize();
-		anim_data = new U8[anim_file_size];
-		success = anim_file->read(anim_data, anim_file_size);	/*Flawfinder: ignore*/
-		delete anim_file;
-		anim_file = NULL;
-	}
+	return STATUS_HOLD;
+}
 
-	if (!success)
+//-----------------------------------------------------------------------------
+// requestAsset()
+//-----------------------------------------------------------------------------
+void LLKeyframeMotion::requestAsset()
+{
+	mAssetStatus = ASSET_NEEDS_FETCH;
+
+	LLUUID* character_id = new LLUUID(mCharacter->getID());
+	gAssetStorage->getAssetData(mID,
+					LLAssetType::AT_ANIMATION,
+					onLoadComplete,
+					(void *)character_id,
+					FALSE);
+}
+
+//-----------------------------------------------------------------------------
+// bindJointMotionList()
+// Points this instance at a resolved list and sets up its joint states.
+//-----------------------------------------------------------------------------
+void LLKeyframeMotion::bindJointMotionList(JointMotionList* joint_motion_list)
+{
+	if (mAssetStatus == ASSET_NEEDS_FETCH || mAssetStatus == ASSET_FETCHED)
 	{
-		llwarns << "Can't open animation file " << mID << llendl;
-		mAssetStatus = ASSET_FETCH_FAILED;
-		return STATUS_FAILURE;
+		LLKeyframeLoadQueue::sLoadLatencyStat.addValue(mLoadTimer.getElapsedTimeF32() * 1000.f);
 	}
 
-	lldebugs << "Loading keyframe data for: " << getName() << ":" << getID() << " (" << anim_file_size << " bytes)" << llendl;
+	mJointMotionList = joint_motion_list;
 
-	LLDataPackerBinaryBuffer dp(anim_data, anim_file_size);
-
-	if (!deserialize(dp))
+	mJointStates.clear();
+	mJointStates.reserve(mJointMotionList->getNumJointMotions());
+	
+	// don't forget to allocate joint states
+	// set up joint states to point to character joints
+	for(U32 i = 0; i < mJointMotionList->getNumJointMotions(); i++)
 	{
-		llwarns << "Failed to decode asset for animation " << getName() << ":" << getID() << llendl;
-		mAssetStatus = ASSET_FETCH_FAILED;
-		return STATUS_FAILURE;
+		JointMotion* joint_motion = mJointMotionList->getJointMotion(i);
+		if (LLJoint *joint = mCharacter->getJoint(joint_motion->mJointName))
+		{
+			LLPointer<LLJointState> joint_state = new LLJointState;
+			mJointStates.push_back(joint_state);
+			joint_state->setJoint(joint);
+			joint_state->setUsage(joint_motion->mUsage);
+			joint_state->setPriority(joint_motion->mPriority);
+		}
+		else
+		{
+			// add dummy joint state with no associated joint
+			mJointStates.push_back(new LLJointState);
+		}
 	}
-
-	delete []anim_data;
-
+	mKeyCursors.assign(mJointMotionList->getNumJointMotions(), KeyCursor());
 	mAssetStatus = ASSET_LOADED;
-	return STATUS_SUCCESS;
+	setupPose();
 }
 
 //-----------------------------------------------------------------------------
@@ -726,7 +823,8 @@ void LLKeyframeMotion::applyKeyframes(F32 time)
 	{
 		mJointMotionList->getJointMotion(i)->update(mJointStates[i],
 													  time, 
-													  mJointMotionList->mDuration );
+													  mJointMotionList->mDuration,
+													  mKeyCursors[i]);
 	}
 
 	LLJoint::JointPriority* pose_priority = (LLJoint::JointPriority* )mCharacter->getAnimationData("Hand Pose Priority");
@@ -1172,9 +1270,32 @@ void LLKeyframeMotion::applyConstraint(JointConstraint* constraint, F32 time, U8
 // deserialize()
 //-----------------------------------------------------------------------------
 BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
+{
+	JointMotionList* joint_motion_list = new JointMotionList;
+	if (!decodeJointMotionList(dp, joint_motion_list)
+		|| !resolveJointMotionList(joint_motion_list, mCharacter))
+	{
+		delete joint_motion_list;
+		return FALSE;
+	}
+
+	// *FIX: support cleanup of old keyframe data
+	LLKeyframeDataCache::addKeyframeData(getID(),  joint_motion_list);
+	bindJointMotionList(joint_motion_list);
+
+	return TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// decodeJointMotionList()
+// Touches nothing but dp and joint_motion_list, so the loader threads can
+// call it.  Constraint volumes are left as names for
+// resolveJointMotionList().
+//-----------------------------------------------------------------------------
+//static
+BOOL LLKeyframeMotion::decodeJointMotionList(LLDataPacker& dp, JointMotionList* joint_motion_list)
 {
 	BOOL old_version = FALSE;
-	mJointMotionList = new LLKeyframeMotion::JointMotionList;
 
 	//-------------------------------------------------------------------------
 	// get base priority
@@ -1214,24 +1335,24 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 		llwarns << "can't read priority" << llendl;
 		return FALSE;
 	}
-	mJointMotionList->mBasePriority = (LLJoint::JointPriority) temp_priority;
+	joint_motion_list->mBasePriority = (LLJoint::JointPriority) temp_priority;
 
-	if (mJointMotionList->mBasePriority >= LLJoint::ADDITIVE_PRIORITY)
+	if (joint_motion_list->mBasePriority >= LLJoint::ADDITIVE_PRIORITY)
 	{
-		mJointMotionList->mBasePriority = (LLJoint::JointPriority)((int)LLJoint::ADDITIVE_PRIORITY-1);
-		mJointMotionList->mMaxPriority = mJointMotionList->mBasePriority;
+		joint_motion_list->mBasePriority = (LLJoint::JointPriority)((int)LLJoint::ADDITIVE_PRIORITY-1);
+		joint_motion_list->mMaxPriority = joint_motion_list->mBasePriority;
 	}
 
 	//-------------------------------------------------------------------------
 	// get duration
 	//-------------------------------------------------------------------------
-	if (!dp.unpackF32(mJointMotionList->mDuration, "duration"))
+	if (!dp.unpackF32(joint_motion_list->mDuration, "duration"))
 	{
 		llwarns << "can't read duration" << llendl;
 		return FALSE;
 	}
 	
-	if (mJointMotionList->mDuration > MAX_ANIM_DURATION )
+	if (joint_motion_list->mDuration > MAX_ANIM_DURATION )
 	{
 		llwarns << "invalid animation duration" << llendl;
 		return FALSE;
@@ -1240,7 +1361,7 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 	//-------------------------------------------------------------------------
 	// get emote (optional)
 	//-------------------------------------------------------------------------
-	if (!dp.unpackString(mJointMotionList->mEmoteName, "emote_name"))
+	if (!dp.unpackString(joint_motion_list->mEmoteName, "emote_name"))
 	{
 		llwarns << "can't read optional_emote_animation" << llendl;
 		return FALSE;
@@ -1249,19 +1370,19 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 	//-------------------------------------------------------------------------
 	// get loop
 	//-------------------------------------------------------------------------
-	if (!dp.unpackF32(mJointMotionList->mLoopInPoint, "loop_in_point"))
+	if (!dp.unpackF32(joint_motion_list->mLoopInPoint, "loop_in_point"))
 	{
 		llwarns << "can't read loop point" << llendl;
 		return FALSE;
 	}
 
-	if (!dp.unpackF32(mJointMotionList->mLoopOutPoint, "loop_out_point"))
+	if (!dp.unpackF32(joint_motion_list->mLoopOutPoint, "loop_out_point"))
 	{
 		llwarns << "can't read loop point" << llendl;
 		return FALSE;
 	}
 
-	if (!dp.unpackS32(mJointMotionList->mLoop, "loop"))
+	if (!dp.unpackS32(joint_motion_list->mLoop, "loop"))
 	{
 		llwarns << "can't read loop" << llendl;
 		return FALSE;
@@ -1270,13 +1391,13 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 	//-------------------------------------------------------------------------
 	// get easeIn and easeOut
 	//-------------------------------------------------------------------------
-	if (!dp.unpackF32(mJointMotionList->mEaseInDuration, "ease_in_duration"))
+	if (!dp.unpackF32(joint_motion_list->mEaseInDuration, "ease_in_duration"))
 	{
 		llwarns << "can't read easeIn" << llendl;
 		return FALSE;
 	}
 
-	if (!dp.unpackF32(mJointMotionList->mEaseOutDuration, "ease_out_duration"))
+	if (!dp.unpackF32(joint_motion_list->mEaseOutDuration, "ease_out_duration"))
 	{
 		llwarns << "can't read easeOut" << llendl;
 		return FALSE;
@@ -1298,7 +1419,7 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 		return FALSE;
 	}
 	
-	mJointMotionList->mHandPose = (LLHandMotion::eHandPose)word;
+	joint_motion_list->mHandPose = (LLHandMotion::eHandPose)word;
 
 	//-------------------------------------------------------------------------
 	// get number of joint motions
@@ -1321,10 +1442,8 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 		return FALSE;
 	}
 
-	mJointMotionList->mJointMotionArray.clear();
-	mJointMotionList->mJointMotionArray.reserve(num_motions);
-	mJointStates.clear();
-	mJointStates.reserve(num_motions);
+	joint_motion_list->mJointMotionArray.clear();
+	joint_motion_list->mJointMotionArray.reserve(num_motions);
 
 	//-------------------------------------------------------------------------
 	// initialize joint motions
@@ -1333,7 +1452,7 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 	for(U32 i=0; i<num_motions; ++i)
 	{
 		JointMotion* joint_motion = new JointMotion;		
-		mJointMotionList->mJointMotionArray.push_back(joint_motion);
+		joint_motion_list->mJointMotionArray.push_back(joint_motion);
 		
 		std::string joint_name;
 		if (!dp.unpackString(joint_name, "joint_name"))
@@ -1347,27 +1466,9 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 			llwarns << "attempted to animate special " << joint_name << " joint" << llendl;
 			return FALSE;
 		}
-				
-		//---------------------------------------------------------------------
-		// find the corresponding joint
-		//---------------------------------------------------------------------
-		LLJoint *joint = mCharacter->getJoint( joint_name );
-		if (joint)
-		{
-//			llinfos << "  joint: " << joint_name << llendl;
-		}
-		else
-		{
-			llwarns << "joint not found: " << llendl;
-			return FALSE;
-		}
 
 		joint_motion->mJointName = joint_name;
-		
-		LLPointer<LLJointState> joint_state = new LLJointState;
-		mJointStates.push_back(joint_state);
-		joint_state->setJoint( joint );
-		joint_state->setUsage( 0 );
+		joint_motion->mUsage = 0;
 
 		//---------------------------------------------------------------------
 		// get joint priority
@@ -1381,26 +1482,25 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 		
 		joint_motion->mPriority = (LLJoint::JointPriority)joint_priority;
 		if (joint_priority != LLJoint::USE_MOTION_PRIORITY &&
-			joint_priority > mJointMotionList->mMaxPriority)
+			joint_priority > joint_motion_list->mMaxPriority)
 		{
-			mJointMotionList->mMaxPriority = (LLJoint::JointPriority)joint_priority;
+			joint_motion_list->mMaxPriority = (LLJoint::JointPriority)joint_priority;
 		}
 
-		joint_state->setPriority((LLJoint::JointPriority)joint_priority);
-
 		//---------------------------------------------------------------------
 		// scan rotation curve header
 		//---------------------------------------------------------------------
-		if (!dp.unpackS32(joint_motion->mRotationCurve.mNumKeys, "num_rot_keys"))
+		S32 num_rot_keys;
+		if (!dp.unpackS32(num_rot_keys, "num_rot_keys"))
 		{
 			llwarns << "can't read number of rotation keys" << llendl;
 			return FALSE;
 		}
 
 		joint_motion->mRotationCurve.mInterpolationType = IT_LINEAR;
-		if (joint_motion->mRotationCurve.mNumKeys != 0)
+		if (num_rot_keys != 0)
 		{
-			joint_state->setUsage(joint_state->getUsage() | LLJointState::ROT );
+			joint_motion->mUsage |= LLJointState::ROT;
 		}
 
 		//---------------------------------------------------------------------
@@ -1408,7 +1508,7 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 		//---------------------------------------------------------------------
 		RotationCurve *rCurve = &joint_motion->mRotationCurve;
 
-		for (S32 k = 0; k < joint_motion->mRotationCurve.mNumKeys; k++)
+		for (S32 k = 0; k < num_rot_keys; k++)
 		{
 			F32 time;
 			U16 time_short;
@@ -1430,9 +1530,9 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 					return FALSE;
 				}
 
-				time = U16_to_F32(time_short, 0.f, mJointMotionList->mDuration);
+				time = U16_to_F32(time_short, 0.f, joint_motion_list->mDuration);
 				
-				if (time < 0 || time > mJointMotionList->mDuration)
+				if (time < 0 || time > joint_motion_list->mDuration)
 				{
 					llwarns << "invalid frame time" << llendl;
 					return FALSE;
@@ -1478,22 +1578,23 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 				return FALSE;
 			}
 
-			rCurve->mKeys[time] = rot_key;
+			rCurve->addKey(rot_key);
 		}
 
 		//---------------------------------------------------------------------
 		// scan position curve header
 		//---------------------------------------------------------------------
-		if (!dp.unpackS32(joint_motion->mPositionCurve.mNumKeys, "num_pos_keys"))
+		S32 num_pos_keys;
+		if (!dp.unpackS32(num_pos_keys, "num_pos_keys"))
 		{
 			llwarns << "can't read number of position keys" << llendl;
 			return FALSE;
 		}
 
 		joint_motion->mPositionCurve.mInterpolationType = IT_LINEAR;
-		if (joint_motion->mPositionCurve.mNumKeys != 0)
+		if (num_pos_keys != 0)
 		{
-			joint_state->setUsage(joint_state->getUsage() | LLJointState::POS );
+			joint_motion->mUsage |= LLJointState::POS;
 		}
 
 		//---------------------------------------------------------------------
@@ -1501,7 +1602,7 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 		//---------------------------------------------------------------------
 		PositionCurve *pCurve = &joint_motion->mPositionCurve;
 		BOOL is_pelvis = joint_motion->mJointName == "mPelvis";
-		for (S32 k = 0; k < joint_motion->mPositionCurve.mNumKeys; k++)
+		for (S32 k = 0; k < num_pos_keys; k++)
 		{
 			U16 time_short;
 			PositionKey pos_key;
@@ -1522,7 +1623,7 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 					return FALSE;
 				}
 
-				pos_key.mTime = U16_to_F32(time_short, 0.f, mJointMotionList->mDuration);
+				pos_key.mTime = U16_to_F32(time_short, 0.f, joint_motion_list->mDuration);
 			}
 
 			BOOL success = TRUE;
@@ -1556,15 +1657,13 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 				return FALSE;
 			}
 			
-			pCurve->mKeys[pos_key.mTime] = pos_key;
+			pCurve->addKey(pos_key);
 
 			if (is_pelvis)
 			{
-				mJointMotionList->mPelvisBBox.addPoint(pos_key.mPosition);
+				joint_motion_list->mPelvisBBox.addPoint(pos_key.mPosition);
 			}
 		}
-
-		joint_motion->mUsage = joint_state->getUsage();
 	}
 
 	//-------------------------------------------------------------------------
@@ -1601,7 +1700,7 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 			}
 			constraintp->mChainLength = (S32) byte;
 
-			if((U32)constraintp->mChainLength > mJointMotionList->getNumJointMotions())
+			if((U32)constraintp->mChainLength > joint_motion_list->getNumJointMotions())
 			{
 				llwarns << "invalid constraint chain length" << llendl;
 				delete constraintp;
@@ -1633,8 +1732,7 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 			}
 
 			bin_data[BIN_DATA_LENGTH-1] = 0; // Ensure null termination
-			str = (char*)bin_data;
-			constraintp->mSourceConstraintVolume = mCharacter->getCollisionVolumeID(str);
+			constraintp->mSourceConstraintVolumeName = (char*)bin_data;
 
 			if (!dp.unpackVector3(constraintp->mSourceConstraintOffset, "source_offset"))
 			{
@@ -1667,7 +1765,7 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 			else
 			{
 				constraintp->mConstraintTargetType = CONSTRAINT_TARGET_TYPE_BODY;
-				constraintp->mTargetConstraintVolume = mCharacter->getCollisionVolumeID(str);
+				constraintp->mTargetConstraintVolumeName = str;
 			}
 
 			if (!dp.unpackVector3(constraintp->mTargetConstraintOffset, "target_offset"))
@@ -1732,51 +1830,81 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 				return FALSE;
 			}
 
-			mJointMotionList->mConstraints.push_front(constraintp);
+			joint_motion_list->mConstraints.push_front(constraintp);
+		}
+	}
 
-			constraintp->mJointStateIndices = new S32[constraintp->mChainLength + 1];
-			
-			LLJoint* joint = mCharacter->findCollisionVolume(constraintp->mSourceConstraintVolume);
-			// get joint to which this collision volume is attached
-			if (!joint)
+	return TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// resolveJointMotionList()
+// Checks a decoded list against the character's skeleton and looks up the
+// constraint volumes and chains.  The result is shared through the
+// keyframe cache by every character, as it always has been.
+//-----------------------------------------------------------------------------
+//static
+BOOL LLKeyframeMotion::resolveJointMotionList(JointMotionList* joint_motion_list, LLCharacter* character)
+{
+	std::vector<LLJoint*> joints;
+	joints.reserve(joint_motion_list->getNumJointMotions());
+	for (U32 i = 0; i < joint_motion_list->getNumJointMotions(); i++)
+	{
+		LLJoint* joint = character->getJoint(joint_motion_list->getJointMotion(i)->mJointName);
+		if (!joint)
+		{
+			llwarns << "joint not found: " << joint_motion_list->getJointMotion(i)->mJointName << llendl;
+			return FALSE;
+		}
+		joints.push_back(joint);
+	}
+
+	for (JointMotionList::constraint_list_t::iterator iter = joint_motion_list->mConstraints.begin();
+		 iter != joint_motion_list->mConstraints.end(); ++iter)
+	{
+		JointConstraintSharedData* constraintp = *iter;
+		constraintp->mSourceConstraintVolume = character->getCollisionVolumeID(constraintp->mSourceConstraintVolumeName);
+		if (constraintp->mConstraintTargetType == CONSTRAINT_TARGET_TYPE_BODY)
+		{
+			constraintp->mTargetConstraintVolume = character->getCollisionVolumeID(constraintp->mTargetConstraintVolumeName);
+		}
+
+		delete [] constraintp->mJointStateIndices;
+		constraintp->mJointStateIndices = new S32[constraintp->mChainLength + 1];
+		
+		LLJoint* joint = character->findCollisionVolume(constraintp->mSourceConstraintVolume);
+		// get joint to which this collision volume is attached
+		if (!joint)
+		{
+			return FALSE;
+		}
+		for (S32 i = 0; i < constraintp->mChainLength + 1; i++)
+		{
+			LLJoint* parent = joint->getParent();
+			if (!parent)
 			{
+				llwarns << "Joint with no parent: " << joint->getName()
+						<< " Emote: " << joint_motion_list->mEmoteName << llendl;
 				return FALSE;
 			}
-			for (S32 i = 0; i < constraintp->mChainLength + 1; i++)
+			joint = parent;
+			constraintp->mJointStateIndices[i] = -1;
+			for (U32 j = 0; j < joints.size(); j++)
 			{
-				LLJoint* parent = joint->getParent();
-				if (!parent)
+				if(joints[j] == joint)
 				{
-					llwarns << "Joint with no parent: " << joint->getName()
-							<< " Emote: " << mJointMotionList->mEmoteName << llendl;
-					return FALSE;
-				}
-				joint = parent;
-				constraintp->mJointStateIndices[i] = -1;
-				for (U32 j = 0; j < mJointMotionList->getNumJointMotions(); j++)
-				{
-					if(getJoint(j) == joint)
-					{
-						constraintp->mJointStateIndices[i] = (S32)j;
-						break;
-					}
-				}
-				if (constraintp->mJointStateIndices[i] < 0 )
-				{
-					llwarns << "No joint index for constraint " << i << llendl;
-					delete constraintp;
-					return FALSE;
+					constraintp->mJointStateIndices[i] = (S32)j;
+					break;
 				}
 			}
+			if (constraintp->mJointStateIndices[i] < 0 )
+			{
+				llwarns << "No joint index for constraint " << i << llendl;
+				return FALSE;
+			}
 		}
 	}
 
-	// *FIX: support cleanup of old keyframe data
-	LLKeyframeDataCache::addKeyframeData(getID(),  mJointMotionList);
-	mAssetStatus = ASSET_LOADED;
-
-	setupPose();
-
 	return TRUE;
 }
 
@@ -1807,14 +1935,13 @@ BOOL LLKeyframeMotion::serialize(LLDataPacker& dp) const
 		success &= dp.packS32(joint_motionp->mPriority, "joint_priority");
 		success &= dp.packS32(joint_motionp->mRotationCurve.mNumKeys, "num_rot_keys");
 
-		for (RotationCurve::key_map_t::iterator iter = joint_motionp->mRotationCurve.mKeys.begin();
-			 iter != joint_motionp->mRotationCurve.mKeys.end(); ++iter)
+		const RotationCurve& rot_curve = joint_motionp->mRotationCurve;
+		for (S32 k = 0; k < rot_curve.mNumKeys; k++)
 		{
-			RotationKey& rot_key = iter->second;
-			U16 time_short = F32_to_U16(rot_key.mTime, 0.f, mJointMotionList->mDuration);
+			U16 time_short = F32_to_U16(rot_curve.mKeyTimes[k], 0.f, mJointMotionList->mDuration);
 			success &= dp.packU16(time_short, "time");
 
-			LLVector3 rot_angles = rot_key.mRotation.packToVector3();
+			LLVector3 rot_angles = rot_curve.mKeyRotations[k].packToVector3();
 			
 			U16 x, y, z;
 			rot_angles.quantize16(-1.f, 1.f, -1.f, 1.f);
@@ -1827,18 +1954,18 @@ BOOL LLKeyframeMotion::serialize(LLDataPacker& dp) const
 		}
 
 		success &= dp.packS32(joint_motionp->mPositionCurve.mNumKeys, "num_pos_keys");
-		for (PositionCurve::key_map_t::iterator iter = joint_motionp->mPositionCurve.mKeys.begin();
-			 iter != joint_motionp->mPositionCurve.mKeys.end(); ++iter)
+		const PositionCurve& pos_curve = joint_motionp->mPositionCurve;
+		for (S32 k = 0; k < pos_curve.mNumKeys; k++)
 		{
-			PositionKey& pos_key = iter->second;
-			U16 time_short = F32_to_U16(pos_key.mTime, 0.f, mJointMotionList->mDuration);
+			U16 time_short = F32_to_U16(pos_curve.mKeyTimes[k], 0.f, mJointMotionList->mDuration);
 			success &= dp.packU16(time_short, "time");
 
 			U16 x, y, z;
-			pos_key.mPosition.quantize16(-LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET, -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
-			x = F32_to_U16(pos_key.mPosition.mV[VX], -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
-			y = F32_to_U16(pos_key.mPosition.mV[VY], -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
-			z = F32_to_U16(pos_key.mPosition.mV[VZ], -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
+			LLVector3 position = pos_curve.mKeyPositions[k];
+			position.quantize16(-LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET, -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
+			x = F32_to_U16(position.mV[VX], -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
+			y = F32_to_U16(position.mV[VY], -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
+			z = F32_to_U16(position.mV[VZ], -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
 			success &= dp.packU16(x, "pos_x");
 			success &= dp.packU16(y, "pos_y");
 			success &= dp.packU16(z, "pos_z");
@@ -2078,31 +2205,15 @@ void LLKeyframeMotion::onLoadComplete(LLVFS *vfs,
 				// asset already loaded
 				return;
 			}
-			LLVFile file(vfs, asset_uuid, type, LLVFile::READ);
-			S32 size = file.getSize();
-			
-			U8* buffer = new U8[size];
-			file.read((U8*)buffer, size);	/*Flawfinder: ignore*/
-			
-			lldebugs << "Loading keyframe data for: " << motionp->getName() << ":" << motionp->getID() << " (" << size << " bytes)" << llendl;
-			
-			LLDataPackerBinaryBuffer dp(buffer, size);
-			if (motionp->deserialize(dp))
-			{
-				motionp->mAssetStatus = ASSET_LOADED;
-			}
-			else
-			{
-				llwarns << "Failed to decode asset for animation " << motionp->getName() << ":" << motionp->getID() << llendl;
-				motionp->mAssetStatus = ASSET_FETCH_FAILED;
-			}
-			
-			delete[] buffer;
+			// decoded on a loader thread, picked up by LLKeyframeLoadQueue::update()
+			motionp->mAssetStatus = ASSET_FETCHED;
+			LLKeyframeLoadQueue::requestLoad(vfs, asset_uuid, character->getID(), FALSE);
 		}
 		else
 		{
 			llwarns << "Failed to load asset for animation " << motionp->getName() << ":" << motionp->getID() << llendl;
 			motionp->mAssetStatus = ASSET_FETCH_FAILED;
+			character->getMotionController().onMotionLoadComplete(asset_uuid);
 		}
 	}
 	else
@@ -2165,7 +2276,7 @@ void LLKeyframeDataCache::removeKeyframeData(const LLUUID& id)
 	if (found_data != sKeyframeDataMap.end())
 	{
 		delete found_data->second;
-		sKeyframeDataMap.erase(found_data);
+		sKeyframeDataMap.erase(id);
 	}
 }
 
@@ -2174,12 +2285,7 @@ void LLKeyframeDataCache::removeKeyframeData(const LLUUID& id)
 //--------------------------------------------------------------------
 LLKeyframeMotion::JointMotionList* LLKeyframeDataCache::getKeyframeData(const LLUUID& id)
 {
-	keyframe_data_map_t::iterator found_data = sKeyframeDataMap.find(id);
-	if (found_data == sKeyframeDataMap.end())
-	{
-		return NULL;
-	}
-	return found_data->second;
+	return sKeyframeDataMap.getIfThere(id, NULL);
 }
 
 //--------------------------------------------------------------------
@@ -2195,10 +2301,241 @@ LLKeyframeDataCache::~LLKeyframeDataCache()
 //-----------------------------------------------------------------------------
 void LLKeyframeDataCache::clear()
 {
-	for_each(sKeyframeDataMap.begin(), sKeyframeDataMap.end(), DeletePairedPointer());
+	std::for_each(sKeyframeDataMap.begin(), sKeyframeDataMap.end(), DeletePairedPointer());
 	sKeyframeDataMap.clear();
 }
 
+//-----------------------------------------------------------------------------
+// LLKeyframeLoadQueue::LoadJob
+//-----------------------------------------------------------------------------
+class LLKeyframeLoadQueue::LoadJob : public LLThreadPool::Job
+{
+public:
+	LoadJob(LLVFS* vfs, const LLUUID& asset_id, const LLUUID& character_id, BOOL fetch_if_missing)
+		: mVFS(vfs),
+		  mAssetID(asset_id),
+		  mCharacterID(character_id),
+		  mFetchIfMissing(fetch_if_missing),
+		  mMissing(FALSE),
+		  mJointMotionList(NULL),
+		  mDecodeTime(0.f),
+		  mNext(NULL)
+	{
+	}
+
+	/*virtual*/ ~LoadJob()
+	{
+		delete mJointMotionList;
+	}
+
+	// WORKER thread
+	/*virtual*/ void run()
+	{
+		LLTimer timer;
+		S32 size = 0;
+		U8* data = LLVFile::readFile(mVFS, mAssetID, LLAssetType::AT_ANIMATION, &size);
+		if (!data)
+		{
+			mMissing = TRUE;
+		}
+		else
+		{
+			LLDataPackerBinaryBuffer dp(data, size);
+			mJointMotionList = new LLKeyframeMotion::JointMotionList;
+			if (!LLKeyframeMotion::decodeJointMotionList(dp, mJointMotionList))
+			{
+				delete mJointMotionList;
+				mJointMotionList = NULL;
+			}
+			delete[] data;
+		}
+		mDecodeTime = timer.getElapsedTimeF32();
+
+		// the main thread may delete this as soon as it is on the list
+		LLKeyframeLoadQueue::pushCompleted(this);
+	}
+
+	LLVFS*				mVFS;
+	LLUUID				mAssetID;
+	LLUUID				mCharacterID;
+	BOOL				mFetchIfMissing;
+
+	// Results, valid once the job is on the completed list
+	BOOL				mMissing;
+	LLKeyframeMotion::JointMotionList* mJointMotionList;	// NULL if the asset didn't decode
+	F32					mDecodeTime;
+
+	LoadJob*			mNext;
+};
+
+//-----------------------------------------------------------------------------
+// LLKeyframeLoadQueue
+//-----------------------------------------------------------------------------
+//static
+void LLKeyframeLoadQueue::initClass(U32 num_threads, bool threaded)
+{
+	if (!sThreadPool)
+	{
+		sThreadPool = new LLThreadPool("Animation Loader", num_threads, threaded);
+	}
+}
+
+//static
+void LLKeyframeLoadQueue::cleanupClass()
+{
+	if (sThreadPool)
+	{
+		sThreadPool->shutdown();
+		delete sThreadPool;
+		sThreadPool = NULL;
+	}
+	LoadJob* job = (LoadJob*)apr_atomic_xchgptr((volatile void**)&sCompleted, NULL);
+	while (job)
+	{
+		LoadJob* next = job->mNext;
+		delete job;
+		job = next;
+	}
+	sNumPending = 0;
+}
+
+//static
+void LLKeyframeLoadQueue::requestLoad(LLVFS* vfs, const LLUUID& asset_id, const LLUUID& character_id, BOOL fetch_if_missing)
+{
+	LoadJob* job = new LoadJob(vfs, asset_id, character_id, fetch_if_missing);
+	sNumPending++;
+	// results are always handed over in update(), even when there is
+	// nothing to decode or no pool to decode on
+	if (LLKeyframeDataCache::getKeyframeData(asset_id))
+	{
+		pushCompleted(job);
+	}
+	else if (!sThreadPool)
+	{
+		job->run();
+	}
+	else
+	{
+		sThreadPool->addJob(job);
+	}
+}
+
+// Treiber stack push; the main thread only ever takes the whole list, so
+// there is no ABA to worry about.
+//static
+void LLKeyframeLoadQueue::pushCompleted(LoadJob* job)
+{
+	void* head;
+	do
+	{
+		head = (void*)sCompleted;
+		job->mNext = (LoadJob*)head;
+	}
+	while (apr_atomic_casptr((volatile void**)&sCompleted, job, head) != head);
+}
+
+//static
+void LLKeyframeLoadQueue::update()
+{
+	if (!sNumPending)
+	{
+		return;
+	}
+	if (sThreadPool)
+	{
+		sThreadPool->reapJobs();
+	}
+
+	LoadJob* completed = (LoadJob*)apr_atomic_xchgptr((volatile void**)&sCompleted, NULL);
+
+	// newest first on the stack, finish them in the order they were asked for
+	LoadJob* job = NULL;
+	while (completed)
+	{
+		LoadJob* next = completed->mNext;
+		completed->mNext = job;
+		job = completed;
+		completed = next;
+	}
+
+	while (job)
+	{
+		LoadJob* next = job->mNext;
+		finishLoad(job);
+		delete job;
+		sNumPending--;
+		job = next;
+	}
+}
+
+//static
+void LLKeyframeLoadQueue::finishLoad(LoadJob* job)
+{
+	const LLUUID& asset_id = job->mAssetID;
+	if (job->mJointMotionList)
+	{
+		sDecodeTimeStat.addValue(job->mDecodeTime * 1000.f);
+	}
+
+	LLCharacter* character = NULL;
+	for (std::vector<LLCharacter*>::iterator iter = LLCharacter::sInstances.begin();
+		 iter != LLCharacter::sInstances.end(); ++iter)
+	{
+		if ((*iter)->getID() == job->mCharacterID)
+		{
+			character = *iter;
+			break;
+		}
+	}
+	if (!character)
+	{
+		// gone while we were loading
+		return;
+	}
+	LLKeyframeMotion* motionp = (LLKeyframeMotion*) character->findMotion(asset_id);
+
+	if (!LLKeyframeDataCache::getKeyframeData(asset_id))
+	{
+		if (job->mMissing && job->mFetchIfMissing)
+		{
+			// not in the static vfs, the controller hears back once the
+			// asset server has answered
+			if (motionp && motionp->mAssetStatus == LLKeyframeMotion::ASSET_FETCHED)
+			{
+				motionp->requestAsset();
+			}
+			return;
+		}
+
+		if (job->mJointMotionList
+			&& LLKeyframeMotion::resolveJointMotionList(job->mJointMotionList, character))
+		{
+			LLKeyframeDataCache::addKeyframeData(asset_id, job->mJointMotionList);
+			job->mJointMotionList = NULL;
+			sNumLoaded++;
+		}
+		else
+		{
+			llwarns << "Failed to decode asset for animation " << asset_id << llendl;
+			if (motionp)
+			{
+				motionp->mAssetStatus = LLKeyframeMotion::ASSET_FETCH_FAILED;
+			}
+			sNumFailed++;
+		}
+	}
+
+	character->getMotionController().onMotionLoadComplete(asset_id);
+}
+
+//static
+std::string LLKeyframeLoadQueue::getDebugString()
+{
+	return llformat("Animations: %d loading, %u loaded, %u failed, %.1f ms latency, %.2f ms decode",
+					sNumPending, sNumLoaded, sNumFailed,
+					sLoadLatencyStat.getMean(), sDecodeTimeStat.getMean());
+}
+
 //-----------------------------------------------------------------------------
 // JointConstraint()
 //-----------------------------------------------------------------------------
@@ -38,6 +38,7 @@
 //-----------------------------------------------------------------------------
 
 #include <string>
+#include <vector>
 
 #include "llassetstorage.h"
 #include "llbboxlocal.h"
@@ -49,8 +50,13 @@
 #include "v3math.h"
 #include "llapr.h"
 #include "llbvhconsts.h"
+#include "llstat.h"
+#include "lltimer.h"
+#include "lluuidflatmap.h"
 
 class LLKeyframeDataCache;
+class LLKeyframeLoadQueue;
+class LLThreadPool;
 class LLVFS;
 class LLDataPacker;
 
@@ -67,6 +73,7 @@ class LLKeyframeMotion :
 	public LLMotion
 {
 	friend class LLKeyframeDataCache;
+	friend class LLKeyframeLoadQueue;
 public:
 	// Constructor
 	LLKeyframeMotion(const LLUUID &id);
@@ -221,6 +228,8 @@ protected:
 		{ };
 		~JointConstraintSharedData() { delete [] mJointStateIndices; }
 
+		std::string				mSourceConstraintVolumeName;	// as decoded, resolved to the ids below
+		std::string				mTargetConstraintVolumeName;
 		S32						mSourceConstraintVolume;
 		LLVector3				mSourceConstraintOffset;
 		S32						mTargetConstraintVolume;
@@ -318,21 +327,42 @@ public:
 		LLVector3	mPosition;
 	};
 
+	//-------------------------------------------------------------------------
+	// KeyCursor
+	// Where each curve of a joint motion was last sampled.  Keyframe data is
+	// shared by every character playing the animation, so the cursors live
+	// with the playback state in each LLKeyframeMotion.
+	//-------------------------------------------------------------------------
+	class KeyCursor
+	{
+	public:
+		KeyCursor() : mScale(0), mRotation(0), mPosition(0) {}
+
+		S32			mScale;
+		S32			mRotation;
+		S32			mPosition;
+	};
+
 	//-------------------------------------------------------------------------
 	// ScaleCurve
+	// Keys are stored sorted by time, with the times in their own array so
+	// the search only touches them.
 	//-------------------------------------------------------------------------
 	class ScaleCurve
 	{
 	public:
 		ScaleCurve();
 		~ScaleCurve();
-		LLVector3 getValue(F32 time, F32 duration);
-		LLVector3 interp(F32 u, ScaleKey& before, ScaleKey& after);
+		LLVector3 getValue(F32 time, F32 duration, S32& cursor) const;
+		LLVector3 getValue(F32 time, F32 duration) const { S32 cursor = 0; return getValue(time, duration, cursor); }
+		LLVector3 interp(F32 u, const LLVector3& before, const LLVector3& after) const;
+		void addKey(const ScaleKey& key);
+		U32 getMemoryUsage() const;
 
 		InterpolationType	mInterpolationType;
 		S32					mNumKeys;
-		typedef std::map<F32, ScaleKey> key_map_t;
-		key_map_t 			mKeys;
+		std::vector<F32>	mKeyTimes;
+		std::vector<LLVector3> mKeyScales;
 		ScaleKey			mLoopInKey;
 		ScaleKey			mLoopOutKey;
 	};
@@ -345,13 +375,16 @@ public:
 	public:
 		RotationCurve();
 		~RotationCurve();
-		LLQuaternion getValue(F32 time, F32 duration);
-		LLQuaternion interp(F32 u, RotationKey& before, RotationKey& after);
+		LLQuaternion getValue(F32 time, F32 duration, S32& cursor) const;
+		LLQuaternion getValue(F32 time, F32 duration) const { S32 cursor = 0; return getValue(time, duration, cursor); }
+		LLQuaternion interp(F32 u, const LLQuaternion& before, const LLQuaternion& after) const;
+		void addKey(const RotationKey& key);
+		U32 getMemoryUsage() const;
 
 		InterpolationType	mInterpolationType;
 		S32					mNumKeys;
-		typedef std::map<F32, RotationKey> key_map_t;
-		key_map_t		mKeys;
+		std::vector<F32>	mKeyTimes;
+		std::vector<LLQuaternion> mKeyRotations;
 		RotationKey		mLoopInKey;
 		RotationKey		mLoopOutKey;
 	};
@@ -364,13 +397,16 @@ public:
 	public:
 		PositionCurve();
 		~PositionCurve();
-		LLVector3 getValue(F32 time, F32 duration);
-		LLVector3 interp(F32 u, PositionKey& before, PositionKey& after);
+		LLVector3 getValue(F32 time, F32 duration, S32& cursor) const;
+		LLVector3 getValue(F32 time, F32 duration) const { S32 cursor = 0; return getValue(time, duration, cursor); }
+		LLVector3 interp(F32 u, const LLVector3& before, const LLVector3& after) const;
+		void addKey(const PositionKey& key);
+		U32 getMemoryUsage() const;
 
 		InterpolationType	mInterpolationType;
 		S32					mNumKeys;
-		typedef std::map<F32, PositionKey> key_map_t;
-		key_map_t		mKeys;
+		std::vector<F32>	mKeyTimes;
+		std::vector<LLVector3> mKeyPositions;
 		PositionKey		mLoopInKey;
 		PositionKey		mLoopOutKey;
 	};
@@ -388,7 +424,7 @@ public:
 		U32				mUsage;
 		LLJoint::JointPriority	mPriority;
 
-		void update(LLJointState* joint_state, F32 time, F32 duration);
+		void update(LLJointState* joint_state, F32 time, F32 duration, KeyCursor& cursor) const;
 	};
 	
 	//-------------------------------------------------------------------------
@@ -422,6 +458,11 @@ public:
 		U32 getNumJointMotions() const { return mJointMotionArray.size(); }
 	};
 
+	// deserialize() in two steps, so the first can run on a loader thread
+	static BOOL decodeJointMotionList(LLDataPacker& dp, JointMotionList* joint_motion_list);
+	static BOOL resolveJointMotionList(JointMotionList* joint_motion_list, LLCharacter* character);
+	void bindJointMotionList(JointMotionList* joint_motion_list);
+	void requestAsset();
 
 protected:
 	static LLVFS*				sVFS;
@@ -431,6 +472,7 @@ protected:
 	//-------------------------------------------------------------------------
 	JointMotionList*				mJointMotionList;
 	std::vector<LLPointer<LLJointState> > mJointStates;
+	std::vector<KeyCursor>			mKeyCursors;
 	LLJoint*						mPelvisp;
 	LLCharacter*					mCharacter;
 	typedef std::list<JointConstraint*>	constraint_list_t;
@@ -439,6 +481,7 @@ protected:
 	F32								mLastUpdateTime;
 	F32								mLastLoopedTime;
 	AssetStatus						mAssetStatus;
+	LLTimer							mLoadTimer;		// since the cache miss that started loading
 };
 
 class LLKeyframeDataCache
@@ -448,7 +491,7 @@ public:
 	LLKeyframeDataCache(){};
 	~LLKeyframeDataCache();
 
-	typedef std::map<LLUUID, class LLKeyframeMotion::JointMotionList*> keyframe_data_map_t; 
+	typedef LLUUIDFlatMap<class LLKeyframeMotion::JointMotionList*> keyframe_data_map_t; 
 	static keyframe_data_map_t sKeyframeDataMap;
 
 	static void addKeyframeData(const LLUUID& id, LLKeyframeMotion::JointMotionList*);
@@ -461,6 +504,48 @@ public:
 	static void clear();
 };
 
+//-----------------------------------------------------------------------------
+// LLKeyframeLoadQueue
+// Reads keyframe assets out of the vfs and decodes them on worker threads.
+// Workers push finished loads onto a lock free list which the main thread
+// drains once per frame: each load is resolved against its character, added
+// to LLKeyframeDataCache, and the character's motion controller is told the
+// motion id has news.
+//-----------------------------------------------------------------------------
+class LLKeyframeLoadQueue
+{
+public:
+	static void initClass(U32 num_threads, bool threaded);
+	static void cleanupClass();
+
+	// MAIN thread.  If the vfs has nothing for asset_id the asset is
+	// requested from the asset server when fetch_if_missing is set, and
+	// the load fails otherwise.
+	static void requestLoad(LLVFS* vfs, const LLUUID& asset_id, const LLUUID& character_id, BOOL fetch_if_missing);
+
+	// MAIN thread, once per frame
+	static void update();
+
+	static S32 getNumPending()		{ return sNumPending; }
+	static std::string getDebugString();
+
+	// Stats
+	static U32 sNumLoaded;
+	static U32 sNumFailed;
+	static LLStat sLoadLatencyStat;	// ms from the cache miss to the motion being bound
+	static LLStat sDecodeTimeStat;	// ms reading and decoding on a loader thread
+
+private:
+	class LoadJob;
+
+	static void pushCompleted(LoadJob* job); // any thread
+	static void finishLoad(LoadJob* job);
+
+	static LLThreadPool* sThreadPool;
+	static LoadJob* volatile sCompleted;
+	static S32 sNumPending;
+};
+
 #endif // LL_LLKEYFRAMEMOTION_H
 
 
@@ -35,6 +35,8 @@
 //-----------------------------------------------------------------------------
 #include "linden_common.h"
 
+#include <algorithm>
+
 #include "llmemtype.h"
 
 #include "llmotioncontroller.h"
@@ -84,13 +86,7 @@ LLMotionRegistry::~LLMotionRegistry()
 BOOL LLMotionRegistry::registerMotion( const LLUUID& id, LLMotionConstructor constructor )
 {
 	//	llinfos << "Registering motion: " << name << llendl;
-	if (!is_in_map(mMotionTable, id))
-	{
-		mMotionTable[id] = constructor;
-		return TRUE;
-	}
-	
-	return FALSE;
+	return mMotionTable.insert(id, constructor) ? TRUE : FALSE;
 }
 
 //-----------------------------------------------------------------------------
@@ -106,7 +102,7 @@ void LLMotionRegistry::markBad( const LLUUID& id )
 //-----------------------------------------------------------------------------
 LLMotion *LLMotionRegistry::createMotion( const LLUUID &id )
 {
-	LLMotionConstructor constructor = get_if_there(mMotionTable, id, LLMotionConstructor(NULL));
+	LLMotionConstructor constructor = mMotionTable.getIfThere(id, LLMotionConstructor(NULL));
 	LLMotion* motion = NULL;
 
 	if ( constructor == NULL )
@@ -172,10 +168,11 @@ void LLMotionController::incMotionCounts(S32& num_motions, S32& num_loading_moti
 void LLMotionController::deleteAllMotions()
 {
 	mLoadingMotions.clear();
+	mCompletedLoads.clear();
 	mLoadedMotions.clear();
 	mActiveMotions.clear();
 
-	for_each(mAllMotions.begin(), mAllMotions.end(), DeletePairedPointer());
+	std::for_each(mAllMotions.begin(), mAllMotions.end(), DeletePairedPointer());
 	mAllMotions.clear();
 }
 
@@ -752,12 +749,27 @@ void LLMotionController::updateMotionsByType(LLMotion::LLMotionBlendType anim_ty
 	}
 }
 
+//-----------------------------------------------------------------------------
+// onMotionLoadComplete()
+//-----------------------------------------------------------------------------
+void LLMotionController::onMotionLoadComplete(const LLUUID& id)
+{
+	mCompletedLoads.push_back(id);
+}
+
 //-----------------------------------------------------------------------------
 // updateLoadingMotions()
 //-----------------------------------------------------------------------------
 void LLMotionController::updateLoadingMotions()
 {
-	// query pending motions for completion
+	if (mCompletedLoads.empty())
+	{
+		return;
+	}
+	std::vector<LLUUID> completed_loads;
+	completed_loads.swap(mCompletedLoads);
+
+	// query pending motions we've heard about for completion
 	for (motion_set_t::iterator iter = mLoadingMotions.begin();
 		 iter != mLoadingMotions.end(); )
 	{
@@ -767,6 +779,10 @@ void LLMotionController::updateLoadingMotions()
 		{
 			continue; // maybe shouldn't happen but i've seen it -MG
 		}
+		if (std::find(completed_loads.begin(), completed_loads.end(), motionp->getID()) == completed_loads.end())
+		{
+			continue;
+		}
 		LLMotion::LLMotionInitStatus status = motionp->onInitialize(mCharacter);
 		if (status == LLMotion::STATUS_SUCCESS)
 		{
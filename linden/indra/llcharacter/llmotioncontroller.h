@@ -39,7 +39,9 @@
 #include <string>
 #include <map>
 #include <deque>
+#include <vector>
 
+#include "lluuidflatmap.h"
 #include "lluuidhashmap.h"
 #include "llmotion.h"
 #include "llpose.h"
@@ -80,7 +82,7 @@ public:
 
 
 protected:
-	typedef std::map<LLUUID, LLMotionConstructor> motion_map_t;
+	typedef LLUUIDFlatMap<LLMotionConstructor> motion_map_t;
 	motion_map_t mMotionTable;
 };
 
@@ -129,6 +131,11 @@ public:
 	// returns true if successful
 	BOOL stopMotionLocally( const LLUUID &id, BOOL stop_immediate );
 
+	// Motions that return STATUS_HOLD from onInitialize() are not polled;
+	// whoever loads them calls this once there is something new, and
+	// onInitialize() is asked again on the next update.
+	void onMotionLoadComplete(const LLUUID& id);
+
 	// Move motions from loading to loaded
 	void updateLoadingMotions();
 	
@@ -202,10 +209,11 @@ protected:
 //	Once an animations is loaded, it will be initialized and put on the mLoadedMotions list.
 //	Any animation that is currently playing also sits in the mActiveMotions list.
 
-	typedef std::map<LLUUID, LLMotion*> motion_map_t;
+	typedef LLUUIDFlatMap<LLMotion*> motion_map_t;
 	motion_map_t	mAllMotions;
 
 	motion_set_t		mLoadingMotions;
+	std::vector<LLUUID>	mCompletedLoads;	// ids of loading motions with news
 	motion_set_t		mLoadedMotions;
 	motion_list_t		mActiveMotions;
 	motion_set_t		mDeprecatedMotions;
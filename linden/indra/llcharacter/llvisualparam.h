@@ -54,6 +54,16 @@ enum EVisualParamGroup
 	NUM_VISUAL_PARAM_GROUPS
 };
 
+// Bits naming the avatar update stages a visual param feeds.  Callers
+// collect these as params change so only the affected stages are redone.
+enum EVisualParamStage
+{
+	VISUAL_PARAM_STAGE_MORPH	= 0x1,	// deformed mesh vertices
+	VISUAL_PARAM_STAGE_SKELETON	= 0x2,	// joint scales and body size
+	VISUAL_PARAM_STAGE_TEXTURE	= 0x4,	// composited texture layers
+	VISUAL_PARAM_STAGE_ALL		= 0x7
+};
+
 const S32 MAX_TRANSMITTED_VISUAL_PARAMS = 255;
 
 //-----------------------------------------------------------------------------
@@ -110,6 +120,8 @@ public:
 	virtual void			setAnimationTarget( F32 target_value, BOOL set_by_user );
 	virtual void			animate(F32 delta, BOOL set_by_user);
 	virtual void			stopAnimating(BOOL set_by_user);
+	//  Stages dirtied by apply(); params that act elsewhere return 0
+	virtual U32				getApplyStages() const { return VISUAL_PARAM_STAGE_ALL; }
 
 	// Interface methods
 	S32						getID() 			{ return mID; }
@@ -0,0 +1,285 @@
+/** 
+ * @file llbucketqueue.h
+ * @brief Priority queue with constant time priority updates.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LLBUCKETQUEUE_H
+#define LL_LLBUCKETQUEUE_H
+
+#include <algorithm>
+#include <vector>
+
+// LLBucketQueue keeps elements ordered by a non-negative F32 priority in
+// logarithmic buckets instead of a sorted tree.  The bucket is taken from
+// the top bits of the float (exponent plus three bits of mantissa), so each
+// bucket spans 1/8 of an octave and no two priorities within about 9% of
+// each other are guaranteed to be ordered.  Negative priorities all land
+// in the lowest bucket.
+//
+// Insert, erase and priority updates are O(1) with no allocation once the
+// buckets have grown.  Iteration visits buckets from highest priority to
+// lowest, skipping empty ones through a bitmap; order within a bucket is
+// arbitrary.  Use getTop() where the exact order of the highest entries
+// matters.  Any change to the queue invalidates iterators.
+//
+// Elements track their own position: HandleOf is a functor returning a
+// reference to the LLBucketQueueHandle stored in an element.
+
+struct LLBucketQueueHandle
+{
+	enum { NOT_QUEUED = 0xFFFFFFFF };
+
+	LLBucketQueueHandle() : mBucket(NOT_QUEUED), mIndex(0) { }
+
+	bool isQueued() const				{ return mBucket != NOT_QUEUED; }
+
+	U32 mBucket;
+	U32 mIndex;
+};
+
+template <class T, class HandleOf>
+class LLBucketQueue
+{
+public:
+	enum
+	{
+		BUCKET_SHIFT = 20,						// drop all but 3 mantissa bits
+		NUM_BUCKETS = 0x80000000 >> BUCKET_SHIFT,	// every non-negative float, inf and nan included
+		NUM_WORDS = NUM_BUCKETS / 32
+	};
+
+	typedef std::vector<T> bucket_t;
+
+	class iterator
+	{
+	public:
+		iterator() : mQueue(NULL), mBucket(0), mIndex(0) { }
+
+		const T& operator*() const				{ return mQueue->mBuckets[mBucket][mIndex]; }
+		const T* operator->() const				{ return &(operator*()); }
+
+		iterator& operator++()
+		{
+			if (++mIndex >= mQueue->mBuckets[mBucket].size())
+			{
+				mIndex = 0;
+				mBucket = mQueue->nextBucket(mBucket);
+			}
+			return *this;
+		}
+
+		iterator operator++(int)
+		{
+			iterator tmp = *this;
+			++(*this);
+			return tmp;
+		}
+
+		bool operator==(const iterator& rhs) const	{ return mBucket == rhs.mBucket && mIndex == rhs.mIndex; }
+		bool operator!=(const iterator& rhs) const	{ return !(*this == rhs); }
+
+	private:
+		friend class LLBucketQueue;
+		iterator(const LLBucketQueue* queue, U32 bucket, U32 index)
+			: mQueue(queue), mBucket(bucket), mIndex(index) { }
+
+		const LLBucketQueue* mQueue;
+		U32 mBucket;
+		U32 mIndex;
+	};
+
+	LLBucketQueue()
+		: mBuckets(NUM_BUCKETS), mSize(0)
+	{
+		memset(mOccupied, 0, sizeof(mOccupied));
+	}
+
+	U32 size() const							{ return mSize; }
+	bool empty() const							{ return mSize == 0; }
+
+	static U32 bucketFor(F32 priority)
+	{
+		if (!(priority > 0.f))
+		{
+			return 0;
+		}
+		union { F32 f; U32 u; } bits;
+		bits.f = priority;
+		return bits.u >> BUCKET_SHIFT;
+	}
+
+	// Returns false if item is already queued.
+	bool insert(const T& item, F32 priority)
+	{
+		LLBucketQueueHandle& handle = HandleOf()(item);
+		if (handle.isQueued())
+		{
+			return false;
+		}
+		push(item, handle, bucketFor(priority));
+		mSize++;
+		return true;
+	}
+
+	// Returns false if item is not queued.
+	bool erase(const T& item)
+	{
+		LLBucketQueueHandle& handle = HandleOf()(item);
+		if (!handle.isQueued())
+		{
+			return false;
+		}
+		// reset first, the queue may hold the last reference to item
+		LLBucketQueueHandle pos = handle;
+		handle = LLBucketQueueHandle();
+		remove(pos);
+		mSize--;
+		return true;
+	}
+
+	// Move a queued item to the bucket for priority.  Free when the bucket
+	// does not change.
+	void update(const T& item, F32 priority)
+	{
+		LLBucketQueueHandle& handle = HandleOf()(item);
+		llassert(handle.isQueued());
+		U32 bucket = bucketFor(priority);
+		if (bucket != handle.mBucket)
+		{
+			T keep = item; // item may be a reference into the old bucket
+			remove(handle);
+			push(keep, handle, bucket);
+		}
+	}
+
+	void clear()
+	{
+		for (U32 w = 0; w < NUM_WORDS; w++)
+		{
+			while (mOccupied[w])
+			{
+				U32 bucket = w * 32 + highestBit(mOccupied[w]);
+				bucket_t& items = mBuckets[bucket];
+				for (typename bucket_t::iterator iter = items.begin(); iter != items.end(); ++iter)
+				{
+					HandleOf()(*iter) = LLBucketQueueHandle();
+				}
+				items.clear();
+				mOccupied[w] &= ~(1U << (bucket & 31));
+			}
+		}
+		mSize = 0;
+	}
+
+	// Append the count highest priority items to results, ordered by comp.
+	// Whole buckets are gathered before sorting, so the result is what a
+	// container fully sorted by comp would return, provided comp orders by
+	// the same priority the items were queued with.
+	template <class Compare>
+	void getTop(U32 count, std::vector<T>& results, const Compare& comp) const
+	{
+		U32 first = results.size();
+		U32 wanted = llmin(count, mSize);
+		for (U32 bucket = nextBucket(NUM_BUCKETS);
+			 bucket != NUM_BUCKETS && results.size() - first < wanted;
+			 bucket = nextBucket(bucket))
+		{
+			results.insert(results.end(), mBuckets[bucket].begin(), mBuckets[bucket].end());
+		}
+		std::partial_sort(results.begin() + first, results.begin() + first + wanted, results.end(), comp);
+		results.resize(first + wanted);
+	}
+
+	iterator begin() const						{ return iterator(this, nextBucket(NUM_BUCKETS), 0); }
+	iterator end() const						{ return iterator(this, NUM_BUCKETS, 0); }
+
+private:
+	void push(const T& item, LLBucketQueueHandle& handle, U32 bucket)
+	{
+		bucket_t& items = mBuckets[bucket];
+		handle.mBucket = bucket;
+		handle.mIndex = items.size();
+		items.push_back(item);
+		mOccupied[bucket >> 5] |= 1U << (bucket & 31);
+	}
+
+	// swap the last element of the bucket into the hole
+	void remove(const LLBucketQueueHandle& handle)
+	{
+		U32 bucket = handle.mBucket;
+		U32 index = handle.mIndex;
+		bucket_t& items = mBuckets[bucket];
+		if (index + 1 != items.size())
+		{
+			items[index] = items.back();
+			HandleOf()(items[index]).mIndex = index;
+		}
+		items.pop_back();
+		if (items.empty())
+		{
+			mOccupied[bucket >> 5] &= ~(1U << (bucket & 31));
+		}
+	}
+
+	// Highest occupied bucket below bucket, or NUM_BUCKETS when there is none.
+	U32 nextBucket(U32 bucket) const
+	{
+		while (bucket > 0)
+		{
+			bucket--;
+			U32 w = bucket >> 5;
+			U32 word = mOccupied[w] & (0xFFFFFFFF >> (31 - (bucket & 31)));
+			if (word)
+			{
+				return w * 32 + highestBit(word);
+			}
+			bucket = w * 32;
+		}
+		return NUM_BUCKETS;
+	}
+
+	static U32 highestBit(U32 word)
+	{
+		U32 bit = 0;
+		if (word & 0xFFFF0000) { word >>= 16; bit += 16; }
+		if (word & 0xFF00) { word >>= 8; bit += 8; }
+		if (word & 0xF0) { word >>= 4; bit += 4; }
+		if (word & 0xC) { word >>= 2; bit += 2; }
+		if (word & 0x2) { bit += 1; }
+		return bit;
+	}
+
+	std::vector<bucket_t> mBuckets;
+	U32 mOccupied[NUM_WORDS];
+	U32 mSize;
+};
+
+#endif // LL_LLBUCKETQUEUE_H
@@ -0,0 +1,120 @@
+/** 
+ * @file llradixsort.h
+ * @brief Stable LSD radix sort over 64-bit keys.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLRADIXSORT_H
+#define LL_LLRADIXSORT_H
+
+#include <vector>
+#include <utility>
+#include <string.h>
+
+#include "stdtypes.h"
+
+// Sorts (key, value) pairs by ascending key, one byte per pass starting
+// with the least significant.  The sort is stable, so values with equal
+// keys keep the order they were pushed in.  A pass is skipped when every
+// key has the same value in that byte, which makes sparse keys (only a
+// few bits in use) nearly as cheap as a single histogram sweep.
+//
+// scratch is working storage; keep it around between calls to avoid
+// reallocating every frame.
+
+template <class T>
+void ll_radix_sort(std::vector<std::pair<U64, T> >& items, std::vector<std::pair<U64, T> >& scratch)
+{
+	typedef std::pair<U64, T> item_t;
+
+	const U32 count = items.size();
+	if (count < 2)
+	{
+		return;
+	}
+
+	if (scratch.size() < count)
+	{
+		scratch.resize(count);
+	}
+
+	// all eight histograms in one sweep
+	U32 histogram[8][256];
+	memset(histogram, 0, sizeof(histogram));
+	for (U32 i = 0; i < count; i++)
+	{
+		U64 key = items[i].first;
+		for (U32 b = 0; b < 8; b++)
+		{
+			histogram[b][(key >> (b * 8)) & 0xFF]++;
+		}
+	}
+
+	item_t* src = &items[0];
+	item_t* dst = &scratch[0];
+
+	for (U32 b = 0; b < 8; b++)
+	{
+		U32* bucket = histogram[b];
+		U32 shift = b * 8;
+
+		if (bucket[(src[0].first >> shift) & 0xFF] == count)
+		{
+			// every key agrees in this byte
+			continue;
+		}
+
+		U32 offset = 0;
+		for (U32 i = 0; i < 256; i++)
+		{
+			U32 n = bucket[i];
+			bucket[i] = offset;
+			offset += n;
+		}
+
+		for (U32 i = 0; i < count; i++)
+		{
+			dst[bucket[(src[i].first >> shift) & 0xFF]++] = src[i];
+		}
+
+		item_t* tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+
+	if (src != &items[0])
+	{
+		for (U32 i = 0; i < count; i++)
+		{
+			items[i] = src[i];
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,205 @@
+/** 
+ * @file llthreadpool.cpp
+ * @brief A small pool of LLQueuedThreads for fork/join style work.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llthreadpool.h"
+#include "llstl.h"
+
+//============================================================================
+
+LLThreadPool::Job::~Job()
+{
+}
+
+//----------------------------------------------------------------------------
+
+LLThreadPool::JobRequest::JobRequest(LLQueuedThread::handle_t handle, U32 priority, Job* job)
+	: LLQueuedThread::QueuedRequest(handle, priority),
+	  mJob(job)
+{
+}
+
+LLThreadPool::JobRequest::~JobRequest()
+{
+}
+
+// WORKER thread
+bool LLThreadPool::JobRequest::processRequest()
+{
+	mJob->run();
+	return true;
+}
+
+//----------------------------------------------------------------------------
+
+LLThreadPool::JobThread::JobThread(const std::string& name, bool threaded)
+	: LLQueuedThread(name, threaded)
+{
+}
+
+// MAIN thread
+LLQueuedThread::handle_t LLThreadPool::JobThread::addJob(Job* job, U32 priority)
+{
+	if (isQuitting())
+	{
+		return nullHandle();
+	}
+	handle_t handle = generateHandle();
+	addRequest(new JobRequest(handle, priority, job));
+	return handle;
+}
+
+//----------------------------------------------------------------------------
+
+// MAIN thread
+LLThreadPool::LLThreadPool(const std::string& name, U32 num_threads, bool threaded)
+	: mNextThread(0),
+	  mThreaded(threaded && num_threads > 0)
+{
+	if (mThreaded)
+	{
+		for (U32 i = 0; i < num_threads; i++)
+		{
+			mThreads.push_back(new JobThread(llformat("%s %d", name.c_str(), i), true));
+		}
+	}
+}
+
+// MAIN thread
+LLThreadPool::~LLThreadPool()
+{
+	shutdown();
+	for_each(mThreads.begin(), mThreads.end(), DeletePointer());
+	mThreads.clear();
+}
+
+// MAIN thread
+void LLThreadPool::shutdown()
+{
+	waitForJobs();
+	for (U32 i = 0; i < mThreads.size(); i++)
+	{
+		mThreads[i]->shutdown();
+	}
+}
+
+// MAIN thread
+void LLThreadPool::addJob(Job* job, U32 priority)
+{
+	if (mThreads.empty())
+	{
+		mInlineJobs.push_back(job);
+		return;
+	}
+
+	U32 index = mNextThread;
+	mNextThread = (mNextThread + 1) % mThreads.size();
+
+	LLQueuedThread::handle_t handle = mThreads[index]->addJob(job, priority);
+	if (handle == LLQueuedThread::nullHandle())
+	{
+		mInlineJobs.push_back(job);
+	}
+	else
+	{
+		mPending.push_back(pending_job_t(index, handle, job));
+	}
+}
+
+// MAIN thread
+void LLThreadPool::waitForJobs()
+{
+	// anything the workers could not take runs here while they are busy
+	for (U32 i = 0; i < mInlineJobs.size(); i++)
+	{
+		mInlineJobs[i]->run();
+	}
+	mInlineJobs.clear();
+
+	for (U32 i = 0; i < mPending.size(); i++)
+	{
+		mThreads[mPending[i].mThread]->waitForResult(mPending[i].mHandle, true);
+	}
+	mPending.clear();
+}
+
+// MAIN thread
+void LLThreadPool::waitForJob(Job* job)
+{
+	std::vector<Job*>::iterator inline_iter = std::find(mInlineJobs.begin(), mInlineJobs.end(), job);
+	if (inline_iter != mInlineJobs.end())
+	{
+		mInlineJobs.erase(inline_iter);
+		job->run();
+		return;
+	}
+
+	for (std::vector<pending_job_t>::iterator iter = mPending.begin(); iter != mPending.end(); ++iter)
+	{
+		if (iter->mJob == job)
+		{
+			mThreads[iter->mThread]->waitForResult(iter->mHandle, true);
+			mPending.erase(iter);
+			return;
+		}
+	}
+}
+
+// MAIN thread
+S32 LLThreadPool::reapJobs()
+{
+	for (U32 i = 0; i < mInlineJobs.size(); i++)
+	{
+		mInlineJobs[i]->run();
+	}
+	mInlineJobs.clear();
+
+	std::vector<pending_job_t>::iterator iter = mPending.begin();
+	while (iter != mPending.end())
+	{
+		JobThread* thread = mThreads[iter->mThread];
+		LLQueuedThread::status_t status = thread->getRequestStatus(iter->mHandle);
+		if (status == LLQueuedThread::STATUS_COMPLETE ||
+			status == LLQueuedThread::STATUS_ABORTED ||
+			status == LLQueuedThread::STATUS_EXPIRED)
+		{
+			thread->completeRequest(iter->mHandle);
+			iter = mPending.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+	return (S32) mPending.size();
+}
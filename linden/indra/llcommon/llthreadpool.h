@@ -0,0 +1,122 @@
+/** 
+ * @file llthreadpool.h
+ * @brief A small pool of LLQueuedThreads for fork/join style work.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTHREADPOOL_H
+#define LL_LLTHREADPOOL_H
+
+#include <string>
+#include <vector>
+
+#include "llqueuedthread.h"
+
+//============================================================================
+// LLThreadPool spreads short, independent jobs over a fixed number of
+// LLQueuedThreads and lets the caller block until all of them are done.
+// Jobs are handed out round robin.  The pool does not take ownership of
+// jobs; they must stay alive until waitForJobs() (or waitForJob() for that
+// job) returns.
+//
+// With zero threads (or threaded = false) jobs run on the calling thread
+// inside waitForJobs(), which keeps single core machines and debugging
+// sessions on the old code path.
+
+class LLThreadPool
+{
+public:
+	class Job
+	{
+	public:
+		virtual ~Job();
+		virtual void run() = 0; // called from a worker thread
+	};
+
+	LLThreadPool(const std::string& name, U32 num_threads, bool threaded = true);
+	~LLThreadPool();
+
+	void shutdown();
+
+	// MAIN thread
+	void addJob(Job* job, U32 priority = LLQueuedThread::PRIORITY_NORMAL);
+	void waitForJobs();
+	// Blocks until job has run, leaving every other job queued.  Lets one
+	// client wait for its own jobs while others still have work in flight.
+	void waitForJob(Job* job);
+	// Forgets jobs that have finished without waiting for the rest; returns
+	// how many are still queued or running.  Jobs that want to be polled
+	// this way need to flag their own completion at the end of run().
+	S32 reapJobs();
+
+	S32 getPending() const	{ return (S32) mPending.size(); }
+	U32 getThreadCount() const	{ return mThreads.size(); }
+	bool getThreaded() const	{ return mThreaded; }
+
+private:
+	class JobRequest : public LLQueuedThread::QueuedRequest
+	{
+	protected:
+		virtual ~JobRequest(); // use deleteRequest()
+
+	public:
+		JobRequest(LLQueuedThread::handle_t handle, U32 priority, Job* job);
+
+		/*virtual*/ bool processRequest();
+
+	private:
+		Job* mJob;
+	};
+
+	class JobThread : public LLQueuedThread
+	{
+	public:
+		JobThread(const std::string& name, bool threaded);
+
+		handle_t addJob(Job* job, U32 priority);
+	};
+
+	struct pending_job_t
+	{
+		pending_job_t(U32 thread, LLQueuedThread::handle_t handle, Job* job)
+			: mThread(thread), mHandle(handle), mJob(job) { }
+
+		U32 mThread;
+		LLQueuedThread::handle_t mHandle;
+		Job* mJob;
+	};
+
+	std::vector<JobThread*> mThreads;
+	std::vector<pending_job_t> mPending;
+	std::vector<Job*> mInlineJobs;
+	U32 mNextThread;
+	bool mThreaded;
+};
+
+#endif // LL_LLTHREADPOOL_H
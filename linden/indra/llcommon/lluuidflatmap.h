@@ -0,0 +1,265 @@
+/** 
+ * @file lluuidflatmap.h
+ * @brief Open addressed hash map keyed by LLUUID.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LLUUIDFLATMAP_H
+#define LL_LLUUIDFLATMAP_H
+
+#include <algorithm>
+#include <vector>
+#include "lluuid.h"
+
+// LLUUIDFlatMap is an open addressed hash map keyed by LLUUID, meant for
+// small values (pointers, function pointers) that are looked up far more
+// often than they are added or removed, such as the motion tables keyed by
+// animation asset id.  Keys and values sit side by side in one array that
+// is probed linearly, so a lookup is usually a single cache line instead of
+// the pointer chase of a std::map.
+//
+// Erase shifts the following entries of the probe run back rather than
+// leaving tombstones, so lookups stay short however much the map churns.
+// Any insert or erase invalidates iterators; collect keys first when
+// erasing during a walk.
+
+template <class DATA>
+class LLUUIDFlatMap
+{
+public:
+	typedef std::pair<LLUUID, DATA> value_type;
+
+	class iterator
+	{
+	public:
+		iterator() : mMap(NULL), mIndex(0) { }
+
+		value_type& operator*() const				{ return mMap->mSlots[mIndex]; }
+		value_type* operator->() const				{ return &(operator*()); }
+
+		iterator& operator++()
+		{
+			mIndex = mMap->nextUsed(mIndex + 1);
+			return *this;
+		}
+
+		iterator operator++(int)
+		{
+			iterator tmp = *this;
+			++(*this);
+			return tmp;
+		}
+
+		bool operator==(const iterator& rhs) const	{ return mIndex == rhs.mIndex; }
+		bool operator!=(const iterator& rhs) const	{ return mIndex != rhs.mIndex; }
+
+	private:
+		friend class LLUUIDFlatMap;
+		iterator(LLUUIDFlatMap* map, U32 index) : mMap(map), mIndex(index) { }
+
+		LLUUIDFlatMap* mMap;
+		U32 mIndex;
+	};
+
+	LLUUIDFlatMap() : mSize(0) { }
+
+	U32 size() const							{ return mSize; }
+	bool empty() const							{ return mSize == 0; }
+
+	iterator begin()							{ return iterator(this, nextUsed(0)); }
+	iterator end()								{ return iterator(this, capacity()); }
+
+	iterator find(const LLUUID& id)
+	{
+		U32 index;
+		return lookup(id, index) ? iterator(this, index) : end();
+	}
+
+	bool count(const LLUUID& id) const
+	{
+		U32 index;
+		return lookup(id, index);
+	}
+
+	// Returns default_value when id is not in the map.
+	DATA getIfThere(const LLUUID& id, DATA default_value) const
+	{
+		U32 index;
+		return lookup(id, index) ? mSlots[index].second : default_value;
+	}
+
+	// Inserts a default constructed value when id is not in the map.
+	DATA& operator[](const LLUUID& id)
+	{
+		U32 index;
+		if (!lookup(id, index))
+		{
+			index = add(id, DATA());
+		}
+		return mSlots[index].second;
+	}
+
+	// Returns false and leaves the old value if id is already in the map.
+	bool insert(const LLUUID& id, const DATA& data)
+	{
+		U32 index;
+		if (lookup(id, index))
+		{
+			return false;
+		}
+		add(id, data);
+		return true;
+	}
+
+	// Returns the number of entries removed, 0 or 1.
+	U32 erase(const LLUUID& id)
+	{
+		U32 hole;
+		if (!lookup(id, hole))
+		{
+			return 0;
+		}
+
+		// pull later members of the probe run back so no lookup ever
+		// stops short at the hole
+		const U32 mask = capacity() - 1;
+		U32 index = hole;
+		while (true)
+		{
+			index = (index + 1) & mask;
+			if (!mUsed[index])
+			{
+				break;
+			}
+			U32 home = hash(mSlots[index].first) & mask;
+			if (((index - home) & mask) >= ((index - hole) & mask))
+			{
+				mSlots[hole] = mSlots[index];
+				hole = index;
+			}
+		}
+		mSlots[hole] = value_type();
+		mUsed[hole] = FALSE;
+		mSize--;
+		return 1;
+	}
+
+	// Keeps the allocation, the map usually refills to the same size.
+	void clear()
+	{
+		std::fill(mSlots.begin(), mSlots.end(), value_type());
+		std::fill(mUsed.begin(), mUsed.end(), (U8)FALSE);
+		mSize = 0;
+	}
+
+	// Asset ids are random, so folding two of the four words is as good
+	// as hashing all sixteen bytes.
+	static U32 hash(const LLUUID& id)
+	{
+		const U32* words = (const U32*)id.mData;
+		U32 h = (words[0] ^ words[3]) * 2654435761U;
+		return h ^ (h >> 16);
+	}
+
+private:
+	enum { MIN_CAPACITY = 16 };
+
+	U32 capacity() const						{ return (U32)mSlots.size(); }
+
+	U32 nextUsed(U32 index) const
+	{
+		const U32 cap = capacity();
+		while (index < cap && !mUsed[index])
+		{
+			index++;
+		}
+		return index;
+	}
+
+	bool lookup(const LLUUID& id, U32& index) const
+	{
+		if (mSize == 0)
+		{
+			return false;
+		}
+		const U32 mask = capacity() - 1;
+		index = hash(id) & mask;
+		while (mUsed[index])
+		{
+			if (mSlots[index].first == id)
+			{
+				return true;
+			}
+			index = (index + 1) & mask;
+		}
+		return false;
+	}
+
+	U32 add(const LLUUID& id, const DATA& data)
+	{
+		// keep at least a third of the slots free so probe runs stay short
+		if ((mSize + 1) * 3 > capacity() * 2)
+		{
+			rehash(llmax((U32)MIN_CAPACITY, capacity() * 2));
+		}
+		const U32 mask = capacity() - 1;
+		U32 index = hash(id) & mask;
+		while (mUsed[index])
+		{
+			index = (index + 1) & mask;
+		}
+		mSlots[index] = value_type(id, data);
+		mUsed[index] = TRUE;
+		mSize++;
+		return index;
+	}
+
+	void rehash(U32 new_capacity)
+	{
+		std::vector<value_type> old_slots(new_capacity);
+		std::vector<U8> old_used(new_capacity, (U8)FALSE);
+		old_slots.swap(mSlots);
+		old_used.swap(mUsed);
+		mSize = 0;
+		for (U32 i = 0; i < old_slots.size(); i++)
+		{
+			if (old_used[i])
+			{
+				add(old_slots[i].first, old_slots[i].second);
+			}
+		}
+	}
+
+	std::vector<value_type> mSlots;
+	std::vector<U8> mUsed;
+	U32 mSize;
+};
+
+#endif // LL_LLUUIDFLATMAP_H
@@ -0,0 +1,524 @@
+/** 
+ * @file llimageblend.h
+ * @brief Software OpenGL blend modes for compositing images on the CPU
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLIMAGEBLEND_H
+#define LL_LLIMAGEBLEND_H
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "stdtypes.h"
+
+#if (LL_GNUC && __SSE2__) || (LL_MSVC && (_M_IX86_FP >= 2 || defined(_M_X64)))
+#define LL_IMAGEBLEND_SSE2	1
+#include <emmintrin.h>
+#else
+#define LL_IMAGEBLEND_SSE2	0
+#endif
+
+//============================================================================
+// LLImageBlend - software versions of the few OpenGL blend states the avatar
+// texture compositor uses, for building bakes without a GL context.
+//
+// Color buffers are 8 bit RGBA, alpha planes are 8 bit single channel.  All
+// products are rounded as a * b / 255.  A textured draw rounds the tinted
+// fragment and then the blend, which puts it within two steps of what the GL
+// path produces.  The SSE2 and scalar versions give identical results.
+//
+// Everything is inline so the kernels can be unit tested without linking
+// the rest of llimage.
+
+class LLImageBlend
+{
+public:
+	enum EBlendMode
+	{
+		BLEND_ALPHA,		// GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+		BLEND_DEST_ALPHA,	// GL_DST_ALPHA, GL_ONE_MINUS_DST_ALPHA
+		BLEND_REPLACE		// GL_ONE, GL_ZERO
+	};
+
+	// GL_ALPHA_TEST with glAlphaFunc(GL_GREATER, 0.01f) passes alpha >= this
+	static const S32 DEFAULT_ALPHA_TEST = 3;
+
+	// a * b / 255, rounded to nearest
+	static U8 mul255(U32 a, U32 b)
+	{
+		U32 t = a * b + 128;
+		return (U8)((t + (t >> 8)) >> 8);
+	}
+
+	// Converts count pixels of a 1 to 4 component image to RGBA the way a
+	// texture of that format is sampled.  One component images are GL_ALPHA
+	// if is_mask is set, luminance otherwise.
+	static void expandToRGBA(U8* dst, const U8* src, S32 components, BOOL is_mask, S32 count);
+
+	// Scales an RGBA image to dst_width x dst_height the way GL samples a
+	// texture with clamped addressing drawn over a quad of that size.
+	// Magnified, or without mipmaps, it is GL_LINEAR.  Minified mipmapped
+	// textures are GL_LINEAR_MIPMAP_LINEAR, on 2x2 box filtered mips.
+	static void resampleRGBA(U8* dst, S32 dst_width, S32 dst_height,
+							 const U8* src, S32 src_width, S32 src_height, BOOL mipmapped);
+
+	// Draws count pixels of src (RGBA, or NULL for an untextured quad)
+	// modulated by tint onto dst.  BLEND_DEST_ALPHA takes the destination
+	// alpha from dst like GL does, or from dest_alpha if it isn't NULL.
+	// Fragments with alpha below min_alpha are discarded, pass 0 to disable
+	// the alpha test.
+	static void blendRGBA(U8* dst, const U8* src, const U8 tint[4], const U8* dest_alpha,
+						  S32 min_alpha, S32 count, EBlendMode mode);
+
+	// Alpha plane operations.  Add saturates (GL_ONE, GL_ONE), multiply is
+	// (GL_DST_ALPHA, GL_ZERO).
+	static void addAlpha(U8* dst, const U8* src, S32 count);
+	static void addAlpha(U8* dst, U8 value, S32 count);
+	static void multiplyAlpha(U8* dst, const U8* src, S32 count);
+	static void multiplyAlpha(U8* dst, U8 value, S32 count);
+
+	// Copies the alpha channel of an RGBA buffer to a plane and back
+	static void extractAlpha(U8* dst, const U8* rgba, S32 count);
+	static void insertAlpha(U8* rgba, const U8* src, S32 count);
+
+	// dst = dst * (src + 1) >> 8, the combination LLTexLayerSet::gatherAlphaMasks() uses
+	static void accumulateMask(U8* dst, const U8* src, S32 count);
+
+private:
+	// One level of a GL generated mip chain
+	static void halveRGBA(std::vector<U8>& dst, S32& width, S32& height, const U8* src);
+
+	// GL_LINEAR sample of every pixel of a dst_width x dst_height quad, as floats
+	static void sampleBilinear(F32* dst, S32 dst_width, S32 dst_height,
+							   const U8* src, S32 src_width, S32 src_height);
+
+	static void blendPixel(U8* dst, const U8* frag, U8 dest_alpha, EBlendMode mode)
+	{
+		switch (mode)
+		{
+		case BLEND_ALPHA:
+			{
+				U8 sa = frag[3];
+				for (S32 c = 0; c < 4; c++)
+				{
+					dst[c] = mul255(frag[c], sa) + mul255(dst[c], 255 - sa);
+				}
+			}
+			break;
+		case BLEND_DEST_ALPHA:
+			for (S32 c = 0; c < 4; c++)
+			{
+				dst[c] = mul255(frag[c], dest_alpha) + mul255(dst[c], 255 - dest_alpha);
+			}
+			break;
+		default:
+			memcpy(dst, frag, 4);
+			break;
+		}
+	}
+
+#if LL_IMAGEBLEND_SSE2
+	// mul255() on eight 16 bit lanes
+	static __m128i mul255(__m128i a, __m128i b)
+	{
+		__m128i t = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+		return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+	}
+
+	// Copies the alpha lane of both pixels in a register to all four channels
+	static __m128i splatAlpha(__m128i v)
+	{
+		v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3));
+		return _mm_shufflehi_epi16(v, _MM_SHUFFLE(3, 3, 3, 3));
+	}
+
+	// Blends two pixels held as 16 bit lanes
+	static __m128i blendPixels(__m128i d, __m128i f, __m128i da, S32 min_alpha, EBlendMode mode)
+	{
+		const __m128i full = _mm_set1_epi16(255);
+		__m128i sa = splatAlpha(f);
+		__m128i r;
+		switch (mode)
+		{
+		case BLEND_ALPHA:
+			r = _mm_add_epi16(mul255(f, sa), mul255(d, _mm_sub_epi16(full, sa)));
+			break;
+		case BLEND_DEST_ALPHA:
+			r = _mm_add_epi16(mul255(f, da), mul255(d, _mm_sub_epi16(full, da)));
+			break;
+		default:
+			r = f;
+			break;
+		}
+		if (min_alpha > 0)
+		{
+			__m128i pass = _mm_cmpgt_epi16(sa, _mm_set1_epi16((short)(min_alpha - 1)));
+			r = _mm_or_si128(_mm_and_si128(pass, r), _mm_andnot_si128(pass, d));
+		}
+		return r;
+	}
+#endif
+};
+
+inline void LLImageBlend::expandToRGBA(U8* dst, const U8* src, S32 components, BOOL is_mask, S32 count)
+{
+	switch (components)
+	{
+	case 4:
+		memcpy(dst, src, count * 4);
+		break;
+	case 3:
+		for (S32 i = 0; i < count; i++, dst += 4, src += 3)
+		{
+			dst[0] = src[0];
+			dst[1] = src[1];
+			dst[2] = src[2];
+			dst[3] = 255;
+		}
+		break;
+	case 2:
+		for (S32 i = 0; i < count; i++, dst += 4, src += 2)
+		{
+			dst[0] = dst[1] = dst[2] = src[0];
+			dst[3] = src[1];
+		}
+		break;
+	default:
+		for (S32 i = 0; i < count; i++, dst += 4, src++)
+		{
+			if (is_mask)
+			{
+				dst[0] = dst[1] = dst[2] = 255;
+				dst[3] = src[0];
+			}
+			else
+			{
+				dst[0] = dst[1] = dst[2] = src[0];
+				dst[3] = 255;
+			}
+		}
+		break;
+	}
+}
+
+inline void LLImageBlend::halveRGBA(std::vector<U8>& dst, S32& width, S32& height, const U8* src)
+{
+	S32 src_width = width;
+	S32 src_height = height;
+	width = width > 1 ? width / 2 : 1;
+	height = height > 1 ? height / 2 : 1;
+	dst.resize(width * height * 4);
+	for (S32 y = 0; y < height; y++)
+	{
+		const U8* row0 = src + (y * 2 < src_height ? y * 2 : src_height - 1) * src_width * 4;
+		const U8* row1 = src + (y * 2 + 1 < src_height ? y * 2 + 1 : src_height - 1) * src_width * 4;
+		for (S32 x = 0; x < width; x++)
+		{
+			S32 x0 = (x * 2 < src_width ? x * 2 : src_width - 1) * 4;
+			S32 x1 = (x * 2 + 1 < src_width ? x * 2 + 1 : src_width - 1) * 4;
+			for (S32 c = 0; c < 4; c++)
+			{
+				dst[(y * width + x) * 4 + c] = (U8)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+			}
+		}
+	}
+}
+
+inline void LLImageBlend::sampleBilinear(F32* dst, S32 dst_width, S32 dst_height,
+										 const U8* src, S32 src_width, S32 src_height)
+{
+	F32 scale_x = (F32)src_width / (F32)dst_width;
+	F32 scale_y = (F32)src_height / (F32)dst_height;
+	for (S32 y = 0; y < dst_height; y++)
+	{
+		F32 v = (y + 0.5f) * scale_y - 0.5f;
+		S32 y0 = (S32)floorf(v);
+		F32 fy = v - (F32)y0;
+		S32 y1 = y0 + 1;
+		y0 = y0 < 0 ? 0 : (y0 >= src_height ? src_height - 1 : y0);
+		y1 = y1 < 0 ? 0 : (y1 >= src_height ? src_height - 1 : y1);
+		for (S32 x = 0; x < dst_width; x++)
+		{
+			F32 u = (x + 0.5f) * scale_x - 0.5f;
+			S32 x0 = (S32)floorf(u);
+			F32 fx = u - (F32)x0;
+			S32 x1 = x0 + 1;
+			x0 = x0 < 0 ? 0 : (x0 >= src_width ? src_width - 1 : x0);
+			x1 = x1 < 0 ? 0 : (x1 >= src_width ? src_width - 1 : x1);
+
+			const U8* t00 = src + (y0 * src_width + x0) * 4;
+			const U8* t10 = src + (y0 * src_width + x1) * 4;
+			const U8* t01 = src + (y1 * src_width + x0) * 4;
+			const U8* t11 = src + (y1 * src_width + x1) * 4;
+			for (S32 c = 0; c < 4; c++)
+			{
+				F32 top = t00[c] + (t10[c] - t00[c]) * fx;
+				F32 bottom = t01[c] + (t11[c] - t01[c]) * fx;
+				*dst++ = top + (bottom - top) * fy;
+			}
+		}
+	}
+}
+
+inline void LLImageBlend::resampleRGBA(U8* dst, S32 dst_width, S32 dst_height,
+									   const U8* src, S32 src_width, S32 src_height, BOOL mipmapped)
+{
+	S32 count = dst_width * dst_height * 4;
+	if (src_width == dst_width && src_height == dst_height)
+	{
+		memcpy(dst, src, count);
+		return;
+	}
+
+	// level of detail, from the larger of the two scale factors
+	F32 rho_x = (F32)src_width / (F32)dst_width;
+	F32 rho_y = (F32)src_height / (F32)dst_height;
+	F32 rho = rho_x > rho_y ? rho_x : rho_y;
+	F32 lod = (mipmapped && rho > 1.f) ? logf(rho) / logf(2.f) : 0.f;
+
+	std::vector<U8> level;
+	std::vector<U8> next;
+	const U8* level_data = src;
+	S32 width = src_width;
+	S32 height = src_height;
+	while (lod >= 1.f && (width > 1 || height > 1))
+	{
+		halveRGBA(next, width, height, level_data);
+		level.swap(next);
+		level_data = &level[0];
+		lod -= 1.f;
+	}
+
+	std::vector<F32> sample(count);
+	sampleBilinear(&sample[0], dst_width, dst_height, level_data, width, height);
+	if (lod > 0.f && (width > 1 || height > 1))
+	{
+		// blend with the next smaller level
+		S32 next_width = width;
+		S32 next_height = height;
+		halveRGBA(next, next_width, next_height, level_data);
+		std::vector<F32> next_sample(count);
+		sampleBilinear(&next_sample[0], dst_width, dst_height, &next[0], next_width, next_height);
+		for (S32 i = 0; i < count; i++)
+		{
+			sample[i] += (next_sample[i] - sample[i]) * lod;
+		}
+	}
+
+	for (S32 i = 0; i < count; i++)
+	{
+		S32 value = (S32)(sample[i] + 0.5f);
+		dst[i] = (U8)(value > 255 ? 255 : value);
+	}
+}
+
+inline void LLImageBlend::blendRGBA(U8* dst, const U8* src, const U8 tint[4], const U8* dest_alpha,
+									S32 min_alpha, S32 count, EBlendMode mode)
+{
+	S32 i = 0;
+
+	// an untextured quad is the same fragment everywhere
+	U8 frag[4];
+	memcpy(frag, tint, 4);
+	if (!src && frag[3] < min_alpha)
+	{
+		return;
+	}
+
+#if LL_IMAGEBLEND_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i tint16 = _mm_set_epi16(tint[3], tint[2], tint[1], tint[0], tint[3], tint[2], tint[1], tint[0]);
+	for ( ; i + 4 <= count; i += 4)
+	{
+		__m128i d = _mm_loadu_si128((const __m128i*)(dst + i * 4));
+		__m128i d_lo = _mm_unpacklo_epi8(d, zero);
+		__m128i d_hi = _mm_unpackhi_epi8(d, zero);
+
+		__m128i f_lo = tint16;
+		__m128i f_hi = tint16;
+		if (src)
+		{
+			__m128i s = _mm_loadu_si128((const __m128i*)(src + i * 4));
+			f_lo = mul255(_mm_unpacklo_epi8(s, zero), tint16);
+			f_hi = mul255(_mm_unpackhi_epi8(s, zero), tint16);
+		}
+
+		__m128i da_lo = splatAlpha(d_lo);
+		__m128i da_hi = splatAlpha(d_hi);
+		if (mode == BLEND_DEST_ALPHA && dest_alpha)
+		{
+			S32 four;
+			memcpy(&four, dest_alpha + i, 4);
+			__m128i a = _mm_unpacklo_epi8(_mm_cvtsi32_si128(four), zero);
+			a = _mm_unpacklo_epi16(a, a);
+			da_lo = _mm_unpacklo_epi32(a, a);
+			da_hi = _mm_unpackhi_epi32(a, a);
+		}
+
+		d_lo = blendPixels(d_lo, f_lo, da_lo, min_alpha, mode);
+		d_hi = blendPixels(d_hi, f_hi, da_hi, min_alpha, mode);
+		_mm_storeu_si128((__m128i*)(dst + i * 4), _mm_packus_epi16(d_lo, d_hi));
+	}
+#endif
+
+	for ( ; i < count; i++)
+	{
+		if (src)
+		{
+			for (S32 c = 0; c < 4; c++)
+			{
+				frag[c] = mul255(src[i * 4 + c], tint[c]);
+			}
+			if (frag[3] < min_alpha)
+			{
+				continue;
+			}
+		}
+		blendPixel(dst + i * 4, frag, dest_alpha ? dest_alpha[i] : dst[i * 4 + 3], mode);
+	}
+}
+
+inline void LLImageBlend::addAlpha(U8* dst, const U8* src, S32 count)
+{
+	S32 i = 0;
+#if LL_IMAGEBLEND_SSE2
+	for ( ; i + 16 <= count; i += 16)
+	{
+		__m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+		__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_adds_epu8(d, s));
+	}
+#endif
+	for ( ; i < count; i++)
+	{
+		S32 sum = dst[i] + src[i];
+		dst[i] = (U8)(sum > 255 ? 255 : sum);
+	}
+}
+
+inline void LLImageBlend::addAlpha(U8* dst, U8 value, S32 count)
+{
+	S32 i = 0;
+#if LL_IMAGEBLEND_SSE2
+	const __m128i v = _mm_set1_epi8((char)value);
+	for ( ; i + 16 <= count; i += 16)
+	{
+		__m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_adds_epu8(d, v));
+	}
+#endif
+	for ( ; i < count; i++)
+	{
+		S32 sum = dst[i] + value;
+		dst[i] = (U8)(sum > 255 ? 255 : sum);
+	}
+}
+
+inline void LLImageBlend::multiplyAlpha(U8* dst, const U8* src, S32 count)
+{
+	S32 i = 0;
+#if LL_IMAGEBLEND_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	for ( ; i + 16 <= count; i += 16)
+	{
+		__m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+		__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i lo = mul255(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero));
+		__m128i hi = mul255(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+#endif
+	for ( ; i < count; i++)
+	{
+		dst[i] = mul255(dst[i], src[i]);
+	}
+}
+
+inline void LLImageBlend::multiplyAlpha(U8* dst, U8 value, S32 count)
+{
+	S32 i = 0;
+#if LL_IMAGEBLEND_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i v = _mm_set1_epi16(value);
+	for ( ; i + 16 <= count; i += 16)
+	{
+		__m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+		__m128i lo = mul255(_mm_unpacklo_epi8(d, zero), v);
+		__m128i hi = mul255(_mm_unpackhi_epi8(d, zero), v);
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+#endif
+	for ( ; i < count; i++)
+	{
+		dst[i] = mul255(dst[i], value);
+	}
+}
+
+inline void LLImageBlend::extractAlpha(U8* dst, const U8* rgba, S32 count)
+{
+	for (S32 i = 0; i < count; i++)
+	{
+		dst[i] = rgba[i * 4 + 3];
+	}
+}
+
+inline void LLImageBlend::insertAlpha(U8* rgba, const U8* src, S32 count)
+{
+	for (S32 i = 0; i < count; i++)
+	{
+		rgba[i * 4 + 3] = src[i];
+	}
+}
+
+inline void LLImageBlend::accumulateMask(U8* dst, const U8* src, S32 count)
+{
+	S32 i = 0;
+#if LL_IMAGEBLEND_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi16(1);
+	for ( ; i + 16 <= count; i += 16)
+	{
+		__m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+		__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_add_epi16(_mm_unpacklo_epi8(s, zero), one));
+		__m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_add_epi16(_mm_unpackhi_epi8(s, zero), one));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+	}
+#endif
+	for ( ; i < count; i++)
+	{
+		U16 result = dst[i];
+		result *= (src[i] + 1);
+		dst[i] = (U8)(result >> 8);
+	}
+}
+
+#endif // LL_LLIMAGEBLEND_H
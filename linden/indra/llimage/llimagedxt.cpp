@@ -168,7 +168,9 @@ S32 LLImageDXT::calcNumMips(S32 width, S32 height)
 LLImageDXT::LLImageDXT()
 	: LLImageFormatted(IMG_CODEC_DXT),
 	  mFileFormat(FORMAT_UNKNOWN),
-	  mHeaderSize(0)
+	  mHeaderSize(0),
+	  mFlags(0),
+	  mSourceDiscard(0)
 {
 }
 
@@ -197,6 +199,8 @@ BOOL LLImageDXT::updateData()
 		dxtfile_header_old_t* oldheader = (dxtfile_header_old_t*)header;
 		mHeaderSize = sizeof(dxtfile_header_old_t);
 		mFileFormat = EFileFormat(oldheader->format);
+		mFlags = 0;
+		mSourceDiscard = 0;
 		miplevelmax = llmin(oldheader->maxlevel,MAX_IMAGE_MIP);
 		width = oldheader->maxwidth;
 		height = oldheader->maxheight;
@@ -205,6 +209,8 @@ BOOL LLImageDXT::updateData()
 	{
 		mHeaderSize = sizeof(dxtfile_header_t);
 		mFileFormat = getFormat(header->pixel_fmt.fourcc);
+		mFlags = header->flags;
+		mSourceDiscard = llclamp(header->reserved[0], 0, MAX_DISCARD_LEVEL);
 		miplevelmax = llmin(header->num_mips-1,MAX_IMAGE_MIP);
 		width = header->maxwidth;
 		height = header->maxheight;
@@ -409,6 +415,90 @@ BOOL LLImageDXT::encode(const LLImageRaw* raw_image, F32 time)
 	return encodeDXT(raw_image, time, false);
 }
 
+BOOL LLImageDXT::encodeCompressed(const LLImageRaw* raw_image, S32 source_discard, bool alpha_mask)
+{
+	llassert_always(raw_image);
+
+	S32 ncomponents = raw_image->getComponents();
+	S32 width = raw_image->getWidth();
+	S32 height = raw_image->getHeight();
+	if (ncomponents < 1 || ncomponents > 4 || width <= 0 || height <= 0 || !raw_image->getData())
+	{
+		setLastError("LLImageDXT::encodeCompressed: bad source image");
+		return FALSE;
+	}
+
+	// Only pay for the 8 bit alpha block when the alpha channel is used
+	EFileFormat format = FORMAT_DXR1;
+	if (ncomponents == 2 || ncomponents == 4)
+	{
+		const U8* alpha = raw_image->getData() + ncomponents - 1;
+		S32 count = width * height;
+		for (S32 i = 0; i < count; i++, alpha += ncomponents)
+		{
+			if (*alpha != 255)
+			{
+				format = FORMAT_DXR5;
+				break;
+			}
+		}
+	}
+
+	setSize(width, height, formatComponents(format));
+	mHeaderSize = sizeof(dxtfile_header_t);
+	mFileFormat = format;
+	mFlags = alpha_mask ? FLAG_ALPHA_MASK : 0;
+	mSourceDiscard = llclamp(source_discard, 0, MAX_DISCARD_LEVEL);
+
+	S32 nmips = calcNumMips(width, height);
+	S32 totbytes = mHeaderSize;
+	S32 w = width;
+	S32 h = height;
+	for (S32 mip=0; mip<nmips; mip++)
+	{
+		totbytes += formatBytes(format, w, h);
+		w >>= 1;
+		h >>= 1;
+	}
+
+	allocateData(totbytes);
+
+	U8* data = getData();
+	dxtfile_header_t* header = (dxtfile_header_t*)data;
+	memset(header, 0, mHeaderSize);
+	header->fourcc = 0x20534444;
+	header->header_size = mHeaderSize;
+	header->flags = mFlags;
+	header->pixel_fmt.fourcc = getFourCC(format);
+	header->num_mips = nmips;
+	header->maxwidth = width;
+	header->maxheight = height;
+	header->reserved[0] = mSourceDiscard;
+
+	// Box filter each mip from the uncompressed previous one so block
+	// errors don't accumulate down the chain
+	const U8* mipsrc = raw_image->getData();
+	U8* prev_mipsrc = NULL;
+	w = width, h = height;
+	for (S32 mip=0; mip<nmips; mip++)
+	{
+		compressMip(mipsrc, data + getMipOffset(mip), w, h, ncomponents, format);
+		if (mip + 1 < nmips)
+		{
+			U8* next_mipsrc = new U8[(w >> 1) * (h >> 1) * ncomponents];
+			generateMip(mipsrc, next_mipsrc, w >> 1, h >> 1, ncomponents);
+			delete[] prev_mipsrc;
+			prev_mipsrc = next_mipsrc;
+			mipsrc = next_mipsrc;
+		}
+		w >>= 1;
+		h >>= 1;
+	}
+	delete[] prev_mipsrc;
+
+	return TRUE;
+}
+
 // virtual
 bool LLImageDXT::convertToDXR()
 {
@@ -487,6 +577,225 @@ S32 LLImageDXT::calcDataSize(S32 discard_level)
 
 //============================================================================
 
+// S3TC block encoding.  Endpoints are the inset bounding box of the block
+// (the usual real time compromise: no iterative fitting), each texel takes
+// the nearest palette entry.
+
+static inline U16 pack_565(const S32* rgb)
+{
+	return (U16)(((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3));
+}
+
+static inline void unpack_565(U16 c, S32* rgb)
+{
+	S32 r = (c >> 11) & 0x1f;
+	S32 g = (c >> 5) & 0x3f;
+	S32 b = c & 0x1f;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+// texels is 16 RGBA quads in row order, writes 8 bytes
+static void compress_color_block(const U8* texels, U8* out)
+{
+	S32 lo[3] = { 255, 255, 255 };
+	S32 hi[3] = { 0, 0, 0 };
+	for (S32 i = 0; i < 16; i++)
+	{
+		for (S32 c = 0; c < 3; c++)
+		{
+			lo[c] = llmin(lo[c], (S32)texels[i*4+c]);
+			hi[c] = llmax(hi[c], (S32)texels[i*4+c]);
+		}
+	}
+	// The box diagonal only follows the block's colors when all channels
+	// rise together; flip the channels that fall as the widest one rises.
+	S32 center[3];
+	S32 ref = 0;
+	for (S32 c = 0; c < 3; c++)
+	{
+		center[c] = (lo[c] + hi[c]) >> 1;
+		if (hi[c] - lo[c] > hi[ref] - lo[ref])
+		{
+			ref = c;
+		}
+	}
+	for (S32 c = 0; c < 3; c++)
+	{
+		if (c == ref)
+		{
+			continue;
+		}
+		S32 cov = 0;
+		for (S32 i = 0; i < 16; i++)
+		{
+			cov += ((S32)texels[i*4+c] - center[c]) * ((S32)texels[i*4+ref] - center[ref]);
+		}
+		if (cov < 0)
+		{
+			std::swap(lo[c], hi[c]);
+		}
+	}
+
+	for (S32 c = 0; c < 3; c++)
+	{
+		S32 inset = (hi[c] - lo[c]) / 16;
+		lo[c] += inset;
+		hi[c] -= inset;
+	}
+
+	U16 color0 = pack_565(hi);
+	U16 color1 = pack_565(lo);
+	if (color0 < color1)
+	{
+		std::swap(color0, color1);
+	}
+
+	U32 indices = 0;
+	if (color0 != color1)
+	{
+		// color0 > color1 selects the four color (opaque) mode
+		S32 palette[4][3];
+		unpack_565(color0, palette[0]);
+		unpack_565(color1, palette[1]);
+		for (S32 c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (S32 i = 0; i < 16; i++)
+		{
+			U32 best = 0;
+			S32 best_dist = S32_MAX;
+			for (U32 p = 0; p < 4; p++)
+			{
+				S32 dr = (S32)texels[i*4+0] - palette[p][0];
+				S32 dg = (S32)texels[i*4+1] - palette[p][1];
+				S32 db = (S32)texels[i*4+2] - palette[p][2];
+				S32 dist = dr*dr + dg*dg + db*db;
+				if (dist < best_dist)
+				{
+					best_dist = dist;
+					best = p;
+				}
+			}
+			indices |= best << (i * 2);
+		}
+	}
+
+	out[0] = (U8)(color0 & 0xff);
+	out[1] = (U8)(color0 >> 8);
+	out[2] = (U8)(color1 & 0xff);
+	out[3] = (U8)(color1 >> 8);
+	for (S32 b = 0; b < 4; b++)
+	{
+		out[4+b] = (U8)((indices >> (b * 8)) & 0xff);
+	}
+}
+
+// DXT5 alpha, texels is 16 RGBA quads in row order, writes 8 bytes
+static void compress_alpha_block(const U8* texels, U8* out)
+{
+	S32 alpha0 = 0;
+	S32 alpha1 = 255;
+	for (S32 i = 0; i < 16; i++)
+	{
+		alpha0 = llmax(alpha0, (S32)texels[i*4+3]);
+		alpha1 = llmin(alpha1, (S32)texels[i*4+3]);
+	}
+
+	// alpha0 > alpha1 selects the eight value mode, which keeps the exact
+	// extremes so fully transparent and fully opaque texels survive
+	U64 indices = 0;
+	if (alpha0 != alpha1)
+	{
+		S32 palette[8];
+		palette[0] = alpha0;
+		palette[1] = alpha1;
+		for (S32 p = 2; p < 8; p++)
+		{
+			palette[p] = ((8 - p) * alpha0 + (p - 1) * alpha1) / 7;
+		}
+
+		for (S32 i = 0; i < 16; i++)
+		{
+			U64 best = 0;
+			S32 best_dist = S32_MAX;
+			for (S32 p = 0; p < 8; p++)
+			{
+				S32 dist = llabs((S32)texels[i*4+3] - palette[p]);
+				if (dist < best_dist)
+				{
+					best_dist = dist;
+					best = p;
+				}
+			}
+			indices |= best << (i * 3);
+		}
+	}
+
+	out[0] = (U8)alpha0;
+	out[1] = (U8)alpha1;
+	for (S32 b = 0; b < 6; b++)
+	{
+		out[2+b] = (U8)((indices >> (b * 8)) & 0xff);
+	}
+}
+
+//static
+void LLImageDXT::compressMip(const U8* indata, U8* mipdata, S32 width, S32 height, S32 ncomponents, EFileFormat format)
+{
+	U8 texels[16*4];
+	for (S32 by = 0; by < height; by += 4)
+	{
+		for (S32 bx = 0; bx < width; bx += 4)
+		{
+			// Mips smaller than a block repeat their edge texels
+			for (S32 y = 0; y < 4; y++)
+			{
+				S32 sy = llmin(by + y, height - 1);
+				for (S32 x = 0; x < 4; x++)
+				{
+					S32 sx = llmin(bx + x, width - 1);
+					const U8* src = indata + (sy * width + sx) * ncomponents;
+					U8* dst = texels + (y * 4 + x) * 4;
+					switch (ncomponents)
+					{
+					  case 1:
+						dst[0] = dst[1] = dst[2] = src[0];
+						dst[3] = 255;
+						break;
+					  case 2:
+						dst[0] = dst[1] = dst[2] = src[0];
+						dst[3] = src[1];
+						break;
+					  case 3:
+						dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2];
+						dst[3] = 255;
+						break;
+					  default:
+						dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2];
+						dst[3] = src[3];
+						break;
+					}
+				}
+			}
+
+			if (format == FORMAT_DXR5)
+			{
+				compress_alpha_block(texels, mipdata);
+				mipdata += 8;
+			}
+			compress_color_block(texels, mipdata);
+			mipdata += 8;
+		}
+	}
+}
+
+//============================================================================
+
 //static
 void LLImageDXT::extractMip(const U8 *indata, U8* mipdata, int width, int height,
 							int mip_width, int mip_height, EFileFormat format)
@@ -94,6 +94,12 @@ public:
 		S32 reserved2;
 	};
 
+	// Bits kept in the otherwise unused dxtfile_header_t::flags
+	enum
+	{
+		FLAG_ALPHA_MASK = 0x1,	// alpha is (nearly) all 0 or 255
+	};
+
 protected:
 	/*virtual*/ ~LLImageDXT();
 
@@ -121,6 +127,14 @@ public:
 	bool isCompressed() { return (mFileFormat >= FORMAT_DXT1 && mFileFormat <= FORMAT_DXR5); }
 
 	bool convertToDXR(); // convert from DXT to DXR
+
+	// S3TC compress raw_image and a full mip chain into DXR1 (opaque) or
+	// DXR5 (any alpha below 255).  source_discard is the discard level the
+	// raw image was decoded at and is stored in the header with the alpha
+	// mask flag so the file can be uploaded without the original texture.
+	BOOL encodeCompressed(const LLImageRaw* raw_image, S32 source_discard, bool alpha_mask);
+	S32 getSourceDiscard() const { return mSourceDiscard; }
+	bool isAlphaMask() const { return (mFlags & FLAG_ALPHA_MASK) != 0; }
 	
 	static void checkMinWidthHeight(EFileFormat format, S32& width, S32& height);
 	static S32 formatBits(EFileFormat format);
@@ -137,10 +151,13 @@ public:
 private:
 	static void extractMip(const U8 *indata, U8* mipdata, int width, int height,
 						   int mip_width, int mip_height, EFileFormat format);
+	static void compressMip(const U8* indata, U8* mipdata, S32 width, S32 height, S32 ncomponents, EFileFormat format);
 	
 private:
 	EFileFormat mFileFormat;
 	S32 mHeaderSize;
+	S32 mFlags;
+	S32 mSourceDiscard;
 };
 
 #endif
@@ -0,0 +1,311 @@
+/**
+ * @file lloctreelinear.h
+ * @brief Flattened, cache friendly snapshot of an LLOctreeNode tree.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ *
+ * Copyright (c) 2009, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLOCTREELINEAR_H
+#define LL_LLOCTREELINEAR_H
+
+#include "v3math.h"
+#include "v3dmath.h"
+#include "llmemory.h"
+#include "lloctree.h"
+#include <vector>
+
+// LLOctreeLinear is a read only copy of an LLOctreeNode tree laid out in
+// contiguous arrays.  Nodes are stored breadth first, so the children of
+// any node occupy a single run of the node array, and the elements of each
+// node occupy a single run of the element array.  Bounds are stored as F32
+// center/half size pairs that tightly enclose everything below a node.
+//
+// The pointer based tree stays authoritative (it owns the listeners and
+// handles insertion and removal); call rebuild() after it changes.  Every
+// linear node remembers the LLOctreeNode it was built from, so any
+// LLOctreeTraveler can be run over the linear layout unchanged.
+//
+// LLSpatialPartition does not use it yet and still culls the pointer tree;
+// test/lloctree_bench.cpp times both layouts under the same cull.
+
+template <class T>
+class LLOctreeLinear
+{
+public:
+	typedef LLOctreeNode<T>			oct_node;
+	typedef LLOctreeTraveler<T>		oct_traveler;
+
+	static const U32 INVALID_INDEX = 0xFFFFFFFF;
+
+	struct Node
+	{
+		LLVector3		mCenter;
+		LLVector3		mSize;
+		U32				mFirstChild;
+		U32				mFirstElement;
+		U32				mElementCount;
+		U8				mChildCount;
+		U8				mOctant;
+		const oct_node*	mSource;
+	};
+
+	typedef std::vector<Node>	node_list;
+	typedef std::vector<T*>		element_list;
+
+	LLOctreeLinear()								{ }
+
+	void clear()
+	{
+		mNodes.clear();
+		mElements.clear();
+	}
+
+	bool isEmpty() const							{ return mNodes.empty(); }
+	U32 getNodeCount() const						{ return mNodes.size(); }
+	U32 getElementCount() const						{ return mElements.size(); }
+	const Node& getNode(U32 index) const			{ return mNodes[index]; }
+	T* getElement(U32 index) const					{ return mElements[index]; }
+
+	// Flatten the tree rooted at root.  Storage is reused between rebuilds.
+	void rebuild(const oct_node* root)
+	{
+		clear();
+		if (!root)
+		{
+			return;
+		}
+
+		// breadth first: mNodes doubles as the work queue
+		mNodes.push_back(Node());
+		mNodes[0].mSource = root;
+
+		for (U32 i = 0; i < mNodes.size(); i++)
+		{
+			const oct_node* src = mNodes[i].mSource;
+
+			mNodes[i].mOctant = src->getOctant();
+			mNodes[i].mFirstElement = mElements.size();
+			mNodes[i].mElementCount = src->getElementCount();
+			for (typename oct_node::const_element_iter iter = src->getData().begin(); iter != src->getData().end(); ++iter)
+			{
+				mElements.push_back(*iter);
+			}
+
+			U32 child_count = src->getChildCount();
+			mNodes[i].mChildCount = (U8) child_count;
+			mNodes[i].mFirstChild = child_count ? mNodes.size() : INVALID_INDEX;
+			for (U32 c = 0; c < child_count; c++)
+			{
+				Node child;
+				child.mSource = src->getChild(c);
+				// push_back may reallocate, don't hold references across it
+				mNodes.push_back(child);
+			}
+		}
+
+		// children always follow their parent, so walking backwards
+		// finishes every child before the parent reads its bounds
+		for (S32 i = (S32) mNodes.size() - 1; i >= 0; i--)
+		{
+			updateBounds(mNodes[i]);
+		}
+	}
+
+	// Visit every node in storage order.
+	void traverse(oct_traveler* traveler) const
+	{
+		for (U32 i = 0; i < mNodes.size(); i++)
+		{
+			mNodes[i].mSource->accept(traveler);
+		}
+	}
+
+	// Visit nodes accepted by filter, depth first.  Filter is any functor
+	// taking (const LLVector3& center, const LLVector3& size) and returning
+	// 0 (outside, skip branch), 1 (partially inside, test children) or 2
+	// (fully inside, accept branch without further tests), the same
+	// convention as LLCamera::AABBInFrustum.
+	template <class Filter>
+	void traverse(oct_traveler* traveler, Filter& filter) const
+	{
+		if (mNodes.empty())
+		{
+			return;
+		}
+
+		// (index << 1) | fully_inside
+		mStack.clear();
+		mStack.push_back(0);
+
+		while (!mStack.empty())
+		{
+			U32 entry = mStack.back();
+			mStack.pop_back();
+
+			const Node& node = mNodes[entry >> 1];
+			U32 inside = entry & 1;
+			if (!inside)
+			{
+				S32 res = filter(node.mCenter, node.mSize);
+				if (res == 0)
+				{
+					continue;
+				}
+				inside = (res == 2) ? 1 : 0;
+			}
+
+			node.mSource->accept(traveler);
+
+			// push in reverse so children pop in storage order
+			for (S32 c = (S32) node.mChildCount - 1; c >= 0; c--)
+			{
+				mStack.push_back(((node.mFirstChild + c) << 1) | inside);
+			}
+		}
+	}
+
+	// Append to results every element stored in a node whose bounds the
+	// segment start-end passes through.
+	void lineSegmentIntersect(const LLVector3& start, const LLVector3& end, element_list& results) const
+	{
+		if (mNodes.empty())
+		{
+			return;
+		}
+
+		mStack.clear();
+		mStack.push_back(0);
+
+		while (!mStack.empty())
+		{
+			const Node& node = mNodes[mStack.back()];
+			mStack.pop_back();
+
+			if (!segmentIntersectsBox(start, end, node.mCenter, node.mSize))
+			{
+				continue;
+			}
+
+			for (U32 e = 0; e < node.mElementCount; e++)
+			{
+				results.push_back(mElements[node.mFirstElement + e]);
+			}
+
+			for (S32 c = (S32) node.mChildCount - 1; c >= 0; c--)
+			{
+				mStack.push_back(node.mFirstChild + c);
+			}
+		}
+	}
+
+	// Separating axis test, same as LLLineSegmentBoxIntersect in llvolume.cpp.
+	static bool segmentIntersectsBox(const LLVector3& start, const LLVector3& end, const LLVector3& center, const LLVector3& size)
+	{
+		F32 awdu[3];
+		F32 dir[3];
+		F32 diff[3];
+
+		for (U32 i = 0; i < 3; i++)
+		{
+			dir[i] = 0.5f * (end.mV[i] - start.mV[i]);
+			diff[i] = (0.5f * (end.mV[i] + start.mV[i])) - center.mV[i];
+			awdu[i] = fabsf(dir[i]);
+			if (fabsf(diff[i]) > size.mV[i] + awdu[i])
+			{
+				return false;
+			}
+		}
+
+		F32 f;
+		f = dir[1] * diff[2] - dir[2] * diff[1];	if (fabsf(f) > size.mV[1]*awdu[2] + size.mV[2]*awdu[1]) return false;
+		f = dir[2] * diff[0] - dir[0] * diff[2];	if (fabsf(f) > size.mV[0]*awdu[2] + size.mV[2]*awdu[0]) return false;
+		f = dir[0] * diff[1] - dir[1] * diff[0];	if (fabsf(f) > size.mV[0]*awdu[1] + size.mV[1]*awdu[0]) return false;
+
+		return true;
+	}
+
+protected:
+	// Tight bounds over the node's own elements and its (already updated)
+	// children.  Empty nodes fall back to the octree cell.
+	void updateBounds(Node& node)
+	{
+		LLVector3 min, max;
+		bool first = true;
+
+		for (U32 e = 0; e < node.mElementCount; e++)
+		{
+			const T* data = mElements[node.mFirstElement + e];
+			LLVector3 pos(data->getPositionGroup());
+			F32 rad = (F32) data->getBinRadius();
+			LLVector3 ext(rad, rad, rad);
+			expand(min, max, pos - ext, pos + ext, first);
+		}
+
+		for (U32 c = 0; c < node.mChildCount; c++)
+		{
+			const Node& child = mNodes[node.mFirstChild + c];
+			expand(min, max, child.mCenter - child.mSize, child.mCenter + child.mSize, first);
+		}
+
+		if (first)
+		{
+			node.mCenter.setVec(node.mSource->getCenter());
+			node.mSize.setVec(node.mSource->getSize());
+		}
+		else
+		{
+			// pad by a millimeter so center/size rounding never
+			// shaves off the edge of an element
+			node.mCenter = (min + max) * 0.5f;
+			node.mSize = (max - min) * 0.5f + LLVector3(0.001f, 0.001f, 0.001f);
+		}
+	}
+
+	static void expand(LLVector3& min, LLVector3& max, const LLVector3& lo, const LLVector3& hi, bool& first)
+	{
+		if (first)
+		{
+			min = lo;
+			max = hi;
+			first = false;
+			return;
+		}
+
+		for (U32 i = 0; i < 3; i++)
+		{
+			min.mV[i] = llmin(min.mV[i], lo.mV[i]);
+			max.mV[i] = llmax(max.mV[i], hi.mV[i]);
+		}
+	}
+
+	node_list			mNodes;
+	element_list		mElements;
+	mutable std::vector<U32> mStack;
+};
+
+#endif
@@ -0,0 +1,229 @@
+/** 
+ * @file llv4skin.h
+ * @brief LLV4* skinning over runs of vertices that share a weight
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLV4SKIN_H
+#define LL_LLV4SKIN_H
+
+#include <algorithm>
+#include <vector>
+
+#include "llmath.h"
+#include "llstrider.h"
+#include "m3math.h"
+#include "m4math.h"
+#include "v3math.h"
+#include "v4math.h"
+#include "llv4math.h"
+#include "llv4matrix3.h"
+#include "llv4matrix4.h"
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// LLV4SkinRun
+//
+// Avatar vertex weights encode the joint index in the integer part and the
+// blend toward the next joint in the fraction, so every vertex sharing a
+// weight shares a blend matrix.  A run is one such group; the vertex indices
+// belonging to a run live contiguously in the order array at
+// [mStart, mStart + mCount).
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+struct LLV4SkinRun
+{
+	F32		mWeight;
+	U32		mStart;
+	U32		mCount;
+};
+
+class LLV4SkinWeightLess
+{
+public:
+	LLV4SkinWeightLess(const F32* weights) : mWeights(weights) {}
+	bool operator()(U32 a, U32 b) const { return mWeights[a] < mWeights[b]; }
+private:
+	const F32* mWeights;
+};
+
+// Groups vertex indices [0, count) by weight.  Vertices within a run keep
+// their original order, which keeps the output writes mostly sequential.
+inline void llv4skin_build_runs(const F32* weights, U32 count,
+								std::vector<U32>& order,
+								std::vector<LLV4SkinRun>& runs)
+{
+	order.resize(count);
+	runs.clear();
+	for (U32 i = 0; i < count; ++i)
+	{
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), LLV4SkinWeightLess(weights));
+
+	for (U32 i = 0; i < count; ++i)
+	{
+		F32 weight = weights[order[i]];
+		if (runs.empty() || runs.back().mWeight != weight)
+		{
+			LLV4SkinRun run;
+			run.mWeight = weight;
+			run.mStart = i;
+			run.mCount = 0;
+			runs.push_back(run);
+		}
+		runs.back().mCount++;
+	}
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// llv4skin_runs - SSE
+//
+// The blend matrix is built once per run and four vertices are transformed
+// per iteration in structure-of-arrays form.  The multiply-adds happen in the
+// same order as LLV4Matrix4::multiply() and LLV4Matrix3::multiply(), so the
+// results match the per-vertex kernels exactly.  That only holds while the
+// compiler does not fuse the scalar multiply-adds, which it will not with
+// our -msse2 -mfpmath=sse flags but may with FMA enabled (-march=native).
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+#if LL_VECTORIZE
+
+inline void llv4skin_runs(const LLV4Matrix4* joint_mat,
+						  const LLV4SkinRun* runs, U32 num_runs,
+						  const U32* order,
+						  const LLVector3* coords, const LLVector3* normals,
+						  LLStrider<LLVector3>& o_vertices,
+						  LLStrider<LLVector3>& o_normals)
+{
+	LLV4Matrix4 blend_mat;
+	LL_LLV4MATH_ALIGN_PREFIX F32 out[6][4] LL_LLV4MATH_ALIGN_POSTFIX;
+
+	for (U32 r = 0; r < num_runs; ++r)
+	{
+		const LLV4SkinRun& run = runs[r];
+		S32 joint = llfloor(run.mWeight);
+		blend_mat.lerp(joint_mat[joint], joint_mat[joint+1], run.mWeight - joint);
+
+		const __m128 m00 = _mm_set1_ps(blend_mat.mMatrix[VX][VX]);
+		const __m128 m01 = _mm_set1_ps(blend_mat.mMatrix[VX][VY]);
+		const __m128 m02 = _mm_set1_ps(blend_mat.mMatrix[VX][VZ]);
+		const __m128 m10 = _mm_set1_ps(blend_mat.mMatrix[VY][VX]);
+		const __m128 m11 = _mm_set1_ps(blend_mat.mMatrix[VY][VY]);
+		const __m128 m12 = _mm_set1_ps(blend_mat.mMatrix[VY][VZ]);
+		const __m128 m20 = _mm_set1_ps(blend_mat.mMatrix[VZ][VX]);
+		const __m128 m21 = _mm_set1_ps(blend_mat.mMatrix[VZ][VY]);
+		const __m128 m22 = _mm_set1_ps(blend_mat.mMatrix[VZ][VZ]);
+		const __m128 m30 = _mm_set1_ps(blend_mat.mMatrix[VW][VX]);
+		const __m128 m31 = _mm_set1_ps(blend_mat.mMatrix[VW][VY]);
+		const __m128 m32 = _mm_set1_ps(blend_mat.mMatrix[VW][VZ]);
+
+		const U32* idx = order + run.mStart;
+		const U32* idx_end = idx + run.mCount;
+		for ( ; idx + 4 <= idx_end; idx += 4)
+		{
+			const LLVector3& c0 = coords[idx[0]];
+			const LLVector3& c1 = coords[idx[1]];
+			const LLVector3& c2 = coords[idx[2]];
+			const LLVector3& c3 = coords[idx[3]];
+			__m128 x = _mm_setr_ps(c0.mV[VX], c1.mV[VX], c2.mV[VX], c3.mV[VX]);
+			__m128 y = _mm_setr_ps(c0.mV[VY], c1.mV[VY], c2.mV[VY], c3.mV[VY]);
+			__m128 z = _mm_setr_ps(c0.mV[VZ], c1.mV[VZ], c2.mV[VZ], c3.mV[VZ]);
+
+			// ( ax * vx ) + vw, + ( ay * vy ), + ( az * vz )
+			_mm_store_ps(out[0], _mm_add_ps(_mm_add_ps(_mm_add_ps(m30, _mm_mul_ps(x, m00)), _mm_mul_ps(y, m10)), _mm_mul_ps(z, m20)));
+			_mm_store_ps(out[1], _mm_add_ps(_mm_add_ps(_mm_add_ps(m31, _mm_mul_ps(x, m01)), _mm_mul_ps(y, m11)), _mm_mul_ps(z, m21)));
+			_mm_store_ps(out[2], _mm_add_ps(_mm_add_ps(_mm_add_ps(m32, _mm_mul_ps(x, m02)), _mm_mul_ps(y, m12)), _mm_mul_ps(z, m22)));
+
+			const LLVector3& n0 = normals[idx[0]];
+			const LLVector3& n1 = normals[idx[1]];
+			const LLVector3& n2 = normals[idx[2]];
+			const LLVector3& n3 = normals[idx[3]];
+			x = _mm_setr_ps(n0.mV[VX], n1.mV[VX], n2.mV[VX], n3.mV[VX]);
+			y = _mm_setr_ps(n0.mV[VY], n1.mV[VY], n2.mV[VY], n3.mV[VY]);
+			z = _mm_setr_ps(n0.mV[VZ], n1.mV[VZ], n2.mV[VZ], n3.mV[VZ]);
+
+			// ( ax * vx ) + ( ay * vy ) + ( az * vz )
+			_mm_store_ps(out[3], _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m00), _mm_mul_ps(y, m10)), _mm_mul_ps(z, m20)));
+			_mm_store_ps(out[4], _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m01), _mm_mul_ps(y, m11)), _mm_mul_ps(z, m21)));
+			_mm_store_ps(out[5], _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m02), _mm_mul_ps(y, m12)), _mm_mul_ps(z, m22)));
+
+			for (U32 i = 0; i < 4; ++i)
+			{
+				o_vertices[idx[i]].setVec(out[0][i], out[1][i], out[2][i]);
+				o_normals[idx[i]].setVec(out[3][i], out[4][i], out[5][i]);
+			}
+		}
+
+		for ( ; idx < idx_end; ++idx)
+		{
+			blend_mat.multiply(coords[*idx], o_vertices[*idx]);
+			((LLV4Matrix3)blend_mat).multiply(normals[*idx], o_normals[*idx]);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// llv4skin_runs
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+#else
+
+inline void llv4skin_runs(const LLV4Matrix4* joint_mat,
+						  const LLV4SkinRun* runs, U32 num_runs,
+						  const U32* order,
+						  const LLVector3* coords, const LLVector3* normals,
+						  LLStrider<LLVector3>& o_vertices,
+						  LLStrider<LLVector3>& o_normals)
+{
+	LLV4Matrix4 blend_mat;
+
+	for (U32 r = 0; r < num_runs; ++r)
+	{
+		const LLV4SkinRun& run = runs[r];
+		S32 joint = llfloor(run.mWeight);
+		blend_mat.lerp(joint_mat[joint], joint_mat[joint+1], run.mWeight - joint);
+
+		const U32* idx_end = order + run.mStart + run.mCount;
+		for (const U32* idx = order + run.mStart; idx < idx_end; ++idx)
+		{
+			blend_mat.multiply(coords[*idx], o_vertices[*idx]);
+			((LLV4Matrix3)blend_mat).multiply(normals[*idx], o_normals[*idx]);
+		}
+	}
+}
+
+#endif
+
+#endif
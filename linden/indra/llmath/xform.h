@@ -128,6 +128,9 @@ public:
 	const LLVector3&	getPositionW() const		{ return mWorldPosition; }
 	const LLQuaternion& getWorldRotation() const	{ return mWorldRotation; }
 	const LLVector3&	getWorldPosition() const	{ return mWorldPosition; }
+
+	// for callers that compute update() themselves, e.g. LLJointHierarchy
+	void setWorldTransform(const LLVector3& pos, const LLQuaternion& rot)	{ mWorldPosition = pos; mWorldRotation = rot; }
 };
 
 class LLXformMatrix : public LLXform
@@ -137,6 +140,7 @@ public:
 	virtual ~LLXformMatrix();
 
 	const LLMatrix4&    getWorldMatrix() const      { return mWorldMatrix; }
+	LLMatrix4&          getWorldMatrix()            { return mWorldMatrix; }
 	void setWorldMatrix (const LLMatrix4& mat)   { mWorldMatrix = mat; }
 
 	void init()
@@ -491,6 +491,9 @@ public:
 	
 	void removeEasy(Easy* easy);
 
+	S32 getActiveCount() const { return mEasyActiveList.size(); }
+	void setConnectionLimits(S32 pool_size, bool pipeline);
+
 	S32 process();
 	S32 perform();
 	
@@ -503,6 +506,7 @@ private:
 	void easyFree(Easy*);
 	
 	CURLM* mCurlMultiHandle;
+	S32 mPoolSize;
 
 	typedef std::set<Easy*> easy_active_list_t;
 	easy_active_list_t mEasyActiveList;
@@ -514,7 +518,8 @@ private:
 
 LLCurl::Multi::Multi()
 	: mQueued(0),
-	  mErrorCount(0)
+	  mErrorCount(0),
+	  mPoolSize(EASY_HANDLE_POOL_SIZE)
 {
 	mCurlMultiHandle = curl_multi_init();
 	if (!mCurlMultiHandle)
@@ -644,7 +649,7 @@ void LLCurl::Multi::easyFree(Easy* easy)
 {
 	mEasyActiveList.erase(easy);
 	mEasyActiveMap.erase(easy->getCurlHandle());
-	if (mEasyFreeList.size() < EASY_HANDLE_POOL_SIZE)
+	if ((S32)mEasyFreeList.size() < mPoolSize)
 	{
 		easy->resetState();
 		mEasyFreeList.insert(easy);
@@ -661,6 +666,18 @@ void LLCurl::Multi::removeEasy(Easy* easy)
 	easyFree(easy);
 }
 
+// Keep enough idle easy handles (and the connections they hold) around
+// to cover pool_size concurrent requests to the same host, and optionally
+// let libcurl pipeline requests over those connections.
+void LLCurl::Multi::setConnectionLimits(S32 pool_size, bool pipeline)
+{
+	mPoolSize = llmax(pool_size, EASY_HANDLE_POOL_SIZE);
+#if LIBCURL_VERSION_NUM >= 0x071003
+	curl_multi_setopt(mCurlMultiHandle, CURLMOPT_MAXCONNECTS, (long)mPoolSize);
+	curl_multi_setopt(mCurlMultiHandle, CURLMOPT_PIPELINING, pipeline ? 1L : 0L);
+#endif
+}
+
 //static
 std::string LLCurl::strerror(CURLcode errorcode)
 {
@@ -681,7 +698,10 @@ std::string LLCurl::strerror(CURLcode errorcode)
 
 LLCurlRequest::LLCurlRequest() :
 	mActiveMulti(NULL),
-	mActiveRequestCount(0)
+	mActiveRequestCount(0),
+	mKeepConnections(false),
+	mPoolSize(EASY_HANDLE_POOL_SIZE),
+	mPipeline(false)
 {
 	mThreadID = LLThread::currentID();
 }
@@ -696,15 +716,36 @@ void LLCurlRequest::addMulti()
 {
 	llassert_always(mThreadID == LLThread::currentID());
 	LLCurl::Multi* multi = new LLCurl::Multi();
+	if (mKeepConnections)
+	{
+		multi->setConnectionLimits(mPoolSize, mPipeline);
+	}
 	mMultiSet.insert(multi);
 	mActiveMulti = multi;
 	mActiveRequestCount = 0;
 }
 
+void LLCurlRequest::setConnectionLimits(S32 pool_size, bool pipeline)
+{
+	llassert_always(mThreadID == LLThread::currentID());
+	mKeepConnections = true;
+	mPoolSize = pool_size;
+	mPipeline = pipeline;
+	if (mActiveMulti)
+	{
+		mActiveMulti->setConnectionLimits(mPoolSize, mPipeline);
+	}
+}
+
 LLCurl::Easy* LLCurlRequest::allocEasy()
 {
+	// Requests that asked for connection limits only move on to a new
+	// multi when this one is full of requests still in flight (or has
+	// errored); retiring it after a fixed number of requests would throw
+	// away its pooled handles and their connections.
+	S32 request_count = mKeepConnections && mActiveMulti ? mActiveMulti->getActiveCount() : mActiveRequestCount;
 	if (!mActiveMulti ||
-		mActiveRequestCount	>= MAX_ACTIVE_REQUEST_COUNT ||
+		request_count >= MAX_ACTIVE_REQUEST_COUNT ||
 		mActiveMulti->mErrorCount > 0)
 	{
 		addMulti();
@@ -199,6 +199,13 @@ public:
 	S32  process();
 	S32  getQueued();
 
+	// Number of idle handles (connections) to keep per host, and whether
+	// to pipeline requests over them when libcurl supports it.  Once set,
+	// the active multi is kept (with its connections) until it is full of
+	// requests in flight instead of being retired after a fixed number of
+	// requests.  Used by the texture fetcher.
+	void setConnectionLimits(S32 pool_size, bool pipeline);
+
 private:
 	void addMulti();
 	LLCurl::Easy* allocEasy();
@@ -209,6 +216,9 @@ private:
 	curlmulti_set_t mMultiSet;
 	LLCurl::Multi* mActiveMulti;
 	S32 mActiveRequestCount;
+	bool mKeepConnections;
+	S32 mPoolSize;
+	bool mPipeline;
 	U32 mThreadID; // debug
 };
 
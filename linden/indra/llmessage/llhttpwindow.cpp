@@ -0,0 +1,131 @@
+/** 
+ * @file llhttpwindow.cpp
+ * @brief LLHTTPWindow class, sizes a window of concurrent HTTP requests
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llhttpwindow.h"
+#include "llmath.h"
+
+const F32 LATENCY_SMOOTHING = 0.125f;
+const F32 BACKLOG_LOW = 2.f;
+const F32 BACKLOG_HIGH = 6.f;
+const F32 BASE_LATENCY_DRIFT = 1.02f;
+
+LLHTTPWindow::LLHTTPWindow(S32 min_requests, S32 max_requests)
+	: mMaxRequests(0),
+	  mLatency(0.f),
+	  mBaseLatency(0.f),
+	  mThroughput(0.f),
+	  mPeriodBytes(0),
+	  mPeriodRequests(0),
+	  mPeriodFailures(0),
+	  mPeriodInFlight(0),
+	  mPeriodPeak(0)
+{
+	// starts at the lower limit
+	setLimits(min_requests, max_requests);
+}
+
+void LLHTTPWindow::setLimits(S32 min_requests, S32 max_requests)
+{
+	mMinRequestsLimit = llmax(min_requests, 1);
+	mMaxRequestsLimit = llmax(max_requests, mMinRequestsLimit);
+	mMaxRequests = llclamp(mMaxRequests, mMinRequestsLimit, mMaxRequestsLimit);
+}
+
+void LLHTTPWindow::requestStarted(S32 in_flight)
+{
+	mPeriodPeak = llmax(mPeriodPeak, in_flight);
+}
+
+void LLHTTPWindow::requestFinished(F32 seconds, S32 bytes, bool success, S32 in_flight)
+{
+	++mPeriodRequests;
+	if (!success)
+	{
+		++mPeriodFailures;
+		return;
+	}
+	mPeriodBytes += bytes;
+	mPeriodInFlight += in_flight;
+	if (mLatency <= 0.f)
+	{
+		mLatency = seconds;
+		mBaseLatency = seconds;
+	}
+	else
+	{
+		mLatency += (seconds - mLatency) * LATENCY_SMOOTHING;
+		mBaseLatency = llmin(mBaseLatency, seconds);
+	}
+}
+
+void LLHTTPWindow::update(F32 elapsed, F32 max_kbps, S32 in_flight)
+{
+	if (elapsed <= 0.f)
+	{
+		return;
+	}
+
+	mThroughput = (F32)mPeriodBytes / elapsed;
+	S32 max_requests = mMaxRequests;
+	S32 successes = mPeriodRequests - mPeriodFailures;
+	if (mPeriodFailures > 0 && mPeriodFailures * 4 >= mPeriodRequests)
+	{
+		max_requests /= 2;
+	}
+	else if (successes > 0 && mLatency > 0.f)
+	{
+		// the backlog is measured over the requests that were actually
+		// out, which is less than the window when it is not kept full
+		F32 in_flight = (F32)mPeriodInFlight / (F32)successes;
+		F32 backlog = in_flight * (1.f - mBaseLatency / mLatency);
+		F32 kbps = mThroughput * 8.f / 1024.f;
+		if (backlog < BACKLOG_LOW && mPeriodPeak >= max_requests && (max_kbps <= 0.f || kbps < max_kbps))
+		{
+			max_requests += 1 + max_requests / 8;
+		}
+		else if (backlog > BACKLOG_HIGH)
+		{
+			max_requests -= 1;
+		}
+	}
+	mMaxRequests = llclamp(max_requests, mMinRequestsLimit, mMaxRequestsLimit);
+
+	// let the base drift up so a route change does not pin us to a stale best case
+	mBaseLatency = llmin(mBaseLatency * BASE_LATENCY_DRIFT, mLatency);
+	mPeriodBytes = 0;
+	mPeriodRequests = 0;
+	mPeriodFailures = 0;
+	mPeriodInFlight = 0;
+	mPeriodPeak = in_flight;
+}
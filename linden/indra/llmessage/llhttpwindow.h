@@ -0,0 +1,84 @@
+/** 
+ * @file llhttpwindow.h
+ * @brief LLHTTPWindow class, sizes a window of concurrent HTTP requests
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLHTTPWINDOW_H
+#define LL_LLHTTPWINDOW_H
+
+// Sizes a window of concurrent HTTP requests from measured latency and
+// throughput, the same idea as TCP Vegas.  With N requests in flight and no
+// queueing every request takes the base latency; the amount the smoothed
+// latency exceeds it estimates how many of the N are just waiting behind
+// the others at the server or on the link.  The window grows while that
+// backlog is small and the window was actually full, shrinks when it
+// builds up, and halves when the server starts failing requests.
+//
+// Not thread safe; callers lock around it.
+class LLHTTPWindow
+{
+public:
+	LLHTTPWindow(S32 min_requests, S32 max_requests);
+
+	void setLimits(S32 min_requests, S32 max_requests);
+
+	// A request was issued; in_flight includes it.
+	void requestStarted(S32 in_flight);
+
+	// A request took seconds.  in_flight is the number of requests
+	// outstanding when it finished, including it.  Failures are requests
+	// the server could not handle, not ones for missing resources.
+	void requestFinished(F32 seconds, S32 bytes, bool success, S32 in_flight);
+
+	// Resizes the window from the elapsed seconds since the last call.
+	// max_kbps stops growth once throughput reaches it, 0 for no limit.
+	// in_flight is the number of requests outstanding now.
+	void update(F32 elapsed, F32 max_kbps, S32 in_flight);
+
+	S32 getMaxRequests() const		{ return mMaxRequests; }
+	F32 getLatency() const			{ return mLatency; }
+	F32 getBaseLatency() const		{ return mBaseLatency; }
+	F32 getThroughput() const		{ return mThroughput; }
+
+private:
+	S32 mMaxRequests;
+	S32 mMinRequestsLimit;
+	S32 mMaxRequestsLimit;
+	F32 mLatency;			// smoothed request time (seconds)
+	F32 mBaseLatency;		// best recent request time (seconds)
+	F32 mThroughput;		// bytes/sec over the last period
+	S32 mPeriodBytes;
+	S32 mPeriodRequests;
+	S32 mPeriodFailures;
+	S32 mPeriodInFlight;	// sum of in_flight over the successful requests
+	S32 mPeriodPeak;
+};
+
+#endif // LL_LLHTTPWINDOW_H
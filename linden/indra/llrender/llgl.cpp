@@ -266,6 +266,9 @@ PFNGLDRAWRANGEELEMENTSPROC glDrawRangeElements = NULL;
 #endif // LL_LINUX_NV_GL_HEADERS
 #endif
 
+// GL_ARB_draw_instanced (declared in llglheaders.h on every platform)
+PFNLLDRAWELEMENTSINSTANCEDPROC glDrawElementsInstancedLL = NULL;
+
 LLGLManager gGLManager;
 
 LLGLManager::LLGLManager() :
@@ -280,12 +283,14 @@ LLGLManager::LLGLManager() :
 	mHasFramebufferMultisample(FALSE),
 
 	mHasVertexBufferObject(FALSE),
+	mHasPixelBufferObject(FALSE),
 	mHasPBuffer(FALSE),
 	mHasShaderObjects(FALSE),
 	mHasVertexShader(FALSE),
 	mHasFragmentShader(FALSE),
 	mHasOcclusionQuery(FALSE),
 	mHasPointParameters(FALSE),
+	mHasDrawInstanced(FALSE),
 
 	mHasAnisotropic(FALSE),
 	mHasARBEnvCombine(FALSE),
@@ -572,6 +577,11 @@ void LLGLManager::initExtensions()
 # else
 	mHasVertexBufferObject = FALSE;
 # endif
+# if GL_ARB_pixel_buffer_object
+	mHasPixelBufferObject = TRUE;
+# else
+	mHasPixelBufferObject = FALSE;
+# endif
 # if GL_EXT_framebuffer_object
 	mHasFramebufferObject = TRUE;
 # else
@@ -587,6 +597,7 @@ void LLGLManager::initExtensions()
 #else
 	mHasDrawBuffers = FALSE;
 # endif
+	mHasDrawInstanced = FALSE;
 	mHasMipMapGeneration = FALSE;
 	mHasSeparateSpecularColor = FALSE;
 	mHasAnisotropic = FALSE;
@@ -607,11 +618,17 @@ void LLGLManager::initExtensions()
 	mHasCompressedTextures = glh_init_extensions("GL_ARB_texture_compression");
 	mHasOcclusionQuery = ExtensionExists("GL_ARB_occlusion_query", gGLHExts.mSysExts);
 	mHasVertexBufferObject = ExtensionExists("GL_ARB_vertex_buffer_object", gGLHExts.mSysExts);
+	mHasPixelBufferObject = ExtensionExists("GL_ARB_pixel_buffer_object", gGLHExts.mSysExts)
+		|| ExtensionExists("GL_EXT_pixel_buffer_object", gGLHExts.mSysExts);
 	// mask out FBO support when packed_depth_stencil isn't there 'cause we need it for LLRenderTarget -Brad
 	mHasFramebufferObject = ExtensionExists("GL_EXT_framebuffer_object", gGLHExts.mSysExts)
 		&& ExtensionExists("GL_EXT_packed_depth_stencil", gGLHExts.mSysExts);
 	mHasFramebufferMultisample = mHasFramebufferObject && ExtensionExists("GL_EXT_framebuffer_multisample", gGLHExts.mSysExts);
 	mHasDrawBuffers = ExtensionExists("GL_ARB_draw_buffers", gGLHExts.mSysExts);
+#if !LL_DARWIN
+	// not GL_EXT_draw_instanced: simpleInstancedV.glsl needs gl_InstanceIDARB
+	mHasDrawInstanced = ExtensionExists("GL_ARB_draw_instanced", gGLHExts.mSysExts);
+#endif
 #if !LL_DARWIN
 	mHasPointParameters = !mIsATI && ExtensionExists("GL_ARB_point_parameters", gGLHExts.mSysExts);
 #endif
@@ -631,6 +648,7 @@ void LLGLManager::initExtensions()
 		mHasARBEnvCombine = FALSE;
 		mHasCompressedTextures = FALSE;
 		mHasVertexBufferObject = FALSE;
+		mHasPixelBufferObject = FALSE;
 		mHasFramebufferObject = FALSE;
 		mHasFramebufferMultisample = FALSE;
 		mHasDrawBuffers = FALSE;
@@ -643,6 +661,7 @@ void LLGLManager::initExtensions()
 		mHasShaderObjects = FALSE;
 		mHasVertexShader = FALSE;
 		mHasFragmentShader = FALSE;
+		mHasDrawInstanced = FALSE;
 		LL_WARNS("RenderInit") << "GL extension support DISABLED via LL_GL_NOEXT" << LL_ENDL;
 	}
 	else if (getenv("LL_GL_BASICEXT"))	/* Flawfinder: ignore */
@@ -685,6 +704,8 @@ void LLGLManager::initExtensions()
 		if (strchr(blacklist,'q')) mHasFramebufferObject = FALSE;//S
 		if (strchr(blacklist,'r')) mHasDrawBuffers = FALSE;//S
 		if (strchr(blacklist,'s')) mHasFramebufferMultisample = FALSE;
+		if (strchr(blacklist,'t')) mHasPixelBufferObject = FALSE;
+		if (strchr(blacklist,'u')) mHasDrawInstanced = FALSE;
 
 	}
 #endif // LL_LINUX || LL_SOLARIS
@@ -773,6 +794,15 @@ void LLGLManager::initExtensions()
 			mHasVertexBufferObject = FALSE;
 		}
 	}
+	// pixel buffers share the buffer object entry points
+	mHasPixelBufferObject = mHasPixelBufferObject && mHasVertexBufferObject;
+	// instanced draws are only used from vertex shaders (gl_InstanceIDARB)
+	mHasDrawInstanced = mHasDrawInstanced && mHasVertexShader;
+	if (mHasDrawInstanced)
+	{
+		glDrawElementsInstancedLL = (PFNLLDRAWELEMENTSINSTANCEDPROC) GLH_EXT_GET_PROC_ADDRESS("glDrawElementsInstancedARB");
+		mHasDrawInstanced = glDrawElementsInstancedLL != NULL;
+	}
 	if (mHasFramebufferObject)
 	{
 		llinfos << "initExtensions() FramebufferObject-related procs..." << llendl;
@@ -819,5 +819,14 @@ extern void glGetBufferPointervARB (GLenum, GLenum, GLvoid* *);
 
 #endif // LL_MESA / LL_WINDOWS / LL_DARWIN
 
+// GL_ARB_draw_instanced; older glext.h headers don't ship it, so the entry
+// point is declared here and loaded as glDrawElementsInstancedARB.
+#if LL_WINDOWS
+typedef void (APIENTRY * PFNLLDRAWELEMENTSINSTANCEDPROC) (GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLsizei primcount);
+#else
+typedef void (* PFNLLDRAWELEMENTSINSTANCEDPROC) (GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLsizei primcount);
+#endif
+extern PFNLLDRAWELEMENTSINSTANCEDPROC glDrawElementsInstancedLL;
+
 
 #endif // LL_LLGLHEADERS_H
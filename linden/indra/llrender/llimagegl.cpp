@@ -43,6 +43,7 @@
 #include "llmath.h"
 #include "llgl.h"
 #include "llrender.h"
+#include "lltextureuploader.h"
 //----------------------------------------------------------------------------
 
 const F32 MIN_TEXTURE_LIFETIME = 10.f;
@@ -263,6 +264,7 @@ void LLImageGL::destroyGL(BOOL save_state)
 	{
 		gGL.getTexUnit(stage)->unbind(LLTexUnit::TT_TEXTURE);
 	}
+	LLTextureUploader::destroyGL();
 	
 	sAllowReadBackRaw = true ;
 	for (std::set<LLImageGL*>::iterator iter = sImageList.begin();
@@ -414,10 +416,12 @@ void LLImageGL::init(BOOL usemipmaps)
 
 	mIsMask = FALSE;
 	mCategory = -1 ;
+	mPendingUpload = NULL;
 }
 
 void LLImageGL::cleanup()
 {
+	cancelUpload();
 	if (!gGLManager.mIsDisabled)
 	{
 		destroyGLTexture();
@@ -989,37 +993,9 @@ BOOL LLImageGL::createGLTexture(S32 discard_level, const LLImageRaw* imageraw, S
 	// setSize may call destroyGLTexture if the size does not match
 	setSize(w, h, imageraw->getComponents());
 
-	if( !mHasExplicitFormat )
+	if( !mHasExplicitFormat && !setDefaultFormat() )
 	{
-		switch (mComponents)
-		{
-		  case 1:
-			// Use luminance alpha (for fonts)
-			mFormatInternal = GL_LUMINANCE8;
-			mFormatPrimary = GL_LUMINANCE;
-			mFormatType = GL_UNSIGNED_BYTE;
-			break;
-		  case 2:
-			// Use luminance alpha (for fonts)
-			mFormatInternal = GL_LUMINANCE8_ALPHA8;
-			mFormatPrimary = GL_LUMINANCE_ALPHA;
-			mFormatType = GL_UNSIGNED_BYTE;
-			break;
-		  case 3:
-			mFormatInternal = GL_RGB8;
-			mFormatPrimary = GL_RGB;
-			mFormatType = GL_UNSIGNED_BYTE;
-			break;
-		  case 4:
-			mFormatInternal = GL_RGBA8;
-			mFormatPrimary = GL_RGBA;
-			mFormatType = GL_UNSIGNED_BYTE;
-			break;
-		  default:
-			LL_DEBUGS("Openjpeg") << "Bad number of components for texture: " << (U32)getComponents() << LL_ENDL;
-			to_create = false;
-			break;
-		}
+		to_create = false;
 	}
 
 	if(!to_create) //not create a gl texture
@@ -1035,9 +1011,192 @@ BOOL LLImageGL::createGLTexture(S32 discard_level, const LLImageRaw* imageraw, S
 	return createGLTexture(discard_level, rawdata, FALSE, usename);
 }
 
+BOOL LLImageGL::setDefaultFormat()
+{
+	switch (mComponents)
+	{
+	  case 1:
+		// Use luminance alpha (for fonts)
+		mFormatInternal = GL_LUMINANCE8;
+		mFormatPrimary = GL_LUMINANCE;
+		mFormatType = GL_UNSIGNED_BYTE;
+		break;
+	  case 2:
+		// Use luminance alpha (for fonts)
+		mFormatInternal = GL_LUMINANCE8_ALPHA8;
+		mFormatPrimary = GL_LUMINANCE_ALPHA;
+		mFormatType = GL_UNSIGNED_BYTE;
+		break;
+	  case 3:
+		mFormatInternal = GL_RGB8;
+		mFormatPrimary = GL_RGB;
+		mFormatType = GL_UNSIGNED_BYTE;
+		break;
+	  case 4:
+		mFormatInternal = GL_RGBA8;
+		mFormatPrimary = GL_RGBA;
+		mFormatType = GL_UNSIGNED_BYTE;
+		break;
+	  default:
+		LL_DEBUGS("Openjpeg") << "Bad number of components for texture: " << (U32)getComponents() << LL_ENDL;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+BOOL LLImageGL::createGLTextureAsync(S32 discard_level, const LLImageRaw* imageraw, S32 category)
+{
+	if (gGLManager.mIsDisabled || !LLTextureUploader::canUpload())
+	{
+		return FALSE;
+	}
+	if (discard_level < 0)
+	{
+		return FALSE;
+	}
+	discard_level = llclamp(discard_level, 0, (S32)mMaxDiscardLevel);
+
+	// setSize may call destroyGLTexture if the size does not match
+	setSize(imageraw->getWidth() << discard_level, imageraw->getHeight() << discard_level, imageraw->getComponents());
+
+	if (!mHasExplicitFormat && !setDefaultFormat())
+	{
+		return FALSE;
+	}
+	if (mFormatType != GL_UNSIGNED_BYTE || mFormatSwapBytes ||
+		(mFormatPrimary >= GL_COMPRESSED_RGBA_S3TC_DXT1_EXT && mFormatPrimary <= GL_COMPRESSED_RGBA_S3TC_DXT5_EXT))
+	{
+		return FALSE;
+	}
+
+	cancelUpload();
+	mPendingUpload = LLTextureUploader::queue(this, discard_level, imageraw);
+	if (!mPendingUpload)
+	{
+		return FALSE;
+	}
+	mCategory = category;
+	return TRUE;
+}
+
+void LLImageGL::cancelUpload()
+{
+	if (mPendingUpload)
+	{
+		LLTextureUploader::cancel(mPendingUpload);
+		mPendingUpload = NULL;
+	}
+}
+
+// Called by LLTextureUploader once every level of tex_name is in,
+// the tail end of createGLTexture()
+void LLImageGL::finishUpload(LLGLuint tex_name, S32 discard_level, BOOL is_mask, const LLImageRaw* imageraw)
+{
+	mPendingUpload = NULL;
+
+	U32 old_name = mTexName;
+	mTexName = tex_name;
+	mCurrentDiscardLevel = discard_level;
+	mHasMipMaps = mUseMipMaps;
+	mIsMask = is_mask;
+	updatePickMask(imageraw->getWidth(), imageraw->getHeight(), imageraw->getData());
+
+	// Set texture options to our defaults.
+	llverify(gGL.getTexUnit(0)->bind(this));
+	gGL.getTexUnit(0)->setHasMipMaps(mHasMipMaps);
+	gGL.getTexUnit(0)->setTextureAddressMode(mAddressMode);
+	gGL.getTexUnit(0)->setTextureFilteringOption(mFilterOption);
+	gGL.getTexUnit(0)->unbind(mBindTarget);
+	stop_glerror();
+
+	if (old_name != 0)
+	{
+		sGlobalTextureMemoryInBytes -= mTextureMemory;
+
+		if(gAuditTexture)
+		{
+			decTextureCounter() ;
+		}
+
+		LLImageGL::deleteTextures(1, &old_name);
+
+		stop_glerror();
+	}
+
+	mTextureMemory = getMipBytes(discard_level);
+	sGlobalTextureMemoryInBytes += mTextureMemory;
+	setActive() ;
+
+	if(gAuditTexture)
+	{
+		incTextureCounter() ;
+	}
+	// mark this as bound at this point, so we don't throw it out immediately
+	mLastBindTime = sLastFrameTime;
+	mGLTextureCreated = true;
+}
+
+BOOL LLImageGL::createGLTexture(S32 discard_level, LLImageDXT* dxt, S32 usename)
+{
+	if (gGLManager.mIsDisabled)
+	{
+		llwarns << "Trying to create a texture while GL is disabled!" << llendl;
+		return FALSE;
+	}
+
+	llassert_always(dxt);
+	GLenum format;
+	switch (dxt->getFileFormat())
+	{
+	  // No RGB DXT1 in dataFormatBits(), the RGBA variant decodes opaque
+	  // blocks (color0 > color1) identically
+	  case LLImageDXT::FORMAT_DXR1: format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; break;
+	  case LLImageDXT::FORMAT_DXR3: format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT; break;
+	  case LLImageDXT::FORMAT_DXR5: format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+	  default:
+		llwarns << "Can't upload LLImageDXT format " << dxt->getFileFormat() << llendl;
+		return FALSE;
+	}
+
+	if (!mUseMipMaps)
+	{
+		llwarns << "Compressed texture upload needs mipmaps" << llendl;
+		return FALSE;
+	}
+
+	mGLTextureCreated = false;
+	llassert(gGLManager.mInited);
+	stop_glerror();
+
+	S32 source_discard = dxt->getSourceDiscard();
+	if (discard_level < source_discard)
+	{
+		discard_level = source_discard;
+	}
+
+	// setSize may call destroyGLTexture if the size does not match
+	setSize(dxt->getWidth() << source_discard, dxt->getHeight() << source_discard, dxt->getComponents());
+	discard_level = llclamp(discard_level, 0, (S32)mMaxDiscardLevel);
+
+	// Not an explicit format: the next raw upload picks its own again
+	mFormatInternal = format;
+	mFormatPrimary = format;
+	mFormatType = GL_UNSIGNED_BYTE;
+	mFormatSwapBytes = FALSE;
+	mIsMask = dxt->isAlphaMask() ? TRUE : FALSE;
+	// no pick mask from compressed data, picks hit the whole face
+	updatePickMask(0, 0, NULL);
+
+	// the file is ordered smallest mip first, setImage() walks back from the largest
+	const U8* data = dxt->getData() + dxt->getMipOffset(discard_level - source_discard);
+	return createGLTexture(discard_level, data, TRUE, usename);
+}
+
 BOOL LLImageGL::createGLTexture(S32 discard_level, const U8* data_in, BOOL data_hasmips, S32 usename)
 {
 	llassert(data_in);
+	// a synchronous upload supersedes any pending one
+	cancelUpload();
 
 	if (discard_level < 0)
 	{
@@ -1295,6 +1454,7 @@ BOOL LLImageGL::readBackRaw(S32 discard_level, LLImageRaw* imageraw, bool compre
 
 void LLImageGL::destroyGLTexture()
 {
+	cancelUpload();
 	if (mTexName != 0)
 	{
 		stop_glerror();
@@ -1481,8 +1641,14 @@ void LLImageGL::analyzeAlpha(const void* data_in, S32 w, S32 h)
 		return;
 	}
 
+	mIsMask = checkAlphaMask((const U8*) data_in, w, h, stride);
+}
+
+//static
+BOOL LLImageGL::checkAlphaMask(const U8* data, S32 w, S32 h, S32 stride)
+{
 	U32 length = w * h;
-	const GLubyte* current = ((const GLubyte*) data_in)+stride-1;
+	const U8* current = data+stride-1;
 	
 	S32 sample[16];
 	memset(sample, 0, sizeof(S32)*16);
@@ -1499,14 +1665,7 @@ void LLImageGL::analyzeAlpha(const void* data_in, S32 w, S32 h)
 		total += sample[i];
 	}
 
-	if (total > length/16)
-	{
-		mIsMask = FALSE;
-	}
-	else
-	{
-		mIsMask = TRUE;
-	}
+	return total > length/16 ? FALSE : TRUE;
 }
 
 BOOL LLImageGL::isDeleted()  
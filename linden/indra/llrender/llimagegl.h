@@ -35,6 +35,7 @@
 #define LL_LLIMAGEGL_H
 
 #include "llimage.h"
+#include "llimagedxt.h"
 
 #include "llgltypes.h"
 #include "llmemory.h"
@@ -42,6 +43,8 @@
 
 #include "llrender.h"
 
+class LLTextureUpload;
+
 #define BYTES_TO_MEGA_BYTES(x) ((x) >> 20)
 #define MEGA_BYTES_TO_BYTES(x) ((x) << 20)
 
@@ -49,6 +52,7 @@
 class LLImageGL : public LLRefCount
 {
 	friend class LLTexUnit;
+	friend class LLTextureUploader;
 public:
 	// Size calculation
 	static S32 dataFormatBits(S32 dataformat);
@@ -70,6 +74,10 @@ public:
 	S32 updateBoundTexMem()const;
 	
 	static bool checkSize(S32 width, S32 height);
+
+	// TRUE if the alpha channel (the last of stride bytes per texel) is
+	// almost entirely 0 or 255.  Thread safe, used by analyzeAlpha().
+	static BOOL checkAlphaMask(const U8* data, S32 w, S32 h, S32 stride);
 	
 	// Not currently necessary for LLImageGL, but required in some derived classes,
 	// so include for compatability
@@ -105,6 +113,14 @@ public:
 	BOOL createGLTexture(S32 discard_level, const LLImageRaw* imageraw, S32 usename = 0, BOOL to_create = TRUE, 
 		S32 category = sMaxCatagories - 1);
 	BOOL createGLTexture(S32 discard_level, const U8* data, BOOL data_hasmips = FALSE, S32 usename = 0);
+	// Upload the precompressed mips of dxt, whose largest mip is at dxt->getSourceDiscard()
+	BOOL createGLTexture(S32 discard_level, LLImageDXT* dxt, S32 usename = 0);
+	// Like createGLTexture(discard_level, imageraw) but over the next few
+	// frames (see LLTextureUploader); the current texture stays in use until
+	// then.  FALSE if it has to be uploaded synchronously.
+	BOOL createGLTextureAsync(S32 discard_level, const LLImageRaw* imageraw, S32 category = sMaxCatagories - 1);
+	BOOL hasPendingUpload() const { return mPendingUpload != NULL; }
+	void cancelUpload();
 	void setImage(const LLImageRaw* imageraw);
 	void setImage(const U8* data_in, BOOL data_hasmips = FALSE);
 	BOOL setSubImage(const LLImageRaw* imageraw, S32 x_pos, S32 y_pos, S32 width, S32 height, BOOL force_fast_update = FALSE);
@@ -182,6 +198,10 @@ protected:
 	void init(BOOL usemipmaps);
 	virtual void cleanup(); // Clean up the LLImageGL so it can be reinitialized.  Be careful when using this in derived class destructors
 
+private:
+	BOOL setDefaultFormat(); // GL formats from mComponents
+	void finishUpload(LLGLuint tex_name, S32 discard_level, BOOL is_mask, const LLImageRaw* imageraw);
+
 public:
 	// Various GL/Rendering options
 	S32 mTextureMemory;
@@ -189,6 +209,7 @@ public:
 	
 private:
 	LLPointer<LLImageRaw> mSaveData; // used for destroyGL/restoreGL
+	LLTextureUpload* mPendingUpload;
 	U8* mPickMask;  //downsampled bitmap approximation of alpha channel.  NULL if no alpha channel
 	U32 mPickMaskSize;
 	S8 mUseMipMaps;
@@ -0,0 +1,506 @@
+/** 
+ * @file lltextureuploader.cpp
+ * @brief Asynchronous texture uploads through pixel buffer objects.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include "lltextureuploader.h"
+
+#include "llapr.h"
+#include "llgl.h"
+#include "llglheaders.h"
+#include "llimage.h"
+#include "llimagegl.h"
+#include "llrender.h"
+#include "llthreadpool.h"
+#include "lltimer.h"
+
+#ifndef GL_PIXEL_UNPACK_BUFFER_ARB
+#define GL_PIXEL_UNPACK_BUFFER_ARB 0x88EC
+#endif
+
+// Mip levels start on this boundary inside the buffer
+const S32 UPLOAD_LEVEL_ALIGNMENT = 16;
+// Buffers are allocated in steps of this, so they can be reused for similar sizes
+const S32 UPLOAD_BUFFER_GRANULARITY = 64 * 1024;
+
+//============================================================================
+
+class LLTextureUpload : public LLThreadPool::Job
+{
+public:
+	LLTextureUpload()
+		: mImage(NULL),
+		  mDiscard(0),
+		  mComponents(0),
+		  mAlphaStride(0),
+		  mFormatInternal(0),
+		  mFormatPrimary(0),
+		  mFormatType(0),
+		  mTarget(GL_TEXTURE_2D),
+		  mBytes(0),
+		  mTexName(0),
+		  mBuffer(0),
+		  mBufferSize(0),
+		  mMappedData(NULL),
+		  mNextLevel(-1),
+		  mIsMask(FALSE),
+		  mFilled(0),
+		  mUnmapped(false)
+	{
+	}
+
+	/*virtual*/ void run();
+
+	LLImageGL* mImage;			// NULL once cancelled
+	LLPointer<LLImageRaw> mRaw;
+	S32 mDiscard;
+	S32 mComponents;
+	S32 mAlphaStride;			// bytes per texel when the last one is alpha, else 0
+	LLGLint mFormatInternal;
+	LLGLenum mFormatPrimary;
+	LLGLenum mFormatType;
+	LLGLenum mTarget;
+
+	// per GL level, level 0 is the largest
+	std::vector<S32> mWidths;
+	std::vector<S32> mHeights;
+	std::vector<S32> mOffsets;
+	S32 mBytes;
+
+	LLGLuint mTexName;			// the texture being filled
+	LLGLuint mBuffer;
+	S32 mBufferSize;
+	U8* mMappedData;
+	S32 mNextLevel;				// next level to transfer, counting down to 0
+
+	BOOL mIsMask;				// from the worker
+	LLAtomicS32 mFilled;		// set by the worker when mMappedData is complete
+	bool mUnmapped;
+	LLTimer mTimer;
+};
+
+// WORKER thread: copy the image in and build the smaller mips next to it.
+// The mapped memory is write only, so mips are generated from a scratch copy.
+void LLTextureUpload::run()
+{
+	const U8* src = mRaw->getData();
+	S32 levels = (S32) mOffsets.size();
+
+	memcpy(mMappedData + mOffsets[0], src, mWidths[0] * mHeights[0] * mComponents);
+	if (mAlphaStride)
+	{
+		mIsMask = LLImageGL::checkAlphaMask(src, mWidths[0], mHeights[0], mAlphaStride);
+	}
+
+	std::vector<U8> prev;
+	std::vector<U8> cur;
+	const U8* prev_data = src;
+	for (S32 level = 1; level < levels; level++)
+	{
+		S32 w = mWidths[level];
+		S32 h = mHeights[level];
+		cur.resize(w * h * mComponents);
+		LLImageBase::generateMip(prev_data, &cur[0], w, h, mComponents);
+		memcpy(mMappedData + mOffsets[level], &cur[0], cur.size());
+		prev.swap(cur);
+		prev_data = &prev[0];
+	}
+
+	mFilled = 1;
+}
+
+//============================================================================
+
+BOOL LLTextureUploader::sEnabled = TRUE;
+S32 LLTextureUploader::sMaxBytesPerFrame = 4 * 1024 * 1024;
+S32 LLTextureUploader::sMaxBytesInFlight = 32 * 1024 * 1024;
+U32 LLTextureUploader::sNumUploads = 0;
+U32 LLTextureUploader::sNumFallbacks = 0;
+LLStat LLTextureUploader::sLatencyStat(64);
+LLStat LLTextureUploader::sBytesStat(32, TRUE);
+LLThreadPool* LLTextureUploader::sThreadPool = NULL;
+std::deque<LLTextureUpload*> LLTextureUploader::sUploads;
+std::vector<LLTextureUploader::Buffer> LLTextureUploader::sFreeBuffers;
+S32 LLTextureUploader::sBytesInFlight = 0;
+
+//static
+void LLTextureUploader::initClass(U32 num_threads, bool threaded)
+{
+	if (!sThreadPool)
+	{
+		sThreadPool = new LLThreadPool("Texture Upload", num_threads, threaded);
+	}
+}
+
+//static
+void LLTextureUploader::cleanupClass()
+{
+	destroyGL();
+	if (sThreadPool)
+	{
+		sThreadPool->shutdown();
+		delete sThreadPool;
+		sThreadPool = NULL;
+	}
+}
+
+//static
+void LLTextureUploader::destroyGL()
+{
+	if (sThreadPool)
+	{
+		// buffers can't be unmapped while a worker is still writing them
+		sThreadPool->waitForJobs();
+	}
+	for (std::deque<LLTextureUpload*>::iterator iter = sUploads.begin();
+		 iter != sUploads.end(); ++iter)
+	{
+		LLTextureUpload* upload = *iter;
+		if (upload->mImage)
+		{
+			upload->mImage->mPendingUpload = NULL;
+			sNumFallbacks++;
+		}
+		if (!gGLManager.mIsDisabled)
+		{
+			unmap(upload);
+			LLImageGL::deleteTextures(1, &upload->mTexName);
+		}
+		releaseBuffer(upload);
+		delete upload;
+	}
+	sUploads.clear();
+
+	if (!gGLManager.mIsDisabled)
+	{
+		for (U32 i = 0; i < sFreeBuffers.size(); i++)
+		{
+			glDeleteBuffersARB(1, &sFreeBuffers[i].mName);
+		}
+	}
+	sFreeBuffers.clear();
+	sBytesInFlight = 0;
+}
+
+//static
+bool LLTextureUploader::canUpload()
+{
+	return sEnabled && sThreadPool && gGLManager.mHasPixelBufferObject && !gGLManager.mIsDisabled;
+}
+
+//static
+LLTextureUpload* LLTextureUploader::queue(LLImageGL* image, S32 discard_level, const LLImageRaw* imageraw)
+{
+	if (!canUpload())
+	{
+		return NULL;
+	}
+
+	LLTextureUpload* upload = new LLTextureUpload;
+	upload->mImage = image;
+	upload->mRaw = const_cast<LLImageRaw*>(imageraw);
+	upload->mDiscard = discard_level;
+	upload->mComponents = imageraw->getComponents();
+	upload->mFormatInternal = image->mFormatInternal;
+	upload->mFormatPrimary = image->mFormatPrimary;
+	upload->mFormatType = image->mFormatType;
+	upload->mTarget = image->mTarget;
+	switch (image->mFormatPrimary)
+	{
+	  case GL_LUMINANCE:
+	  case GL_ALPHA:
+		upload->mAlphaStride = 1;
+		break;
+	  case GL_LUMINANCE_ALPHA:
+		upload->mAlphaStride = 2;
+		break;
+	  case GL_RGBA:
+	  case GL_BGRA_EXT:
+		upload->mAlphaStride = 4;
+		break;
+	  default:
+		upload->mAlphaStride = 0;
+		break;
+	}
+
+	S32 last_discard = image->getUseMipMaps() ? image->getMaxDiscardLevel() : discard_level;
+	S32 offset = 0;
+	for (S32 d = discard_level; d <= last_discard; d++)
+	{
+		S32 w = image->getWidth(d);
+		S32 h = image->getHeight(d);
+		upload->mWidths.push_back(w);
+		upload->mHeights.push_back(h);
+		upload->mOffsets.push_back(offset);
+		offset += (w * h * upload->mComponents + UPLOAD_LEVEL_ALIGNMENT - 1) & ~(UPLOAD_LEVEL_ALIGNMENT - 1);
+	}
+	upload->mBytes = offset;
+	upload->mNextLevel = (S32) upload->mOffsets.size() - 1;
+
+	if (sBytesInFlight + upload->mBytes > sMaxBytesInFlight || !acquireBuffer(upload))
+	{
+		delete upload;
+		sNumFallbacks++;
+		return NULL;
+	}
+
+	LLImageGL::generateTextures(1, &upload->mTexName);
+	sBytesInFlight += upload->mBufferSize;
+	sUploads.push_back(upload);
+	sThreadPool->addJob(upload);
+	return upload;
+}
+
+//static
+void LLTextureUploader::cancel(LLTextureUpload* upload)
+{
+	// the worker may still be filling the buffer, update() cleans up
+	upload->mImage = NULL;
+}
+
+//static
+bool LLTextureUploader::acquireBuffer(LLTextureUpload* upload)
+{
+	S32 size = (upload->mBytes + UPLOAD_BUFFER_GRANULARITY - 1) & ~(UPLOAD_BUFFER_GRANULARITY - 1);
+
+	// smallest free buffer that fits
+	S32 best = -1;
+	for (U32 i = 0; i < sFreeBuffers.size(); i++)
+	{
+		if (sFreeBuffers[i].mSize >= size &&
+			(best < 0 || sFreeBuffers[i].mSize < sFreeBuffers[best].mSize))
+		{
+			best = i;
+		}
+	}
+	if (best >= 0)
+	{
+		upload->mBuffer = sFreeBuffers[best].mName;
+		upload->mBufferSize = sFreeBuffers[best].mSize;
+		sFreeBuffers.erase(sFreeBuffers.begin() + best);
+	}
+	else
+	{
+		glGenBuffersARB(1, &upload->mBuffer);
+		upload->mBufferSize = size;
+	}
+
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, upload->mBuffer);
+	// orphan the old contents, the GPU may still be reading them
+	glBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, upload->mBufferSize, NULL, GL_STREAM_DRAW_ARB);
+	upload->mMappedData = (U8*) glMapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+	stop_glerror();
+
+	if (!upload->mMappedData)
+	{
+		llwarns << "Failed to map a " << upload->mBufferSize << " byte pixel buffer" << llendl;
+		glDeleteBuffersARB(1, &upload->mBuffer);
+		upload->mBuffer = 0;
+		return false;
+	}
+	return true;
+}
+
+//static
+void LLTextureUploader::releaseBuffer(LLTextureUpload* upload)
+{
+	if (!upload->mBuffer)
+	{
+		return;
+	}
+	if (gGLManager.mIsDisabled)
+	{
+		upload->mBuffer = 0;
+		return;
+	}
+
+	// keep recently used buffers around, up to the in flight limit
+	S32 free_bytes = 0;
+	for (U32 i = 0; i < sFreeBuffers.size(); i++)
+	{
+		free_bytes += sFreeBuffers[i].mSize;
+	}
+	if (free_bytes + upload->mBufferSize <= sMaxBytesInFlight)
+	{
+		Buffer buffer;
+		buffer.mName = upload->mBuffer;
+		buffer.mSize = upload->mBufferSize;
+		sFreeBuffers.push_back(buffer);
+	}
+	else
+	{
+		glDeleteBuffersARB(1, &upload->mBuffer);
+	}
+	upload->mBuffer = 0;
+}
+
+//static
+bool LLTextureUploader::unmap(LLTextureUpload* upload)
+{
+	if (upload->mUnmapped || !upload->mBuffer)
+	{
+		return true;
+	}
+	upload->mUnmapped = true;
+	upload->mMappedData = NULL;
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, upload->mBuffer);
+	// FALSE means the contents were lost (e.g. a mode switch) while mapped
+	bool res = glUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB) ? true : false;
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+	stop_glerror();
+	return res;
+}
+
+// Issue level transfers, smallest first, until max_bytes have gone out.
+// Returns the bytes transferred.
+//static
+S32 LLTextureUploader::transfer(LLTextureUpload* upload, S32 max_bytes)
+{
+	S32 levels = (S32) upload->mOffsets.size();
+	LLTexUnit::eTextureType bind_target = LLTexUnit::TT_TEXTURE;
+
+	gGL.getTexUnit(0)->unbind(bind_target);
+	llverify(gGL.getTexUnit(0)->bindManual(bind_target, upload->mTexName));
+	if (upload->mNextLevel == levels - 1)
+	{
+		glTexParameteri(upload->mTarget, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(upload->mTarget, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	}
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, upload->mBuffer);
+
+	S32 bytes = 0;
+	while (upload->mNextLevel >= 0)
+	{
+		S32 level = upload->mNextLevel;
+		S32 level_bytes = upload->mWidths[level] * upload->mHeights[level] * upload->mComponents;
+		if (bytes > 0 && bytes + level_bytes > max_bytes)
+		{
+			break;
+		}
+		// with a buffer bound the pointer argument is an offset into it
+		LLImageGL::setManualImage(upload->mTarget, level, upload->mFormatInternal,
+								  upload->mWidths[level], upload->mHeights[level],
+								  upload->mFormatPrimary, upload->mFormatType,
+								  (const void*)(size_t) upload->mOffsets[level]);
+		bytes += level_bytes;
+		upload->mNextLevel--;
+	}
+
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+	gGL.getTexUnit(0)->unbind(bind_target);
+	stop_glerror();
+	return bytes;
+}
+
+//static
+void LLTextureUploader::finish(LLTextureUpload* upload)
+{
+	LLImageGL* image = upload->mImage;
+	image->finishUpload(upload->mTexName, upload->mDiscard, upload->mIsMask, upload->mRaw);
+	upload->mTexName = 0; // owned by the image now
+
+	sNumUploads++;
+	sLatencyStat.addValue(upload->mTimer.getElapsedTimeF32() * 1000.f);
+}
+
+//static
+F32 LLTextureUploader::update(F32 max_time)
+{
+	LLTimer timer;
+	if (sUploads.empty())
+	{
+		sBytesStat.addValue(0);
+		return 0.f;
+	}
+	sThreadPool->reapJobs();
+
+	S32 bytes = 0;
+	std::deque<LLTextureUpload*>::iterator iter = sUploads.begin();
+	while (iter != sUploads.end())
+	{
+		LLTextureUpload* upload = *iter;
+		if (!upload->mFilled)
+		{
+			++iter;
+			continue;
+		}
+
+		bool done = false;
+		if (!unmap(upload))
+		{
+			llwarns << "Pixel buffer contents lost, uploading synchronously" << llendl;
+			if (upload->mImage)
+			{
+				LLImageGL* image = upload->mImage;
+				image->mPendingUpload = NULL;
+				image->createGLTexture(upload->mDiscard, upload->mRaw, 0, TRUE, image->getCategory());
+				sNumFallbacks++;
+			}
+			done = true;
+		}
+		else if (!upload->mImage)
+		{
+			// cancelled
+			done = true;
+		}
+		else if (bytes < sMaxBytesPerFrame && timer.getElapsedTimeF32() < max_time)
+		{
+			bytes += transfer(upload, sMaxBytesPerFrame - bytes);
+			if (upload->mNextLevel < 0)
+			{
+				finish(upload);
+				done = true;
+			}
+		}
+
+		if (done)
+		{
+			if (upload->mTexName)
+			{
+				LLImageGL::deleteTextures(1, &upload->mTexName);
+			}
+			sBytesInFlight -= upload->mBufferSize;
+			releaseBuffer(upload);
+			delete upload;
+			iter = sUploads.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+
+	sBytesStat.addValue(bytes);
+	return timer.getElapsedTimeF32();
+}
@@ -0,0 +1,112 @@
+/** 
+ * @file lltextureuploader.h
+ * @brief Asynchronous texture uploads through pixel buffer objects.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LLTEXTUREUPLOADER_H
+#define LL_LLTEXTUREUPLOADER_H
+
+#include <deque>
+#include <vector>
+
+#include "llgltypes.h"
+#include "llstat.h"
+
+class LLImageGL;
+class LLImageRaw;
+class LLTextureUpload;
+class LLThreadPool;
+
+// LLTextureUploader moves the expensive half of LLImageGL::createGLTexture()
+// off the frame.  The main thread maps a pixel buffer object and hands it to
+// a worker, which copies the raw image in and builds the rest of the mip
+// chain next to it.  Once the buffer is filled the main thread unmaps it and
+// issues one glTexImage2D per mip level sourced from the buffer, so the
+// driver can DMA the data while we keep going.  Levels go out smallest
+// first, a few per frame within a byte and time budget, into a fresh
+// texture name; the image keeps drawing its old texture until the last
+// level is in and the names are swapped.
+//
+// Without GL_ARB_pixel_buffer_object, or when the buffers in flight would
+// go over sMaxBytesInFlight, queue() returns NULL and the caller uploads
+// synchronously as before.
+
+class LLTextureUploader
+{
+public:
+	static void initClass(U32 num_threads, bool threaded);
+	static void cleanupClass();
+	// GL context is going away, drop everything in flight
+	static void destroyGL();
+
+	static bool canUpload();
+
+	// MAIN thread, ONLY called from LLImageGL
+	static LLTextureUpload* queue(LLImageGL* image, S32 discard_level, const LLImageRaw* imageraw);
+	static void cancel(LLTextureUpload* upload);
+
+	// MAIN thread, once per frame.  Returns the time spent.
+	static F32 update(F32 max_time);
+
+	static S32 getNumPending()		{ return (S32) sUploads.size(); }
+	static S32 getBytesInFlight()	{ return sBytesInFlight; }
+
+	// Settings
+	static BOOL sEnabled;
+	static S32 sMaxBytesPerFrame;	// transfer budget
+	static S32 sMaxBytesInFlight;	// mapped and transferring buffers
+
+	// Stats
+	static U32 sNumUploads;			// completed asynchronously
+	static U32 sNumFallbacks;		// handed back for a synchronous upload
+	static LLStat sLatencyStat;		// ms from queue() to the texture being swapped in
+	static LLStat sBytesStat;		// bytes transferred per frame
+
+private:
+	static bool acquireBuffer(LLTextureUpload* upload);
+	static void releaseBuffer(LLTextureUpload* upload);
+	static bool unmap(LLTextureUpload* upload);
+	static S32 transfer(LLTextureUpload* upload, S32 max_bytes);
+	static void finish(LLTextureUpload* upload);
+
+	struct Buffer
+	{
+		LLGLuint mName;
+		S32 mSize;
+	};
+
+	static LLThreadPool* sThreadPool;
+	static std::deque<LLTextureUpload*> sUploads;	// in queue order
+	static std::vector<Buffer> sFreeBuffers;
+	static S32 sBytesInFlight;
+};
+
+#endif // LL_LLTEXTUREUPLOADER_H
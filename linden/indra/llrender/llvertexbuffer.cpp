@@ -32,6 +32,7 @@
 
 #include "linden_common.h"
 
+#include <algorithm>
 #include <boost/static_assert.hpp>
 
 #include "llvertexbuffer.h"
@@ -49,6 +50,13 @@ LLVBOPool LLVertexBuffer::sDynamicVBOPool;
 LLVBOPool LLVertexBuffer::sStreamIBOPool;
 LLVBOPool LLVertexBuffer::sDynamicIBOPool;
 
+const U32 VBO_POOL_ALIGN = 64;
+
+LLVBOArena LLVertexBuffer::sStaticVBOArena(GL_ARRAY_BUFFER_ARB, 4*1024*1024);
+LLVBOArena LLVertexBuffer::sStaticIBOArena(GL_ELEMENT_ARRAY_BUFFER_ARB, 1024*1024);
+LLVBORing LLVertexBuffer::sStreamVBORing(GL_ARRAY_BUFFER_ARB, 4*1024*1024);
+LLVBORing LLVertexBuffer::sStreamIBORing(GL_ELEMENT_ARRAY_BUFFER_ARB, 1024*1024);
+
 U32 LLVertexBuffer::sBindCount = 0;
 U32 LLVertexBuffer::sSetCount = 0;
 S32 LLVertexBuffer::sCount = 0;
@@ -57,13 +65,17 @@ S32 LLVertexBuffer::sMappedCount = 0;
 BOOL LLVertexBuffer::sEnableVBOs = TRUE;
 U32 LLVertexBuffer::sGLRenderBuffer = 0;
 U32 LLVertexBuffer::sGLRenderIndices = 0;
+U32 LLVertexBuffer::sGLRenderOffset = 0;
 U32 LLVertexBuffer::sLastMask = 0;
 BOOL LLVertexBuffer::sVBOActive = FALSE;
 BOOL LLVertexBuffer::sIBOActive = FALSE;
 U32 LLVertexBuffer::sAllocatedBytes = 0;
+U32 LLVertexBuffer::sUploadBytes = 0;
 BOOL LLVertexBuffer::sMapped = FALSE;
+BOOL LLVertexBuffer::sUsePools = TRUE;
 
 std::vector<U32> LLVertexBuffer::sDeleteList;
+std::vector<LLVertexBuffer*> LLVertexBuffer::sReleaseList;
 
 S32 LLVertexBuffer::sTypeOffsets[LLVertexBuffer::TYPE_MAX] =
 {
@@ -91,6 +103,307 @@ U32 LLVertexBuffer::sGLMode[LLRender::NUM_MODES] =
 	GL_LINE_LOOP,
 };
 
+static U32 align_pool_size(U32 size)
+{
+	return (size + VBO_POOL_ALIGN - 1) & ~(VBO_POOL_ALIGN - 1);
+}
+
+//============================================================================
+
+LLVBOArena::LLVBOArena(U32 target, U32 block_size)
+	: mTarget(target),
+	  mBlockSize(block_size),
+	  mCapacity(0),
+	  mUsedBytes(0)
+{
+}
+
+LLVBOArena::~LLVBOArena()
+{
+	// GL names go away with the context, see cleanup()
+}
+
+void LLVBOArena::allocate(U32 size, U32& name, U32& offset)
+{
+	size = align_pool_size(size);
+
+	//first fit
+	for (U32 i = 0; i < mBlocks.size(); i++)
+	{
+		Block& block = mBlocks[i];
+		for (range_map_t::iterator iter = block.mFree.begin(); iter != block.mFree.end(); ++iter)
+		{
+			if (iter->second >= size)
+			{
+				name = block.mName;
+				offset = iter->first;
+				U32 remaining = iter->second - size;
+				block.mFree.erase(iter);
+				if (remaining)
+				{
+					block.mFree[offset + size] = remaining;
+				}
+				block.mAllocated[offset] = size;
+				block.mUsed += size;
+				mUsedBytes += size;
+				return;
+			}
+		}
+	}
+
+	//no room anywhere, add a block
+	Block block;
+	block.mSize = llmax(size, mBlockSize);
+	block.mUsed = size;
+	glGenBuffersARB(1, (GLuint*) &block.mName);
+	glBindBufferARB(mTarget, block.mName);
+	glBufferDataARB(mTarget, block.mSize, NULL, GL_STATIC_DRAW_ARB);
+	glBindBufferARB(mTarget, 0);
+	stop_glerror();
+
+	if (block.mSize > size)
+	{
+		block.mFree[size] = block.mSize - size;
+	}
+	block.mAllocated[0] = size;
+
+	mBlocks.push_back(block);
+	mCapacity += block.mSize;
+	mUsedBytes += size;
+
+	name = block.mName;
+	offset = 0;
+}
+
+void LLVBOArena::release(U32 name, U32 offset)
+{
+	for (U32 i = 0; i < mBlocks.size(); i++)
+	{
+		Block& block = mBlocks[i];
+		if (block.mName != name)
+		{
+			continue;
+		}
+
+		range_map_t::iterator alloc = block.mAllocated.find(offset);
+		if (alloc == block.mAllocated.end())
+		{
+			llerrs << "Released a range that was never allocated from this arena." << llendl;
+		}
+		U32 size = alloc->second;
+		block.mAllocated.erase(alloc);
+		block.mUsed -= size;
+		mUsedBytes -= size;
+
+		//merge with the following free range
+		range_map_t::iterator next = block.mFree.lower_bound(offset);
+		if (next != block.mFree.end() && next->first == offset + size)
+		{
+			size += next->second;
+			block.mFree.erase(next);
+		}
+
+		//merge with the preceding free range
+		range_map_t::iterator prev = block.mFree.lower_bound(offset);
+		if (prev != block.mFree.begin() &&
+			(--prev)->first + prev->second == offset)
+		{
+			prev->second += size;
+		}
+		else
+		{
+			block.mFree[offset] = size;
+		}
+
+		//give back empty blocks, but keep one around to avoid thrashing
+		if (block.mUsed == 0 && (mBlocks.size() > 1 || block.mSize > mBlockSize))
+		{
+			LLVertexBuffer::sDeleteList.push_back(block.mName);
+			mCapacity -= block.mSize;
+			mBlocks.erase(mBlocks.begin() + i);
+		}
+		return;
+	}
+
+	// name not found: the arena was cleaned up under this buffer
+}
+
+void LLVBOArena::cleanup()
+{
+	for (U32 i = 0; i < mBlocks.size(); i++)
+	{
+		LLVertexBuffer::sDeleteList.push_back(mBlocks[i].mName);
+	}
+	mBlocks.clear();
+	mCapacity = 0;
+	mUsedBytes = 0;
+}
+
+U32 LLVBOArena::getLargestFree() const
+{
+	U32 largest = 0;
+	for (U32 i = 0; i < mBlocks.size(); i++)
+	{
+		const range_map_t& free_list = mBlocks[i].mFree;
+		for (range_map_t::const_iterator iter = free_list.begin(); iter != free_list.end(); ++iter)
+		{
+			largest = llmax(largest, iter->second);
+		}
+	}
+	return largest;
+}
+
+F32 LLVBOArena::getFragmentation() const
+{
+	U32 free_bytes = mCapacity - mUsedBytes;
+	if (!free_bytes)
+	{
+		return 0.f;
+	}
+	return 1.f - (F32) getLargestFree() / (F32) free_bytes;
+}
+
+//============================================================================
+
+LLVBORing::LLVBORing(U32 target, U32 size)
+	: mTarget(target),
+	  mName(0),
+	  mSize(size),
+	  mHead(0),
+	  mUsedBytes(0),
+	  mFrame(0)
+{
+}
+
+LLVBORing::~LLVBORing()
+{
+	// GL names go away with the context, see cleanup()
+}
+
+BOOL LLVBORing::allocate(U32 size, LLVertexBuffer* owner, U32& name, U32& offset)
+{
+	size = align_pool_size(size);
+	if (size > mSize / RING_FRAMES)
+	{ //would not leave room for the frames in flight
+		return FALSE;
+	}
+
+	if (!mName)
+	{
+		glGenBuffersARB(1, (GLuint*) &mName);
+		glBindBufferARB(mTarget, mName);
+		glBufferDataARB(mTarget, mSize, NULL, GL_STREAM_DRAW_ARB);
+		glBindBufferARB(mTarget, 0);
+		stop_glerror();
+	}
+
+	while (1)
+	{
+		if (mRanges.empty())
+		{
+			mHead = 0;
+			offset = 0;
+			break;
+		}
+
+		U32 tail = mRanges.front().mOffset;
+		if (mHead > tail)
+		{ //free space is [head, end) and [0, tail)
+			if (mHead + size <= mSize)
+			{
+				offset = mHead;
+				break;
+			}
+			if (size <= tail)
+			{
+				offset = 0;
+				break;
+			}
+		}
+		else if (mHead + size <= tail)
+		{ //wrapped, free space is [head, tail)
+			offset = mHead;
+			break;
+		}
+
+		if (!retireFront())
+		{
+			return FALSE;
+		}
+	}
+
+	Range range;
+	range.mOffset = offset;
+	range.mSize = size;
+	range.mFrame = mFrame;
+	range.mOwner = owner;
+	mRanges.push_back(range);
+
+	mHead = offset + size;
+	mUsedBytes += size;
+	name = mName;
+	return TRUE;
+}
+
+void LLVBORing::release(U32 offset, LLVertexBuffer* owner)
+{
+	//owners usually release recent ranges, search from the back
+	for (std::deque<Range>::reverse_iterator iter = mRanges.rbegin(); iter != mRanges.rend(); ++iter)
+	{
+		if (iter->mOffset == offset && iter->mOwner == owner)
+		{
+			iter->mOwner = NULL;
+			iter->mFrame = mFrame;
+			return;
+		}
+	}
+	// not found: evicted or cleaned up
+}
+
+BOOL LLVBORing::retireFront()
+{
+	if (mRanges.empty())
+	{
+		return FALSE;
+	}
+
+	Range& range = mRanges.front();
+	if (range.mFrame + RING_FRAMES > mFrame)
+	{ //the GPU may still be reading it
+		return FALSE;
+	}
+
+	if (range.mOwner)
+	{
+		range.mOwner->evictFromRing();
+	}
+	mUsedBytes -= range.mSize;
+	mRanges.pop_front();
+	return TRUE;
+}
+
+void LLVBORing::cleanup()
+{
+	for (U32 i = 0; i < mRanges.size(); i++)
+	{
+		if (mRanges[i].mOwner)
+		{
+			mRanges[i].mOwner->evictFromRing();
+		}
+	}
+	mRanges.clear();
+
+	if (mName)
+	{
+		LLVertexBuffer::sDeleteList.push_back(mName);
+		mName = 0;
+	}
+	mHead = 0;
+	mUsedBytes = 0;
+}
+
+//============================================================================
+
 //static
 void LLVertexBuffer::setupClientArrays(U32 data_mask)
 {
@@ -228,6 +541,48 @@ void LLVertexBuffer::drawRange(U32 mode, U32 start, U32 end, U32 count, U32 indi
 	stop_glerror();
 }
 
+void LLVertexBuffer::drawInstanced(U32 mode, U32 start, U32 end, U32 count, U32 indices_offset, U32 instances) const
+{
+	if (start >= (U32) mRequestedNumVerts ||
+		end >= (U32) mRequestedNumVerts)
+	{
+		llerrs << "Bad vertex buffer draw range: [" << start << ", " << end << "]" << llendl;
+	}
+
+	if (indices_offset >= (U32) mRequestedNumIndices ||
+		indices_offset + count > (U32) mRequestedNumIndices)
+	{
+		llerrs << "Bad index buffer draw range: [" << indices_offset << ", " << indices_offset+count << "]" << llendl;
+	}
+
+	if (mGLIndices != sGLRenderIndices)
+	{
+		llerrs << "Wrong index buffer bound." << llendl;
+	}
+
+	if (mGLBuffer != sGLRenderBuffer)
+	{
+		llerrs << "Wrong vertex buffer bound." << llendl;
+	}
+
+	if (mode > LLRender::NUM_MODES)
+	{
+		llerrs << "Invalid draw mode: " << mode << llendl;
+		return;
+	}
+
+	if (!gGLManager.mHasDrawInstanced)
+	{
+		llerrs << "Instanced draw without GL_ARB_draw_instanced." << llendl;
+		return;
+	}
+
+	stop_glerror();
+	glDrawElementsInstancedLL(sGLMode[mode], count, GL_UNSIGNED_SHORT, 
+		((U16*) getIndicesPointer()) + indices_offset, instances);
+	stop_glerror();
+}
+
 void LLVertexBuffer::draw(U32 mode, U32 count, U32 indices_offset) const
 {
 	if (indices_offset >= (U32) mRequestedNumIndices ||
@@ -308,6 +663,7 @@ void LLVertexBuffer::unbind()
 
 	sGLRenderBuffer = 0;
 	sGLRenderIndices = 0;
+	sGLRenderOffset = 0;
 
 	setupClientArrays(0);
 }
@@ -317,9 +673,40 @@ void LLVertexBuffer::cleanupClass()
 {
 	LLMemType mt(LLMemType::MTYPE_VERTEX_DATA);
 	unbind();
+	sStaticVBOArena.cleanup();
+	sStaticIBOArena.cleanup();
+	sStreamVBORing.cleanup();
+	sStreamIBORing.cleanup();
+	releaseClientData();
 	clientCopy(); // deletes GL buffers
 }
 
+//static
+void LLVertexBuffer::nextFrame()
+{
+	sStreamVBORing.nextFrame();
+	sStreamIBORing.nextFrame();
+	releaseClientData();
+}
+
+//static
+void LLVertexBuffer::releaseClientData()
+{
+	for (U32 i = 0; i < sReleaseList.size(); i++)
+	{
+		LLVertexBuffer* buffer = sReleaseList[i];
+		if (buffer->mReleaseQueued && !buffer->mLocked)
+		{
+			delete [] buffer->mClientData;
+			buffer->mClientData = NULL;
+			delete [] buffer->mClientIndexData;
+			buffer->mClientIndexData = NULL;
+		}
+		buffer->mReleaseQueued = FALSE;
+	}
+	sReleaseList.clear();
+}
+
 void LLVertexBuffer::clientCopy(F64 max_time)
 {
 	if (!sDeleteList.empty())
@@ -334,6 +721,9 @@ void LLVertexBuffer::clientCopy(F64 max_time)
 LLVertexBuffer::LLVertexBuffer(U32 typemask, S32 usage) :
 	LLRefCount(),
 	mNumVerts(0), mNumIndices(0), mUsage(usage), mGLBuffer(0), mGLIndices(0), 
+	mGLOffset(0), mGLIndicesOffset(0), mPoolType(POOL_NONE),
+	mClientData(NULL), mClientIndexData(NULL), mClientDirty(FALSE),
+	mOwnsGLBuffer(FALSE), mOwnsGLIndices(FALSE), mReleaseQueued(FALSE),
 	mMappedData(NULL),
 	mMappedIndexData(NULL), mLocked(FALSE),
 	mFinal(FALSE),
@@ -347,6 +737,18 @@ LLVertexBuffer::LLVertexBuffer(U32 typemask, S32 usage) :
 	{
 		mUsage = 0 ; 
 	}
+
+	if (sUsePools && useVBOs())
+	{
+		if (mUsage == GL_STATIC_DRAW_ARB)
+		{
+			mPoolType = POOL_ARENA;
+		}
+		else if (mUsage == GL_STREAM_DRAW_ARB)
+		{
+			mPoolType = POOL_RING;
+		}
+	}
 	
 	S32 stride = calcStride(typemask, mOffsets);
 
@@ -380,6 +782,10 @@ S32 LLVertexBuffer::calcStride(const U32& typemask, S32* offsets)
 LLVertexBuffer::~LLVertexBuffer()
 {
 	LLMemType mt(LLMemType::MTYPE_VERTEX_DATA);
+	if (mReleaseQueued)
+	{
+		sReleaseList.erase(std::find(sReleaseList.begin(), sReleaseList.end(), this));
+	}
 	destroyGLBuffer();
 	destroyGLIndices();
 	sCount--;
@@ -389,9 +795,19 @@ LLVertexBuffer::~LLVertexBuffer()
 
 void LLVertexBuffer::genBuffer()
 {
-	if (mUsage == GL_STREAM_DRAW_ARB)
+	mGLOffset = 0;
+	mOwnsGLBuffer = FALSE;
+	if (mPoolType == POOL_ARENA)
+	{
+		sStaticVBOArena.allocate(getSize(), mGLBuffer, mGLOffset);
+	}
+	else if (mPoolType == POOL_RING && sStreamVBORing.allocate(getSize(), this, mGLBuffer, mGLOffset))
+	{
+	}
+	else if (mUsage == GL_STREAM_DRAW_ARB)
 	{
 		mGLBuffer = sStreamVBOPool.allocate();
+		mOwnsGLBuffer = TRUE;
 	}
 	else if (mUsage == GL_DYNAMIC_DRAW_ARB)
 	{
@@ -407,9 +823,19 @@ void LLVertexBuffer::genBuffer()
 
 void LLVertexBuffer::genIndices()
 {
-	if (mUsage == GL_STREAM_DRAW_ARB)
+	mGLIndicesOffset = 0;
+	mOwnsGLIndices = FALSE;
+	if (mPoolType == POOL_ARENA)
+	{
+		sStaticIBOArena.allocate(getIndicesSize(), mGLIndices, mGLIndicesOffset);
+	}
+	else if (mPoolType == POOL_RING && sStreamIBORing.allocate(getIndicesSize(), this, mGLIndices, mGLIndicesOffset))
+	{
+	}
+	else if (mUsage == GL_STREAM_DRAW_ARB)
 	{
 		mGLIndices = sStreamIBOPool.allocate();
+		mOwnsGLIndices = TRUE;
 	}
 	else if (mUsage == GL_DYNAMIC_DRAW_ARB)
 	{
@@ -425,7 +851,15 @@ void LLVertexBuffer::genIndices()
 
 void LLVertexBuffer::releaseBuffer()
 {
-	if (mUsage == GL_STREAM_DRAW_ARB)
+	if (mPoolType == POOL_ARENA)
+	{
+		sStaticVBOArena.release(mGLBuffer, mGLOffset);
+	}
+	else if (mPoolType == POOL_RING && !mOwnsGLBuffer)
+	{
+		sStreamVBORing.release(mGLOffset, this);
+	}
+	else if (mUsage == GL_STREAM_DRAW_ARB)
 	{
 		sStreamVBOPool.release(mGLBuffer);
 	}
@@ -442,7 +876,15 @@ void LLVertexBuffer::releaseBuffer()
 
 void LLVertexBuffer::releaseIndices()
 {
-	if (mUsage == GL_STREAM_DRAW_ARB)
+	if (mPoolType == POOL_ARENA)
+	{
+		sStaticIBOArena.release(mGLIndices, mGLIndicesOffset);
+	}
+	else if (mPoolType == POOL_RING && !mOwnsGLIndices)
+	{
+		sStreamIBORing.release(mGLIndicesOffset, this);
+	}
+	else if (mUsage == GL_STREAM_DRAW_ARB)
 	{
 		sStreamIBOPool.release(mGLIndices);
 	}
@@ -478,7 +920,20 @@ void LLVertexBuffer::createGLBuffer()
 	{
 		mMappedData = NULL;
 		genBuffer();
-		mResized = TRUE;
+		if (mPoolType == POOL_NONE)
+		{
+			mResized = TRUE;
+		}
+		else
+		{
+			unbind(); // a new block or ring may have been bound
+			if (mPoolType == POOL_RING)
+			{ //streamed buffers keep a client copy to re-upload from
+				mClientData = new U8[size];
+				memset(mClientData, 0, size);
+				mClientDirty = TRUE;
+			}
+		}
 	}
 	else
 	{
@@ -510,7 +965,20 @@ void LLVertexBuffer::createGLIndices()
 	{
 		mMappedIndexData = NULL;
 		genIndices();
-		mResized = TRUE;
+		if (mPoolType == POOL_NONE)
+		{
+			mResized = TRUE;
+		}
+		else
+		{
+			unbind();
+			if (mPoolType == POOL_RING)
+			{
+				mClientIndexData = new U8[size];
+				memset(mClientIndexData, 0, size);
+				mClientDirty = TRUE;
+			}
+		}
 	}
 	else
 	{
@@ -533,6 +1001,8 @@ void LLVertexBuffer::destroyGLBuffer()
 				llerrs << "Vertex buffer destroyed while mapped!" << llendl;
 			}
 			releaseBuffer();
+			delete [] mClientData;
+			mClientData = NULL;
 		}
 		else
 		{
@@ -545,6 +1015,7 @@ void LLVertexBuffer::destroyGLBuffer()
 	}
 	
 	mGLBuffer = 0;
+	mGLOffset = 0;
 	unbind();
 }
 
@@ -560,6 +1031,8 @@ void LLVertexBuffer::destroyGLIndices()
 				llerrs << "Vertex buffer destroyed while mapped." << llendl;
 			}
 			releaseIndices();
+			delete [] mClientIndexData;
+			mClientIndexData = NULL;
 		}
 		else
 		{
@@ -572,6 +1045,7 @@ void LLVertexBuffer::destroyGLIndices()
 	}
 
 	mGLIndices = 0;
+	mGLIndicesOffset = 0;
 	unbind();
 }
 
@@ -684,7 +1158,15 @@ void LLVertexBuffer::resizeBuffer(S32 newnverts, S32 newnindices)
 			else
 			{
 				//delete old buffer, keep GL buffer for now
-				if (!useVBOs())
+				if (mPoolType == POOL_RING)
+				{ //contents are discarded like glBufferData(NULL), the next upload takes a range of the new size
+					delete [] mClientData;
+					mClientData = new U8[newsize];
+					memset(mClientData, 0, newsize);
+					mClientDirty = TRUE;
+					mEmpty = TRUE;
+				}
+				else if (!useVBOs())
 				{
 					U8* old = mMappedData;
 					mMappedData = new U8[newsize];
@@ -704,7 +1186,7 @@ void LLVertexBuffer::resizeBuffer(S32 newnverts, S32 newnindices)
 						mEmpty = TRUE;
 					}
 				}
-				mResized = TRUE;
+				mResized = mPoolType != POOL_RING;
 			}
 		}
 		else if (mGLBuffer)
@@ -720,7 +1202,15 @@ void LLVertexBuffer::resizeBuffer(S32 newnverts, S32 newnindices)
 			}
 			else
 			{
-				if (!useVBOs())
+				if (mPoolType == POOL_RING)
+				{
+					delete [] mClientIndexData;
+					mClientIndexData = new U8[new_index_size];
+					memset(mClientIndexData, 0, new_index_size);
+					mClientDirty = TRUE;
+					mEmpty = TRUE;
+				}
+				else if (!useVBOs())
 				{
 					//delete old buffer, keep GL buffer for now
 					U8* old = mMappedIndexData;
@@ -741,7 +1231,7 @@ void LLVertexBuffer::resizeBuffer(S32 newnverts, S32 newnindices)
 						mEmpty = TRUE;
 					}
 				}
-				mResized = TRUE;
+				mResized = mPoolType != POOL_RING;
 			}
 		}
 		else if (mGLIndices)
@@ -789,7 +1279,23 @@ U8* LLVertexBuffer::mapBuffer(S32 access)
 		llerrs << "LLVertexBuffer::mapBuffer() called on unallocated buffer." << llendl;
 	}
 		
-	if (!mLocked && useVBOs())
+	if (!mLocked && useVBOs() && mPoolType != POOL_NONE)
+	{ //pooled buffers are written in client memory and uploaded on unmap
+		if (!mClientData && getSize())
+		{
+			mClientData = new U8[getSize()];
+		}
+		if (!mClientIndexData && getIndicesSize())
+		{
+			mClientIndexData = new U8[getIndicesSize()];
+		}
+		mLocked = TRUE;
+		mReleaseQueued = FALSE;
+		mMappedData = mClientData;
+		mMappedIndexData = mClientIndexData;
+		sMappedCount++;
+	}
+	else if (!mLocked && useVBOs())
 	{
 		setBuffer(0);
 		mLocked = TRUE;
@@ -845,11 +1351,25 @@ void LLVertexBuffer::unmapBuffer()
 	{
 		if (useVBOs() && mLocked)
 		{
-			stop_glerror();
-			glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
-			stop_glerror();
-			glUnmapBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB);
-			stop_glerror();
+			if (mPoolType != POOL_NONE)
+			{
+				uploadClientData();
+				if (mPoolType == POOL_ARENA && !mReleaseQueued)
+				{ //static buffers are only written once, but a deferred writer may
+				  //still hold the client copy, so free it at the next frame
+					mReleaseQueued = TRUE;
+					sReleaseList.push_back(this);
+				}
+			}
+			else
+			{
+				stop_glerror();
+				glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
+				stop_glerror();
+				glUnmapBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB);
+				stop_glerror();
+				sUploadBytes += getSize() + getIndicesSize();
+			}
 
 			/*if (!sMapped)
 			{
@@ -879,6 +1399,66 @@ void LLVertexBuffer::unmapBuffer()
 
 //----------------------------------------------------------------------------
 
+// Hand pooled client data to GL.  Arena buffers write into their own range
+// of a shared block, ring buffers take a fresh range for every upload so the
+// GPU can keep reading the previous one.
+void LLVertexBuffer::uploadClientData()
+{
+	LLMemType mt(LLMemType::MTYPE_VERTEX_DATA);
+
+	if (mPoolType == POOL_RING)
+	{
+		if (mClientData)
+		{
+			releaseBuffer();
+			genBuffer();
+		}
+		if (mClientIndexData)
+		{
+			releaseIndices();
+			genIndices();
+		}
+	}
+
+	stop_glerror();
+	if (mGLBuffer && mClientData)
+	{
+		glBindBufferARB(GL_ARRAY_BUFFER_ARB, mGLBuffer);
+		if (mOwnsGLBuffer)
+		{
+			glBufferDataARB(GL_ARRAY_BUFFER_ARB, getSize(), mClientData, mUsage);
+		}
+		else
+		{
+			glBufferSubDataARB(GL_ARRAY_BUFFER_ARB, mGLOffset, getSize(), mClientData);
+		}
+		sVBOActive = TRUE;
+		sUploadBytes += getSize();
+	}
+	if (mGLIndices && mClientIndexData)
+	{
+		glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, mGLIndices);
+		if (mOwnsGLIndices)
+		{
+			glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, getIndicesSize(), mClientIndexData, mUsage);
+		}
+		else
+		{
+			glBufferSubDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, mGLIndicesOffset, getIndicesSize(), mClientIndexData);
+		}
+		sIBOActive = TRUE;
+		sUploadBytes += getIndicesSize();
+	}
+	stop_glerror();
+
+	//bindings changed behind setBuffer's back
+	sGLRenderBuffer = 0;
+	sGLRenderIndices = 0;
+	mClientDirty = FALSE;
+}
+
+//----------------------------------------------------------------------------
+
 template <class T,S32 type> struct VertexBufferStrider
 {
 	typedef LLStrider<T> strider_t;
@@ -990,6 +1570,23 @@ void LLVertexBuffer::setBuffer(U32 data_mask)
 
 	if (useVBOs())
 	{
+		if (mPoolType != POOL_NONE)
+		{ //get pooled data to GL before binding
+			if (mLocked)
+			{
+				unmapBuffer();
+			}
+			else if (mClientDirty)
+			{
+				uploadClientData();
+			}
+		}
+
+		if (mGLBuffer && mGLOffset != sGLRenderOffset)
+		{
+			setup = TRUE; // ... or another range of a shared buffer is in use
+		}
+
 		if (mGLBuffer && (mGLBuffer != sGLRenderBuffer || !sVBOActive))
 		{
 			/*if (sMapped)
@@ -1111,6 +1708,7 @@ void LLVertexBuffer::setBuffer(U32 data_mask)
 	if (mGLBuffer)
 	{
 		sGLRenderBuffer = mGLBuffer;
+		sGLRenderOffset = mGLOffset;
 		if (data_mask && setup)
 		{
 			setupVertexBuffer(data_mask); // subclass specific setup (virtual function)
@@ -1124,7 +1722,7 @@ void LLVertexBuffer::setupVertexBuffer(U32 data_mask) const
 {
 	LLMemType mt(LLMemType::MTYPE_VERTEX_DATA);
 	stop_glerror();
-	U8* base = useVBOs() ? NULL : mMappedData;
+	U8* base = getVerticesPointer();
 	S32 stride = mStride;
 
 	if ((data_mask & mTypeMask) != data_mask)
@@ -44,6 +44,8 @@
 #include <set>
 #include <vector>
 #include <list>
+#include <map>
+#include <deque>
 
 //============================================================================
 // NOTES
@@ -74,6 +76,97 @@ protected:
 };
 
 
+//============================================================================
+// sub-allocated buffer objects
+
+class LLVertexBuffer;
+
+// LLVBOArena carves large GL buffer objects ("blocks") into ranges, so that
+// thousands of small static vertex buffers share a handful of GL names.
+// Each block keeps an address ordered free list; allocation is first fit
+// and released ranges are merged with their neighbours.  Requests larger
+// than the block size get a block of their own.
+class LLVBOArena
+{
+public:
+	LLVBOArena(U32 target, U32 block_size);
+	~LLVBOArena();
+
+	void allocate(U32 size, U32& name, U32& offset);
+	void release(U32 name, U32 offset);
+	void cleanup(); // delete every block (and GL name)
+
+	U32 getBlockCount() const	{ return mBlocks.size(); }
+	U32 getCapacity() const		{ return mCapacity; }
+	U32 getUsedBytes() const	{ return mUsedBytes; }
+	U32 getLargestFree() const;
+	// 0 when all free space is one contiguous range, approaching 1 as the
+	// free space is shattered into ranges too small to be useful
+	F32 getFragmentation() const;
+
+private:
+	typedef std::map<U32, U32> range_map_t; // offset -> size
+
+	struct Block
+	{
+		U32 mName;
+		U32 mSize;
+		U32 mUsed;
+		range_map_t mFree;
+		range_map_t mAllocated;
+	};
+
+	U32 mTarget;
+	U32 mBlockSize;
+	U32 mCapacity;
+	U32 mUsedBytes;
+	std::vector<Block> mBlocks;
+};
+
+// LLVBORing streams frequently rewritten geometry through one large GL
+// buffer object.  Every upload takes a fresh range at the head of the ring;
+// a range is only written again once its owner has moved on and RING_FRAMES
+// frames have passed, so the driver never has to wait for the GPU to finish
+// reading it.  Owners that have not uploaded in RING_FRAMES frames can be
+// evicted when the ring is full; they re-upload from their client copy the
+// next time they are drawn.
+class LLVBORing
+{
+public:
+	enum { RING_FRAMES = 3 };
+
+	LLVBORing(U32 target, U32 size);
+	~LLVBORing();
+
+	// returns FALSE if the ring can not hold size bytes right now
+	BOOL allocate(U32 size, LLVertexBuffer* owner, U32& name, U32& offset);
+	void release(U32 offset, LLVertexBuffer* owner);
+	void nextFrame()			{ mFrame++; }
+	void cleanup();
+
+	U32 getSize() const			{ return mSize; }
+	U32 getUsedBytes() const	{ return mUsedBytes; }
+
+private:
+	BOOL retireFront();
+
+	struct Range
+	{
+		U32 mOffset;
+		U32 mSize;
+		U32 mFrame;		// frame the range was written or released
+		LLVertexBuffer* mOwner;	// NULL once released
+	};
+
+	U32 mTarget;
+	U32 mName;
+	U32 mSize;
+	U32 mHead;
+	U32 mUsedBytes;
+	U32 mFrame;
+	std::deque<Range> mRanges; // oldest first
+};
+
 //============================================================================
 // base class
 
@@ -85,11 +178,18 @@ public:
 	static LLVBOPool sStreamIBOPool;
 	static LLVBOPool sDynamicIBOPool;
 
+	static LLVBOArena sStaticVBOArena;
+	static LLVBOArena sStaticIBOArena;
+	static LLVBORing sStreamVBORing;
+	static LLVBORing sStreamIBORing;
+
 	static void initClass(bool use_vbo);
 	static void cleanupClass();
 	static void setupClientArrays(U32 data_mask);
  	static void clientCopy(F64 max_time = 0.005); //copy data from client to GL
 	static void unbind(); //unbind any bound vertex buffer
+	static void nextFrame(); //call once per frame, recycles streaming ranges
+	static void releaseClientData(); //frees client copies of arena buffers unmapped since the last frame
 
 	//get the size of a vertex with the given typemask
 	//if offsets is not NULL, its contents will be filled
@@ -126,8 +226,16 @@ public:
 		MAP_CLOTHWEIGHT = (1<<TYPE_CLOTHWEIGHT),
 	};
 	
+	enum EPoolType
+	{
+		POOL_NONE = 0,	// own GL buffer objects, mapped with glMapBuffer
+		POOL_ARENA,		// static, sub-allocated from sStaticVBOArena
+		POOL_RING		// streaming, uploaded into sStreamVBORing
+	};
+
 protected:
 	friend class LLRender;
+	friend class LLVBORing;
 
 	virtual ~LLVertexBuffer(); // use unref()
 
@@ -145,6 +253,8 @@ protected:
 	void	updateNumIndices(S32 nindices); 
 	virtual BOOL	useVBOs() const;
 	void	unmapBuffer();
+	void	uploadClientData();
+	void	evictFromRing()		{ mClientDirty = TRUE; }
 		
 public:
 	LLVertexBuffer(U32 typemask, S32 usage);
@@ -181,8 +291,9 @@ public:
 	S32 getRequestedVerts() const			{ return mRequestedNumVerts; }
 	S32 getRequestedIndices() const			{ return mRequestedNumIndices; }
 
-	U8* getIndicesPointer() const			{ return useVBOs() ? NULL : mMappedIndexData; }
-	U8* getVerticesPointer() const			{ return useVBOs() ? NULL : mMappedData; }
+	// pointers to hand to GL: offsets into the bound buffer objects when using VBOs
+	U8* getIndicesPointer() const			{ return useVBOs() ? (U8*) mGLIndicesOffset : mMappedIndexData; }
+	U8* getVerticesPointer() const			{ return useVBOs() ? (U8*) mGLOffset : mMappedData; }
 	S32 getStride() const					{ return mStride; }
 	S32 getTypeMask() const					{ return mTypeMask; }
 	BOOL hasDataType(S32 type) const		{ return ((1 << type) & getTypeMask()) ? TRUE : FALSE; }
@@ -192,6 +303,7 @@ public:
 	U8* getMappedIndices() const			{ return mMappedIndexData; }
 	S32 getOffset(S32 type) const			{ return mOffsets[type]; }
 	S32 getUsage() const					{ return mUsage; }
+	U32 getPoolType() const					{ return mPoolType; }
 
 	void setStride(S32 type, S32 new_stride);
 	
@@ -200,6 +312,8 @@ public:
 	void draw(U32 mode, U32 count, U32 indices_offset) const;
 	void drawArrays(U32 mode, U32 offset, U32 count) const;
 	void drawRange(U32 mode, U32 start, U32 end, U32 count, U32 indices_offset) const;
+	// Draws the range instances times; requires gGLManager.mHasDrawInstanced.
+	void drawInstanced(U32 mode, U32 start, U32 end, U32 count, U32 indices_offset, U32 instances) const;
 
 protected:	
 	S32		mNumVerts;		// Number of vertices allocated
@@ -212,6 +326,15 @@ protected:
 	S32		mUsage;			// GL usage
 	U32		mGLBuffer;		// GL VBO handle
 	U32		mGLIndices;		// GL IBO handle
+	U32		mGLOffset;		// byte offset of this buffer's vertices in mGLBuffer
+	U32		mGLIndicesOffset;	// byte offset of this buffer's indices in mGLIndices
+	U32		mPoolType;		// EPoolType
+	U8*		mClientData;	// pooled buffers are written here and uploaded on unmap
+	U8*		mClientIndexData;
+	BOOL	mClientDirty;	// client data must be uploaded before the next draw
+	BOOL	mOwnsGLBuffer;	// ring buffer fell back to its own GL name
+	BOOL	mOwnsGLIndices;
+	BOOL	mReleaseQueued;	// in sReleaseList, client copy is freed at the next frame
 	U8*		mMappedData;	// pointer to currently mapped data (NULL if unmapped)
 	U8*		mMappedIndexData;	// pointer to currently mapped indices (NULL if unmapped)
 	BOOL	mLocked;			// if TRUE, buffer is being or has been written to in client memory
@@ -243,6 +366,7 @@ public:
 	static S32 sMappedCount;
 	static BOOL sMapped;
 	static std::vector<U32> sDeleteList;
+	static std::vector<LLVertexBuffer*> sReleaseList;	// arena buffers whose client copy is freed next frame
 	typedef std::list<LLVertexBuffer*> buffer_list_t;
 		
 	static BOOL sEnableVBOs;
@@ -250,12 +374,15 @@ public:
 	static U32 sGLMode[LLRender::NUM_MODES];
 	static U32 sGLRenderBuffer;
 	static U32 sGLRenderIndices;
+	static U32 sGLRenderOffset;
 	static BOOL sVBOActive;
 	static BOOL sIBOActive;
 	static U32 sLastMask;
 	static U32 sAllocatedBytes;
 	static U32 sBindCount;
 	static U32 sSetCount;
+	static U32 sUploadBytes;	// bytes handed to GL since last reset
+	static BOOL sUsePools;		// sub-allocate static buffers and stream through rings
 };
 
 
@@ -0,0 +1,43 @@
+/** 
+ * @file simpleInstancedV.glsl
+ *
+ * Copyright (c) 2007-$CurrentYear$, Linden Research, Inc.
+ * $License$
+ */
+
+#extension GL_ARB_draw_instanced : enable
+
+vec4 calcLighting(vec3 pos, vec3 norm, vec4 color, vec4 baseCol);
+void calcAtmospherics(vec3 inPositionEye);
+
+//per instance volume to region transform (3 rows) followed by its
+//inverse transpose (3 rows), INSTANCE_BATCH instances per draw
+//(see LLRenderPass::pushInstances)
+uniform vec4 instance_data[48];
+
+void main()
+{
+	int base = gl_InstanceIDARB * 6;
+	vec4 vert = vec4(dot(instance_data[base], gl_Vertex),
+					 dot(instance_data[base+1], gl_Vertex),
+					 dot(instance_data[base+2], gl_Vertex),
+					 1.0);
+	vec3 inst_norm = vec3(dot(instance_data[base+3].xyz, gl_Normal),
+						  dot(instance_data[base+4].xyz, gl_Normal),
+						  dot(instance_data[base+5].xyz, gl_Normal));
+
+	//transform vertex
+	gl_Position = gl_ModelViewProjectionMatrix * vert;
+	gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;
+	
+	vec4 pos = (gl_ModelViewMatrix * vert);
+	
+	vec3 norm = normalize(gl_NormalMatrix * inst_norm);
+
+	calcAtmospherics(pos.xyz);
+
+	vec4 color = calcLighting(pos.xyz, norm, gl_Color, vec4(0.));
+	gl_FrontColor = color;
+
+	gl_FogFragCoord = pos.z;
+}
@@ -3429,7 +3429,7 @@ void LLAgent::updateCamera()
 
 		mAvatarObject->mPelvisp->setPosition(mAvatarObject->mPelvisp->getPosition() + diff);
 
-		mAvatarObject->mRoot.updateWorldMatrixChildren();
+		mAvatarObject->mJointHierarchy.updateWorldMatrices();
 
 		for (LLVOAvatar::attachment_map_t::iterator iter = mAvatarObject->mAttachmentPoints.begin(); 
 			 iter != mAvatarObject->mAttachmentPoints.end(); )
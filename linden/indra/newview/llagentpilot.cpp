@@ -40,6 +40,7 @@
 #include "llagent.h"
 #include "llframestats.h"
 #include "llappviewer.h"
+#include "lltextureprefetch.h"
 #include "llviewercontrol.h"
 
 LLAgentPilot gAgentPilot;
@@ -199,6 +200,7 @@ void LLAgentPilot::updateTarget()
 						llinfos << "At start, beginning playback" << llendl;
 						mTimer.reset();
 						LLFrameStats::startLogging(NULL);
+						LLTexturePrefetch::getInstance()->resetStats();
 						mStarted = TRUE;
 					}
 				}
@@ -216,6 +218,7 @@ void LLAgentPilot::updateTarget()
 				{
 					stopPlayback();
 					LLFrameStats::stopLogging(NULL);
+					LLTexturePrefetch::getInstance()->dumpStats();
 					mNumRuns--;
 					if (sLoop)
 					{
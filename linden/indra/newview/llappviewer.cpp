@@ -94,6 +94,10 @@
 #include "lltexturecache.h"
 #include "lltexturefetch.h"
 #include "llimageworker.h"
+#include "llthreadpool.h"
+#include "lltextureuploader.h"
+#include "lltexlayercompositor.h"
+#include "llavatarupdatescheduler.h"
 
 // The files below handle dependencies from cleanup.
 #include "llkeyframemotion.h"
@@ -449,7 +453,7 @@ static void settings_modify()
 	if (gSysCPU.hasSSE2())
 	{
 		gSavedSettings.setBOOL("VectorizeEnable", TRUE );
-		gSavedSettings.setU32("VectorizeProcessor", 2 );
+		gSavedSettings.setU32("VectorizeProcessor", 3 );
 	}
 	else
 	if (gSysCPU.hasSSE())
@@ -532,6 +536,7 @@ const std::string LLAppViewer::sCrashSettingsName = "CrashSettings";
 LLTextureCache* LLAppViewer::sTextureCache = NULL; 
 LLImageDecodeThread* LLAppViewer::sImageDecodeThread = NULL; 
 LLTextureFetch* LLAppViewer::sTextureFetch = NULL; 
+LLThreadPool* LLAppViewer::sGeometryThreads = NULL; 
 
 LLAppViewer::LLAppViewer() : 
 	mMarkerFile(),
@@ -1417,12 +1422,19 @@ bool LLAppViewer::cleanup()
 	sTextureCache->shutdown();
 	sTextureFetch->shutdown();
 	sImageDecodeThread->shutdown();
+	sGeometryThreads->shutdown();
+	LLTextureUploader::cleanupClass();
+	LLTexLayerCompositor::cleanupClass();
+	LLAvatarUpdateScheduler::cleanupClass();
+	LLKeyframeLoadQueue::cleanupClass();
 	delete sTextureCache;
     sTextureCache = NULL;
 	delete sTextureFetch;
     sTextureFetch = NULL;
 	delete sImageDecodeThread;
     sImageDecodeThread = NULL;
+	delete sGeometryThreads;
+	sGeometryThreads = NULL;
 
 	gSavedSettings.cleanup();//do this after last time gSavedSettings is used  *surprise*
 
@@ -1529,6 +1541,23 @@ bool LLAppViewer::initThreads()
 	LLAppViewer::sTextureFetch = new LLTextureFetch(LLAppViewer::getTextureCache(), sImageDecodeThread, enable_threads && true);
 	LLImage::initClass();
 
+	// Volume geometry fill, 0 threads fills on the render thread
+	S32 geometry_threads = llclamp(gSavedSettings.getS32("RenderGeometryThreads"), 0, 8);
+	LLAppViewer::sGeometryThreads = new LLThreadPool("Geometry", geometry_threads, enable_threads && true);
+
+	// Pixel buffer fills for texture uploads, 0 threads fills on the render thread
+	S32 upload_threads = llclamp(gSavedSettings.getS32("RenderTextureUploadThreads"), 0, 4);
+	LLTextureUploader::initClass(upload_threads, enable_threads && true);
+
+	// Compositing of our own baked textures for upload, 0 threads composites on the render thread
+	S32 bake_threads = llclamp(gSavedSettings.getS32("AvatarBakeThreads"), 0, 2);
+	LLTexLayerCompositor::initClass(bake_threads, enable_threads && true);
+	LLTexLayerCompositor::sEnabled = gSavedSettings.getBOOL("AvatarBakeOnCPU");
+
+	// Animation asset reads and decodes, 0 threads decodes on the main thread
+	S32 animation_threads = llclamp(gSavedSettings.getS32("AnimationLoadThreads"), 0, 2);
+	LLKeyframeLoadQueue::initClass(animation_threads, enable_threads && true);
+
 	// *FIX: no error handling here!
 	return true;
 }
@@ -3474,6 +3503,8 @@ void LLAppViewer::idle()
 		
         if (!(logoutRequestSent() && hasSavedFinalSnapshot()))
 		{
+			LLKeyframeLoadQueue::update();
+			LLAvatarUpdateScheduler::update();
 			gObjectList.update(gAgent, *LLWorld::getInstance());
 		}
 	}
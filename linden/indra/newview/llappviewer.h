@@ -36,6 +36,7 @@
 class LLTextureCache;
 class LLImageDecodeThread;
 class LLTextureFetch;
+class LLThreadPool;
 class LLWatchdogTimeout;
 class LLCommandLineParser;
 
@@ -93,6 +94,7 @@ public:
 	static LLTextureCache* getTextureCache() { return sTextureCache; }
 	static LLImageDecodeThread* getImageDecodeThread() { return sImageDecodeThread; }
 	static LLTextureFetch* getTextureFetch() { return sTextureFetch; }
+	static LLThreadPool* getGeometryThreads() { return sGeometryThreads; }
 
 	const std::string& getSerialNumber() { return mSerialNumber; }
 	
@@ -215,6 +217,7 @@ private:
 	static LLTextureCache* sTextureCache; 
 	static LLImageDecodeThread* sImageDecodeThread; 
 	static LLTextureFetch* sTextureFetch;
+	static LLThreadPool* sGeometryThreads;
 
 	S32 mNumSessions;
 
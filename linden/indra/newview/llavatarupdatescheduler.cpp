@@ -0,0 +1,282 @@
+/** 
+ * @file llavatarupdatescheduler.cpp
+ * @brief Schedules avatar animation updates within a per-frame budget
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llavatarupdatescheduler.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "llviewercamera.h"
+#include "llviewercontrol.h"
+#include "llvoavatar.h"
+
+// Avatars at least this large on screen (pixels) are updated every frame
+const F32 FULL_RATE_PIXEL_AREA = 128.f * 128.f;
+// Avatars this close to the camera are always updated every frame
+const F32 FULL_RATE_DISTANCE = 8.f;
+const S32 MAX_UPDATE_PERIOD = 8;
+
+BOOL LLAvatarUpdateScheduler::sEnabled = TRUE;
+BOOL LLAvatarUpdateScheduler::sInterpolate = TRUE;
+F32 LLAvatarUpdateScheduler::sBudgetMS = 4.f;
+F32 LLAvatarUpdateScheduler::sAppearanceBudgetMS = 2.f;
+LLStat LLAvatarUpdateScheduler::sFrameCostStat(32);
+LLStat LLAvatarUpdateScheduler::sAvatarCountStat(32);
+LLStat LLAvatarUpdateScheduler::sAppearanceCostStat(32);
+F32 LLAvatarUpdateScheduler::sEstimatedCost = 0.f;
+F32 LLAvatarUpdateScheduler::sFrameCost = 0.f;
+U32 LLAvatarUpdateScheduler::sFrameAvatars = 0;
+U32 LLAvatarUpdateScheduler::sFrameFullUpdates = 0;
+U32 LLAvatarUpdateScheduler::sLastFrameAvatars = 0;
+U32 LLAvatarUpdateScheduler::sLastFrameFullUpdates = 0;
+U32 LLAvatarUpdateScheduler::sAppearanceApplied = 0;
+U32 LLAvatarUpdateScheduler::sAppearancePending = 0;
+F64 LLAvatarUpdateScheduler::sReportCost[REPORT_NUM_BUCKETS];
+F64 LLAvatarUpdateScheduler::sReportMaxCost[REPORT_NUM_BUCKETS];
+U32 LLAvatarUpdateScheduler::sReportFullUpdates[REPORT_NUM_BUCKETS];
+U32 LLAvatarUpdateScheduler::sReportFrames[REPORT_NUM_BUCKETS];
+
+namespace
+{
+	struct ScheduledAvatar
+	{
+		LLVOAvatar*	mAvatar;
+		F32			mPixelArea;
+		F32			mCost;
+		S32			mPeriod;
+		BOOL		mNear;
+	};
+
+	struct SmallestFirst
+	{
+		bool operator()(const ScheduledAvatar& a, const ScheduledAvatar& b) const
+		{
+			return a.mPixelArea < b.mPixelArea;
+		}
+	};
+
+	struct LargestFirst
+	{
+		bool operator()(const std::pair<F32, LLVOAvatar*>& a, const std::pair<F32, LLVOAvatar*>& b) const
+		{
+			return a.first > b.first;
+		}
+	};
+}
+
+//static
+void LLAvatarUpdateScheduler::cleanupClass()
+{
+	dumpReport();
+}
+
+//static
+void LLAvatarUpdateScheduler::update()
+{
+	// close out the frame that just finished
+	if (sFrameAvatars > 0)
+	{
+		sFrameCostStat.addValue(sFrameCost);
+		sAvatarCountStat.addValue((F32)sFrameAvatars);
+
+		S32 bucket = llmin((S32)(sFrameAvatars / REPORT_BUCKET_SIZE), (S32)REPORT_NUM_BUCKETS - 1);
+		sReportCost[bucket] += sFrameCost;
+		sReportMaxCost[bucket] = llmax(sReportMaxCost[bucket], (F64)sFrameCost);
+		sReportFullUpdates[bucket] += sFrameFullUpdates;
+		sReportFrames[bucket]++;
+	}
+	sLastFrameAvatars = sFrameAvatars;
+	sLastFrameFullUpdates = sFrameFullUpdates;
+	sFrameCost = 0.f;
+	sFrameAvatars = 0;
+	sFrameFullUpdates = 0;
+
+	sEnabled = gSavedSettings.getBOOL("AvatarUpdateScheduler");
+	sInterpolate = gSavedSettings.getBOOL("AvatarUpdateInterpolate");
+	sBudgetMS = llmax(gSavedSettings.getF32("AvatarUpdateBudgetMS"), 0.f);
+
+	std::vector<ScheduledAvatar> avatars;
+	avatars.reserve(LLCharacter::sInstances.size());
+	const LLVector3& camera_pos = LLViewerCamera::getInstance()->getOrigin();
+
+	for (std::vector<LLCharacter*>::iterator iter = LLCharacter::sInstances.begin();
+		 iter != LLCharacter::sInstances.end(); ++iter)
+	{
+		LLVOAvatar* avatarp = (LLVOAvatar*) *iter;
+		if (!sEnabled || avatarp->isDead() || avatarp->isSelf() || avatarp->mIsDummy
+			|| !avatarp->isVisible() || avatarp->isImpostor())
+		{
+			// the impostor path has its own update rate
+			avatarp->setScheduledPeriod(1);
+			continue;
+		}
+
+		ScheduledAvatar entry;
+		entry.mAvatar = avatarp;
+		entry.mPixelArea = avatarp->getPixelArea();
+		entry.mCost = avatarp->getUpdateCost();
+		entry.mNear = dist_vec(avatarp->getPositionAgent(), camera_pos) < FULL_RATE_DISTANCE;
+		if (entry.mNear || entry.mPixelArea >= FULL_RATE_PIXEL_AREA)
+		{
+			entry.mPeriod = 1;
+		}
+		else
+		{
+			// half the linear size, half the rate
+			F32 ratio = FULL_RATE_PIXEL_AREA / llmax(entry.mPixelArea, 1.f);
+			entry.mPeriod = llclamp((S32)sqrtf(ratio), 1, MAX_UPDATE_PERIOD);
+		}
+		avatars.push_back(entry);
+	}
+
+	F32 estimated_cost = 0.f;
+	for (std::vector<ScheduledAvatar>::iterator iter = avatars.begin(); iter != avatars.end(); ++iter)
+	{
+		estimated_cost += iter->mCost / (F32)iter->mPeriod;
+	}
+
+	// over budget: halve the rate of the smallest avatars first, a round at
+	// a time, until it fits or nothing can be slowed any more
+	if (estimated_cost > sBudgetMS)
+	{
+		std::sort(avatars.begin(), avatars.end(), SmallestFirst());
+		BOOL slowed = TRUE;
+		while (estimated_cost > sBudgetMS && slowed)
+		{
+			slowed = FALSE;
+			for (std::vector<ScheduledAvatar>::iterator iter = avatars.begin();
+				 iter != avatars.end() && estimated_cost > sBudgetMS; ++iter)
+			{
+				ScheduledAvatar& entry = *iter;
+				if (entry.mNear || entry.mPeriod >= MAX_UPDATE_PERIOD)
+				{
+					continue;
+				}
+				S32 period = llmin(entry.mPeriod * 2, MAX_UPDATE_PERIOD);
+				estimated_cost -= entry.mCost / (F32)entry.mPeriod - entry.mCost / (F32)period;
+				entry.mPeriod = period;
+				slowed = TRUE;
+			}
+		}
+	}
+	sEstimatedCost = estimated_cost;
+
+	for (std::vector<ScheduledAvatar>::iterator iter = avatars.begin(); iter != avatars.end(); ++iter)
+	{
+		iter->mAvatar->setScheduledPeriod(iter->mPeriod);
+	}
+
+	updateAppearance();
+}
+
+//static
+void LLAvatarUpdateScheduler::updateAppearance()
+{
+	sAppearanceBudgetMS = llmax(gSavedSettings.getF32("AvatarAppearanceBudgetMS"), 0.f);
+
+	// AvatarAppearance messages only mark their avatar pending, so a burst
+	// of them costs one updateVisualParams() per avatar
+	std::vector<std::pair<F32, LLVOAvatar*> > pending;
+	for (std::vector<LLCharacter*>::iterator iter = LLCharacter::sInstances.begin();
+		 iter != LLCharacter::sInstances.end(); ++iter)
+	{
+		LLVOAvatar* avatarp = (LLVOAvatar*) *iter;
+		if (avatarp->isVisualParamUpdatePending() && !avatarp->isDead())
+		{
+			pending.push_back(std::make_pair(avatarp->getPixelArea(), avatarp));
+		}
+	}
+	std::sort(pending.begin(), pending.end(), LargestFirst());
+
+	// always apply at least one so a tight budget still drains the queue
+	LLTimer timer;
+	U32 applied = 0;
+	for (std::vector<std::pair<F32, LLVOAvatar*> >::iterator iter = pending.begin();
+		 iter != pending.end(); ++iter)
+	{
+		if (applied > 0 && sEnabled && timer.getElapsedTimeF32() * 1000.f >= sAppearanceBudgetMS)
+		{
+			break;
+		}
+		iter->second->updateVisualParams();
+		applied++;
+	}
+
+	sAppearanceApplied = applied;
+	sAppearancePending = pending.size() - applied;
+	sAppearanceCostStat.addValue(timer.getElapsedTimeF32() * 1000.f);
+}
+
+//static
+void LLAvatarUpdateScheduler::addUpdateTime(F32 ms, BOOL full_update)
+{
+	sFrameCost += ms;
+	sFrameAvatars++;
+	if (full_update)
+	{
+		sFrameFullUpdates++;
+	}
+}
+
+//static
+std::string LLAvatarUpdateScheduler::getDebugString()
+{
+	return llformat("Avatar updates: %.2f ms (est %.2f, budget %.2f), %d/%d full, appearance %.2f ms (budget %.2f), %d applied, %d pending",
+					sFrameCostStat.getPrev(0), sEstimatedCost, sBudgetMS,
+					sLastFrameFullUpdates, sLastFrameAvatars,
+					sAppearanceCostStat.getPrev(0), sAppearanceBudgetMS,
+					sAppearanceApplied, sAppearancePending);
+}
+
+//static
+void LLAvatarUpdateScheduler::dumpReport()
+{
+	llinfos << "Avatar update cost per frame by avatars updated (budget " << sBudgetMS << " ms):" << llendl;
+	for (S32 i = 0; i < REPORT_NUM_BUCKETS; i++)
+	{
+		if (!sReportFrames[i])
+		{
+			continue;
+		}
+		std::string range = (i == REPORT_NUM_BUCKETS - 1)
+			? llformat("%d+", i * REPORT_BUCKET_SIZE)
+			: llformat("%d-%d", i * REPORT_BUCKET_SIZE, (i + 1) * REPORT_BUCKET_SIZE - 1);
+		llinfos << llformat("  %6s avatars: %6.2f ms mean, %6.2f ms max, %5.1f full updates, %u frames",
+							range.c_str(),
+							sReportCost[i] / sReportFrames[i],
+							sReportMaxCost[i],
+							(F32)sReportFullUpdates[i] / (F32)sReportFrames[i],
+							sReportFrames[i]) << llendl;
+	}
+}
@@ -0,0 +1,99 @@
+/** 
+ * @file llavatarupdatescheduler.h
+ * @brief Schedules avatar animation updates within a per-frame budget
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLAVATARUPDATESCHEDULER_H
+#define LL_LLAVATARUPDATESCHEDULER_H
+
+#include <string>
+
+#include "llstat.h"
+
+//-----------------------------------------------------------------------------
+// LLAvatarUpdateScheduler
+// Spreads avatar animation over several frames to keep the time spent in
+// LLVOAvatar::idleUpdate() within a per-frame budget.  Each frame, avatars
+// are given an update period from their pixel area and distance, then the
+// least important ones are slowed further until the estimated cost of all
+// full updates fits the budget.  On skipped frames an avatar follows its
+// object and blends between its last two animated poses, its attachments
+// are not moved and its mesh is only reskinned when something moved.
+// Impostored avatars keep the impostor update rate.
+// It also applies the visual params of other avatars whose appearance
+// changed, largest on screen first, within a separate per-frame budget.
+//-----------------------------------------------------------------------------
+class LLAvatarUpdateScheduler
+{
+public:
+	static void cleanupClass();
+
+	// MAIN thread, once per frame before the object list update.
+	static void update();
+
+	// MAIN thread, from LLVOAvatar::idleUpdate()
+	static void addUpdateTime(F32 ms, BOOL full_update);
+
+	static std::string getDebugString();
+	static void dumpReport();
+
+	// Settings, read every frame
+	static BOOL sEnabled;		// AvatarUpdateScheduler
+	static BOOL sInterpolate;	// AvatarUpdateInterpolate
+	static F32 sBudgetMS;		// AvatarUpdateBudgetMS
+	static F32 sAppearanceBudgetMS;	// AvatarAppearanceBudgetMS
+
+	// Stats
+	static LLStat sFrameCostStat;	// ms per frame spent updating avatars
+	static LLStat sAvatarCountStat;	// avatars updated per frame
+	static LLStat sAppearanceCostStat;	// ms per frame spent applying appearance
+
+private:
+	static void updateAppearance();
+
+	static F32 sEstimatedCost;
+	static F32 sFrameCost;
+	static U32 sFrameAvatars;
+	static U32 sFrameFullUpdates;
+	static U32 sLastFrameAvatars;
+	static U32 sLastFrameFullUpdates;
+	static U32 sAppearanceApplied;
+	static U32 sAppearancePending;
+
+	// frame cost against the number of avatars updated, in steps of
+	// REPORT_BUCKET_SIZE avatars
+	enum { REPORT_BUCKET_SIZE = 5, REPORT_NUM_BUCKETS = 10 };
+	static F64 sReportCost[REPORT_NUM_BUCKETS];
+	static F64 sReportMaxCost[REPORT_NUM_BUCKETS];
+	static U32 sReportFullUpdates[REPORT_NUM_BUCKETS];
+	static U32 sReportFrames[REPORT_NUM_BUCKETS];
+};
+
+#endif // LL_LLAVATARUPDATESCHEDULER_H
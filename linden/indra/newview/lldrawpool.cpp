@@ -54,6 +54,7 @@
 #include "llspatialpartition.h"
 #include "llviewercamera.h"
 #include "lldrawpoolwlsky.h"
+#include "llviewershadermgr.h"
 
 S32 LLDrawPool::sNumDrawPools = 0;
 
@@ -408,6 +409,8 @@ void LLFacePool::LLOverrideFaceColor::setColor(F32 r, F32 g, F32 b, F32 a)
 //=============================
 // Render Pass Implementation
 //=============================
+BOOL LLRenderPass::sHardwareInstancing = FALSE;
+
 LLRenderPass::LLRenderPass(const U32 type)
 : LLDrawPool(type)
 {
@@ -449,11 +452,13 @@ void LLRenderPass::renderTexture(U32 type, U32 mask)
 
 void LLRenderPass::pushBatches(U32 type, U32 mask, BOOL texture)
 {
-	for (LLCullResult::drawinfo_list_t::iterator i = gPipeline.beginRenderMap(type); i != gPipeline.endRenderMap(type); ++i)	
+	LLCullResult::drawinfo_list_t::iterator end = gPipeline.endRenderMap(type);
+	for (LLCullResult::drawinfo_list_t::iterator i = gPipeline.beginRenderMap(type); i != end; ++i)	
 	{
 		LLDrawInfo* pparams = *i;
 		if (pparams) 
 		{
+			LLMergedBatch batch(*pparams, i, end);
 			pushBatch(*pparams, mask, texture);
 		}
 	}
@@ -473,6 +478,67 @@ void LLRenderPass::applyModelMatrix(LLDrawInfo& params)
 	}
 }
 
+// instances per glDrawElementsInstanced call, must match the size of
+// instance_data in objects/simpleInstancedV.glsl (6 vec4 per instance)
+static const U32 INSTANCE_BATCH = 8;
+
+//static
+void LLRenderPass::pushInstances(LLDrawInfo& params)
+{
+	//vertex buffer is already set
+	if (sHardwareInstancing)
+	{ //rows of each instance transform and its inverse transpose as uniforms,
+	  //one draw call per INSTANCE_BATCH instances
+		GLfloat data[INSTANCE_BATCH*6*4];
+		U32 count = 0;
+		for (LLDrawInfo::instance_list_t::iterator iter = params.mInstances.begin(); iter != params.mInstances.end(); ++iter)
+		{
+			const LLMatrix4& mat = iter->mMatrix;
+			const LLMatrix3& norm = iter->mNormalMatrix;
+			GLfloat* dst = data + count*24;
+			for (U32 i = 0; i < 3; i++)
+			{
+				dst[i*4+0] = mat.mMatrix[0][i];
+				dst[i*4+1] = mat.mMatrix[1][i];
+				dst[i*4+2] = mat.mMatrix[2][i];
+				dst[i*4+3] = mat.mMatrix[3][i];
+				dst[12+i*4+0] = norm.mMatrix[0][i];
+				dst[12+i*4+1] = norm.mMatrix[1][i];
+				dst[12+i*4+2] = norm.mMatrix[2][i];
+				dst[12+i*4+3] = 0.f;
+			}
+
+			if (++count == INSTANCE_BATCH)
+			{
+				gObjectSimpleInstancedProgram.uniform4fv("instance_data", count*6, data);
+				params.mVertexBuffer->drawInstanced(LLRender::TRIANGLES, params.mStart, params.mEnd, params.mCount, params.mOffset, count);
+				count = 0;
+			}
+		}
+
+		if (count > 0)
+		{
+			gObjectSimpleInstancedProgram.uniform4fv("instance_data", count*6, data);
+			params.mVertexBuffer->drawInstanced(LLRender::TRIANGLES, params.mStart, params.mEnd, params.mCount, params.mOffset, count);
+		}
+	}
+	else
+	{ //underwater, no shaders: genInstances only builds instances when
+	  //the hardware path exists, so this is the rare case and draws each
+	  //instance on its own
+		for (LLDrawInfo::instance_list_t::iterator iter = params.mInstances.begin(); iter != params.mInstances.end(); ++iter)
+		{
+			glPushMatrix();
+			glMultMatrixf((GLfloat*) iter->mMatrix.mMatrix);
+			params.mVertexBuffer->drawRange(LLRender::TRIANGLES, params.mStart, params.mEnd, params.mCount, params.mOffset);
+			glPopMatrix();
+			gPipeline.mMatrixOpCount++;
+		}
+	}
+	gPipeline.addTrianglesDrawn((S32) (params.mCount/3 * params.mInstances.size()));
+	gPipeline.mInstanceCount += params.mInstances.size();
+}
+
 void LLRenderPass::pushBatch(LLDrawInfo& params, U32 mask, BOOL texture)
 {
 	applyModelMatrix(params);
@@ -502,8 +568,15 @@ void LLRenderPass::pushBatch(LLDrawInfo& params, U32 mask, BOOL texture)
 			params.mGroup->rebuildMesh();
 		}
 		params.mVertexBuffer->setBuffer(mask);
-		params.mVertexBuffer->drawRange(LLRender::TRIANGLES, params.mStart, params.mEnd, params.mCount, params.mOffset);
-		gPipeline.addTrianglesDrawn(params.mCount/3);
+		if (params.mInstances.empty())
+		{
+			params.mVertexBuffer->drawRange(LLRender::TRIANGLES, params.mStart, params.mEnd, params.mCount, params.mOffset);
+			gPipeline.addTrianglesDrawn(params.mCount/3);
+		}
+		else
+		{
+			pushInstances(params);
+		}
 	}
 
 	if (params.mTextureMatrix && texture && params.mTexture.notNull())
@@ -517,3 +590,99 @@ void LLRenderPass::renderGroups(U32 type, U32 mask, BOOL texture)
 {
 	gPipeline.renderGroups(this, type, mask, texture);
 }
+
+//=============================
+// LLMergedBatch
+
+const void* LLMergedBatch::sLastTexture = NULL;
+const void* LLMergedBatch::sLastMatrix = NULL;
+const void* LLMergedBatch::sLastBuffer = NULL;
+
+LLMergedBatch::LLMergedBatch(LLDrawInfo& params, drawinfo_iter_t& i, drawinfo_iter_t end)
+: mParams(params),
+  mStart(params.mStart),
+  mEnd(params.mEnd),
+  mCount(params.mCount),
+  mMerged(0)
+{
+	drawinfo_iter_t next = i;
+	for (++next; next != end; ++next)
+	{
+		LLDrawInfo* pnext = *next;
+		if (!pnext || 
+			params.mOffset + params.mCount != pnext->mOffset ||
+			!canMerge(params, *pnext))
+		{
+			break;
+		}
+#if LL_DARWIN
+		// the merged range must stay within the limits registerFace()
+		// enforces for a single batch
+		if ((U32) (llmax(params.mEnd, pnext->mEnd) - llmin(params.mStart, pnext->mStart)) >= (U32) gGLManager.mGLMaxVertexRange ||
+			params.mCount + pnext->mCount > (U32) gGLManager.mGLMaxIndexRange)
+		{
+			break;
+		}
+#endif
+
+		params.mStart = llmin(params.mStart, pnext->mStart);
+		params.mEnd = llmax(params.mEnd, pnext->mEnd);
+		params.mCount += pnext->mCount;
+		i = next;
+		mMerged++;
+	}
+
+	gPipeline.mMergedBatchCount += mMerged;
+
+	if (params.mTexture.get() != sLastTexture)
+	{
+		sLastTexture = params.mTexture.get();
+		gPipeline.mStateChangeCount++;
+	}
+	if (params.mModelMatrix != sLastMatrix)
+	{
+		sLastMatrix = params.mModelMatrix;
+		gPipeline.mStateChangeCount++;
+	}
+	if (params.mVertexBuffer.get() != sLastBuffer)
+	{
+		sLastBuffer = params.mVertexBuffer.get();
+		gPipeline.mStateChangeCount++;
+	}
+}
+
+LLMergedBatch::~LLMergedBatch()
+{
+	mParams.mStart = mStart;
+	mParams.mEnd = mEnd;
+	mParams.mCount = mCount;
+}
+
+//static
+bool LLMergedBatch::canMerge(const LLDrawInfo& lhs, const LLDrawInfo& rhs)
+{
+	return lhs.mVertexBuffer.notNull() &&
+		lhs.mVertexBuffer == rhs.mVertexBuffer &&
+		lhs.mGroup == rhs.mGroup &&
+		lhs.mTexture == rhs.mTexture &&
+		lhs.mTextureMatrix == rhs.mTextureMatrix &&
+		lhs.mModelMatrix == rhs.mModelMatrix &&
+		lhs.mGlowColor == rhs.mGlowColor &&
+		lhs.mFullbright == rhs.mFullbright &&
+		lhs.mBump == rhs.mBump &&
+		lhs.mParticle == rhs.mParticle &&
+		lhs.mPartSize == rhs.mPartSize &&
+#if LL_DARWIN
+		(U32) (llmax(lhs.mEnd, rhs.mEnd) - llmin(lhs.mStart, rhs.mStart)) < (U32) gGLManager.mGLMaxVertexRange &&
+		lhs.mCount + rhs.mCount <= (U32) gGLManager.mGLMaxIndexRange &&
+#endif
+		lhs.mInstances.empty() && rhs.mInstances.empty();
+}
+
+//static
+void LLMergedBatch::resetFrameState()
+{
+	sLastTexture = NULL;
+	sLastMatrix = NULL;
+	sLastBuffer = NULL;
+}
@@ -133,6 +133,7 @@ public:
 		PASS_ALPHA_MASK,
 		PASS_FULLBRIGHT_ALPHA_MASK,
 		PASS_ALPHA_SHADOW,
+		PASS_SIMPLE_INSTANCED,
 		NUM_RENDER_TYPES,
 	};
 
@@ -145,12 +146,50 @@ public:
 	void resetDrawOrders() { }
 
 	static void applyModelMatrix(LLDrawInfo& params);
+	static void pushInstances(LLDrawInfo& params);
 	virtual void pushBatches(U32 type, U32 mask, BOOL texture = TRUE);
 	virtual void pushBatch(LLDrawInfo& params, U32 mask, BOOL texture);
 	virtual void renderGroup(LLSpatialGroup* group, U32 type, U32 mask, BOOL texture = TRUE);
 	virtual void renderGroups(U32 type, U32 mask, BOOL texture = TRUE);
 	virtual void renderTexture(U32 type, U32 mask);
 
+	// TRUE while gObjectSimpleInstancedProgram is bound and instances are
+	// drawn with glDrawElementsInstanced (see pushInstances)
+	static BOOL sHardwareInstancing;
+};
+
+// Draws adjacent batches from a sorted render map as one.  On construction
+// the batches following params (which must be *i) that continue its index
+// range in the same vertex buffer with identical state are folded into
+// params and i is left on the last of them, so loops can keep using ++i.
+// params gets its own range back on destruction.
+class LLMergedBatch
+{
+public:
+	typedef std::vector<LLDrawInfo*>::iterator drawinfo_iter_t;
+
+	LLMergedBatch(LLDrawInfo& params, drawinfo_iter_t& i, drawinfo_iter_t end);
+	~LLMergedBatch();
+
+	static bool canMerge(const LLDrawInfo& lhs, const LLDrawInfo& rhs);
+
+	// forget the last submitted state; called once per frame so stale
+	// pointers from the previous frame are never compared against
+	static void resetFrameState();
+
+	U32 getMergedCount() const		{ return mMerged; }
+
+private:
+	LLDrawInfo& mParams;
+	U16 mStart;
+	U16 mEnd;
+	U32 mCount;
+	U32 mMerged;
+
+	//state of the last batch submitted, for counting state changes
+	static const void* sLastTexture;
+	static const void* sLastMatrix;
+	static const void* sLastBuffer;
 };
 
 class LLFacePool : public LLDrawPool
@@ -130,6 +130,19 @@ void LLDrawPoolAvatar::prerender()
 	else
 	{
 		sBufferUsage = GL_STREAM_DRAW_ARB;
+
+		// Start skinning now so it overlaps with the pools rendered before
+		// this one; renderSkinned() waits for it.
+		if (gRenderAvatar && !mDrawFace.empty() && mDrawFace[0]->getDrawable())
+		{
+			LLVOAvatar* avatarp = (LLVOAvatar*)mDrawFace[0]->getDrawable()->getVObj().get();
+			if (!avatarp->isDead() && avatarp->mDrawable.notNull()
+				&& avatarp->isFullyLoaded() && !avatarp->isImpostor())
+			{
+				avatarp->queueSkinning();
+				LLViewerJointMesh::dispatchSkinning();
+			}
+		}
 	}
 }
 
@@ -873,7 +886,7 @@ void LLVertexBufferAvatar::setupVertexBuffer(U32 data_mask) const
 {
 	if (sRenderingSkinned)
 	{
-		U8* base = useVBOs() ? NULL : mMappedData;
+		U8* base = getVerticesPointer();
 
 		glVertexPointer(3,GL_FLOAT, mStride, (void*)(base + 0));
 		glNormalPointer(GL_FLOAT, mStride, (void*)(base + mOffsets[TYPE_NORMAL]));
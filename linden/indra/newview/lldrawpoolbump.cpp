@@ -1187,6 +1187,7 @@ void LLDrawPoolBump::renderBump(U32 type, U32 mask)
 
 		if (LLDrawPoolBump::bindBumpMap(params))
 		{
+			LLMergedBatch batch(params, i, end);
 			pushBatch(params, mask, FALSE);
 		}
 	}
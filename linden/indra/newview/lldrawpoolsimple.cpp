@@ -144,6 +144,28 @@ void LLDrawPoolSimple::render(S32 pass)
 		gPipeline.enableLightsDynamic();
 		renderTexture(LLRenderPass::PASS_SIMPLE, getVertexDataMask());
 
+		if (gPipeline.beginRenderMap(LLRenderPass::PASS_SIMPLE_INSTANCED) != gPipeline.endRenderMap(LLRenderPass::PASS_SIMPLE_INSTANCED))
+		{ //identical prims drawn from shared geometry
+			BOOL hw_instancing = gGLManager.mHasDrawInstanced && mVertexShaderLevel > 0 && !LLPipeline::sUnderWaterRender && gObjectSimpleInstancedProgram.mProgramObject;
+			if (hw_instancing)
+			{
+				gObjectSimpleInstancedProgram.bind();
+				LLRenderPass::sHardwareInstancing = TRUE;
+			}
+
+			{
+				//instance transforms may scale normals
+				LLGLState normalize(GL_NORMALIZE, mVertexShaderLevel > 0 ? FALSE : TRUE);
+				renderTexture(LLRenderPass::PASS_SIMPLE_INSTANCED, getVertexDataMask());
+			}
+
+			if (hw_instancing)
+			{
+				LLRenderPass::sHardwareInstancing = FALSE;
+				simple_shader->bind();
+			}
+		}
+
 		if (LLPipeline::sRenderDeferred)
 		{
 			renderTexture(LLRenderPass::PASS_BUMP, getVertexDataMask());
@@ -90,6 +90,7 @@ public:
 	// LLVisualParam Virtual functions
 	///*virtual*/ BOOL				parseData(LLXmlTreeNode* node);
 	/*virtual*/ void				apply( ESex sex ) {} // apply is called separately for each driven param.
+	/*virtual*/ U32					getApplyStages() const { return 0; }
 	/*virtual*/ void				setWeight(F32 weight, BOOL set_by_user);
 	/*virtual*/ void				setAnimationTarget( F32 target_value, BOOL set_by_user );
 	/*virtual*/ void				stopAnimating(BOOL set_by_user);
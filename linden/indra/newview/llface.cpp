@@ -432,6 +432,10 @@ void LLFace::renderForSelect(U32 data_mask)
 				{
 					glPushMatrix();
 					glMultMatrixf((float*) mDrawablep->getRegion()->mRenderMatrix.mMatrix);
+					if (isState(INSTANCED))
+					{
+						glMultMatrixf((float*) mDrawablep->getVOVolume()->getRelativeXform().mMatrix);
+					}
 					mVertexBuffer->draw(LLRender::TRIANGLES, mIndicesCount, mIndicesIndex);
 					glPopMatrix();
 				}
@@ -471,6 +475,10 @@ void LLFace::renderSelected(LLImageGL *imagep, const LLColor4& color)
 		else
 		{
 			glMultMatrixf((GLfloat*)mDrawablep->getRegion()->mRenderMatrix.mMatrix);
+			if (isState(INSTANCED))
+			{
+				glMultMatrixf((GLfloat*)mDrawablep->getVOVolume()->getRelativeXform().mMatrix);
+			}
 		}
 
 		setFaceColor(color);
@@ -833,7 +841,8 @@ void LLFace::updateRebuildFlags()
 BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 							   const S32 &f,
 								const LLMatrix4& mat_vert, const LLMatrix3& mat_normal,
-								const U16 &index_offset)
+								const U16 &index_offset,
+								VolumeGeometry* deferred)
 {
 	const LLVolumeFace &vf = volume.getVolumeFace(f);
 	S32 num_vertices = (S32)vf.mVertices.size();
@@ -854,13 +863,15 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 		}
 	}
 
-	LLStrider<LLVector3> vertices;
-	LLStrider<LLVector2> tex_coords;
-	LLStrider<LLVector2> tex_coords2;
-	LLStrider<LLVector3> normals;
-	LLStrider<LLColor4U> colors;
-	LLStrider<LLVector3> binormals;
-	LLStrider<U16> indicesp;
+	VolumeGeometry local_geom;
+	VolumeGeometry& geom = deferred ? *deferred : local_geom;
+
+	geom.mVolumeFace = &vf;
+	geom.mNumVertices = num_vertices;
+	geom.mNumIndices = num_indices;
+	geom.mIndexOffset = index_offset;
+	geom.mMatVert = mat_vert;
+	geom.mMatNormal = mat_normal;
 
 	BOOL full_rebuild = mDrawablep->isState(LLDrawable::REBUILD_VOLUME);
 	
@@ -884,30 +895,33 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 	const LLTextureEntry *tep = mVObjp->getTE(f);
 	U8  bump_code = tep ? tep->getBumpmap() : 0;
 
+	// all striders are fetched here, mapping the buffer on the render thread
 	if (rebuild_pos)
 	{
-		mVertexBuffer->getVertexStrider(vertices, mGeomIndex);
+		mVertexBuffer->getVertexStrider(geom.mVertices, mGeomIndex);
 	}
 	if (rebuild_normal)
 	{
-		mVertexBuffer->getNormalStrider(normals, mGeomIndex);
+		mVertexBuffer->getNormalStrider(geom.mNormals, mGeomIndex);
 	}
 	if (rebuild_binormal)
 	{
-		mVertexBuffer->getBinormalStrider(binormals, mGeomIndex);
+		mVertexBuffer->getBinormalStrider(geom.mBinormals, mGeomIndex);
 	}
 
+	BOOL bump_tcoord = FALSE;
 	if (rebuild_tcoord)
 	{
-		mVertexBuffer->getTexCoord0Strider(tex_coords, mGeomIndex);
+		mVertexBuffer->getTexCoord0Strider(geom.mTexCoords, mGeomIndex);
 		if (bump_code && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_TEXCOORD1))
 		{
-			mVertexBuffer->getTexCoord1Strider(tex_coords2, mGeomIndex);
+			mVertexBuffer->getTexCoord1Strider(geom.mTexCoords2, mGeomIndex);
+			bump_tcoord = TRUE;
 		}
 	}
 	if (rebuild_color)
 	{	
-		mVertexBuffer->getColorStrider(colors, mGeomIndex);
+		mVertexBuffer->getColorStrider(geom.mColors, mGeomIndex);
 	}
 
 	F32 r = 0, os = 0, ot = 0, ms = 0, mt = 0, cos_ang = 0, sin_ang = 0;
@@ -915,8 +929,6 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 	BOOL is_static = mDrawablep->isStatic();
 	BOOL is_global = is_static;
 
-	LLVector3 center_sum(0.f, 0.f, 0.f);
-	
 	if (is_global)
 	{
 		setState(GLOBAL);
@@ -926,10 +938,6 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 		clearState(GLOBAL);
 	}
 
-	LLVector2 tmin, tmax;
-	
-	
-
 	if (rebuild_tcoord)
 	{
 		if (tep)
@@ -1000,14 +1008,9 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
     // INDICES
 	if (full_rebuild)
 	{
-		mVertexBuffer->getIndexStrider(indicesp, mIndicesIndex);
-		for (U16 i = 0; i < num_indices; i++)
-		{
-			*indicesp++ = vf.mIndices[i] + index_offset;
-		}
+		mVertexBuffer->getIndexStrider(geom.mIndices, mIndicesIndex);
 	}
 	
-	
 	//bump setup
 	LLVector3 binormal_dir( -sin_ang, cos_ang, 0 );
 	LLVector3 bump_s_primary_light_ray;
@@ -1073,19 +1076,84 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 		mVObjp->getVolume()->genBinormals(f);
 	}
 
-	for (S32 i = 0; i < num_vertices; i++)
+	geom.mRebuildPos = rebuild_pos;
+	geom.mRebuildNormal = rebuild_normal;
+	geom.mRebuildBinormal = rebuild_binormal;
+	geom.mRebuildTCoord = rebuild_tcoord;
+	geom.mRebuildColor = rebuild_color;
+	geom.mRebuildIndices = full_rebuild;
+	geom.mBump = bump_tcoord;
+	geom.mActive = mDrawablep->isActive();
+	geom.mTexGen = texgen;
+	geom.mTexMode = tex_mode;
+	geom.mUseTextureMatrix = (tex_mode && mTextureMatrix) ? TRUE : FALSE;
+	if (geom.mUseTextureMatrix)
 	{
-		if (rebuild_tcoord)
+		geom.mTextureMatrix = *mTextureMatrix;
+	}
+	geom.mScale = scale;
+	geom.mBinormalDir = binormal_dir;
+	geom.mBumpSRay = bump_s_primary_light_ray;
+	geom.mBumpTRay = bump_t_primary_light_ray;
+	geom.mBumpQuat = bump_quat;
+	geom.mColor = color;
+	geom.mCosAng = cos_ang;
+	geom.mSinAng = sin_ang;
+	geom.mOffsetS = os;
+	geom.mOffsetT = ot;
+	geom.mScaleS = ms;
+	geom.mScaleT = mt;
+
+	if (!deferred)
+	{
+		fillGeometryVolume(geom);
+	}
+
+	if (rebuild_tcoord)
+	{
+		mTexExtents[0].setVec(0,0);
+		mTexExtents[1].setVec(1,1);
+		xform(mTexExtents[0], cos_ang, sin_ang, os, ot, ms, mt);
+		xform(mTexExtents[1], cos_ang, sin_ang, os, ot, ms, mt);		
+	}
+
+	mLastVertexBuffer = mVertexBuffer;
+	mLastGeomCount = mGeomCount;
+	mLastGeomIndex = mGeomIndex;
+	mLastIndicesCount = mIndicesCount;
+	mLastIndicesIndex = mIndicesIndex;
+
+	return TRUE;
+}
+
+//static
+// May be called from a worker thread: touches nothing but the volume face
+// and the (already mapped) vertex buffer memory described by geom.
+void LLFace::fillGeometryVolume(VolumeGeometry& geom)
+{
+	const LLVolumeFace& vf = *geom.mVolumeFace;
+
+	if (geom.mRebuildIndices)
+	{
+		for (U16 i = 0; i < geom.mNumIndices; i++)
+		{
+			*geom.mIndices++ = vf.mIndices[i] + geom.mIndexOffset;
+		}
+	}
+
+	for (S32 i = 0; i < geom.mNumVertices; i++)
+	{
+		if (geom.mRebuildTCoord)
 		{
 			LLVector2 tc = vf.mVertices[i].mTexCoord;
 		
-			if (texgen != LLTextureEntry::TEX_GEN_DEFAULT)
+			if (geom.mTexGen != LLTextureEntry::TEX_GEN_DEFAULT)
 			{
 				LLVector3 vec = vf.mVertices[i].mPosition; 
 			
-				vec.scaleVec(scale);
+				vec.scaleVec(geom.mScale);
 
-				switch (texgen)
+				switch (geom.mTexGen)
 				{
 					case LLTextureEntry::TEX_GEN_PLANAR:
 						planarProjection(tc, vf.mVertices[i].mNormal, vf.mCenter, vec);
@@ -1101,82 +1169,66 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 				}		
 			}
 
-			if (tex_mode && mTextureMatrix)
+			if (geom.mUseTextureMatrix)
 			{
 				LLVector3 tmp(tc.mV[0], tc.mV[1], 0.f);
-				tmp = tmp * *mTextureMatrix;
+				tmp = tmp * geom.mTextureMatrix;
 				tc.mV[0] = tmp.mV[0];
 				tc.mV[1] = tmp.mV[1];
 			}
 			else
 			{
-				xform(tc, cos_ang, sin_ang, os, ot, ms, mt);
+				xform(tc, geom.mCosAng, geom.mSinAng, geom.mOffsetS, geom.mOffsetT, geom.mScaleS, geom.mScaleT);
 			}
 
-			*tex_coords++ = tc;
+			*geom.mTexCoords++ = tc;
 		
-			if (bump_code && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_TEXCOORD1))
+			if (geom.mBump)
 			{
 				LLVector3 tangent = vf.mVertices[i].mBinormal % vf.mVertices[i].mNormal;
 
 				LLMatrix3 tangent_to_object;
 				tangent_to_object.setRows(tangent, vf.mVertices[i].mBinormal, vf.mVertices[i].mNormal);
-				LLVector3 binormal = binormal_dir * tangent_to_object;
-				binormal = binormal * mat_normal;
+				LLVector3 binormal = geom.mBinormalDir * tangent_to_object;
+				binormal = binormal * geom.mMatNormal;
 				
-				if (mDrawablep->isActive())
+				if (geom.mActive)
 				{
-					binormal *= bump_quat;
+					binormal *= geom.mBumpQuat;
 				}
 
 				binormal.normVec();
-				tc += LLVector2( bump_s_primary_light_ray * tangent, bump_t_primary_light_ray * binormal );
+				tc += LLVector2( geom.mBumpSRay * tangent, geom.mBumpTRay * binormal );
 				
-				*tex_coords2++ = tc;
+				*geom.mTexCoords2++ = tc;
 			}	
 		}
 			
-		if (rebuild_pos)
+		if (geom.mRebuildPos)
 		{
-			*vertices++ = vf.mVertices[i].mPosition * mat_vert;
+			*geom.mVertices++ = vf.mVertices[i].mPosition * geom.mMatVert;
 		}
 		
-		if (rebuild_normal)
+		if (geom.mRebuildNormal)
 		{
-			LLVector3 normal = vf.mVertices[i].mNormal * mat_normal;
+			LLVector3 normal = vf.mVertices[i].mNormal * geom.mMatNormal;
 			normal.normVec();
 			
-			*normals++ = normal;
+			*geom.mNormals++ = normal;
 		}
 		
-		if (rebuild_binormal)
+		if (geom.mRebuildBinormal)
 		{
-			LLVector3 binormal = vf.mVertices[i].mBinormal * mat_normal;
+			LLVector3 binormal = vf.mVertices[i].mBinormal * geom.mMatNormal;
 			binormal.normVec();
-			*binormals++ = binormal;
+			*geom.mBinormals++ = binormal;
 		}
 		
-		if (rebuild_color)
+		if (geom.mRebuildColor)
 		{
-			*colors++ = color;		
+			*geom.mColors++ = geom.mColor;		
 		}
 	}
-
-	if (rebuild_tcoord)
-	{
-		mTexExtents[0].setVec(0,0);
-		mTexExtents[1].setVec(1,1);
-		xform(mTexExtents[0], cos_ang, sin_ang, os, ot, ms, mt);
-		xform(mTexExtents[1], cos_ang, sin_ang, os, ot, ms, mt);		
-	}
-
-	mLastVertexBuffer = mVertexBuffer;
-	mLastGeomCount = mGeomCount;
-	mLastGeomIndex = mGeomIndex;
-	mLastIndicesCount = mIndicesCount;
-	mLastIndicesIndex = mIndicesIndex;
-
-	return TRUE;
 }
 
 const F32 LEAST_IMPORTANCE = 0.05f ;
@@ -39,6 +39,7 @@
 #include "v2math.h"
 #include "v3math.h"
 #include "v4math.h"
+#include "m3math.h"
 #include "m4math.h"
 #include "v4coloru.h"
 #include "llquaternion.h"
@@ -51,6 +52,7 @@
 
 class LLFacePool;
 class LLVolume;
+class LLVolumeFace;
 class LLViewerImage;
 class LLTextureEntry;
 class LLVertexProgram;
@@ -72,6 +74,7 @@ public:
 		HUD_RENDER		= 0x0008,
 		USE_FACE_COLOR	= 0x0010,
 		TEXTURE_ANIM	= 0x0020, 
+		INSTANCED		= 0x0040, //geometry is in volume space, shared with identical prims
 	};
 
 	static void initClass();
@@ -135,12 +138,56 @@ public:
 	const LLColor4& getRenderColor() const;
 	
 
+	// Snapshot of everything getGeometryVolume needs to pack one volume
+	// face into its vertex buffer.  Filling from a snapshot only reads the
+	// volume face and writes through the striders, so it is safe to do
+	// on a worker thread while the buffer stays mapped.
+	struct VolumeGeometry
+	{
+		const LLVolumeFace*		mVolumeFace;
+		LLStrider<LLVector3>	mVertices;
+		LLStrider<LLVector3>	mNormals;
+		LLStrider<LLVector3>	mBinormals;
+		LLStrider<LLVector2>	mTexCoords;
+		LLStrider<LLVector2>	mTexCoords2;
+		LLStrider<LLColor4U>	mColors;
+		LLStrider<U16>			mIndices;
+		S32				mNumVertices;
+		S32				mNumIndices;
+		U16				mIndexOffset;
+		BOOL			mRebuildPos;
+		BOOL			mRebuildNormal;
+		BOOL			mRebuildBinormal;
+		BOOL			mRebuildTCoord;
+		BOOL			mRebuildColor;
+		BOOL			mRebuildIndices;
+		BOOL			mBump;
+		BOOL			mActive;
+		U8				mTexGen;
+		U8				mTexMode;
+		BOOL			mUseTextureMatrix;
+		LLMatrix4		mTextureMatrix;
+		LLMatrix4		mMatVert;
+		LLMatrix3		mMatNormal;
+		LLVector3		mScale;
+		LLVector3		mBinormalDir;
+		LLVector3		mBumpSRay;
+		LLVector3		mBumpTRay;
+		LLQuaternion	mBumpQuat;
+		LLColor4U		mColor;
+		F32				mCosAng, mSinAng, mOffsetS, mOffsetT, mScaleS, mScaleT;
+	};
+
 	//for volumes
 	void updateRebuildFlags();
+	// If deferred is not NULL, the vertex and index data is not written
+	// here; it is described in *deferred for fillGeometryVolume() instead.
 	BOOL getGeometryVolume(const LLVolume& volume,
 						const S32 &f,
 						const LLMatrix4& mat_vert, const LLMatrix3& mat_normal,
-						const U16 &index_offset);
+						const U16 &index_offset,
+						VolumeGeometry* deferred = NULL);
+	static void fillGeometryVolume(VolumeGeometry& geom);
 
 	// For avatar
 	U16			 getGeometryAvatar(
@@ -42,6 +42,7 @@
 #include "llstring.h"
 
 #include "llagent.h"
+#include "llappviewer.h"
 #include "llbbox.h"
 #include "llbutton.h"
 #include "llcheckboxctrl.h"
@@ -254,7 +255,7 @@ BOOL LLFloaterAnimPreview::postBuild()
 			{
 				file_buffer[file_size] = '\0';
 				llinfos << "Loading BVH file " << mFilename << llendl;
-				loaderp = new LLBVHLoader(file_buffer);
+				loaderp = new LLBVHLoader(file_buffer, file_size, LLAppViewer::getGeometryThreads());
 			}
 
 			infile.close() ;
@@ -1640,7 +1640,7 @@ void LLManipTranslate::highlightIntersection(LLVector3 normal,
 		return;
 	}
 	
-	U32 types[] = { LLRenderPass::PASS_SIMPLE, LLRenderPass::PASS_ALPHA, LLRenderPass::PASS_FULLBRIGHT, LLRenderPass::PASS_SHINY };
+	U32 types[] = { LLRenderPass::PASS_SIMPLE, LLRenderPass::PASS_SIMPLE_INSTANCED, LLRenderPass::PASS_ALPHA, LLRenderPass::PASS_FULLBRIGHT, LLRenderPass::PASS_SHINY };
 	U32 num_types = LL_ARRAY_SIZE(types);
 
 	GLuint stencil_mask = 0xFFFFFFFF;
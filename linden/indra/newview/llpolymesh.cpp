@@ -45,6 +45,7 @@
 #include "llendianswizzle.h"
 
 #include "llfasttimer.h"
+#include "llv4skin.h"
 
 #define HEADER_ASCII "Linden Mesh 1.0"
 #define HEADER_BINARY "Linden Binary Mesh 1.0"
@@ -56,6 +57,22 @@ extern LLControlGroup gSavedSettings;				// read only
 //-----------------------------------------------------------------------------
 LLPolyMesh::LLPolyMeshSharedDataTable LLPolyMesh::sGlobalSharedMeshList;
 
+LLPolyMesh::appearance_cache_t LLPolyMesh::sAppearanceCache;
+U32 LLPolyMesh::sAppearanceCacheBytes = 0;
+U32 LLPolyMesh::sAppearanceCacheMaxBytes = 16 * 1024 * 1024;
+U32 LLPolyMesh::sAppearanceCacheClock = 0;
+
+// 64 bit FNV-1a
+static inline void hash_bytes(U64& hash, const void* data, size_t size)
+{
+	const U8* bytes = (const U8*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+}
+
 //-----------------------------------------------------------------------------
 // LLPolyMeshSharedData()
 //-----------------------------------------------------------------------------
@@ -68,6 +85,8 @@ LLPolyMeshSharedData::LLPolyMeshSharedData()
 	mTexCoords = NULL;
 	mDetailTexCoords = NULL;
 	mWeights = NULL;
+	mNumSkinRuns = 0;
+	mSkinRuns = NULL;
 	mHasWeights = FALSE;
 	mHasDetailTexCoords = FALSE;
 
@@ -154,6 +173,11 @@ void LLPolyMeshSharedData::freeMeshData()
 	delete [] mTriangleIndices;
 	mTriangleIndices = NULL;
 
+	mSkinOrder.clear();
+	mNumSkinRuns = 0;
+	delete [] mSkinRuns;
+	mSkinRuns = NULL;
+
 //	mVertFaceMap.deleteAllData();
 }
 
@@ -212,6 +236,9 @@ U32 LLPolyMeshSharedData::getNumKB()
 		num_kb += mNumVertices * sizeof(float);		// weights
 	}
 
+	num_kb += mSkinOrder.size() * sizeof(U32);				// skin order
+	num_kb += mNumSkinRuns * sizeof(LLV4SkinRun);			// skin runs
+
 	num_kb += mNumFaces * sizeof(LLPolyFace);	// faces
 
 	num_kb /= 1024;
@@ -635,6 +662,19 @@ BOOL LLPolyMeshSharedData::loadMesh( const std::string& fileName )
 			}
 		}
 
+		//----------------------------------------------------------------
+		// Skin runs
+		//----------------------------------------------------------------
+		if (mHasWeights)
+		{
+			std::vector<LLV4SkinRun> runs;
+			llv4skin_build_runs(mWeights, mNumVertices, mSkinOrder, runs);
+			delete [] mSkinRuns;
+			mNumSkinRuns = runs.size();
+			mSkinRuns = new LLV4SkinRun[mNumSkinRuns];
+			std::copy(runs.begin(), runs.end(), mSkinRuns);
+		}
+
 		status = TRUE;
 	}
 	else
@@ -810,6 +850,167 @@ void LLPolyMesh::freeAllMeshes()
 	// delete each item in the global lists
 	for_each(sGlobalSharedMeshList.begin(), sGlobalSharedMeshList.end(), DeletePairedPointer());
 	sGlobalSharedMeshList.clear();
+
+	// the cache is keyed by the shared data just freed
+	freeAppearanceCache();
+}
+
+//-----------------------------------------------------------------------------
+// LLPolyMesh::getAppearanceHash()
+//-----------------------------------------------------------------------------
+BOOL LLPolyMesh::getAppearanceHash(ESex sex, BOOL applied, U64& hash)
+{
+	if (!mVertexData)
+	{
+		return FALSE;
+	}
+
+	hash = 0xcbf29ce484222325ULL;
+	for (std::vector<LLPolyMorphTarget*>::iterator iter = mMorphTargets.begin();
+		 iter != mMorphTargets.end(); ++iter)
+	{
+		LLPolyMorphTarget* target = *iter;
+		if (target->isAnimating() || target->mVertMask || target->mNumMorphMasksPending > 0)
+		{
+			return FALSE;
+		}
+
+		F32 weight = target->getEffectiveWeight(sex);
+		BOOL clothing_applied = target->mClothingApplied;
+		if (applied)
+		{
+			if (weight != target->getLastWeight())
+			{
+				return FALSE;
+			}
+		}
+		else if (weight != target->getLastWeight()
+				 && target->isClothingMorph())
+		{
+			clothing_applied = TRUE;
+		}
+
+		S32 id = target->getID();
+		hash_bytes(hash, &id, sizeof(id));
+		hash_bytes(hash, &weight, sizeof(weight));
+		hash_bytes(hash, &clothing_applied, sizeof(clothing_applied));
+	}
+	return TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// LLPolyMesh::needsMorph()
+//-----------------------------------------------------------------------------
+BOOL LLPolyMesh::needsMorph(ESex sex)
+{
+	for (std::vector<LLPolyMorphTarget*>::iterator iter = mMorphTargets.begin();
+		 iter != mMorphTargets.end(); ++iter)
+	{
+		if ((*iter)->getEffectiveWeight(sex) != (*iter)->getLastWeight())
+		{
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+//-----------------------------------------------------------------------------
+// LLPolyMesh::hasCachedAppearance()
+//-----------------------------------------------------------------------------
+BOOL LLPolyMesh::hasCachedAppearance(U64 hash) const
+{
+	return sAppearanceCache.find(std::make_pair(mSharedData, hash)) != sAppearanceCache.end();
+}
+
+//-----------------------------------------------------------------------------
+// LLPolyMesh::applyCachedAppearance()
+//-----------------------------------------------------------------------------
+void LLPolyMesh::applyCachedAppearance(U64 hash, ESex sex)
+{
+	appearance_cache_t::iterator found = sAppearanceCache.find(std::make_pair(mSharedData, hash));
+	if (found == sAppearanceCache.end())
+	{
+		return;
+	}
+	LLPolyMeshAppearance& appearance = found->second;
+	llassert(appearance.mNumFloats == getNumVertexFloats());
+	memcpy(mVertexData, appearance.mVertexData, sizeof(F32) * appearance.mNumFloats);		/*Flawfinder: ignore*/
+	appearance.mLastUsed = ++sAppearanceCacheClock;
+
+	for (std::vector<LLPolyMorphTarget*>::iterator iter = mMorphTargets.begin();
+		 iter != mMorphTargets.end(); ++iter)
+	{
+		(*iter)->applyCachedMorph(sex);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// LLPolyMesh::cacheAppearance()
+//-----------------------------------------------------------------------------
+void LLPolyMesh::cacheAppearance(U64 hash)
+{
+	if (!mVertexData || hasCachedAppearance(hash))
+	{
+		return;
+	}
+
+	U32 num_floats = getNumVertexFloats();
+	U32 bytes = num_floats * sizeof(F32);
+	if (bytes > sAppearanceCacheMaxBytes)
+	{
+		return;
+	}
+
+	// evict least recently used geometry until the new entry fits
+	while (sAppearanceCacheBytes + bytes > sAppearanceCacheMaxBytes)
+	{
+		appearance_cache_t::iterator oldest = sAppearanceCache.begin();
+		for (appearance_cache_t::iterator iter = sAppearanceCache.begin();
+			 iter != sAppearanceCache.end(); ++iter)
+		{
+			if (iter->second.mLastUsed < oldest->second.mLastUsed)
+			{
+				oldest = iter;
+			}
+		}
+		sAppearanceCacheBytes -= oldest->second.mNumFloats * sizeof(F32);
+		delete [] oldest->second.mVertexData;
+		sAppearanceCache.erase(oldest);
+	}
+
+	LLPolyMeshAppearance appearance;
+	appearance.mVertexData = new F32[num_floats];
+	appearance.mNumFloats = num_floats;
+	appearance.mLastUsed = ++sAppearanceCacheClock;
+	memcpy(appearance.mVertexData, mVertexData, bytes);		/*Flawfinder: ignore*/
+	sAppearanceCache[std::make_pair(mSharedData, hash)] = appearance;
+	sAppearanceCacheBytes += bytes;
+}
+
+//-----------------------------------------------------------------------------
+// LLPolyMesh::setAppearanceCacheSize()
+//-----------------------------------------------------------------------------
+void LLPolyMesh::setAppearanceCacheSize(U32 max_bytes)
+{
+	sAppearanceCacheMaxBytes = max_bytes;
+	if (sAppearanceCacheBytes > sAppearanceCacheMaxBytes)
+	{
+		freeAppearanceCache();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// LLPolyMesh::freeAppearanceCache()
+//-----------------------------------------------------------------------------
+void LLPolyMesh::freeAppearanceCache()
+{
+	for (appearance_cache_t::iterator iter = sAppearanceCache.begin();
+		 iter != sAppearanceCache.end(); ++iter)
+	{
+		delete [] iter->second.mVertexData;
+	}
+	sAppearanceCache.clear();
+	sAppearanceCacheBytes = 0;
 }
 
 LLPolyMeshSharedData *LLPolyMesh::getSharedData() const
@@ -35,6 +35,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include "llstl.h"
 
 #include "v3math.h"
@@ -46,6 +47,7 @@
 
 class LLSkinJoint;
 class LLVOAvatar;
+struct LLV4SkinRun;
 
 //#define USE_STRIPS	// Use tri-strips for rendering.
 
@@ -84,6 +86,11 @@ private:
 	LLVector2				*mTexCoords;
 	LLVector2				*mDetailTexCoords;
 	F32						*mWeights;
+
+	// vertex indices grouped by weight, for the skinning kernels
+	std::vector<U32>		mSkinOrder;
+	U32						mNumSkinRuns;
+	LLV4SkinRun				*mSkinRuns;
 	
 	BOOL					mHasWeights;
 	BOOL					mHasDetailTexCoords;
@@ -280,6 +287,22 @@ public:
 
 	F32			*getWritableWeights() const;
 
+	// Get vertex indices grouped into runs of identical weight
+	const U32 *getSkinOrder() const {
+		llassert (mSharedData);
+		return mSharedData->mSkinOrder.empty() ? NULL : &mSharedData->mSkinOrder[0];
+	}
+
+	U32 getNumSkinRuns() const {
+		llassert (mSharedData);
+		return mSharedData->mNumSkinRuns;
+	}
+
+	const LLV4SkinRun *getSkinRuns() const {
+		llassert (mSharedData);
+		return mSharedData->mSkinRuns;
+	}
+
 	LLVector4	*getWritableClothingWeights();
 
 	const LLVector4		*getClothingWeights()
@@ -327,6 +350,31 @@ public:
 	void setAvatar(LLVOAvatar* avatarp) { mAvatarp = avatarp; }
 	LLVOAvatar* getAvatar() { return mAvatarp; }
 
+	// Morph targets deforming this mesh.  They belong to the same avatar
+	// and are deleted after it, so they are never unregistered.
+	void addMorphTarget(LLPolyMorphTarget* target) { mMorphTargets.push_back(target); }
+	BOOL hasMorphTargets() const { return !mMorphTargets.empty(); }
+
+	//--------------------------------------------------------------------
+	// Appearance cache
+	// Fully morphed geometry is kept per shared mesh and morph weight hash,
+	// so avatars with identical shapes copy it instead of blending every
+	// morph target again.
+	//--------------------------------------------------------------------
+	// Hashes the weights the morph targets are about to reach, or have
+	// reached if 'applied' is set.  Returns FALSE if the mesh can't be
+	// cached right now (params animating, morph masks in use).
+	BOOL getAppearanceHash(ESex sex, BOOL applied, U64& hash);
+	// Returns TRUE if any morph target has yet to reach its weight
+	BOOL needsMorph(ESex sex);
+	BOOL hasCachedAppearance(U64 hash) const;
+	// Copies cached geometry in and brings the morph targets up to date
+	void applyCachedAppearance(U64 hash, ESex sex);
+	void cacheAppearance(U64 hash);
+
+	static void setAppearanceCacheSize(U32 max_bytes);
+	static void freeAppearanceCache();
+
 	LLDynamicArray<LLJointRenderData*>	mJointRenderData;
 
 	U32				mFaceVertexOffset;
@@ -337,6 +385,8 @@ public:
 private:
 	void initializeForMorph();
 
+	U32 getNumVertexFloats() const { return mSharedData->mNumVertices * (3*5 + 2 + 4); }
+
 	// Dumps diagnostic information about the global mesh table
 	static void dumpDiagInfo();
 
@@ -366,6 +416,21 @@ protected:
 	typedef std::map<std::string, LLPolyMeshSharedData*> LLPolyMeshSharedDataTable; 
 	static LLPolyMeshSharedDataTable sGlobalSharedMeshList;
 
+	// morphed geometry keyed by shared mesh and morph weight hash
+	struct LLPolyMeshAppearance
+	{
+		F32*	mVertexData;
+		U32		mNumFloats;
+		U32		mLastUsed;
+	};
+	typedef std::map<std::pair<LLPolyMeshSharedData*, U64>, LLPolyMeshAppearance> appearance_cache_t;
+	static appearance_cache_t sAppearanceCache;
+	static U32 sAppearanceCacheBytes;
+	static U32 sAppearanceCacheMaxBytes;
+	static U32 sAppearanceCacheClock;
+
+	std::vector<LLPolyMorphTarget*> mMorphTargets;
+
 	// Backlink only; don't make this an LLPointer.
 	LLVOAvatar* mAvatarp;
 };
@@ -419,6 +484,7 @@ public:
 	// LLVisualParam Virtual functions
 	///*virtual*/ BOOL				parseData(LLXmlTreeNode* node);
 	/*virtual*/ void				apply( ESex sex );
+	/*virtual*/ U32					getApplyStages() const { return VISUAL_PARAM_STAGE_SKELETON; }
 	
 	// LLViewerVisualParam Virtual functions
 	/*virtual*/ F32					getTotalDistortion() { return 0.1f; }
@@ -44,6 +44,11 @@
 
 const F32 NORMAL_SOFTEN_FACTOR = 0.65f;
 
+// While a param is animating, weight changes smaller than this are left to
+// accumulate rather than walking the whole morph for an invisible change.
+// The final apply when the animation stops catches up exactly.
+const F32 MORPH_MIN_ANIMATING_DELTA = 0.002f;
+
 //-----------------------------------------------------------------------------
 // LLPolyMorphData()
 //-----------------------------------------------------------------------------
@@ -60,6 +65,7 @@ LLPolyMorphData::LLPolyMorphData(const std::string& morph_name)
 	mNormals = NULL;
 	mBinormals = NULL;
 	mTexCoords = NULL;
+	mDeltas = NULL;
 
 	mMesh = NULL;
 }
@@ -74,6 +80,7 @@ LLPolyMorphData::~LLPolyMorphData()
 	delete [] mNormals;
 	delete [] mBinormals;
 	delete [] mTexCoords;
+	delete [] mDeltas;
 }
 
 //-----------------------------------------------------------------------------
@@ -177,6 +184,15 @@ BOOL LLPolyMorphData::loadBinary(LLFILE *fp, LLPolyMeshSharedData *mesh)
 	mAvgDistortion = mAvgDistortion * (1.f/(F32)mNumIndices);
 	mAvgDistortion.normVec();
 
+	mDeltas = new LLPolyMorphDelta[mNumIndices];
+	for (U32 i = 0; i < mNumIndices; i++)
+	{
+		mDeltas[i].mCoord = mCoords[i];
+		mDeltas[i].mScaledNormal = mNormals[i] * NORMAL_SOFTEN_FACTOR;
+		mDeltas[i].mScaledBinormal = mBinormals[i] * NORMAL_SOFTEN_FACTOR;
+		mDeltas[i].mTexCoord = mTexCoords[i];
+	}
+
 	return TRUE;
 }
 
@@ -248,7 +264,8 @@ LLPolyMorphTarget::LLPolyMorphTarget(LLPolyMesh *poly_mesh)
 	: mMorphData(NULL), mMesh(poly_mesh),
 	  mVertMask(NULL),
 	  mLastSex(SEX_FEMALE),
-	  mNumMorphMasksPending(0)
+	  mNumMorphMasksPending(0),
+	  mClothingApplied(FALSE)
 {
 }
 
@@ -298,6 +315,7 @@ BOOL LLPolyMorphTarget::setInfo(LLPolyMorphTargetInfo* info)
 		llwarns << "No morph target named " << getInfo()->mMorphName << " found in mesh." << llendl;
 		return FALSE;  // Continue, ignoring this tag
 	}
+	mMesh->addMorphTarget(this);
 	return TRUE;
 }
 
@@ -446,7 +464,11 @@ void LLPolyMorphTarget::apply( ESex avatar_sex )
 	mLastSex = avatar_sex;
 
 	// perform differential update of morph
-	F32 delta_weight = ( getSex() & avatar_sex ) ? (mCurWeight - mLastWeight) : (getDefaultWeight() - mLastWeight);
+	F32 delta_weight = getEffectiveWeight(avatar_sex) - mLastWeight;
+	if (mIsAnimating && fabs(delta_weight) < MORPH_MIN_ANIMATING_DELTA)
+	{
+		delta_weight = 0.f;
+	}
 	// store last weight
 	mLastWeight += delta_weight;
 
@@ -461,58 +483,58 @@ void LLPolyMorphTarget::apply( ESex avatar_sex )
 		LLVector3 *scaled_binormals = mMesh->getScaledBinormals();
 		LLVector3 *binormals = mMesh->getWritableBinormals();
 
-		LLVector4 *clothing_weights = mMesh->getWritableClothingWeights();
+		LLVector4 *clothing_weights = getInfo()->mIsClothingMorph ? mMesh->getWritableClothingWeights() : NULL;
 		LLVector2 *tex_coords = mMesh->getWritableTexCoords();
 
 		F32 *maskWeightArray = (mVertMask) ? mVertMask->getMorphMaskWeights() : NULL;
 
+		const U32 *vertex_indices = mMorphData->mVertexIndices;
+		const LLPolyMorphDelta *deltas = mMorphData->mDeltas;
+
 		for(U32 vert_index_morph = 0; vert_index_morph < mMorphData->mNumIndices; vert_index_morph++)
 		{
-			S32 vert_index_mesh = mMorphData->mVertexIndices[vert_index_morph];
+			S32 vert_index_mesh = vertex_indices[vert_index_morph];
+			const LLPolyMorphDelta& delta = deltas[vert_index_morph];
 
 			F32 maskWeight = 1.f;
 			if (maskWeightArray)
 			{
 				maskWeight = maskWeightArray[vert_index_morph];
 			}
+			F32 weight = delta_weight * maskWeight;
 
-			coords[vert_index_mesh] += mMorphData->mCoords[vert_index_morph] * delta_weight * maskWeight;
-			if (getInfo()->mIsClothingMorph && clothing_weights)
+			LLVector3 coord_offset = delta.mCoord * weight;
+			coords[vert_index_mesh] += coord_offset;
+			if (clothing_weights)
 			{
-				LLVector3 clothing_offset = mMorphData->mCoords[vert_index_morph] * delta_weight * maskWeight;
 				LLVector4* clothing_weight = &clothing_weights[vert_index_mesh];
-				clothing_weight->mV[VX] += clothing_offset.mV[VX];
-				clothing_weight->mV[VY] += clothing_offset.mV[VY];
-				clothing_weight->mV[VZ] += clothing_offset.mV[VZ];
+				clothing_weight->mV[VX] += coord_offset.mV[VX];
+				clothing_weight->mV[VY] += coord_offset.mV[VY];
+				clothing_weight->mV[VZ] += coord_offset.mV[VZ];
 				clothing_weight->mV[VW] = maskWeight;
 			}
 
 			// calculate new normals based on half angles
-			scaled_normals[vert_index_mesh] += mMorphData->mNormals[vert_index_morph] * delta_weight * maskWeight * NORMAL_SOFTEN_FACTOR;
+			scaled_normals[vert_index_mesh] += delta.mScaledNormal * weight;
 			LLVector3 normalized_normal = scaled_normals[vert_index_mesh];
 			normalized_normal.normVec();
 			normals[vert_index_mesh] = normalized_normal;
 
 			// calculate new binormals
-			scaled_binormals[vert_index_mesh] += mMorphData->mBinormals[vert_index_morph] * delta_weight * maskWeight * NORMAL_SOFTEN_FACTOR;
+			scaled_binormals[vert_index_mesh] += delta.mScaledBinormal * weight;
 			LLVector3 tangent = scaled_binormals[vert_index_mesh] % normalized_normal;
 			LLVector3 normalized_binormal = normalized_normal % tangent; 
 			normalized_binormal.normVec();
 			binormals[vert_index_mesh] = normalized_binormal;
 
-			tex_coords[vert_index_mesh] += mMorphData->mTexCoords[vert_index_morph] * delta_weight * maskWeight;
+			tex_coords[vert_index_mesh] += delta.mTexCoord * weight;
 		}
-
-		// now apply volume changes
-		for( volume_list_t::iterator iter = mVolumeMorphs.begin(); iter != mVolumeMorphs.end(); iter++ )
+		if (clothing_weights)
 		{
-			LLPolyVolumeMorph* volume_morph = &(*iter);
-			LLVector3 scale_delta = volume_morph->mScale * delta_weight;
-			LLVector3 pos_delta = volume_morph->mPos * delta_weight;
-			
-			volume_morph->mVolume->setScale(volume_morph->mVolume->getScale() + scale_delta);
-			volume_morph->mVolume->setPosition(volume_morph->mVolume->getPosition() + pos_delta);
+			mClothingApplied = TRUE;
 		}
+
+		applyVolumeMorphs(delta_weight);
 	}
 
 	if (mNext)
@@ -521,6 +543,42 @@ void LLPolyMorphTarget::apply( ESex avatar_sex )
 	}
 }
 
+//-----------------------------------------------------------------------------
+// applyCachedMorph()
+//-----------------------------------------------------------------------------
+void LLPolyMorphTarget::applyCachedMorph( ESex avatar_sex )
+{
+	mLastSex = avatar_sex;
+
+	F32 delta_weight = getEffectiveWeight(avatar_sex) - mLastWeight;
+	mLastWeight += delta_weight;
+
+	if (delta_weight != 0.f)
+	{
+		if (isClothingMorph() && mMesh->getWritableClothingWeights())
+		{
+			mClothingApplied = TRUE;
+		}
+		applyVolumeMorphs(delta_weight);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// applyVolumeMorphs()
+//-----------------------------------------------------------------------------
+void LLPolyMorphTarget::applyVolumeMorphs( F32 delta_weight )
+{
+	for( volume_list_t::iterator iter = mVolumeMorphs.begin(); iter != mVolumeMorphs.end(); iter++ )
+	{
+		LLPolyVolumeMorph* volume_morph = &(*iter);
+		LLVector3 scale_delta = volume_morph->mScale * delta_weight;
+		LLVector3 pos_delta = volume_morph->mPos * delta_weight;
+		
+		volume_morph->mVolume->setScale(volume_morph->mVolume->getScale() + scale_delta);
+		volume_morph->mVolume->setPosition(volume_morph->mVolume->getPosition() + pos_delta);
+	}
+}
+
 //-----------------------------------------------------------------------------
 // applyMask()
 //-----------------------------------------------------------------------------
@@ -551,14 +609,16 @@ void	LLPolyMorphTarget::applyMask(U8 *maskTextureData, S32 width, S32 height, S3
 				S32 out_vert = mMorphData->mVertexIndices[vert];
 
 				// remove effect of existing masked morph
-				coords[out_vert] -= mMorphData->mCoords[vert] * lastMaskWeight;
-				scaled_normals[out_vert] -= mMorphData->mNormals[vert] * lastMaskWeight * NORMAL_SOFTEN_FACTOR;
-				scaled_binormals[out_vert] -= mMorphData->mBinormals[vert] * lastMaskWeight * NORMAL_SOFTEN_FACTOR;
-				tex_coords[out_vert] -= mMorphData->mTexCoords[vert] * lastMaskWeight;
+				const LLPolyMorphDelta& delta = mMorphData->mDeltas[vert];
+				LLVector3 coord_offset = delta.mCoord * lastMaskWeight;
+				coords[out_vert] -= coord_offset;
+				scaled_normals[out_vert] -= delta.mScaledNormal * lastMaskWeight;
+				scaled_binormals[out_vert] -= delta.mScaledBinormal * lastMaskWeight;
+				tex_coords[out_vert] -= delta.mTexCoord * lastMaskWeight;
 
 				if (clothing_weights)
 				{
-					LLVector3 clothing_offset = mMorphData->mCoords[vert] * lastMaskWeight;
+					LLVector3 clothing_offset = coord_offset;
 					LLVector4* clothing_weight = &clothing_weights[out_vert];
 					clothing_weight->mV[VX] -= clothing_offset.mV[VX];
 					clothing_weight->mV[VY] -= clothing_offset.mV[VY];
@@ -37,12 +37,27 @@
 #include <vector>
 
 #include "llviewervisualparam.h"
+#include "v2math.h"
+#include "v3math.h"
 
 class LLPolyMeshSharedData;
 class LLVOAvatar;
-class LLVector2;
 class LLViewerJointCollisionVolume;
 
+//-----------------------------------------------------------------------------
+// LLPolyMorphDelta
+// Everything LLPolyMorphTarget::apply() adds to one vertex, packed together
+// so a morph is a single linear walk.  Normals and binormals are premultiplied
+// by the soften factor.
+//-----------------------------------------------------------------------------
+struct LLPolyMorphDelta
+{
+	LLVector3			mCoord;
+	LLVector3			mScaledNormal;
+	LLVector3			mScaledBinormal;
+	LLVector2			mTexCoord;
+};
+
 //-----------------------------------------------------------------------------
 // LLPolyMorphData()
 //-----------------------------------------------------------------------------
@@ -66,6 +81,8 @@ public:
 	LLVector3*			mNormals;
 	LLVector3*			mBinormals;
 	LLVector2*			mTexCoords;
+	// the same deltas, packed, parallel to mVertexIndices
+	LLPolyMorphDelta*	mDeltas;
 
 	F32					mTotalDistortion;	// vertex distortion summed over entire morph
 	F32					mMaxDistortion;		// maximum single vertex distortion in a given morph
@@ -144,6 +161,7 @@ protected:
 //-----------------------------------------------------------------------------
 class LLPolyMorphTarget : public LLViewerVisualParam
 {
+	friend class LLPolyMesh;
 public:
 	LLPolyMorphTarget(LLPolyMesh *poly_mesh);
 	~LLPolyMorphTarget();
@@ -156,6 +174,7 @@ public:
 	// LLVisualParam Virtual functions
 	///*virtual*/ BOOL				parseData(LLXmlTreeNode* node);
 	/*virtual*/ void				apply( ESex sex );
+	/*virtual*/ U32					getApplyStages() const { return VISUAL_PARAM_STAGE_MORPH; }
 	
 	// LLViewerVisualParam Virtual functions
 	/*virtual*/ F32					getTotalDistortion();
@@ -168,13 +187,24 @@ public:
 	void	applyMask(U8 *maskData, S32 width, S32 height, S32 num_components, BOOL invert);
 	void	addPendingMorphMask() { mNumMorphMasksPending++; }
 
+	// Brings the weight and collision volumes up to date without touching
+	// the mesh, after LLPolyMesh has restored its geometry from the
+	// appearance cache.
+	void	applyCachedMorph( ESex avatar_sex );
+
 protected:
+	F32		getEffectiveWeight( ESex avatar_sex ) { return ( getSex() & avatar_sex ) ? mCurWeight : getDefaultWeight(); }
+	BOOL	isClothingMorph() const { return getInfo()->mIsClothingMorph; }
+	void	applyVolumeMorphs( F32 delta_weight );
+
 	LLPolyMorphData*				mMorphData;
 	LLPolyMesh*						mMesh;
 	LLPolyVertexMask *				mVertMask;
 	ESex							mLastSex;
 	// number of morph masks that haven't been generated, must be 0 before this morph is applied
 	BOOL							mNumMorphMasksPending;	
+	// set once a clothing morph has written clothing weights
+	BOOL							mClothingApplied;
 
 	typedef std::vector<LLPolyVolumeMorph> volume_list_t;
 	volume_list_t 					mVolumeMorphs;
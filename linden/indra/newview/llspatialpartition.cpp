@@ -47,6 +47,7 @@
 #include "pipeline.h"
 #include "llrender.h"
 #include "lloctree.h"
+#include "llradixsort.h"
 #include "llvoavatar.h"
 
 const F32 SG_OCCLUSION_FUDGE = 0.25f;
@@ -468,7 +469,7 @@ void validate_draw_info(LLDrawInfo& params)
 	}
 	
 	//bad indices
-	U32* indicesp = (U32*) params.mVertexBuffer->getIndicesPointer();
+	U32* indicesp = (U32*) params.mVertexBuffer->getMappedIndices();
 	if (indicesp)
 	{
 		for (U32 i = params.mOffset; i < params.mOffset+params.mCount; i++)
@@ -2943,6 +2944,27 @@ LLDrawInfo::~LLDrawInfo()
 	}
 }
 
+//fold a pointer into the low bits bits of a sort key field
+static U64 sort_key_bits(const void* ptr, U32 bits)
+{
+	U64 val = ((U64) (size_t) ptr) >> 4; //allocations are at least 16 byte aligned
+	val ^= val >> bits;
+	val ^= val >> (bits * 2);
+	return val & ((((U64) 1) << bits) - 1);
+}
+
+U64 LLDrawInfo::getSortKey(U32 pass) const
+{
+	//  6 bits pass, 8 bits bump, 24 bits texture, 12 bits matrix, 14 bits vertex buffer
+	U64 bump = pass == LLRenderPass::PASS_BUMP ? mBump : 0;
+
+	return ((U64) (pass & 0x3F) << 58) |
+			(bump << 50) |
+			(sort_key_bits(mTexture.get(), 24) << 26) |
+			(sort_key_bits(mModelMatrix, 12) << 14) |
+			sort_key_bits(mVertexBuffer.get(), 14);
+}
+
 LLVertexBuffer* LLGeometryManager::createVertexBuffer(U32 type_mask, U32 usage)
 {
 	return new LLVertexBuffer(type_mask, usage);
@@ -3133,6 +3155,31 @@ void LLCullResult::pushDrawInfo(U32 type, LLDrawInfo* draw_info)
 	++mRenderMapSize[type];
 }
 
+void LLCullResult::sortRenderMap(U32 type)
+{
+	U32 count = mRenderMapSize[type];
+	if (count < 2)
+	{
+		return;
+	}
+
+	mSortList.resize(count);
+	for (U32 i = 0; i < count; i++)
+	{
+		LLDrawInfo* draw_info = mRenderMap[type][i];
+		mSortList[i].first = draw_info->getSortKey(type);
+		mSortList[i].second = draw_info;
+	}
+
+	//stable, so batches from the same group stay in index order and
+	//can be merged at submission
+	ll_radix_sort(mSortList, mSortScratch);
+
+	for (U32 i = 0; i < count; i++)
+	{
+		mRenderMap[type][i] = mSortList[i].second;
+	}
+}
 
 void LLCullResult::assertDrawMapsEmpty()
 {
@@ -90,6 +90,24 @@ public:
 	F32 mDistance;
 	LLVector3 mExtents[2];
 
+	// Set when mVertexBuffer holds one volume face in volume space, shared
+	// by identical prims; the batch is drawn once per instance.
+	struct Instance
+	{
+		LLMatrix4 mMatrix;			//volume to region space
+		LLMatrix3 mNormalMatrix;	//inverse transpose of mMatrix
+	};
+	typedef std::vector<Instance> instance_list_t;
+	instance_list_t mInstances;
+
+	// Key for ordering batches within render pass type so that state
+	// changes are minimized when they're submitted in ascending order.
+	// From the most significant bits down: pass (pool/shader), bump code
+	// (bump pass only), texture, model matrix, vertex buffer.  Pointers
+	// are folded into their fields, so distinct objects may share a value;
+	// that only costs a state change, never correctness.
+	U64 getSortKey(U32 pass) const;
+
 	struct CompareTexture
 	{
 		bool operator()(const LLDrawInfo& lhs, const LLDrawInfo& rhs)
@@ -453,6 +471,9 @@ public:
 	void pushDrawable(LLDrawable* drawable);
 	void pushBridge(LLSpatialBridge* bridge);
 	void pushDrawInfo(U32 type, LLDrawInfo* draw_info);
+
+	// radix sort render map type by LLDrawInfo::getSortKey
+	void sortRenderMap(U32 type);
 	
 	U32 getVisibleGroupsSize()		{ return mVisibleGroupsSize; }
 	U32	getAlphaGroupsSize()		{ return mAlphaGroupsSize; }
@@ -479,6 +500,10 @@ private:
 	drawable_list_t		mVisibleList;
 	bridge_list_t		mVisibleBridge;
 	drawinfo_list_t		mRenderMap[LLRenderPass::NUM_RENDER_TYPES];
+
+	typedef std::vector<std::pair<U64, LLDrawInfo*> > sort_list_t;
+	sort_list_t			mSortList;
+	sort_list_t			mSortScratch;
 };
 
 
@@ -553,6 +578,21 @@ public:
 	void genDrawInfo(LLSpatialGroup* group, U32 mask, std::vector<LLFace*>& faces, BOOL distance_sort = FALSE);
 	void registerFace(LLSpatialGroup* group, LLFace* facep, U32 type);
 
+	// Moves faces of identical prims (same LLVolume, face and texture
+	// entry) out of faces and into instanced batches that share one
+	// vertex buffer of volume space geometry.
+	void genInstances(LLSpatialGroup* group, U32 mask, std::vector<LLFace*>& faces);
+	static BOOL canInstance(LLFace* facep);
+
+	// Shared volume space geometry for facep, NULL if none is cached and
+	// create is FALSE (or building it failed).
+	static LLVertexBuffer* getInstanceGeometry(LLFace* facep, U32 mask, BOOL create);
+
+	// Release all shared instance geometry (GL shutdown or reset).
+	static void cleanupInstances();
+
+	static U32 sInstanceGeometryCount;	//shared buffers alive
+
 };
 
 //spatial partition that uses volume geometry manager (implemented in LLVOVolume.cpp)
@@ -43,6 +43,7 @@
 #include "llpolymorph.h"
 #include "llquantize.h"
 #include "lltexlayer.h"
+#include "lltexlayercompositor.h"
 #include "llui.h"
 #include "llvfile.h"
 #include "llviewerimagelist.h"
@@ -99,6 +100,8 @@ LLTexLayerSetBuffer::LLTexLayerSetBuffer( LLTexLayerSet* owner, S32 width, S32 h
 	mNeedsUpdate( TRUE ),
 	mNeedsUpload( FALSE ),
 	mUploadPending( FALSE ), // Not used for any logic here, just to sync sending of updates
+	mBakePending( FALSE ),
+	mReadBackBake( FALSE ),
 	mTexLayerSet( owner )	
 {
 	LLTexLayerSetBuffer::sGLByteCount += getSize();
@@ -110,6 +113,7 @@ LLTexLayerSetBuffer::LLTexLayerSetBuffer( LLTexLayerSet* owner, S32 width, S32 h
 
 LLTexLayerSetBuffer::~LLTexLayerSetBuffer()
 {
+	cancelBake();
 	LLTexLayerSetBuffer::sGLByteCount -= getSize();
 
 	if( mBumpTex.notNull())
@@ -189,6 +193,7 @@ void LLTexLayerSetBuffer::requestUpdate()
 	// If we're in the middle of uploading a baked texture, we don't care about it any more.
 	// When it's downloaded, ignore it.
 	mUploadID.setNull();
+	cancelBake();
 }
 
 void LLTexLayerSetBuffer::requestUpload()
@@ -207,6 +212,16 @@ void LLTexLayerSetBuffer::cancelUpload()
 		mNeedsUpload = FALSE;
 	}
 	mUploadPending = FALSE;
+	cancelBake();
+}
+
+void LLTexLayerSetBuffer::cancelBake()
+{
+	if (mBakePending)
+	{
+		LLTexLayerCompositor::cancel(this);
+		mBakePending = FALSE;
+	}
 }
 
 void LLTexLayerSetBuffer::pushProjection()
@@ -233,7 +248,7 @@ void LLTexLayerSetBuffer::popProjection()
 BOOL LLTexLayerSetBuffer::needsRender()
 {
 	LLVOAvatar* avatar = mTexLayerSet->getAvatar();
-	BOOL upload_now = mNeedsUpload && mTexLayerSet->isLocalTextureDataFinal();
+	BOOL upload_now = mNeedsUpload && !mBakePending && mTexLayerSet->isLocalTextureDataFinal();
 	BOOL needs_update = gAgent.mNumPendingQueries == 0 && (mNeedsUpdate || upload_now) && !avatar->mAppearanceAnimating;
 	if (needs_update)
 	{
@@ -279,7 +294,7 @@ BOOL LLTexLayerSetBuffer::render()
 
 	// do we need to upload, and do we have sufficient data to create an uploadable composite?
 	// When do we upload the texture if gAgent.mNumPendingQueries is non-zero?
-	BOOL upload_now = (gAgent.mNumPendingQueries == 0 && mNeedsUpload && mTexLayerSet->isLocalTextureDataFinal());
+	BOOL upload_now = (gAgent.mNumPendingQueries == 0 && mNeedsUpload && !mBakePending && mTexLayerSet->isLocalTextureDataFinal());
 	BOOL success = TRUE;
 
 	// Composite bump
@@ -323,8 +338,15 @@ BOOL LLTexLayerSetBuffer::render()
 			llinfos << "Failed attempt to bake " << mTexLayerSet->getBodyRegion() << llendl;
 			mUploadPending = FALSE;
 		}
+		else if (!mReadBackBake && LLTexLayerCompositor::bake(this, mTexLayerSet, mWidth, mHeight))
+		{
+			// uploadBake() sends it once the compositor is done
+			mBakePending = TRUE;
+			delete [] baked_bump_data;
+		}
 		else
 		{
+			mReadBackBake = FALSE;
 			readBackAndUpload(baked_bump_data);
 		}
 	}
@@ -386,8 +408,38 @@ void LLTexLayerSetBuffer::readBackAndUpload(U8* baked_bump_data)
 	mTexLayerSet->gatherAlphaMasks(baked_mask_data, mWidth, mHeight);
 //	imdebug("lum b=8 w=%d h=%d %p", mWidth, mHeight, baked_mask_data);
 
+	uploadBakedData(baked_color_data, baked_mask_data);
 
-	// writes into baked_color_data
+	delete [] baked_color_data;
+	delete [] baked_bump_data;
+}
+
+// Called by LLTexLayerCompositor with the images it built, or NULL if it failed.
+void LLTexLayerSetBuffer::uploadBake(LLImageRaw* baked_color_image, LLImageRaw* baked_mask_image)
+{
+	mBakePending = FALSE;
+
+	if (!baked_color_image || !baked_mask_image)
+	{
+		// mNeedsUpload is still set, so the next render reads it back instead
+		llinfos << "Failed attempt to composite " << mTexLayerSet->getBodyRegion() << ", reading back instead" << llendl;
+		mReadBackBake = TRUE;
+		return;
+	}
+
+	llinfos << "Baked " << mTexLayerSet->getBodyRegion() << " on the CPU" << llendl;
+	LLViewerStats::getInstance()->incStat(LLViewerStats::ST_TEX_BAKES);
+
+	llassert( gAgent.getAvatarObject() == mTexLayerSet->getAvatar() );
+
+	mTexLayerSet->deleteCaches();
+
+	uploadBakedData(baked_color_image->getData(), baked_mask_image->getData());
+}
+
+// Packs the composite and its mask into the upload image, encodes it and sends it.
+void LLTexLayerSetBuffer::uploadBakedData(const U8* baked_color_data, const U8* baked_mask_data)
+{
 	const char* comment_text = NULL;
 
 	S32 baked_image_components = mBumpTex.notNull() ? 5 : 4; // red green blue [bump] clothing
@@ -541,9 +593,6 @@ void LLTexLayerSetBuffer::readBackAndUpload(U8* baked_bump_data)
 		mUploadPending = FALSE;
 		llinfos << "unable to create baked upload file" << llendl;
 	}
-
-	delete [] baked_color_data;
-	delete [] baked_bump_data;
 }
 
 
@@ -1015,6 +1064,38 @@ void LLTexLayerSet::applyMorphMask(U8* tex_data, S32 width, S32 height, S32 num_
 	}
 }
 
+// Records what render() and gatherAlphaMasks() would draw, for
+// LLTexLayerCompositor.  Returns FALSE if an input isn't available.
+BOOL LLTexLayerSet::gatherBake(LLTexLayerBake* bake)
+{
+	for( layer_list_t::iterator iter = mLayerList.begin(); iter != mLayerList.end(); iter++ )
+	{
+		LLTexLayer* layer = *iter;
+		if( !layer->gatherBake( bake ) )
+		{
+			return FALSE;
+		}
+	}
+
+	if( !getInfo()->mStaticAlphaFileName.empty() )
+	{
+		LLImageTGA* image_tga = gTexStaticImageList.getImageTGA( getInfo()->mStaticAlphaFileName );
+		if( !image_tga )
+		{
+			return FALSE;
+		}
+		bake->mHasStaticAlpha = TRUE;
+		bake->mStaticAlpha.mTGA = image_tga;
+		bake->mStaticAlpha.mIsMask = TRUE;
+	}
+	else
+	{
+		bake->mClearAlpha = getInfo()->mClearAlpha;
+	}
+
+	return TRUE;
+}
+
 //-----------------------------------------------------------------------------
 // LLTexLayerInfo
 //-----------------------------------------------------------------------------
@@ -1484,6 +1565,168 @@ BOOL LLTexLayer::render( S32 x, S32 y, S32 width, S32 height )
 	return success;
 }
 
+// Converts a color component the way glColor4f() does
+static U8 gl_color_byte(F32 value)
+{
+	return (U8)llclampb(llround(value * 255.f));
+}
+
+// Records this layer's alpha mask and, for color layers, its draws the way
+// render() and renderAlphaMasks() do them.
+BOOL LLTexLayer::gatherBake( LLTexLayerBake* bake )
+{
+	bake->mLayers.push_back(LLTexLayerBake::Layer());
+	LLTexLayerBake::Layer& layer = bake->mLayers.back();
+
+	LLColor4 net_color;
+	BOOL color_specified = findNetColor( &net_color );
+	BOOL is_color = (getRenderPass() == RP_COLOR);
+
+	LLPointer<LLImageRaw> local_image;
+	if( (getInfo()->mLocalTexture != -1) && (is_color || !mParamAlphaList.empty()) )
+	{
+		LLPointer<LLImageRaw> image_raw = new LLImageRaw;
+		if( !mTexLayerSet->getAvatar()->getLocalTextureRaw((ETextureIndex)getInfo()->mLocalTexture, image_raw) )
+		{
+			return FALSE;
+		}
+		// the default avatar texture reads back empty and isn't drawn
+		if( image_raw->getData() )
+		{
+			local_image = image_raw;
+		}
+	}
+
+	if( !mParamAlphaList.empty() )
+	{
+		layer.mHasAlphaMask = TRUE;
+		layer.mKeepAlpha = mParamAlphaList.front()->getMultiplyBlend();
+
+		for( alpha_list_t::iterator iter = mParamAlphaList.begin(); iter != mParamAlphaList.end(); iter++ )
+		{
+			LLTexLayerParamAlpha* param = *iter;
+			if( !param->gatherBake( bake ) )
+			{
+				return FALSE;
+			}
+		}
+
+		LLTexLayerBake::AlphaOp op;
+		op.mMultiply = TRUE;
+		op.mHasSource = TRUE;
+		if( local_image.notNull() && (local_image->getComponents() == 4) )
+		{
+			op.mSource.mRaw = local_image;
+			op.mSource.mMipmapped = TRUE;
+			layer.mAlphaOps.push_back(op);
+		}
+
+		if( !getInfo()->mStaticImageFileName.empty() )
+		{
+			LLImageTGA* image_tga = gTexStaticImageList.getImageTGA( getInfo()->mStaticImageFileName );
+			if( !image_tga )
+			{
+				return FALSE;
+			}
+			if(	(image_tga->getComponents() == 4) ||
+				( (image_tga->getComponents() == 1) && getInfo()->mStaticImageIsMask ) )
+			{
+				op.mSource = LLTexLayerBake::Source();
+				op.mSource.mTGA = image_tga;
+				op.mSource.mIsMask = getInfo()->mStaticImageIsMask;
+				layer.mAlphaOps.push_back(op);
+			}
+		}
+
+		if( net_color.mV[VW] != 1.f )
+		{
+			op.mHasSource = FALSE;
+			op.mSource = LLTexLayerBake::Source();
+			op.mValue = gl_color_byte( net_color.mV[VW] );
+			layer.mAlphaOps.push_back(op);
+		}
+	}
+
+	// The rest mirrors the skips in render()
+	if( !is_color || is_approx_zero( net_color.mV[VW] ) )
+	{
+		return TRUE;
+	}
+
+	if( !mParamAlphaList.empty() && mMaskedMorphs.empty() )
+	{
+		BOOL skip_layer = TRUE;
+		for( alpha_list_t::iterator iter = mParamAlphaList.begin(); iter != mParamAlphaList.end(); iter++ )
+		{
+			if( !(*iter)->getSkip() )
+			{
+				skip_layer = FALSE;
+				break;
+			}
+		}
+		if( skip_layer )
+		{
+			return TRUE;
+		}
+	}
+
+	layer.mDraw = TRUE;
+	if( getInfo()->mWriteAllChannels )
+	{
+		layer.mBlend = LLImageBlend::BLEND_REPLACE;
+	}
+	else if( !mParamAlphaList.empty() )
+	{
+		layer.mBlend = LLImageBlend::BLEND_DEST_ALPHA;
+	}
+	else
+	{
+		layer.mBlend = LLImageBlend::BLEND_ALPHA;
+	}
+	for( S32 i = 0; i < 4; i++ )
+	{
+		layer.mColor[i] = gl_color_byte( net_color.mV[i] );
+	}
+
+	LLTexLayerBake::ColorOp op;
+	if( local_image.notNull() && !getInfo()->mUseLocalTextureAlphaOnly )
+	{
+		op.mHasSource = TRUE;
+		op.mSource.mRaw = local_image;
+		op.mSource.mMipmapped = TRUE;
+		op.mAlphaTest = getInfo()->mWriteAllChannels ? 0 : LLImageBlend::DEFAULT_ALPHA_TEST;
+		layer.mColorOps.push_back(op);
+	}
+
+	if( !getInfo()->mStaticImageFileName.empty() )
+	{
+		LLImageTGA* image_tga = gTexStaticImageList.getImageTGA( getInfo()->mStaticImageFileName );
+		if( !image_tga )
+		{
+			return FALSE;
+		}
+		op.mHasSource = TRUE;
+		op.mSource = LLTexLayerBake::Source();
+		op.mSource.mTGA = image_tga;
+		op.mSource.mIsMask = getInfo()->mStaticImageIsMask;
+		op.mAlphaTest = LLImageBlend::DEFAULT_ALPHA_TEST;
+		layer.mColorOps.push_back(op);
+	}
+
+	if( ((-1 == getInfo()->mLocalTexture) ||
+		 getInfo()->mUseLocalTextureAlphaOnly) &&
+		getInfo()->mStaticImageFileName.empty() &&
+		color_specified )
+	{
+		op.mHasSource = FALSE;
+		op.mSource = LLTexLayerBake::Source();
+		op.mAlphaTest = 0;
+		layer.mColorOps.push_back(op);
+	}
+
+	return TRUE;
+}
+
 U8*	LLTexLayer::getAlphaData()
 {
 	LLCRC alpha_mask_crc;
@@ -1977,7 +2220,7 @@ void LLTexLayerParamAlpha::setWeight(F32 weight, BOOL set_by_user)
 			}
 			avatar->invalidateComposite( mTexLayer->getTexLayerSet(), set_by_user );
 			mTexLayer->invalidateMorphMasks();
-			avatar->updateMeshTextures();
+			avatar->dirtyMeshTextures();
 		}
 	}
 }
@@ -2127,6 +2370,42 @@ BOOL LLTexLayerParamAlpha::render( S32 x, S32 y, S32 width, S32 height )
 	return success;
 }
 
+// Records render() for LLTexLayer::gatherBake().  The alpha gradient is
+// processed on the worker.
+BOOL LLTexLayerParamAlpha::gatherBake( LLTexLayerBake* bake )
+{
+	if( getSkip() )
+	{
+		return TRUE;
+	}
+
+	F32 effective_weight = ( mTexLayer->getTexLayerSet()->getAvatar()->getSex() & getSex() ) ? mCurWeight : getDefaultWeight();
+
+	LLTexLayerBake::AlphaOp op;
+	op.mMultiply = getInfo()->mMultiplyBlend;
+	if( !getInfo()->mStaticImageFileName.empty() && !mStaticImageInvalid)
+	{
+		LLImageTGA* image_tga = gTexStaticImageList.getImageTGA( getInfo()->mStaticImageFileName );
+		if( !image_tga )
+		{
+			return FALSE;
+		}
+		op.mHasSource = TRUE;
+		op.mSource.mTGA = image_tga;
+		op.mSource.mIsMask = TRUE;
+		op.mSource.mProcess = TRUE;
+		op.mSource.mDomain = getInfo()->mDomain;
+		op.mSource.mWeight = effective_weight;
+	}
+	else
+	{
+		op.mValue = gl_color_byte( effective_weight );
+	}
+	bake->mLayers.back().mAlphaOps.push_back(op);
+
+	return TRUE;
+}
+
 //-----------------------------------------------------------------------------
 // LLTexGlobalColorInfo
 //-----------------------------------------------------------------------------
@@ -49,6 +49,7 @@ class LLTexLayerSetInfo;
 class LLTexLayerSet;
 class LLTexLayerInfo;
 class LLTexLayer;
+class LLTexLayerBake;
 class LLImageGL;
 class LLImageTGA;
 class LLTexGlobalColorInfo;
@@ -221,6 +222,7 @@ public:
 	BOOL					uploadPending() { return mUploadPending; }
 	BOOL					render( S32 x, S32 y, S32 width, S32 height );
 	void					readBackAndUpload(U8* baked_bump_data);
+	void					uploadBake(LLImageRaw* baked_color_image, LLImageRaw* baked_mask_image);
 	void                    createBumpTexture() ;
 
 	static void				onTextureUploadComplete( const LLUUID& uuid,
@@ -234,12 +236,16 @@ public:
 private:
 	void					pushProjection();
 	void					popProjection();
+	void					uploadBakedData(const U8* baked_color_data, const U8* baked_mask_data);
+	void					cancelBake();
 
 private:
 	BOOL                    mHasBump ;
 	BOOL					mNeedsUpdate;
 	BOOL					mNeedsUpload;
 	BOOL					mUploadPending;
+	BOOL					mBakePending;	// LLTexLayerCompositor is building the upload image
+	BOOL					mReadBackBake;	// it failed, read the next one back from GL
 	LLUUID					mUploadID;		// Identifys the current upload process (null if none).  Used to avoid overlaps (eg, when the user rapidly makes two changes outside of Face Edit)
 	LLTexLayerSet*			mTexLayerSet;
 	LLPointer<LLImageGL>	mBumpTex;	// zero if none
@@ -281,6 +287,7 @@ public:
 	void					deleteCaches();
 	void					gatherAlphaMasks(U8 *data, S32 width, S32 height);
 	void					applyMorphMask(U8* tex_data, S32 width, S32 height, S32 num_components);
+	BOOL					gatherBake(LLTexLayerBake* bake);
 	const std::string		getBodyRegion() 				{ return mInfo->mBodyRegion; }
 	BOOL					hasComposite()					{ return (mComposite != NULL); }
 	void					setBump( BOOL b )				{ mHasBump = b; }
@@ -348,6 +355,7 @@ public:
 	BOOL					renderImageRaw( U8* in_data, S32 in_width, S32 in_height, S32 in_components, S32 width, S32 height, BOOL is_mask );
 	BOOL					renderAlphaMasks(  S32 x, S32 y, S32 width, S32 height, LLColor4* colorp );
 	BOOL					hasAlphaParams() { return (!mParamAlphaList.empty());}
+	BOOL					gatherBake( LLTexLayerBake* bake );
 
 protected:
 	LLTexLayerSet*			mTexLayerSet;
@@ -390,6 +398,7 @@ public:
 	// LLVisualParam Virtual functions
 	///*virtual*/ BOOL		parseData(LLXmlTreeNode* node);
 	/*virtual*/ void		apply( ESex avatar_sex ) {}
+	/*virtual*/ U32			getApplyStages() const { return 0; } // setWeight() dirties the texture stage
 	/*virtual*/ void		setWeight(F32 weight, BOOL set_by_user);
 	/*virtual*/ void		setAnimationTarget(F32 target_value, BOOL set_by_user); 
 	/*virtual*/ void		animate(F32 delta, BOOL set_by_user);
@@ -404,6 +413,7 @@ public:
 
 	// New functions
 	BOOL					render( S32 x, S32 y, S32 width, S32 height );
+	BOOL					gatherBake( LLTexLayerBake* bake );
 	BOOL					getSkip();
 	void					deleteCaches();
 	LLTexLayer*				getTexLayer()		{ return mTexLayer; }
@@ -475,6 +485,7 @@ public:
 	// LLVisualParam Virtual functions
 	///*virtual*/ BOOL			parseData(LLXmlTreeNode* node);
 	/*virtual*/ void			apply( ESex avatar_sex ) {}
+	/*virtual*/ U32				getApplyStages() const { return 0; } // setWeight() dirties the texture stage
 	/*virtual*/ void			setWeight(F32 weight, BOOL set_by_user);
 	/*virtual*/ void			setAnimationTarget(F32 target_value, BOOL set_by_user);
 	/*virtual*/ void			animate(F32 delta, BOOL set_by_user);
@@ -0,0 +1,382 @@
+/** 
+ * @file lltexlayercompositor.cpp
+ * @brief Composites baked avatar textures for upload off the render thread
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "lltexlayercompositor.h"
+
+#include "llstl.h"
+#include "lltexlayer.h"
+
+//-----------------------------------------------------------------------------
+// LLTexLayerBake
+//-----------------------------------------------------------------------------
+
+LLTexLayerBake::LLTexLayerBake(LLTexLayerSetBuffer* buffer, S32 width, S32 height)
+	: mHasStaticAlpha(FALSE),
+	  mClearAlpha(FALSE),
+	  mBuffer(buffer),
+	  mSuccess(FALSE),
+	  mDone(0),
+	  mWidth(width),
+	  mHeight(height)
+{
+}
+
+LLTexLayerBake::~LLTexLayerBake()
+{
+}
+
+// WORKER thread
+// Returns the source as RGBA at the bake size, or NULL if it can't be decoded.
+const U8* LLTexLayerBake::loadRGBA(const Source& source)
+{
+	const void* key = source.mRaw.notNull() ? (const void*)source.mRaw.get() : (const void*)source.mTGA.get();
+	if (!source.mProcess)
+	{
+		source_map_t::iterator iter = mRGBACache.find(key);
+		if (iter != mRGBACache.end())
+		{
+			return &iter->second[0];
+		}
+	}
+
+	LLPointer<LLImageRaw> raw = source.mRaw;
+	if (raw.isNull())
+	{
+		raw = new LLImageRaw;
+		BOOL decoded = source.mProcess
+			? source.mTGA->decodeAndProcess(raw, source.mDomain, source.mWeight)
+			: source.mTGA->decode(raw, 0.f);
+		if (!decoded)
+		{
+			return NULL;
+		}
+	}
+
+	S32 src_width = raw->getWidth();
+	S32 src_height = raw->getHeight();
+	if (!raw->getData() || src_width <= 0 || src_height <= 0)
+	{
+		return NULL;
+	}
+
+	// expand first, then filter the way the GL path samples the texture
+	std::vector<U8> rgba(src_width * src_height * 4);
+	LLImageBlend::expandToRGBA(&rgba[0], raw->getData(), raw->getComponents(), source.mIsMask,
+							   src_width * src_height);
+
+	std::vector<U8>& data = source.mProcess ? mScratch : mRGBACache[key];
+	data.resize(mWidth * mHeight * 4);
+	LLImageBlend::resampleRGBA(&data[0], mWidth, mHeight, &rgba[0], src_width, src_height, source.mMipmapped);
+	return &data[0];
+}
+
+// WORKER thread
+const U8* LLTexLayerBake::loadAlpha(const Source& source)
+{
+	if (source.mProcess)
+	{
+		// gradients are different for every weight, don't keep them
+		const U8* rgba = loadRGBA(source);
+		if (!rgba)
+		{
+			return NULL;
+		}
+		std::vector<U8> alpha(mWidth * mHeight);
+		LLImageBlend::extractAlpha(&alpha[0], rgba, mWidth * mHeight);
+		mScratch.swap(alpha);
+		return &mScratch[0];
+	}
+
+	const void* key = source.mRaw.notNull() ? (const void*)source.mRaw.get() : (const void*)source.mTGA.get();
+	source_map_t::iterator iter = mAlphaCache.find(key);
+	if (iter != mAlphaCache.end())
+	{
+		return &iter->second[0];
+	}
+
+	const U8* rgba = loadRGBA(source);
+	if (!rgba)
+	{
+		return NULL;
+	}
+	std::vector<U8>& alpha = mAlphaCache[key];
+	alpha.resize(mWidth * mHeight);
+	LLImageBlend::extractAlpha(&alpha[0], rgba, mWidth * mHeight);
+	return &alpha[0];
+}
+
+// WORKER thread
+// Same steps as LLTexLayer::renderAlphaMasks(), into a separate plane.
+void LLTexLayerBake::renderAlphaMask(const Layer& layer, U8* alpha)
+{
+	S32 count = mWidth * mHeight;
+	if (!layer.mKeepAlpha)
+	{
+		memset(alpha, 0, count);
+	}
+
+	for (std::vector<AlphaOp>::const_iterator iter = layer.mAlphaOps.begin();
+		 iter != layer.mAlphaOps.end(); ++iter)
+	{
+		const AlphaOp& op = *iter;
+		if (op.mHasSource)
+		{
+			const U8* src = loadAlpha(op.mSource);
+			if (!src)
+			{
+				mSuccess = FALSE;
+				continue;
+			}
+			if (op.mMultiply)
+			{
+				LLImageBlend::multiplyAlpha(alpha, src, count);
+			}
+			else
+			{
+				LLImageBlend::addAlpha(alpha, src, count);
+			}
+		}
+		else if (op.mMultiply)
+		{
+			LLImageBlend::multiplyAlpha(alpha, op.mValue, count);
+		}
+		else
+		{
+			LLImageBlend::addAlpha(alpha, op.mValue, count);
+		}
+	}
+}
+
+// WORKER thread
+void LLTexLayerBake::run()
+{
+	mSuccess = TRUE;
+
+	S32 count = mWidth * mHeight;
+	mColorImage = new LLImageRaw(mWidth, mHeight, 4);
+	mMaskImage = new LLImageRaw(mWidth, mHeight, 1);
+	U8* color = mColorImage->getData();
+	U8* mask = mMaskImage->getData();
+	if (!color || !mask)
+	{
+		mSuccess = FALSE;
+		mDone = 1;
+		return;
+	}
+	memset(color, 0, count * 4);
+	std::vector<U8> alpha(count);
+
+	// LLTexLayerSet::render()
+	for (std::vector<Layer>::iterator iter = mLayers.begin(); iter != mLayers.end(); ++iter)
+	{
+		const Layer& layer = *iter;
+		if (!layer.mDraw)
+		{
+			continue;
+		}
+
+		if (layer.mHasAlphaMask)
+		{
+			if (layer.mKeepAlpha)
+			{
+				LLImageBlend::extractAlpha(&alpha[0], color, count);
+			}
+			renderAlphaMask(layer, &alpha[0]);
+			// renderAlphaMasks() leaves the mask in the frame buffer alpha,
+			// where the BLEND_DEST_ALPHA draws read and update it
+			LLImageBlend::insertAlpha(color, &alpha[0], count);
+		}
+
+		for (std::vector<ColorOp>::const_iterator op_iter = layer.mColorOps.begin();
+			 op_iter != layer.mColorOps.end(); ++op_iter)
+		{
+			const ColorOp& op = *op_iter;
+			const U8* src = NULL;
+			if (op.mHasSource)
+			{
+				src = loadRGBA(op.mSource);
+				if (!src)
+				{
+					mSuccess = FALSE;
+					continue;
+				}
+			}
+			LLImageBlend::blendRGBA(color, src, layer.mColor, NULL, op.mAlphaTest, count, layer.mBlend);
+		}
+	}
+
+	if (mHasStaticAlpha)
+	{
+		const U8* src = loadAlpha(mStaticAlpha);
+		if (src)
+		{
+			LLImageBlend::insertAlpha(color, src, count);
+		}
+		else
+		{
+			mSuccess = FALSE;
+		}
+	}
+	else if (mClearAlpha)
+	{
+		memset(&alpha[0], 255, count);
+		LLImageBlend::insertAlpha(color, &alpha[0], count);
+	}
+
+	// LLTexLayerSet::gatherAlphaMasks(), which draws each layer's mask into
+	// the finished composite in turn
+	memset(mask, 255, count);
+	LLImageBlend::extractAlpha(&alpha[0], color, count);
+	for (std::vector<Layer>::iterator iter = mLayers.begin(); iter != mLayers.end(); ++iter)
+	{
+		if (iter->mHasAlphaMask)
+		{
+			renderAlphaMask(*iter, &alpha[0]);
+			LLImageBlend::accumulateMask(mask, &alpha[0], count);
+		}
+	}
+
+	// done with the decoded sources
+	mRGBACache.clear();
+	mAlphaCache.clear();
+	mScratch.clear();
+
+	mDone = 1;
+}
+
+//-----------------------------------------------------------------------------
+// LLTexLayerCompositor
+//-----------------------------------------------------------------------------
+
+BOOL LLTexLayerCompositor::sEnabled = FALSE;
+U32 LLTexLayerCompositor::sNumBakes = 0;
+U32 LLTexLayerCompositor::sNumFallbacks = 0;
+LLStat LLTexLayerCompositor::sBakeTimeStat(16);
+LLThreadPool* LLTexLayerCompositor::sThreadPool = NULL;
+std::vector<LLTexLayerBake*> LLTexLayerCompositor::sBakes;
+
+//static
+void LLTexLayerCompositor::initClass(U32 num_threads, bool threaded)
+{
+	if (!sThreadPool)
+	{
+		sThreadPool = new LLThreadPool("Avatar Bake", num_threads, threaded);
+	}
+}
+
+//static
+void LLTexLayerCompositor::cleanupClass()
+{
+	if (sThreadPool)
+	{
+		sThreadPool->shutdown();
+		delete sThreadPool;
+		sThreadPool = NULL;
+	}
+	for_each(sBakes.begin(), sBakes.end(), DeletePointer());
+	sBakes.clear();
+}
+
+//static
+BOOL LLTexLayerCompositor::bake(LLTexLayerSetBuffer* buffer, LLTexLayerSet* layer_set, S32 width, S32 height)
+{
+	if (!sEnabled || !sThreadPool)
+	{
+		return FALSE;
+	}
+
+	LLTexLayerBake* bake = new LLTexLayerBake(buffer, width, height);
+	if (!layer_set->gatherBake(bake))
+	{
+		llinfos << "Unable to gather " << layer_set->getBodyRegion() << " for baking, reading back instead" << llendl;
+		delete bake;
+		sNumFallbacks++;
+		return FALSE;
+	}
+
+	sBakes.push_back(bake);
+	sThreadPool->addJob(bake);
+	return TRUE;
+}
+
+//static
+void LLTexLayerCompositor::cancel(LLTexLayerSetBuffer* buffer)
+{
+	for (std::vector<LLTexLayerBake*>::iterator iter = sBakes.begin(); iter != sBakes.end(); ++iter)
+	{
+		if ((*iter)->mBuffer == buffer)
+		{
+			// the worker may still be running, update() deletes it
+			(*iter)->mBuffer = NULL;
+		}
+	}
+}
+
+//static
+void LLTexLayerCompositor::update()
+{
+	if (sBakes.empty())
+	{
+		return;
+	}
+	sThreadPool->reapJobs();
+
+	std::vector<LLTexLayerBake*>::iterator iter = sBakes.begin();
+	while (iter != sBakes.end())
+	{
+		LLTexLayerBake* bake = *iter;
+		if (!bake->mDone)
+		{
+			++iter;
+			continue;
+		}
+
+		if (bake->mBuffer)
+		{
+			sBakeTimeStat.addValue(bake->mTimer.getElapsedTimeF32() * 1000.f);
+			if (bake->mSuccess)
+			{
+				sNumBakes++;
+				bake->mBuffer->uploadBake(bake->mColorImage, bake->mMaskImage);
+			}
+			else
+			{
+				sNumFallbacks++;
+				bake->mBuffer->uploadBake(NULL, NULL);
+			}
+		}
+		delete bake;
+		iter = sBakes.erase(iter);
+	}
+}
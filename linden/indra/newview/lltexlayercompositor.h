@@ -0,0 +1,191 @@
+/** 
+ * @file lltexlayercompositor.h
+ * @brief Composites baked avatar textures for upload off the render thread
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXLAYERCOMPOSITOR_H
+#define LL_LLTEXLAYERCOMPOSITOR_H
+
+#include <map>
+#include <vector>
+
+#include "llapr.h"
+#include "llimage.h"
+#include "llimageblend.h"
+#include "llimagetga.h"
+#include "llstat.h"
+#include "llthreadpool.h"
+#include "lltimer.h"
+
+class LLTexLayerSet;
+class LLTexLayerSetBuffer;
+
+//-----------------------------------------------------------------------------
+// LLTexLayerBake
+// A layer set flattened into the images, tints and blend modes that
+// LLTexLayerSet::render() would draw, composited into the upload image on a
+// worker thread.  Built on the main thread by LLTexLayerSet::gatherBake().
+//-----------------------------------------------------------------------------
+class LLTexLayerBake : public LLThreadPool::Job
+{
+public:
+	// An image as the GL path would sample it, scaled to the bake size.
+	// Either a decoded image, or a static tga decoded on the worker,
+	// optionally run through LLImageTGA::decodeAndProcess().
+	struct Source
+	{
+		Source() : mIsMask(FALSE), mMipmapped(FALSE), mProcess(FALSE), mDomain(0.f), mWeight(0.f) {}
+
+		LLPointer<LLImageRaw>	mRaw;
+		LLPointer<LLImageTGA>	mTGA;
+		BOOL					mIsMask;	// one component images are GL_ALPHA
+		BOOL					mMipmapped;	// sampled trilinear when minified
+		BOOL					mProcess;	// alpha gradient
+		F32						mDomain;
+		F32						mWeight;
+	};
+
+	// One step of LLTexLayer::renderAlphaMasks()
+	struct AlphaOp
+	{
+		AlphaOp() : mMultiply(FALSE), mHasSource(FALSE), mValue(0) {}
+
+		BOOL					mMultiply;	// (GL_DST_ALPHA, GL_ZERO), otherwise added
+		BOOL					mHasSource;	// alpha of mSource, otherwise mValue
+		Source					mSource;
+		U8						mValue;
+	};
+
+	// One draw of LLTexLayer::render()
+	struct ColorOp
+	{
+		ColorOp() : mHasSource(FALSE), mAlphaTest(0) {}
+
+		BOOL					mHasSource;	// otherwise an untextured quad
+		Source					mSource;
+		S32						mAlphaTest;
+	};
+
+	struct Layer
+	{
+		Layer() : mHasAlphaMask(FALSE), mKeepAlpha(FALSE), mDraw(FALSE), mBlend(LLImageBlend::BLEND_ALPHA)
+		{
+			mColor[0] = mColor[1] = mColor[2] = mColor[3] = 255;
+		}
+
+		BOOL					mHasAlphaMask;
+		BOOL					mKeepAlpha;	// first alpha param multiplies the alpha already there
+		std::vector<AlphaOp>	mAlphaOps;
+
+		BOOL					mDraw;		// FALSE if the layer only contributes to the mask
+		LLImageBlend::EBlendMode mBlend;
+		U8						mColor[4];
+		std::vector<ColorOp>	mColorOps;
+	};
+
+	LLTexLayerBake(LLTexLayerSetBuffer* buffer, S32 width, S32 height);
+	/*virtual*/ ~LLTexLayerBake();
+
+	/*virtual*/ void run(); // WORKER thread
+
+	S32						getWidth() const	{ return mWidth; }
+	S32						getHeight() const	{ return mHeight; }
+
+public:
+	// Filled in by gatherBake()
+	std::vector<Layer>		mLayers;
+	BOOL					mHasStaticAlpha;	// replace the final alpha with mStaticAlpha
+	Source					mStaticAlpha;
+	BOOL					mClearAlpha;		// otherwise set the final alpha to one
+
+	// MAIN thread only, NULL once the owner has lost interest
+	LLTexLayerSetBuffer*	mBuffer;
+	LLTimer					mTimer;
+
+	// Results, valid once mDone is set
+	LLPointer<LLImageRaw>	mColorImage;	// RGBA, as read back from the GL composite
+	LLPointer<LLImageRaw>	mMaskImage;		// as LLTexLayerSet::gatherAlphaMasks() builds it
+	BOOL					mSuccess;
+	LLAtomicS32				mDone;
+
+private:
+	const U8*				loadRGBA(const Source& source);
+	const U8*				loadAlpha(const Source& source);
+	void					renderAlphaMask(const Layer& layer, U8* alpha);
+
+	S32						mWidth;
+	S32						mHeight;
+
+	// decoded sources, so a texture used by both passes is only scaled once
+	typedef std::map<const void*, std::vector<U8> > source_map_t;
+	source_map_t			mRGBACache;
+	source_map_t			mAlphaCache;
+	std::vector<U8>			mScratch;
+};
+
+//-----------------------------------------------------------------------------
+// LLTexLayerCompositor
+// Builds the baked textures we upload for our own avatar on a worker thread
+// instead of reading the GL composite back.  The GL composite still draws
+// every layer set for display and keeps the morph masks up to date; only the
+// image that is encoded and uploaded comes from here.  If an input can't be
+// gathered on the main thread, or the worker fails, the upload falls back to
+// LLTexLayerSetBuffer::readBackAndUpload().
+//-----------------------------------------------------------------------------
+class LLTexLayerCompositor
+{
+public:
+	static void initClass(U32 num_threads, bool threaded);
+	static void cleanupClass();
+
+	// MAIN thread.  Returns FALSE if the caller should read back the GL
+	// composite instead.
+	static BOOL bake(LLTexLayerSetBuffer* buffer, LLTexLayerSet* layer_set, S32 width, S32 height);
+	static void cancel(LLTexLayerSetBuffer* buffer);
+
+	// MAIN thread, once per frame.  Hands finished bakes to their buffers.
+	static void update();
+
+	static S32 getNumPending()		{ return (S32) sBakes.size(); }
+
+	// Settings
+	static BOOL sEnabled;
+
+	// Stats
+	static U32 sNumBakes;			// composited off the main thread
+	static U32 sNumFallbacks;		// read back from GL instead
+	static LLStat sBakeTimeStat;	// ms from bake() to the result being picked up
+
+private:
+	static LLThreadPool* sThreadPool;
+	static std::vector<LLTexLayerBake*> sBakes;
+};
+
+#endif // LL_LLTEXLAYERCOMPOSITOR_H
@@ -0,0 +1,300 @@
+/** 
+ * @file lltexturebudget.cpp
+ * @brief Keeps texture memory inside a GL and host budget.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "llviewerprecompiledheaders.h"
+
+#include "lltexturebudget.h"
+
+#include <algorithm>
+
+#include "llviewercontrol.h"
+#include "llviewerimage.h"
+#include "llviewerimagelist.h"
+
+// How often usage is recounted and the budget enforced (seconds)
+const F32 TEXTURE_BUDGET_INTERVAL = 0.5f;
+// When over budget, reclaim down to this fraction of it
+const F32 TEXTURE_BUDGET_TARGET = 0.9f;
+// Below this fraction of the budget downsampled textures may fetch back up
+const F32 TEXTURE_BUDGET_LOW_WATER = 0.75f;
+// GL readbacks are synchronous, only do a few per pass
+const S32 MAX_DOWNSAMPLES_PER_PASS = 8;
+// How much a visible texel of each category is worth relative to the world
+const F32 CATEGORY_WEIGHT[LLTextureBudget::CAT_COUNT] = { 4.f, 1.f, 1.f, 1.f };
+
+LLTextureBudget::LLTextureBudget()
+	: mTotalGLBytes(0),
+	  mTotalHostBytes(0),
+	  mGLBudgetMB(0),
+	  mHostBudgetMB(0),
+	  mNumDownsampled(0),
+	  mNumEvicted(0)
+{
+	memset(mUsage, 0, sizeof(mUsage));
+}
+
+//static
+LLTextureBudget::ECategory LLTextureBudget::getCategory(const LLViewerImage* imagep)
+{
+	if (imagep->mForSculpt)
+	{
+		return CAT_SCULPT;
+	}
+	switch (imagep->mBoostLevel)
+	{
+	  case LLViewerImageBoostLevel::BOOST_SCULPTED:
+		return CAT_SCULPT;
+	  case LLViewerImageBoostLevel::BOOST_AVATAR_BAKED:
+	  case LLViewerImageBoostLevel::BOOST_AVATAR:
+	  case LLViewerImageBoostLevel::BOOST_AVATAR_BAKED_SELF:
+	  case LLViewerImageBoostLevel::BOOST_AVATAR_SELF:
+		return CAT_AVATAR_BAKE;
+	  case LLViewerImageBoostLevel::BOOST_UI:
+	  case LLViewerImageBoostLevel::BOOST_PREVIEW:
+	  case LLViewerImageBoostLevel::BOOST_HUD:
+	  case LLViewerImageBoostLevel::BOOST_MAP:
+	  case LLViewerImageBoostLevel::BOOST_MAP_VISIBLE:
+		return CAT_UI;
+	  default:
+		break;
+	}
+	// Baked textures are fetched from the avatar's simulator
+	return imagep->mTargetHost.isOk() ? CAT_AVATAR_BAKE : CAT_WORLD;
+}
+
+//static
+const char* LLTextureBudget::getCategoryName(S32 category)
+{
+	static const char* names[CAT_COUNT] = { "Bake", "UI", "World", "Sculpt" };
+	return (category >= 0 && category < CAT_COUNT) ? names[category] : "?";
+}
+
+//static
+S32 LLTextureBudget::getGLBytes(const LLViewerImage* imagep, S32 discard_level)
+{
+	if (discard_level < 0 || discard_level > imagep->getMaxDiscardLevel())
+	{
+		return 0;
+	}
+	return imagep->getMipBytes(discard_level);
+}
+
+void LLTextureBudget::update()
+{
+	if (mUpdateTimer.getElapsedTimeF32() < TEXTURE_BUDGET_INTERVAL)
+	{
+		return;
+	}
+	mUpdateTimer.reset();
+
+	mGLBudgetMB = gSavedSettings.getS32("TextureBudgetGLMB");
+	if (mGLBudgetMB <= 0)
+	{
+		mGLBudgetMB = gImageList.getMaxTotalTextureMem();
+	}
+	mHostBudgetMB = gSavedSettings.getS32("TextureBudgetHostMB");
+
+	account();
+
+	if (!gSavedSettings.getBOOL("TextureBudget") || mGLBudgetMB <= 0)
+	{
+		return;
+	}
+
+	S64 gl_budget = (S64)mGLBudgetMB << 20;
+	if (mTotalGLBytes > gl_budget)
+	{
+		reclaimGL(mTotalGLBytes - (S64)(gl_budget * TEXTURE_BUDGET_TARGET));
+	}
+	else if (mTotalGLBytes < (S64)(gl_budget * TEXTURE_BUDGET_LOW_WATER))
+	{
+		relaxFloors();
+	}
+
+	S64 host_budget = (S64)mHostBudgetMB << 20;
+	if (host_budget > 0 && mTotalHostBytes > host_budget)
+	{
+		reclaimHost(mTotalHostBytes - (S64)(host_budget * TEXTURE_BUDGET_TARGET));
+	}
+}
+
+// Count every image and collect the ones we could take memory from
+void LLTextureBudget::account()
+{
+	memset(mUsage, 0, sizeof(mUsage));
+	mTotalGLBytes = 0;
+	mTotalHostBytes = 0;
+	mGLCandidates.clear();
+	mHostCandidates.clear();
+
+	for (LLViewerImageList::uuid_map_t::iterator iter = gImageList.mUUIDMap.begin();
+		 iter != gImageList.mUUIDMap.end(); ++iter)
+	{
+		LLViewerImage* imagep = iter->second;
+		ECategory category = getCategory(imagep);
+		S32 gl_bytes = imagep->getHasGLTexture() ? imagep->mTextureMemory : 0;
+		S32 host_bytes = imagep->getHostBytes();
+
+		Usage& usage = mUsage[category];
+		usage.mCount++;
+		usage.mGLBytes += gl_bytes;
+		usage.mHostBytes += host_bytes;
+		mTotalGLBytes += gl_bytes;
+		mTotalHostBytes += host_bytes;
+
+		// Anything we take away has to be fetchable again
+		if (imagep->mBoostLevel >= LLViewerImageBoostLevel::BOOST_HIGH ||
+			!imagep->getUseDiscard() ||
+			imagep->mIsMediaTexture ||
+			imagep->mFullyLoaded ||
+			imagep->mNeedsCreateTexture ||
+			imagep->hasPendingUpload() ||
+			imagep->hasCallbacks())
+		{
+			continue;
+		}
+
+		BOOL bound_recently = imagep->getBoundRecently();
+		if (gl_bytes > 0)
+		{
+			Candidate candidate;
+			candidate.mImage = imagep;
+			S32 discard = imagep->getDiscardLevel();
+			if (!bound_recently)
+			{
+				candidate.mScore = 0.f;
+				candidate.mBytes = gl_bytes;
+				candidate.mEvict = true;
+				mGLCandidates.push_back(candidate);
+			}
+			else if (discard >= 0 && discard < imagep->getMaxDiscardLevel())
+			{
+				S32 saved = gl_bytes - getGLBytes(imagep, discard + 1);
+				if (saved > 0)
+				{
+					// Texels beyond what is on screen are free to lose
+					F32 texels = (F32)imagep->getWidth(discard) * (F32)imagep->getHeight(discard);
+					F32 useful = llmin(imagep->mMaxVirtualSize, texels);
+					F32 lost = llmax(0.f, useful - texels * 0.25f);
+					candidate.mScore = lost * CATEGORY_WEIGHT[category] / (F32)saved;
+					candidate.mBytes = saved;
+					candidate.mEvict = false;
+					mGLCandidates.push_back(candidate);
+				}
+			}
+		}
+
+		LLImageRaw* cached = imagep->mCachedRawImage;
+		if (cached && cached != imagep->mRawImage.get() && category != CAT_SCULPT && !bound_recently)
+		{
+			Candidate candidate;
+			candidate.mImage = imagep;
+			candidate.mBytes = cached->getDataSize();
+			candidate.mScore = imagep->mMaxVirtualSize / (F32)llmax(candidate.mBytes, 1);
+			candidate.mEvict = false;
+			mHostCandidates.push_back(candidate);
+		}
+	}
+}
+
+void LLTextureBudget::reclaimGL(S64 target)
+{
+	std::sort(mGLCandidates.begin(), mGLCandidates.end());
+
+	S64 freed = 0;
+	S32 downsamples = 0;
+	for (std::vector<Candidate>::iterator iter = mGLCandidates.begin();
+		 iter != mGLCandidates.end() && freed < target; ++iter)
+	{
+		LLViewerImage* imagep = iter->mImage;
+		if (iter->mEvict)
+		{
+			imagep->budgetEvict();
+			mNumEvicted++;
+			freed += iter->mBytes;
+		}
+		else
+		{
+			if (downsamples >= MAX_DOWNSAMPLES_PER_PASS)
+			{
+				break;
+			}
+			downsamples++;
+			if (imagep->budgetDownsample(imagep->getDiscardLevel() + 1))
+			{
+				mNumDownsampled++;
+				freed += iter->mBytes;
+			}
+		}
+	}
+}
+
+void LLTextureBudget::reclaimHost(S64 target)
+{
+	std::sort(mHostCandidates.begin(), mHostCandidates.end());
+
+	S64 freed = 0;
+	for (std::vector<Candidate>::iterator iter = mHostCandidates.begin();
+		 iter != mHostCandidates.end() && freed < target; ++iter)
+	{
+		iter->mImage->releaseCachedRawImage();
+		freed += iter->mBytes;
+	}
+}
+
+// There is room again, let downsampled textures come back a level at a time
+void LLTextureBudget::relaxFloors()
+{
+	for (LLViewerImageList::uuid_map_t::iterator iter = gImageList.mUUIDMap.begin();
+		 iter != gImageList.mUUIDMap.end(); ++iter)
+	{
+		LLViewerImage* imagep = iter->second;
+		if (imagep->mBudgetDiscardLevel > 0)
+		{
+			imagep->mBudgetDiscardLevel--;
+		}
+	}
+}
+
+void LLTextureBudget::dump()
+{
+	llinfos << "Texture budget GL " << (mTotalGLBytes >> 20) << "/" << mGLBudgetMB << " MB"
+			<< " host " << (mTotalHostBytes >> 20) << "/" << mHostBudgetMB << " MB"
+			<< " downsampled " << mNumDownsampled << " evicted " << mNumEvicted << llendl;
+	for (S32 i = 0; i < CAT_COUNT; i++)
+	{
+		llinfos << "  " << getCategoryName(i) << ": " << mUsage[i].mCount << " images"
+				<< " GL " << (mUsage[i].mGLBytes >> 20) << " MB"
+				<< " host " << (mUsage[i].mHostBytes >> 20) << " MB" << llendl;
+	}
+}
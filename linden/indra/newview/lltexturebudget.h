@@ -0,0 +1,136 @@
+/** 
+ * @file lltexturebudget.h
+ * @brief Keeps texture memory inside a GL and host budget.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LLTEXTUREBUDGET_H
+#define LL_LLTEXTUREBUDGET_H
+
+#include "llframetimer.h"
+#include "llmemory.h"
+#include <vector>
+
+class LLViewerImage;
+
+// LLTextureBudget accounts for the exact bytes every LLViewerImage holds,
+// in GL (the uploaded mip chain at its current discard level) and on the
+// host (raw, aux, cached, saved and compressed copies), broken down by what
+// the texture is used for.  When GL memory goes over TextureBudgetGLMB it
+// picks the textures that lose the least visible detail per byte freed and
+// drops them one discard level (or evicts them outright when they have not
+// been bound in a while), until usage is back under the low water mark.
+// Downsampled textures are kept from fetching back up until there is room
+// again.  Host memory over TextureBudgetHostMB is reclaimed by releasing
+// the small cached raw copies of unused textures.
+//
+// This sits on top of the global sDesiredDiscardBias/scaleDown() control
+// in LLViewerImage, which still acts as the safety net when the budget
+// can't keep up.
+
+class LLTextureBudget : public LLSingleton<LLTextureBudget>
+{
+public:
+	enum ECategory
+	{
+		CAT_AVATAR_BAKE = 0,
+		CAT_UI,
+		CAT_WORLD,
+		CAT_SCULPT,
+		CAT_COUNT
+	};
+
+	struct Usage
+	{
+		S32 mCount;
+		S64 mGLBytes;
+		S64 mHostBytes;
+	};
+
+	LLTextureBudget();
+
+	// Main thread, once per frame from LLViewerImageList::updateImages()
+	void update();
+
+	static ECategory getCategory(const LLViewerImage* imagep);
+	static const char* getCategoryName(S32 category);
+	// GL bytes the image would use at discard_level
+	static S32 getGLBytes(const LLViewerImage* imagep, S32 discard_level);
+
+	const Usage& getUsage(S32 category) const	{ return mUsage[category]; }
+	S64 getTotalGLBytes() const					{ return mTotalGLBytes; }
+	S64 getTotalHostBytes() const				{ return mTotalHostBytes; }
+	S32 getGLBudgetMB() const					{ return mGLBudgetMB; }
+	S32 getHostBudgetMB() const					{ return mHostBudgetMB; }
+	S32 getNumDownsampled() const				{ return mNumDownsampled; }
+	S32 getNumEvicted() const					{ return mNumEvicted; }
+
+	void dump();
+
+private:
+	struct Candidate
+	{
+		LLViewerImage*	mImage;
+		F32				mScore;		// visible texels lost per byte freed
+		S32				mBytes;		// bytes freed
+		bool			mEvict;		// destroy the GL texture rather than drop a level
+
+		bool operator<(const Candidate& rhs) const
+		{
+			if (mEvict != rhs.mEvict)
+			{
+				return mEvict;
+			}
+			return mScore < rhs.mScore || (mScore == rhs.mScore && mBytes > rhs.mBytes);
+		}
+	};
+
+	void account();
+	void reclaimGL(S64 target);
+	void reclaimHost(S64 target);
+	void relaxFloors();
+
+	LLFrameTimer mUpdateTimer;
+
+	Usage mUsage[CAT_COUNT];
+	S64 mTotalGLBytes;
+	S64 mTotalHostBytes;
+	S32 mGLBudgetMB;
+	S32 mHostBudgetMB;
+
+	std::vector<Candidate> mGLCandidates;
+	std::vector<Candidate> mHostCandidates;
+
+	// Totals since startup
+	S32 mNumDownsampled;
+	S32 mNumEvicted;
+};
+
+#endif // LL_LLTEXTUREBUDGET_H
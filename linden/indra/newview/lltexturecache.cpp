@@ -40,12 +40,14 @@
 #include "lllfsthread.h"
 #include "llviewercontrol.h"
 
-// Included to allow LLTextureCache::purgeTextures() to pause watchdog timeout
-#include "llappviewer.h" 
+#if !LL_WINDOWS
+#include <sys/mman.h>
+#endif
 
 // Cache organization:
 // cache/texture.entries
-//  Unordered array of Entry structs
+//  EntriesInfo followed by an unordered array of Entry structs, preallocated
+//  to sCacheMaxEntries and kept memory mapped while the cache is open
 // cache/texture.cache
 //  First TEXTURE_CACHE_ENTRY_SIZE bytes of each texture in texture.entries in same order
 //  Entry size same as header packet, so we're not 0-padding unless whole image is contained in header.
@@ -53,7 +55,8 @@
 //  Actual texture body files
 
 const S32 TEXTURE_CACHE_ENTRY_SIZE = FIRST_PACKET_SIZE; 
-const F32 TEXTURE_CACHE_PURGE_AMOUNT = .20f; // % amount to reduce the cache by when it exceeds its limit
+const F32 TEXTURE_CACHE_EVICT_AMOUNT = .05f; // % below its limit eviction trims the cache to
+const U32 TEXTURE_CACHE_EVICT_SLICE = 16; // max bodies removed per cache thread update
 const F32 TEXTURE_CACHE_LRU_SIZE = .10f; // % amount for LRU list (low overhead to regenerate)
 
 class LLTextureCacheWorker : public LLWorkerClass
@@ -310,6 +313,90 @@ private:
 	e_state mState;
 };
 
+// Reads and writes the <id>.dxt copy of a cached texture
+class LLTextureCacheCompressedWorker : public LLTextureCacheWorker
+{
+public:
+	LLTextureCacheCompressedWorker(LLTextureCache* cache, U32 priority, const LLUUID& id,
+								   LLImageFormatted* image, // for writes
+								   LLTextureCache::Responder* responder)
+			: LLTextureCacheWorker(cache, priority, id,
+								   image ? image->getData() : NULL, image ? image->getDataSize() : 0, 0,
+								   0, responder),
+			mImage(image)
+	{
+		mImageFormat = IMG_CODEC_DXT;
+	}
+
+	virtual bool doRead();
+	virtual bool doWrite();
+
+private:
+	LLPointer<LLImageFormatted> mImage; // owns mWriteData
+};
+
+bool LLTextureCacheCompressedWorker::doRead()
+{
+	S32 size = mCache->getCompressedSize(mID);
+	if (size <= 0)
+	{
+		mDataSize = 0; // no copy
+		return true;
+	}
+
+	std::string filename = mCache->getCompressedFileName(mID);
+	mReadData = new U8[size];
+	S32 bytes_read = LLAPRFile::readEx(filename, mReadData, 0, size);
+	if (bytes_read != size)
+	{
+		llwarns << "LLTextureCacheWorker: "  << mID
+				<< " incorrect number of bytes read from compressed copy: " << bytes_read
+				<< " / " << size << llendl;
+		delete[] mReadData;
+		mReadData = NULL;
+		mDataSize = 0; // the J2C data is still good, only drop the copy
+		mCache->removeCompressedFromCache(mID);
+		return true;
+	}
+	mDataSize = size;
+	mImageSize = size;
+	return true;
+}
+
+bool LLTextureCacheCompressedWorker::doWrite()
+{
+	llassert_always(mDataSize > 0);
+	S32 size = mDataSize;
+	mDataSize = 0; // failures only lose the copy, see endWork()
+	if (mCache->getCompressedSize(mID) < 0)
+	{
+		return true; // entry went away
+	}
+
+	// writeEx doesn't truncate, and the old copy must stop counting
+	mCache->removeCompressedFromCache(mID);
+
+	std::string filename = mCache->getCompressedFileName(mID);
+	S32 bytes_written = LLAPRFile::writeEx(filename, mWriteData, 0, size);
+	if (bytes_written != size)
+	{
+		llwarns << "LLTextureCacheWorker: "  << mID
+				<< " incorrect number of bytes written to compressed copy: " << bytes_written
+				<< " / " << size << llendl;
+		LLAPRFile::remove(filename);
+	}
+	else if (!mCache->setCompressedSize(mID, size))
+	{
+		// entry was removed or recycled while writing
+		LLAPRFile::remove(filename);
+	}
+	else
+	{
+		mDataSize = size;
+	}
+	return true;
+}
+
 
 //virtual
 void LLTextureCacheWorker::startWork(S32 param)
@@ -404,11 +491,13 @@ bool LLTextureCacheRemoteWorker::doRead()
 		if (idx < 0)
 		{
 			// The texture is *not* cached. We're done here...
+			mCache->mCacheMisses++;
 			mDataSize = 0; // no data 
 			done = true;
 		}
 		else
 		{
+			mCache->mCacheHits++;
 			// If the read offset is bigger than the header cache, we read directly from the body
 			// Note that currently, we *never* read with offset from the cache, so the result is *always* HEADER
 			mState = mOffset < TEXTURE_CACHE_ENTRY_SIZE ? HEADER : BODY;
@@ -738,15 +827,27 @@ LLTextureCache::LLTextureCache(bool threaded)
 	  mWorkersMutex(NULL),
 	  mHeaderMutex(NULL),
 	  mListMutex(NULL),
-	  mHeaderAPRFile(NULL),
 	  mReadOnly(FALSE),
+	  mHeaderMapFile(NULL),
+	  mHeaderMap(NULL),
+	  mEntries(NULL),
+	  mMappedEntries(0),
+	  mEntryIndex(NULL),
+	  mEntryIndexMask(0),
+	  mEntryIndexUsed(0),
 	  mTexturesSizeTotal(0),
-	  mDoPurge(FALSE)
+	  mDoPurge(FALSE),
+	  mCacheHits(0),
+	  mCacheMisses(0),
+	  mEvictions(0),
+	  mEvictedBytes(0)
 {
 }
 
 LLTextureCache::~LLTextureCache()
 {
+	closeHeaderMap();
+	delete[] mEntryIndex;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -757,6 +858,11 @@ S32 LLTextureCache::update(U32 max_time_ms)
 	S32 res;
 	res = LLWorkerThread::update(max_time_ms);
 
+	if (!mThreaded && mDoPurge)
+	{
+		evictTextures(TEXTURE_CACHE_EVICT_SLICE);
+	}
+
 	mListMutex.lock();
 	handle_list_t priorty_list = mPrioritizeWriteList; // copy list
 	mPrioritizeWriteList.clear();
@@ -811,44 +917,85 @@ std::string LLTextureCache::getTextureFileName(const LLUUID& id)
 	return filename;
 }
 
+std::string LLTextureCache::getCompressedFileName(const LLUUID& id)
+{
+	std::string idstr = id.asString();
+	std::string delem = gDirUtilp->getDirDelimiter();
+	std::string filename = mTexturesDirName + delem + idstr[0] + delem + idstr + ".dxt";
+	return filename;
+}
+
+S32 LLTextureCache::getCompressedSize(const LLUUID& id)
+{
+	LLMutexLock lock(&mHeaderMutex);
+	S32 idx = lookupEntry(id);
+	return idx >= 0 ? mEntries[idx].mCompressedSize : -1;
+}
+
+bool LLTextureCache::setCompressedSize(const LLUUID& id, S32 size)
+{
+	bool purge = false;
+	{
+		LLMutexLock lock(&mHeaderMutex);
+		S32 idx = lookupEntry(id);
+		if (idx < 0 || mReadOnly)
+		{
+			return false;
+		}
+		Entry& entry = mEntries[idx];
+		mTexturesSizeTotal += size - entry.mCompressedSize;
+		entry.mCompressedSize = size;
+		purge = mTexturesSizeTotal > sCacheMaxTexturesSize;
+	}
+	if (purge)
+	{
+		mDoPurge = TRUE;
+	}
+	return true;
+}
+
+// mHeaderMutex must be locked
+void LLTextureCache::removeCompressedFile(Entry& entry)
+{
+	if (entry.mCompressedSize > 0)
+	{
+		LLAPRFile::remove(getCompressedFileName(entry.mID));
+		mTexturesSizeTotal -= entry.mCompressedSize;
+		entry.mCompressedSize = 0;
+	}
+}
+
+void LLTextureCache::removeCompressedFromCache(const LLUUID& id)
+{
+	if (!mReadOnly)
+	{
+		LLMutexLock lock(&mHeaderMutex);
+		S32 idx = lookupEntry(id);
+		if (idx >= 0)
+		{
+			removeCompressedFile(mEntries[idx]);
+		}
+	}
+}
+
 bool LLTextureCache::updateTextureEntryList(const LLUUID& id, S32 bodysize)
 {
 	bool res = false;
 	bool purge = false;
+	S32 idx = -1;
 	{
-		mHeaderMutex.lock();
-		size_map_t::iterator iter1 = mTexturesSizeMap.find(id);
-		if (iter1 == mTexturesSizeMap.end() || iter1->second < bodysize)
+		LLMutexLock lock(&mHeaderMutex);
+		idx = lookupEntry(id);
+		if (idx >= 0 && mEntries[idx].mBodySize < bodysize)
 		{
 			llassert_always(bodysize > 0);
 
-			S32 oldbodysize = 0;
-			if (iter1 != mTexturesSizeMap.end())
-			{
-				oldbodysize = iter1->second;
-			}
-						
-			Entry entry;
-			S32 idx = openAndReadEntry(id, entry, false);
-			if (idx < 0)
-			{
-				// TODO: change to llwarns
-				llerrs << "Failed to open entry: " << id << llendl;
-				mHeaderMutex.unlock();
-				removeFromCache(id);
-				return false;
-			}			
-			else if (oldbodysize != entry.mBodySize)
-			{
-				// TODO: change to llwarns
-				llerrs << "Entry mismatch in mTextureSizeMap / mHeaderIDMap"
-					   << " idx=" << idx << " oldsize=" << oldbodysize << " entrysize=" << entry.mBodySize << llendl;
-			}
-			entry.mBodySize = bodysize;
-			writeEntryAndClose(idx, entry);
-			
-			mTexturesSizeTotal -= oldbodysize;
+			Entry& entry = mEntries[idx];
+			mTexturesSizeTotal -= entry.mBodySize;
 			mTexturesSizeTotal += bodysize;
+			entry.mBodySize = bodysize;
+			llassert_always(entry.mImageSize == 0 || entry.mImageSize > entry.mBodySize);
+			touchEntry(idx);
 			
 			if (mTexturesSizeTotal > sCacheMaxTexturesSize)
 			{
@@ -857,11 +1004,15 @@ bool LLTextureCache::updateTextureEntryList(const LLUUID& id, S32 bodysize)
 			res = true;
 		}
 	}
+	if (idx < 0)
+	{
+		llwarns << "Failed to find entry: " << id << llendl;
+		removeFromCache(id);
+	}
 	if (purge)
 	{
 		mDoPurge = TRUE;
 	}
-	mHeaderMutex.unlock();
 	return res;
 }
 
@@ -869,7 +1020,7 @@ bool LLTextureCache::updateTextureEntryList(const LLUUID& id, S32 bodysize)
 
 //static
 const S32 MAX_REASONABLE_FILE_SIZE = 512*1024*1024; // 512 MB
-F32 LLTextureCache::sHeaderCacheVersion = 1.2f;
+F32 LLTextureCache::sHeaderCacheVersion = 1.3f;
 U32 LLTextureCache::sCacheMaxEntries = MAX_REASONABLE_FILE_SIZE / TEXTURE_CACHE_ENTRY_SIZE;
 S64 LLTextureCache::sCacheMaxTexturesSize = 0; // no limit
 const char* entries_filename = "texture.entries";
@@ -891,7 +1042,7 @@ void LLTextureCache::purgeCache(ELLPath location)
 	if (!mReadOnly)
 	{
 		setDirNames(location);
-		llassert_always(mHeaderAPRFile == NULL);
+		closeHeaderMap();
 		LLAPRFile::remove(mHeaderEntriesFileName);
 		LLAPRFile::remove(mHeaderDataFileName);
 	}
@@ -929,7 +1080,7 @@ S64 LLTextureCache::initCache(ELLPath location, S64 max_size, BOOL read_only)
 		}
 	}
 	readHeaderCache();
-	purgeTextures(true); // calc mTexturesSize and make some room in the texture cache if we need it
+	validateTextures(); // spot check body sizes, schedule eviction if over budget
 
 	return max_size; // unused cache space
 }
@@ -937,26 +1088,107 @@ S64 LLTextureCache::initCache(ELLPath location, S64 max_size, BOOL read_only)
 //----------------------------------------------------------------------------
 // mHeaderMutex must be locked for the following functions!
 
-LLAPRFile* LLTextureCache::openHeaderEntriesFile(bool readonly, S32 offset)
+enum
+{
+	ENTRY_SLOT_EMPTY = 0,
+	ENTRY_SLOT_REMOVED = 0xFFFFFFFF
+};
+
+static inline U32 entry_hash(const LLUUID& id)
+{
+	// texture ids are random, a few bytes mixed together are plenty
+	U32 hash;
+	memcpy(&hash, id.mData, sizeof(U32));
+	hash ^= hash >> 16;
+	hash *= 0x45d9f3b;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+bool LLTextureCache::openHeaderMap()
 {
-	llassert_always(mHeaderAPRFile == NULL);
-	apr_int32_t flags = readonly ? APR_READ|APR_BINARY : APR_READ|APR_WRITE|APR_BINARY;
-	mHeaderAPRFile = new LLAPRFile(mHeaderEntriesFileName, flags, LLAPRFile::local);
-	mHeaderAPRFile->seek(APR_SET, offset);
-	return mHeaderAPRFile;
+	llassert_always(mHeaderMap == NULL);
+
+	apr_pool_t* pool = mHeaderMapPool.getAPRPool();
+	apr_int32_t flags = mReadOnly ? APR_READ|APR_BINARY : APR_READ|APR_WRITE|APR_CREATE|APR_BINARY;
+	if (apr_file_open(&mHeaderMapFile, mHeaderEntriesFileName.c_str(), flags, APR_OS_DEFAULT, pool) != APR_SUCCESS)
+	{
+		mHeaderMapFile = NULL;
+		return false;
+	}
+
+	apr_off_t size = sizeof(EntriesInfo) + (apr_off_t)sCacheMaxEntries * sizeof(Entry);
+	apr_status_t status;
+	if (mReadOnly)
+	{
+		// map whatever the writing instance left behind
+		apr_finfo_t info;
+		status = apr_file_info_get(&info, APR_FINFO_SIZE, mHeaderMapFile);
+		if (status == APR_SUCCESS)
+		{
+			size = llmin(size, info.size);
+		}
+	}
+	else
+	{
+		// grow (or shrink) the file to the full table
+		status = apr_file_trunc(mHeaderMapFile, size);
+	}
+
+	if (status == APR_SUCCESS && size >= (apr_off_t)sizeof(EntriesInfo))
+	{
+		apr_int32_t mmap_flags = mReadOnly ? APR_MMAP_READ : APR_MMAP_READ|APR_MMAP_WRITE;
+		status = apr_mmap_create(&mHeaderMap, mHeaderMapFile, 0, (apr_size_t)size, mmap_flags, pool);
+	}
+
+	if (status != APR_SUCCESS || !mHeaderMap)
+	{
+		ll_apr_warn_status(status);
+		mHeaderMap = NULL;
+		apr_file_close(mHeaderMapFile);
+		mHeaderMapFile = NULL;
+		return false;
+	}
+
+	mEntries = (Entry*)((U8*)mHeaderMap->mm + sizeof(EntriesInfo));
+	mMappedEntries = (U32)((size - sizeof(EntriesInfo)) / sizeof(Entry));
+	return true;
 }
 
-void LLTextureCache::closeHeaderEntriesFile()
+void LLTextureCache::closeHeaderMap()
 {
-	llassert_always(mHeaderAPRFile != NULL);
-	delete mHeaderAPRFile;
-	mHeaderAPRFile = NULL;
+	if (mHeaderMap)
+	{
+		// apr_mmap_delete() only unmaps; get the table onto disk first
+		if (!mReadOnly)
+		{
+#if LL_WINDOWS
+			FlushViewOfFile(mHeaderMap->mm, mHeaderMap->size);
+#else
+			msync(mHeaderMap->mm, mHeaderMap->size, MS_SYNC);
+#endif
+		}
+		apr_mmap_delete(mHeaderMap);
+		mHeaderMap = NULL;
+	}
+	if (mHeaderMapFile)
+	{
+		apr_file_close(mHeaderMapFile);
+		mHeaderMapFile = NULL;
+	}
+	mEntries = NULL;
+	mMappedEntries = 0;
+	if (mEntryIndex)
+	{
+		memset(mEntryIndex, 0, (mEntryIndexMask + 1) * sizeof(apr_uint32_t));
+	}
+	mEntryIndexUsed = 0;
 }
 
 void LLTextureCache::readEntriesHeader()
 {
 	// mHeaderEntriesInfo initializes to default values so safe not to read it
-		llassert_always(mHeaderAPRFile == NULL);
+	llassert_always(mHeaderMap == NULL);
 	if (LLAPRFile::isExist(mHeaderEntriesFileName))
 	{
 		LLAPRFile::readEx(mHeaderEntriesFileName, (U8*)&mHeaderEntriesInfo, 0, sizeof(EntriesInfo));
@@ -965,291 +1197,299 @@ void LLTextureCache::readEntriesHeader()
 
 void LLTextureCache::writeEntriesHeader()
 {
-	llassert_always(mHeaderAPRFile == NULL);
 	if (!mReadOnly)
 	{
-		LLAPRFile::writeEx(mHeaderEntriesFileName, (U8*)&mHeaderEntriesInfo, 0, sizeof(EntriesInfo));
+		if (mHeaderMap)
+		{
+			memcpy(mHeaderMap->mm, &mHeaderEntriesInfo, sizeof(EntriesInfo));
+		}
+		else
+		{
+			LLAPRFile::writeEx(mHeaderEntriesFileName, (U8*)&mHeaderEntriesInfo, 0, sizeof(EntriesInfo));
+		}
 	}
 }
 
-static S32 mHeaderEntriesMaxWriteIdx = 0;
+S32 LLTextureCache::lookupEntry(const LLUUID& id) const
+{
+	apr_uint32_t* index = mEntryIndex;
+	if (!index || !mEntries)
+	{
+		return -1;
+	}
+	for (U32 slot = entry_hash(id) & mEntryIndexMask; ; slot = (slot + 1) & mEntryIndexMask)
+	{
+		U32 value = index[slot];
+		if (value == ENTRY_SLOT_EMPTY)
+		{
+			return -1;
+		}
+		if (value != ENTRY_SLOT_REMOVED && mEntries[value - 1].mID == id)
+		{
+			return (S32)(value - 1);
+		}
+	}
+}
 
-S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create)
+void LLTextureCache::insertEntryIndex(S32 idx)
 {
-	S32 idx = -1;
-	
-	id_map_t::iterator iter1 = mHeaderIDMap.find(id);
-	if (iter1 != mHeaderIDMap.end())
+	// keep at least a quarter of the slots empty so probes terminate quickly
+	if ((mEntryIndexUsed + 1) * 4 > (mEntryIndexMask + 1) * 3)
 	{
-		idx = iter1->second;
+		rebuildEntryIndex();
 	}
 
-	if (idx < 0)
+	apr_uint32_t* index = mEntryIndex;
+	S32 reuse = -1;
+	U32 slot = entry_hash(mEntries[idx].mID) & mEntryIndexMask;
+	while (index[slot] != ENTRY_SLOT_EMPTY)
 	{
-		if (create && !mReadOnly)
+		if (index[slot] == ENTRY_SLOT_REMOVED && reuse < 0)
 		{
-			if (mHeaderEntriesInfo.mEntries < sCacheMaxEntries)
-			{
-				// Add an entry to the end of the list
-				idx = mHeaderEntriesInfo.mEntries++;
-
-			}
-			else if (!mFreeList.empty())
-			{
-				idx = *(mFreeList.begin());
-				mFreeList.erase(mFreeList.begin());
-			}
-			else
-			{
-				// Look for a still valid entry in the LRU
-				for (std::set<LLUUID>::iterator iter2 = mLRU.begin(); iter2 != mLRU.end();)
-				{
-					std::set<LLUUID>::iterator curiter2 = iter2++;
-					LLUUID oldid = *curiter2;
-					// Erase entry from LRU regardless
-					mLRU.erase(curiter2);
-					// Look up entry and use it if it is valid
-					id_map_t::iterator iter3 = mHeaderIDMap.find(oldid);
-					if (iter3 != mHeaderIDMap.end() && iter3->second >= 0)
-					{
-						idx = iter3->second;
-						mHeaderIDMap.erase(oldid);
-						mTexturesSizeMap.erase(oldid);
-						break;
-					}
-				}
-				// if (idx < 0) at this point, we will rebuild the LRU 
-				//  and retry if called from setHeaderCacheEntry(),
-				//  otherwise this shouldn't happen and will trigger an error
-			}
-			if (idx >= 0)
-			{
-				// Set the header index
-				mHeaderIDMap[id] = idx;
-				llassert_always(mTexturesSizeMap.erase(id) == 0);
-				// Initialize the entry (will get written later)
-				entry.init(id, time(NULL));
-				// Update Header
-				writeEntriesHeader();
-				// Write Entry
-				S32 offset = sizeof(EntriesInfo) + idx * sizeof(Entry);
-				LLAPRFile* aprfile = openHeaderEntriesFile(false, offset);
-				S32 bytes_written = aprfile->write((void*)&entry, (S32)sizeof(Entry));
-				llassert_always(bytes_written == sizeof(Entry));
-				mHeaderEntriesMaxWriteIdx = llmax(mHeaderEntriesMaxWriteIdx, idx);
-				closeHeaderEntriesFile();
-			}
+			reuse = slot;
 		}
+		slot = (slot + 1) & mEntryIndexMask;
+	}
+	if (reuse >= 0)
+	{
+		slot = reuse;
 	}
 	else
 	{
-		// Remove this entry from the LRU if it exists
-		mLRU.erase(id);
-		// Read the entry
-		S32 offset = sizeof(EntriesInfo) + idx * sizeof(Entry);
-		LLAPRFile* aprfile = openHeaderEntriesFile(true, offset);
-		S32 bytes_read = aprfile->read((void*)&entry, (S32)sizeof(Entry));
-		llassert_always(bytes_read == sizeof(Entry));
-		llassert_always(entry.mImageSize == 0 || entry.mImageSize == -1 || entry.mImageSize > entry.mBodySize);
-		closeHeaderEntriesFile();
+		mEntryIndexUsed++;
 	}
-	return idx;
+	index[slot] = (apr_uint32_t)(idx + 1);
 }
 
-void LLTextureCache::writeEntryAndClose(S32 idx, Entry& entry)
+void LLTextureCache::eraseEntryIndex(S32 idx)
 {
-	if (idx >= 0)
+	apr_uint32_t* index = mEntryIndex;
+	for (U32 slot = entry_hash(mEntries[idx].mID) & mEntryIndexMask; index[slot] != ENTRY_SLOT_EMPTY; slot = (slot + 1) & mEntryIndexMask)
 	{
-		if (!mReadOnly)
+		if (index[slot] == (apr_uint32_t)(idx + 1))
+		{
+			index[slot] = ENTRY_SLOT_REMOVED;
+			return;
+		}
+	}
+}
+
+// Drops removed slots.
+void LLTextureCache::rebuildEntryIndex()
+{
+	U32 size = mEntryIndexMask + 1;
+	apr_uint32_t* old_index = mEntryIndex;
+	apr_uint32_t* new_index = new apr_uint32_t[size];
+	memset(new_index, 0, size * sizeof(apr_uint32_t));
+
+	mEntryIndexUsed = 0;
+	for (U32 i = 0; i < size; i++)
+	{
+		U32 value = old_index[i];
+		if (value != ENTRY_SLOT_EMPTY && value != ENTRY_SLOT_REMOVED)
 		{
-			entry.mTime = time(NULL);
-			llassert_always(entry.mImageSize == 0 || entry.mImageSize == -1 || entry.mImageSize > entry.mBodySize);
-			if (entry.mBodySize > 0)
+			U32 slot = entry_hash(mEntries[value - 1].mID) & mEntryIndexMask;
+			while (new_index[slot] != ENTRY_SLOT_EMPTY)
 			{
-				mTexturesSizeMap[entry.mID] = entry.mBodySize;
+				slot = (slot + 1) & mEntryIndexMask;
 			}
-// 			llinfos << "Updating TE: " << idx << ": " << id << " Size: " << entry.mBodySize << " Time: " << entry.mTime << llendl;
-			S32 offset = sizeof(EntriesInfo) + idx * sizeof(Entry);
-			LLAPRFile* aprfile = openHeaderEntriesFile(false, offset);
-			S32 bytes_written = aprfile->write((void*)&entry, (S32)sizeof(Entry));
-			llassert_always(bytes_written == sizeof(Entry));
-			mHeaderEntriesMaxWriteIdx = llmax(mHeaderEntriesMaxWriteIdx, idx);
-			closeHeaderEntriesFile();
+			new_index[slot] = value;
+			mEntryIndexUsed++;
 		}
 	}
+
+	mEntryIndex = new_index;
+	delete[] old_index;
 }
 
-U32 LLTextureCache::openAndReadEntries(std::vector<Entry>& entries)
+// Scan the mapped entries once to rebuild the index, the free list and the
+// body size total.
+void LLTextureCache::buildEntryIndex()
 {
-	U32 num_entries = mHeaderEntriesInfo.mEntries;
+	U32 size = 16;
+	while (size < sCacheMaxEntries * 2)
+	{
+		size <<= 1;
+	}
+	if (size != mEntryIndexMask + 1)
+	{
+		delete[] mEntryIndex;
+		mEntryIndex = new apr_uint32_t[size];
+		mEntryIndexMask = size - 1;
+	}
+	memset(mEntryIndex, 0, size * sizeof(apr_uint32_t));
+	mEntryIndexUsed = 0;
 
-	mHeaderIDMap.clear();
-	mTexturesSizeMap.clear();
 	mFreeList.clear();
+	mLRU.clear();
+	mBodyLRU.clear();
 	mTexturesSizeTotal = 0;
 
-	LLAPRFile* aprfile = openHeaderEntriesFile(false, (S32)sizeof(EntriesInfo));
-	for (U32 idx=0; idx<num_entries; idx++)
+	U32 num_entries = mHeaderEntriesInfo.mEntries;
+	for (U32 idx = 0; idx < num_entries; idx++)
 	{
-		Entry entry;
-		S32 bytes_read = aprfile->read((void*)(&entry), (S32)sizeof(Entry));
-		if (bytes_read < sizeof(Entry))
+		Entry& entry = mEntries[idx];
+		bool bad = false;
+		if (entry.mImageSize >= 0)
 		{
-			llwarns << "Corrupted header entries, failed at " << idx << " / " << num_entries << llendl;
-			closeHeaderEntriesFile();
-			purgeAllTextures(false);
-			return 0;
+			if (entry.mBodySize > 0 && entry.mBodySize > entry.mImageSize)
+			{
+				// Shouldn't happen, failsafe only
+				llwarns << "Bad entry: " << idx << ": " << entry.mID << ": BodySize: " << entry.mBodySize << llendl;
+				bad = true;
+			}
+			else if (lookupEntry(entry.mID) >= 0)
+			{
+				llwarns << "Duplicate entry: " << idx << ": " << entry.mID << llendl;
+				bad = true;
+			}
+		}
+
+		if (bad && !mReadOnly)
+		{
+			if (lookupEntry(entry.mID) < 0)
+			{
+				LLAPRFile::remove(getTextureFileName(entry.mID));
+				LLAPRFile::remove(getCompressedFileName(entry.mID));
+			}
+			entry.mImageSize = -1;
+			entry.mBodySize = 0;
+			entry.mCompressedSize = 0;
 		}
-		entries.push_back(entry);
-// 		llinfos << "ENTRY: " << entry.mTime << " TEX: " << entry.mID << " IDX: " << idx << " Size: " << entry.mImageSize << llendl;
-		if (entry.mImageSize < 0)
+
+		if (entry.mImageSize < 0 || bad)
 		{
-			mFreeList.insert(idx);
+			mFreeList.push_back(idx);
 		}
 		else
 		{
-			mHeaderIDMap[entry.mID] = idx;
-			if (entry.mBodySize > 0)
-			{
-				mTexturesSizeMap[entry.mID] = entry.mBodySize;
-				mTexturesSizeTotal += entry.mBodySize;
-			}
-			llassert_always(entry.mImageSize == 0 || entry.mImageSize > entry.mBodySize);
+			insertEntryIndex(idx);
+			mTexturesSizeTotal += entry.mBodySize + entry.mCompressedSize;
 		}
 	}
-	closeHeaderEntriesFile();
-	return num_entries;
 }
 
-void LLTextureCache::writeEntriesAndClose(const std::vector<Entry>& entries)
+void LLTextureCache::touchEntry(S32 idx)
 {
-	S32 num_entries = entries.size();
-	llassert_always(num_entries == mHeaderEntriesInfo.mEntries);
-	
 	if (!mReadOnly)
 	{
-		LLAPRFile* aprfile = openHeaderEntriesFile(false, (S32)sizeof(EntriesInfo));
-		for (S32 idx=0; idx<num_entries; idx++)
-		{
-			S32 bytes_written = aprfile->write((void*)(&entries[idx]), (S32)sizeof(Entry));
-			llassert_always(bytes_written == sizeof(Entry));
-		}
-		mHeaderEntriesMaxWriteIdx = llmax(mHeaderEntriesMaxWriteIdx, num_entries-1);
-		closeHeaderEntriesFile();
+		mEntries[idx].mTime = (U32)time(NULL);
 	}
 }
 
-//----------------------------------------------------------------------------
-
-// Called from either the main thread or the worker thread
-void LLTextureCache::readHeaderCache()
+// Collect the oldest TEXTURE_CACHE_LRU_SIZE of the entries (or of those
+// with bodies) as eviction candidates.
+void LLTextureCache::rebuildLRU(lru_list_t& lru, bool bodies_only)
 {
-	mHeaderMutex.lock();
-
-	mLRU.clear(); // always clear the LRU
-
-	readEntriesHeader();
-	
-	if (mHeaderEntriesInfo.mVersion != sHeaderCacheVersion)
+	lru.clear();
+	U32 num_entries = mHeaderEntriesInfo.mEntries;
+	for (U32 idx = 0; idx < num_entries; idx++)
 	{
-		if (!mReadOnly)
+		if (mEntries[idx].mImageSize >= 0 &&
+			(!bodies_only || mEntries[idx].mBodySize > 0 || mEntries[idx].mCompressedSize > 0))
 		{
-			purgeAllTextures(false);
+			lru.push_back(std::make_pair((U32)mEntries[idx].mTime, (S32)idx));
 		}
 	}
+
+	U32 lru_entries = llmax((U32)1, (U32)((F32)sCacheMaxEntries * TEXTURE_CACHE_LRU_SIZE));
+	if (lru.size() > lru_entries)
+	{
+		std::nth_element(lru.begin(), lru.begin() + lru_entries, lru.end());
+		lru.resize(lru_entries);
+	}
+	// newest first, so the oldest pops off the back
+	std::sort(lru.begin(), lru.end(), std::greater<std::pair<U32, S32> >());
+}
+
+S32 LLTextureCache::allocateEntry(const LLUUID& id)
+{
+	S32 idx = -1;
+	if (mHeaderEntriesInfo.mEntries < llmin(sCacheMaxEntries, mMappedEntries))
+	{
+		// Add an entry to the end of the list
+		idx = mHeaderEntriesInfo.mEntries++;
+		writeEntriesHeader();
+	}
+	else if (!mFreeList.empty())
+	{
+		idx = mFreeList.back();
+		mFreeList.pop_back();
+	}
 	else
 	{
-		std::vector<Entry> entries;
-		U32 num_entries = openAndReadEntries(entries);
-		if (num_entries)
+		// Recycle the least recently used entry.  Candidates touched since
+		// the list was built are skipped.
+		for (S32 pass = 0; pass < 2 && idx < 0; pass++)
 		{
-			U32 empty_entries = 0;
-			typedef std::pair<U32, LLUUID> lru_data_t;
-			std::set<lru_data_t> lru;
-			std::vector<LLUUID> purge_list;
-			for (U32 i=0; i<num_entries; i++)
-			{
-				Entry& entry = entries[i];
-				const LLUUID& id = entry.mID;
-				if (entry.mImageSize < 0)
-				{
-					// This will be in the Free List, don't put it in the LRU
-					++empty_entries;
-				}
-				else
-				{
-					lru.insert(std::make_pair(entry.mTime, id));
-					if (entry.mBodySize > 0)
-					{
-						if (entry.mBodySize > entry.mImageSize)
-						{
-							// Shouldn't happen, failsafe only
-							llwarns << "Bad entry: " << i << ": " << id << ": BodySize: " << entry.mBodySize << llendl;
-							purge_list.push_back(id);
-						}
-					}
-				}
-			}
-			if (num_entries > sCacheMaxEntries)
-			{
-				// Special case: cache size was reduced, need to remove entries
-				// Note: After we prune entries, we will call this again and create the LRU
-				U32 entries_to_purge = (num_entries-empty_entries) - sCacheMaxEntries;
-				if (entries_to_purge > 0)
-				{
-					for (std::set<lru_data_t>::iterator iter = lru.begin(); iter != lru.end(); ++iter)
-					{
-						purge_list.push_back(iter->second);
-						if (--entries_to_purge <= 0)
-							break;
-					}
-				}
-			}
-			else
+			if (mLRU.empty())
 			{
-				S32 lru_entries = (S32)((F32)sCacheMaxEntries * TEXTURE_CACHE_LRU_SIZE);
-				for (std::set<lru_data_t>::iterator iter = lru.begin(); iter != lru.end(); ++iter)
-				{
-					mLRU.insert(iter->second);
-// 					llinfos << "LRU: " << iter->first << " : " << iter->second << llendl;
-					if (--lru_entries <= 0)
-						break;
-				}
+				rebuildLRU(mLRU, false);
 			}
-			
-			if (purge_list.size() > 0)
+			while (!mLRU.empty())
 			{
-				for (std::vector<LLUUID>::iterator iter = purge_list.begin(); iter != purge_list.end(); ++iter)
-				{
-					mHeaderMutex.unlock(); 
-					removeFromCache(*iter);
-					mHeaderMutex.lock();
-				}
-				// If we removed any entries, we need to rebuild the entries list,
-				// write the header, and call this again
-				std::vector<Entry> new_entries;
-				for (U32 i=0; i<num_entries; i++)
+				std::pair<U32, S32> candidate = mLRU.back();
+				mLRU.pop_back();
+				Entry& entry = mEntries[candidate.second];
+				if (entry.mImageSize >= 0 && entry.mTime == candidate.first)
 				{
-					const Entry& entry = entries[i];
-					if (entry.mImageSize >=0)
+					idx = candidate.second;
+					eraseEntryIndex(idx);
+					removeCompressedFile(entry);
+					if (entry.mBodySize > 0)
 					{
-						new_entries.push_back(entry);
+						LLAPRFile::remove(getTextureFileName(entry.mID));
+						mTexturesSizeTotal -= entry.mBodySize;
 					}
+					break;
 				}
-				llassert_always(new_entries.size() <= sCacheMaxEntries);
-				mHeaderEntriesInfo.mEntries = new_entries.size();
-				writeEntriesAndClose(new_entries);
-				mHeaderMutex.unlock(); // unlock the mutex before calling again
-				readHeaderCache(); // repeat with new entries file
-				mHeaderMutex.lock();
-			}
-			else
-			{
-				writeEntriesAndClose(entries);
 			}
 		}
 	}
-	mHeaderMutex.unlock();
+
+	if (idx >= 0)
+	{
+		mEntries[idx].init(id, time(NULL));
+		insertEntryIndex(idx);
+	}
+	return idx;
+}
+
+//----------------------------------------------------------------------------
+
+// Called from either the main thread or the worker thread
+void LLTextureCache::readHeaderCache()
+{
+	LLMutexLock lock(&mHeaderMutex);
+
+	closeHeaderMap();
+	readEntriesHeader();
+	
+	if (mHeaderEntriesInfo.mVersion != sHeaderCacheVersion ||
+		mHeaderEntriesInfo.mEntries > sCacheMaxEntries)
+	{
+		// Header data is stored by entry index, so a table that no longer
+		// fits can't be compacted in place; start over.
+		if (!mReadOnly)
+		{
+			purgeAllTextures(false);
+		}
+		else
+		{
+			mHeaderEntriesInfo.mEntries = 0;
+		}
+	}
+
+	if (!openHeaderMap())
+	{
+		llwarns << "Unable to map " << mHeaderEntriesFileName << llendl;
+		mHeaderEntriesInfo.mEntries = 0;
+		return;
+	}
+
+	mHeaderEntriesInfo.mEntries = llmin(mHeaderEntriesInfo.mEntries, mMappedEntries);
+	writeEntriesHeader();
+	buildEntryIndex();
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1275,10 +1515,14 @@ void LLTextureCache::purgeAllTextures(bool purge_directories)
 			LLFile::rmdir(mTexturesDirName);
 		}
 	}
-	mHeaderIDMap.clear();
-	mTexturesSizeMap.clear();
-	mTexturesSizeTotal = 0;
+	if (mEntryIndex)
+	{
+		memset(mEntryIndex, 0, (mEntryIndexMask + 1) * sizeof(apr_uint32_t));
+	}
+	mEntryIndexUsed = 0;
 	mFreeList.clear();
+	mLRU.clear();
+	mBodyLRU.clear();
 	mTexturesSizeTotal = 0;
 
 	// Info with 0 entries
@@ -1287,121 +1531,146 @@ void LLTextureCache::purgeAllTextures(bool purge_directories)
 	writeEntriesHeader();
 }
 
-void LLTextureCache::purgeTextures(bool validate)
+void LLTextureCache::validateTextures()
 {
 	if (mReadOnly)
 	{
 		return;
 	}
 
-	if (!mThreaded)
-	{
-		// *FIX:Mani - watchdog off.
-		LLAppViewer::instance()->pauseMainloopTimeout();
-	}
-	
 	LLMutexLock lock(&mHeaderMutex);
 
-	llinfos << "TEXTURE CACHE: Purging." << llendl;
+	// Validate 1/256th of the files on startup
+	U32 validate_idx = gSavedSettings.getU32("CacheValidateCounter");
+	U32 next_idx = (++validate_idx) % 256;
+	gSavedSettings.setU32("CacheValidateCounter", next_idx);
+	LL_DEBUGS("TextureCache") << "TEXTURE CACHE: Validating: " << validate_idx << LL_ENDL;
 
-	// Read the entries list
-	std::vector<Entry> entries;
-	U32 num_entries = openAndReadEntries(entries);
-	if (!num_entries)
-	{
-		writeEntriesAndClose(entries);
-		return; // nothing to purge
-	}
-	
-	// Use mTexturesSizeMap to collect UUIDs of textures with bodies
-	typedef std::set<std::pair<U32,S32> > time_idx_set_t;
-	std::set<std::pair<U32,S32> > time_idx_set;
-	for (size_map_t::iterator iter1 = mTexturesSizeMap.begin();
-		 iter1 != mTexturesSizeMap.end(); ++iter1)
+	U32 num_entries = mHeaderEntriesInfo.mEntries;
+	S32 purge_count = 0;
+	for (U32 idx = 0; idx < num_entries; idx++)
 	{
-		if (iter1->second > 0)
+		Entry& entry = mEntries[idx];
+		if (entry.mImageSize < 0 || entry.mID.mData[0] != validate_idx)
 		{
-			id_map_t::iterator iter2 = mHeaderIDMap.find(iter1->first);
-			if (iter2 != mHeaderIDMap.end())
-			{
-				S32 idx = iter2->second;
-				time_idx_set.insert(std::make_pair(entries[idx].mTime, idx));
-// 				llinfos << "TIME: " << entries[idx].mTime << " TEX: " << entries[idx].mID << " IDX: " << idx << " Size: " << entries[idx].mImageSize << llendl;
-			}
+			continue;
+		}
+
+		if (entry.mCompressedSize > 0 &&
+			LLAPRFile::size(getCompressedFileName(entry.mID)) != entry.mCompressedSize)
+		{
+			purge_count++;
+			removeCompressedFile(entry);
+		}
+		if (entry.mBodySize <= 0)
+		{
+			continue;
+		}
+
+		// make sure file exists and is the correct size
+		std::string filename = getTextureFileName(entry.mID);
+		LL_DEBUGS("TextureCache") << "Validating: " << filename << "Size: " << entry.mBodySize << LL_ENDL;
+		S32 bodysize = LLAPRFile::size(filename);
+		if (bodysize != entry.mBodySize)
+		{
+			LL_WARNS("TextureCache") << "TEXTURE CACHE BODY HAS BAD SIZE: " << bodysize << " != " << entry.mBodySize
+					<< filename << LL_ENDL;
+			purge_count++;
+			LLAPRFile::remove(filename);
+			mTexturesSizeTotal -= entry.mBodySize;
+			entry.mBodySize = 0;
 		}
 	}
-	
-	// Validate 1/256th of the files on startup
-	U32 validate_idx = 0;
-	if (validate)
+
+	if (mTexturesSizeTotal > sCacheMaxTexturesSize)
 	{
-		validate_idx = gSavedSettings.getU32("CacheValidateCounter");
-		U32 next_idx = (++validate_idx) % 256;
-		gSavedSettings.setU32("CacheValidateCounter", next_idx);
-		LL_DEBUGS("TextureCache") << "TEXTURE CACHE: Validating: " << validate_idx << LL_ENDL;
+		// trimmed back in slices by the cache thread
+		mDoPurge = TRUE;
 	}
 
-	S64 cache_size = mTexturesSizeTotal;
-	S64 purged_cache_size = (sCacheMaxTexturesSize * (S64)((1.f-TEXTURE_CACHE_PURGE_AMOUNT)*100)) / 100;
-	S32 purge_count = 0;
-	for (time_idx_set_t::iterator iter = time_idx_set.begin();
-		 iter != time_idx_set.end(); ++iter)
+	LL_INFOS("TextureCache") << "TEXTURE CACHE:"
+			<< " INVALID: " << purge_count
+			<< " ENTRIES: " << num_entries
+			<< " CACHE SIZE: " << mTexturesSizeTotal / (1024*1024) << " MB"
+			<< llendl;
+}
+
+// Remove the bodies of up to max_count least recently used textures, stopping
+// once the cache is TEXTURE_CACHE_EVICT_AMOUNT below its budget.  Headers stay,
+// so an evicted texture still starts from its first packet.
+void LLTextureCache::evictTextures(U32 max_count)
+{
+	if (mReadOnly)
 	{
-		S32 idx = iter->second;
-		bool purge_entry = false;
-		std::string filename = getTextureFileName(entries[idx].mID);
-		if (cache_size >= purged_cache_size)
-		{
-			purge_entry = true;
-		}
-		else if (validate)
+		mDoPurge = FALSE;
+		return;
+	}
+
+	LLMutexLock lock(&mHeaderMutex);
+
+	S64 target_size = (sCacheMaxTexturesSize * (S64)((1.f-TEXTURE_CACHE_EVICT_AMOUNT)*100)) / 100;
+	bool rebuilt = false;
+	U32 count = 0;
+	while (mTexturesSizeTotal > target_size && count < max_count)
+	{
+		if (mBodyLRU.empty())
 		{
-			// make sure file exists and is the correct size
-			S32 uuididx = entries[idx].mID.mData[0];
-			if (uuididx == validate_idx)
+			if (rebuilt)
 			{
- 				LL_DEBUGS("TextureCache") << "Validating: " << filename << "Size: " << entries[idx].mBodySize << LL_ENDL;
-				S32 bodysize = LLAPRFile::size(filename);
-				if (bodysize != entries[idx].mBodySize)
-				{
-					LL_WARNS("TextureCache") << "TEXTURE CACHE BODY HAS BAD SIZE: " << bodysize << " != " << entries[idx].mBodySize
-							<< filename << LL_ENDL;
-					purge_entry = true;
-				}
+				break; // at most one scan per slice
+			}
+			rebuildLRU(mBodyLRU, true);
+			rebuilt = true;
+			if (mBodyLRU.empty())
+			{
+				break;
 			}
 		}
-		else
+
+		std::pair<U32, S32> candidate = mBodyLRU.back();
+		mBodyLRU.pop_back();
+		Entry& entry = mEntries[candidate.second];
+		if (entry.mImageSize < 0 || (entry.mBodySize <= 0 && entry.mCompressedSize <= 0) ||
+			entry.mTime != candidate.first)
 		{
-			break;
+			continue; // gone, or used since the list was built
 		}
-		
-		if (purge_entry)
+
+		LL_DEBUGS("TextureCache") << "EVICTING: " << entry.mID << " Size: " << entry.mBodySize
+								  << " Compressed: " << entry.mCompressedSize << LL_ENDL;
+		mEvictedBytes += entry.mBodySize + entry.mCompressedSize;
+		removeCompressedFile(entry);
+		if (entry.mBodySize > 0)
 		{
-			purge_count++;
-	 		LL_DEBUGS("TextureCache") << "PURGING: " << filename << LL_ENDL;
-			LLAPRFile::remove(filename);
-			cache_size -= entries[idx].mBodySize;
-			mTexturesSizeTotal -= entries[idx].mBodySize;
-			entries[idx].mBodySize = 0;
-			mTexturesSizeMap.erase(entries[idx].mID);
+			LLAPRFile::remove(getTextureFileName(entry.mID));
+			mTexturesSizeTotal -= entry.mBodySize;
+			entry.mBodySize = 0;
 		}
+		mEvictions++;
+		count++;
 	}
 
-	LL_DEBUGS("TextureCache") << "TEXTURE CACHE: Writing Entries: " << num_entries << LL_ENDL;
+	if (mTexturesSizeTotal <= target_size || (rebuilt && mBodyLRU.empty()))
+	{
+		mDoPurge = FALSE;
+	}
+}
 
-	writeEntriesAndClose(entries);
-	
-	if (!mThreaded)
+//virtual
+bool LLTextureCache::runCondition()
+{
+	// mRunCondition must be locked here.  Keep running while over budget
+	// even with no requests queued.
+	return mDoPurge || !(mRequestQueue.empty() && mIdleThread);
+}
+
+//virtual
+void LLTextureCache::threadedUpdate()
+{
+	if (mDoPurge)
 	{
-		// *FIX:Mani - watchdog back on.
-		LLAppViewer::instance()->resumeMainloopTimeout();
+		evictTextures(TEXTURE_CACHE_EVICT_SLICE);
 	}
-	
-	LL_INFOS("TextureCache") << "TEXTURE CACHE:"
-			<< " PURGED: " << purge_count
-			<< " ENTRIES: " << num_entries
-			<< " CACHE SIZE: " << mTexturesSizeTotal / 1024*1024 << " MB"
-			<< llendl;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1436,12 +1705,11 @@ LLTextureCacheWorker* LLTextureCache::getWriter(handle_t handle)
 S32 LLTextureCache::getHeaderCacheEntry(const LLUUID& id, S32& imagesize)
 {
 	LLMutexLock lock(&mHeaderMutex);
-	Entry entry;
-	S32 idx = openAndReadEntry(id, entry, false);
+	S32 idx = lookupEntry(id);
 	if (idx >= 0)
 	{
-		imagesize = entry.mImageSize;
-		writeEntryAndClose(idx, entry); // updates time
+		imagesize = mEntries[idx].mImageSize;
+		touchEntry(idx);
 	}
 	return idx;
 }
@@ -1449,24 +1717,19 @@ S32 LLTextureCache::getHeaderCacheEntry(const LLUUID& id, S32& imagesize)
 // Writes imagesize to the header, updates timestamp
 S32 LLTextureCache::setHeaderCacheEntry(const LLUUID& id, S32 imagesize)
 {
-	mHeaderMutex.lock();
+	LLMutexLock lock(&mHeaderMutex);
 	llassert_always(imagesize >= 0);
-	Entry entry;
-	S32 idx = openAndReadEntry(id, entry, true);
-	if (idx >= 0)
+	S32 idx = lookupEntry(id);
+	if (idx < 0 && !mReadOnly && mEntries)
 	{
-		entry.mImageSize = imagesize;
-		writeEntryAndClose(idx, entry);
-		mHeaderMutex.unlock();
+		idx = allocateEntry(id);
 	}
-	else // retry
+	if (idx >= 0 && !mReadOnly)
 	{
-		mHeaderMutex.unlock();
-		readHeaderCache(); // We couldn't write an entry, so refresh the LRU
-		mHeaderMutex.lock();
-		llassert_always(!mLRU.empty() || mHeaderEntriesInfo.mEntries < sCacheMaxEntries);
-		mHeaderMutex.unlock();
-		idx = setHeaderCacheEntry(id, imagesize); // assert above ensures no inf. recursion
+		Entry& entry = mEntries[idx];
+		entry.mImageSize = imagesize;
+		llassert_always(entry.mImageSize == 0 || entry.mImageSize > entry.mBodySize);
+		touchEntry(idx);
 	}
 	return idx;
 }
@@ -1547,14 +1810,6 @@ LLTextureCache::handle_t LLTextureCache::writeToCache(const LLUUID& id, U32 prio
 		delete responder;
 		return LLWorkerThread::nullHandle();
 	}
-	if (mDoPurge)
-	{
-		// NOTE: This may cause an occasional hiccup,
-		//  but it really needs to be done on the control thread
-		//  (i.e. here)		
-		purgeTextures(false);
-		mDoPurge = FALSE;
-	}
 	LLMutexLock lock(&mWorkersMutex);
 	LLTextureCacheWorker* worker = new LLTextureCacheRemoteWorker(this, priority, id,
 																  data, datasize, 0,
@@ -1564,6 +1819,34 @@ LLTextureCache::handle_t LLTextureCache::writeToCache(const LLUUID& id, U32 prio
 	return handle;
 }
 
+LLTextureCache::handle_t LLTextureCache::readCompressedFromCache(const LLUUID& id, U32 priority,
+																 ReadResponder* responder)
+{
+	LLMutexLock lock(&mWorkersMutex);
+	LLTextureCacheWorker* worker = new LLTextureCacheCompressedWorker(this, priority, id,
+																	  NULL, responder);
+	handle_t handle = worker->read();
+	mReaders[handle] = worker;
+	return handle;
+}
+
+LLTextureCache::handle_t LLTextureCache::writeCompressedToCache(const LLUUID& id, U32 priority,
+																LLImageFormatted* image,
+																WriteResponder* responder)
+{
+	if (mReadOnly || !image || image->getDataSize() <= 0)
+	{
+		delete responder;
+		return LLWorkerThread::nullHandle();
+	}
+	LLMutexLock lock(&mWorkersMutex);
+	LLTextureCacheWorker* worker = new LLTextureCacheCompressedWorker(this, priority, id,
+																	  image, responder);
+	handle_t handle = worker->write();
+	mWriters[handle] = worker;
+	return handle;
+}
+
 bool LLTextureCache::writeComplete(handle_t handle, bool abort)
 {
 	lockWorkers();
@@ -1607,16 +1890,17 @@ bool LLTextureCache::removeHeaderCacheEntry(const LLUUID& id)
 	if (!mReadOnly)
 	{
 		LLMutexLock lock(&mHeaderMutex);
-		Entry entry;
-		S32 idx = openAndReadEntry(id, entry, false);
+		S32 idx = lookupEntry(id);
 		if (idx >= 0)
 		{
+			eraseEntryIndex(idx);
+			Entry& entry = mEntries[idx];
+			removeCompressedFile(entry);
+			mTexturesSizeTotal -= entry.mBodySize;
 			entry.mImageSize = -1;
 			entry.mBodySize = 0;
-			writeEntryAndClose(idx, entry);
-			mFreeList.insert(idx);
-			mHeaderIDMap.erase(id);
-			mTexturesSizeMap.erase(id);
+			touchEntry(idx);
+			mFreeList.push_back(idx);
 			return true;
 		}
 	}
@@ -40,6 +40,8 @@
 
 #include "llworkerthread.h"
 
+#include "apr_mmap.h"
+
 class LLTextureCacheWorker;
 
 class LLTextureCache : public LLWorkerThread
@@ -47,6 +49,7 @@ class LLTextureCache : public LLWorkerThread
 	friend class LLTextureCacheWorker;
 	friend class LLTextureCacheRemoteWorker;
 	friend class LLTextureCacheLocalFileWorker;
+	friend class LLTextureCacheCompressedWorker;
 
 private:
 	// Entries
@@ -60,13 +63,15 @@ private:
 	{
 		Entry() {}
 		Entry(const LLUUID& id, S32 imagesize, S32 bodysize, U32 time) :
-			mID(id), mImageSize(imagesize), mBodySize(bodysize), mTime(time) {}
-		void init(const LLUUID& id, U32 time) { mID = id, mImageSize = 0; mBodySize = 0; mTime = time; }
+			mID(id), mImageSize(imagesize), mBodySize(bodysize), mTime(time), mCompressedSize(0) {}
+		void init(const LLUUID& id, U32 time) { mID = id, mImageSize = 0; mBodySize = 0; mTime = time; mCompressedSize = 0; }
 		LLUUID mID; // 16 bytes
 		S32 mImageSize; // total size of image if known
 		S32 mBodySize; // size of body file in body cache
 		U32 mTime; // seconds since 1/1/1970
+		S32 mCompressedSize; // size of the DXT copy, 0 if none
 	};
+	typedef std::vector<std::pair<U32, S32> > lru_list_t; // (time, index)
 
 	
 public:
@@ -118,6 +123,16 @@ public:
 
 	void removeFromCache(const LLUUID& id);
 
+	// DXT copies of decoded textures (see LLTextureFetchWorker
+	// COMPRESS_IMAGE) live next to the bodies, count towards the cache
+	// size and go when their entry does.  A copy is only written for an
+	// existing entry.
+	handle_t readCompressedFromCache(const LLUUID& id, U32 priority, ReadResponder* responder);
+	handle_t writeCompressedToCache(const LLUUID& id, U32 priority, LLImageFormatted* image,
+									WriteResponder* responder);
+	void removeCompressedFromCache(const LLUUID& id);
+	bool isReadOnly() const { return mReadOnly ? true : false; }
+
 	// For LLTextureCacheWorker::Responder
 	LLTextureCacheWorker* getReader(handle_t handle);
 	LLTextureCacheWorker* getWriter(handle_t handle);
@@ -131,40 +146,54 @@ public:
 	S64 getMaxUsage() { return sCacheMaxTexturesSize; }
 	U32 getEntries() { return mHeaderEntriesInfo.mEntries; }
 	U32 getMaxEntries() { return sCacheMaxEntries; };
+	U32 getHits() { return mCacheHits; }
+	U32 getMisses() { return mCacheMisses; }
+	U32 getEvictions() { return mEvictions; }
+	S64 getEvictedBytes() { return mEvictedBytes; }
 
 protected:
 	// Accessed by LLTextureCacheWorker
 	bool updateTextureEntryList(const LLUUID& id, S32 size);
 	std::string getLocalFileName(const LLUUID& id);
 	std::string getTextureFileName(const LLUUID& id);
+	std::string getCompressedFileName(const LLUUID& id);
+	S32 getCompressedSize(const LLUUID& id); // -1 without an entry
+	bool setCompressedSize(const LLUUID& id, S32 size);
 	void addCompleted(Responder* responder, bool success);
 	
 protected:
 	//void setFileAPRPool(apr_pool_t* pool) { mFileAPRPool = pool ; }
 
 private:
+	/*virtual*/ bool runCondition();
+	/*virtual*/ void threadedUpdate();
 	void setDirNames(ELLPath location);
 	void readHeaderCache();
 	void purgeAllTextures(bool purge_directories);
-	void purgeTextures(bool validate);
-	LLAPRFile* openHeaderEntriesFile(bool readonly, S32 offset);
-	void closeHeaderEntriesFile();
+	void validateTextures();
+	void evictTextures(U32 max_count);
+	bool openHeaderMap();
+	void closeHeaderMap();
 	void readEntriesHeader();
 	void writeEntriesHeader();
-	S32 openAndReadEntry(const LLUUID& id, Entry& entry, bool create);
-	void writeEntryAndClose(S32 idx, Entry& entry);
-	U32 openAndReadEntries(std::vector<Entry>& entries);
-	void writeEntriesAndClose(const std::vector<Entry>& entries);
+	void buildEntryIndex();
+	S32 lookupEntry(const LLUUID& id) const;
+	void insertEntryIndex(S32 idx);
+	void eraseEntryIndex(S32 idx);
+	void rebuildEntryIndex();
+	void touchEntry(S32 idx);
+	S32 allocateEntry(const LLUUID& id);
+	void rebuildLRU(lru_list_t& lru, bool bodies_only);
 	S32 getHeaderCacheEntry(const LLUUID& id, S32& imagesize);
 	S32 setHeaderCacheEntry(const LLUUID& id, S32 imagesize);
 	bool removeHeaderCacheEntry(const LLUUID& id);
+	void removeCompressedFile(Entry& entry);
 	
 private:
 	// Internal
 	LLMutex mWorkersMutex;
 	LLMutex mHeaderMutex;
 	LLMutex mListMutex;
-	LLAPRFile* mHeaderAPRFile;
 	
 	typedef std::map<handle_t, LLTextureCacheWorker*> handle_map_t;
 	handle_map_t mReaders;
@@ -182,17 +211,35 @@ private:
 	std::string mHeaderEntriesFileName;
 	std::string mHeaderDataFileName;
 	EntriesInfo mHeaderEntriesInfo;
-	std::set<S32> mFreeList; // deleted entries
-	std::set<LLUUID> mLRU;
-	typedef std::map<LLUUID,S32> id_map_t;
-	id_map_t mHeaderIDMap;
+	std::vector<S32> mFreeList; // deleted entries
+	lru_list_t mLRU; // entries to recycle, oldest last
+	lru_list_t mBodyLRU; // bodies to evict, oldest last
+
+	// texture.entries mapped as a fixed size table of Entry records.
+	// Changes to the table are made with mHeaderMutex held and land in
+	// the file without explicit writes.
+	LLAPRPool mHeaderMapPool;
+	apr_file_t* mHeaderMapFile;
+	apr_mmap_t* mHeaderMap;
+	Entry* mEntries;
+	U32 mMappedEntries;
+
+	// Open addressed UUID -> entry index + 1 table over mEntries, read and
+	// written with mHeaderMutex held.
+	apr_uint32_t* mEntryIndex;
+	U32 mEntryIndexMask;
+	U32 mEntryIndexUsed; // live and removed slots
 
 	// BODIES (TEXTURES minus headers)
 	std::string mTexturesDirName;
-	typedef std::map<LLUUID,S32> size_map_t;
-	size_map_t mTexturesSizeMap;
 	S64 mTexturesSizeTotal;
-	LLAtomic32<BOOL> mDoPurge;
+	LLAtomic32<BOOL> mDoPurge; // over budget, evict in slices
+
+	// for tuning the cache size
+	LLAtomicU32 mCacheHits;
+	LLAtomicU32 mCacheMisses;
+	U32 mEvictions;
+	S64 mEvictedBytes;
 
 	// Statics
 	static F32 sHeaderCacheVersion;
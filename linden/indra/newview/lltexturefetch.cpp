@@ -43,6 +43,8 @@
 #include "llhttpclient.h"
 #include "llhttpstatuscodes.h"
 #include "llimage.h"
+#include "llimagedxt.h"
+#include "llimagegl.h"
 #include "llimageworker.h"
 #include "llworkerthread.h"
 
@@ -84,6 +86,29 @@ private:
 		LLUUID mID;
 	};
 
+	class CacheCompressedReadResponder : public LLTextureCache::ReadResponder
+	{
+	public:
+		CacheCompressedReadResponder(LLTextureFetch* fetcher, const LLUUID& id, LLImageDXT* image)
+			: mFetcher(fetcher), mID(id)
+		{
+			setImage(image);
+		}
+		virtual void completed(bool success)
+		{
+			mFetcher->lockQueue();
+			LLTextureFetchWorker* worker = mFetcher->getWorker(mID);
+			if (worker)
+			{
+ 				worker->callbackCompressedRead(success, mFormattedImage);
+			}
+			mFetcher->unlockQueue();
+		}
+	private:
+		LLTextureFetch* mFetcher;
+		LLUUID mID;
+	};
+
 	class CacheWriteResponder : public LLTextureCache::WriteResponder
 	{
 	public:
@@ -159,6 +184,7 @@ public:
 						 bool last_block, bool success);
 	void callbackCacheRead(bool success, LLImageFormatted* image,
 						   S32 imagesize, BOOL islocal);
+	void callbackCompressedRead(bool success, LLImageFormatted* image);
 	void callbackCacheWrite(bool success);
 	void callbackDecoded(bool success, LLImageRaw* raw, LLImageRaw* aux);
 	
@@ -189,6 +215,9 @@ private:
 	void removeFromCache();
 	bool processSimulatorPackets();
 	bool writeToCacheComplete();
+	bool loadCompressed();
+	void compressImage();
+	bool writeCompressed();
 	
 	void lockWorkMutex() { mWorkMutex.lock(); }
 	void unlockWorkMutex() { mWorkMutex.unlock(); }
@@ -199,6 +228,7 @@ private:
 		// NOTE: Affects LLTextureBar::draw in lltextureview.cpp (debug hack)
 		INVALID = 0,
 		INIT,
+		LOAD_COMPRESSED,
 		LOAD_FROM_TEXTURE_CACHE,
 		CACHE_POST,
 		LOAD_FROM_NETWORK,
@@ -207,6 +237,7 @@ private:
 		WAIT_HTTP_REQ,
 		DECODE_IMAGE,
 		DECODE_IMAGE_UPDATE,
+		COMPRESS_IMAGE,
 		WRITE_TO_CACHE,
 		WAIT_ON_WRITE,
 		DONE
@@ -218,11 +249,31 @@ private:
 		SENT_SIM = 2
 	};
 	static const char* sStateDescs[];
+
+	// Changes mState, recording the time spent in the old state when the
+	// fetch trace is enabled.
+	void setState(e_state state);
+	// Brackets a cache, HTTP or decode request issued by state, so the
+	// time until its callback counts against that state rather than as
+	// waiting in whichever state the worker is in meanwhile.
+	void traceRequestIssued(e_state state);
+	void traceRequestDone();
+	// Sorts the time since the last call into work, request or wait.
+	void traceAdvance(U64 now);
+	// Counts the time spent inside doWork() as work for the current state.
+	struct TraceWorkScope
+	{
+		TraceWorkScope(LLTextureFetchWorker* worker);
+		~TraceWorkScope();
+		LLTextureFetchWorker* mWorker;
+	};
+
 	e_state mState;
 	LLTextureFetch* mFetcher;
 	LLPointer<LLImageFormatted> mFormattedImage;
 	LLPointer<LLImageRaw> mRawImage;
 	LLPointer<LLImageRaw> mAuxImage;
+	LLPointer<LLImageDXT> mCompressedImage;
 	LLUUID mID;
 	LLHost mHost;
 	std::string mUrl;
@@ -230,6 +281,7 @@ private:
 	F32 mImagePriority;
 	U32 mWorkPriority;
 	F32 mRequestedPriority;
+	F32 mHTTPPriority;
 	S32 mDesiredDiscard;
 	S32 mSimRequestedDiscard;
 	S32 mRequestedDiscard;
@@ -253,6 +305,9 @@ private:
 	BOOL mNeedsAux;
 	BOOL mHaveAllData;
 	BOOL mInLocalCache;
+	BOOL mCompress;
+	BOOL mWriteCompressed; // mCompressedImage improves on the cached copy
+	S32 mCompressedDiscard; // -2 not probed yet, -1 no cached copy
 	S32 mHTTPFailCount;
 	S32 mRetryAttempt;
 	S32 mActiveCount;
@@ -274,6 +329,17 @@ private:
 	S32 mLastPacket;
 	U16 mTotalPackets;
 	U8 mImageCodec;
+
+	// Fetch trace, protected by mWorkMutex
+	U32 mTraceRequest;
+	U64 mStateStartTime;	// 0 when not tracing
+	U64 mStateWorkTime;
+	U64 mStateRequestTime;	// waiting on an issued request, not in doWork()
+	U64 mTraceMark;			// time sorted up to
+	BOOL mInWork;			// inside doWork()
+	U64 mRequestStartTime;	// non 0 while an issued request is pending
+	U64 mRequestPendingTime;
+	e_state mRequestState;
 };
 
 //////////////////////////////////////////////////////////////////////////////
@@ -305,6 +371,14 @@ public:
 		}
 
 		lldebugs << "HTTP COMPLETE: " << mID << llendl;
+		// Server side errors and transport failures (499) mean we are asking
+		// for too much at once; a 404 says nothing about the connection.
+		bool overloaded = status >= HTTP_INTERNAL_SERVER_ERROR || status == HTTP_INTERNAL_ERROR ||
+						  status == HTTP_REQUEST_TIME_OUT;
+		S32 bytes = overloaded ? 0 : buffer->countAfter(channels.in(), NULL);
+		F32 seconds = (F32)((LLTimer::getTotalTime() - mStartTime) / 1000000.0);
+		mFetcher->recordHTTPResult(seconds, bytes, !overloaded);
+
 		mFetcher->lockQueue();
 		LLTextureFetchWorker* worker = mFetcher->getWorker(mID);
 		if (worker)
@@ -354,6 +428,7 @@ private:
 const char* LLTextureFetchWorker::sStateDescs[] = {
 	"INVALID",
 	"INIT",
+	"LOAD_COMPRESSED",
 	"LOAD_FROM_TEXTURE_CACHE",
 	"CACHE_POST",
 	"LOAD_FROM_NETWORK",
@@ -362,6 +437,7 @@ const char* LLTextureFetchWorker::sStateDescs[] = {
 	"WAIT_HTTP_REQ",
 	"DECODE_IMAGE",
 	"DECODE_IMAGE_UPDATE",
+	"COMPRESS_IMAGE",
 	"WRITE_TO_CACHE",
 	"WAIT_ON_WRITE",
 	"DONE",
@@ -385,6 +461,7 @@ LLTextureFetchWorker::LLTextureFetchWorker(LLTextureFetch* fetcher,
 	  mImagePriority(priority),
 	  mWorkPriority(0),
 	  mRequestedPriority(0.f),
+	  mHTTPPriority(0.f),
 	  mDesiredDiscard(-1),
 	  mSimRequestedDiscard(-1),
 	  mRequestedDiscard(-1),
@@ -406,6 +483,9 @@ LLTextureFetchWorker::LLTextureFetchWorker(LLTextureFetch* fetcher,
 	  mNeedsAux(FALSE),
 	  mHaveAllData(FALSE),
 	  mInLocalCache(FALSE),
+	  mCompress(FALSE),
+	  mWriteCompressed(FALSE),
+	  mCompressedDiscard(-2),
 	  mHTTPFailCount(0),
 	  mRetryAttempt(0),
 	  mActiveCount(0),
@@ -414,7 +494,16 @@ LLTextureFetchWorker::LLTextureFetchWorker(LLTextureFetch* fetcher,
 	  mFirstPacket(0),
 	  mLastPacket(-1),
 	  mTotalPackets(0),
-	  mImageCodec(IMG_CODEC_INVALID)
+	  mImageCodec(IMG_CODEC_INVALID),
+	  mTraceRequest(fetcher->mTrace.newRequestId()),
+	  mStateStartTime(fetcher->mTrace.isEnabled() ? LLTimer::getTotalTime() : 0),
+	  mStateWorkTime(0),
+	  mStateRequestTime(0),
+	  mTraceMark(mStateStartTime),
+	  mInWork(FALSE),
+	  mRequestStartTime(0),
+	  mRequestPendingTime(0),
+	  mRequestState(INVALID)
 {
 	calcWorkPriority();
 	mType = host.isOk() ? LLImageBase::TYPE_AVATAR_BAKE : LLImageBase::TYPE_NORMAL;
@@ -437,6 +526,11 @@ LLTextureFetchWorker::~LLTextureFetchWorker()
 // 			<< " Desired=" << mDesiredDiscard << llendl;
 	llassert_always(!haveWork());
 	lockWorkMutex();
+	if (mState != DONE)
+	{
+		// Close the interval of a request cancelled part way through
+		setState(DONE);
+	}
 	if (mCacheReadHandle != LLTextureCache::nullHandle())
 	{
 		mFetcher->mTextureCache->readComplete(mCacheReadHandle, true);
@@ -528,7 +622,7 @@ void LLTextureFetchWorker::setDesiredDiscard(S32 discard, S32 size)
 	}
 	if ((prioritize && mState == INIT) || mState == DONE)
 	{
-		mState = INIT;
+		setState(INIT);
 		U32 work_priority = mWorkPriority | LLWorkerThread::PRIORITY_HIGH;
 		setPriority(work_priority);
 	}
@@ -571,6 +665,7 @@ void LLTextureFetchWorker::startWork(S32 param)
 bool LLTextureFetchWorker::doWork(S32 param)
 {
 	LLMutexLock lock(&mWorkMutex);
+	TraceWorkScope trace_scope(this);
 
 	if ((mFetcher->isQuitting() || (mImagePriority <= 0.0f) || getFlags(LLWorkerClass::WCF_DELETE_REQUESTED)))
 	{
@@ -613,7 +708,37 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		clearPackets(); // TODO: Shouldn't be necessary
 		mCacheReadHandle = LLTextureCache::nullHandle();
 		mCacheWriteHandle = LLTextureCache::nullHandle();
-		mState = LOAD_FROM_TEXTURE_CACHE;
+		// The DXT copy is only probed once per worker: after that any
+		// better copy was made by this worker itself.
+		setState(mCompress && mCompressedDiscard == -2 ? LOAD_COMPRESSED : LOAD_FROM_TEXTURE_CACHE);
+		// fall through
+	}
+
+	if (mState == LOAD_COMPRESSED)
+	{
+		if (mCacheReadHandle == LLTextureCache::nullHandle())
+		{
+			mCompressedDiscard = -1;
+			mLoaded = FALSE;
+			setPriority(LLWorkerThread::PRIORITY_LOW | mWorkPriority); // Set priority first since Responder may change it
+			CacheCompressedReadResponder* responder = new CacheCompressedReadResponder(mFetcher, mID, new LLImageDXT);
+			traceRequestIssued(LOAD_COMPRESSED);
+			mCacheReadHandle = mFetcher->mTextureCache->readCompressedFromCache(mID, mWorkPriority, responder);
+			return false;
+		}
+		if (!mLoaded || !mFetcher->mTextureCache->readComplete(mCacheReadHandle, false))
+		{
+			return false;
+		}
+		mCacheReadHandle = LLTextureCache::nullHandle();
+		mLoaded = FALSE;
+		if (loadCompressed())
+		{
+			// The DXT copy is good enough, skip the fetch and decode
+			setState(DONE);
+			return false;
+		}
+		setState(LOAD_FROM_TEXTURE_CACHE);
 		// fall through
 	}
 
@@ -626,7 +751,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 			S32 size = mDesiredSize - offset;
 			if (size <= 0)
 			{
-				mState = CACHE_POST;
+				setState(CACHE_POST);
 				return false;
 			}
 			mFileSize = 0;
@@ -638,11 +763,13 @@ bool LLTextureFetchWorker::doWork(S32 param)
 			{
 				// read file from local disk
 				std::string filename = mUrl.substr(7, std::string::npos);
+				traceRequestIssued(LOAD_FROM_TEXTURE_CACHE);
 				mCacheReadHandle = mFetcher->mTextureCache->readFromCache(filename, mID, cache_priority,
 																		  offset, size, responder);
 			}
 			else if (mUrl.empty())
 			{
+				traceRequestIssued(LOAD_FROM_TEXTURE_CACHE);
 				mCacheReadHandle = mFetcher->mTextureCache->readFromCache(mID, cache_priority,
 																		  offset, size, responder);
 			}
@@ -654,7 +781,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 					llwarns << "Unknown URL Type: " << mUrl << llendl;
 				}
 				setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
-				mState = SEND_HTTP_REQ;
+				setState(SEND_HTTP_REQ);
 			}
 		}
 
@@ -664,7 +791,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 			if (mFetcher->mTextureCache->readComplete(mCacheReadHandle, false))
 			{
 				mCacheReadHandle = LLTextureCache::nullHandle();
-				mState = CACHE_POST;
+				setState(CACHE_POST);
 				// fall through
 			}
 			else
@@ -687,7 +814,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		{
 			// we have enough data, decode it
 			llassert_always(mFormattedImage->getDataSize() > 0);
-			mState = DECODE_IMAGE;
+			setState(DECODE_IMAGE);
 			// fall through
 		}
 		else
@@ -700,7 +827,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 			// need more data
 			else
 			{
-				mState = LOAD_FROM_NETWORK;	// CACHE_POST --> LOAD_FROM_NETWORK, or SEND_HTTP_REQ see below.
+				setState(LOAD_FROM_NETWORK);	// CACHE_POST --> LOAD_FROM_NETWORK, or SEND_HTTP_REQ see below.
 				// This is true because mSentRequest is set to UNSENT in INIT and if we get here we went through
 				// the states INIT --> LOAD_FROM_TEXTURE_CACHE --> CACHE_POST. Therefore either
 				// mFetcher->addToNetworkQueue(this) is called below, or mState is set to SEND_HTTP_REQ.
@@ -738,7 +865,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		}
 		if (!mUrl.empty())
 		{
-			mState = LLTextureFetchWorker::SEND_HTTP_REQ;
+			setState(LLTextureFetchWorker::SEND_HTTP_REQ);
 			setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
 			// don't return, fall through to next state
 		}
@@ -776,7 +903,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 				return true; // failed
 			}
 			setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
-			mState = DECODE_IMAGE;
+			setState(DECODE_IMAGE);
 		}
 		else
 		{
@@ -788,14 +915,13 @@ bool LLTextureFetchWorker::doWork(S32 param)
 	if (mState == SEND_HTTP_REQ)
 	{
 		{
-			const S32 HTTP_QUEUE_MAX_SIZE = 32;
 			// *TODO: Integrate this with llviewerthrottle
 			// Note: LLViewerThrottle uses dynamic throttling which makes sense for UDP,
 			// but probably not for Textures.
 			// Set the throttle to the entire bandwidth, assuming UDP packets will get priority
 			// when they are needed
 			F32 max_bandwidth = mFetcher->mMaxBandwidth;
-			if ((mFetcher->getNumHTTPRequests() >= HTTP_QUEUE_MAX_SIZE) ||
+			if ((mFetcher->getNumHTTPRequests() >= mFetcher->getMaxHTTPRequests()) ||
 				(mFetcher->getTextureBandwidth() > max_bandwidth))
 			{
 				// Make normal priority and return (i.e. wait until there is room in the queue)
@@ -812,6 +938,30 @@ bool LLTextureFetchWorker::doWork(S32 param)
 			mRequestedDiscard = mDesiredDiscard;
 			mRequestedSize -= cur_size;
 // 			F32 priority = mImagePriority / (F32)LLViewerImage::maxDecodePriority(); // 0-1
+
+			// If this texture's priority has climbed since we last asked for it,
+			// it will almost certainly want the next discard level too, so grow
+			// the range to cover it now rather than coming back with another
+			// small request. The extra data goes to the cache with the rest.
+			const F32 HTTP_PRIORITY_GROWTH = 1.5f;
+			if (mHTTPPriority > 0.f && mImagePriority > mHTTPPriority * HTTP_PRIORITY_GROWTH &&
+				mDesiredDiscard > 0 && !mHaveAllData &&
+				mFormattedImage.notNull() && mFormattedImage->getWidth() > 0)
+			{
+				S32 grow_discard = mDesiredDiscard - 1;
+				S32 grow_size = MAX_IMAGE_DATA_SIZE;
+				if (grow_discard > 0)
+				{
+					grow_size = LLImageJ2C::calcDataSizeJ2C(mFormattedImage->getWidth(), mFormattedImage->getHeight(),
+															mFormattedImage->getComponents(), grow_discard);
+				}
+				if (grow_size > mDesiredSize)
+				{
+					mRequestedSize = grow_size - cur_size;
+					mFetcher->mHTTPGrownRanges++;
+				}
+			}
+			mHTTPPriority = mImagePriority;
 			S32 offset = cur_size;
 			mBufferSize = cur_size; // This will get modified by callbackHttpGet()
 			
@@ -826,7 +976,8 @@ bool LLTextureFetchWorker::doWork(S32 param)
 						<< " Bandwidth(kbps): " << mFetcher->getTextureBandwidth() << "/" << max_bandwidth
 						<< llendl;
 				setPriority(LLWorkerThread::PRIORITY_LOW | mWorkPriority);
-				mState = WAIT_HTTP_REQ;	
+				setState(WAIT_HTTP_REQ);	
+				traceRequestIssued(SEND_HTTP_REQ);
 
 				mFetcher->addToHTTPQueue(mID);
 				// Will call callbackHttpGet when curl request completes
@@ -867,13 +1018,13 @@ bool LLTextureFetchWorker::doWork(S32 param)
 					}
 					else
 					{
-						mState = SEND_HTTP_REQ;
+						setState(SEND_HTTP_REQ);
 						return false; // retry
 					}
 				}
 				else
 				{
-					mState = DECODE_IMAGE;
+					setState(DECODE_IMAGE);
 					return false; // use what we have
 				}
 			}
@@ -907,7 +1058,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 			mBuffer = NULL;
 			mBufferSize = 0;
 			mLoadedDiscard = mRequestedDiscard;
-			mState = DECODE_IMAGE;
+			setState(DECODE_IMAGE);
 			setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
 			return false;
 		}
@@ -924,11 +1075,13 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		setPriority(LLWorkerThread::PRIORITY_LOW | mWorkPriority); // Set priority first since Responder may change it
 		mRawImage = NULL;
 		mAuxImage = NULL;
+		mCompressedImage = NULL;
 		llassert_always(mFormattedImage.notNull());
 		S32 discard = mHaveAllData ? 0 : mLoadedDiscard;
 		U32 image_priority = LLWorkerThread::PRIORITY_NORMAL | mWorkPriority;
 		mDecoded  = FALSE;
-		mState = DECODE_IMAGE_UPDATE;
+		setState(DECODE_IMAGE_UPDATE);
+		traceRequestIssued(DECODE_IMAGE);
 		mDecodeHandle = mFetcher->mImageDecodeThread->decodeImage(mFormattedImage, image_priority, discard, mNeedsAux,
 																  new DecodeResponder(mFetcher, mID, this));
 		// fall though
@@ -948,19 +1101,19 @@ bool LLTextureFetchWorker::doWork(S32 param)
 					mFormattedImage = NULL;
 					++mRetryAttempt;
 					setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
-					mState = INIT;
+					setState(INIT);
 					return false;
 				}
 				else
 				{
 // 					llwarns << "UNABLE TO LOAD TEXTURE: " << mID << " RETRIES: " << mRetryAttempt << llendl;
-					mState = DONE; // failed
+					setState(DONE); // failed
 				}
 			}
 			else
 			{
 				setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
-				mState = WRITE_TO_CACHE;
+				setState(COMPRESS_IMAGE);
 			}
 			// fall through
 		}
@@ -970,13 +1123,28 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		}
 	}
 
+	if (mState == COMPRESS_IMAGE)
+	{
+		if (mCompress && mRawImage.notNull() && mAuxImage.isNull())
+		{
+			compressImage();
+		}
+		setState(WRITE_TO_CACHE);
+		// fall through
+	}
+
 	if (mState == WRITE_TO_CACHE)
 	{
 		if (mInLocalCache || mSentRequest == UNSENT || mFormattedImage.isNull())
 		{
 			// If we're in a local cache or we didn't actually receive any new data,
 			// or we failed to load anything, skip
-			mState = DONE;
+			if (writeCompressed())
+			{
+				setState(WAIT_ON_WRITE);
+				return false;
+			}
+			setState(DONE);
 			return false;
 		}
 		S32 datasize = mFormattedImage->getDataSize();
@@ -984,7 +1152,8 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		setPriority(LLWorkerThread::PRIORITY_LOW | mWorkPriority); // Set priority first since Responder may change it
 		U32 cache_priority = mWorkPriority;
 		mWritten = FALSE;
-		mState = WAIT_ON_WRITE;
+		setState(WAIT_ON_WRITE);
+		traceRequestIssued(WRITE_TO_CACHE);
 		CacheWriteResponder* responder = new CacheWriteResponder(mFetcher, mID);
 		mCacheWriteHandle = mFetcher->mTextureCache->writeToCache(mID, cache_priority,
 																  mFormattedImage->getData(), datasize,
@@ -996,7 +1165,12 @@ bool LLTextureFetchWorker::doWork(S32 param)
 	{
 		if (writeToCacheComplete())
 		{
-			mState = DONE;
+			// the DXT copy goes after the J2C body so it always has an entry
+			if (writeCompressed())
+			{
+				return false;
+			}
+			setState(DONE);
 			// fall through
 		}
 		else
@@ -1017,7 +1191,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		if (mDecodedDiscard >= 0 && mDesiredDiscard < mDecodedDiscard)
 		{
 			// More data was requested, return to INIT
-			mState = INIT;
+			setState(INIT);
 			setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
 			return false;
 		}
@@ -1031,6 +1205,108 @@ bool LLTextureFetchWorker::doWork(S32 param)
 	return false;
 }
 
+// mWorkMutex is locked
+void LLTextureFetchWorker::traceAdvance(U64 now)
+{
+	if (mTraceMark && now > mTraceMark)
+	{
+		U64 elapsed = now - mTraceMark;
+		if (mInWork)
+		{
+			mStateWorkTime += elapsed;
+		}
+		else if (mRequestStartTime)
+		{
+			mStateRequestTime += elapsed;
+			mRequestPendingTime += elapsed;
+		}
+	}
+	mTraceMark = now;
+}
+
+// mWorkMutex is locked
+void LLTextureFetchWorker::setState(e_state state)
+{
+	LLTextureFetchTrace& trace = mFetcher->mTrace;
+	if (trace.isEnabled())
+	{
+		U64 now = LLTimer::getTotalTime();
+		traceAdvance(now);
+		if (mStateStartTime)
+		{
+			trace.record(mID, mTraceRequest, mState, sStateDescs[mState],
+						 mStateStartTime, now, mStateWorkTime, mStateRequestTime);
+		}
+		mStateStartTime = now;
+	}
+	else
+	{
+		mStateStartTime = 0;
+		mTraceMark = 0;
+		mRequestStartTime = 0;
+	}
+	mStateWorkTime = 0;
+	mStateRequestTime = 0;
+	mState = state;
+}
+
+// mWorkMutex is locked
+void LLTextureFetchWorker::traceRequestIssued(e_state state)
+{
+	if (mStateStartTime && mFetcher->mTrace.isEnabled())
+	{
+		U64 now = LLTimer::getTotalTime();
+		traceAdvance(now);
+		mRequestStartTime = now;
+		mRequestPendingTime = 0;
+		mRequestState = state;
+	}
+}
+
+// mWorkMutex is locked
+void LLTextureFetchWorker::traceRequestDone()
+{
+	if (!mRequestStartTime)
+	{
+		return;
+	}
+	LLTextureFetchTrace& trace = mFetcher->mTrace;
+	if (trace.isEnabled())
+	{
+		U64 now = LLTimer::getTotalTime();
+		traceAdvance(now);
+		trace.recordRequest(mID, mTraceRequest, mRequestState, sStateDescs[mRequestState],
+							mRequestStartTime, now, mRequestPendingTime);
+	}
+	mRequestStartTime = 0;
+}
+
+LLTextureFetchWorker::TraceWorkScope::TraceWorkScope(LLTextureFetchWorker* worker)
+	: mWorker(worker)
+{
+	if (mWorker->mFetcher->mTrace.isEnabled())
+	{
+		U64 now = LLTimer::getTotalTime();
+		if (!mWorker->mStateStartTime)
+		{
+			// Tracing was turned on while this request was in flight
+			mWorker->mStateStartTime = now;
+			mWorker->mTraceMark = now;
+		}
+		mWorker->traceAdvance(now);
+		mWorker->mInWork = TRUE;
+	}
+}
+
+LLTextureFetchWorker::TraceWorkScope::~TraceWorkScope()
+{
+	if (mWorker->mInWork)
+	{
+		mWorker->traceAdvance(LLTimer::getTotalTime());
+		mWorker->mInWork = FALSE;
+	}
+}
+
 // Called from MAIN thread
 void LLTextureFetchWorker::endWork(S32 param, bool aborted)
 {
@@ -1182,6 +1458,7 @@ void LLTextureFetchWorker::callbackHttpGet(const LLChannelDescriptors& channels,
 				<< " req=" << mSentRequest << " state= " << mState << llendl;
 		return;
 	}
+	traceRequestDone();
 	if (mLoaded)
 	{
 		llwarns << "Duplicate callback for " << mID.asString() << llendl;
@@ -1242,6 +1519,7 @@ void LLTextureFetchWorker::callbackCacheRead(bool success, LLImageFormatted* ima
 // 		llwarns << "Read callback for " << mID << " with state = " << mState << llendl;
 		return;
 	}
+	traceRequestDone();
 	if (success)
 	{
 		llassert_always(imagesize >= 0);
@@ -1258,6 +1536,22 @@ void LLTextureFetchWorker::callbackCacheRead(bool success, LLImageFormatted* ima
 	setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
 }
 
+void LLTextureFetchWorker::callbackCompressedRead(bool success, LLImageFormatted* image)
+{
+	LLMutexLock lock(&mWorkMutex);
+	if (mState != LOAD_COMPRESSED)
+	{
+		return;
+	}
+	traceRequestDone();
+	if (success)
+	{
+		mCompressedImage = (LLImageDXT*)image;
+	}
+	mLoaded = TRUE;
+	setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
+}
+
 void LLTextureFetchWorker::callbackCacheWrite(bool success)
 {
 	LLMutexLock lock(&mWorkMutex);
@@ -1266,12 +1560,100 @@ void LLTextureFetchWorker::callbackCacheWrite(bool success)
 // 		llwarns << "Write callback for " << mID << " with state = " << mState << llendl;
 		return;
 	}
+	traceRequestDone();
 	mWritten = TRUE;
 	setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
 }
 
 //////////////////////////////////////////////////////////////////////////////
 
+// Checks the DXT copy read in LOAD_COMPRESSED (now in mCompressedImage)
+// and keeps it when it covers the desired discard level.
+bool LLTextureFetchWorker::loadCompressed()
+{
+	LLPointer<LLImageDXT> dxt = mCompressedImage;
+	mCompressedImage = NULL;
+	if (dxt.isNull())
+	{
+		return false;
+	}
+
+	S32 size = dxt->getDataSize();
+	if (size <= (S32)sizeof(LLImageDXT::dxtfile_header_t) ||
+		!dxt->updateData() || !dxt->isCompressed() ||
+		dxt->calcDataSize(0) > size)
+	{
+		llwarns << "Removing bad compressed texture: " << mID << llendl;
+		mFetcher->mTextureCache->removeCompressedFromCache(mID);
+		return false;
+	}
+
+	mCompressedDiscard = dxt->getSourceDiscard();
+	if (mCompressedDiscard > mDesiredDiscard)
+	{
+		return false;
+	}
+	mCompressedImage = dxt;
+	mDecodedDiscard = mCompressedDiscard;
+	return true;
+}
+
+// Called on the fetch thread after a decode, so the S3TC encode never
+// touches the main thread.  The result rides along with the raw image and
+// is handed to the cache workers when it improves on the copy already
+// there (see writeCompressed()).
+void LLTextureFetchWorker::compressImage()
+{
+	S32 components = mRawImage->getComponents();
+	if (!LLImageGL::checkSize(mRawImage->getWidth(), mRawImage->getHeight()))
+	{
+		return;
+	}
+
+	bool alpha_mask = false;
+	if (components == 2 || components == 4)
+	{
+		alpha_mask = LLImageGL::checkAlphaMask(mRawImage->getData(), mRawImage->getWidth(),
+											   mRawImage->getHeight(), components) ? true : false;
+	}
+
+	LLPointer<LLImageDXT> dxt = new LLImageDXT;
+	if (!dxt->encodeCompressed(mRawImage, mDecodedDiscard, alpha_mask))
+	{
+		return;
+	}
+	mCompressedImage = dxt;
+
+	mWriteCompressed = (mCompressedDiscard < 0 || mDecodedDiscard < mCompressedDiscard) &&
+		!mInLocalCache && !mFetcher->mTextureCache->isReadOnly();
+}
+
+// Queues the DXT copy on the cache thread, reusing mCacheWriteHandle.
+// Returns true if a write is pending.
+bool LLTextureFetchWorker::writeCompressed()
+{
+	if (!mWriteCompressed || mCompressedImage.isNull())
+	{
+		mWriteCompressed = FALSE;
+		return false;
+	}
+	mWriteCompressed = FALSE;
+	mWritten = FALSE;
+	setPriority(LLWorkerThread::PRIORITY_LOW | mWorkPriority); // Set priority first since Responder may change it
+	traceRequestIssued(mState);
+	CacheWriteResponder* responder = new CacheWriteResponder(mFetcher, mID);
+	mCacheWriteHandle = mFetcher->mTextureCache->writeCompressedToCache(mID, mWorkPriority,
+																		mCompressedImage, responder);
+	if (mCacheWriteHandle == LLTextureCache::nullHandle())
+	{
+		return false;
+	}
+	mCompressedDiscard = mDecodedDiscard;
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
 void LLTextureFetchWorker::callbackDecoded(bool success, LLImageRaw* raw, LLImageRaw* aux)
 {
 	LLMutexLock lock(&mWorkMutex);
@@ -1286,6 +1668,7 @@ void LLTextureFetchWorker::callbackDecoded(bool success, LLImageRaw* raw, LLImag
 		return;
 	}
 	llassert_always(mFormattedImage.notNull());
+	traceRequestDone();
 	
 	mDecodeHandle = 0;
 	if (success)
@@ -1356,9 +1739,15 @@ LLTextureFetch::LLTextureFetch(LLTextureCache* cache, LLImageDecodeThread* image
 	  mTextureCache(cache),
 	  mImageDecodeThread(imagedecodethread),
 	  mTextureBandwidth(0),
-	  mCurlGetRequest(NULL)
+	  mCurlGetRequest(NULL),
+	  mHTTPWindow(1, 1),
+	  mHTTPGrownRanges(0)
 {
 	mMaxBandwidth = gSavedSettings.getF32("ThrottleBandwidthKBPS");
+	S32 min_requests = llmax(gSavedSettings.getS32("TextureFetchHTTPMinRequests"), 1);
+	mHTTPMaxRequestsLimit = llmax(gSavedSettings.getS32("TextureFetchHTTPMaxRequests"), min_requests);
+	mHTTPWindow.setLimits(min_requests, mHTTPMaxRequestsLimit);
+	mHTTPPipelining = gSavedSettings.getBOOL("TextureFetchHTTPPipelining");
 	mTextureInfo.setUpLogging(gSavedSettings.getBOOL("LogTextureDownloadsToViewerLog"), gSavedSettings.getBOOL("LogTextureDownloadsToSimulator"), gSavedSettings.getU32("TextureLoggingThreshold"));
 }
 
@@ -1368,7 +1757,7 @@ LLTextureFetch::~LLTextureFetch()
 }
 
 bool LLTextureFetch::createRequest(const std::string& url, const LLUUID& id, const LLHost& host, F32 priority,
-								   S32 w, S32 h, S32 c, S32 desired_discard, bool needs_aux)
+								   S32 w, S32 h, S32 c, S32 desired_discard, bool needs_aux, bool compress)
 {
 	if (mDebugPause)
 	{
@@ -1438,7 +1827,7 @@ bool LLTextureFetch::createRequest(const std::string& url, const LLUUID& id, con
 			{
 			  	removeFromNetworkQueue(worker, true);
 			}
-			worker->mState = LLTextureFetchWorker::INIT;
+			worker->setState(LLTextureFetchWorker::INIT);
 			worker->unlockWorkMutex();
 			worker->addWork(0, LLWorkerThread::PRIORITY_HIGH | worker->mWorkPriority);
 		}
@@ -1450,6 +1839,7 @@ bool LLTextureFetch::createRequest(const std::string& url, const LLUUID& id, con
 	}
 	worker->mActiveCount++;
 	worker->mNeedsAux = needs_aux;
+	worker->mCompress = compress;
 // 	llinfos << "REQUESTED: " << id << " Discard: " << desired_discard << llendl;
 	return true;
 }
@@ -1490,6 +1880,7 @@ void LLTextureFetch::addToHTTPQueue(const LLUUID& id)
 {
 	LLMutexLock lock(&mNetworkQueueMutex);
 	mHTTPTextureQueue.insert(id);
+	mHTTPWindow.requestStarted((S32)mHTTPTextureQueue.size());
 }
 
 void LLTextureFetch::removeFromHTTPQueue(const LLUUID& id)
@@ -1498,6 +1889,29 @@ void LLTextureFetch::removeFromHTTPQueue(const LLUUID& id)
 	mHTTPTextureQueue.erase(id);
 }
 
+// Called from HTTPGetResponder on the worker thread, before the request
+// leaves mHTTPTextureQueue
+void LLTextureFetch::recordHTTPResult(F32 seconds, S32 bytes, bool success)
+{
+	LLMutexLock lock(&mNetworkQueueMutex);
+	mHTTPWindow.requestFinished(seconds, bytes, success, (S32)mHTTPTextureQueue.size());
+}
+
+// Once a second, resize the HTTP request window (see LLHTTPWindow).
+void LLTextureFetch::updateHTTPConcurrency()
+{
+	const F32 HTTP_WINDOW_TIME = 1.f;
+
+	LLMutexLock lock(&mNetworkQueueMutex);
+	F32 elapsed = mHTTPWindowTimer.getElapsedTimeF32();
+	if (elapsed < HTTP_WINDOW_TIME)
+	{
+		return;
+	}
+	mHTTPWindowTimer.reset();
+	mHTTPWindow.update(elapsed, mMaxBandwidth, (S32)mHTTPTextureQueue.size());
+}
+
 // call lockQueue() first!
 void LLTextureFetch::removeRequest(LLTextureFetchWorker* worker, bool cancel)
 {
@@ -1523,7 +1937,8 @@ LLTextureFetchWorker* LLTextureFetch::getWorker(const LLUUID& id)
 
 
 bool LLTextureFetch::getRequestFinished(const LLUUID& id, S32& discard_level,
-										LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux)
+										LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux,
+										LLPointer<LLImageDXT>& compressed)
 {
 	bool res = false;
 	LLMutexLock lock(&mQueueMutex);
@@ -1548,6 +1963,7 @@ bool LLTextureFetch::getRequestFinished(const LLUUID& id, S32& discard_level,
 			discard_level = worker->mDecodedDiscard;
 			raw = worker->mRawImage; worker->mRawImage = NULL;
 			aux = worker->mAuxImage; worker->mAuxImage = NULL;
+			compressed = worker->mCompressedImage; worker->mCompressedImage = NULL;
 			res = true;
 		}
 		else
@@ -1561,6 +1977,7 @@ bool LLTextureFetch::getRequestFinished(const LLUUID& id, S32& discard_level,
 				discard_level = worker->mDecodedDiscard;
 				if (worker->mRawImage) raw = worker->mRawImage;
 				if (worker->mAuxImage) aux = worker->mAuxImage;
+				if (worker->mCompressedImage) compressed = worker->mCompressedImage;
 			}
 			worker->unlockWorkMutex();
 		}
@@ -1596,6 +2013,11 @@ S32 LLTextureFetch::update(U32 max_time_ms)
 	S32 res;
 	
 	mMaxBandwidth = gSavedSettings.getF32("ThrottleBandwidthKBPS");
+	mTrace.setEnabled(gSavedSettings.getBOOL("TextureFetchTrace"));
+	if (mTrace.isEnabled())
+	{
+		mTrace.setCapacity(gSavedSettings.getU32("TextureFetchTraceSize"));
+	}
 	
 	res = LLWorkerThread::update(max_time_ms);
 	
@@ -1612,6 +2034,9 @@ void LLTextureFetch::startThread()
 {
 	// Construct mCurlGetRequest from Worker Thread
 	mCurlGetRequest = new LLCurlRequest();
+	// Pool a handle (and its keep-alive connection) for every request we
+	// may have in flight, so the texture host is not reconnected to per request
+	mCurlGetRequest->setConnectionLimits(mHTTPMaxRequestsLimit, mHTTPPipelining);
 }
 
 // WORKER THREAD
@@ -1642,6 +2067,7 @@ void LLTextureFetch::threadedUpdate()
 	{
 		lldebugs << "processed: " << processed << " messages." << llendl;
 	}
+	updateHTTPConcurrency();
 
 #if 0
 	const F32 INFO_TIME = 1.0f; 
@@ -1945,7 +2371,7 @@ bool LLTextureFetch::receiveImageHeader(const LLHost& host, const LLUUID& id, U8
 		llassert_always(data_size == FIRST_PACKET_SIZE || data_size == worker->mFileSize);
 		res = worker->insertPacket(0, data, data_size);
 		worker->setPriority(LLWorkerThread::PRIORITY_HIGH | worker->mWorkPriority);
-		worker->mState = LLTextureFetchWorker::LOAD_FROM_SIMULATOR;
+		worker->setState(LLTextureFetchWorker::LOAD_FROM_SIMULATOR);
 	}
 	worker->unlockWorkMutex();
 	return res;
@@ -1990,7 +2416,7 @@ bool LLTextureFetch::receiveImagePacket(const LLHost& host, const LLUUID& id, U1
 		(worker->mState == LLTextureFetchWorker::LOAD_FROM_NETWORK))
 	{
 		worker->setPriority(LLWorkerThread::PRIORITY_HIGH | worker->mWorkPriority);
-		worker->mState = LLTextureFetchWorker::LOAD_FROM_SIMULATOR;
+		worker->setState(LLTextureFetchWorker::LOAD_FROM_SIMULATOR);
 	}
 	else
 	{
@@ -34,10 +34,14 @@
 #define LL_LLTEXTUREFETCH_H
 
 #include "lldir.h"
+#include "llframetimer.h"
 #include "llimage.h"
+#include "llimagedxt.h"
 #include "lluuid.h"
 #include "llworkerthread.h"
 #include "llcurl.h"
+#include "llhttpwindow.h"
+#include "lltexturefetchtrace.h"
 #include "lltextureinfo.h"
 
 class LLViewerImage;
@@ -60,10 +64,13 @@ public:
 	/*virtual*/ S32 update(U32 max_time_ms);	
 
 	bool createRequest(const std::string& url, const LLUUID& id, const LLHost& host, F32 priority,
-					   S32 w, S32 h, S32 c, S32 discard, bool needs_aux);
+					   S32 w, S32 h, S32 c, S32 discard, bool needs_aux, bool compress = false);
 	void deleteRequest(const LLUUID& id, bool cancel);
+	// compressed is set when the request was made with compress and the
+	// image could be S3TC encoded; raw is NULL when it came from the DXT cache
 	bool getRequestFinished(const LLUUID& id, S32& discard_level,
-							LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux);
+							LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux,
+							LLPointer<LLImageDXT>& compressed);
 	bool updateRequestPriority(const LLUUID& id, F32 priority);
 
 	bool receiveImageHeader(const LLHost& host, const LLUUID& id, U8 codec, U16 packets, U32 totalbytes, U16 data_size, U8* data);
@@ -78,6 +85,10 @@ public:
 	void dump();
 	S32 getNumRequests() const { LLMutexLock lock(&mQueueMutex); return mRequestMap.size(); }
 	S32 getNumHTTPRequests() const { LLMutexLock lock(&mNetworkQueueMutex); return mHTTPTextureQueue.size(); }
+	S32 getMaxHTTPRequests() const { LLMutexLock lock(&mNetworkQueueMutex); return mHTTPWindow.getMaxRequests(); }
+	F32 getHTTPLatency() const { LLMutexLock lock(&mNetworkQueueMutex); return mHTTPWindow.getLatency(); }
+	F32 getHTTPThroughput() const { LLMutexLock lock(&mNetworkQueueMutex); return mHTTPWindow.getThroughput(); }
+	S32 getHTTPGrownRanges() { return mHTTPGrownRanges; }
 	
 	// Public for access by callbacks
 	void lockQueue() { mQueueMutex.lock(); }
@@ -85,12 +96,15 @@ public:
 	LLTextureFetchWorker* getWorker(const LLUUID& id);
 
 	LLTextureInfo* getTextureInfo() { return &mTextureInfo; }
+	LLTextureFetchTrace* getTrace() { return &mTrace; }
 	
 protected:
 	void addToNetworkQueue(LLTextureFetchWorker* worker);
 	void removeFromNetworkQueue(LLTextureFetchWorker* worker, bool cancel);
 	void addToHTTPQueue(const LLUUID& id);
 	void removeFromHTTPQueue(const LLUUID& id);
+	void recordHTTPResult(F32 seconds, S32 bytes, bool success);
+	void updateHTTPConcurrency();
 	void removeRequest(LLTextureFetchWorker* worker, bool cancel);
 	// Called from worker thread (during doWork)
 	void processCurlRequests();	
@@ -128,7 +142,15 @@ private:
 	cancel_queue_t mCancelQueue;
 	F32 mTextureBandwidth;
 	F32 mMaxBandwidth;
+
+	// Adaptive HTTP concurrency, protected by mNetworkQueueMutex
+	LLHTTPWindow mHTTPWindow;
+	S32 mHTTPMaxRequestsLimit;
+	bool mHTTPPipelining;
+	LLFrameTimer mHTTPWindowTimer;
+	LLAtomicS32 mHTTPGrownRanges;
 	LLTextureInfo mTextureInfo;
+	LLTextureFetchTrace mTrace;
 };
 
 #endif // LL_LLTEXTUREFETCH_H
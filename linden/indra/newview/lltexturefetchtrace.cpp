@@ -0,0 +1,262 @@
+/** 
+ * @file lltexturefetchtrace.cpp
+ * @brief Ring buffer of texture fetch state transitions
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "lltexturefetchtrace.h"
+
+#include "llfile.h"
+#include "lltimer.h"
+#include <map>
+
+const U32 DEFAULT_TRACE_CAPACITY = 16384;
+
+LLTextureFetchTrace::LLTextureFetchTrace()
+	: mMutex(NULL),
+	  mCapacity(DEFAULT_TRACE_CAPACITY),
+	  mNext(0),
+	  mNextRequest(0),
+	  mStartTime(LLTimer::getTotalTime()),
+	  mEnabled(0)
+{
+}
+
+void LLTextureFetchTrace::setCapacity(U32 capacity)
+{
+	LLMutexLock lock(&mMutex);
+	capacity = llmax(capacity, (U32)64);
+	if (capacity != mCapacity)
+	{
+		mCapacity = capacity;
+		mEvents.clear();
+		mNext = 0;
+	}
+}
+
+void LLTextureFetchTrace::clear()
+{
+	LLMutexLock lock(&mMutex);
+	mEvents.clear();
+	mNext = 0;
+	mStats.clear();
+	mStartTime = LLTimer::getTotalTime();
+}
+
+U32 LLTextureFetchTrace::newRequestId()
+{
+	LLMutexLock lock(&mMutex);
+	return ++mNextRequest;
+}
+
+// mMutex is locked
+void LLTextureFetchTrace::addEvent(const Event& event)
+{
+	if (mEvents.size() < mCapacity)
+	{
+		mEvents.push_back(event);
+	}
+	else
+	{
+		mEvents[mNext] = event;
+	}
+	mNext = (mNext + 1) % mCapacity;
+
+	if (event.mState >= (S32)mStats.size())
+	{
+		mStats.resize(event.mState + 1);
+	}
+	mStats[event.mState].mName = event.mName;
+}
+
+void LLTextureFetchTrace::record(const LLUUID& id, U32 request, S32 state, const char* name,
+								 U64 start, U64 end, U64 work, U64 service)
+{
+	if (state < 0 || end < start)
+	{
+		return;
+	}
+	U64 duration = end - start;
+	work = llmin(work, duration);
+	service = llmin(service, duration - work);
+
+	Event event;
+	event.mID = id;
+	event.mRequest = request;
+	event.mState = state;
+	event.mName = name;
+	event.mIsRequest = false;
+	event.mStart = start;
+	event.mDuration = duration;
+	event.mWork = work;
+	event.mService = service;
+
+	LLMutexLock lock(&mMutex);
+	addEvent(event);
+	StateStats& stats = mStats[state];
+	stats.mCount++;
+	stats.mWork += work;
+	stats.mWait += duration - work - service;
+}
+
+void LLTextureFetchTrace::recordRequest(const LLUUID& id, U32 request, S32 state, const char* name,
+										U64 start, U64 end, U64 pending)
+{
+	if (state < 0 || end < start)
+	{
+		return;
+	}
+	U64 duration = end - start;
+
+	Event event;
+	event.mID = id;
+	event.mRequest = request;
+	event.mState = state;
+	event.mName = name;
+	event.mIsRequest = true;
+	event.mStart = start;
+	event.mDuration = duration;
+	event.mWork = 0;
+	event.mService = llmin(pending, duration);
+
+	LLMutexLock lock(&mMutex);
+	addEvent(event);
+	StateStats& stats = mStats[state];
+	stats.mRequests++;
+	stats.mService += event.mService;
+}
+
+bool LLTextureFetchTrace::exportChromeTrace(const std::string& filename)
+{
+	// Copy under the lock, the fetch thread records while we write
+	std::vector<Event> events;
+	std::vector<StateStats> stats_list;
+	U64 start_time;
+	{
+		LLMutexLock lock(&mMutex);
+		// Oldest first: once the buffer has wrapped that is the one at mNext
+		U32 count = mEvents.size();
+		U32 first = count < mCapacity ? 0 : mNext;
+		events.reserve(count);
+		for (U32 i = 0; i < count; ++i)
+		{
+			events.push_back(mEvents[(first + i) % count]);
+		}
+		stats_list = mStats;
+		start_time = mStartTime;
+	}
+
+	llofstream out(filename);
+	if (!out.is_open())
+	{
+		llwarns << "Unable to write texture fetch trace to " << filename << llendl;
+		return false;
+	}
+
+	std::map<U32, LLUUID> rows;
+	out << "{\"traceEvents\":[\n";
+	bool comma = false;
+	for (std::vector<Event>::const_iterator iter = events.begin(); iter != events.end(); ++iter)
+	{
+		const Event& event = *iter;
+		rows[event.mRequest] = event.mID;
+		S64 ts = (S64)event.mStart - (S64)start_time;
+		out << (comma ? ",\n" : "")
+			<< "{\"name\":\"" << event.mName << (event.mIsRequest ? " request" : "") << "\""
+			<< ",\"cat\":\"" << (event.mIsRequest ? "texture_request" : "texture") << "\",\"ph\":\"X\""
+			<< ",\"ts\":" << ts << ",\"dur\":" << event.mDuration
+			<< ",\"pid\":1,\"tid\":" << event.mRequest
+			<< ",\"args\":{\"id\":\"" << event.mID << "\"";
+		if (event.mIsRequest)
+		{
+			out << ",\"pending_us\":" << event.mService << "}}";
+		}
+		else
+		{
+			out << ",\"work_us\":" << event.mWork
+				<< ",\"request_us\":" << event.mService
+				<< ",\"wait_us\":" << (event.mDuration - event.mWork - event.mService) << "}}";
+		}
+		comma = true;
+	}
+	// One row per request, labelled with the texture it fetched
+	for (std::map<U32, LLUUID>::iterator iter = rows.begin(); iter != rows.end(); ++iter)
+	{
+		out << (comma ? ",\n" : "")
+			<< "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << iter->first
+			<< ",\"args\":{\"name\":\"" << iter->second << "\"}}";
+		comma = true;
+	}
+	out << "\n],\n\"displayTimeUnit\":\"ms\",\n\"otherData\":{";
+	comma = false;
+	for (U32 state = 0; state < stats_list.size(); ++state)
+	{
+		const StateStats& stats = stats_list[state];
+		if (!stats.mCount && !stats.mRequests)
+		{
+			continue;
+		}
+		out << (comma ? ",\n" : "\n")
+			<< "\"" << stats.mName << "\":\"count " << stats.mCount
+			<< " wait_ms " << (U64)(stats.mWait / 1000)
+			<< " work_ms " << (U64)(stats.mWork / 1000)
+			<< " requests " << stats.mRequests
+			<< " request_ms " << (U64)(stats.mService / 1000) << "\"";
+		comma = true;
+	}
+	out << "\n}}\n";
+	out.close();
+
+	llinfos << "Wrote " << events.size() << " texture fetch trace events to " << filename << llendl;
+	return true;
+}
+
+void LLTextureFetchTrace::dumpStats()
+{
+	LLMutexLock lock(&mMutex);
+	llinfos << "Texture fetch time by state (count, total wait ms, total work ms, avg wait ms, avg work ms,"
+			<< " requests issued, total request ms):" << llendl;
+	for (U32 state = 0; state < mStats.size(); ++state)
+	{
+		const StateStats& stats = mStats[state];
+		if (!stats.mCount && !stats.mRequests)
+		{
+			continue;
+		}
+		U32 count = llmax(stats.mCount, (U32)1);
+		F64 wait_ms = (F64)stats.mWait / 1000.0;
+		F64 work_ms = (F64)stats.mWork / 1000.0;
+		F64 service_ms = (F64)stats.mService / 1000.0;
+		llinfos << llformat(" %-24s %6u %10.1f %10.1f %8.2f %8.2f %6u %10.1f", stats.mName, stats.mCount,
+							wait_ms, work_ms, wait_ms / count, work_ms / count,
+							stats.mRequests, service_ms) << llendl;
+	}
+}
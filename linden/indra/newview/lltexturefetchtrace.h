@@ -0,0 +1,115 @@
+/** 
+ * @file lltexturefetchtrace.h
+ * @brief Ring buffer of texture fetch state transitions
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXTUREFETCHTRACE_H
+#define LL_LLTEXTUREFETCHTRACE_H
+
+#include "llapr.h"
+#include "llthread.h"
+#include "lluuid.h"
+#include <vector>
+
+// Records how long each texture fetch request spends in each state of the
+// LLTextureFetchWorker state machine, split into time spent working
+// (inside doWork()), time spent on a cache, HTTP or decode request the
+// state issued, and time spent waiting to be worked on.  Request time is
+// counted against the state that issued the request, even when the worker
+// has moved on to the state that waits for it.
+// Called from the texture fetch thread and its callbacks, so all access
+// goes through mMutex.
+class LLTextureFetchTrace
+{
+public:
+	LLTextureFetchTrace();
+
+	void setEnabled(bool enabled) { mEnabled = enabled ? 1 : 0; }
+	bool isEnabled() { return mEnabled != 0; }
+	// Number of intervals kept; the oldest are overwritten first.
+	void setCapacity(U32 capacity);
+	void clear();
+
+	// Returns an id for a new fetch request, used as its trace row.
+	U32 newRequestId();
+	// Records an interval of request spent in state, from start to end
+	// (LLTimer::getTotalTime() usecs), work usecs of which were spent
+	// inside doWork() and service usecs waiting on an issued request.
+	void record(const LLUUID& id, U32 request, S32 state, const char* name,
+				U64 start, U64 end, U64 work, U64 service);
+	// Records a cache, HTTP or decode request issued by state, from start
+	// to end, pending usecs of which the worker wasn't in doWork().
+	void recordRequest(const LLUUID& id, U32 request, S32 state, const char* name,
+					   U64 start, U64 end, U64 pending);
+
+	// Writes the buffered intervals as Chrome trace event JSON
+	// (chrome://tracing, about:tracing), with the per state totals in
+	// "otherData".
+	bool exportChromeTrace(const std::string& filename);
+	// Logs the per state totals since the last clear().
+	void dumpStats();
+
+private:
+	struct Event
+	{
+		LLUUID mID;
+		U32 mRequest;
+		S32 mState;
+		const char* mName;
+		bool mIsRequest;	// an issued request rather than a state interval
+		U64 mStart;
+		U64 mDuration;
+		U64 mWork;
+		U64 mService;
+	};
+	struct StateStats
+	{
+		StateStats() : mName(NULL), mCount(0), mRequests(0), mWait(0), mWork(0), mService(0) {}
+		const char* mName;
+		U32 mCount;
+		U32 mRequests;
+		U64 mWait;
+		U64 mWork;
+		U64 mService;
+	};
+
+	void addEvent(const Event& event);
+
+	LLMutex mMutex;
+	std::vector<Event> mEvents;
+	U32 mCapacity;
+	U32 mNext;
+	std::vector<StateStats> mStats;
+	U32 mNextRequest;
+	U64 mStartTime;
+	LLAtomicU32 mEnabled;	// read by the fetch thread without mMutex
+};
+
+#endif // LL_LLTEXTUREFETCHTRACE_H
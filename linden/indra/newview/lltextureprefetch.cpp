@@ -0,0 +1,331 @@
+/** 
+ * @file lltextureprefetch.cpp
+ * @brief Boosts textures of objects the camera is about to see.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "lltextureprefetch.h"
+
+#include <algorithm>
+#include <set>
+
+#include "llimagej2c.h"
+
+#include "llagent.h"
+#include "lldrawable.h"
+#include "llface.h"
+#include "llviewercamera.h"
+#include "llviewercontrol.h"
+#include "llviewerimage.h"
+#include "llviewerobject.h"
+#include "llviewerobjectlist.h"
+#include "llviewerregion.h"
+#include "llvlcomposition.h"
+#include "llworld.h"
+
+// How often the prediction is redone (seconds)
+const F32 PREFETCH_UPDATE_INTERVAL = 0.5f;
+// Points along the predicted path that are tested, as fractions of TexturePrefetchTime
+const F32 PREFETCH_STEPS[] = { 0.25f, 0.5f, 1.f };
+const S32 PREFETCH_STEP_COUNT = LL_ARRAY_SIZE(PREFETCH_STEPS);
+// We do not predict rotation, so widen the frustum by this much per meter of distance
+const F32 PREFETCH_ANGLE_PAD = 0.2f;
+// Predicted areas count for less than what is actually on screen
+const F32 PREFETCH_AREA_SCALE = 0.5f;
+// Below this the camera is considered at rest and nothing is predicted (m/s)
+const F32 PREFETCH_MIN_SPEED = 0.5f;
+const F32 CAMERA_VELOCITY_SMOOTHING = 0.3f;
+// Faster than this is a teleport or camera jump, not motion (m/s)
+const F32 CAMERA_MAX_SPEED = 200.f;
+const S32 MAX_TIME_TO_FULL_RES_SAMPLES = 16384;
+
+LLTexturePrefetch::LLTexturePrefetch()
+	: mHaveLastOrigin(false),
+	  mNumBoosted(0)
+{
+}
+
+void LLTexturePrefetch::updateVelocity()
+{
+	F32 dt = mUpdateTimer.getElapsedTimeF32();
+	LLVector3 origin = LLViewerCamera::getInstance()->getOrigin();
+	if (mHaveLastOrigin && dt > 0.f)
+	{
+		LLVector3 velocity = (origin - mLastCameraOrigin) / dt;
+		if (velocity.magVecSquared() > CAMERA_MAX_SPEED * CAMERA_MAX_SPEED)
+		{
+			mCameraVelocity.clearVec();
+		}
+		else
+		{
+			mCameraVelocity += (velocity - mCameraVelocity) * CAMERA_VELOCITY_SMOOTHING;
+		}
+	}
+	mLastCameraOrigin = origin;
+	mHaveLastOrigin = true;
+}
+
+void LLTexturePrefetch::update()
+{
+	if (mUpdateTimer.getElapsedTimeF32() < PREFETCH_UPDATE_INTERVAL)
+	{
+		return;
+	}
+	updateVelocity();
+	mUpdateTimer.reset();
+	mNumBoosted = 0;
+
+	if (!gSavedSettings.getBOOL("TexturePrefetch"))
+	{
+		return;
+	}
+
+	F32 horizon = gSavedSettings.getF32("TexturePrefetchTime");
+	if (horizon <= 0.f)
+	{
+		return;
+	}
+
+	prefetchRegionAhead(horizon);
+
+	mCandidates.clear();
+	S32 count = gObjectList.getNumObjects();
+	for (S32 i = 0; i < count; i++)
+	{
+		LLViewerObject* objectp = gObjectList.getObject(i);
+		if (objectp)
+		{
+			gatherObject(objectp, horizon);
+		}
+	}
+	if (mCandidates.empty())
+	{
+		return;
+	}
+
+	// Spend the budget on whatever becomes visible soonest.  There is no
+	// point in asking for more than can arrive before we get there.
+	F32 bytes_per_sec = gSavedSettings.getF32("ThrottleBandwidthKBPS") * 1024.f / 8.f;
+	F32 budget = bytes_per_sec * gSavedSettings.getF32("TexturePrefetchBandwidthFraction") * horizon;
+
+	std::sort(mCandidates.begin(), mCandidates.end());
+	std::set<LLViewerImage*> boosted;
+	for (std::vector<Candidate>::iterator iter = mCandidates.begin();
+		 iter != mCandidates.end() && budget > 0.f; ++iter)
+	{
+		LLViewerImage* imagep = iter->mImage;
+		if (!boosted.insert(imagep).second)
+		{
+			continue;
+		}
+		budget -= (F32)estimateBytes(imagep, iter->mPixelArea);
+		imagep->addTextureStats(iter->mPixelArea * PREFETCH_AREA_SCALE);
+		// only credit the prefetch for loads that finish before the texture is seen
+		imagep->mPrefetched |= !imagep->mOnScreen;
+		mNumBoosted++;
+	}
+}
+
+void LLTexturePrefetch::gatherObject(LLViewerObject* objectp, F32 horizon)
+{
+	if (objectp->isDead() || objectp->getPCode() != LL_PCODE_VOLUME || objectp->isAttachment())
+	{
+		return;
+	}
+	LLDrawable* drawablep = objectp->mDrawable;
+	if (!drawablep || drawablep->isRecentlyVisible() || !drawablep->getNumFaces())
+	{
+		// on screen objects are already handled by the normal stats
+		return;
+	}
+
+	const LLVector3& object_velocity = objectp->getVelocity();
+	if (mCameraVelocity.magVecSquared() < PREFETCH_MIN_SPEED * PREFETCH_MIN_SPEED &&
+		object_velocity.magVecSquared() < PREFETCH_MIN_SPEED * PREFETCH_MIN_SPEED)
+	{
+		// neither is moving, nothing new will come into view
+		return;
+	}
+
+	LLViewerCamera* camera = LLViewerCamera::getInstance();
+	F32 radius = objectp->getVObjRadius();
+	for (S32 step = 0; step < PREFETCH_STEP_COUNT; step++)
+	{
+		// Moving the object by -camera_motion is the same as moving the
+		// camera, and keeps us from having to rebuild the frustum planes
+		F32 t = horizon * PREFETCH_STEPS[step];
+		LLVector3 center = objectp->getPositionAgent() + (object_velocity - mCameraVelocity) * t;
+		F32 dist = (center - camera->getOrigin()).magVec();
+		if (!camera->sphereInFrustum(center, radius + dist * PREFETCH_ANGLE_PAD))
+		{
+			continue;
+		}
+
+		F32 height = camera->heightInPixels(center, radius);
+		F32 pixel_area = height * height;
+		if (pixel_area < 1.f)
+		{
+			return;
+		}
+
+		Candidate candidate;
+		candidate.mPixelArea = pixel_area;
+		candidate.mTime = t;
+		for (S32 i = 0; i < drawablep->getNumFaces(); i++)
+		{
+			LLFace* facep = drawablep->getFace(i);
+			candidate.mImage = facep ? facep->getTexture() : NULL;
+			if (candidate.mImage && candidate.mImage->getBoostLevel() < LLViewerImageBoostLevel::BOOST_HIGH)
+			{
+				mCandidates.push_back(candidate);
+			}
+		}
+		return;
+	}
+}
+
+// Terrain textures of the region the agent is heading into; its objects
+// are picked up by the frustum test above if the neighbor has sent them.
+void LLTexturePrefetch::prefetchRegionAhead(F32 horizon)
+{
+	LLViewerRegion* regionp = gAgent.getRegion();
+	if (!regionp)
+	{
+		return;
+	}
+	LLVector3d ahead = gAgent.getPositionGlobal() + LLVector3d(gAgent.getVelocity() * horizon);
+	LLViewerRegion* next_regionp = LLWorld::getInstance()->getRegionFromPosGlobal(ahead);
+	if (!next_regionp || next_regionp == regionp || !next_regionp->getComposition())
+	{
+		return;
+	}
+	for (S32 i = 0; i < LLVLComposition::CORNER_COUNT; i++)
+	{
+		LLViewerImage* imagep = next_regionp->getComposition()->getDetailTexture(i);
+		if (imagep)
+		{
+			imagep->addTextureStats(1024.f * 1024.f); // same as LLDrawPoolTerrain
+			imagep->mPrefetched |= !imagep->mOnScreen;
+			mNumBoosted++;
+		}
+	}
+}
+
+// Bytes still needed to show imagep at pixel_area, assuming a square image
+//static
+S32 LLTexturePrefetch::estimateBytes(LLViewerImage* imagep, F32 pixel_area)
+{
+	const S32 MIN_SIDE = 32;
+	const S32 MAX_SIDE = 1024;
+	S32 side = MIN_SIDE;
+	while ((F32)(side * side) < pixel_area && side < MAX_SIDE)
+	{
+		side <<= 1;
+	}
+	S32 full_side = llmax(imagep->mFullWidth, imagep->mFullHeight);
+	if (full_side > 0)
+	{
+		side = llmin(side, full_side);
+	}
+
+	S32 have = 0;
+	S32 discard = imagep->getDiscardLevel();
+	if (discard >= 0 && full_side > 0)
+	{
+		S32 cur_side = full_side >> discard;
+		if (cur_side >= side)
+		{
+			return 0;
+		}
+		have = LLImageJ2C::calcDataSizeJ2C(cur_side, cur_side, 4, 0);
+	}
+	return llmax(LLImageJ2C::calcDataSizeJ2C(side, side, 4, 0) - have, 0);
+}
+
+void LLTexturePrefetch::recordTimeToFullRes(F32 seconds, bool prefetched)
+{
+	std::vector<F32>& samples = prefetched ? mPrefetchedSamples : mSamples;
+	if ((S32)samples.size() < MAX_TIME_TO_FULL_RES_SAMPLES)
+	{
+		samples.push_back(seconds);
+	}
+}
+
+void LLTexturePrefetch::resetStats()
+{
+	mSamples.clear();
+	mPrefetchedSamples.clear();
+}
+
+F32 LLTexturePrefetch::getMeanTimeToFullRes() const
+{
+	S32 count = mSamples.size() + mPrefetchedSamples.size();
+	if (!count)
+	{
+		return 0.f;
+	}
+	F32 total = 0.f;
+	for (U32 i = 0; i < mSamples.size(); i++)
+	{
+		total += mSamples[i];
+	}
+	for (U32 i = 0; i < mPrefetchedSamples.size(); i++)
+	{
+		total += mPrefetchedSamples[i];
+	}
+	return total / (F32)count;
+}
+
+static void dump_samples(const char* label, std::vector<F32> samples)
+{
+	if (samples.empty())
+	{
+		llinfos << "Time to full res, " << label << ": no samples" << llendl;
+		return;
+	}
+	std::sort(samples.begin(), samples.end());
+	F32 total = 0.f;
+	for (U32 i = 0; i < samples.size(); i++)
+	{
+		total += samples[i];
+	}
+	llinfos << "Time to full res, " << label << ": " << samples.size() << " textures"
+			<< " mean " << total / (F32)samples.size()
+			<< " median " << samples[samples.size() / 2]
+			<< " 90% " << samples[(samples.size() * 9) / 10]
+			<< " max " << samples.back() << llendl;
+}
+
+void LLTexturePrefetch::dumpStats()
+{
+	dump_samples("prefetched", mPrefetchedSamples);
+	dump_samples("not prefetched", mSamples);
+}
@@ -0,0 +1,103 @@
+/** 
+ * @file lltextureprefetch.h
+ * @brief Boosts textures of objects the camera is about to see.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXTUREPREFETCH_H
+#define LL_LLTEXTUREPREFETCH_H
+
+#include "llframetimer.h"
+#include "llmemory.h"
+#include "v3math.h"
+#include <vector>
+
+class LLViewerImage;
+class LLViewerObject;
+
+// Textures normally start loading only once the faces using them are on
+// screen.  LLTexturePrefetch projects the camera and agent a few seconds
+// ahead along their current velocity and feeds the textures of objects
+// that will come into view (and the terrain of a region we are about to
+// cross into) into the normal texture stats, so the fetcher sees them
+// early.  Boosts are granted soonest-first until a slice of the texture
+// bandwidth is used up.
+//
+// It also measures time-to-full-res: the time from a texture's first
+// face becoming visible to the texture reaching its desired discard level.
+// The numbers are reset and logged around LLAgentPilot playback so
+// recorded flight paths can be compared with prefetch on and off.
+
+class LLTexturePrefetch : public LLSingleton<LLTexturePrefetch>
+{
+public:
+	LLTexturePrefetch();
+
+	// Main thread, once per frame before the image list updates priorities
+	void update();
+
+	// Time-to-full-res
+	void recordTimeToFullRes(F32 seconds, bool prefetched);
+	void resetStats();
+	void dumpStats();
+
+	S32 getNumBoosted() const				{ return mNumBoosted; }
+	F32 getMeanTimeToFullRes() const;
+
+private:
+	struct Candidate
+	{
+		LLViewerImage*	mImage;
+		F32				mPixelArea;
+		F32				mTime;		// seconds ahead it is predicted to become visible
+
+		bool operator<(const Candidate& rhs) const
+		{
+			return mTime < rhs.mTime || (mTime == rhs.mTime && mPixelArea > rhs.mPixelArea);
+		}
+	};
+
+	void updateVelocity();
+	void gatherObject(LLViewerObject* objectp, F32 horizon);
+	void prefetchRegionAhead(F32 horizon);
+	static S32 estimateBytes(LLViewerImage* imagep, F32 pixel_area);
+
+	LLFrameTimer mUpdateTimer;
+	LLVector3 mLastCameraOrigin;
+	LLVector3 mCameraVelocity;
+	bool mHaveLastOrigin;
+
+	std::vector<Candidate> mCandidates;
+	S32 mNumBoosted;
+
+	std::vector<F32> mSamples;
+	std::vector<F32> mPrefetchedSamples;
+};
+
+#endif // LL_LLTEXTUREPREFETCH_H
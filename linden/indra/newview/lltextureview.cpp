@@ -47,8 +47,11 @@
 #include "llhoverview.h"
 #include "llselectmgr.h"
 #include "lltexlayer.h"
+#include "lltexturebudget.h"
 #include "lltexturecache.h"
 #include "lltexturefetch.h"
+#include "lltextureprefetch.h"
+#include "lltextureuploader.h"
 #include "llviewercontrol.h"
 #include "llviewerobject.h"
 #include "llviewerimage.h"
@@ -218,6 +221,7 @@ void LLTextureBar::draw()
 	struct { const std::string desc; LLColor4 color; } fetch_state_desc[] = {
 		{ "---", LLColor4::red },	// INVALID
 		{ "INI", LLColor4::white },	// INIT
+		{ "DXT", LLColor4::blue },	// LOAD_COMPRESSED
 		{ "DSK", LLColor4::cyan },	// LOAD_FROM_TEXTURE_CACHE
 		{ "DSK", LLColor4::blue },	// CACHE_POST
 		{ "NET", LLColor4::green },	// LOAD_FROM_NETWORK
@@ -226,10 +230,11 @@ void LLTextureBar::draw()
 		{ "HTP", LLColor4::green },	// WAIT_HTTP_REQ
 		{ "DEC", LLColor4::yellow },// DECODE_IMAGE
 		{ "DEC", LLColor4::green }, // DECODE_IMAGE_UPDATE
+		{ "DXT", LLColor4::cyan },  // COMPRESS_IMAGE
 		{ "WRT", LLColor4::purple },// WRITE_TO_CACHE
 		{ "WRT", LLColor4::orange },// WAIT_ON_WRITE
 		{ "END", LLColor4::red },   // DONE
-#define LAST_STATE 12
+#define LAST_STATE 14
 		{ "CRE", LLColor4::magenta }, // LAST_STATE+1
 		{ "FUL", LLColor4::green }, // LAST_STATE+2
 		{ "BAD", LLColor4::red }, // LAST_STATE+3
@@ -373,7 +378,7 @@ public:
 		  mTextureView(texview)
 	{
 		S32 line_height = (S32)(LLFontGL::getFontMonospace()->getLineHeight() + .5f);
-		setRect(LLRect(0,0,100,line_height * 4));
+		setRect(LLRect(0,0,100,line_height * 5));
 	}
 
 	virtual void draw();	
@@ -403,18 +408,39 @@ void LLGLTexMemBar::draw()
 	LLColor4 color;
 	
 	std::string text;
-	text = llformat("GL Tot: %d/%d MB Bound: %d/%d MB Raw Tot: %d MB Bias: %.2f Cache: %.1f/%.1f MB",
+	text = llformat("GL Tot: %d/%d MB Bound: %d/%d MB Raw Tot: %d MB Bias: %.2f Cache: %.1f/%.1f MB Hit/Miss/Evict: %d/%d/%d",
 					total_mem,
 					max_total_mem,
 					bound_mem,
 					max_bound_mem,
 					LLImageRaw::sGlobalRawMemory >> 20,					discard_bias,
-					cache_usage, cache_max_usage);
+					cache_usage, cache_max_usage,
+					LLAppViewer::getTextureCache()->getHits(),
+					LLAppViewer::getTextureCache()->getMisses(),
+					LLAppViewer::getTextureCache()->getEvictions());
 	//, cache_entries, cache_max_entries
 
 	LLFontGL::getFontMonospace()->renderUTF8(text, 0, 0, line_height*3,
 											 text_color, LLFontGL::LEFT, LLFontGL::TOP);
 
+	LLTextureBudget* budget = LLTextureBudget::getInstance();
+	S32 budget_gl = (S32)(budget->getTotalGLBytes() >> 20);
+	S32 budget_host = (S32)(budget->getTotalHostBytes() >> 20);
+	text = llformat("Budget GL: %d/%d MB Host: %d/%d MB Down/Evict: %d/%d",
+					budget_gl, budget->getGLBudgetMB(),
+					budget_host, budget->getHostBudgetMB(),
+					budget->getNumDownsampled(), budget->getNumEvicted());
+	for (S32 i = 0; i < LLTextureBudget::CAT_COUNT; i++)
+	{
+		const LLTextureBudget::Usage& usage = budget->getUsage(i);
+		text += llformat(" %s: %d/%d/%d", LLTextureBudget::getCategoryName(i), usage.mCount,
+						 (S32)(usage.mGLBytes >> 20), (S32)(usage.mHostBytes >> 20));
+	}
+	color = budget_gl > budget->getGLBudgetMB() ? LLColor4::red : text_color;
+	color[VALPHA] = text_color[VALPHA];
+	LLFontGL::getFontMonospace()->renderUTF8(text, 0, 0, line_height*4,
+											 color, LLFontGL::LEFT, LLFontGL::TOP);
+
 	//----------------------------------------------------------------------------
 #if 0
 	S32 bar_left = 400;
@@ -478,7 +504,7 @@ void LLGLTexMemBar::draw()
 #endif
 	//----------------------------------------------------------------------------
 
-	text = llformat("Textures: %d Fetch: %d(%d) Pkts:%d(%d) Cache R/W: %d/%d LFS:%d IW:%d RAW:%d HTP:%d",
+	text = llformat("Textures: %d Fetch: %d(%d) Pkts:%d(%d) Cache R/W: %d/%d LFS:%d IW:%d RAW:%d HTP:%d/%d %.0fms %.0fKB/s Grow:%d",
 					gImageList.getNumImages(),
 					LLAppViewer::getTextureFetch()->getNumRequests(), LLAppViewer::getTextureFetch()->getNumDeletes(),
 					LLAppViewer::getTextureFetch()->mPacketCount, LLAppViewer::getTextureFetch()->mBadPacketCount, 
@@ -486,7 +512,9 @@ void LLGLTexMemBar::draw()
 					LLLFSThread::sLocal->getPending(),
 					LLAppViewer::getImageDecodeThread()->getPending(), 
 					LLImageRaw::sRawImageCount,
-					LLAppViewer::getTextureFetch()->getNumHTTPRequests());
+					LLAppViewer::getTextureFetch()->getNumHTTPRequests(), LLAppViewer::getTextureFetch()->getMaxHTTPRequests(),
+					LLAppViewer::getTextureFetch()->getHTTPLatency() * 1000.f, LLAppViewer::getTextureFetch()->getHTTPThroughput() / 1024.f,
+					LLAppViewer::getTextureFetch()->getHTTPGrownRanges());
 
 	LLFontGL::getFontMonospace()->renderUTF8(text, 0, 0, line_height*2,
 									 text_color, LLFontGL::LEFT, LLFontGL::TOP);
@@ -497,7 +525,11 @@ void LLGLTexMemBar::draw()
 	F32 max_bandwidth = gSavedSettings.getF32("ThrottleBandwidthKBPS");
 	color = bandwidth > max_bandwidth ? LLColor4::red : bandwidth > max_bandwidth*.75f ? LLColor4::yellow : text_color;
 	color[VALPHA] = text_color[VALPHA];
-	text = llformat("BW:%.0f/%.0f",bandwidth, max_bandwidth);
+	text = llformat("BW:%.0f/%.0f Prefetch:%d TTFR:%.2fs Upload:%d/%dKB %.0f/%.0fms Sync:%d",bandwidth, max_bandwidth,
+					LLTexturePrefetch::getInstance()->getNumBoosted(), LLTexturePrefetch::getInstance()->getMeanTimeToFullRes(),
+					LLTextureUploader::getNumPending(), LLTextureUploader::getBytesInFlight() >> 10,
+					LLTextureUploader::sLatencyStat.getMean(), LLTextureUploader::sLatencyStat.getMax(),
+					LLTextureUploader::sNumFallbacks);
 	LLFontGL::getFontMonospace()->renderUTF8(text, 0, left, line_height*2,
 											 color, LLFontGL::LEFT, LLFontGL::TOP);
 	
@@ -68,6 +68,7 @@
 #include "llversionviewer.h"
 #include "llappviewer.h"
 #include "llvosurfacepatch.h"
+#include "lltexlayercompositor.h"
 #include "llvowlsky.h"
 #include "llrender.h"
 #include "llmediamanager.h"
@@ -347,6 +348,12 @@ static bool handleUploadBakedTexOldChanged(const LLSD& newvalue)
 	return true;
 }
 
+static bool handleAvatarBakeOnCPUChanged(const LLSD& newvalue)
+{
+	LLTexLayerCompositor::sEnabled = newvalue.asBoolean();
+	return true;
+}
+
 
 static bool handleNumpadControlChanged(const LLSD& newvalue)
 {
@@ -575,6 +582,7 @@ void settings_setup_listeners()
 	gSavedSettings.getControl("ChatPersistTime")->getSignal()->connect(boost::bind(&handleChatPersistTimeChanged, _1));
 	gSavedSettings.getControl("ConsoleMaxLines")->getSignal()->connect(boost::bind(&handleConsoleMaxLinesChanged, _1));
 	gSavedSettings.getControl("UploadBakedTexOld")->getSignal()->connect(boost::bind(&handleUploadBakedTexOldChanged, _1));
+	gSavedSettings.getControl("AvatarBakeOnCPU")->getSignal()->connect(boost::bind(&handleAvatarBakeOnCPUChanged, _1));
 	gSavedSettings.getControl("UseOcclusion")->getSignal()->connect(boost::bind(&handleUseOcclusionChanged, _1));
 	gSavedSettings.getControl("AudioLevelMaster")->getSignal()->connect(boost::bind(&handleAudioVolumeChanged, _1));
 	gSavedSettings.getControl("AudioLevelSFX")->getSignal()->connect(boost::bind(&handleAudioVolumeChanged, _1));
@@ -52,6 +52,7 @@
 #include "llimagegl.h"
 #include "llselectmgr.h"
 #include "llsky.h"
+#include "lltexlayercompositor.h"
 #include "llstartup.h"
 #include "lltoolfocus.h"
 #include "lltoolmgr.h"
@@ -519,6 +520,9 @@ void display(BOOL rebuild, F32 zoom_factor, int subfield, BOOL for_snapshot)
 	// Actually push all of our triangles to the screen.
 	//
 
+	// pick up baked textures composited off the render thread
+	LLTexLayerCompositor::update();
+
 	// do render-to-texture stuff here
 	if (gPipeline.hasRenderDebugFeatureMask(LLPipeline::RENDER_DEBUG_FEATURE_DYNAMIC_TEXTURES))
 	{
@@ -549,6 +553,7 @@ void display(BOOL rebuild, F32 zoom_factor, int subfield, BOOL for_snapshot)
 
 		//upkeep gl name pools
 		LLGLNamePool::upkeepPools();
+		LLVertexBuffer::nextFrame();
 		
 		stop_glerror();
 		display_update_camera();
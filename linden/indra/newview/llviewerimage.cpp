@@ -47,6 +47,7 @@
 #include "llimagetga.h"
 #include "llmemtype.h"
 #include "llstl.h"
+#include "lltextureuploader.h"
 #include "llvfile.h"
 #include "llvfs.h"
 #include "message.h"
@@ -55,6 +56,7 @@
 // viewer includes
 #include "lldrawpool.h"
 #include "lltexturefetch.h"
+#include "lltextureprefetch.h"
 #include "llviewerimagelist.h"
 #include "llviewercontrol.h"
 #include "pipeline.h"
@@ -85,6 +87,7 @@ S32 LLViewerImage::sMaxBoundTextureMemInMegaBytes = 0;
 S32 LLViewerImage::sMaxTotalTextureMemInMegaBytes = 0;
 S32 LLViewerImage::sMaxDesiredTextureMemInBytes = 0 ;
 BOOL LLViewerImage::sDontLoadVolumeTextures = FALSE;
+BOOL LLViewerImage::sCompressTextures = FALSE;
 
 S32 LLViewerImage::sMaxSculptRez = 128 ; //max sculpt image size
 const S32 MAX_CACHED_RAW_IMAGE_AREA = 64 * 64 ;
@@ -231,6 +234,12 @@ void LLViewerImage::updateClass(const F32 velocity, const F32 angular_velocity)
 	}
 	sDesiredDiscardBias = llclamp(sDesiredDiscardBias, sDesiredDiscardBiasMin, sDesiredDiscardBiasMax);
 
+	sCompressTextures = gSavedSettings.getBOOL("RenderCompressTextures") && gGLManager.mHasCompressedTextures;
+
+	LLTextureUploader::sEnabled = gSavedSettings.getBOOL("RenderTextureUploadPBO");
+	LLTextureUploader::sMaxBytesPerFrame = llmax(gSavedSettings.getS32("RenderTextureUploadKBPerFrame"), 64) * 1024;
+	LLTextureUploader::sMaxBytesInFlight = llmax(gSavedSettings.getS32("RenderTextureUploadMaxMB"), 4) << 20;
+
 	F32 camera_moving_speed = LLViewerCamera::getInstance()->getAverageSpeed() ;
 	F32 camera_angular_speed = LLViewerCamera::getInstance()->getAverageAngularSpeed();
 	sCameraMovingDiscardBias = (S8)llmax(0.2f * camera_moving_speed, 2.0f * camera_angular_speed - 1) ;
@@ -303,6 +312,7 @@ void LLViewerImage::init(bool firstinit)
 	mFullyLoaded = FALSE;
 	mDesiredDiscardLevel = MAX_DISCARD_LEVEL + 1;
 	mMinDesiredDiscardLevel = MAX_DISCARD_LEVEL + 1;
+	mBudgetDiscardLevel = 0;
 	mCalculatedDiscardLevel = -1.f;
 
 	mDecodingAux = FALSE;
@@ -328,6 +338,8 @@ void LLViewerImage::init(bool firstinit)
 	mIsRawImageValid = FALSE;
 	mRawDiscardLevel = INVALID_DISCARD_LEVEL;
 	mMinDiscardLevel = 0;
+	mCompressedImage = NULL;
+	mCompressedUpload = FALSE;
 
 	mHasFetcher = FALSE;
 	mIsFetching = FALSE;
@@ -337,6 +349,9 @@ void LLViewerImage::init(bool firstinit)
 	mFetchDeltaTime = 999999.f;
 	mDecodeFrame = 0;
 	mVisibleFrame = 0;
+	mOnScreenTime = -1.0;
+	mOnScreen = FALSE;
+	mPrefetched = FALSE;
 	mForSculpt = FALSE ;
 	mCachedRawImage = NULL ;
 	mCachedRawDiscardLevel = -1 ;
@@ -432,7 +447,10 @@ void LLViewerImage::addToCreateTexture()
 	if(isForSculptOnly())
 	{
 		//just update some variables, not to create a real GL texture.
-		createGLTexture(mRawDiscardLevel, mRawImage, 0, FALSE) ;
+		if (mRawImage.notNull())
+		{
+			createGLTexture(mRawDiscardLevel, mRawImage, 0, FALSE) ;
+		}
 		mNeedsCreateTexture = FALSE ;
 		destroyRawImage();
 	}
@@ -472,7 +490,11 @@ void LLViewerImage::addToCreateTexture()
 							destroyRawImage();
 							return ;
 						}
-						mRawImage->scale(w >> i, h >> i) ;					
+						if (mRawImage.notNull())
+						{
+							// a compressed copy is uploaded from its smaller mips instead
+							mRawImage->scale(w >> i, h >> i) ;
+						}
 					}
 				}
 			}
@@ -493,10 +515,20 @@ BOOL LLViewerImage::createTexture(S32 usename/*= 0*/)
 		return FALSE;
 	}
 	mNeedsCreateTexture	= FALSE;
-	if (mRawImage.isNull())
+	if (mRawImage.isNull() && mCompressedImage.isNull())
 	{
 		llerrs << "LLViewerImage trying to create texture with no Raw Image" << llendl;
 	}
+	if (mRawImage.isNull() && (!mLoadedCallbackList.empty() || mNeedsAux || mForSculpt))
+	{
+		// Raw data became necessary after the request went out and the
+		// DXT cache answered it, drop it and let the next fetch decode
+		destroyRawImage();
+		return FALSE;
+	}
+	// Raw data callbacks read the GL texture back, which compressed data can't do
+	bool use_compressed = mCompressedImage.notNull() && (mRawImage.isNull() || mLoadedCallbackList.empty());
+	const LLImageBase* image = use_compressed ? (const LLImageBase*)mCompressedImage.get() : (const LLImageBase*)mRawImage.get();
 // 	llinfos << llformat("IMAGE Creating (%d) [%d x %d] Bytes: %d ",
 // 						mRawDiscardLevel, 
 // 						mRawImage->getWidth(), mRawImage->getHeight(),mRawImage->getDataSize())
@@ -521,18 +553,20 @@ BOOL LLViewerImage::createTexture(S32 usename/*= 0*/)
 
 		bool size_okay = true;
 		
-		U32 raw_width = mRawImage->getWidth() << mRawDiscardLevel;
-		U32 raw_height = mRawImage->getHeight() << mRawDiscardLevel;
+		// the compressed copy keeps every mip from the discard it was decoded at
+		S32 image_discard = use_compressed ? mCompressedImage->getSourceDiscard() : mRawDiscardLevel;
+		U32 raw_width = image->getWidth() << image_discard;
+		U32 raw_height = image->getHeight() << image_discard;
 		if( raw_width > MAX_IMAGE_SIZE || raw_height > MAX_IMAGE_SIZE )
 		{
 			llinfos << "Width or height is greater than " << MAX_IMAGE_SIZE << ": (" << raw_width << "," << raw_height << ")" << llendl;
 			size_okay = false;
 		}
 		
-		if (!LLImageGL::checkSize(mRawImage->getWidth(), mRawImage->getHeight()))
+		if (!LLImageGL::checkSize(image->getWidth(), image->getHeight()))
 		{
 			// A non power-of-two image was uploaded (through a non standard client)
-			llinfos << "Non power of two width or height: (" << mRawImage->getWidth() << "," << mRawImage->getHeight() << ")" << llendl;
+			llinfos << "Non power of two width or height: (" << image->getWidth() << "," << image->getHeight() << ")" << llendl;
 			size_okay = false;
 		}
 		
@@ -546,7 +580,22 @@ BOOL LLViewerImage::createTexture(S32 usename/*= 0*/)
 			return FALSE;
 		}
 		
-		res = LLImageGL::createGLTexture(mRawDiscardLevel, mRawImage, usename);
+		if (use_compressed)
+		{
+			res = LLImageGL::createGLTexture(mRawDiscardLevel, mCompressedImage, usename);
+		}
+		if (!use_compressed || (!res && mRawImage.notNull()))
+		{
+			// callbacks may read the GL texture back as soon as this returns
+			res = usename == 0 && mLoadedCallbackList.empty() &&
+				LLImageGL::createGLTextureAsync(mRawDiscardLevel, mRawImage);
+			if (!res)
+			{
+				res = LLImageGL::createGLTexture(mRawDiscardLevel, mRawImage, usename);
+			}
+			use_compressed = false;
+		}
+		mCompressedUpload = use_compressed && res;
 	}
 
 	//
@@ -707,6 +756,11 @@ void LLViewerImage::processTextureStats()
 		
 		// Can't go higher than the max discard level
 		mDesiredDiscardLevel = llmin((S32)mMaxDiscardLevel+1, (S32)discard_level);
+		// Don't fetch back what the texture budget just took away
+		if (mBoostLevel < LLViewerImageBoostLevel::BOOST_HIGH)
+		{
+			mDesiredDiscardLevel = llmax((S32)mDesiredDiscardLevel, (S32)mBudgetDiscardLevel);
+		}
 		// Clamp to min desired discard
 		mDesiredDiscardLevel = llmin(mMinDesiredDiscardLevel, mDesiredDiscardLevel);
 
@@ -741,6 +795,7 @@ void LLViewerImage::updateVirtualSize()
 	{
 		addTextureStats(0.f, FALSE) ;//reset
 	}
+	BOOL on_screen = FALSE;
 	if(mFaceList.size() > 0) 
 	{				
 		for(std::list<LLFace*>::iterator iter = mFaceList.begin(); iter != mFaceList.end(); ++iter)
@@ -750,12 +805,111 @@ void LLViewerImage::updateVirtualSize()
 			{
 				addTextureStats(facep->getVirtualSize()) ;
 				setAdditionalDecodePriority(facep->getImportanceToCamera()) ;
+				on_screen = TRUE;
 			}
 		}	
 	}
+
+	// time-to-full-res clock (see LLTexturePrefetch).  Started on every
+	// off->on transition, even when the data is already here, so that
+	// calcDecodePriority() reports a 0 s sample for textures that were
+	// complete when they came into view.
+	if (on_screen && !mOnScreen)
+	{
+		mOnScreenTime = LLFrameTimer::getTotalSeconds();
+	}
+	else if (!on_screen && mOnScreen)
+	{
+		mOnScreenTime = -1.0;
+		mPrefetched = FALSE;
+	}
+	mOnScreen = on_screen;
 	mNeedsResetMaxVirtualSize = TRUE ;
 #endif	
 }
+S32 LLViewerImage::getHostBytes() const
+{
+	S32 bytes = 0;
+	if (mRawImage.notNull())
+	{
+		bytes += mRawImage->getDataSize();
+	}
+	if (mAuxRawImage.notNull())
+	{
+		bytes += mAuxRawImage->getDataSize();
+	}
+	if (mCachedRawImage.notNull() && mCachedRawImage != mRawImage)
+	{
+		bytes += mCachedRawImage->getDataSize();
+	}
+	if (mSavedRawImage.notNull() && mSavedRawImage != mRawImage)
+	{
+		bytes += mSavedRawImage->getDataSize();
+	}
+	if (mCompressedImage.notNull())
+	{
+		bytes += mCompressedImage->getDataSize();
+	}
+	return bytes;
+}
+
+// Drop the GL texture to discard_level and keep it from fetching back up
+// until LLTextureBudget relaxes the floor.
+BOOL LLViewerImage::budgetDownsample(S32 discard_level)
+{
+	if (!getHasGLTexture() || mNeedsCreateTexture ||
+		discard_level <= getDiscardLevel() || discard_level > getMaxDiscardLevel())
+	{
+		return FALSE;
+	}
+
+	BOOL res = FALSE;
+	if (!mCompressedUpload)
+	{
+		// The lower mips are already in GL, read one back and re-upload it
+		LLPointer<LLImageRaw> raw = new LLImageRaw;
+		if (readBackRaw(discard_level, raw, false))
+		{
+			res = createGLTexture(discard_level, raw);
+		}
+	}
+	if (!res && mCachedRawDiscardLevel > getDiscardLevel())
+	{
+		// S3TC data can't be read back, fall back to the cached copy
+		discard_level = mCachedRawDiscardLevel;
+		scaleDown();
+		res = mNeedsCreateTexture;
+	}
+	if (res)
+	{
+		mBudgetDiscardLevel = llmax((S32)mBudgetDiscardLevel, discard_level);
+		mFullyLoaded = FALSE;
+	}
+	return res;
+}
+
+void LLViewerImage::budgetEvict()
+{
+	if (mNeedsCreateTexture)
+	{
+		return;
+	}
+	destroyGLTexture();
+	mCompressedUpload = FALSE;
+	mFullyLoaded = FALSE;
+}
+
+void LLViewerImage::releaseCachedRawImage()
+{
+	if (mForSculpt || mCachedRawImage.isNull() || mCachedRawImage == mRawImage)
+	{
+		return;
+	}
+	mCachedRawImage = NULL;
+	mCachedRawDiscardLevel = -1;
+	mCachedRawImageReady = FALSE;
+}
+
 void LLViewerImage::scaleDown()
 {
 	if(getHasGLTexture() && mCachedRawDiscardLevel > getDiscardLevel())
@@ -814,6 +968,14 @@ F32 LLViewerImage::calcDecodePriority()
 	//}
 
 	bool have_all_data = (cur_discard >= 0 && (cur_discard <= mDesiredDiscardLevel));
+	if (have_all_data && mOnScreenTime >= 0.0)
+	{
+		// 0 when the data was complete in the frame it came on screen
+		F32 elapsed = (F32)(LLFrameTimer::getTotalSeconds() - mOnScreenTime);
+		LLTexturePrefetch::getInstance()->recordTimeToFullRes(elapsed, mPrefetched);
+		mOnScreenTime = -1.0;
+		mPrefetched = FALSE;
+	}
 	F32 pixel_priority = fsqrtf(mMaxVirtualSize);
 	const S32 MIN_NOT_VISIBLE_FRAMES = 30; // NOTE: this function is not called every frame
 	mDecodeFrame++;
@@ -971,6 +1133,14 @@ void LLViewerImage::setBoostLevel(S32 level)
 
 //============================================================================
 
+bool LLViewerImage::wantsCompressed() const
+{
+	// Callbacks, sculpts and saved copies need the raw pixels, local
+	// files are uploaded at their own size
+	return sCompressTextures && getUseMipMaps() && mLoadedCallbackList.empty() && !mNeedsAux &&
+		!mForSculpt && !mForceToSaveRawImage && mUrl.compare(0, 7, "file://") != 0;
+}
+
 bool LLViewerImage::updateFetch()
 {
 	mFetchState = 0;
@@ -990,7 +1160,7 @@ bool LLViewerImage::updateFetch()
 		llassert_always(!mHasFetcher);
 		return false; // skip
 	}
-	if (mNeedsCreateTexture)
+	if (mNeedsCreateTexture || hasPendingUpload())
 	{
 		// We may be fetching still (e.g. waiting on write)
 		// but don't check until we've processed the raw data we have
@@ -1031,7 +1201,7 @@ bool LLViewerImage::updateFetch()
 
 		if (mRawImage.notNull()) sRawCount--;
 		if (mAuxRawImage.notNull()) sAuxCount--;
-		bool finished = LLAppViewer::getTextureFetch()->getRequestFinished(getID(), fetch_discard, mRawImage, mAuxRawImage);
+		bool finished = LLAppViewer::getTextureFetch()->getRequestFinished(getID(), fetch_discard, mRawImage, mAuxRawImage, mCompressedImage);
 		if (mRawImage.notNull()) sRawCount++;
 		if (mAuxRawImage.notNull()) sAuxCount++;
 		if (finished)
@@ -1045,23 +1215,25 @@ bool LLViewerImage::updateFetch()
 		}
 		
 		// We may have data ready regardless of whether or not we are finished (e.g. waiting on write)
-		if (mRawImage.notNull())
+		if (mRawImage.notNull() || mCompressedImage.notNull())
 		{
 			mRawDiscardLevel = fetch_discard;
+			// the components the GL texture will have
+			LLImageBase* image = mCompressedImage.notNull() ? (LLImageBase*)mCompressedImage.get() : (LLImageBase*)mRawImage.get();
 			
-			if ((mRawImage->getDataSize() > 0 && mRawDiscardLevel >= 0) &&
+			if ((image->getDataSize() > 0 && mRawDiscardLevel >= 0) &&
 				(current_discard < 0 || mRawDiscardLevel < current_discard))
 			{
-				if (getComponents() != mRawImage->getComponents())
+				if (getComponents() != image->getComponents())
 				{
 					// We've changed the number of components, so we need to move any
 					// objects using this pool to a different pool.
-					mComponents = mRawImage->getComponents();
+					mComponents = image->getComponents();
 					gImageList.dirtyImage(this);
 				}			
 				
-				mFullWidth = mRawImage->getWidth() << mRawDiscardLevel;
-				mFullHeight = mRawImage->getHeight() << mRawDiscardLevel;
+				mFullWidth = image->getWidth() << mRawDiscardLevel;
+				mFullHeight = image->getHeight() << mRawDiscardLevel;
 
 				if(mFullWidth > MAX_IMAGE_SIZE || mFullHeight > MAX_IMAGE_SIZE)
 				{ 
@@ -1073,7 +1245,7 @@ bool LLViewerImage::updateFetch()
 				}
 				else
 				{
-					mIsRawImageValid = TRUE;			
+					mIsRawImageValid = mRawImage.notNull();
 					addToCreateTexture() ;
 				}
 
@@ -1179,7 +1351,7 @@ bool LLViewerImage::updateFetch()
 		// bypass texturefetch directly by pulling from LLTextureCache
 		bool fetch_request_created = false;
 		fetch_request_created = LLAppViewer::getTextureFetch()->createRequest(mUrl, getID(),getTargetHost(), decode_priority,
-																			  w, h, c, desired_discard, needsAux());
+																			  w, h, c, desired_discard, needsAux(), wantsCompressed());
 
 		if (fetch_request_created)
 		{				
@@ -1206,7 +1378,7 @@ bool LLViewerImage::updateFetch()
 		}
 	}
 	
-	llassert_always(mRawImage.notNull() || (!mNeedsCreateTexture && !mIsRawImageValid));
+	llassert_always(mRawImage.notNull() || mCompressedImage.notNull() || (!mNeedsCreateTexture && !mIsRawImageValid));
 	
 	return mIsFetching ? true : false;
 }
@@ -1258,7 +1430,7 @@ BOOL LLViewerImage::forceFetch()
 		c = getComponents();
 	}
 	fetch_request_created = LLAppViewer::getTextureFetch()->createRequest(mUrl, getID(),getTargetHost(), maxDecodePriority(),
-																		  w, h, c, desired_discard, needsAux());
+																		  w, h, c, desired_discard, needsAux(), wantsCompressed());
 
 	if (fetch_request_created)
 	{
@@ -1313,6 +1485,14 @@ void LLViewerImage::setLoadedCallback( loaded_callback_func loaded_callback,
 	LLLoadedCallbackEntry* entryp = new LLLoadedCallbackEntry(loaded_callback, discard_level, keep_imageraw, userdata);
 	mLoadedCallbackList.push_back(entryp);
 	mNeedsAux |= needs_aux;
+	if (mCompressedUpload && !mNeedsCreateTexture)
+	{
+		// GL data uploaded compressed can't be read back for the
+		// callbacks, drop it so the next fetch decodes raw data
+		mCompressedUpload = FALSE;
+		mFullyLoaded = FALSE;
+		destroyGLTexture();
+	}
 	if (mNeedsAux && mAuxRawImage.isNull() && getDiscardLevel() >= 0)
 	{
 		// We need aux data, but we've already loaded the image, and it didn't have any
@@ -1685,6 +1865,7 @@ void LLViewerImage::destroyRawImage()
 
 	mRawImage = NULL;
 	mAuxRawImage = NULL;
+	mCompressedImage = NULL;
 	mIsRawImageValid = FALSE;
 	mRawDiscardLevel = INVALID_DISCARD_LEVEL;
 }
@@ -1733,7 +1914,17 @@ void LLViewerImage::setCachedRawImage()
 			{
 				--i ;
 			}
-			mRawImage->scale(w >> i, h >> i) ;
+			if (hasPendingUpload())
+			{
+				// a worker is still reading mRawImage for the upload, scale a copy
+				LLPointer<LLImageRaw> scaled = new LLImageRaw(w >> i, h >> i, mRawImage->getComponents());
+				scaled->copyScaled(mRawImage);
+				mRawImage = scaled;
+			}
+			else
+			{
+				mRawImage->scale(w >> i, h >> i) ;
+			}
 		}
 		mCachedRawImage = mRawImage ;
 		mCachedRawDiscardLevel = mRawDiscardLevel + i ;			
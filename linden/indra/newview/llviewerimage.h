@@ -37,6 +37,7 @@
 #include "lltimer.h"
 #include "llframetimer.h"
 #include "llhost.h"
+#include "llbucketqueue.h"
 
 #include <map>
 #include <list>
@@ -119,6 +120,7 @@ class LLViewerImage : public LLImageGL
 
 	friend class LLTextureBar; // debug info only
 	friend class LLTextureView; // debug info only
+	friend class LLTextureBudget;
 	
 public:
 	static void initClass();
@@ -147,6 +149,15 @@ public:
 		}
 	};
 
+	// position in LLViewerImageList's priority queue
+	struct PriorityHandle
+	{
+		LLBucketQueueHandle& operator()(const LLPointer<LLViewerImage>& image) const
+		{
+			return ((LLViewerImage*) image)->mPriorityHandle;
+		}
+	};
+
 	struct CompareByHostAndPriority
 	{
 		// lhs < rhs
@@ -253,6 +264,8 @@ public:
 	void addToCreateTexture();
 
 	BOOL needsAux() const							{ return mNeedsAux; }
+	// TRUE if a fetch should also hand back an S3TC copy to upload
+	bool wantsCompressed() const;
 
 	// setDesiredDiscardLevel is only used by LLViewerImageList
 	void setDesiredDiscardLevel(S32 discard) { mDesiredDiscardLevel = discard; }
@@ -313,6 +326,12 @@ public:
 
 	void        addFace(LLFace* facep) ;
 	void        removeFace(LLFace* facep) ;
+
+	// Texture budget (see LLTextureBudget)
+	S32         getHostBytes() const ;
+	BOOL        budgetDownsample(S32 discard_level) ;
+	void        budgetEvict() ;
+	void        releaseCachedRawImage() ;
 private:
 	/*virtual*/ void cleanup(); // Cleanup the LLViewerImage (so we can reinitialize it)
 
@@ -342,6 +361,7 @@ public:
 	F32 mDiscardVirtualSize;		// Virtual size used to calculate desired discard
 	
 	S8  mInImageList;				// TRUE if image is in list (in which case don't reset priority!)
+	LLBucketQueueHandle mPriorityHandle;
 	S8  mIsMediaTexture;			// TRUE if image is being replaced by media (in which case don't update)
 
 	// Various info regarding image requests
@@ -354,6 +374,9 @@ public:
 	F32 mRequestDeltaTime;
 	S32 mDecodeFrame;
 	S32 mVisibleFrame; // decode frame where image was last visible
+	F64 mOnScreenTime; // when a face using it last came on screen, until full res is reported, or -1
+	S8  mOnScreen;     // a face using it was visible at the last updateVirtualSize()
+	S8  mPrefetched;   // boosted by LLTexturePrefetch while off screen
 	
 	// Timers
 	LLFrameTimer mLastPacketTimer;		// Time since last packet.
@@ -364,6 +387,7 @@ private:
 
 	S8  mDesiredDiscardLevel;			// The discard level we'd LIKE to have - if we have it and there's space
 	S8  mMinDesiredDiscardLevel;		// The minimum discard level we'd like to have
+	S8  mBudgetDiscardLevel;			// Don't fetch below this, LLTextureBudget took it away
 	S8  mNeedsCreateTexture;	
 	mutable S8  mNeedsGLTexture;
 	S8  mNeedsAux;					// We need to decode the auxiliary channels
@@ -387,6 +411,10 @@ private:
 	callback_list_t mLoadedCallbackList;
 
 	LLPointer<LLImageRaw> mRawImage;
+	// S3TC copy of mRawImage (or all we got, from the DXT cache) uploaded
+	// in its place, at mRawDiscardLevel
+	LLPointer<LLImageDXT> mCompressedImage;
+	BOOL mCompressedUpload; // the GL texture came from mCompressedImage
 	S32 mRawDiscardLevel;
 	S32	mMinDiscardLevel;
 	F32 mCalculatedDiscardLevel; // Last calculated discard level
@@ -437,6 +465,7 @@ public:
 	static S32 sMaxTotalTextureMemInMegaBytes;
 	static S32 sMaxDesiredTextureMemInBytes ;
 	static BOOL sDontLoadVolumeTextures;
+	static BOOL sCompressTextures;
 
 	static S32 sMaxSculptRez ;
 	static S32 sMinLargeImageSize ;
@@ -46,6 +46,7 @@
 
 #include "llsdserialize.h"
 #include "llsys.h"
+#include "lltextureuploader.h"
 #include "llvfs.h"
 #include "llvfile.h"
 #include "llvfsthread.h"
@@ -53,8 +54,10 @@
 #include "message.h"
 
 #include "llagent.h"
+#include "lltexturebudget.h"
 #include "lltexturecache.h"
 #include "lltexturefetch.h"
+#include "lltextureprefetch.h"
 #include "llviewercontrol.h"
 #include "llviewerimage.h"
 #include "llviewermedia.h"
@@ -297,6 +300,7 @@ void LLViewerImageList::dump()
 		<< " http://asset.siva.lindenlab.com/" << image->getID() << ".texture"
 		<< llendl;
 	}
+	LLTextureBudget::getInstance()->dump();
 }
 
 void LLViewerImageList::destroyGL(BOOL save_state)
@@ -451,7 +455,7 @@ void LLViewerImageList::addImageToList(LLViewerImage *image)
 	{
 		llerrs << "LLViewerImageList::addImageToList - Image already in list" << llendl;
 	}
-	llverify((mImageList.insert(image)).second == true);
+	llverify(mImageList.insert(image, image->getDecodePriority()));
 	image->mInImageList = TRUE;
 }
 
@@ -468,7 +472,7 @@ void LLViewerImageList::removeImageFromList(LLViewerImage *image)
 		}
 		llerrs << "LLViewerImageList::removeImageFromList - Image not in list" << llendl;
 	}
-	llverify(mImageList.erase(image) == 1);
+	llverify(mImageList.erase(image));
 	image->mInImageList = FALSE;
 }
 
@@ -534,6 +538,8 @@ void LLViewerImageList::updateImages(F32 max_time)
 
 	llpushcallstacks ;
 
+	LLTexturePrefetch::getInstance()->update();
+	LLTextureBudget::getInstance()->update();
 	updateImagesDecodePriorities();
 
 	llpushcallstacks ;
@@ -655,9 +661,8 @@ void LLViewerImageList::updateImagesDecodePriorities()
 			if ((decode_priority_test < old_priority_test * .8f) ||
 				(decode_priority_test > old_priority_test * 1.25f))
 			{
-				removeImageFromList(imagep);
 				imagep->setDecodePriority(decode_priority);
-				addImageToList(imagep);
+				mImageList.update(imagep, decode_priority);
 			}
 			update_counter--;
 		}
@@ -702,6 +707,9 @@ F32 LLViewerImageList::updateImagesCreateTextures(F32 max_time)
 	LLFastTimer t(LLFastTimer::FTM_IMAGE_CREATE);
 	
 	LLTimer create_timer;
+	// finish the uploads already in flight first, they free pixel buffers
+	LLTextureUploader::update(max_time);
+
 	image_list_t::iterator enditer = mCreateTextureList.begin();
 	for (image_list_t::iterator iter = mCreateTextureList.begin();
 		 iter != mCreateTextureList.end();)
@@ -738,7 +746,7 @@ void LLViewerImageList::bumpToMaxDecodePriority(LLViewerImage* imagep)
 	imagep->processTextureStats();
 	F32 decode_priority = LLViewerImage::maxDecodePriority() ;
 	imagep->setDecodePriority(decode_priority);
-	mImageList.insert(imagep);
+	mImageList.insert(imagep, decode_priority);
 	imagep->mInImageList = TRUE;
 
 	return ;
@@ -753,20 +761,13 @@ F32 LLViewerImageList::updateImagesFetchTextures(F32 max_time)
 	const size_t max_priority_count = llmin((S32) (256*10.f*gFrameIntervalSeconds)+1, 32);
 	const size_t max_update_count = llmin((S32) (1024*10.f*gFrameIntervalSeconds)+1, 256);
 	
-	// 32 high priority entries
-	typedef std::vector<LLViewerImage*> entries_list_t;
+	// 32 high priority entries, in exact priority order
+	typedef std::vector<LLPointer<LLViewerImage> > entries_list_t;
 	entries_list_t entries;
-	size_t update_counter = llmin(max_priority_count, mImageList.size());
-	image_priority_list_t::iterator iter1 = mImageList.begin();
-	while(update_counter > 0)
-	{
-		entries.push_back(*iter1);
-		++iter1;
-		update_counter--;
-	}
+	mImageList.getTop(max_priority_count, entries, LLViewerImage::Compare());
 	
 	// 256 cycled entries
-	update_counter = llmin(max_update_count, mUUIDMap.size());
+	size_t update_counter = llmin(max_update_count, mUUIDMap.size());
 	if (update_counter > 0)
 	{
 		uuid_map_t::iterator iter2 = mUUIDMap.upper_bound(mLastFetchUUID);
@@ -852,7 +853,7 @@ void LLViewerImageList::decodeAllImages(F32 max_time)
 		imagep->processTextureStats();
 		F32 decode_priority = imagep->calcDecodePriority();
 		imagep->setDecodePriority(decode_priority);
-		mImageList.insert(imagep);
+		mImageList.insert(imagep, decode_priority);
 		imagep->mInImageList = TRUE;
 	}
 	image_list.clear();
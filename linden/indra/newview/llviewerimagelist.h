@@ -70,6 +70,7 @@ class LLViewerImageList
         LOG_CLASS(LLViewerImageList);
 
 	friend class LLTextureView;
+	friend class LLTextureBudget;
 	
 public:
 	static BOOL createUploadFile(const std::string& filename, const std::string& out_filename, const U8 codec);
@@ -173,7 +174,8 @@ private:
 	LLUUID mLastUpdateUUID;
 	LLUUID mLastFetchUUID;
 	
-	typedef std::set<LLPointer<LLViewerImage>, LLViewerImage::Compare> image_priority_list_t;	
+	// bucketed by decode priority, see LLBucketQueue
+	typedef LLBucketQueue<LLPointer<LLViewerImage>, LLViewerImage::PriorityHandle> image_priority_list_t;	
 	image_priority_list_t mImageList;
 
 	// simply holds on to LLViewerImage references to stop them from being purged too soon
@@ -34,12 +34,15 @@
 // Header Files
 //-----------------------------------------------------------------------------
 #include "llviewerprecompiledheaders.h"
+#include <list>
 
 #include "imageids.h"
 #include "llfasttimer.h"
 #include "llrender.h"
 
 #include "llagent.h"
+#include "llappviewer.h"
+#include "llthreadpool.h"
 #include "llapr.h"
 #include "llbox.h"
 #include "lldrawable.h"
@@ -839,7 +842,104 @@ static BOOL sVectorizePerfTest 				= FALSE;
 static U32 sVectorizeProcessor 				= 0;
 
 //static
-void (*LLViewerJointMesh::sUpdateGeometryFunc)(LLFace* face, LLPolyMesh* mesh);
+void (*LLViewerJointMesh::sSkinGeometryFunc)(const SkinGeometry& geom);
+
+// Avatar meshes are skinned on the geometry worker threads, one job per mesh.
+// The render thread maps the vertex buffer and gathers the job in
+// updateJointGeometry(), LLDrawPoolAvatar::prerender() dispatches everything
+// queued for the frame and LLVOAvatar::renderSkinned() waits for it before
+// unmapping the buffer and drawing.
+
+class LLSkinGeometryJob : public LLThreadPool::Job
+{
+public:
+	LLSkinGeometryJob(const LLViewerJointMesh::SkinGeometry& geom, LLVertexBuffer* buffer)
+		: mGeometry(geom), mBuffer(buffer), mDispatched(false) { }
+
+	/*virtual*/ void run()
+	{
+		LLViewerJointMesh::sSkinGeometryFunc(mGeometry);
+	}
+
+	LLViewerJointMesh::SkinGeometry mGeometry;
+	LLPointer<LLVertexBuffer> mBuffer;	// mapped until this job is finished
+	bool mDispatched;
+};
+
+// a list so queued jobs don't move when others are added or finished
+typedef std::list<LLSkinGeometryJob> skin_job_list_t;
+static skin_job_list_t sSkinJobs;
+
+//static
+void LLViewerJointMesh::getSkinGeometry(LLFace* face, LLPolyMesh* mesh, SkinGeometry& geom)
+{
+	LLVertexBuffer *buffer = face->mVertexBuffer;
+	buffer->getVertexStrider(geom.mVertices, mesh->mFaceVertexOffset);
+	buffer->getNormalStrider(geom.mNormals,  mesh->mFaceVertexOffset);
+	geom.mMesh = mesh;
+}
+
+//static
+void LLViewerJointMesh::dispatchSkinning()
+{
+	LLThreadPool* pool = LLAppViewer::getGeometryThreads();
+	if (!pool)
+	{
+		return;
+	}
+	for (skin_job_list_t::iterator iter = sSkinJobs.begin(); iter != sSkinJobs.end(); ++iter)
+	{
+		if (!iter->mDispatched)
+		{
+			pool->addJob(&(*iter));
+			iter->mDispatched = true;
+		}
+	}
+}
+
+//static
+void LLViewerJointMesh::finishSkinning(LLVertexBuffer* buffer)
+{
+	// Wait for the jobs writing to buffer one by one rather than draining
+	// the pool, which also carries volume geometry and other avatars.
+	LLThreadPool* pool = LLAppViewer::getGeometryThreads();
+	std::vector<LLPointer<LLVertexBuffer> > finished;
+	skin_job_list_t::iterator iter = sSkinJobs.begin();
+	while (iter != sSkinJobs.end())
+	{
+		skin_job_list_t::iterator cur = iter++;
+		if (buffer && cur->mBuffer != buffer)
+		{
+			continue;
+		}
+		if (cur->mDispatched)
+		{
+			pool->waitForJob(&(*cur));
+		}
+		else
+		{
+			cur->run();
+		}
+		if (!buffer && std::find(finished.begin(), finished.end(), cur->mBuffer) == finished.end())
+		{
+			finished.push_back(cur->mBuffer);
+		}
+		sSkinJobs.erase(cur);
+	}
+
+	// every writer is done, the buffers can be uploaded now
+	if (buffer)
+	{
+		buffer->setBuffer(0);
+	}
+	for (U32 i = 0; i < finished.size(); i++)
+	{
+		if (finished[i]->isLocked())
+		{
+			finished[i]->setBuffer(0);
+		}
+	}
+}
 
 //static
 void LLViewerJointMesh::updateVectorize()
@@ -852,7 +952,8 @@ void LLViewerJointMesh::updateVectorize()
 	std::string vp;
 	switch(sVectorizeProcessor)
 	{
-		case 2: vp = "SSE2"; break;					// *TODO: replace the magic #s
+		case 3: vp = "SSE2 weight runs"; break;		// *TODO: replace the magic #s
+		case 2: vp = "SSE2"; break;
 		case 1: vp = "SSE"; break;
 		default: vp = "COMPILER DEFAULT"; break;
 	}
@@ -863,20 +964,23 @@ void LLViewerJointMesh::updateVectorize()
 	{
 		switch(sVectorizeProcessor)
 		{
+			case 3:
+				sSkinGeometryFunc = &skinGeometrySSE2Runs;
+				break;
 			case 2:
-				sUpdateGeometryFunc = &updateGeometrySSE2;
+				sSkinGeometryFunc = &skinGeometrySSE2;
 				break;
 			case 1:
-				sUpdateGeometryFunc = &updateGeometrySSE;
+				sSkinGeometryFunc = &skinGeometrySSE;
 				break;
 			default:
-				sUpdateGeometryFunc = &updateGeometryVectorized;
+				sSkinGeometryFunc = &skinGeometryVectorized;
 				break;
 		}
 	}
 	else
 	{
-		sUpdateGeometryFunc = &updateGeometryOriginal;
+		sSkinGeometryFunc = NULL;
 	}
 }
 
@@ -896,9 +1000,23 @@ void LLViewerJointMesh::updateJointGeometry()
 	{
 		// Once we've measured performance, just run the specified
 		// code version.
-		if(sUpdateGeometryFunc == updateGeometryOriginal)
+		if (!sSkinGeometryFunc)
+		{
 			uploadJointMatrices();
-		sUpdateGeometryFunc(mFace, mMesh);
+			updateGeometryOriginal(mFace, mMesh);
+			return;
+		}
+		SkinGeometry geom;
+		getSkinGeometry(mFace, mMesh, geom);
+		LLThreadPool* pool = LLAppViewer::getGeometryThreads();
+		if (pool && pool->getThreaded())
+		{
+			sSkinJobs.push_back(LLSkinGeometryJob(geom, mFace->mVertexBuffer));
+		}
+		else
+		{
+			sSkinGeometryFunc(geom);
+		}
 	}
 	else
 	{
@@ -906,12 +1024,12 @@ void LLViewerJointMesh::updateJointGeometry()
 		// the fastest one.
 		LLTimer ug_timer ;
 		
-		if (sUpdateGeometryCallPointer)
+		if (sUpdateGeometryCallPointer && sSkinGeometryFunc)
 		{
-			if(sUpdateGeometryFunc == updateGeometryOriginal)
-				uploadJointMatrices();
 			// call accelerated version for this processor
-			sUpdateGeometryFunc(mFace, mMesh);
+			SkinGeometry geom;
+			getSkinGeometry(mFace, mMesh, geom);
+			sSkinGeometryFunc(geom);
 		}
 		else
 		{
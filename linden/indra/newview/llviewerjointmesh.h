@@ -36,6 +36,7 @@
 #include "llviewerjoint.h"
 #include "llviewerimage.h"
 #include "llpolymesh.h"
+#include "llstrider.h"
 #include "v4color.h"
 #include "llapr.h"
 
@@ -151,6 +152,14 @@ public:
 	/*virtual*/ BOOL isAnimatable() { return FALSE; }
 	
 	static void updateVectorize(); // Update globals when settings variables change
+
+	// With the geometry worker threads running, updateJointGeometry() only
+	// queues the mesh.  dispatchSkinning() hands the queued meshes to the
+	// workers.  finishSkinning() blocks until the meshes queued for buffer
+	// are written and then unmaps buffer; with NULL it does this for every
+	// queued mesh.  Other jobs on the geometry threads are not waited for.
+	static void dispatchSkinning();
+	static void finishSkinning(LLVertexBuffer* buffer);
 	
 private:
 	// Avatar vertex skinning is a significant performance issue on computers
@@ -160,13 +169,29 @@ private:
 	// These functions require compiler options for SSE2, SSE, or neither, and
 	// hence are contained in separate individual .cpp files.  JC
 	static void updateGeometryOriginal(LLFace* face, LLPolyMesh* mesh);
+
+	// The SIMD versions only touch the mesh and the mapped vertex buffer
+	// region gathered here on the render thread, so they are safe to run on
+	// worker threads.
+	struct SkinGeometry
+	{
+		LLPolyMesh* mMesh;
+		LLStrider<LLVector3> mVertices;
+		LLStrider<LLVector3> mNormals;
+	};
+	static void getSkinGeometry(LLFace* face, LLPolyMesh* mesh, SkinGeometry& geom);
 	// generic vector code, used for Altivec
-	static void updateGeometryVectorized(LLFace* face, LLPolyMesh* mesh);
-	static void updateGeometrySSE(LLFace* face, LLPolyMesh* mesh);
-	static void updateGeometrySSE2(LLFace* face, LLPolyMesh* mesh);
+	static void skinGeometryVectorized(const SkinGeometry& geom);
+	static void skinGeometrySSE(const SkinGeometry& geom);
+	static void skinGeometrySSE2(const SkinGeometry& geom);
+	// SSE2, four vertices at a time over runs of identical weight
+	static void skinGeometrySSE2Runs(const SkinGeometry& geom);
+
+	// Use a fuction pointer to indicate which version we are running;
+	// NULL runs updateGeometryOriginal().
+	static void (*sSkinGeometryFunc)(const SkinGeometry& geom);
 
-	// Use a fuction pointer to indicate which version we are running.
-	static void (*sUpdateGeometryFunc)(LLFace* face, LLPolyMesh* mesh);
+	friend class LLSkinGeometryJob;
 
 private:
 	// Allocate skin data
@@ -55,6 +55,7 @@
 #include "llv4math.h"		// for LL_VECTORIZE
 #include "llv4matrix3.h"
 #include "llv4matrix4.h"
+#include "llv4skin.h"
 #include "m4math.h"
 #include "v3math.h"
 
@@ -74,17 +75,20 @@ inline void matrix_translate(LLV4Matrix4& m, const LLMatrix4* w, const LLVector3
 }
 
 // static
-void LLViewerJointMesh::updateGeometrySSE2(LLFace *face, LLPolyMesh *mesh)
+void LLViewerJointMesh::skinGeometrySSE2(const SkinGeometry& geom)
 {
 	// This cannot be a file-level static because it will be initialized
 	// before main() using SSE code, which will crash on non-SSE processors.
-	static LLV4Matrix4	sJointMat[32];
+	// It is not a function static either so meshes can be skinned on several
+	// threads at once.
+	LLV4Matrix4			joint_mat[32];
+	LLPolyMesh*			mesh		= geom.mMesh;
 	LLDynamicArray<LLJointRenderData*>& joint_data = mesh->getReferenceMesh()->mJointRenderData;
 
 	//upload joint pivots/matrices
 	for(S32 j = 0, jend = joint_data.count(); j < jend ; ++j )
 	{
-		matrix_translate(sJointMat[j], joint_data[j]->mWorldMatrix,
+		matrix_translate(joint_mat[j], joint_data[j]->mWorldMatrix,
 			joint_data[j]->mSkinJoint ?
 				joint_data[j]->mSkinJoint->mRootToJointSkinOffset
 				: joint_data[j+1]->mSkinJoint->mRootToParentJointSkinOffset);
@@ -93,12 +97,8 @@ void LLViewerJointMesh::updateGeometrySSE2(LLFace *face, LLPolyMesh *mesh)
 	F32					weight		= F32_MAX;
 	LLV4Matrix4			blend_mat;
 
-	LLStrider<LLVector3> o_vertices;
-	LLStrider<LLVector3> o_normals;
-
-	LLVertexBuffer *buffer = face->mVertexBuffer;
-	buffer->getVertexStrider(o_vertices,  mesh->mFaceVertexOffset);
-	buffer->getNormalStrider(o_normals,   mesh->mFaceVertexOffset);
+	LLStrider<LLVector3> o_vertices	= geom.mVertices;
+	LLStrider<LLVector3> o_normals	= geom.mNormals;
 
 	const F32*			weights			= mesh->getWeights();
 	const LLVector3*	coords			= mesh->getCoords();
@@ -108,7 +108,7 @@ void LLViewerJointMesh::updateGeometrySSE2(LLFace *face, LLPolyMesh *mesh)
 		if( weight != weights[index])
 		{
 			S32 joint = llfloor(weight = weights[index]);
-			blend_mat.lerp(sJointMat[joint], sJointMat[joint+1], weight - joint);
+			blend_mat.lerp(joint_mat[joint], joint_mat[joint+1], weight - joint);
 		}
 		blend_mat.multiply(coords[index], o_vertices[index]);
 		((LLV4Matrix3)blend_mat).multiply(normals[index], o_normals[index]);
@@ -117,11 +117,49 @@ void LLViewerJointMesh::updateGeometrySSE2(LLFace *face, LLPolyMesh *mesh)
 	//setBuffer(0) called in LLVOAvatar::renderSkinned
 }
 
+// static
+void LLViewerJointMesh::skinGeometrySSE2Runs(const SkinGeometry& geom)
+{
+	// See skinGeometrySSE2() for why this lives on the stack.
+	LLV4Matrix4			joint_mat[32];
+	LLPolyMesh*			mesh		= geom.mMesh;
+	LLDynamicArray<LLJointRenderData*>& joint_data = mesh->getReferenceMesh()->mJointRenderData;
+
+	//upload joint pivots/matrices
+	for(S32 j = 0, jend = joint_data.count(); j < jend ; ++j )
+	{
+		matrix_translate(joint_mat[j], joint_data[j]->mWorldMatrix,
+			joint_data[j]->mSkinJoint ?
+				joint_data[j]->mSkinJoint->mRootToJointSkinOffset
+				: joint_data[j+1]->mSkinJoint->mRootToParentJointSkinOffset);
+	}
+
+	const U32*			order		= mesh->getSkinOrder();
+	if (!order)
+	{
+		skinGeometrySSE2(geom);
+		return;
+	}
+
+	LLStrider<LLVector3> o_vertices	= geom.mVertices;
+	LLStrider<LLVector3> o_normals	= geom.mNormals;
+
+	llv4skin_runs(joint_mat, mesh->getSkinRuns(), mesh->getNumSkinRuns(), order,
+				  mesh->getCoords(), mesh->getNormals(), o_vertices, o_normals);
+
+	//setBuffer(0) called in LLVOAvatar::renderSkinned
+}
+
 #else
 
-void LLViewerJointMesh::updateGeometrySSE2(LLFace *face, LLPolyMesh *mesh)
+void LLViewerJointMesh::skinGeometrySSE2(const SkinGeometry& geom)
+{
+	LLViewerJointMesh::skinGeometryVectorized(geom);
+}
+
+void LLViewerJointMesh::skinGeometrySSE2Runs(const SkinGeometry& geom)
 {
-	LLViewerJointMesh::updateGeometryVectorized(face, mesh);
+	LLViewerJointMesh::skinGeometryVectorized(geom);
 }
 
 #endif
@@ -50,9 +50,12 @@
 // on PowerPC.
 
 // static
-void LLViewerJointMesh::updateGeometryVectorized(LLFace *face, LLPolyMesh *mesh)
+void LLViewerJointMesh::skinGeometryVectorized(const SkinGeometry& geom)
 {
-	static LLV4Matrix4	sJointMat[32];
+	// One per call rather than a function static so meshes can be skinned
+	// on several threads at once.
+	LLV4Matrix4			joint_mat[32];
+	LLPolyMesh*			mesh		= geom.mMesh;
 	LLDynamicArray<LLJointRenderData*>& joint_data = mesh->getReferenceMesh()->mJointRenderData;
 	S32 j, joint_num, joint_end = joint_data.count();
 	LLV4Vector3 pivot;
@@ -65,23 +68,19 @@ void LLViewerJointMesh::updateGeometryVectorized(LLFace *face, LLPolyMesh *mesh)
 		if (NULL == (sj = joint_data[joint_num]->mSkinJoint))
 		{
 				sj = joint_data[++joint_num]->mSkinJoint;
-				((LLV4Matrix3)(sJointMat[j] = *wm)).multiply(sj->mRootToParentJointSkinOffset, pivot);
-				sJointMat[j++].translate(pivot);
+				((LLV4Matrix3)(joint_mat[j] = *wm)).multiply(sj->mRootToParentJointSkinOffset, pivot);
+				joint_mat[j++].translate(pivot);
 				wm = joint_data[joint_num]->mWorldMatrix;
 		}
-		((LLV4Matrix3)(sJointMat[j] = *wm)).multiply(sj->mRootToJointSkinOffset, pivot);
-		sJointMat[j++].translate(pivot);
+		((LLV4Matrix3)(joint_mat[j] = *wm)).multiply(sj->mRootToJointSkinOffset, pivot);
+		joint_mat[j++].translate(pivot);
 	}
 
 	F32					weight		= F32_MAX;
 	LLV4Matrix4			blend_mat;
 
-	LLStrider<LLVector3> o_vertices;
-	LLStrider<LLVector3> o_normals;
-
-	LLVertexBuffer *buffer = face->mVertexBuffer;
-	buffer->getVertexStrider(o_vertices,  mesh->mFaceVertexOffset);
-	buffer->getNormalStrider(o_normals,   mesh->mFaceVertexOffset);
+	LLStrider<LLVector3> o_vertices	= geom.mVertices;
+	LLStrider<LLVector3> o_normals	= geom.mNormals;
 
 	const F32*			weights			= mesh->getWeights();
 	const LLVector3*	coords			= mesh->getCoords();
@@ -91,11 +90,9 @@ void LLViewerJointMesh::updateGeometryVectorized(LLFace *face, LLPolyMesh *mesh)
 		if( weight != weights[index])
 		{
 			S32 joint = llfloor(weight = weights[index]);
-			blend_mat.lerp(sJointMat[joint], sJointMat[joint+1], weight - joint);
+			blend_mat.lerp(joint_mat[joint], joint_mat[joint+1], weight - joint);
 		}
 		blend_mat.multiply(coords[index], o_vertices[index]);
 		((LLV4Matrix3)blend_mat).multiply(normals[index], o_normals[index]);
 	}
-
-	buffer->setBuffer(0);
 }
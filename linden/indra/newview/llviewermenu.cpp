@@ -172,6 +172,7 @@
 #include "llstring.h"
 #include "llsurfacepatch.h"
 #include "llimview.h"
+#include "lltexturefetch.h"
 #include "lltextureview.h"
 #include "lltool.h"
 #include "lltoolbar.h"
@@ -9350,6 +9351,24 @@ class LLAdvancedPrintTextureMemoryStats : public view_listener_t
 
 
 
+////////////////////////////////
+// EXPORT TEXTURE FETCH TRACE //
+////////////////////////////////
+
+
+class LLAdvancedExportTextureFetchTrace : public view_listener_t
+{
+	bool handleEvent(LLPointer<LLEvent> event, const LLSD& userdata)
+	{
+		LLTextureFetchTrace* trace = LLAppViewer::getTextureFetch()->getTrace();
+		trace->dumpStats();
+		trace->exportChromeTrace(gDirUtilp->getExpandedFilename(LL_PATH_LOGS, "texture_fetch_trace.json"));
+		return true;
+	}
+};
+
+
+
 //////////////////////
 // DEBUG SELECT MGR //
 //////////////////////
@@ -10957,6 +10976,7 @@ void initialize_menus()
 	addMenu(new LLAdvancedPrintSelectedObjectInfo(), "Advanced.PrintSelectedObjectInfo");
 	addMenu(new LLAdvancedPrintAgentInfo(), "Advanced.PrintAgentInfo");
 	addMenu(new LLAdvancedPrintTextureMemoryStats(), "Advanced.PrintTextureMemoryStats");
+	addMenu(new LLAdvancedExportTextureFetchTrace(), "Advanced.ExportTextureFetchTrace");
 	addMenu(new LLAdvancedToggleDebugSelectMgr(), "Advanced.ToggleDebugSelectMgr");
 	addMenu(new LLAdvancedCheckDebugSelectMgr(), "Advanced.CheckDebugSelectMgr");
 	addMenu(new LLAdvancedToggleDebugClicks(), "Advanced.ToggleDebugClicks");
@@ -69,6 +69,7 @@ LLVector4			gShinyOrigin;
 
 //object shaders
 LLGLSLShader		gObjectSimpleProgram;
+LLGLSLShader		gObjectSimpleInstancedProgram;
 LLGLSLShader		gObjectSimpleWaterProgram;
 LLGLSLShader		gObjectFullbrightProgram;
 LLGLSLShader		gObjectFullbrightWaterProgram;
@@ -135,6 +136,7 @@ LLViewerShaderMgr::LLViewerShaderMgr() :
 	mShaderList.push_back(&gWaterProgram);
 	mShaderList.push_back(&gAvatarEyeballProgram); 
 	mShaderList.push_back(&gObjectSimpleProgram);
+	mShaderList.push_back(&gObjectSimpleInstancedProgram);
 	mShaderList.push_back(&gObjectFullbrightProgram);
 	mShaderList.push_back(&gObjectFullbrightShinyProgram);
 	mShaderList.push_back(&gTerrainProgram);
@@ -470,6 +472,7 @@ void LLViewerShaderMgr::setShaders()
 void LLViewerShaderMgr::unloadShaders()
 {
 	gObjectSimpleProgram.unload();
+	gObjectSimpleInstancedProgram.unload();
 	gObjectSimpleWaterProgram.unload();
 	gObjectFullbrightProgram.unload();
 	gObjectFullbrightWaterProgram.unload();
@@ -1035,6 +1038,7 @@ BOOL LLViewerShaderMgr::loadShadersObject()
 		gObjectFullbrightShinyProgram.unload();
 		gObjectShinyWaterProgram.unload();
 		gObjectSimpleProgram.unload();
+		gObjectSimpleInstancedProgram.unload();
 		gObjectSimpleWaterProgram.unload();
 		gObjectFullbrightProgram.unload();
 		gObjectFullbrightWaterProgram.unload();
@@ -1055,6 +1059,30 @@ BOOL LLViewerShaderMgr::loadShadersObject()
 		gObjectSimpleProgram.mShaderLevel = mVertexShaderLevel[SHADER_OBJECT];
 		success = gObjectSimpleProgram.createShader(NULL, NULL);
 	}
+
+	//instanced draws need gl_InstanceIDARB; without it, or if the shader
+	//doesn't compile, identical prims stay in merged buffers (see
+	//LLVolumeGeometryManager::genInstances) and the other object shaders
+	//are still loaded
+	gObjectSimpleInstancedProgram.unload();
+	if (gGLManager.mHasDrawInstanced && success)
+	{
+		gObjectSimpleInstancedProgram.mName = "Simple Instanced Shader";
+		gObjectSimpleInstancedProgram.mFeatures.calculatesLighting = true;
+		gObjectSimpleInstancedProgram.mFeatures.calculatesAtmospherics = true;
+		gObjectSimpleInstancedProgram.mFeatures.hasGamma = true;
+		gObjectSimpleInstancedProgram.mFeatures.hasAtmospherics = true;
+		gObjectSimpleInstancedProgram.mFeatures.hasLighting = true;
+		gObjectSimpleInstancedProgram.mShaderFiles.clear();
+		gObjectSimpleInstancedProgram.mShaderFiles.push_back(make_pair("objects/simpleInstancedV.glsl", GL_VERTEX_SHADER_ARB));
+		gObjectSimpleInstancedProgram.mShaderFiles.push_back(make_pair("objects/simpleF.glsl", GL_FRAGMENT_SHADER_ARB));
+		gObjectSimpleInstancedProgram.mShaderLevel = mVertexShaderLevel[SHADER_OBJECT];
+		if (!gObjectSimpleInstancedProgram.createShader(NULL, NULL))
+		{
+			llwarns << "Failed to load " << gObjectSimpleInstancedProgram.mName << ", instancing disabled" << llendl;
+			gObjectSimpleInstancedProgram.unload();
+		}
+	}
 	
 	if (success)
 	{
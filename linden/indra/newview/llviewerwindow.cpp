@@ -75,6 +75,7 @@
 // newview includes
 #include "llagent.h"
 #include "llalertdialog.h"
+#include "llavatarupdatescheduler.h"
 #include "llbox.h"
 #include "llchatbar.h"
 #include "llconsole.h"
@@ -118,6 +119,7 @@
 #include "llimageworker.h"
 #include "llinventoryview.h"
 #include "llkeyboard.h"
+#include "llkeyframemotion.h"
 #include "lllineeditor.h"
 #include "llmenugl.h"
 #include "llmodaldialog.h"
@@ -426,6 +428,24 @@ public:
 			addText(xpos, ypos, llformat("%d Vertex Buffer Sets", LLVertexBuffer::sSetCount));
 			ypos += y_inc;
 
+			addText(xpos, ypos, llformat("%d KB Vertex Uploads", LLVertexBuffer::sUploadBytes/1024));
+			ypos += y_inc;
+
+			addText(xpos, ypos, llformat("VBO Arena: %d/%d KB in %d blocks, %.0f%% fragmented",
+				LLVertexBuffer::sStaticVBOArena.getUsedBytes()/1024, LLVertexBuffer::sStaticVBOArena.getCapacity()/1024,
+				LLVertexBuffer::sStaticVBOArena.getBlockCount(), LLVertexBuffer::sStaticVBOArena.getFragmentation()*100.f));
+			ypos += y_inc;
+
+			addText(xpos, ypos, llformat("IBO Arena: %d/%d KB in %d blocks, %.0f%% fragmented",
+				LLVertexBuffer::sStaticIBOArena.getUsedBytes()/1024, LLVertexBuffer::sStaticIBOArena.getCapacity()/1024,
+				LLVertexBuffer::sStaticIBOArena.getBlockCount(), LLVertexBuffer::sStaticIBOArena.getFragmentation()*100.f));
+			ypos += y_inc;
+
+			addText(xpos, ypos, llformat("Stream Ring: %d/%d KB", 
+				(LLVertexBuffer::sStreamVBORing.getUsedBytes() + LLVertexBuffer::sStreamIBORing.getUsedBytes())/1024,
+				(LLVertexBuffer::sStreamVBORing.getSize() + LLVertexBuffer::sStreamIBORing.getSize())/1024));
+			ypos += y_inc;
+
 			addText(xpos, ypos, llformat("%d Texture Binds", LLImageGL::sBindCount));
 			ypos += y_inc;
 
@@ -435,6 +455,16 @@ public:
 			addText(xpos, ypos, llformat("%d Render Calls", gPipeline.mBatchCount));
             ypos += y_inc;
 
+			addText(xpos, ypos, llformat("%d Merged Batches", gPipeline.mMergedBatchCount));
+			ypos += y_inc;
+
+			addText(xpos, ypos, llformat("%d Batch State Changes", gPipeline.mStateChangeCount));
+			ypos += y_inc;
+
+			addText(xpos, ypos, llformat("%d Instances Drawn, %d Shared Buffers", gPipeline.mInstanceCount,
+				LLVolumeGeometryManager::sInstanceGeometryCount));
+			ypos += y_inc;
+
 			addText(xpos, ypos, llformat("%d Matrix Ops", gPipeline.mMatrixOpCount));
 			ypos += y_inc;
 
@@ -443,6 +473,9 @@ public:
 
 			gPipeline.mTextureMatrixOps = 0;
 			gPipeline.mMatrixOpCount = 0;
+			gPipeline.mMergedBatchCount = 0;
+			gPipeline.mStateChangeCount = 0;
+			gPipeline.mInstanceCount = 0;
 
 			if (gPipeline.mBatchCount > 0)
 			{
@@ -464,12 +497,21 @@ public:
 			
 			ypos += y_inc;
 
+			addText(xpos,ypos, LLAvatarUpdateScheduler::getDebugString());
+
+			ypos += y_inc;
+
+			addText(xpos,ypos, LLKeyframeLoadQueue::getDebugString());
+
+			ypos += y_inc;
+
 			addText(xpos,ypos, llformat("%d Lights visible", LLPipeline::sVisibleLightCount));
 			
 			ypos += y_inc;
 
 			LLVertexBuffer::sBindCount = LLImageGL::sBindCount = 
 				LLVertexBuffer::sSetCount = LLImageGL::sUniqueCount = 
+				LLVertexBuffer::sUploadBytes = 
 				gPipeline.mNumVisibleNodes = LLPipeline::sVisibleLightCount = 0;
 		}
 		if (gSavedSettings.getBOOL("DebugShowRenderMatrices"))
@@ -1287,6 +1329,7 @@ LLViewerWindow::LLViewerWindow(
 	{
 		gSavedSettings.setBOOL("RenderVBOEnable", FALSE);
 	}
+	LLVertexBuffer::sUsePools = gSavedSettings.getBOOL("RenderVBOPool");
 	LLVertexBuffer::initClass(gSavedSettings.getBOOL("RenderVBOEnable"));
 
 	if (LLFeatureManager::getInstance()->isSafe()
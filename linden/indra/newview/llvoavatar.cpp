@@ -41,6 +41,7 @@
 #include "noise.h"
 
 #include "llagent.h" //  Get state values from here
+#include "llavatarupdatescheduler.h"
 #include "llviewercontrol.h"
 #include "lldrawpoolavatar.h"
 #include "lldriverparam.h"
@@ -760,7 +761,16 @@ LLVOAvatar::LLVOAvatar(const LLUUID& id,
 	mTexHairColor( NULL ),
 	mTexEyeColor( NULL ),
 	mNeedsSkin(FALSE),
+	mSkinQueued(FALSE),
+	mSkinQueuedFrame(0),
 	mUpdatePeriod(1),
+	mScheduledPeriod(1),
+	mUpdateCostMS(0.f),
+	mAnimatedFrame(0),
+	mAnimatedPeriod(1),
+	mHasAnimatedPose(FALSE),
+	mMeshTexturesDirty(FALSE),
+	mVisualParamUpdatePending(FALSE),
 //	mFullyLoadedInitialized(FALSE)
 	mPreviousFullyLoaded(FALSE),
 	mVisibleChat( FALSE ),
@@ -868,6 +878,7 @@ LLVOAvatar::LLVOAvatar(const LLUUID& id,
 	// initialize joint, mesh and shape members
 	//-------------------------------------------------------------------------
 	mRoot.setName( "mRoot" );
+	mJointHierarchy.setRoot(&mRoot);
 
 	for (LLVOAvatarDictionary::mesh_map_t::const_iterator iter = LLVOAvatarDictionary::getInstance()->getMeshes().begin();
 		 iter != LLVOAvatarDictionary::getInstance()->getMeshes().end();
@@ -1093,6 +1104,10 @@ void LLVOAvatar::markDead()
 	mVoiceVisualizer->markDead();
 
 	mBeam = NULL;
+
+	// the geometry threads may still be writing to our vertex buffer
+	finishSkinning();
+
 	LLViewerObject::markDead();
 }
 
@@ -2619,7 +2634,9 @@ BOOL LLVOAvatar::idleUpdate(LLAgent &agent, LLWorld &world, const F64 &time)
 	// animate the character
 	// store off last frame's root position to be consistent with camera position
 	LLVector3 root_pos_last = mRoot.getWorldPosition();
+	LLTimer update_timer;
 	bool detailed_update = updateCharacter(agent);
+	F32 update_ms = update_timer.getElapsedTimeF32() * 1000.f;
 	bool voice_enabled = gVoiceClient->getVoiceEnabled( mID ) && gVoiceClient->inProximalChannel();
 
 	if (gNoRender)
@@ -2638,8 +2655,20 @@ BOOL LLVOAvatar::idleUpdate(LLAgent &agent, LLWorld &world, const F64 &time)
 	}
 
 	idleUpdateVoiceVisualizer( voice_enabled );
+	update_timer.reset();
 	idleUpdateMisc( detailed_update );
+	update_ms += update_timer.getElapsedTimeF32() * 1000.f;
+
+	BOOL full_update = (mAnimatedFrame == LLDrawable::getCurrentFrame());
+	if (full_update)
+	{
+		mUpdateCostMS = mUpdateCostMS > 0.f ? lerp(mUpdateCostMS, update_ms, 0.25f) : update_ms;
+	}
+	LLAvatarUpdateScheduler::addUpdateTime(update_ms, full_update);
+
 	idleUpdateAppearanceAnimation();
+	// texture params only mark their stage dirty from setWeight()
+	updateMeshTexturesIfDirty();
 	idleUpdateBoobEffect();
 	idleUpdateLipSync( voice_enabled );
 	idleUpdateLoadingEffect();
@@ -2757,8 +2786,8 @@ void LLVOAvatar::idleUpdateMisc(bool detailed_update)
 
 	BOOL visible = isVisible() || mNeedsAnimUpdate;
 
-	// update attachments positions
-	if (detailed_update || !sUseImpostors)
+	// update attachments positions, on the frames the avatar itself moved
+	if (detailed_update || (!sUseImpostors && mScheduledPeriod <= 1))
 	{
 		LLFastTimer t(LLFastTimer::FTM_ATTACHMENT_UPDATE);
 		for (attachment_map_t::iterator iter = mAttachmentPoints.begin();
@@ -3878,7 +3907,7 @@ void LLVOAvatar::slamPosition()
 	{
 		gPipeline.updateMoveNormalAsync(mDrawable);
 	}
-	mRoot.updateWorldMatrixChildren();
+	mJointHierarchy.updateWorldMatrices();
 }
 
 //------------------------------------------------------------------------
@@ -4000,6 +4029,13 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 		return FALSE;
 	}
 
+	// small avatars are only animated every few frames, see LLAvatarUpdateScheduler
+	if (!mIsSelf && !mIsDummy && !mNeedsAnimUpdate && !sFreezeCounter && mScheduledPeriod > 1
+		&& (LLDrawable::getCurrentFrame()+mID.mData[0])%mScheduledPeriod != 0)
+	{
+		return updateScheduledSkip();
+	}
+
 	// change animation time quanta based on avatar render load
 	if (!mIsSelf && !mIsDummy)
 	{
@@ -4100,6 +4136,7 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 			mRoot.touch();
 			mRoot.setWorldPosition(newPosition ); // regular update
 		}
+		mRootOffset = newPosition - getRenderPosition();
 
 
 		//--------------------------------------------------------------------
@@ -4274,12 +4311,35 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 	// store data relevant to motions
 	mSpeed = speed;
 
+	// when scheduled at a reduced rate, the joints hold a blend of the last
+	// two updates; motions blend onto the joints, so give them back the
+	// last update's output first
+	BOOL interpolate = LLAvatarUpdateScheduler::sInterpolate && mScheduledPeriod > 1 && !mIsSelf;
+	if (interpolate || mHasAnimatedPose)
+	{
+		storePose(mPoseFromRot, mPoseFromPelvis);
+	}
+	if (mHasAnimatedPose)
+	{
+		applyPose(mPoseToRot, mPoseToPelvis);
+		mHasAnimatedPose = FALSE;
+	}
+
 	// update animations
 	if (mSpecialRenderMode == 1) // Animation Preview
 		updateMotions(LLCharacter::FORCE_UPDATE);
 	else
 		updateMotions(LLCharacter::NORMAL_UPDATE);
 
+	mAnimatedFrame = LLDrawable::getCurrentFrame();
+	mAnimatedPeriod = mScheduledPeriod;
+	if (interpolate)
+	{
+		storePose(mPoseToRot, mPoseToPelvis);
+		mHasAnimatedPose = TRUE;
+		applyInterpolatedPose();
+	}
+
 	// update head position
 	updateHeadOffset();
 
@@ -4365,7 +4425,7 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 		}
 	}
 
-	mRoot.updateWorldMatrixChildren();
+	mJointHierarchy.updateWorldMatrices();
 
 	if (!mDebugText.size() && mText.notNull())
 	{
@@ -4383,6 +4443,103 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 	return TRUE;
 }
 
+//-----------------------------------------------------------------------------
+// updateScheduledSkip()
+// A frame the scheduler has skipped: the avatar follows its object and
+// eases towards the last animated pose, without evaluating any motions.
+//-----------------------------------------------------------------------------
+BOOL LLVOAvatar::updateScheduledSkip()
+{
+	updateMotions(LLCharacter::HIDDEN_UPDATE);
+
+	BOOL moved = mHasAnimatedPose;
+	if (mIsSitting && getParent())
+	{
+		if (mDrawable.notNull() && mRoot.getPosition() != mDrawable->getPosition())
+		{
+			mRoot.setPosition(mDrawable->getPosition());
+			mRoot.setRotation(mDrawable->getRotation());
+			moved = TRUE;
+		}
+	}
+	else
+	{
+		LLVector3 new_position = getRenderPosition() + mRootOffset;
+		if (new_position != mRoot.getXform()->getWorldPosition())
+		{
+			mRoot.touch();
+			mRoot.setWorldPosition(new_position);
+			moved = TRUE;
+		}
+	}
+
+	if (!moved)
+	{
+		// same pose as last frame, nothing to reskin
+		return FALSE;
+	}
+
+	if (mHasAnimatedPose)
+	{
+		applyInterpolatedPose();
+	}
+	mJointHierarchy.updateWorldMatrices();
+	mNeedsSkin = TRUE;
+	return TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// storePose()
+//-----------------------------------------------------------------------------
+void LLVOAvatar::storePose(std::vector<LLQuaternion>& rot, LLVector3& pelvis_pos)
+{
+	rot.resize(mNumJoints);
+	for (S32 i = 0; i < mNumJoints; i++)
+	{
+		rot[i] = mSkeleton[i].getRotation();
+	}
+	pelvis_pos = mPelvisp->getPosition();
+}
+
+//-----------------------------------------------------------------------------
+// applyPose()
+//-----------------------------------------------------------------------------
+void LLVOAvatar::applyPose(const std::vector<LLQuaternion>& rot, const LLVector3& pelvis_pos)
+{
+	if (rot.size() != (U32)mNumJoints)
+	{
+		// skeleton was rebuilt
+		return;
+	}
+	for (S32 i = 0; i < mNumJoints; i++)
+	{
+		mSkeleton[i].setRotation(rot[i]);
+	}
+	mPelvisp->setPosition(pelvis_pos);
+}
+
+//-----------------------------------------------------------------------------
+// applyInterpolatedPose()
+// Blends from the pose shown when the last update ran to its output, so the
+// output is reached on the frame before the next update.
+//-----------------------------------------------------------------------------
+void LLVOAvatar::applyInterpolatedPose()
+{
+	if (mPoseFromRot.size() != (U32)mNumJoints || mPoseToRot.size() != (U32)mNumJoints)
+	{
+		mHasAnimatedPose = FALSE;
+		return;
+	}
+
+	S32 frames = LLDrawable::getCurrentFrame() - mAnimatedFrame + 1;
+	F32 u = llclamp((F32)frames / (F32)llmax(mAnimatedPeriod, 1), 0.f, 1.f);
+	for (S32 i = 0; i < mNumJoints; i++)
+	{
+		mSkeleton[i].setRotation(nlerp(u, mPoseFromRot[i], mPoseToRot[i]));
+	}
+	mPelvisp->setPosition(lerp(mPoseFromPelvis, mPoseToPelvis, u));
+}
+
 //-----------------------------------------------------------------------------
 // updateHeadOffset()
 //-----------------------------------------------------------------------------
@@ -4563,15 +4720,23 @@ BOOL LLVOAvatar::needsRenderBeam()
 }
 
 //-----------------------------------------------------------------------------
-// renderSkinned()
+// queueSkinning()
 //-----------------------------------------------------------------------------
-U32 LLVOAvatar::renderSkinned(EAvatarRenderPass pass)
+void LLVOAvatar::queueSkinning()
 {
-	U32 num_indices = 0;
-
 	if (!mIsBuilt)
 	{
-		return num_indices;
+		return;
+	}
+
+	if (mSkinQueued)
+	{
+		if (mSkinQueuedFrame == LLFrameTimer::getFrameCount())
+		{
+			return;
+		}
+		// Queued on an earlier frame but never drawn
+		finishSkinning();
 	}
 
 	if (mDirtyMesh || mDrawable->isState(LLDrawable::REBUILD_GEOMETRY))
@@ -4602,18 +4767,57 @@ U32 LLVOAvatar::renderSkinned(EAvatarRenderPass pass)
 				mMeshLOD[MESH_ID_HAIR]->updateJointGeometry();
 			}
 			mNeedsSkin = FALSE;
-
-			LLVertexBuffer* vb = mDrawable->getFace(0)->mVertexBuffer;
-			if (vb)
-			{
-				vb->setBuffer(0);
-			}
+			mSkinQueued = TRUE;
+			mSkinQueuedFrame = LLFrameTimer::getFrameCount();
 		}
 	}
 	else
 	{
 		mNeedsSkin = FALSE;
 	}
+}
+
+//-----------------------------------------------------------------------------
+// finishSkinning()
+//-----------------------------------------------------------------------------
+void LLVOAvatar::finishSkinning()
+{
+	if (mSkinQueued)
+	{
+		// Skinning may still be running on the geometry threads.  Only wait
+		// for our own meshes; without a buffer to match, finish them all.
+		LLFace* face = mDrawable.notNull() ? mDrawable->getFace(0) : NULL;
+		LLViewerJointMesh::finishSkinning(face ? face->mVertexBuffer.get() : NULL);
+		mSkinQueued = FALSE;
+	}
+}
+
+//static
+void LLVOAvatar::finishAllSkinning()
+{
+	for (std::vector<LLCharacter*>::iterator iter = LLCharacter::sInstances.begin();
+		iter != LLCharacter::sInstances.end(); ++iter)
+	{
+		((LLVOAvatar*) *iter)->finishSkinning();
+	}
+	// anything queued for a buffer no avatar still points at
+	LLViewerJointMesh::finishSkinning(NULL);
+}
+
+//-----------------------------------------------------------------------------
+// renderSkinned()
+//-----------------------------------------------------------------------------
+U32 LLVOAvatar::renderSkinned(EAvatarRenderPass pass)
+{
+	U32 num_indices = 0;
+
+	if (!mIsBuilt)
+	{
+		return num_indices;
+	}
+
+	queueSkinning();
+	finishSkinning();
 
 	if (sDebugInvisible)
 	{
@@ -6093,6 +6297,8 @@ BOOL LLVOAvatar::loadMeshNodes()
 //-----------------------------------------------------------------------------
 void LLVOAvatar::updateVisualParams()
 {
+	mVisualParamUpdatePending = FALSE;
+
 	if (gNoRender)
 	{
 		return;
@@ -6100,17 +6306,33 @@ void LLVOAvatar::updateVisualParams()
 
 	setSex( (getVisualParamWeight( "male" ) > 0.5f) ? SEX_MALE : SEX_FEMALE );
 
-	LLCharacter::updateVisualParams();
+	BOOL cache_morphs = applyCachedMorphs();
+
+	// only redo the stages fed by params that actually changed
+	U32 stages = applyVisualParams();
+	if (cache_morphs)
+	{
+		cacheMorphs();
+	}
 
 	if (mLastSkeletonSerialNum != mSkeletonSerialNum)
 	{
 		computeBodySize();
 		mLastSkeletonSerialNum = mSkeletonSerialNum;
-		mRoot.updateWorldMatrixChildren();
+		mJointHierarchy.updateWorldMatrices();
+		stages |= VISUAL_PARAM_STAGE_SKELETON;
 	}
 
-	dirtyMesh();
-	updateHeadOffset();
+	if (stages & (VISUAL_PARAM_STAGE_MORPH | VISUAL_PARAM_STAGE_SKELETON))
+	{
+		dirtyMesh();
+	}
+	if (stages & VISUAL_PARAM_STAGE_SKELETON)
+	{
+		updateHeadOffset();
+	}
+
+	updateMeshTexturesIfDirty();
 }
 
 //-----------------------------------------------------------------------------
@@ -6372,6 +6594,73 @@ void LLVOAvatar::updateSexDependentLayerSets( BOOL set_by_user )
 	updateMeshTextures();
 }
 
+//-----------------------------------------------------------------------------
+// applyCachedMorphs()
+//-----------------------------------------------------------------------------
+BOOL LLVOAvatar::applyCachedMorphs()
+{
+	U32 cache_size = gSavedSettings.getU32("AvatarMorphCacheSize");
+	LLPolyMesh::setAppearanceCacheSize(cache_size * 1024 * 1024);
+	if (!cache_size)
+	{
+		return FALSE;
+	}
+
+	// Shared params chain morph targets across meshes, so it's all or
+	// nothing: either every mesh comes from the cache or none does.
+	ESex sex = getSex();
+	BOOL needs_morph = FALSE;
+	BOOL all_cached = TRUE;
+	std::vector<std::pair<LLPolyMesh*, U64> > hashes;
+	for (polymesh_map_t::iterator iter = mMeshes.begin(); iter != mMeshes.end(); ++iter)
+	{
+		LLPolyMesh* mesh = iter->second;
+		if (mesh->isLOD() || !mesh->hasMorphTargets())
+		{
+			continue;
+		}
+		U64 hash;
+		if (!mesh->getAppearanceHash(sex, FALSE, hash))
+		{
+			return FALSE;
+		}
+		needs_morph = needs_morph || mesh->needsMorph(sex);
+		all_cached = all_cached && mesh->hasCachedAppearance(hash);
+		hashes.push_back(std::make_pair(mesh, hash));
+	}
+
+	if (!needs_morph || !all_cached)
+	{
+		return needs_morph;
+	}
+
+	for (U32 i = 0; i < hashes.size(); i++)
+	{
+		hashes[i].first->applyCachedAppearance(hashes[i].second, sex);
+	}
+	// the restored morphs skip apply(), so dirty the mesh stage here
+	dirtyMesh();
+	return FALSE;
+}
+
+//-----------------------------------------------------------------------------
+// cacheMorphs()
+//-----------------------------------------------------------------------------
+void LLVOAvatar::cacheMorphs()
+{
+	ESex sex = getSex();
+	for (polymesh_map_t::iterator iter = mMeshes.begin(); iter != mMeshes.end(); ++iter)
+	{
+		LLPolyMesh* mesh = iter->second;
+		U64 hash;
+		if (!mesh->isLOD() && mesh->hasMorphTargets()
+			&& mesh->getAppearanceHash(sex, TRUE, hash))
+		{
+			mesh->cacheAppearance(hash);
+		}
+	}
+}
+
 //-----------------------------------------------------------------------------
 // dirtyMesh()
 //-----------------------------------------------------------------------------
@@ -6625,7 +6914,7 @@ void LLVOAvatar::sitOnObject(LLViewerObject *sit_object)
 // [/RLVa:KB]
 	mRoot.getXform()->setParent(&sit_object->mDrawable->mXform); // LLVOAvatar::sitOnObject
 	mRoot.setPosition(getPosition());
-	mRoot.updateWorldMatrixChildren();
+	mJointHierarchy.updateWorldMatrices();
 
 	stopMotion(ANIM_AGENT_BODY_NOISE);
 
@@ -6985,7 +7274,7 @@ void LLVOAvatar::onGlobalColorChanged( LLTexGlobalColor* global_color, BOOL set_
 //		llinfos << "invalidateComposite cause: onGlobalColorChanged( eyecolor )" << llendl;
 		invalidateComposite( mBakedTextureData[BAKED_EYES].mTexLayerSet,  set_by_user );
 	}
-	updateMeshTextures();
+	dirtyMeshTextures();
 }
 
 void LLVOAvatar::forceBakeAllTextures(bool slam_for_debug)
@@ -7433,9 +7722,18 @@ void LLVOAvatar::setupComposites()
 // updateMeshTextures()
 // Uses the current TE values to set the meshes' and layersets' textures.
 //-----------------------------------------------------------------------------
+void LLVOAvatar::updateMeshTexturesIfDirty()
+{
+	if (mMeshTexturesDirty)
+	{
+		updateMeshTextures();
+	}
+}
+
 void LLVOAvatar::updateMeshTextures()
 {
     // llinfos << "updateMeshTextures" << llendl;
+	mMeshTexturesDirty = FALSE;
 	if (gNoRender) return;
 
 	// if user has never specified a texture, assign the default
@@ -8510,7 +8808,18 @@ void LLVOAvatar::processAvatarAppearance( LLMessageSystem* mesgsys )
 			{
 				startAppearanceAnimation(FALSE, FALSE);
 			}
-			updateVisualParams();
+			if (mIsSelf)
+			{
+				updateVisualParams();
+			}
+			else
+			{
+				// Layer sets depend on sex, so settle it now; the mesh and
+				// skeleton stages wait for LLAvatarUpdateScheduler, which
+				// coalesces a burst of appearance messages into one update.
+				setSex( (getVisualParamWeight( "male" ) > 0.5f) ? SEX_MALE : SEX_FEMALE );
+				requestVisualParamUpdate();
+			}
 
 			ESex new_sex = getSex();
 			if( old_sex != new_sex )
@@ -8524,6 +8833,7 @@ void LLVOAvatar::processAvatarAppearance( LLMessageSystem* mesgsys )
 		llwarns << "AvatarAppearance msg received without any parameters, object: " << getID() << llendl;
 	}
 
+	updateMeshTexturesIfDirty();
 	setCompositeUpdatesEnabled( TRUE );
 
 	llassert( getSex() == ((getVisualParamWeight( "male" ) > 0.5f) ? SEX_MALE : SEX_FEMALE) );
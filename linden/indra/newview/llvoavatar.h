@@ -43,6 +43,7 @@
 #include "lldrawpoolalpha.h"
 #include "llviewerobject.h"
 #include "llcharacter.h"
+#include "lljointhierarchy.h"
 #include "llviewerjointmesh.h"
 #include "llviewerjointattachment.h"
 #include "llrendertarget.h"
@@ -123,6 +124,13 @@ public:
 	U32 renderImpostor(LLColor4U color = LLColor4U(255,255,255,255));
 	U32 renderRigid();
 	U32 renderSkinned(EAvatarRenderPass pass);
+	// Starts updating the skinned vertices renderSkinned() will draw, on the
+	// geometry threads when they are running; finishSkinning() waits for
+	// them and unmaps the vertex buffer.  finishAllSkinning() does that for
+	// avatars that were queued but not drawn.
+	void queueSkinning();
+	void finishSkinning();
+	static void finishAllSkinning();
 	U32 renderTransparent(BOOL first_pass);
 	void renderCollisionVolumes();
 	
@@ -272,6 +280,10 @@ public:
 	void updateSexDependentLayerSets( BOOL set_by_user );
 	void dirtyMesh(); // Dirty the avatar mesh
 	void hideSkirt();
+	// Restores morphed meshes from LLPolyMesh's appearance cache; returns
+	// TRUE if the morphs still need applying and the result is worth caching
+	BOOL applyCachedMorphs();
+	void cacheMorphs();
 
 	virtual void setParent(LLViewerObject* parent);
 	virtual void addChild(LLViewerObject *childp);
@@ -588,6 +600,7 @@ public:
 	LLFrameTimer	mTimeInAir;
 	LLVector3 mHeadOffset; // current head position
 	LLViewerJoint mRoot; // avatar skeleton
+	LLJointHierarchy mJointHierarchy; // mRoot flattened for updating world matrices
 	BOOL mIsSitting; // sitting state
 
 	static bool updateClientTags();
@@ -704,8 +717,47 @@ private:
 	LLTexGlobalColor*	mTexEyeColor;
 
 	BOOL				mNeedsSkin;  //if TRUE, avatar has been animated and verts have not been updated
+	BOOL				mSkinQueued; //if TRUE, verts are being updated and the vertex buffer is still mapped
+	U32					mSkinQueuedFrame;
 	S32					mUpdatePeriod;
 
+	//--------------------------------------------------------------------
+	// Update scheduling, see LLAvatarUpdateScheduler
+	//--------------------------------------------------------------------
+public:
+	S32					getScheduledPeriod() const			{ return mScheduledPeriod; }
+	void				setScheduledPeriod(S32 period)		{ mScheduledPeriod = period; }
+	F32					getUpdateCost() const				{ return mUpdateCostMS; }
+private:
+	BOOL				updateScheduledSkip();
+	void				storePose(std::vector<LLQuaternion>& rot, LLVector3& pelvis_pos);
+	void				applyPose(const std::vector<LLQuaternion>& rot, const LLVector3& pelvis_pos);
+	void				applyInterpolatedPose();
+
+	S32					mScheduledPeriod;	// frames between full updates
+	F32					mUpdateCostMS;		// smoothed cost of a full update
+	S32					mAnimatedFrame;		// frame of the last full update
+	S32					mAnimatedPeriod;	// mScheduledPeriod at that update
+	BOOL				mHasAnimatedPose;	// mPoseTo* hold the motion output
+	std::vector<LLQuaternion> mPoseFromRot;	// displayed when the last update ran
+	std::vector<LLQuaternion> mPoseToRot;	// output of the last update
+	LLVector3			mPoseFromPelvis;
+	LLVector3			mPoseToPelvis;
+	LLVector3			mRootOffset;		// mRoot relative to the render position
+
+	//--------------------------------------------------------------------
+	// Batched appearance application, see LLAvatarUpdateScheduler
+	//--------------------------------------------------------------------
+public:
+	void				dirtyMeshTextures()					{ mMeshTexturesDirty = TRUE; }
+	void				updateMeshTexturesIfDirty();
+	// Coalesces updateVisualParams() calls until the scheduler runs it
+	void				requestVisualParamUpdate()			{ mVisualParamUpdatePending = TRUE; }
+	BOOL				isVisualParamUpdatePending() const	{ return mVisualParamUpdatePending; }
+private:
+	BOOL				mMeshTexturesDirty;			// texture stage needs updateMeshTextures()
+	BOOL				mVisualParamUpdatePending;	// params set but not yet applied
+
 	//--------------------------------------------------------------------
 	// Internal functions
 	//--------------------------------------------------------------------
@@ -59,9 +59,12 @@
 #include "llviewercamera.h"
 #include "llviewerimagelist.h"
 #include "llviewerregion.h"
+#include "llviewershadermgr.h"
 #include "llviewertextureanim.h"
 #include "llworld.h"
 #include "llselectmgr.h"
+#include "llappviewer.h"
+#include "llthreadpool.h"
 #include "pipeline.h"
 
 const S32 MIN_QUIET_FRAMES_COALESCE = 30;
@@ -2184,6 +2187,140 @@ void LLVolumeGeometryManager::registerFace(LLSpatialGroup* group, LLFace* facep,
 	}
 }
 
+//----------------------------------------------------------------------------
+// Volume face geometry is packed into mapped vertex buffers by the geometry
+// worker threads.  The render thread works out everything that needs the
+// face, drawable, texture or GL state in LLFace::getGeometryVolume and queues
+// the rest; flushVolumeGeometry() hands the queue out in batches of roughly
+// GEOMETRY_JOB_VERTICES vertices and blocks until all of it is written, so
+// buffers are only ever unmapped (and uploaded) on the render thread.
+// Buffers filled while geometry is queued must stay mapped until then: a
+// pooled buffer uploads its client copy on unmap, so unmapping early would
+// upload it unwritten.  unmapVolumeBuffer() defers those to the flush.
+
+const U32 GEOMETRY_JOB_VERTICES = 8192;
+
+class LLVolumeGeometryJob : public LLThreadPool::Job
+{
+public:
+	LLVolumeGeometryJob(LLFace::VolumeGeometry* begin, LLFace::VolumeGeometry* end)
+		: mBegin(begin), mEnd(end) { }
+
+	/*virtual*/ void run()
+	{
+		for (LLFace::VolumeGeometry* geom = mBegin; geom != mEnd; ++geom)
+		{
+			LLFace::fillGeometryVolume(*geom);
+		}
+	}
+
+private:
+	LLFace::VolumeGeometry* mBegin;
+	LLFace::VolumeGeometry* mEnd;
+};
+
+static std::vector<LLFace::VolumeGeometry> sQueuedGeometry;
+static std::vector<LLVolumeGeometryJob> sGeometryJobs;
+static std::vector<LLPointer<LLVertexBuffer> > sQueuedBuffers;
+static U32 sQueuedVertices = 0;
+
+static BOOL queueVolumeGeometry(LLFace* facep, const LLVolume& volume, const S32 f,
+								const LLMatrix4& mat_vert, const LLMatrix3& mat_normal, const U16 index_offset)
+{
+	LLThreadPool* pool = LLAppViewer::getGeometryThreads();
+	if (!pool || !pool->getThreaded())
+	{
+		return facep->getGeometryVolume(volume, f, mat_vert, mat_normal, index_offset);
+	}
+
+	sQueuedGeometry.push_back(LLFace::VolumeGeometry());
+	if (!facep->getGeometryVolume(volume, f, mat_vert, mat_normal, index_offset, &sQueuedGeometry.back()))
+	{
+		sQueuedGeometry.pop_back();
+		return FALSE;
+	}
+	sQueuedVertices += sQueuedGeometry.back().mNumVertices;
+	return TRUE;
+}
+
+static void unmapVolumeBuffer(LLVertexBuffer* buffer)
+{
+	if (sQueuedGeometry.empty())
+	{
+		buffer->setBuffer(0);
+	}
+	else
+	{
+		sQueuedBuffers.push_back(buffer);
+	}
+}
+
+static void flushVolumeGeometry()
+{
+	if (sQueuedGeometry.empty())
+	{
+		llassert(sQueuedBuffers.empty());
+		return;
+	}
+
+	LLThreadPool* pool = LLAppViewer::getGeometryThreads();
+	if (!pool || sQueuedVertices <= GEOMETRY_JOB_VERTICES)
+	{ //not worth a round trip through the workers
+		for (U32 i = 0; i < sQueuedGeometry.size(); i++)
+		{
+			LLFace::fillGeometryVolume(sQueuedGeometry[i]);
+		}
+	}
+	else
+	{
+		LLFace::VolumeGeometry* first = &sQueuedGeometry[0];
+		LLFace::VolumeGeometry* last = first + sQueuedGeometry.size();
+
+		sGeometryJobs.clear();
+		U32 batch_vertices = 0;
+		LLFace::VolumeGeometry* batch_start = first;
+		for (LLFace::VolumeGeometry* geom = first; geom != last; ++geom)
+		{
+			batch_vertices += geom->mNumVertices;
+			if (batch_vertices >= GEOMETRY_JOB_VERTICES)
+			{
+				sGeometryJobs.push_back(LLVolumeGeometryJob(batch_start, geom+1));
+				batch_start = geom+1;
+				batch_vertices = 0;
+			}
+		}
+		if (batch_start != last)
+		{
+			sGeometryJobs.push_back(LLVolumeGeometryJob(batch_start, last));
+		}
+
+		// jobs must not move once queued
+		for (U32 i = 0; i < sGeometryJobs.size(); i++)
+		{
+			pool->addJob(&sGeometryJobs[i]);
+		}
+		// only wait for our own jobs, avatar skinning may share the pool
+		for (U32 i = 0; i < sGeometryJobs.size(); i++)
+		{
+			pool->waitForJob(&sGeometryJobs[i]);
+		}
+		sGeometryJobs.clear();
+	}
+
+	sQueuedGeometry.clear();
+	sQueuedVertices = 0;
+
+	//every writer is done, the buffers can be uploaded now
+	for (U32 i = 0; i < sQueuedBuffers.size(); i++)
+	{
+		if (sQueuedBuffers[i]->isLocked())
+		{
+			sQueuedBuffers[i]->setBuffer(0);
+		}
+	}
+	sQueuedBuffers.clear();
+}
+
 void LLVolumeGeometryManager::getGeometry(LLSpatialGroup* group)
 {
 
@@ -2392,11 +2529,14 @@ void LLVolumeGeometryManager::rebuildGeom(LLSpatialGroup* group)
 		bump_mask |= LLVertexBuffer::MAP_BINORMAL;
 	}
 
+	genInstances(group, simple_mask, simple_faces);
 	genDrawInfo(group, simple_mask, simple_faces);
 	genDrawInfo(group, bump_mask, bump_faces);
 	genDrawInfo(group, fullbright_mask, fullbright_faces);
 	genDrawInfo(group, alpha_mask, alpha_faces, TRUE);
 
+	flushVolumeGeometry();
+
 	if (!LLPipeline::sDelayVBUpdate)
 	{
 		//drawables have been rebuilt, clear rebuild status
@@ -2446,7 +2586,16 @@ void LLVolumeGeometryManager::rebuildMesh(LLSpatialGroup* group)
 					LLFace* face = drawablep->getFace(i);
 					if (face && face->mVertexBuffer.notNull())
 					{
-						face->getGeometryVolume(*volume, face->getTEOffset(), 
+						if (face->isState(LLFace::INSTANCED))
+						{ //shared geometry is never rewritten in place, regroup if it no longer matches
+							if (face->mVertexBuffer != getInstanceGeometry(face, face->mVertexBuffer->getTypeMask(), FALSE))
+							{
+								group->dirtyGeom();
+							}
+							continue;
+						}
+
+						queueVolumeGeometry(face, *volume, face->getTEOffset(), 
 							vobj->getRelativeXform(), vobj->getRelativeXformInvTrans(), face->getGeomIndex());
 					}
 				}
@@ -2455,6 +2604,9 @@ void LLVolumeGeometryManager::rebuildMesh(LLSpatialGroup* group)
 			}
 		}
 		
+		//wait for the workers before anything is unmapped
+		flushVolumeGeometry();
+
 		//unmap all the buffers
 		for (LLSpatialGroup::buffer_map_t::iterator i = group->mBufferMap.begin(); i != group->mBufferMap.end(); ++i)
 		{
@@ -2620,6 +2772,7 @@ void LLVolumeGeometryManager::genDrawInfo(LLSpatialGroup* group, U32 mask, std::
 			facep->mIndicesIndex = indices_index;
 			facep->mGeomIndex = index_offset;
 			facep->mVertexBuffer = buffer;
+			facep->clearState(LLFace::INSTANCED);
 			{
 				facep->updateRebuildFlags();
 				if (!LLPipeline::sDelayVBUpdate)
@@ -2630,7 +2783,7 @@ void LLVolumeGeometryManager::genDrawInfo(LLSpatialGroup* group, U32 mask, std::
 
 					U32 te_idx = facep->getTEOffset();
 
-					if (facep->getGeometryVolume(*volume, te_idx, 
+					if (queueVolumeGeometry(facep, *volume, te_idx, 
 						vobj->getRelativeXform(), vobj->getRelativeXformInvTrans(), index_offset))
 					{
 						buffer->markDirty(facep->getGeomIndex(), facep->getGeomCount(), 
@@ -2756,7 +2909,7 @@ void LLVolumeGeometryManager::genDrawInfo(LLSpatialGroup* group, U32 mask, std::
 			++face_iter;
 		}
 
-		buffer->setBuffer(0);
+		unmapVolumeBuffer(buffer);
 	}
 
 	group->mBufferMap[mask].clear();
@@ -2766,6 +2919,276 @@ void LLVolumeGeometryManager::genDrawInfo(LLSpatialGroup* group, U32 mask, std::
 	}
 }
 
+//----------------------------------------------------------------------------
+// Instancing.  Static prims with the same LLVolume (LLVolumeMgr hands out one
+// per volume params and detail level) and the same texture entry produce
+// identical geometry up to their relative transform.  Each such volume face
+// is generated once, in volume space, into a buffer shared by every group
+// that draws it, and the group draws it once per instance.
+
+typedef std::pair<const LLVolume*, S32> instance_key_t;
+
+struct LLInstanceGeometry
+{
+	LLPointer<LLVolume> mVolume; //keep the key's volume from being recycled
+	LLTextureEntry mTE;
+	LLPointer<LLVertexBuffer> mBuffer;
+};
+
+typedef std::multimap<instance_key_t, LLInstanceGeometry> instance_cache_t;
+static instance_cache_t sInstanceCache;
+static U32 sInstancePruneSize = 64;
+
+U32 LLVolumeGeometryManager::sInstanceGeometryCount = 0;
+
+struct CompareInstanceKey
+{
+	bool operator()(const LLFace* const& lhs, const LLFace* const& rhs)
+	{
+		const LLVolume* lhs_volume = lhs->getViewerObject()->getVolume();
+		const LLVolume* rhs_volume = rhs->getViewerObject()->getVolume();
+		if (lhs_volume != rhs_volume)
+		{
+			return lhs_volume < rhs_volume;
+		}
+		if (lhs->getTEOffset() != rhs->getTEOffset())
+		{
+			return lhs->getTEOffset() < rhs->getTEOffset();
+		}
+		return lhs->getTexture() < rhs->getTexture();
+	}
+};
+
+//static
+BOOL LLVolumeGeometryManager::canInstance(LLFace* facep)
+{
+	LLDrawable* drawablep = facep->getDrawable();
+	LLVOVolume* vobj = drawablep->getVOVolume();
+	const LLTextureEntry* te = facep->getTextureEntry();
+	LLViewerImage* tex = facep->getTexture();
+
+	//only plain lit, opaque, static faces whose vertices depend on nothing
+	//but the volume and the texture entry
+	return vobj && te && tex &&
+		!drawablep->isActive() &&
+		!vobj->isFlexible() &&
+		!vobj->isSculpted() &&
+		!vobj->isSelected() &&
+		!vobj->isHUDAttachment() &&
+		!facep->isState(LLFace::TEXTURE_ANIM) &&
+		facep->getPoolType() != LLDrawPool::POOL_ALPHA &&
+		!te->getShiny() &&
+		!te->getBumpmap() &&
+		!te->getFullbright() &&
+		te->getGlow() == 0.f &&
+		te->getTexGen() == LLTextureEntry::TEX_GEN_DEFAULT &&
+		tex->getPrimaryFormat() != GL_ALPHA &&
+		facep->getGeomCount() > 0 &&
+		facep->getIndicesCount() > 0;
+}
+
+//static
+LLVertexBuffer* LLVolumeGeometryManager::getInstanceGeometry(LLFace* facep, U32 mask, BOOL create)
+{
+	LLDrawable* drawablep = facep->getDrawable();
+	LLVolume* volume = drawablep->getVOVolume()->getVolume();
+	S32 f = facep->getTEOffset();
+	const LLTextureEntry* te = facep->getTextureEntry();
+
+	instance_key_t key(volume, f);
+	std::pair<instance_cache_t::iterator, instance_cache_t::iterator> range = sInstanceCache.equal_range(key);
+	for (instance_cache_t::iterator iter = range.first; iter != range.second; ++iter)
+	{
+		if (iter->second.mTE == *te && (U32) iter->second.mBuffer->getTypeMask() == mask)
+		{
+			return iter->second.mBuffer;
+		}
+	}
+
+	if (!create)
+	{
+		return NULL;
+	}
+
+	if (sInstanceCache.size() >= sInstancePruneSize)
+	{ //drop geometry no draw info or face refers to any more
+		for (instance_cache_t::iterator iter = sInstanceCache.begin(); iter != sInstanceCache.end(); )
+		{
+			instance_cache_t::iterator cur = iter++;
+			if (cur->second.mBuffer->getNumRefs() == 1)
+			{
+				sInstanceCache.erase(cur);
+			}
+		}
+		sInstancePruneSize = llmax((U32) 64, (U32) sInstanceCache.size() * 2);
+	}
+
+	LLPointer<LLVertexBuffer> buffer = new LLVertexBuffer(mask, GL_STATIC_DRAW_ARB);
+	buffer->allocateBuffer(facep->getGeomCount(), facep->getIndicesCount(), TRUE);
+
+	facep->mVertexBuffer = buffer;
+	facep->mGeomIndex = 0;
+	facep->mIndicesIndex = 0;
+
+	//fresh buffer, write every attribute
+	BOOL rebuild_volume = drawablep->isState(LLDrawable::REBUILD_VOLUME);
+	drawablep->setState(LLDrawable::REBUILD_VOLUME);
+
+	LLMatrix4 mat_vert;
+	LLMatrix3 mat_normal;
+	BOOL success = facep->getGeometryVolume(*volume, f, mat_vert, mat_normal, 0);
+
+	if (!rebuild_volume)
+	{
+		drawablep->clearState(LLDrawable::REBUILD_VOLUME);
+	}
+
+	buffer->setBuffer(0);
+
+	if (!success)
+	{
+		return NULL;
+	}
+
+	LLInstanceGeometry geom;
+	geom.mVolume = volume;
+	geom.mTE = *te;
+	geom.mBuffer = buffer;
+	sInstanceCache.insert(std::make_pair(key, geom));
+	sInstanceGeometryCount = sInstanceCache.size();
+
+	return buffer;
+}
+
+//static
+void LLVolumeGeometryManager::cleanupInstances()
+{
+	sInstanceCache.clear();
+	sInstanceGeometryCount = 0;
+}
+
+void LLVolumeGeometryManager::genInstances(LLSpatialGroup* group, U32 mask, std::vector<LLFace*>& faces)
+{
+	// Per instance draws cost more than the merged buffer they replace, so
+	// only instance where one glDrawElementsInstanced covers a whole batch.
+	if (LLPipeline::sRenderDeferred ||
+		!gGLManager.mHasDrawInstanced ||
+		!gObjectSimpleInstancedProgram.mProgramObject ||
+		group->mSpatialPartition->isBridge() ||
+		!gSavedSettings.getBOOL("RenderInstancing"))
+	{
+		return;
+	}
+
+	U32 min_count = (U32) llmax(gSavedSettings.getS32("RenderInstancingMinCount"), 2);
+
+	std::vector<LLFace*> candidates;
+	std::vector<LLFace*> remaining;
+	for (std::vector<LLFace*>::iterator iter = faces.begin(); iter != faces.end(); ++iter)
+	{
+		if (canInstance(*iter))
+		{
+			candidates.push_back(*iter);
+		}
+		else
+		{
+			remaining.push_back(*iter);
+		}
+	}
+
+	if (candidates.size() < min_count)
+	{
+		return;
+	}
+
+	std::sort(candidates.begin(), candidates.end(), CompareInstanceKey());
+
+	std::vector<LLFace*> instances;
+	U32 run = 0;
+	while (run < candidates.size())
+	{
+		//run of faces on the same volume face with the same texture
+		U32 run_end = run + 1;
+		while (run_end < candidates.size() && !CompareInstanceKey()(candidates[run], candidates[run_end]))
+		{
+			run_end++;
+		}
+
+		//split the run by texture entry, moving leftovers to the front
+		U32 end = run_end;
+		while (run < end)
+		{
+			const LLTextureEntry& te = *candidates[run]->getTextureEntry();
+			instances.clear();
+			U32 keep = run;
+			for (U32 i = run; i < end; i++)
+			{
+				LLFace* facep = candidates[i];
+				if (*facep->getTextureEntry() == te)
+				{
+					instances.push_back(facep);
+				}
+				else
+				{
+					candidates[keep++] = facep;
+				}
+			}
+			end = keep;
+
+			LLVertexBuffer* buffer = NULL;
+			if (instances.size() >= min_count)
+			{
+				buffer = getInstanceGeometry(instances[0], mask, TRUE);
+			}
+
+			if (!buffer)
+			{
+				remaining.insert(remaining.end(), instances.begin(), instances.end());
+				continue;
+			}
+
+			LLFace* first = instances[0];
+			LLPointer<LLDrawInfo> draw_info = new LLDrawInfo(0, first->getGeomCount()-1, first->getIndicesCount(), 0,
+				first->getTexture(), buffer);
+			draw_info->mGroup = group;
+			draw_info->mModelMatrix = &(first->getDrawable()->getRegion()->mRenderMatrix);
+			draw_info->mGlowColor.setVec(0,0,0,0);
+			draw_info->mExtents[0] = first->mExtents[0];
+			draw_info->mExtents[1] = first->mExtents[1];
+			draw_info->mVSize = 0.f;
+			draw_info->mInstances.resize(instances.size());
+
+			for (U32 i = 0; i < instances.size(); i++)
+			{
+				LLFace* facep = instances[i];
+				LLVOVolume* vobj = facep->getDrawable()->getVOVolume();
+
+				draw_info->mInstances[i].mMatrix = vobj->getRelativeXform();
+				draw_info->mInstances[i].mNormalMatrix = vobj->getRelativeXformInvTrans();
+				draw_info->mVSize = llmax(draw_info->mVSize, facep->getVirtualSize());
+				update_min_max(draw_info->mExtents[0], draw_info->mExtents[1], facep->mExtents[0]);
+				update_min_max(draw_info->mExtents[0], draw_info->mExtents[1], facep->mExtents[1]);
+
+				//faces point at the shared geometry so picking and selection
+				//can draw them with their own transform
+				facep->mVertexBuffer = buffer;
+				facep->mGeomIndex = 0;
+				facep->mIndicesIndex = 0;
+				facep->mLastVertexBuffer = NULL;
+				facep->setState(LLFace::INSTANCED);
+				facep->setPoolType(LLDrawPool::POOL_SIMPLE);
+			}
+
+			validate_draw_info(*draw_info);
+			group->mDrawMap[LLRenderPass::PASS_SIMPLE_INSTANCED].push_back(draw_info);
+		}
+
+		run = run_end;
+	}
+
+	faces.swap(remaining);
+}
+
 void LLGeometryManager::addGeometryCount(LLSpatialGroup* group, U32 &vertex_count, U32 &index_count)
 {	
 	//initialize to default usage for this partition
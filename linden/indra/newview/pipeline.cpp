@@ -277,6 +277,9 @@ void addDeferredAttachments(LLRenderTarget& target)
 LLPipeline::LLPipeline() :
 	mBackfaceCull(FALSE),
 	mBatchCount(0),
+	mMergedBatchCount(0),
+	mStateChangeCount(0),
+	mInstanceCount(0),
 	mMatrixOpCount(0),
 	mTextureMatrixOps(0),
 	mMaxBatchSize(0),
@@ -429,6 +432,8 @@ void LLPipeline::cleanup()
 	//delete mWLSkyPool;
 	mWLSkyPool = NULL;
 
+	LLVolumeGeometryManager::cleanupInstances();
+
 	releaseGLBuffers();
 
 	mBloomImagep = NULL;
@@ -1105,6 +1110,7 @@ void LLPipeline::resetFrameStats()
 	mLightingChanges = 0;
 	mGeometryChanges = 0;
 	mNumVisibleFaces = 0;
+	LLMergedBatch::resetFrameState();
 
 	if (mOldRenderDebugMask != mRenderDebugMask)
 	{
@@ -2283,17 +2289,10 @@ void LLPipeline::postSort(LLCamera& camera)
 		
 	if (!sShadowRender)
 	{
-		//sort by texture or bump map
+		//sort by bump map, texture, matrix and vertex buffer
 		for (U32 i = 0; i < LLRenderPass::NUM_RENDER_TYPES; ++i)
 		{
-			if (i == LLRenderPass::PASS_BUMP)
-			{
-				std::sort(sCull->beginRenderMap(i), sCull->endRenderMap(i), LLDrawInfo::CompareBump());
-			}
-			else 
-			{
-				std::sort(sCull->beginRenderMap(i), sCull->endRenderMap(i), LLDrawInfo::CompareTexturePtrMatrix());
-			}	
+			sCull->sortRenderMap(i);
 		}
 
 		std::sort(sCull->beginAlphaGroups(), sCull->endAlphaGroups(), LLSpatialGroup::CompareDepthGreater());
@@ -2681,6 +2680,10 @@ void LLPipeline::renderGeom(LLCamera& camera, BOOL forceVBOUpdate)
 	
 	LLAppViewer::instance()->pingMainloopTimeout("Pipeline:RenderDrawPoolsEnd");
 
+	// Don't leave avatar buffers mapped if an avatar queued in prerender()
+	// wasn't drawn after all
+	LLVOAvatar::finishAllSkinning();
+
 	LLVertexBuffer::unbind();
 		
 		gGLLastMatrix = NULL;
@@ -4864,6 +4867,8 @@ void LLPipeline::resetVertexBuffers()
 
 	gSky.resetVertexBuffers();
 
+	LLVolumeGeometryManager::cleanupInstances();
+
 	if (LLVertexBuffer::sGLCount > 0)
 	{
 		LLVertexBuffer::cleanupClass();
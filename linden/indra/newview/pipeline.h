@@ -376,6 +376,9 @@ public:
 
 	BOOL					 mBackfaceCull;
 	S32						 mBatchCount;
+	S32						 mMergedBatchCount;
+	S32						 mStateChangeCount;
+	S32						 mInstanceCount;
 	S32						 mMatrixOpCount;
 	S32						 mTextureMatrixOps;
 	S32						 mMaxBatchSize;
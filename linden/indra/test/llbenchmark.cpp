@@ -0,0 +1,109 @@
+/** 
+ * @file llbenchmark.cpp
+ * @brief Entry point for the standalone benchmark executable
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "llbenchmark.h"
+
+#include <iostream>
+#include "llapr.h"
+
+LLBenchmark::LLBenchmark(const std::string& name)
+:	mName(name),
+	mFailed(false)
+{
+	getRegistry().push_back(this);
+}
+
+LLBenchmark::~LLBenchmark()
+{
+}
+
+void LLBenchmark::report(const std::string& label, F64 seconds, U32 passes)
+{
+	std::cout << "  " << label << ": " << seconds * 1000.0 << " ms total, "
+			  << (passes ? seconds * 1000.0 / passes : 0.0) << " ms per pass ("
+			  << passes << " passes)" << std::endl;
+}
+
+void LLBenchmark::check(bool condition, const std::string& message)
+{
+	if (!condition && !mFailed)
+	{
+		std::cout << "  FAILED: " << message << std::endl;
+		mFailed = true;
+	}
+}
+
+// static
+std::vector<LLBenchmark*>& LLBenchmark::getRegistry()
+{
+	static std::vector<LLBenchmark*> registry;
+	return registry;
+}
+
+// static
+S32 LLBenchmark::runAll(const std::string& prefix)
+{
+	S32 failures = 0;
+	std::vector<LLBenchmark*>& registry = getRegistry();
+	for (U32 i = 0; i < registry.size(); i++)
+	{
+		LLBenchmark* bench = registry[i];
+		if (bench->getName().compare(0, prefix.size(), prefix) != 0)
+		{
+			continue;
+		}
+
+		std::cout << bench->getName() << std::endl;
+		bench->run();
+		if (bench->mFailed)
+		{
+			failures++;
+		}
+	}
+	return failures;
+}
+
+int main(int argc, char** argv)
+{
+	std::string prefix;
+	if (argc > 1)
+	{
+		prefix = argv[1];
+	}
+
+	// threaded benchmarks need APR
+	ll_init_apr();
+	S32 failures = LLBenchmark::runAll(prefix);
+	ll_cleanup_apr();
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+/** 
+ * @file llbenchmark.h
+ * @brief Registry and timing helpers for the standalone benchmark executable
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLBENCHMARK_H
+#define LL_LLBENCHMARK_H
+
+#include "stdtypes.h"
+#include <string>
+#include <vector>
+
+// Benchmarks are kept out of the unit tests so that the test run stays
+// fast and deterministic.  Each benchmark is a static LLBenchmark
+// instance; the benchmark executable runs every registered benchmark, or
+// only those whose name starts with its first argument, and prints the
+// timings.  Nothing is asserted beyond the benchmark's own sanity checks,
+// and numbers are only comparable between runs on the same machine.
+
+class LLBenchmark
+{
+public:
+	LLBenchmark(const std::string& name);
+	virtual ~LLBenchmark();
+
+	const std::string& getName() const		{ return mName; }
+
+	virtual void run() = 0;
+
+	// Prints one result line: total seconds over passes and the per pass
+	// average in milliseconds.
+	void report(const std::string& label, F64 seconds, U32 passes);
+
+	// Aborts the run with message if a benchmark's two sides disagree.
+	void check(bool condition, const std::string& message);
+
+	static S32 runAll(const std::string& prefix);
+
+private:
+	std::string mName;
+	bool mFailed;
+
+	static std::vector<LLBenchmark*>& getRegistry();
+};
+
+#endif
@@ -0,0 +1,152 @@
+/** 
+ * @file llbucketqueue_bench.cpp
+ * @brief Texture priority queue timings for LLBucketQueue against std::set
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "llbenchmark.h"
+
+#include <set>
+#include <sstream>
+#include "llbucketqueue.h"
+#include "llrand.h"
+#include "lltimer.h"
+
+namespace
+{
+	struct QueueItem
+	{
+		QueueItem() : mPriority(0.f) { }
+
+		F32 mPriority;
+		LLBucketQueueHandle mHandle;
+	};
+
+	struct ItemHandle
+	{
+		LLBucketQueueHandle& operator()(QueueItem* item) const	{ return item->mHandle; }
+	};
+
+	// the ordering LLViewerImageList used before the bucket queue
+	struct ComparePriority
+	{
+		bool operator()(const QueueItem* lhs, const QueueItem* rhs) const
+		{
+			if (lhs->mPriority != rhs->mPriority)
+			{
+				return lhs->mPriority > rhs->mPriority;
+			}
+			return lhs < rhs;
+		}
+	};
+
+	typedef LLBucketQueue<QueueItem*, ItemHandle> item_queue;
+	typedef std::set<QueueItem*, ComparePriority> item_set;
+
+	// One simulated frame of LLViewerImageList: reprioritize a tenth of the
+	// images, then take the 32 highest in exact order for fetching.  Both
+	// containers see the same priority changes and return the same top 32.
+	class BucketQueueBenchmark : public LLBenchmark
+	{
+	public:
+		BucketQueueBenchmark() : LLBenchmark("texture priority queue") { }
+
+		virtual void run()
+		{
+			const U32 counts[] = { 5000, 20000, 50000 };
+			const U32 frames = 100;
+			const U32 top_count = 32;
+
+			for (U32 c = 0; c < 3; c++)
+			{
+				U32 count = counts[c];
+				std::vector<QueueItem> items(count);
+				item_queue queue;
+				item_set sorted;
+				for (U32 i = 0; i < count; i++)
+				{
+					items[i].mPriority = ll_frand(6000000.f);
+					queue.insert(&items[i], items[i].mPriority);
+					sorted.insert(&items[i]);
+				}
+
+				F64 set_time = 0.0;
+				F64 queue_time = 0.0;
+				LLTimer timer;
+				std::vector<QueueItem*> set_top;
+				std::vector<QueueItem*> queue_top;
+
+				for (U32 frame = 0; frame < frames; frame++)
+				{
+					std::vector<std::pair<QueueItem*, F32> > changes;
+					for (U32 i = 0; i < count / 10; i++)
+					{
+						QueueItem* item = &items[ll_rand(count)];
+						changes.push_back(std::make_pair(item, item->mPriority * (0.5f + ll_frand())));
+					}
+
+					timer.reset();
+					for (U32 i = 0; i < changes.size(); i++)
+					{
+						QueueItem* item = changes[i].first;
+						sorted.erase(item);
+						item->mPriority = changes[i].second;
+						sorted.insert(item);
+					}
+					set_top.clear();
+					item_set::iterator set_iter = sorted.begin();
+					for (U32 i = 0; i < top_count; i++, ++set_iter)
+					{
+						set_top.push_back(*set_iter);
+					}
+					set_time += timer.getElapsedTimeF64();
+
+					timer.reset();
+					for (U32 i = 0; i < changes.size(); i++)
+					{
+						queue.update(changes[i].first, changes[i].first->mPriority);
+					}
+					queue_top.clear();
+					queue.getTop(top_count, queue_top, ComparePriority());
+					queue_time += timer.getElapsedTimeF64();
+
+					check(queue_top == set_top, "bucket queue top differs from std::set");
+				}
+
+				std::ostringstream label;
+				label << count << " images, ";
+				report(label.str() + "std::set", set_time, frames);
+				report(label.str() + "LLBucketQueue", queue_time, frames);
+			}
+		}
+	};
+
+	BucketQueueBenchmark sBucketQueueBenchmark;
+}
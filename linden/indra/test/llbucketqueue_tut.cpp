@@ -0,0 +1,228 @@
+/** 
+ * @file llbucketqueue_tut.cpp
+ * @brief LLBucketQueue test cases.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include <tut/tut.hpp>
+#include "linden_common.h"
+#include "lltut.h"
+
+#include <set>
+#include "llbucketqueue.h"
+#include "llrand.h"
+
+namespace
+{
+	struct QueueItem
+	{
+		QueueItem() : mPriority(0.f) { }
+
+		F32 mPriority;
+		LLBucketQueueHandle mHandle;
+	};
+
+	struct ItemHandle
+	{
+		LLBucketQueueHandle& operator()(QueueItem* item) const	{ return item->mHandle; }
+	};
+
+	// the ordering LLViewerImageList used before the bucket queue
+	struct ComparePriority
+	{
+		bool operator()(const QueueItem* lhs, const QueueItem* rhs) const
+		{
+			if (lhs->mPriority != rhs->mPriority)
+			{
+				return lhs->mPriority > rhs->mPriority;
+			}
+			return lhs < rhs;
+		}
+	};
+
+	typedef LLBucketQueue<QueueItem*, ItemHandle> item_queue;
+	typedef std::set<QueueItem*, ComparePriority> item_set;
+}
+
+namespace tut
+{
+	struct llbucketqueue_data
+	{
+		void populate(U32 count)
+		{
+			mItems.resize(count);
+			for (U32 i = 0; i < count; i++)
+			{
+				mItems[i].mPriority = ll_frand(6000000.f);
+				mQueue.insert(&mItems[i], mItems[i].mPriority);
+			}
+		}
+
+		// every item visited once, in non-increasing bucket order
+		void checkOrder(U32 expected_count)
+		{
+			U32 count = 0;
+			U32 last_bucket = item_queue::NUM_BUCKETS;
+			for (item_queue::iterator iter = mQueue.begin(); iter != mQueue.end(); ++iter)
+			{
+				QueueItem* item = *iter;
+				U32 bucket = item_queue::bucketFor(item->mPriority);
+				ensure("descending buckets", bucket <= last_bucket);
+				ensure_equals("handle bucket", item->mHandle.mBucket, bucket);
+				last_bucket = bucket;
+				count++;
+			}
+			ensure_equals("iteration count", count, expected_count);
+			ensure_equals("size", mQueue.size(), expected_count);
+		}
+
+		std::vector<QueueItem> mItems;
+		item_queue mQueue;
+	};
+	typedef test_group<llbucketqueue_data> llbucketqueue_test;
+	typedef llbucketqueue_test::object llbucketqueue_object;
+	tut::llbucketqueue_test llbucketqueue_testcase("llbucketqueue");
+
+	template<> template<>
+	void llbucketqueue_object::test<1>()
+	{
+		ensure("new queue empty", mQueue.empty());
+		ensure("begin is end", mQueue.begin() == mQueue.end());
+
+		ensure("bucket order follows priority", item_queue::bucketFor(1.f) < item_queue::bucketFor(2.f));
+		ensure("bucket order follows priority", item_queue::bucketFor(2.f) < item_queue::bucketFor(6000000.f));
+		ensure_equals("negative priorities share the bottom", item_queue::bucketFor(-5.f), (U32) 0);
+		ensure_equals("zero in the bottom bucket", item_queue::bucketFor(0.f), (U32) 0);
+
+		QueueItem item;
+		ensure("insert", mQueue.insert(&item, 1.f));
+		ensure("second insert refused", !mQueue.insert(&item, 1.f));
+		ensure("handle queued", item.mHandle.isQueued());
+		ensure("erase", mQueue.erase(&item));
+		ensure("second erase refused", !mQueue.erase(&item));
+		ensure("handle cleared", !item.mHandle.isQueued());
+		ensure("empty again", mQueue.empty());
+	}
+
+	template<> template<>
+	void llbucketqueue_object::test<2>()
+	{
+		populate(5000);
+		checkOrder(5000);
+
+		// reprioritize, erase and reinsert at random
+		for (U32 i = 0; i < 20000; i++)
+		{
+			QueueItem& item = mItems[ll_rand(mItems.size())];
+			switch (ll_rand(3))
+			{
+			case 0:
+				if (item.mHandle.isQueued())
+				{
+					item.mPriority = ll_frand(6000000.f) - 1000.f;
+					mQueue.update(&item, item.mPriority);
+				}
+				break;
+			case 1:
+				mQueue.erase(&item);
+				break;
+			default:
+				mQueue.insert(&item, item.mPriority);
+				break;
+			}
+		}
+
+		U32 queued = 0;
+		for (U32 i = 0; i < mItems.size(); i++)
+		{
+			if (mItems[i].mHandle.isQueued())
+			{
+				queued++;
+			}
+		}
+		checkOrder(queued);
+
+		mQueue.clear();
+		checkOrder(0);
+		for (U32 i = 0; i < mItems.size(); i++)
+		{
+			ensure("clear resets handles", !mItems[i].mHandle.isQueued());
+		}
+	}
+
+	template<> template<>
+	void llbucketqueue_object::test<3>()
+	{
+		// getTop() returns exactly what the old std::set gave, ties and
+		// all, while priorities move within and across buckets
+		const U32 count = 5000;
+		const U32 top_count = 32;
+		populate(count);
+		for (U32 i = 0; i < count; i += 7)
+		{
+			// equal priorities are ordered by address
+			mItems[i].mPriority = 5000000.f;
+			mQueue.update(&mItems[i], mItems[i].mPriority);
+		}
+
+		for (U32 round = 0; round < 50; round++)
+		{
+			for (U32 i = 0; i < count / 10; i++)
+			{
+				QueueItem* item = &mItems[ll_rand(count)];
+				item->mPriority *= 0.9f + ll_frand(0.25f);
+				mQueue.update(item, item->mPriority);
+			}
+
+			item_set sorted;
+			for (U32 i = 0; i < count; i++)
+			{
+				sorted.insert(&mItems[i]);
+			}
+
+			std::vector<QueueItem*> top;
+			top.push_back(NULL);
+			mQueue.getTop(top_count, top, ComparePriority());
+			ensure_equals("existing entries kept", top[0], (QueueItem*) NULL);
+			ensure_equals("top count", top.size(), (size_t) top_count + 1);
+
+			item_set::iterator set_iter = sorted.begin();
+			for (U32 i = 1; i <= top_count; i++, ++set_iter)
+			{
+				ensure("top matches sorted order", top[i] == *set_iter);
+			}
+		}
+		checkOrder(count);
+
+		std::vector<QueueItem*> all;
+		mQueue.getTop(count * 2, all, ComparePriority());
+		ensure_equals("getTop stops at the queue size", all.size(), (size_t) count);
+	}
+}
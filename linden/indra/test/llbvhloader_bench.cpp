@@ -0,0 +1,309 @@
+/** 
+ * @file llbvhloader_bench.cpp
+ * @brief BVH import timings against the tokenizer and sscanf parse it replaced.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "llbenchmark.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <boost/tokenizer.hpp>
+#include "llbvhloader.h"
+#include "lldatapacker.h"
+#include "llrand.h"
+#include "llstl.h"
+#include "llthreadpool.h"
+#include "lltimer.h"
+
+// An upload sized clip: the 19 joints anim.ini maps, a few thousand frames
+// of six decimal values.  The baseline is the motion parse LLBVHLoader
+// used to do, which copied the file into a std::string, split it with
+// boost::tokenizer and read every triple with sscanf.  The current loader
+// walks the buffer in place.  Both must read the same floats.  Keyframe
+// reduction is timed on the calling thread and spread over a pool the
+// way the upload preview runs it.
+
+namespace
+{
+	const char* JOINT_NAMES[] =
+	{
+		"hip", "abdomen", "chest", "neck", "head",
+		"lCollar", "lShldr", "lForeArm", "lHand",
+		"rCollar", "rShldr", "rForeArm", "rHand",
+		"lThigh", "lShin", "lFoot",
+		"rThigh", "rShin", "rFoot"
+	};
+	const S32 JOINT_PARENTS[] =
+	{
+		-1, 0, 1, 2, 3,
+		2, 5, 6, 7,
+		2, 9, 10, 11,
+		0, 13, 14,
+		0, 16, 17
+	};
+	const S32 NUM_JOINTS = LL_ARRAY_SIZE(JOINT_NAMES);
+	const S32 NUM_CHANNELS = NUM_JOINTS * 3 + 3;
+	const S32 NUM_FRAMES = 2400;
+	const U32 BENCH_PASSES = 5;
+	const U32 NUM_THREADS = 2;
+
+	void write_joint(std::ostream& out, S32 joint, const std::string& indent)
+	{
+		out << indent << (joint ? "JOINT " : "ROOT ") << JOINT_NAMES[joint] << "\n";
+		out << indent << "{\n";
+		out << indent << "\tOFFSET 0.000000 " << 2.f + joint * 0.25f << " 0.000000\n";
+		out << indent << "\tCHANNELS " << (joint ? "3" : "6 Xposition Yposition Zposition")
+			<< " Zrotation Xrotation Yrotation\n";
+		bool leaf = true;
+		for (S32 child = joint + 1; child < NUM_JOINTS; child++)
+		{
+			if (JOINT_PARENTS[child] == joint)
+			{
+				write_joint(out, child, indent + "\t");
+				leaf = false;
+			}
+		}
+		if (leaf)
+		{
+			out << indent << "\tEnd Site\n";
+			out << indent << "\t{\n";
+			out << indent << "\t\tOFFSET 0.000000 1.000000 0.000000\n";
+			out << indent << "\t}\n";
+		}
+		out << indent << "}\n";
+	}
+
+	// Slow swings with a little noise, so reduction keeps some keys and
+	// drops others.
+	std::string make_clip()
+	{
+		std::ostringstream out;
+		out.setf(std::ios::fixed);
+		out.precision(6);
+		out << "HIERARCHY\n";
+		write_joint(out, 0, "");
+		out << "MOTION\n";
+		out << "Frames: " << NUM_FRAMES << "\n";
+		out << "Frame Time: 0.033333\n";
+		for (S32 f = 0; f < NUM_FRAMES; f++)
+		{
+			out << 2.f * sinf(f * 0.01f) << " " << 43.f + 0.5f * sinf(f * 0.05f) << " " << 0.02f * f;
+			for (S32 c = 3; c < NUM_CHANNELS; c++)
+			{
+				F32 swing = (c % 3 == 0) ? 0.f : 30.f * sinf(f * 0.02f + c);
+				out << " " << swing + ll_frand(0.01f);
+			}
+			out << "\n";
+		}
+		return out.str();
+	}
+
+	const char* find_next_whitespace(const char* p)
+	{
+		while (*p && isspace(*p)) p++;
+		while (*p && !isspace(*p)) p++;
+		return p;
+	}
+
+	// the frame loop LLBVHLoader::loadBVHFile() used to run
+	bool parse_motion_sscanf(const char* buffer, std::vector<F32>& values)
+	{
+		std::string str(buffer);
+		typedef boost::tokenizer<boost::char_separator<char> > tokenizer;
+		boost::char_separator<char> sep("\r\n");
+		tokenizer tokens(str, sep);
+		tokenizer::iterator iter = tokens.begin();
+
+		std::string line;
+		while (iter != tokens.end() && line.find("MOTION") == std::string::npos)
+		{
+			line = *(iter++);
+		}
+		S32 num_frames = 0;
+		F32 frame_time = 0.f;
+		if (iter == tokens.end() || sscanf((*(iter++)).c_str(), "Frames: %d", &num_frames) != 1)
+		{
+			return false;
+		}
+		if (iter == tokens.end() || sscanf((*(iter++)).c_str(), "Frame Time: %f", &frame_time) != 1)
+		{
+			return false;
+		}
+
+		values.clear();
+		for (S32 i = 0; i < num_frames; i++)
+		{
+			if (iter == tokens.end())
+			{
+				return false;
+			}
+			line = *(iter++);
+			const char* p = line.c_str();
+			for (S32 j = 0; j < NUM_JOINTS; j++)
+			{
+				F32 pos[3];
+				if (j == 0)
+				{
+					if (sscanf(p, "%f %f %f", pos, pos + 1, pos + 2) != 3)
+					{
+						return false;
+					}
+					values.insert(values.end(), pos, pos + 3);
+				}
+				p = find_next_whitespace(p);
+				p = find_next_whitespace(++p);
+				p = find_next_whitespace(++p);
+
+				F32 rot[3];
+				if (sscanf(p, " %f %f %f", rot, rot + 1, rot + 2) != 3)
+				{
+					return false;
+				}
+				values.insert(values.end(), rot, rot + 3);
+				p++;
+			}
+		}
+		return true;
+	}
+
+	// Parses straight into the loader, skipping the anim.ini lookup, and
+	// reads the keys back in file order.
+	class BenchLoader : public LLBVHLoader
+	{
+	public:
+		BenchLoader(LLThreadPool* pool) : LLBVHLoader("", 0, pool) { }
+
+		bool parse(const std::string& text)
+		{
+			std::for_each(mJoints.begin(), mJoints.end(), DeletePointer());
+			mJoints.clear();
+			char error_text[128];		/* Flawfinder: ignore */
+			S32 error_line;
+			return loadBVHFile(text.data(), (S32) text.size(), error_text, error_line) == ST_OK;
+		}
+
+		void getValues(std::vector<F32>& values)
+		{
+			values.clear();
+			for (S32 f = 0; f < mNumFrames; f++)
+			{
+				for (U32 j = 0; j < mJoints.size(); j++)
+				{
+					Joint* joint = mJoints[j];
+					const Key& key = joint->mKeys[f];
+					if (j == 0)
+					{
+						values.insert(values.end(), key.mPos, key.mPos + 3);
+					}
+					for (S32 k = 0; k < 3; k++)
+					{
+						values.push_back(key.mRot[joint->mOrder[k] - 'X']);
+					}
+				}
+			}
+		}
+
+		void getOutput(std::vector<U8>& out)
+		{
+			out.resize(getOutputSize());
+			LLDataPackerBinaryBuffer dp(&out[0], (S32) out.size());
+			serialize(dp);
+		}
+	};
+
+	class BVHLoaderBenchmark : public LLBenchmark
+	{
+	public:
+		BVHLoaderBenchmark() : LLBenchmark("bvh loader") { }
+
+		virtual void run()
+		{
+			std::string clip = make_clip();
+
+			LLThreadPool pool("bvh benchmark", NUM_THREADS);
+			BenchLoader serial(NULL);
+			BenchLoader pooled(&pool);
+			std::vector<F32> expected;
+			std::vector<F32> actual;
+			std::vector<U8> serial_output;
+			std::vector<U8> pooled_output;
+
+			F64 sscanf_time = 0.0;
+			F64 parse_time = 0.0;
+			F64 serial_time = 0.0;
+			F64 pooled_time = 0.0;
+			LLTimer timer;
+			bool parsed = true;
+			for (U32 pass = 0; pass < BENCH_PASSES; pass++)
+			{
+				timer.reset();
+				parsed = parse_motion_sscanf(clip.c_str(), expected) && parsed;
+				sscanf_time += timer.getElapsedTimeF64();
+
+				timer.reset();
+				parsed = serial.parse(clip) && parsed;
+				parse_time += timer.getElapsedTimeF64();
+
+				timer.reset();
+				serial.optimize();
+				serial_time += timer.getElapsedTimeF64();
+
+				parsed = pooled.parse(clip) && parsed;
+				timer.reset();
+				pooled.optimize();
+				pooled_time += timer.getElapsedTimeF64();
+			}
+			check(parsed, "clip failed to parse");
+			serial.getValues(actual);
+			check(actual == expected, "loader read different values than sscanf");
+			serial.getOutput(serial_output);
+			pooled.getOutput(pooled_output);
+			check(serial_output == pooled_output, "pooled reduction serialized differently");
+
+			std::ostringstream label;
+			label << NUM_JOINTS << " joints, " << NUM_FRAMES << " frames, ";
+			report(label.str() + "tokenizer and sscanf parse", sscanf_time, BENCH_PASSES);
+			report(label.str() + "in place parse", parse_time, BENCH_PASSES);
+			std::cout << "  " << clip.size() / 1024 << " KB: sscanf "
+					  << clip.size() * BENCH_PASSES / (sscanf_time * 1048576.0) << " MB/s, in place "
+					  << clip.size() * BENCH_PASSES / (parse_time * 1048576.0) << " MB/s" << std::endl;
+			report(label.str() + "reduction on the calling thread", serial_time, BENCH_PASSES);
+			std::ostringstream threaded;
+			threaded << "reduction on " << NUM_THREADS << " pool threads";
+			report(label.str() + threaded.str(), pooled_time, BENCH_PASSES);
+
+			pool.shutdown();
+		}
+	};
+
+	BVHLoaderBenchmark sBVHLoaderBenchmark;
+}
@@ -0,0 +1,279 @@
+/** 
+ * @file llbvhloader_tut.cpp
+ * @brief LLBVHLoader test cases.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include <tut/tut.hpp>
+#include "linden_common.h"
+#include "lltut.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "llapr.h"
+#include "llbvhloader.h"
+#include "lldatapacker.h"
+#include "llstl.h"
+
+namespace
+{
+	// A short clip with a root position channel, an ignored joint and a
+	// few keys that keyframe reduction drops.
+	const char BVH_PLAIN[] =
+		"HIERARCHY\n"
+		"ROOT hip\n"
+		"{\n"
+		"\tOFFSET 0.00 0.00 0.00\n"
+		"\tCHANNELS 6 Xposition Yposition Zposition Xrotation Zrotation Yrotation\n"
+		"\tJOINT abdomen\n"
+		"\t{\n"
+		"\t\tOFFSET 0.000000 3.422050 0.000000\n"
+		"\t\tCHANNELS 3 Xrotation Zrotation Yrotation\n"
+		"\t\tJOINT chest\n"
+		"\t\t{\n"
+		"\t\t\tOFFSET 0.000000 8.486693 -0.684411\n"
+		"\t\t\tCHANNELS 3 Xrotation Zrotation Yrotation\n"
+		"\t\t\tJOINT neckDummy\n"
+		"\t\t\t{\n"
+		"\t\t\t\tOFFSET 0.000000 10.266162 -0.273764\n"
+		"\t\t\t\tCHANNELS 3 Xrotation Yrotation Zrotation\n"
+		"\t\t\t\tEnd Site\n"
+		"\t\t\t\t{\n"
+		"\t\t\t\t\tOFFSET 0.000000 3.148285 0.000000\n"
+		"\t\t\t\t}\n"
+		"\t\t\t}\n"
+		"\t\t}\n"
+		"\t}\n"
+		"}\n"
+		"MOTION\n"
+		"Frames: 6\n"
+		"Frame Time: 0.0625\n"
+		"0.00 43.50 0.25 0.00 0.00 0.00 0.00 0.00 0.00 0.00 0.00 0.00 0.00 0.00 0.00\n"
+		"1.25 43.50 0.25 12.50 -3.75 0.00 5.00 0.00 0.00 -7.125 2.50 0.00 1.00 2.00 3.00\n"
+		"2.50 43.75 -0.50 25.00 -7.50 0.00 10.00 0.00 0.00 -14.25 5.00 0.00 1.00 2.00 3.00\n"
+		"3.75 44.00 -1.25 37.50 -11.25 0.00 15.00 0.00 0.00 -21.375 7.50 0.00 1.00 2.00 3.00\n"
+		"5.00 44.00 -2.00 50.00 -15.00 0.00 20.00 0.00 0.00 -28.50 10.00 0.00 1.00 2.00 3.00\n"
+		"6.25 43.50 -2.75 62.50 -18.75 0.00 25.00 0.00 0.00 -35.625 12.50 0.00 1.00 2.00 3.00\n";
+
+	// The same clip with every motion value in exponent notation.
+	const char BVH_EXPONENT[] =
+		"HIERARCHY\n"
+		"ROOT hip\n"
+		"{\n"
+		"\tOFFSET 0.00 0.00 0.00\n"
+		"\tCHANNELS 6 Xposition Yposition Zposition Xrotation Zrotation Yrotation\n"
+		"\tJOINT abdomen\n"
+		"\t{\n"
+		"\t\tOFFSET 0.000000 3.422050 0.000000\n"
+		"\t\tCHANNELS 3 Xrotation Zrotation Yrotation\n"
+		"\t\tJOINT chest\n"
+		"\t\t{\n"
+		"\t\t\tOFFSET 0.000000 8.486693 -0.684411\n"
+		"\t\t\tCHANNELS 3 Xrotation Zrotation Yrotation\n"
+		"\t\t\tJOINT neckDummy\n"
+		"\t\t\t{\n"
+		"\t\t\t\tOFFSET 0.000000 10.266162 -0.273764\n"
+		"\t\t\t\tCHANNELS 3 Xrotation Yrotation Zrotation\n"
+		"\t\t\t\tEnd Site\n"
+		"\t\t\t\t{\n"
+		"\t\t\t\t\tOFFSET 0.000000 3.148285 0.000000\n"
+		"\t\t\t\t}\n"
+		"\t\t\t}\n"
+		"\t\t}\n"
+		"\t}\n"
+		"}\n"
+		"MOTION\n"
+		"Frames: 6\n"
+		"Frame Time: 6.25e-2\n"
+		"0e0 4.35e1 2.5E-1 0.0e+0 0e0 0e0 0e0 0e0 0e0 0e0 0e0 0e0 0e0 0e0 0e0\n"
+		"1.25e0 4.35e1 2.5E-1 1.25e+1 -3.75e0 0e0 5e0 0e0 0e0 -7.125e0 2.5e0 0e0 1e0 2e0 3e0\n"
+		"2.5e0 4.375e1 -5e-1 2.5e1 -7.5e0 0e0 1e1 0e0 0e0 -1.425e1 5e0 0e0 1e0 2e0 3e0\n"
+		"3.75e0 4.4e1 -1.25e0 3.75e1 -1.125e1 0e0 1.5e1 0e0 0e0 -2.1375e1 7.5e0 0e0 1e0 2e0 3e0\n"
+		"5e0 4.4e1 -2e0 5e1 -1.5e1 0e0 2e1 0e0 0e0 -2.85e1 1e1 0e0 1e0 2e0 3e0\n"
+		"6.25e0 4.35e1 -2.75e0 6.25e1 -1.875e1 0e0 2.5e1 0e0 0e0 -3.5625e1 1.25e1 0e0 1e0 2e0 3e0\n";
+
+	// BVH_PLAIN serialized by the loader that split its input with
+	// boost::tokenizer and read numbers with sscanf.
+	const U8 SERIALIZED[] =
+	{
+		0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x3e,
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x3e, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x40, 0x3e, 0x00, 0x00, 0x40, 0x3e, 0x01, 0x00, 0x00,
+		0x00, 0x03, 0x00, 0x00, 0x00, 0x6d, 0x50, 0x65, 0x6c, 0x76, 0x69, 0x73,
+		0x00, 0x02, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x55, 0x55, 0xd5,
+		0x7b, 0xec, 0x8d, 0x74, 0x80, 0xaa, 0xaa, 0x1e, 0x74, 0xf1, 0xa8, 0x07,
+		0x84, 0xff, 0xff, 0x2c, 0x6e, 0x83, 0xc1, 0xd0, 0x8a, 0x04, 0x00, 0x00,
+		0x00, 0x55, 0x55, 0xff, 0x7f, 0xcf, 0x80, 0xff, 0x7f, 0xaa, 0xaa, 0x05,
+		0x7f, 0x6f, 0x82, 0x52, 0x80, 0x54, 0xd5, 0x88, 0x7e, 0x3f, 0x83, 0x52,
+		0x80, 0xff, 0xff, 0x0c, 0x7e, 0x0f, 0x84, 0xff, 0x7f, 0x6d, 0x54, 0x6f,
+		0x72, 0x73, 0x6f, 0x00, 0x02, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+		0x55, 0x55, 0xff, 0x7f, 0x94, 0x85, 0xff, 0x7f, 0x54, 0xd5, 0xff, 0x7f,
+		0x39, 0x96, 0xff, 0x7f, 0xff, 0xff, 0xff, 0x7f, 0xb3, 0x9b, 0xff, 0x7f,
+		0x00, 0x00, 0x00, 0x00, 0x6d, 0x43, 0x68, 0x65, 0x73, 0x74, 0x00, 0x02,
+		0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x55, 0x55, 0xc8, 0x82, 0x0b,
+		0x78, 0x2b, 0x80, 0x54, 0xd5, 0xcf, 0x8a, 0x9c, 0x60, 0xbe, 0x82, 0xff,
+		0xff, 0x43, 0x8d, 0x13, 0x59, 0x42, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00
+	};
+
+	// Loads with the translations anim.ini gives these joints rather than
+	// whatever app_settings happens to hold.
+	class LLBVHTestLoader : public LLBVHLoader
+	{
+	public:
+		LLBVHTestLoader(const std::string& text)
+			: LLBVHLoader(text.data(), (S32) text.size())
+		{
+			std::for_each(mJoints.begin(), mJoints.end(), DeletePointer());
+			mJoints.clear();
+			reset();
+
+			LLMatrix3 frame;
+			frame.setRows(LLVector3(0.f, 1.f, 0.f), LLVector3(0.f, 0.f, 1.f), LLVector3(1.f, 0.f, 0.f));
+
+			mTranslations.clear();
+			mConstraints.clear();
+			Translation& hip = mTranslations["hip"];
+			hip.mOutName = "mPelvis";
+			hip.mRelativePositionKey = TRUE;
+			hip.mRelativeRotationKey = TRUE;
+			hip.mFrameMatrix = frame;
+			Translation& abdomen = mTranslations["abdomen"];
+			abdomen.mOutName = "mTorso";
+			abdomen.mFrameMatrix = frame;
+			Translation& chest = mTranslations["chest"];
+			chest.mOutName = "mChest";
+			chest.mFrameMatrix = frame;
+			Translation& neck_dummy = mTranslations["neckDummy"];
+			neck_dummy.mIgnore = TRUE;
+			neck_dummy.mFrameMatrix = frame;
+
+			// no NUL terminator past the end of the buffer
+			std::vector<char> buffer(text.begin(), text.end());
+			char error_text[128];		/* Flawfinder: ignore */
+			S32 error_line;
+			mStatus = loadBVHFile(&buffer[0], (S32) buffer.size(), error_text, error_line);
+			if (mStatus == ST_OK)
+			{
+				applyTranslations();
+				optimize();
+				mInitialized = TRUE;
+			}
+		}
+	};
+
+	std::vector<U8> serialize_bvh(const std::string& text)
+	{
+		LLBVHTestLoader loader(text);
+		tut::ensure_equals("status", std::string(loader.getStatus()), std::string(LLBVHLoader::ST_OK));
+		tut::ensure("initialized", loader.isInitialized());
+
+		std::vector<U8> out(loader.getOutputSize());
+		LLDataPackerBinaryBuffer dp(&out[0], (S32) out.size());
+		tut::ensure("serialize", loader.serialize(dp));
+		tut::ensure_equals("serialized size", dp.getCurrentSize(), (S32) out.size());
+		return out;
+	}
+
+	void ensure_serialized(const std::string& text)
+	{
+		std::vector<U8> actual = serialize_bvh(text);
+		tut::ensure_equals("serialized size", actual.size(), sizeof(SERIALIZED));
+		for (U32 i = 0; i < actual.size(); i++)
+		{
+			tut::ensure_equals("serialized byte", (S32) actual[i], (S32) SERIALIZED[i]);
+		}
+	}
+
+	std::string to_crlf(const std::string& text)
+	{
+		std::string out;
+		for (std::string::const_iterator it = text.begin(); it != text.end(); ++it)
+		{
+			if (*it == '\n')
+			{
+				out += '\r';
+			}
+			out += *it;
+		}
+		return out;
+	}
+}
+
+namespace tut
+{
+	struct llbvhloader_data
+	{
+		llbvhloader_data()
+		{
+			if (!gAPRPoolp)
+			{
+				ll_init_apr();
+			}
+		}
+	};
+	typedef test_group<llbvhloader_data> llbvhloader_test;
+	typedef llbvhloader_test::object llbvhloader_object;
+	tut::llbvhloader_test tbvh("bvhloader");
+
+	template<> template<>
+	void llbvhloader_object::test<1>()
+	{
+		// plain LF input
+		ensure_serialized(BVH_PLAIN);
+	}
+
+	template<> template<>
+	void llbvhloader_object::test<2>()
+	{
+		// CRLF line endings
+		ensure_serialized(to_crlf(BVH_PLAIN));
+	}
+
+	template<> template<>
+	void llbvhloader_object::test<3>()
+	{
+		// last line without a newline, for both line endings
+		std::string text(BVH_PLAIN);
+		ensure_serialized(text.substr(0, text.size() - 1));
+
+		std::string crlf = to_crlf(text);
+		ensure_serialized(crlf.substr(0, crlf.size() - 2));
+	}
+
+	template<> template<>
+	void llbvhloader_object::test<4>()
+	{
+		// exponents go through strtod and land on the same floats
+		ensure_serialized(BVH_EXPONENT);
+		ensure_serialized(to_crlf(BVH_EXPONENT));
+	}
+}
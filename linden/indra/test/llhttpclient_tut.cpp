@@ -43,8 +43,10 @@
 #if !LL_WINDOWS
 
 #include "lltut.h"
+#include "llcurl.h"
 #include "llhttpclient.h"
 #include "llformat.h"
+#include "lltimer.h"
 #include "llpipeutil.h"
 #include "llpumpio.h"
 
@@ -81,9 +83,41 @@ namespace tut
 		}
 	};
 
+	// stand-in for the texture capability: a fixed size body
+	class BlobNode : public LLHTTPNode
+	{
+	public:
+		LLSD get() const					{ return LLSD(std::string(8192, 'x')); }
+	};
+
 	LLHTTPRegistration<LLSDStorageNode> gStorageNode("/test/storage");
 	LLHTTPRegistration<ErrorNode>		gErrorNode("/test/error");
 	LLHTTPRegistration<TimeOutNode>		gTimeOutNode("/test/timeout");
+	LLHTTPRegistration<BlobNode>		gBlobNode("/test/blob");
+
+	class RangeCounter : public LLCurl::Responder
+	{
+	public:
+		RangeCounter(S32& done, S32& bytes)
+			: mDone(done), mBytes(bytes)
+		{
+		}
+
+		virtual void completedRaw(U32 status, const std::string& reason,
+								  const LLChannelDescriptors& channels,
+								  const LLIOPipe::buffer_ptr_t& buffer)
+		{
+			if (200 <= status && status < 300)
+			{
+				mBytes += buffer->countAfter(channels.in(), NULL);
+			}
+			++mDone;
+		}
+
+	private:
+		S32& mDone;
+		S32& mBytes;
+	};
 
 	struct HTTPClientTestData
 	{
@@ -137,6 +171,30 @@ namespace tut
 			delete mServerPump;
 			mServerPump = NULL;
 		}
+
+		// Issue count range requests against the local server, keeping
+		// in_flight of them outstanding, the way LLTextureFetch does.
+		void fetchRanges(LLCurlRequest& request, S32 count, S32 in_flight, S32& done, S32& bytes)
+		{
+			LLCurlRequest::headers_t headers;
+			LLTimer timer;
+			timer.setTimerExpirySec(100.f);
+			S32 sent = 0;
+			done = 0;
+			bytes = 0;
+			while (done < count && !timer.hasExpired())
+			{
+				while (sent < count && sent - done < in_flight)
+				{
+					request.getByteRange("http://localhost:8888/test/blob", headers, 0, 4096,
+										 new RangeCounter(done, bytes));
+					++sent;
+				}
+				mServerPump->pump();
+				mServerPump->callback();
+				request.process();
+			}
+		}
 	
 	private:
 		apr_pool_t* mPool;
@@ -380,6 +438,35 @@ namespace tut
 		ensureStatusOK();
 		ensure("result object wasn't destroyed", mResultDeleted);
 	}
+
+	template<> template<>
+	void HTTPClientTestObject::test<10>()
+	{
+		// More range requests than one multi handle takes before it is
+		// retired all complete, both for a plain request (which retires
+		// its multi) and for one with connection limits set (which keeps
+		// it while it has room for requests in flight).
+		const S32 REQUESTS = 256;
+		const S32 IN_FLIGHT = 32;
+
+		setupTheServer();
+
+		for (S32 i = 0; i < 2; i++)
+		{
+			LLCurlRequest request;
+			if (i)
+			{
+				request.setConnectionLimits(IN_FLIGHT, false);
+			}
+			S32 done = 0;
+			S32 bytes = 0;
+			fetchRanges(request, REQUESTS, IN_FLIGHT, done, bytes);
+
+			ensure_equals("all requests completed", done, REQUESTS);
+			ensure("received data", bytes > 0);
+			ensure_equals("nothing left queued", request.getQueued(), 0);
+		}
+	}
 }
 
 #endif	// !LL_WINDOWS
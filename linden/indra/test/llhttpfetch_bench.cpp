@@ -0,0 +1,353 @@
+/** 
+ * @file llhttpfetch_bench.cpp
+ * @brief HTTP range fetch throughput with a fixed and an adaptive request window.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "llbenchmark.h"
+
+#include <deque>
+#include <iostream>
+#include <map>
+#include "llapr.h"
+#include "llcurl.h"
+#include "llformat.h"
+#include "llhttpnode.h"
+#include "llhttpwindow.h"
+#include "lliohttpserver.h"
+#include "llpumpio.h"
+#include "llsdhttpserver.h"
+#include "lltimer.h"
+
+// Range requests issued the way LLTextureFetch issues them, against a
+// stand-in texture server that works on a fixed number of requests at a
+// time and takes a fixed service time over each; requests beyond that wait
+// in its queue.  Every scenario is fetched with the old fixed window of 32
+// requests and with LLHTTPWindow between the default limits of 8 and 64.
+// The "busy server" has fewer slots than 32, so a bigger window only adds
+// queueing; the "slow server" has more, so 32 leaves it idle.  The window
+// is resized every WINDOW_TIME instead of every second so a run only takes
+// a few seconds.
+//
+// "http fetch" goes through LLCurlRequest to LLIOHTTPServer on localhost,
+// and also runs the fixed window without connection limits, which retires
+// the curl multi handle and its connections every 100 requests.  "http
+// fetch model" runs the same server and window in simulated time; its
+// numbers do not depend on the machine.
+
+namespace
+{
+	struct Scenario
+	{
+		const char* mName;
+		U32 mSlots;
+		F64 mServiceTime;
+	};
+
+	const Scenario SCENARIOS[] =
+	{
+		{ "busy server", 12, 0.02 },
+		{ "slow server", 96, 0.05 }
+	};
+	const U32 NUM_SCENARIOS = LL_ARRAY_SIZE(SCENARIOS);
+
+	const S32 REQUESTS = 3000;
+	const S32 FIXED_WINDOW = 32;
+	const S32 MIN_REQUESTS = 8;
+	const S32 MAX_REQUESTS = 64;
+	const F32 WINDOW_TIME = 0.25f;
+	const S32 BODY_BYTES = 4096;
+	const U16 SERVER_PORT = 8889;
+
+	struct FetchResult
+	{
+		FetchResult() : mSeconds(0.0), mLatency(0.0), mBytes(0), mWindow(0) { }
+
+		F64 mSeconds;
+		F64 mLatency;	// mean per request
+		S32 mBytes;
+		S32 mWindow;	// at the end of the run
+	};
+
+	void print_result(LLBenchmark* bench, const std::string& label, const FetchResult& result)
+	{
+		bench->report(label, result.mSeconds, REQUESTS);
+		std::cout << "    " << (F64)REQUESTS / result.mSeconds << " requests/s, "
+				  << result.mLatency * 1000.0 << " ms mean latency, window "
+				  << result.mWindow << std::endl;
+	}
+
+	//-------------------------------------------------------------------------
+	// simulated
+	//-------------------------------------------------------------------------
+
+	FetchResult fetch_model(const Scenario& scenario, bool adaptive)
+	{
+		LLHTTPWindow window(MIN_REQUESTS, MAX_REQUESTS);
+		std::deque<F64> waiting;				// issue times
+		std::multimap<F64, F64> serving;		// due time, issue time
+		F64 now = 0.0;
+		F64 next_update = WINDOW_TIME;
+		S32 sent = 0;
+		S32 done = 0;
+		U32 seed = 1;
+		FetchResult result;
+
+		while (done < REQUESTS)
+		{
+			S32 limit = adaptive ? window.getMaxRequests() : FIXED_WINDOW;
+			while (sent < REQUESTS && sent - done < limit)
+			{
+				waiting.push_back(now);
+				++sent;
+				window.requestStarted(sent - done);
+			}
+			while (!waiting.empty() && serving.size() < scenario.mSlots)
+			{
+				// +/-10% so the latency is not perfectly flat
+				seed = seed * 1103515245 + 12345;
+				F64 jitter = 0.9 + 0.2 * (F64)((seed >> 16) & 0x7fff) / 32768.0;
+				serving.insert(std::make_pair(now + scenario.mServiceTime * jitter, waiting.front()));
+				waiting.pop_front();
+			}
+
+			std::multimap<F64, F64>::iterator first = serving.begin();
+			if (adaptive && next_update <= first->first)
+			{
+				now = next_update;
+				next_update += WINDOW_TIME;
+				window.update(WINDOW_TIME, 0.f, sent - done);
+				continue;
+			}
+
+			now = first->first;
+			F64 latency = now - first->second;
+			serving.erase(first);
+			window.requestFinished((F32)latency, BODY_BYTES, true, sent - done);
+			result.mLatency += latency;
+			result.mBytes += BODY_BYTES;
+			++done;
+		}
+
+		result.mSeconds = now;
+		result.mLatency /= REQUESTS;
+		result.mWindow = adaptive ? window.getMaxRequests() : FIXED_WINDOW;
+		return result;
+	}
+
+	class FetchModelBenchmark : public LLBenchmark
+	{
+	public:
+		FetchModelBenchmark() : LLBenchmark("http fetch model") { }
+
+		/*virtual*/ void run()
+		{
+			for (U32 s = 0; s < NUM_SCENARIOS; s++)
+			{
+				const Scenario& scenario = SCENARIOS[s];
+				FetchResult fixed = fetch_model(scenario, false);
+				FetchResult adaptive = fetch_model(scenario, true);
+				check(fixed.mBytes == adaptive.mBytes, "both windows fetched everything");
+				print_result(this, std::string(scenario.mName) + ", fixed 32 (simulated s)", fixed);
+				print_result(this, std::string(scenario.mName) + ", adaptive (simulated s)", adaptive);
+			}
+		}
+	};
+	FetchModelBenchmark sFetchModelBenchmark;
+
+	//-------------------------------------------------------------------------
+	// local server
+	//-------------------------------------------------------------------------
+
+	struct TextureServer
+	{
+		TextureServer() : mSlots(1), mServiceTime(0.0) { }
+
+		// answers the requests that are due and starts waiting ones on the
+		// free slots
+		void serve(F64 now)
+		{
+			while (!mServing.empty() && mServing.begin()->first <= now)
+			{
+				mServing.begin()->second->result(LLSD(std::string(BODY_BYTES, 'x')));
+				mServing.erase(mServing.begin());
+			}
+			while (!mWaiting.empty() && mServing.size() < mSlots)
+			{
+				mServing.insert(std::make_pair(now + mServiceTime, mWaiting.front()));
+				mWaiting.pop_front();
+			}
+		}
+
+		U32 mSlots;
+		F64 mServiceTime;
+		std::deque<LLHTTPNode::ResponsePtr> mWaiting;
+		std::multimap<F64, LLHTTPNode::ResponsePtr> mServing;
+	};
+	TextureServer sTextureServer;
+
+	class TextureNode : public LLHTTPNode
+	{
+	public:
+		void get(ResponsePtr r, const LLSD& context) const
+		{
+			sTextureServer.mWaiting.push_back(r);
+		}
+	};
+	LLHTTPRegistration<TextureNode> gTextureNode("/bench/texture");
+
+	struct FetchState
+	{
+		FetchState() : mWindow(NULL), mSent(0), mDone(0) { }
+
+		LLHTTPWindow* mWindow;
+		S32 mSent;
+		S32 mDone;
+		FetchResult mResult;
+	};
+
+	class FetchResponder : public LLCurl::Responder
+	{
+	public:
+		FetchResponder(FetchState& state)
+			: mState(state), mStart(LLTimer::getTotalSeconds())
+		{
+		}
+
+		virtual void completedRaw(U32 status, const std::string& reason,
+								  const LLChannelDescriptors& channels,
+								  const LLIOPipe::buffer_ptr_t& buffer)
+		{
+			F64 seconds = LLTimer::getTotalSeconds() - mStart;
+			bool success = 200 <= status && status < 300;
+			S32 bytes = success ? buffer->countAfter(channels.in(), NULL) : 0;
+			if (mState.mWindow)
+			{
+				mState.mWindow->requestFinished((F32)seconds, bytes, success, mState.mSent - mState.mDone);
+			}
+			mState.mResult.mLatency += seconds;
+			mState.mResult.mBytes += bytes;
+			++mState.mDone;
+		}
+
+	private:
+		FetchState& mState;
+		F64 mStart;
+	};
+
+	class FetchBenchmark : public LLBenchmark
+	{
+	public:
+		FetchBenchmark() : LLBenchmark("http fetch"), mServerPump(NULL) { }
+
+		/*virtual*/ void run()
+		{
+			apr_pool_t* pool = NULL;
+			apr_pool_create(&pool, NULL);
+			mServerPump = new LLPumpIO(pool);
+			LLHTTPNode& root = LLIOHTTPServer::create(pool, *mServerPump, SERVER_PORT);
+			LLHTTPStandardServices::useServices();
+			LLHTTPRegistrar::buildAllServices(root);
+
+			for (U32 s = 0; s < NUM_SCENARIOS; s++)
+			{
+				const Scenario& scenario = SCENARIOS[s];
+				sTextureServer.mSlots = scenario.mSlots;
+				sTextureServer.mServiceTime = scenario.mServiceTime;
+
+				FetchResult plain = fetch(false, false);
+				FetchResult fixed = fetch(true, false);
+				FetchResult adaptive = fetch(true, true);
+				check(plain.mBytes > 0 && plain.mBytes == fixed.mBytes && fixed.mBytes == adaptive.mBytes,
+					  "every request completed");
+				print_result(this, std::string(scenario.mName) + ", fixed 32, no connection limits", plain);
+				print_result(this, std::string(scenario.mName) + ", fixed 32", fixed);
+				print_result(this, std::string(scenario.mName) + ", adaptive", adaptive);
+			}
+
+			delete mServerPump;
+			mServerPump = NULL;
+			apr_pool_destroy(pool);
+		}
+
+	private:
+		FetchResult fetch(bool connection_limits, bool adaptive)
+		{
+			LLHTTPWindow window(MIN_REQUESTS, MAX_REQUESTS);
+			LLCurlRequest request;
+			if (connection_limits)
+			{
+				request.setConnectionLimits(MAX_REQUESTS, false);
+			}
+			LLCurlRequest::headers_t headers;
+			FetchState state;
+			if (adaptive)
+			{
+				state.mWindow = &window;
+			}
+
+			std::string url = llformat("http://localhost:%d/bench/texture", SERVER_PORT);
+			LLTimer timeout;
+			timeout.setTimerExpirySec(120.f);
+			F64 start = LLTimer::getTotalSeconds();
+			F64 next_update = start + WINDOW_TIME;
+			while (state.mDone < REQUESTS && !timeout.hasExpired())
+			{
+				S32 limit = adaptive ? window.getMaxRequests() : FIXED_WINDOW;
+				while (state.mSent < REQUESTS && state.mSent - state.mDone < limit)
+				{
+					request.getByteRange(url, headers, 0, BODY_BYTES, new FetchResponder(state));
+					++state.mSent;
+					window.requestStarted(state.mSent - state.mDone);
+				}
+				mServerPump->pump();
+				mServerPump->callback();
+				F64 now = LLTimer::getTotalSeconds();
+				sTextureServer.serve(now);
+				request.process();
+				if (adaptive && now >= next_update)
+				{
+					window.update((F32)(now - next_update + WINDOW_TIME), 0.f, state.mSent - state.mDone);
+					next_update = now + WINDOW_TIME;
+				}
+			}
+
+			FetchResult result = state.mResult;
+			result.mSeconds = LLTimer::getTotalSeconds() - start;
+			result.mLatency /= llmax(state.mDone, 1);
+			result.mWindow = adaptive ? window.getMaxRequests() : FIXED_WINDOW;
+			check(state.mDone == REQUESTS, "fetch timed out");
+			return result;
+		}
+
+		LLPumpIO* mServerPump;
+	};
+	FetchBenchmark sFetchBenchmark;
+}
@@ -0,0 +1,130 @@
+/** 
+ * @file llhttpwindow_tut.cpp
+ * @brief LLHTTPWindow test cases.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include <tut/tut.hpp>
+#include "linden_common.h"
+#include "lltut.h"
+
+#include "llhttpwindow.h"
+
+namespace tut
+{
+	struct llhttpwindow_data
+	{
+		// count requests of seconds each finish with in_flight outstanding,
+		// after one at base seconds has set the base latency
+		void finish(LLHTTPWindow& window, F32 base, F32 seconds, S32 count, S32 in_flight)
+		{
+			window.requestStarted(in_flight);
+			window.requestFinished(base, 1024, true, in_flight);
+			for (S32 i = 0; i < count; i++)
+			{
+				window.requestFinished(seconds, 1024, true, in_flight);
+			}
+		}
+	};
+	typedef test_group<llhttpwindow_data> llhttpwindow_test;
+	typedef llhttpwindow_test::object llhttpwindow_object;
+	tut::llhttpwindow_test llhttpwindow_testcase("httpwindow");
+
+	template<> template<>
+	void llhttpwindow_object::test<1>()
+	{
+		// starts at the lower limit and grows while it is full and requests
+		// take no longer than the best case
+		LLHTTPWindow window(8, 64);
+		ensure_equals("starts at the minimum", window.getMaxRequests(), 8);
+		finish(window, 0.05f, 0.05f, 40, 8);
+		window.update(1.f, 0.f, 8);
+		ensure_equals("grown", window.getMaxRequests(), 10);
+		ensure("throughput measured", window.getThroughput() > 0.f);
+
+		// not full, so no reason to grow
+		finish(window, 0.05f, 0.05f, 40, 4);
+		window.update(1.f, 0.f, 4);
+		ensure_equals("not grown", window.getMaxRequests(), 10);
+	}
+
+	template<> template<>
+	void llhttpwindow_object::test<2>()
+	{
+		// the backlog is estimated from the requests actually in flight:
+		// four requests at twice the base latency are at most two waiting,
+		// however large the window is
+		LLHTTPWindow window(64, 64);
+		window.setLimits(8, 64);
+		ensure_equals("kept", window.getMaxRequests(), 64);
+		finish(window, 0.05f, 0.1f, 40, 4);
+		window.update(1.f, 0.f, 4);
+		ensure_equals("not shrunk", window.getMaxRequests(), 64);
+
+		// thirty two at twice the base latency are a real backlog
+		finish(window, 0.05f, 0.1f, 40, 32);
+		window.update(1.f, 0.f, 32);
+		ensure_equals("shrunk", window.getMaxRequests(), 63);
+	}
+
+	template<> template<>
+	void llhttpwindow_object::test<3>()
+	{
+		// a quarter of the requests failing halves the window, down to the
+		// lower limit
+		LLHTTPWindow window(32, 32);
+		window.setLimits(8, 32);
+		for (S32 i = 0; i < 4; i++)
+		{
+			window.requestStarted(i + 1);
+			window.requestFinished(0.05f, 1024, i != 0, 32);
+		}
+		window.update(1.f, 0.f, 32);
+		ensure_equals("halved", window.getMaxRequests(), 16);
+
+		window.requestFinished(0.05f, 0, false, 16);
+		window.update(1.f, 0.f, 16);
+		window.requestFinished(0.05f, 0, false, 16);
+		window.update(1.f, 0.f, 16);
+		ensure_equals("limited", window.getMaxRequests(), 8);
+	}
+
+	template<> template<>
+	void llhttpwindow_object::test<4>()
+	{
+		// no growth once throughput reaches the bandwidth limit
+		LLHTTPWindow window(8, 64);
+		finish(window, 0.05f, 0.05f, 127, 8);
+		window.update(1.f, 1024.f, 8);
+		ensure_equals("at the limit", window.getMaxRequests(), 8);
+		finish(window, 0.05f, 0.05f, 127, 8);
+		window.update(1.f, 2048.f, 8);
+		ensure_equals("under the limit", window.getMaxRequests(), 10);
+	}
+}
@@ -0,0 +1,506 @@
+/** 
+ * @file llimageblend_tut.cpp
+ * @brief LLImageBlend test cases.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include <tut/tut.hpp>
+#include "linden_common.h"
+#include "lltut.h"
+
+#include <vector>
+#include "llimageblend.h"
+#include "llrand.h"
+
+namespace
+{
+	// What the GL blend stage computes, in floating point
+	F32 ref_blend(F32 d, F32 f, F32 sa, F32 da, LLImageBlend::EBlendMode mode)
+	{
+		switch (mode)
+		{
+		case LLImageBlend::BLEND_ALPHA:
+			return f * sa + d * (1.f - sa);
+		case LLImageBlend::BLEND_DEST_ALPHA:
+			return f * da + d * (1.f - da);
+		default:
+			return f;
+		}
+	}
+
+	void random_bytes(U8* data, S32 count)
+	{
+		for (S32 i = 0; i < count; i++)
+		{
+			data[i] = (U8)ll_rand(256);
+		}
+	}
+
+	// GL_LINEAR at (u, v) in texel units, clamped to the edge
+	F32 ref_bilinear(const std::vector<F32>& tex, S32 width, S32 height, F32 u, F32 v, S32 c)
+	{
+		S32 x0 = (S32)floorf(u);
+		S32 y0 = (S32)floorf(v);
+		F32 fx = u - x0;
+		F32 fy = v - y0;
+		S32 x1 = llclamp(x0 + 1, 0, width - 1);
+		S32 y1 = llclamp(y0 + 1, 0, height - 1);
+		x0 = llclamp(x0, 0, width - 1);
+		y0 = llclamp(y0, 0, height - 1);
+		F32 top = tex[(y0 * width + x0) * 4 + c] * (1.f - fx) + tex[(y0 * width + x1) * 4 + c] * fx;
+		F32 bottom = tex[(y1 * width + x0) * 4 + c] * (1.f - fx) + tex[(y1 * width + x1) * 4 + c] * fx;
+		return top * (1.f - fy) + bottom * fy;
+	}
+
+	// What GL draws for a width x height texture on a quad of dst_width x
+	// dst_height, with box filtered mips stored at 8 bits like the texture
+	void ref_sample(std::vector<F32>& out, const U8* src, S32 width, S32 height,
+					S32 dst_width, S32 dst_height, BOOL mipmapped)
+	{
+		std::vector<std::vector<F32> > levels(1, std::vector<F32>(src, src + width * height * 4));
+		std::vector<S32> widths(1, width);
+		std::vector<S32> heights(1, height);
+		while (widths.back() > 1 || heights.back() > 1)
+		{
+			S32 w = widths.back();
+			S32 h = heights.back();
+			S32 nw = llmax(w / 2, 1);
+			S32 nh = llmax(h / 2, 1);
+			const std::vector<F32>& prev = levels.back();
+			std::vector<F32> next(nw * nh * 4);
+			for (S32 y = 0; y < nh; y++)
+			{
+				for (S32 x = 0; x < nw; x++)
+				{
+					for (S32 c = 0; c < 4; c++)
+					{
+						S32 x0 = llmin(x * 2, w - 1), x1 = llmin(x * 2 + 1, w - 1);
+						S32 y0 = llmin(y * 2, h - 1), y1 = llmin(y * 2 + 1, h - 1);
+						F32 sum = prev[(y0 * w + x0) * 4 + c] + prev[(y0 * w + x1) * 4 + c] +
+								  prev[(y1 * w + x0) * 4 + c] + prev[(y1 * w + x1) * 4 + c];
+						next[(y * nw + x) * 4 + c] = floorf(sum * 0.25f + 0.5f);
+					}
+				}
+			}
+			levels.push_back(next);
+			widths.push_back(nw);
+			heights.push_back(nh);
+		}
+
+		F32 rho = llmax((F32)width / dst_width, (F32)height / dst_height);
+		F32 lod = (mipmapped && rho > 1.f) ? logf(rho) / logf(2.f) : 0.f;
+		S32 level = llmin((S32)lod, (S32)levels.size() - 1);
+		S32 next_level = llmin(level + 1, (S32)levels.size() - 1);
+		F32 frac = (level == next_level) ? 0.f : lod - level;
+
+		out.resize(dst_width * dst_height * 4);
+		for (S32 y = 0; y < dst_height; y++)
+		{
+			for (S32 x = 0; x < dst_width; x++)
+			{
+				for (S32 c = 0; c < 4; c++)
+				{
+					F32 s = (x + 0.5f) / dst_width;
+					F32 t = (y + 0.5f) / dst_height;
+					F32 a = ref_bilinear(levels[level], widths[level], heights[level],
+										 s * widths[level] - 0.5f, t * heights[level] - 0.5f, c);
+					F32 b = ref_bilinear(levels[next_level], widths[next_level], heights[next_level],
+										 s * widths[next_level] - 0.5f, t * heights[next_level] - 0.5f, c);
+					out[(y * dst_width + x) * 4 + c] = a + (b - a) * frac;
+				}
+			}
+		}
+	}
+
+	S32 max_difference(const U8* a, const U8* b, S32 count)
+	{
+		S32 diff = 0;
+		for (S32 i = 0; i < count; i++)
+		{
+			S32 d = (S32)a[i] - (S32)b[i];
+			diff = llmax(diff, d < 0 ? -d : d);
+		}
+		return diff;
+	}
+}
+
+namespace tut
+{
+	struct llimageblend_data
+	{
+		enum { NUM_PIXELS = 67 };	// not a multiple of the vector width
+
+		U8 mDst[NUM_PIXELS * 4];
+		U8 mSrc[NUM_PIXELS * 4];
+		U8 mMask[NUM_PIXELS];
+
+		llimageblend_data()
+		{
+			random_bytes(mDst, sizeof(mDst));
+			random_bytes(mSrc, sizeof(mSrc));
+			random_bytes(mMask, sizeof(mMask));
+			// make sure the alpha test sees both sides of its threshold
+			for (S32 i = 0; i < NUM_PIXELS; i += 5)
+			{
+				mSrc[i * 4 + 3] = (U8)(i % 4);
+			}
+		}
+	};
+	typedef test_group<llimageblend_data> llimageblend_test;
+	typedef llimageblend_test::object llimageblend_object;
+	tut::llimageblend_test llimageblend_testcase("llimageblend");
+
+	template<> template<>
+	void llimageblend_object::test<1>()
+	{
+		// mul255 rounds to nearest
+		for (U32 a = 0; a < 256; a++)
+		{
+			for (U32 b = 0; b < 256; b++)
+			{
+				U32 expected = (a * b * 2 + 255) / 510;
+				ensure_equals("mul255", (U32)LLImageBlend::mul255(a, b), expected);
+			}
+		}
+	}
+
+	template<> template<>
+	void llimageblend_object::test<2>()
+	{
+		// the vector loop and the scalar tail agree, pixel for pixel
+		const U8 tint[4] = { 200, 150, 255, 230 };
+		for (S32 mode = LLImageBlend::BLEND_ALPHA; mode <= LLImageBlend::BLEND_REPLACE; mode++)
+		{
+			for (S32 textured = 0; textured < 2; textured++)
+			{
+				U8 batch[NUM_PIXELS * 4];
+				U8 single[NUM_PIXELS * 4];
+				memcpy(batch, mDst, sizeof(batch));
+				memcpy(single, mDst, sizeof(single));
+
+				const U8* src = textured ? mSrc : NULL;
+				LLImageBlend::blendRGBA(batch, src, tint, mMask, LLImageBlend::DEFAULT_ALPHA_TEST,
+										NUM_PIXELS, (LLImageBlend::EBlendMode)mode);
+				for (S32 i = 0; i < NUM_PIXELS; i++)
+				{
+					LLImageBlend::blendRGBA(single + i * 4, src ? src + i * 4 : NULL, tint, mMask + i,
+											LLImageBlend::DEFAULT_ALPHA_TEST, 1, (LLImageBlend::EBlendMode)mode);
+				}
+				ensure_memory_matches("batch matches single pixels", batch, sizeof(batch), single, sizeof(single));
+			}
+		}
+	}
+
+	template<> template<>
+	void llimageblend_object::test<3>()
+	{
+		// blendRGBA against the GL blend equations
+		const U8 tint[4] = { 255, 128, 64, 200 };
+		for (S32 mode = LLImageBlend::BLEND_ALPHA; mode <= LLImageBlend::BLEND_REPLACE; mode++)
+		{
+			U8 result[NUM_PIXELS * 4];
+			memcpy(result, mDst, sizeof(result));
+			LLImageBlend::blendRGBA(result, mSrc, tint, mMask, LLImageBlend::DEFAULT_ALPHA_TEST,
+									NUM_PIXELS, (LLImageBlend::EBlendMode)mode);
+
+			U8 expected[NUM_PIXELS * 4];
+			for (S32 i = 0; i < NUM_PIXELS; i++)
+			{
+				F32 frag[4];
+				for (S32 c = 0; c < 4; c++)
+				{
+					frag[c] = (mSrc[i * 4 + c] / 255.f) * (tint[c] / 255.f);
+				}
+				for (S32 c = 0; c < 4; c++)
+				{
+					F32 d = mDst[i * 4 + c] / 255.f;
+					F32 v = (frag[3] > 0.01f)
+						? ref_blend(d, frag[c], frag[3], mMask[i] / 255.f, (LLImageBlend::EBlendMode)mode)
+						: d;
+					expected[i * 4 + c] = (U8)llclamp((S32)(v * 255.f + 0.5f), 0, 255);
+				}
+			}
+			ensure("blend within two steps of GL", max_difference(result, expected, NUM_PIXELS * 4) <= 2);
+		}
+	}
+
+	template<> template<>
+	void llimageblend_object::test<4>()
+	{
+		// alpha plane operations
+		U8 plane[NUM_PIXELS];
+		U8 src[NUM_PIXELS];
+		random_bytes(plane, NUM_PIXELS);
+		random_bytes(src, NUM_PIXELS);
+
+		U8 result[NUM_PIXELS];
+		memcpy(result, plane, NUM_PIXELS);
+		LLImageBlend::addAlpha(result, src, NUM_PIXELS);
+		for (S32 i = 0; i < NUM_PIXELS; i++)
+		{
+			ensure_equals("add saturates", (S32)result[i], llmin(255, plane[i] + src[i]));
+		}
+
+		memcpy(result, plane, NUM_PIXELS);
+		LLImageBlend::addAlpha(result, (U8)100, NUM_PIXELS);
+		for (S32 i = 0; i < NUM_PIXELS; i++)
+		{
+			ensure_equals("add constant saturates", (S32)result[i], llmin(255, plane[i] + 100));
+		}
+
+		memcpy(result, plane, NUM_PIXELS);
+		LLImageBlend::multiplyAlpha(result, src, NUM_PIXELS);
+		for (S32 i = 0; i < NUM_PIXELS; i++)
+		{
+			ensure_equals("multiply", result[i], LLImageBlend::mul255(plane[i], src[i]));
+		}
+
+		memcpy(result, plane, NUM_PIXELS);
+		LLImageBlend::multiplyAlpha(result, (U8)77, NUM_PIXELS);
+		for (S32 i = 0; i < NUM_PIXELS; i++)
+		{
+			ensure_equals("multiply constant", result[i], LLImageBlend::mul255(plane[i], 77));
+		}
+
+		memcpy(result, plane, NUM_PIXELS);
+		LLImageBlend::accumulateMask(result, src, NUM_PIXELS);
+		for (S32 i = 0; i < NUM_PIXELS; i++)
+		{
+			ensure_equals("mask", (S32)result[i], (plane[i] * (src[i] + 1)) >> 8);
+		}
+
+		U8 rgba[NUM_PIXELS * 4];
+		memcpy(rgba, mDst, sizeof(rgba));
+		LLImageBlend::insertAlpha(rgba, src, NUM_PIXELS);
+		LLImageBlend::extractAlpha(result, rgba, NUM_PIXELS);
+		ensure_memory_matches("alpha round trip", result, NUM_PIXELS, src, NUM_PIXELS);
+		for (S32 i = 0; i < NUM_PIXELS; i++)
+		{
+			ensure_equals("color untouched", rgba[i * 4], mDst[i * 4]);
+		}
+	}
+
+	template<> template<>
+	void llimageblend_object::test<5>()
+	{
+		// A small bake done the way LLTexLayerSet::render() draws one: an
+		// opaque base, a tinted layer masked by an alpha gradient, then the
+		// alpha cleared to one.  Compared against a floating point bake.
+		const U8 base_tint[4] = { 230, 190, 170, 255 };
+		const U8 layer_tint[4] = { 60, 90, 200, 255 };
+
+		U8 base[NUM_PIXELS * 4];
+		U8 layer[NUM_PIXELS];
+		U8 gradient[NUM_PIXELS];
+		random_bytes(base, sizeof(base));
+		random_bytes(layer, sizeof(layer));
+		for (S32 i = 0; i < NUM_PIXELS; i++)
+		{
+			gradient[i] = (U8)(i * 255 / (NUM_PIXELS - 1));
+		}
+
+		U8 bake[NUM_PIXELS * 4];
+		memset(bake, 0, sizeof(bake));
+		LLImageBlend::blendRGBA(bake, base, base_tint, NULL, 0, NUM_PIXELS, LLImageBlend::BLEND_REPLACE);
+
+		U8 layer_rgba[NUM_PIXELS * 4];
+		LLImageBlend::expandToRGBA(layer_rgba, layer, 1, FALSE, NUM_PIXELS);
+		U8 alpha[NUM_PIXELS];
+		memset(alpha, 0, sizeof(alpha));
+		LLImageBlend::addAlpha(alpha, gradient, NUM_PIXELS);
+		LLImageBlend::multiplyAlpha(alpha, (U8)200, NUM_PIXELS);
+		LLImageBlend::blendRGBA(bake, layer_rgba, layer_tint, alpha, LLImageBlend::DEFAULT_ALPHA_TEST,
+								NUM_PIXELS, LLImageBlend::BLEND_DEST_ALPHA);
+
+		memset(alpha, 255, sizeof(alpha));
+		LLImageBlend::insertAlpha(bake, alpha, NUM_PIXELS);
+
+		U8 expected[NUM_PIXELS * 4];
+		for (S32 i = 0; i < NUM_PIXELS; i++)
+		{
+			F32 da = (gradient[i] / 255.f) * (200.f / 255.f);
+			for (S32 c = 0; c < 3; c++)
+			{
+				F32 d = (base[i * 4 + c] / 255.f) * (base_tint[c] / 255.f);
+				F32 f = (layer[i] / 255.f) * (layer_tint[c] / 255.f);
+				expected[i * 4 + c] = (U8)(ref_blend(d, f, 1.f, da, LLImageBlend::BLEND_DEST_ALPHA) * 255.f + 0.5f);
+			}
+			expected[i * 4 + 3] = 255;
+		}
+		ensure("bake within two steps of the reference", max_difference(bake, expected, NUM_PIXELS * 4) <= 2);
+	}
+
+	template<> template<>
+	void llimageblend_object::test<6>()
+	{
+		// without an alpha plane BLEND_DEST_ALPHA reads the destination
+		// alpha and blends it too, as the GL frame buffer does
+		const U8 tint[4] = { 255, 128, 64, 200 };
+		U8 batch[NUM_PIXELS * 4];
+		U8 single[NUM_PIXELS * 4];
+		memcpy(batch, mDst, sizeof(batch));
+		memcpy(single, mDst, sizeof(single));
+		LLImageBlend::blendRGBA(batch, mSrc, tint, NULL, LLImageBlend::DEFAULT_ALPHA_TEST,
+								NUM_PIXELS, LLImageBlend::BLEND_DEST_ALPHA);
+		for (S32 i = 0; i < NUM_PIXELS; i++)
+		{
+			LLImageBlend::blendRGBA(single + i * 4, mSrc + i * 4, tint, NULL, LLImageBlend::DEFAULT_ALPHA_TEST,
+									1, LLImageBlend::BLEND_DEST_ALPHA);
+		}
+		ensure_memory_matches("batch matches single pixels", batch, sizeof(batch), single, sizeof(single));
+
+		U8 expected[NUM_PIXELS * 4];
+		for (S32 i = 0; i < NUM_PIXELS; i++)
+		{
+			F32 da = mDst[i * 4 + 3] / 255.f;
+			F32 fa = (mSrc[i * 4 + 3] / 255.f) * (tint[3] / 255.f);
+			for (S32 c = 0; c < 4; c++)
+			{
+				F32 f = (mSrc[i * 4 + c] / 255.f) * (tint[c] / 255.f);
+				F32 d = mDst[i * 4 + c] / 255.f;
+				F32 v = (fa > 0.01f) ? ref_blend(d, f, fa, da, LLImageBlend::BLEND_DEST_ALPHA) : d;
+				expected[i * 4 + c] = (U8)llclamp((S32)(v * 255.f + 0.5f), 0, 255);
+			}
+		}
+		ensure("blend within two steps of GL", max_difference(batch, expected, sizeof(batch)) <= 2);
+	}
+
+	template<> template<>
+	void llimageblend_object::test<7>()
+	{
+		// resampleRGBA against GL texture filtering
+		const S32 SIZE = 32;
+		U8 src[SIZE * SIZE * 4];
+		random_bytes(src, sizeof(src));
+
+		struct Case { S32 mWidth; S32 mHeight; BOOL mMipmapped; S32 mTolerance; };
+		const Case cases[] =
+		{
+			{ 32, 32, TRUE, 0 },	// same size, a copy
+			{ 64, 64, TRUE, 1 },	// magnified, GL_LINEAR
+			{ 16, 16, TRUE, 1 },	// exactly one mip down
+			{ 4, 8, TRUE, 1 },		// non square footprint
+			{ 12, 12, TRUE, 2 },	// between mips, trilinear
+			{ 12, 12, FALSE, 1 },	// no mips, GL_LINEAR
+		};
+		for (U32 i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+		{
+			const Case& test_case = cases[i];
+			S32 count = test_case.mWidth * test_case.mHeight * 4;
+			std::vector<U8> result(count);
+			LLImageBlend::resampleRGBA(&result[0], test_case.mWidth, test_case.mHeight,
+									   src, SIZE, SIZE, test_case.mMipmapped);
+
+			std::vector<F32> reference;
+			ref_sample(reference, src, SIZE, SIZE, test_case.mWidth, test_case.mHeight, test_case.mMipmapped);
+			std::vector<U8> expected(count);
+			for (S32 j = 0; j < count; j++)
+			{
+				expected[j] = (U8)llclamp((S32)(reference[j] + 0.5f), 0, 255);
+			}
+			ensure("resample matches GL filtering",
+				   max_difference(&result[0], &expected[0], count) <= test_case.mTolerance);
+		}
+	}
+
+	template<> template<>
+	void llimageblend_object::test<8>()
+	{
+		// Replays two masked layers the way LLTexLayerBake::run() does and
+		// compares them with a model of the GL frame buffer.  The second
+		// layer's mask starts from the alpha the first one left behind, as
+		// a layer whose first alpha param multiplies does.
+		const U8 tints[2][4] = { { 230, 190, 170, 255 }, { 60, 90, 200, 230 } };
+		const U8 mask_values[2] = { 180, 140 };
+
+		U8 layers[2][NUM_PIXELS * 4];
+		U8 gradients[2][NUM_PIXELS];
+		random_bytes(layers[0], sizeof(layers[0]));
+		random_bytes(layers[1], sizeof(layers[1]));
+		random_bytes(gradients[0], sizeof(gradients[0]));
+		random_bytes(gradients[1], sizeof(gradients[1]));
+
+		// CPU: mask in a plane, copied into the color alpha before the draw
+		U8 bake[NUM_PIXELS * 4];
+		memset(bake, 0, sizeof(bake));
+		U8 alpha[NUM_PIXELS];
+		for (S32 l = 0; l < 2; l++)
+		{
+			if (l == 0)
+			{
+				memset(alpha, 0, sizeof(alpha));
+				LLImageBlend::addAlpha(alpha, gradients[l], NUM_PIXELS);
+			}
+			else
+			{
+				LLImageBlend::extractAlpha(alpha, bake, NUM_PIXELS);
+				LLImageBlend::multiplyAlpha(alpha, gradients[l], NUM_PIXELS);
+			}
+			LLImageBlend::multiplyAlpha(alpha, mask_values[l], NUM_PIXELS);
+			LLImageBlend::insertAlpha(bake, alpha, NUM_PIXELS);
+			LLImageBlend::blendRGBA(bake, layers[l], tints[l], NULL, LLImageBlend::DEFAULT_ALPHA_TEST,
+									NUM_PIXELS, LLImageBlend::BLEND_DEST_ALPHA);
+		}
+		memset(alpha, 255, sizeof(alpha));
+		LLImageBlend::insertAlpha(bake, alpha, NUM_PIXELS);
+
+		// GL: one RGBA buffer, the mask drawn with only alpha writes enabled
+		std::vector<F32> frame(NUM_PIXELS * 4, 0.f);
+		for (S32 l = 0; l < 2; l++)
+		{
+			for (S32 i = 0; i < NUM_PIXELS; i++)
+			{
+				F32* dst = &frame[i * 4];
+				F32 g = gradients[l][i] / 255.f;
+				dst[3] = (l == 0) ? g : dst[3] * g;
+				dst[3] *= mask_values[l] / 255.f;
+
+				F32 frag[4];
+				for (S32 c = 0; c < 4; c++)
+				{
+					frag[c] = (layers[l][i * 4 + c] / 255.f) * (tints[l][c] / 255.f);
+				}
+				if (frag[3] > 0.01f)
+				{
+					F32 da = dst[3];
+					for (S32 c = 0; c < 4; c++)
+					{
+						dst[c] = ref_blend(dst[c], frag[c], frag[3], da, LLImageBlend::BLEND_DEST_ALPHA);
+					}
+				}
+			}
+		}
+		U8 expected[NUM_PIXELS * 4];
+		for (S32 i = 0; i < NUM_PIXELS * 4; i++)
+		{
+			expected[i] = (i % 4 == 3) ? 255 : (U8)llclamp((S32)(frame[i] * 255.f + 0.5f), 0, 255);
+		}
+		ensure("replay within three steps of GL", max_difference(bake, expected, sizeof(bake)) <= 3);
+	}
+}
@@ -0,0 +1,400 @@
+/** 
+ * @file llimagedxt_tut.cpp
+ * @brief LLImageDXT S3TC encoder test cases.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include <tut/tut.hpp>
+#include "linden_common.h"
+#include "lltut.h"
+
+#include <vector>
+#include "llimagedxt.h"
+
+namespace
+{
+	void unpack_565(U16 c, S32* rgb)
+	{
+		S32 r = (c >> 11) & 0x1f;
+		S32 g = (c >> 5) & 0x3f;
+		S32 b = c & 0x1f;
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	// Reference S3TC decoders, as the GL spec defines them.  Both write
+	// 16 RGBA texels in row order.
+	void decode_color_block(const U8* block, U8* texels)
+	{
+		U16 color0 = block[0] | (block[1] << 8);
+		U16 color1 = block[2] | (block[3] << 8);
+		S32 palette[4][3];
+		unpack_565(color0, palette[0]);
+		unpack_565(color1, palette[1]);
+		for (S32 c = 0; c < 3; c++)
+		{
+			if (color0 > color1)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			else
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+		U32 indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((U32)block[7] << 24);
+		for (S32 i = 0; i < 16; i++)
+		{
+			U32 p = (indices >> (i * 2)) & 3;
+			for (S32 c = 0; c < 3; c++)
+			{
+				texels[i*4+c] = (U8)palette[p][c];
+			}
+			texels[i*4+3] = 255;
+		}
+	}
+
+	void decode_alpha_block(const U8* block, U8* texels)
+	{
+		S32 palette[8];
+		palette[0] = block[0];
+		palette[1] = block[1];
+		if (palette[0] > palette[1])
+		{
+			for (S32 p = 2; p < 8; p++)
+			{
+				palette[p] = ((8 - p) * palette[0] + (p - 1) * palette[1]) / 7;
+			}
+		}
+		else
+		{
+			for (S32 p = 2; p < 6; p++)
+			{
+				palette[p] = ((6 - p) * palette[0] + (p - 1) * palette[1]) / 5;
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+		U64 indices = 0;
+		for (S32 b = 0; b < 6; b++)
+		{
+			indices |= (U64)block[2+b] << (b * 8);
+		}
+		for (S32 i = 0; i < 16; i++)
+		{
+			texels[i*4+3] = (U8)palette[(indices >> (i * 3)) & 7];
+		}
+	}
+
+	// Decodes one mip of a DXR1/DXR5 image to RGBA
+	void decode_mip(LLImageDXT* dxt, S32 discard, std::vector<U8>& rgba)
+	{
+		S32 width = llmax(dxt->getWidth() >> discard, 1);
+		S32 height = llmax(dxt->getHeight() >> discard, 1);
+		bool alpha = dxt->getFileFormat() == LLImageDXT::FORMAT_DXR5;
+		const U8* block = dxt->getData() + dxt->getMipOffset(discard);
+		rgba.resize(width * height * 4);
+		U8 texels[16*4];
+		for (S32 by = 0; by < height; by += 4)
+		{
+			for (S32 bx = 0; bx < width; bx += 4)
+			{
+				if (alpha)
+				{
+					decode_color_block(block + 8, texels);
+					decode_alpha_block(block, texels);
+					block += 16;
+				}
+				else
+				{
+					decode_color_block(block, texels);
+					block += 8;
+				}
+				for (S32 y = 0; y < 4 && by + y < height; y++)
+				{
+					for (S32 x = 0; x < 4 && bx + x < width; x++)
+					{
+						memcpy(&rgba[((by + y) * width + bx + x) * 4], texels + (y * 4 + x) * 4, 4);
+					}
+				}
+			}
+		}
+	}
+
+	// What 565 storage makes of an 8 bit color
+	void quantize_565(const U8* rgb, S32* out)
+	{
+		unpack_565((U16)(((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3)), out);
+	}
+}
+
+namespace tut
+{
+	struct llimagedxt_data
+	{
+		llimagedxt_data()
+		{
+			LLImage::initClass();
+		}
+		~llimagedxt_data()
+		{
+			LLImage::cleanupClass();
+		}
+
+		LLPointer<LLImageDXT> encode(LLImageRaw* raw, S32 discard = 0, bool alpha_mask = false)
+		{
+			LLPointer<LLImageDXT> dxt = new LLImageDXT;
+			ensure("encodeCompressed", dxt->encodeCompressed(raw, discard, alpha_mask) == TRUE);
+			return dxt;
+		}
+	};
+	typedef test_group<llimagedxt_data> llimagedxt_test;
+	typedef llimagedxt_test::object llimagedxt_object;
+	tut::llimagedxt_test llimagedxt_testcase("llimagedxt");
+
+	template<> template<>
+	void llimagedxt_object::test<1>()
+	{
+		// layout: header, then the full mip chain, and a reload through
+		// updateData() sees the same image
+		LLPointer<LLImageRaw> raw = new LLImageRaw(64, 32, 3);
+		memset(raw->getData(), 128, raw->getDataSize());
+		LLPointer<LLImageDXT> dxt = encode(raw, 2, false);
+
+		ensure_equals("opaque format", dxt->getFileFormat(), LLImageDXT::FORMAT_DXR1);
+		S32 expected = sizeof(LLImageDXT::dxtfile_header_t);
+		S32 num_mips = LLImageDXT::calcNumMips(64, 32);
+		for (S32 mip = 0, w = 64, h = 32; mip < num_mips; mip++, w >>= 1, h >>= 1)
+		{
+			expected += LLImageDXT::formatBytes(LLImageDXT::FORMAT_DXR1, w, h);
+		}
+		ensure_equals("data size", dxt->getDataSize(), expected);
+
+		LLPointer<LLImageDXT> loaded = new LLImageDXT;
+		memcpy(loaded->allocateData(dxt->getDataSize()), dxt->getData(), dxt->getDataSize());
+		ensure("updateData", loaded->updateData() == TRUE);
+		ensure("compressed", loaded->isCompressed());
+		ensure_equals("width", (S32)loaded->getWidth(), 64);
+		ensure_equals("height", (S32)loaded->getHeight(), 32);
+		ensure_equals("source discard", loaded->getSourceDiscard(), 2);
+		ensure("no alpha mask", !loaded->isAlphaMask());
+		ensure_equals("all mips present", loaded->calcDataSize(0), dxt->getDataSize());
+	}
+
+	template<> template<>
+	void llimagedxt_object::test<2>()
+	{
+		// a single color per block survives exactly, up to 565 storage
+		const S32 size = 16;
+		LLPointer<LLImageRaw> raw = new LLImageRaw(size, size, 3);
+		U8* data = raw->getData();
+		for (S32 y = 0; y < size; y++)
+		{
+			for (S32 x = 0; x < size; x++)
+			{
+				S32 block = (y / 4) * 4 + x / 4;
+				U8* texel = data + (y * size + x) * 3;
+				texel[0] = (U8)(block * 17);
+				texel[1] = (U8)(255 - block * 13);
+				texel[2] = (U8)(block * 71);
+			}
+		}
+		LLPointer<LLImageDXT> dxt = encode(raw);
+
+		std::vector<U8> decoded;
+		decode_mip(dxt, 0, decoded);
+		for (S32 i = 0; i < size * size; i++)
+		{
+			S32 expected[3];
+			quantize_565(data + i * 3, expected);
+			for (S32 c = 0; c < 3; c++)
+			{
+				ensure_equals("flat block", (S32)decoded[i*4+c], expected[c]);
+			}
+		}
+	}
+
+	template<> template<>
+	void llimagedxt_object::test<3>()
+	{
+		// Colors along a line in every block, including lines where some
+		// channels fall as others rise.  Each channel stays within a sixth
+		// of its range (the palette spacing) plus the endpoint inset and
+		// 565 rounding.
+		const S32 size = 64;
+		LLPointer<LLImageRaw> raw = new LLImageRaw(size, size, 3);
+		U8* data = raw->getData();
+		for (S32 by = 0; by < size; by += 4)
+		{
+			for (S32 bx = 0; bx < size; bx += 4)
+			{
+				S32 seed = by * size + bx;
+				S32 base[3], dir[3];
+				for (S32 c = 0; c < 3; c++)
+				{
+					base[c] = (seed * (c + 3) * 37 + c * 101) % 256;
+					dir[c] = ((seed * (c + 7) * 53 + c * 59) % 256) - base[c];
+				}
+				for (S32 y = 0; y < 4; y++)
+				{
+					for (S32 x = 0; x < 4; x++)
+					{
+						S32 t = (x * 7 + y * 5 + seed) % 16;
+						U8* texel = data + ((by + y) * size + bx + x) * 3;
+						for (S32 c = 0; c < 3; c++)
+						{
+							texel[c] = (U8)(base[c] + dir[c] * t / 15);
+						}
+					}
+				}
+			}
+		}
+		LLPointer<LLImageDXT> dxt = encode(raw);
+
+		std::vector<U8> decoded;
+		decode_mip(dxt, 0, decoded);
+		for (S32 by = 0; by < size; by += 4)
+		{
+			for (S32 bx = 0; bx < size; bx += 4)
+			{
+				S32 lo[3] = { 255, 255, 255 };
+				S32 hi[3] = { 0, 0, 0 };
+				for (S32 i = 0; i < 16; i++)
+				{
+					const U8* texel = data + ((by + i / 4) * size + bx + i % 4) * 3;
+					for (S32 c = 0; c < 3; c++)
+					{
+						lo[c] = llmin(lo[c], (S32)texel[c]);
+						hi[c] = llmax(hi[c], (S32)texel[c]);
+					}
+				}
+				for (S32 i = 0; i < 16; i++)
+				{
+					S32 offset = (by + i / 4) * size + bx + i % 4;
+					for (S32 c = 0; c < 3; c++)
+					{
+						S32 range = hi[c] - lo[c];
+						S32 error = llabs((S32)decoded[offset*4+c] - (S32)data[offset*3+c]);
+						ensure("gradient block error", error <= range / 6 + range / 16 + 8);
+					}
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void llimagedxt_object::test<4>()
+	{
+		// any alpha below 255 selects DXR5; a 0/255 mask is kept exactly
+		const S32 size = 32;
+		LLPointer<LLImageRaw> raw = new LLImageRaw(size, size, 4);
+		U8* data = raw->getData();
+		for (S32 i = 0; i < size * size; i++)
+		{
+			data[i*4+0] = (U8)(i * 3);
+			data[i*4+1] = (U8)(i * 5);
+			data[i*4+2] = (U8)(i * 7);
+			data[i*4+3] = ((i / 2 + i / size) & 1) ? 255 : 0;
+		}
+		LLPointer<LLImageDXT> dxt = encode(raw, 0, true);
+		ensure_equals("alpha format", dxt->getFileFormat(), LLImageDXT::FORMAT_DXR5);
+		ensure("alpha mask flag", dxt->isAlphaMask());
+
+		std::vector<U8> decoded;
+		decode_mip(dxt, 0, decoded);
+		for (S32 i = 0; i < size * size; i++)
+		{
+			ensure_equals("mask alpha", (S32)decoded[i*4+3], (S32)data[i*4+3]);
+		}
+
+		// soft alpha is within half a step of the 8 value palette
+		for (S32 i = 0; i < size * size; i++)
+		{
+			data[i*4+3] = (U8)((i * 11) % 256);
+		}
+		dxt = encode(raw);
+		decode_mip(dxt, 0, decoded);
+		for (S32 by = 0; by < size; by += 4)
+		{
+			for (S32 bx = 0; bx < size; bx += 4)
+			{
+				S32 lo = 255, hi = 0;
+				for (S32 i = 0; i < 16; i++)
+				{
+					S32 a = data[((by + i / 4) * size + bx + i % 4) * 4 + 3];
+					lo = llmin(lo, a);
+					hi = llmax(hi, a);
+				}
+				for (S32 i = 0; i < 16; i++)
+				{
+					S32 offset = ((by + i / 4) * size + bx + i % 4) * 4 + 3;
+					S32 error = llabs((S32)decoded[offset] - (S32)data[offset]);
+					ensure("soft alpha error", error <= (hi - lo) / 14 + 1);
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void llimagedxt_object::test<5>()
+	{
+		// four components with opaque alpha don't pay for the alpha block,
+		// and the mips below one block repeat their edge texels
+		const S32 size = 16;
+		const U8 color[3] = { 200, 100, 40 };
+		LLPointer<LLImageRaw> raw = new LLImageRaw(size, size, 4);
+		U8* data = raw->getData();
+		for (S32 i = 0; i < size * size; i++)
+		{
+			memcpy(data + i * 4, color, 3);
+			data[i*4+3] = 255;
+		}
+		LLPointer<LLImageDXT> dxt = encode(raw);
+		ensure_equals("opaque format", dxt->getFileFormat(), LLImageDXT::FORMAT_DXR1);
+
+		S32 expected[3];
+		quantize_565(color, expected);
+		std::vector<U8> decoded;
+		S32 num_mips = LLImageDXT::calcNumMips(size, size);
+		for (S32 discard = 0; discard < num_mips; discard++)
+		{
+			decode_mip(dxt, discard, decoded);
+			for (U32 i = 0; i < decoded.size() / 4; i++)
+			{
+				for (S32 c = 0; c < 3; c++)
+				{
+					ensure_equals("flat mip", (S32)decoded[i*4+c], expected[c]);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,137 @@
+/** 
+ * @file llimagej2c_bench.cpp
+ * @brief J2C decode timings for discard level refinement.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "llbenchmark.h"
+
+#include "llimage.h"
+#include "llimagej2c.h"
+#include "llrand.h"
+#include "lltimer.h"
+
+namespace
+{
+	const S32 IMAGE_SIZE = 1024;
+	const U32 BENCH_PASSES = 5;
+
+	// A 1024x1024 RGBA texture with smooth gradients and some noise, so
+	// every resolution level carries data.
+	LLPointer<LLImageJ2C> encodeTestImage()
+	{
+		LLPointer<LLImageRaw> raw = new LLImageRaw(IMAGE_SIZE, IMAGE_SIZE, 4);
+		U8* data = raw->getData();
+		for (S32 y = 0; y < IMAGE_SIZE; y++)
+		{
+			for (S32 x = 0; x < IMAGE_SIZE; x++)
+			{
+				U8* pixel = data + (y * IMAGE_SIZE + x) * 4;
+				pixel[0] = (U8) (x / 4);
+				pixel[1] = (U8) (y / 4);
+				pixel[2] = (U8) ((x ^ y) + ll_rand(16));
+				pixel[3] = (U8) (128 + ll_rand(64));
+			}
+		}
+
+		LLPointer<LLImageJ2C> j2c = new LLImageJ2C;
+		j2c->encode(raw, 0.f);
+		return j2c;
+	}
+
+	LLPointer<LLImageJ2C> copyCodestream(LLImageJ2C* source, S32 size)
+	{
+		// the way the fetcher hands over its buffer: setData() takes ownership
+		size = llmin(size, source->getDataSize());
+		U8* data = new U8[size];
+		memcpy(data, source->getData(), size);
+		LLPointer<LLImageJ2C> j2c = new LLImageJ2C;
+		j2c->setData(data, size);
+		j2c->updateData();
+		return j2c;
+	}
+
+	// Refining a texture from discard 3 to discard 0 as the fetcher does:
+	// decode the first bytes at discard 3, append the rest and decode again
+	// at discard 0.  OpenJPEG 1.x can't resume a decode, so the second
+	// decode costs as much as a cold discard 0 decode.  This is the baseline
+	// for a decoder that only decodes the added resolution levels.
+	class J2CRefineBenchmark : public LLBenchmark
+	{
+	public:
+		J2CRefineBenchmark() : LLBenchmark("j2c refine") { }
+
+		virtual void run()
+		{
+			LLImage::initClass();
+			LLPointer<LLImageJ2C> source = encodeTestImage();
+			check(source->getDataSize() > 0, "encode failed");
+
+			S32 partial_size = source->calcDataSize(3);
+			F64 coarse_time = 0.0;
+			F64 refine_time = 0.0;
+			F64 cold_time = 0.0;
+			LLTimer timer;
+
+			for (U32 pass = 0; pass < BENCH_PASSES; pass++)
+			{
+				LLPointer<LLImageJ2C> j2c = copyCodestream(source, partial_size);
+				LLPointer<LLImageRaw> raw = new LLImageRaw;
+
+				timer.reset();
+				j2c->setDiscardLevel(3);
+				j2c->decode(raw, 1000.f);
+				coarse_time += timer.getElapsedTimeF64();
+				check(raw->getWidth() == IMAGE_SIZE >> 3, "discard 3 decode failed");
+
+				timer.reset();
+				j2c->appendData(source->getData() + j2c->getDataSize(), source->getDataSize() - j2c->getDataSize());
+				j2c->updateData();
+				j2c->setDiscardLevel(0);
+				j2c->decode(raw, 1000.f);
+				refine_time += timer.getElapsedTimeF64();
+				check(raw->getWidth() == IMAGE_SIZE, "refined decode failed");
+
+				LLPointer<LLImageJ2C> cold = copyCodestream(source, source->getDataSize());
+				timer.reset();
+				cold->setDiscardLevel(0);
+				cold->decode(raw, 1000.f);
+				cold_time += timer.getElapsedTimeF64();
+			}
+
+			report("discard 3 decode", coarse_time, BENCH_PASSES);
+			report("refine to discard 0", refine_time, BENCH_PASSES);
+			report("cold discard 0 decode", cold_time, BENCH_PASSES);
+			LLImage::cleanupClass();
+		}
+	};
+
+	J2CRefineBenchmark sJ2CRefineBenchmark;
+}
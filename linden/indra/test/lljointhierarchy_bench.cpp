@@ -0,0 +1,157 @@
+/** 
+ * @file lljointhierarchy_bench.cpp
+ * @brief Avatar joint world matrix update timings.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "llbenchmark.h"
+
+#include <sstream>
+#include "lljointhierarchy.h"
+#include "lltimer.h"
+
+// A crowd of avatar-sized skeletons with a third of their joints rotated
+// every frame, the way motions leave them.  The baseline is the recursive
+// updateWorldMatrixChildren() walk; the hierarchy brings world positions
+// and rotations down the flattened tree and then builds the matrices in
+// batches.  Both sides run on identical skeletons and must end up with
+// identical matrices.
+
+namespace
+{
+	const S32 NUM_AVATARS = 100;
+	const U32 BENCH_FRAMES = 200;
+
+	// roughly the avatar's shape: a pelvis with five chains of four
+	// skeleton joints, each carrying collision volumes and attachment points
+	void build_skeleton(std::vector<LLJoint*>& joints)
+	{
+		LLJoint* root = new LLJoint("root");
+		root->mUpdateXform = TRUE;
+		joints.push_back(root);
+		LLJoint* pelvis = new LLJoint("pelvis", root);
+		joints.push_back(pelvis);
+		for (S32 chain = 0; chain < 5; chain++)
+		{
+			LLJoint* parent = pelvis;
+			for (S32 depth = 0; depth < 4; depth++)
+			{
+				LLJoint* joint = new LLJoint("joint", parent);
+				joint->setPosition(LLVector3(0.1f, 0.f, 0.2f));
+				joints.push_back(joint);
+				for (S32 extra = 0; extra < 5; extra++)
+				{
+					LLJoint* leaf = new LLJoint("leaf", joint);
+					leaf->setPosition(LLVector3(0.f, 0.05f, 0.f));
+					joints.push_back(leaf);
+				}
+				parent = joint;
+			}
+		}
+		for (U32 i = 0; i < joints.size(); i++)
+		{
+			joints[i]->mUpdateXform = TRUE;
+		}
+	}
+
+	class JointHierarchyBenchmark : public LLBenchmark
+	{
+	public:
+		JointHierarchyBenchmark() : LLBenchmark("joint hierarchy") { }
+
+		virtual void run()
+		{
+			std::vector<std::vector<LLJoint*> > recursive(NUM_AVATARS);
+			std::vector<std::vector<LLJoint*> > flattened(NUM_AVATARS);
+			std::vector<LLJointHierarchy> hierarchies(NUM_AVATARS);
+			for (S32 a = 0; a < NUM_AVATARS; a++)
+			{
+				build_skeleton(recursive[a]);
+				build_skeleton(flattened[a]);
+				hierarchies[a].setRoot(flattened[a][0]);
+			}
+
+			F64 recursive_time = 0.0;
+			F64 flattened_time = 0.0;
+			LLTimer timer;
+			bool same = true;
+			for (U32 frame = 0; frame < BENCH_FRAMES; frame++)
+			{
+				LLQuaternion rotation(0.01f * frame, LLVector3(0.f, 0.f, 1.f));
+				for (S32 a = 0; a < NUM_AVATARS; a++)
+				{
+					for (U32 i = 1; i < recursive[a].size(); i += 3)
+					{
+						recursive[a][i]->setRotation(rotation);
+						flattened[a][i]->setRotation(rotation);
+					}
+				}
+
+				timer.reset();
+				for (S32 a = 0; a < NUM_AVATARS; a++)
+				{
+					recursive[a][0]->updateWorldMatrixChildren();
+				}
+				recursive_time += timer.getElapsedTimeF64();
+
+				timer.reset();
+				for (S32 a = 0; a < NUM_AVATARS; a++)
+				{
+					hierarchies[a].updateWorldMatrices();
+				}
+				flattened_time += timer.getElapsedTimeF64();
+
+				const std::vector<LLJoint*>& lhs = recursive[NUM_AVATARS - 1];
+				const std::vector<LLJoint*>& rhs = flattened[NUM_AVATARS - 1];
+				for (U32 i = 0; i < lhs.size(); i++)
+				{
+					same = same && lhs[i]->getXform()->getWorldMatrix() == rhs[i]->getXform()->getWorldMatrix();
+				}
+			}
+			check(same, "flattened matrices differ from the recursive walk");
+
+			std::ostringstream label;
+			label << NUM_AVATARS << " avatars of " << hierarchies[0].getNumJoints() << " joints, ";
+			report(label.str() + "recursive", recursive_time, BENCH_FRAMES);
+			report(label.str() + "flattened", flattened_time, BENCH_FRAMES);
+
+			for (S32 a = 0; a < NUM_AVATARS; a++)
+			{
+				for (S32 i = (S32) recursive[a].size() - 1; i >= 0; i--)
+				{
+					delete recursive[a][i];
+					delete flattened[a][i];
+				}
+			}
+		}
+	};
+
+	JointHierarchyBenchmark sJointHierarchyBenchmark;
+}
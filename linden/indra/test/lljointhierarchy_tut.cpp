@@ -0,0 +1,199 @@
+/** 
+ * @file lljointhierarchy_tut.cpp
+ * @brief LLJointHierarchy test cases.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include <tut/tut.hpp>
+#include "linden_common.h"
+#include "lltut.h"
+
+#include <vector>
+#include "lljointhierarchy.h"
+
+namespace tut
+{
+	struct lljointhierarchy_data
+	{
+		enum { NUM_CHAINS = 3, CHAIN_LENGTH = 4, NUM_LEAVES = 3 };
+
+		// two identical skeletons, one updated recursively and one through
+		// a hierarchy
+		lljointhierarchy_data()
+		{
+			buildSkeleton(mRecursive);
+			buildSkeleton(mFlattened);
+		}
+
+		~lljointhierarchy_data()
+		{
+			deleteSkeleton(mRecursive);
+			deleteSkeleton(mFlattened);
+		}
+
+		void buildSkeleton(std::vector<LLJoint*>& joints)
+		{
+			LLJoint* root = new LLJoint("root");
+			root->mUpdateXform = TRUE;
+			joints.push_back(root);
+			for (S32 c = 0; c < NUM_CHAINS; c++)
+			{
+				LLJoint* parent = root;
+				for (S32 d = 0; d < CHAIN_LENGTH; d++)
+				{
+					LLJoint* joint = new LLJoint("joint", parent);
+					joint->mUpdateXform = TRUE;
+					joint->setPosition(LLVector3(0.1f * c, 0.02f, 0.2f));
+					joint->setScale(LLVector3(1.f, 1.f + 0.1f * d, 1.f));
+					joints.push_back(joint);
+					for (S32 l = 0; l < NUM_LEAVES; l++)
+					{
+						LLJoint* leaf = new LLJoint("leaf", joint);
+						leaf->mUpdateXform = TRUE;
+						leaf->setPosition(LLVector3(0.f, 0.05f * l, 0.01f));
+						joints.push_back(leaf);
+					}
+					parent = joint;
+				}
+			}
+		}
+
+		void deleteSkeleton(std::vector<LLJoint*>& joints)
+		{
+			// children first
+			for (S32 i = (S32) joints.size() - 1; i >= 0; i--)
+			{
+				delete joints[i];
+			}
+			joints.clear();
+		}
+
+		void rotate(S32 frame)
+		{
+			for (U32 i = 1; i < mRecursive.size(); i += 3)
+			{
+				LLQuaternion rotation(0.1f * frame + 0.01f * i, LLVector3(0.3f, 0.5f, 0.8f));
+				mRecursive[i]->setRotation(rotation);
+				mFlattened[i]->setRotation(rotation);
+			}
+		}
+
+		void ensureSameMatrices()
+		{
+			for (U32 i = 0; i < mRecursive.size(); i++)
+			{
+				const LLMatrix4& expected = mRecursive[i]->getXform()->getWorldMatrix();
+				const LLMatrix4& actual = mFlattened[i]->getXform()->getWorldMatrix();
+				for (S32 r = 0; r < 4; r++)
+				{
+					for (S32 c = 0; c < 4; c++)
+					{
+						ensure_equals("world matrix", actual.mMatrix[r][c], expected.mMatrix[r][c]);
+					}
+				}
+				ensure_equals("dirty flags", mFlattened[i]->mDirtyFlags, mRecursive[i]->mDirtyFlags);
+			}
+		}
+
+		std::vector<LLJoint*> mRecursive;
+		std::vector<LLJoint*> mFlattened;
+	};
+	typedef test_group<lljointhierarchy_data> lljointhierarchy_test;
+	typedef lljointhierarchy_test::object lljointhierarchy_object;
+	tut::lljointhierarchy_test lljointhierarchy_testcase("jointhierarchy");
+
+	template<> template<>
+	void lljointhierarchy_object::test<1>()
+	{
+		// the batched matrix pass matches the recursive walk exactly,
+		// including the partial batch at the end
+		LLJointHierarchy hierarchy;
+		hierarchy.setRoot(mFlattened[0]);
+		ensure_equals("every joint", hierarchy.getNumJoints(), (S32) mFlattened.size());
+		for (S32 frame = 0; frame < 5; frame++)
+		{
+			rotate(frame);
+			mRecursive[0]->updateWorldMatrixChildren();
+			hierarchy.updateWorldMatrices();
+			ensureSameMatrices();
+		}
+	}
+
+	template<> template<>
+	void lljointhierarchy_object::test<2>()
+	{
+		// a joint that doesn't update its transform hides its subtree
+		LLJointHierarchy hierarchy;
+		hierarchy.setRoot(mFlattened[0]);
+		mRecursive[1]->mUpdateXform = FALSE;
+		mFlattened[1]->mUpdateXform = FALSE;
+		rotate(1);
+		mRecursive[0]->updateWorldMatrixChildren();
+		hierarchy.updateWorldMatrices();
+		ensureSameMatrices();
+	}
+
+	template<> template<>
+	void lljointhierarchy_object::test<3>()
+	{
+		// reparenting rebuilds only the hierarchies above the joint moved
+		LLJointHierarchy recursive;
+		LLJointHierarchy flattened;
+		recursive.setRoot(mRecursive[0]);
+		flattened.setRoot(mFlattened[0]);
+		S32 num_joints = flattened.getNumJoints();
+		ensure_equals("same size", recursive.getNumJoints(), num_joints);
+
+		U32 serial = mRecursive[0]->mHierarchySerial;
+		LLJoint* extra = new LLJoint("extra");
+		extra->mUpdateXform = TRUE;
+		mFlattened[2]->addChild(extra);
+		ensure_equals("untouched skeleton", mRecursive[0]->mHierarchySerial, serial);
+		ensure_equals("untouched skeleton size", recursive.getNumJoints(), num_joints);
+		ensure_equals("joint added", flattened.getNumJoints(), num_joints + 1);
+
+		extra->setRotation(LLQuaternion(0.5f, LLVector3(0.f, 0.f, 1.f)));
+		flattened.updateWorldMatrices();
+		LLMatrix4 expected = extra->getXform()->getWorldMatrix();
+		extra->touch();
+		extra->updateWorldMatrixParent();
+		const LLMatrix4& actual = extra->getXform()->getWorldMatrix();
+		for (S32 r = 0; r < 4; r++)
+		{
+			for (S32 c = 0; c < 4; c++)
+			{
+				ensure_equals("added joint updated", actual.mMatrix[r][c], expected.mMatrix[r][c]);
+			}
+		}
+
+		delete extra;
+		ensure_equals("joint removed", flattened.getNumJoints(), num_joints);
+	}
+}
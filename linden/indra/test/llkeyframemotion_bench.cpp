@@ -0,0 +1,153 @@
+/** 
+ * @file llkeyframemotion_bench.cpp
+ * @brief Keyframe rotation curve sampling timings.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "llbenchmark.h"
+
+#include <iostream>
+#include <map>
+#include "llkeyframemotion.h"
+#include "llrand.h"
+#include "lltimer.h"
+
+// Avatars in a crowd playing the same few looping animations.  The baseline
+// is the per-key std::map LLKeyframeMotion used to keep, sampled with
+// lower_bound; the current curves keep sorted arrays of keys and a cursor
+// per avatar.  Both hold the same rotations, so they must sample to the
+// same values.
+
+namespace
+{
+	const S32 NUM_ANIMATIONS = 3;
+	const S32 NUM_JOINTS = 20;
+	const S32 NUM_KEYS = 120;
+	const S32 NUM_AVATARS = 100;
+	const U32 BENCH_FRAMES = 600;
+	const F32 DURATION = 4.f;
+
+	typedef std::map<F32, LLKeyframeMotion::RotationKey> rotation_key_map_t;
+
+	LLQuaternion sample_map(const rotation_key_map_t& keys, F32 time)
+	{
+		rotation_key_map_t::const_iterator right = keys.lower_bound(time);
+		if (right == keys.end())
+		{
+			--right;
+			return right->second.mRotation;
+		}
+		if (right == keys.begin() || right->first == time)
+		{
+			return right->second.mRotation;
+		}
+		rotation_key_map_t::const_iterator left = right;
+		--left;
+		F32 u = (time - left->first) / (right->first - left->first);
+		return nlerp(u, left->second.mRotation, right->second.mRotation);
+	}
+
+	class KeyframeBenchmark : public LLBenchmark
+	{
+	public:
+		KeyframeBenchmark() : LLBenchmark("keyframe curves") { }
+
+		virtual void run()
+		{
+			const S32 num_curves = NUM_ANIMATIONS * NUM_JOINTS;
+			std::vector<LLKeyframeMotion::RotationCurve> curves(num_curves);
+			std::vector<rotation_key_map_t> maps(num_curves);
+			U32 curve_bytes = 0;
+			for (S32 c = 0; c < num_curves; c++)
+			{
+				for (S32 k = 0; k < NUM_KEYS; k++)
+				{
+					F32 time = DURATION * k / (NUM_KEYS - 1);
+					LLQuaternion rotation(ll_frand(F_TWO_PI), LLVector3(ll_frand(), ll_frand(), ll_frand()));
+					LLKeyframeMotion::RotationKey key(time, rotation);
+					curves[c].addKey(key);
+					maps[c][time] = key;
+				}
+				curve_bytes += curves[c].getMemoryUsage();
+			}
+
+			std::vector<F32> phases(NUM_AVATARS);
+			for (S32 a = 0; a < NUM_AVATARS; a++)
+			{
+				phases[a] = ll_frand(DURATION);
+			}
+			std::vector<S32> cursors(NUM_AVATARS * num_curves, 0);
+
+			F64 map_time = 0.0;
+			F64 curve_time = 0.0;
+			LLTimer timer;
+			LLQuaternion map_sum;
+			LLQuaternion curve_sum;
+			for (U32 frame = 0; frame < BENCH_FRAMES; frame++)
+			{
+				timer.reset();
+				for (S32 a = 0; a < NUM_AVATARS; a++)
+				{
+					F32 time = fmodf(phases[a] + frame / 60.f, DURATION);
+					for (S32 c = 0; c < num_curves; c++)
+					{
+						map_sum = map_sum + sample_map(maps[c], time);
+					}
+				}
+				map_time += timer.getElapsedTimeF64();
+
+				timer.reset();
+				for (S32 a = 0; a < NUM_AVATARS; a++)
+				{
+					F32 time = fmodf(phases[a] + frame / 60.f, DURATION);
+					S32* cursor = &cursors[a * num_curves];
+					for (S32 c = 0; c < num_curves; c++)
+					{
+						curve_sum = curve_sum + curves[c].getValue(time, DURATION, cursor[c]);
+					}
+				}
+				curve_time += timer.getElapsedTimeF64();
+			}
+			check(map_sum == curve_sum, "curve samples differ from the map");
+
+			// what the map nodes cost, roughly: the key plus four pointers
+			// and a color per node, before allocator overhead
+			U32 map_bytes = num_curves * NUM_KEYS
+				* (sizeof(rotation_key_map_t::value_type) + 4 * sizeof(void*));
+			std::cout << "  " << num_curves * NUM_KEYS << " keys: map about " << map_bytes
+					  << " bytes, curves " << curve_bytes << " bytes" << std::endl;
+
+			report("std::map", map_time, BENCH_FRAMES);
+			report("sorted arrays with cursors", curve_time, BENCH_FRAMES);
+		}
+	};
+
+	KeyframeBenchmark sKeyframeBenchmark;
+}
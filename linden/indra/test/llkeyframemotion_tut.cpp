@@ -0,0 +1,126 @@
+/** 
+ * @file llkeyframemotion_tut.cpp
+ * @brief LLKeyframeMotion curve test cases.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include <tut/tut.hpp>
+#include "linden_common.h"
+#include "lltut.h"
+
+#include "llkeyframemotion.h"
+
+namespace tut
+{
+	struct llkeyframemotion_data
+	{
+		enum { NUM_KEYS = 16 };
+
+		// a rotation no U16 triple can represent exactly
+		LLQuaternion keyRotation(S32 k)
+		{
+			LLQuaternion rotation(0.1f + 0.0137f * k, LLVector3(0.3f, 0.5f, 0.7f));
+			rotation.normQuat();
+			return rotation;
+		}
+
+		void ensureQuatEquals(const char* msg, const LLQuaternion& actual, const LLQuaternion& expected)
+		{
+			for (S32 i = 0; i < 4; i++)
+			{
+				ensure_equals(msg, actual.mQ[i], expected.mQ[i]);
+			}
+		}
+	};
+	typedef test_group<llkeyframemotion_data> llkeyframemotion_test;
+	typedef llkeyframemotion_test::object llkeyframemotion_object;
+	tut::llkeyframemotion_test llkeyframemotion_testcase("keyframemotion");
+
+	template<> template<>
+	void llkeyframemotion_object::test<1>()
+	{
+		// keys keep their full rotations, whichever asset format they came from
+		LLKeyframeMotion::RotationCurve curve;
+		for (S32 k = 0; k < NUM_KEYS; k++)
+		{
+			curve.addKey(LLKeyframeMotion::RotationKey((F32) k, keyRotation(k)));
+		}
+		ensure_equals("key count", curve.mNumKeys, (S32) NUM_KEYS);
+		for (S32 k = 0; k < NUM_KEYS; k++)
+		{
+			ensureQuatEquals("key rotation", curve.mKeyRotations[k], keyRotation(k));
+			ensureQuatEquals("value at key", curve.getValue((F32) k, (F32) NUM_KEYS), keyRotation(k));
+		}
+
+		LLQuaternion between = nlerp(0.25f, keyRotation(3), keyRotation(4));
+		ensureQuatEquals("between keys", curve.getValue(3.25f, (F32) NUM_KEYS), between);
+	}
+
+	template<> template<>
+	void llkeyframemotion_object::test<2>()
+	{
+		// keys arriving out of order end up sorted, and equal times replace
+		LLKeyframeMotion::RotationCurve curve;
+		const S32 order[] = { 3, 0, 7, 1, 6, 2, 5, 4 };
+		for (S32 i = 0; i < (S32) LL_ARRAY_SIZE(order); i++)
+		{
+			curve.addKey(LLKeyframeMotion::RotationKey((F32) order[i], keyRotation(order[i])));
+		}
+		curve.addKey(LLKeyframeMotion::RotationKey(5.f, keyRotation(9)));
+		ensure_equals("key count", curve.mNumKeys, (S32) LL_ARRAY_SIZE(order));
+		ensure_equals("rotation count", curve.mKeyRotations.size(), LL_ARRAY_SIZE(order));
+		for (S32 k = 0; k < curve.mNumKeys; k++)
+		{
+			ensure_equals("key time", curve.mKeyTimes[k], (F32) k);
+			ensureQuatEquals("key rotation", curve.mKeyRotations[k], keyRotation(k == 5 ? 9 : k));
+		}
+	}
+
+	template<> template<>
+	void llkeyframemotion_object::test<3>()
+	{
+		// a cursor carried between samples gives the same values as a fresh
+		// search, whichever way playback moves
+		LLKeyframeMotion::RotationCurve curve;
+		for (S32 k = 0; k < NUM_KEYS; k++)
+		{
+			curve.addKey(LLKeyframeMotion::RotationKey((F32) k, keyRotation(k)));
+		}
+		S32 cursor = 0;
+		const F32 times[] = { -1.f, 0.f, 0.5f, 1.f, 1.7f, 2.2f, 9.5f, 3.f, 15.f, 20.f, 0.25f };
+		for (S32 i = 0; i < (S32) LL_ARRAY_SIZE(times); i++)
+		{
+			ensureQuatEquals("sample", curve.getValue(times[i], (F32) NUM_KEYS, cursor),
+							 curve.getValue(times[i], (F32) NUM_KEYS));
+		}
+		ensureQuatEquals("before first key", curve.getValue(-1.f, (F32) NUM_KEYS), keyRotation(0));
+		ensureQuatEquals("past last key", curve.getValue(20.f, (F32) NUM_KEYS), keyRotation(NUM_KEYS - 1));
+	}
+}
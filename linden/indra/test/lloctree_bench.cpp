@@ -0,0 +1,133 @@
+/** 
+ * @file lloctree_bench.cpp
+ * @brief Cull and segment query timings for LLOctreeLinear against the pointer octree
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "llbenchmark.h"
+
+#include "lltimer.h"
+#include "lloctreetest.h"
+
+using namespace lloctreetest;
+
+namespace
+{
+	const U32 BENCH_ELEMENTS = 100000;
+	const U32 BENCH_PASSES = 200;
+
+	// Both sides cull with the same tight bounds, the same filter and the
+	// same per element test; only the layout being walked differs.
+	class OctreeCullBenchmark : public LLBenchmark
+	{
+	public:
+		OctreeCullBenchmark() : LLBenchmark("octree cull") { }
+
+		virtual void run()
+		{
+			OctreeScene scene;
+			scene.populate(BENCH_ELEMENTS);
+
+			F64 pointer_time = 0.0;
+			F64 linear_time = 0.0;
+			LLTimer timer;
+			element_vec pointer_results;
+			element_vec linear_results;
+
+			for (U32 pass = 0; pass < BENCH_PASSES; pass++)
+			{
+				LLVector3 min(scene.frand(192.f), scene.frand(192.f), scene.frand(192.f));
+				LLVector3 max = min + LLVector3(64.f, 64.f, 64.f);
+				BoxFilter filter(min, max);
+
+				pointer_results.clear();
+				timer.reset();
+				BoxCollector pointer_collect(min, max, pointer_results);
+				PointerCull<BoxFilter> pointer_cull(&pointer_collect, filter);
+				pointer_cull.traverse(&scene.mRoot);
+				pointer_time += timer.getElapsedTimeF64();
+
+				linear_results.clear();
+				timer.reset();
+				BoxCollector linear_collect(min, max, linear_results);
+				scene.mLinear.traverse(&linear_collect, filter);
+				linear_time += timer.getElapsedTimeF64();
+
+				check(linear_results == pointer_results, "linear cull differs from pointer cull");
+			}
+
+			report("pointer", pointer_time, BENCH_PASSES);
+			report("linear", linear_time, BENCH_PASSES);
+		}
+	};
+
+	class OctreeSegmentBenchmark : public LLBenchmark
+	{
+	public:
+		OctreeSegmentBenchmark() : LLBenchmark("octree lineSegmentIntersect") { }
+
+		virtual void run()
+		{
+			OctreeScene scene;
+			scene.populate(BENCH_ELEMENTS);
+
+			F64 pointer_time = 0.0;
+			F64 linear_time = 0.0;
+			LLTimer timer;
+			element_vec pointer_results;
+			test_linear::element_list linear_results;
+
+			for (U32 pass = 0; pass < BENCH_PASSES; pass++)
+			{
+				LLVector3 start(scene.frand(256.f), scene.frand(256.f), scene.frand(256.f));
+				LLVector3 end(scene.frand(256.f), scene.frand(256.f), scene.frand(256.f));
+
+				pointer_results.clear();
+				timer.reset();
+				PointerSegment pointer_ray(start, end, pointer_results);
+				pointer_ray.traverse(&scene.mRoot);
+				pointer_time += timer.getElapsedTimeF64();
+
+				linear_results.clear();
+				timer.reset();
+				scene.mLinear.lineSegmentIntersect(start, end, linear_results);
+				linear_time += timer.getElapsedTimeF64();
+
+				check(linear_results.size() == pointer_results.size(), "linear segment query differs from pointer query");
+			}
+
+			report("pointer", pointer_time, BENCH_PASSES);
+			report("linear", linear_time, BENCH_PASSES);
+		}
+	};
+
+	OctreeCullBenchmark sOctreeCullBenchmark;
+	OctreeSegmentBenchmark sOctreeSegmentBenchmark;
+}
@@ -0,0 +1,219 @@
+/**
+ * @file lloctree_tut.cpp
+ * @brief LLOctreeNode and LLOctreeLinear test cases.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ *
+ * Copyright (c) 2009, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include <tut/tut.hpp>
+#include "linden_common.h"
+#include "lltut.h"
+
+#include <algorithm>
+#include "lloctreetest.h"
+
+using namespace lloctreetest;
+
+namespace
+{
+	class NodeCounter : public LLOctreeTraveler<OctreeElement>
+	{
+	public:
+		NodeCounter() : mNodes(0), mElements(0) { }
+
+		virtual void visit(const test_node* branch)
+		{
+			mNodes++;
+			mElements += branch->getElementCount();
+		}
+
+		U32 mNodes;
+		U32 mElements;
+	};
+
+	// no culling at all: every element of every node
+	class AllElements : public LLOctreeTraveler<OctreeElement>
+	{
+	public:
+		AllElements(element_vec& results) : mResults(results) { }
+
+		virtual void visit(const test_node* branch)
+		{
+			for (test_node::const_element_iter i = branch->getData().begin(); i != branch->getData().end(); ++i)
+			{
+				mResults.push_back(*i);
+			}
+		}
+
+		element_vec& mResults;
+	};
+}
+
+namespace tut
+{
+	struct lloctree_data : public OctreeScene
+	{
+		// the reference answer: test every element, no tree pruning
+		void bruteForceBox(const LLVector3& min, const LLVector3& max, element_vec& results)
+		{
+			element_vec all;
+			AllElements collect(all);
+			collect.traverse(&mRoot);
+			for (U32 i = 0; i < all.size(); i++)
+			{
+				if (all[i]->overlaps(min, max))
+				{
+					results.push_back(all[i]);
+				}
+			}
+			std::sort(results.begin(), results.end());
+		}
+
+		void bruteForceSegment(const LLVector3& start, const LLVector3& end, element_vec& results)
+		{
+			element_vec all;
+			AllElements collect(all);
+			collect.traverse(&mRoot);
+			for (U32 i = 0; i < all.size(); i++)
+			{
+				if (all[i]->intersects(start, end))
+				{
+					results.push_back(all[i]);
+				}
+			}
+			std::sort(results.begin(), results.end());
+		}
+	};
+	typedef test_group<lloctree_data> lloctree_test;
+	typedef lloctree_test::object lloctree_object;
+	tut::lloctree_test lloctree_testcase("lloctree");
+
+	const U32 TEST_ELEMENTS = 5000;
+	const U32 TEST_QUERIES = 50;
+
+	template<> template<>
+	void lloctree_object::test<1>()
+	{
+		populate(1000);
+
+		NodeCounter counter;
+		counter.traverse(&mRoot);
+
+		ensure_equals("linear node count", mLinear.getNodeCount(), counter.mNodes);
+		ensure_equals("linear element count", mLinear.getElementCount(), counter.mElements);
+		ensure_equals("every element stored once", mLinear.getElementCount(), (U32) mElements.size());
+
+		NodeCounter linear_counter;
+		mLinear.traverse(&linear_counter);
+		ensure_equals("traveler sees every node", linear_counter.mNodes, counter.mNodes);
+
+		for (U32 i = 0; i < mLinear.getNodeCount(); i++)
+		{
+			const test_linear::Node& node = mLinear.getNode(i);
+			for (U32 c = 0; c < node.mChildCount; c++)
+			{
+				const test_linear::Node& child = mLinear.getNode(node.mFirstChild + c);
+				ensure("child follows parent", node.mFirstChild + c > i);
+				ensure("child source matches", child.mSource == node.mSource->getChild(c));
+				for (U32 j = 0; j < 3; j++)
+				{
+					ensure("child bounds inside parent",
+						child.mCenter.mV[j] - child.mSize.mV[j] >= node.mCenter.mV[j] - node.mSize.mV[j] - F_APPROXIMATELY_ZERO &&
+						child.mCenter.mV[j] + child.mSize.mV[j] <= node.mCenter.mV[j] + node.mSize.mV[j] + F_APPROXIMATELY_ZERO);
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void lloctree_object::test<2>()
+	{
+		// the filtered linear cull, the pointer cull over the same
+		// bounds, and testing every element all agree
+		populate(TEST_ELEMENTS);
+
+		for (U32 pass = 0; pass < TEST_QUERIES; pass++)
+		{
+			LLVector3 min(frand(224.f), frand(224.f), frand(224.f));
+			LLVector3 max = min + LLVector3(frand(64.f), frand(64.f), frand(64.f));
+			BoxFilter filter(min, max);
+
+			element_vec pointer_results;
+			BoxCollector pointer_collect(min, max, pointer_results);
+			PointerCull<BoxFilter> pointer_cull(&pointer_collect, filter);
+			pointer_cull.traverse(&mRoot);
+
+			element_vec linear_results;
+			BoxCollector linear_collect(min, max, linear_results);
+			mLinear.traverse(&linear_collect, filter);
+
+			ensure("linear cull visits in pointer cull order", linear_results == pointer_results);
+
+			element_vec expected;
+			bruteForceBox(min, max, expected);
+			std::sort(linear_results.begin(), linear_results.end());
+			ensure("linear cull finds every overlapping element", linear_results == expected);
+		}
+	}
+
+	template<> template<>
+	void lloctree_object::test<3>()
+	{
+		populate(TEST_ELEMENTS);
+
+		element_vec candidates;
+		for (U32 pass = 0; pass < TEST_QUERIES; pass++)
+		{
+			LLVector3 start(frand(256.f), frand(256.f), frand(256.f));
+			LLVector3 end(frand(256.f), frand(256.f), frand(256.f));
+
+			element_vec pointer_candidates;
+			PointerSegment pointer_ray(start, end, pointer_candidates);
+			pointer_ray.traverse(&mRoot);
+
+			test_linear::element_list linear_candidates;
+			mLinear.lineSegmentIntersect(start, end, linear_candidates);
+
+			ensure_equals("same candidate count", linear_candidates.size(), pointer_candidates.size());
+			element_vec linear_results;
+			for (U32 i = 0; i < linear_candidates.size(); i++)
+			{
+				ensure("same candidate order", linear_candidates[i] == pointer_candidates[i]);
+				if (linear_candidates[i]->intersects(start, end))
+				{
+					linear_results.push_back(linear_candidates[i]);
+				}
+			}
+
+			element_vec expected;
+			bruteForceSegment(start, end, expected);
+			std::sort(linear_results.begin(), linear_results.end());
+			ensure("linear raycast finds every intersected element", linear_results == expected);
+		}
+	}
+}
@@ -0,0 +1,277 @@
+/** 
+ * @file lloctreetest.h
+ * @brief Octree fixtures shared by the octree tests and benchmarks
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLOCTREETEST_H
+#define LL_LLOCTREETEST_H
+
+#include <boost/random/lagged_fibonacci.hpp>
+#include "llmemory.h"
+#include "v3dmath.h"
+#include "lloctree.h"
+#include "lloctreelinear.h"
+
+// Elements, queries and cull travelers used to check LLOctreeLinear
+// against the pointer tree it was built from.  Both sides cull with the
+// same tight bounds and the same filter, so the only difference between
+// them is the memory layout being walked.
+
+namespace lloctreetest
+{
+	class OctreeElement : public LLRefCount
+	{
+	public:
+		OctreeElement(const LLVector3d& pos, F64 radius)
+			: mPosition(pos), mRadius(radius) { }
+
+		const LLVector3d& getPositionGroup() const	{ return mPosition; }
+		F64 getBinRadius() const					{ return mRadius; }
+
+		bool overlaps(const LLVector3& min, const LLVector3& max) const
+		{
+			LLVector3 pos(mPosition);
+			F32 rad = (F32) mRadius;
+			for (U32 i = 0; i < 3; i++)
+			{
+				if (pos.mV[i] + rad < min.mV[i] ||
+					pos.mV[i] - rad > max.mV[i])
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool intersects(const LLVector3& start, const LLVector3& end) const
+		{
+			F32 rad = (F32) mRadius;
+			return LLOctreeLinear<OctreeElement>::segmentIntersectsBox(start, end, LLVector3(mPosition), LLVector3(rad, rad, rad));
+		}
+
+		LLVector3d mPosition;
+		F64 mRadius;
+	};
+
+	typedef LLOctreeNode<OctreeElement> test_node;
+	typedef LLOctreeRoot<OctreeElement> test_root;
+	typedef LLOctreeLinear<OctreeElement> test_linear;
+	typedef std::vector<const OctreeElement*> element_vec;
+
+	// AABB filter in the LLCamera::AABBInFrustum convention
+	struct BoxFilter
+	{
+		BoxFilter(const LLVector3& min, const LLVector3& max) : mMin(min), mMax(max) { }
+
+		S32 operator()(const LLVector3& center, const LLVector3& size)
+		{
+			S32 res = 2;
+			for (U32 i = 0; i < 3; i++)
+			{
+				F32 lo = center.mV[i] - size.mV[i];
+				F32 hi = center.mV[i] + size.mV[i];
+				if (hi < mMin.mV[i] || lo > mMax.mV[i])
+				{
+					return 0;
+				}
+				if (lo < mMin.mV[i] || hi > mMax.mV[i])
+				{
+					res = 1;
+				}
+			}
+			return res;
+		}
+
+		LLVector3 mMin;
+		LLVector3 mMax;
+	};
+
+	// Per node tight bounds hung off the pointer tree, the way
+	// LLSpatialGroup keeps mBounds for LLOctreeCull.
+	class BoundsListener : public LLOctreeListener<OctreeElement>
+	{
+	public:
+		BoundsListener(const LLVector3& center, const LLVector3& size)
+			: mCenter(center), mSize(size) { }
+
+		virtual void handleInsertion(const LLTreeNode<OctreeElement>* node, OctreeElement* data) { }
+		virtual void handleRemoval(const LLTreeNode<OctreeElement>* node, OctreeElement* data) { }
+		virtual void handleDestruction(const LLTreeNode<OctreeElement>* node) { }
+		virtual void handleStateChange(const LLTreeNode<OctreeElement>* node) { }
+		virtual void handleChildAddition(const test_node* parent, test_node* child) { }
+		virtual void handleChildRemoval(const test_node* parent, const test_node* child) { }
+
+		LLVector3 mCenter;
+		LLVector3 mSize;
+	};
+
+	// Collects the elements of every visited node that overlap a box.
+	class BoxCollector : public LLOctreeTraveler<OctreeElement>
+	{
+	public:
+		BoxCollector(const LLVector3& min, const LLVector3& max, element_vec& results)
+			: mMin(min), mMax(max), mResults(results) { }
+
+		virtual void visit(const test_node* branch)
+		{
+			for (test_node::const_element_iter i = branch->getData().begin(); i != branch->getData().end(); ++i)
+			{
+				if ((*i)->overlaps(mMin, mMax))
+				{
+					mResults.push_back(*i);
+				}
+			}
+		}
+
+		LLVector3 mMin;
+		LLVector3 mMax;
+		element_vec& mResults;
+	};
+
+	// Filtered depth first cull of the pointer tree using the bounds in
+	// each node's BoundsListener, visiting nodes in the same order as
+	// LLOctreeLinear::traverse(traveler, filter).
+	template <class Filter>
+	class PointerCull : public LLOctreeTraveler<OctreeElement>
+	{
+	public:
+		PointerCull(LLOctreeTraveler<OctreeElement>* visitor, Filter& filter)
+			: mVisitor(visitor), mFilter(filter) { }
+
+		virtual void traverse(const LLTreeNode<OctreeElement>* node)
+		{
+			cull((const test_node*) node, false);
+		}
+
+		virtual void visit(const test_node* branch)
+		{
+			branch->accept(mVisitor);
+		}
+
+		void cull(const test_node* node, bool inside)
+		{
+			if (!inside)
+			{
+				const BoundsListener* bounds = (const BoundsListener*) node->getListener(0);
+				S32 res = mFilter(bounds->mCenter, bounds->mSize);
+				if (res == 0)
+				{
+					return;
+				}
+				inside = (res == 2);
+			}
+
+			visit(node);
+			for (U32 i = 0; i < node->getChildCount(); i++)
+			{
+				cull(node->getChild(i), inside);
+			}
+		}
+
+		LLOctreeTraveler<OctreeElement>* mVisitor;
+		Filter& mFilter;
+	};
+
+	// Segment query over the pointer tree with the same bounds test as
+	// LLOctreeLinear::lineSegmentIntersect().
+	class PointerSegment
+	{
+	public:
+		PointerSegment(const LLVector3& start, const LLVector3& end, element_vec& results)
+			: mStart(start), mEnd(end), mResults(results) { }
+
+		void traverse(const test_node* node)
+		{
+			const BoundsListener* bounds = (const BoundsListener*) node->getListener(0);
+			if (!test_linear::segmentIntersectsBox(mStart, mEnd, bounds->mCenter, bounds->mSize))
+			{
+				return;
+			}
+
+			for (test_node::const_element_iter i = node->getData().begin(); i != node->getData().end(); ++i)
+			{
+				mResults.push_back(*i);
+			}
+			for (U32 i = 0; i < node->getChildCount(); i++)
+			{
+				traverse(node->getChild(i));
+			}
+		}
+
+		LLVector3 mStart;
+		LLVector3 mEnd;
+		element_vec& mResults;
+	};
+
+	// A populated pointer tree, its linear snapshot, and the same tight
+	// bounds attached to every pointer node.  Elements come from a fixed
+	// seed so every run builds the same tree.
+	class OctreeScene
+	{
+	public:
+		OctreeScene(U32 seed = 1)
+			: mRoot(LLVector3d(128.0, 128.0, 128.0), LLVector3d(128.0, 128.0, 128.0), NULL),
+			  mRandom(seed)
+		{
+		}
+
+		F32 frand(F32 val)
+		{
+			return (F32) (mRandom() * val);
+		}
+
+		void populate(U32 count)
+		{
+			mElements.reserve(count);
+			for (U32 i = 0; i < count; i++)
+			{
+				LLVector3d pos(frand(256.f), frand(256.f), frand(256.f));
+				F64 radius = 0.25 + frand(4.f);
+				LLPointer<OctreeElement> element = new OctreeElement(pos, radius);
+				mElements.push_back(element);
+				mRoot.insert(element);
+			}
+			mLinear.rebuild(&mRoot);
+
+			for (U32 i = 0; i < mLinear.getNodeCount(); i++)
+			{
+				const test_linear::Node& node = mLinear.getNode(i);
+				((test_node*) node.mSource)->addListener(new BoundsListener(node.mCenter, node.mSize));
+			}
+		}
+
+		test_root mRoot;
+		test_linear mLinear;
+		std::vector<LLPointer<OctreeElement> > mElements;
+		boost::lagged_fibonacci607 mRandom;
+	};
+}
+
+#endif
@@ -0,0 +1,130 @@
+/** 
+ * @file llradixsort_tut.cpp
+ * @brief ll_radix_sort test cases.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include <tut/tut.hpp>
+#include "linden_common.h"
+#include "lltut.h"
+
+#include "llradixsort.h"
+#include "llrand.h"
+
+namespace
+{
+	typedef std::pair<U64, U32> sort_item;
+	typedef std::vector<sort_item> sort_list;
+
+	struct CompareKey
+	{
+		bool operator()(const sort_item& lhs, const sort_item& rhs) const
+		{
+			return lhs.first < rhs.first;
+		}
+	};
+
+	U64 random_key()
+	{
+		return ((U64) ll_rand() << 48) ^ ((U64) ll_rand() << 32) ^ ((U64) ll_rand() << 16) ^ (U64) ll_rand();
+	}
+}
+
+namespace tut
+{
+	struct llradixsort_data
+	{
+		sort_list mItems;
+		sort_list mScratch;
+	};
+	typedef test_group<llradixsort_data> llradixsort_test;
+	typedef llradixsort_test::object llradixsort_object;
+	tut::llradixsort_test llradixsort_testcase("llradixsort");
+
+	template<> template<>
+	void llradixsort_object::test<1>()
+	{
+		// degenerate sizes
+		ll_radix_sort(mItems, mScratch);
+		ensure("empty list stays empty", mItems.empty());
+
+		mItems.push_back(sort_item(42, 0));
+		ll_radix_sort(mItems, mScratch);
+		ensure_equals("single item untouched", mItems[0].first, (U64) 42);
+	}
+
+	template<> template<>
+	void llradixsort_object::test<2>()
+	{
+		// full 64-bit keys match a stable comparison sort
+		for (U32 i = 0; i < 5000; i++)
+		{
+			mItems.push_back(sort_item(random_key(), i));
+		}
+		sort_list expected = mItems;
+		std::stable_sort(expected.begin(), expected.end(), CompareKey());
+
+		ll_radix_sort(mItems, mScratch);
+		ensure("matches std::stable_sort", mItems == expected);
+	}
+
+	template<> template<>
+	void llradixsort_object::test<3>()
+	{
+		// few distinct keys spread over high and low bytes: equal keys
+		// keep insertion order, and the odd number of active passes
+		// exercises the copy back from scratch
+		for (U32 i = 0; i < 2000; i++)
+		{
+			U64 key = ((U64) ll_rand(4) << 56) | (U64) ll_rand(3);
+			mItems.push_back(sort_item(key, i));
+		}
+		sort_list expected = mItems;
+		std::stable_sort(expected.begin(), expected.end(), CompareKey());
+
+		ll_radix_sort(mItems, mScratch);
+		ensure("sparse keys stable", mItems == expected);
+	}
+
+	template<> template<>
+	void llradixsort_object::test<4>()
+	{
+		// draw info style key: a handful of passes and textures
+		for (U32 i = 0; i < 20000; i++)
+		{
+			U64 key = ((U64) ll_rand(8) << 58) | ((U64) ll_rand(512) << 26) | (U64) ll_rand(4096);
+			mItems.push_back(sort_item(key, i));
+		}
+		sort_list expected = mItems;
+		std::stable_sort(expected.begin(), expected.end(), CompareKey());
+
+		ll_radix_sort(mItems, mScratch);
+		ensure("draw info keys stable", mItems == expected);
+	}
+}
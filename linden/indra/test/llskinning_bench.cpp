@@ -0,0 +1,244 @@
+/** 
+ * @file llskinning_bench.cpp
+ * @brief Avatar skinning timings on LLThreadPool workers against the render thread
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "llbenchmark.h"
+
+#include <sstream>
+#include "llrand.h"
+#include "llthreadpool.h"
+#include "lltimer.h"
+#include "llv4skin.h"
+
+// N avatars skinned the way LLViewerJointMesh does it: one job per mesh on
+// the geometry threads, each avatar waiting only for its own jobs before it
+// would unmap its buffer.  The baseline skins every mesh on the calling
+// thread.  Both run the same weight run kernel over the same meshes, and a
+// batch of unrelated jobs sits in the pool the whole time, standing in for
+// volume geometry, which the avatars must not wait for.
+
+namespace
+{
+	// roughly the vertex counts of the upper body, lower body, head,
+	// hair, eyes and skirt meshes at the highest LOD
+	const U32 MESH_VERTICES[] = { 2800, 1600, 1200, 600, 300, 500 };
+	const U32 NUM_MESHES = LL_ARRAY_SIZE(MESH_VERTICES);
+	const S32 NUM_JOINTS = 16;
+	const U32 BENCH_FRAMES = 20;
+	const U32 NUM_THREADS = 2;
+
+	struct SkinMesh
+	{
+		SkinMesh(U32 count)
+			: mCoords(count), mNormals(count), mVertices(count), mOutNormals(count)
+		{
+			std::vector<F32> weights(count);
+			for (U32 i = 0; i < count; i++)
+			{
+				// a few hundred distinct weights per mesh, as the avatar meshes have
+				weights[i] = (F32) ll_rand(NUM_JOINTS - 1) + (F32) ll_rand(16) / 16.f;
+				mCoords[i].setVec(ll_frand(2.f) - 1.f, ll_frand(2.f) - 1.f, ll_frand(2.f));
+				mNormals[i].setVec(ll_frand(2.f) - 1.f, ll_frand(2.f) - 1.f, ll_frand(2.f) - 1.f);
+				mNormals[i].normVec();
+			}
+			llv4skin_build_runs(&weights[0], count, mOrder, mRuns);
+		}
+
+		void skin(const LLV4Matrix4* joints)
+		{
+			LLStrider<LLVector3> o_vertices;
+			LLStrider<LLVector3> o_normals;
+			o_vertices = &mVertices[0];
+			o_normals = &mOutNormals[0];
+			llv4skin_runs(joints, &mRuns[0], mRuns.size(), &mOrder[0],
+						  &mCoords[0], &mNormals[0], o_vertices, o_normals);
+		}
+
+		std::vector<LLVector3> mCoords;
+		std::vector<LLVector3> mNormals;
+		std::vector<U32> mOrder;
+		std::vector<LLV4SkinRun> mRuns;
+		std::vector<LLVector3> mVertices;
+		std::vector<LLVector3> mOutNormals;
+	};
+
+	struct SkinAvatar
+	{
+		SkinAvatar()
+		{
+			for (S32 j = 0; j < NUM_JOINTS; j++)
+			{
+				LLMatrix4 mat;
+				mat.setTranslation(LLVector3(ll_frand(), ll_frand(), ll_frand()));
+				mJoints[j] = mat;
+			}
+			for (U32 m = 0; m < NUM_MESHES; m++)
+			{
+				mMeshes.push_back(new SkinMesh(MESH_VERTICES[m]));
+			}
+		}
+
+		~SkinAvatar()
+		{
+			for (U32 m = 0; m < mMeshes.size(); m++)
+			{
+				delete mMeshes[m];
+			}
+		}
+
+		LLV4Matrix4 mJoints[NUM_JOINTS];
+		std::vector<SkinMesh*> mMeshes;
+	};
+
+	class SkinJob : public LLThreadPool::Job
+	{
+	public:
+		SkinJob() : mMesh(NULL), mJoints(NULL) { }
+		SkinJob(SkinMesh* mesh, const LLV4Matrix4* joints) : mMesh(mesh), mJoints(joints) { }
+
+		/*virtual*/ void run()
+		{
+			mMesh->skin(mJoints);
+		}
+
+		SkinMesh* mMesh;
+		const LLV4Matrix4* mJoints;
+	};
+
+	// stands in for queued volume geometry nobody in this benchmark waits on
+	class BusyJob : public LLThreadPool::Job
+	{
+	public:
+		BusyJob() : mSum(0.f) { }
+
+		/*virtual*/ void run()
+		{
+			for (U32 i = 0; i < 200000; i++)
+			{
+				mSum += (F32) i * 0.5f;
+			}
+		}
+
+		volatile F32 mSum;
+	};
+
+	class SkinningBenchmark : public LLBenchmark
+	{
+	public:
+		SkinningBenchmark() : LLBenchmark("avatar skinning") { }
+
+		virtual void run()
+		{
+			const U32 counts[] = { 10, 25, 50 };
+			for (U32 c = 0; c < LL_ARRAY_SIZE(counts); c++)
+			{
+				runAvatars(counts[c]);
+			}
+		}
+
+		void runAvatars(U32 num_avatars)
+		{
+			std::vector<SkinAvatar*> avatars;
+			for (U32 a = 0; a < num_avatars; a++)
+			{
+				avatars.push_back(new SkinAvatar);
+			}
+
+			LLThreadPool pool("skinning benchmark", NUM_THREADS);
+			std::vector<SkinJob> jobs(num_avatars * NUM_MESHES);
+			std::vector<BusyJob> busy(NUM_THREADS * 4);
+			std::vector<LLVector3> serial_result;
+
+			F64 serial_time = 0.0;
+			F64 threaded_time = 0.0;
+			LLTimer timer;
+
+			for (U32 frame = 0; frame < BENCH_FRAMES; frame++)
+			{
+				timer.reset();
+				for (U32 a = 0; a < num_avatars; a++)
+				{
+					for (U32 m = 0; m < NUM_MESHES; m++)
+					{
+						avatars[a]->mMeshes[m]->skin(avatars[a]->mJoints);
+					}
+				}
+				serial_time += timer.getElapsedTimeF64();
+				serial_result = avatars[num_avatars - 1]->mMeshes[0]->mVertices;
+
+				for (U32 b = 0; b < busy.size(); b++)
+				{
+					pool.addJob(&busy[b]);
+				}
+
+				// queue everything, then wait per avatar as renderSkinned() does
+				timer.reset();
+				for (U32 a = 0; a < num_avatars; a++)
+				{
+					for (U32 m = 0; m < NUM_MESHES; m++)
+					{
+						SkinJob& job = jobs[a * NUM_MESHES + m];
+						job = SkinJob(avatars[a]->mMeshes[m], avatars[a]->mJoints);
+						pool.addJob(&job);
+					}
+				}
+				for (U32 a = 0; a < num_avatars; a++)
+				{
+					for (U32 m = 0; m < NUM_MESHES; m++)
+					{
+						pool.waitForJob(&jobs[a * NUM_MESHES + m]);
+					}
+				}
+				threaded_time += timer.getElapsedTimeF64();
+
+				check(serial_result == avatars[num_avatars - 1]->mMeshes[0]->mVertices,
+					  "threaded skinning differs from serial skinning");
+				pool.waitForJobs();
+			}
+
+			std::ostringstream label;
+			label << num_avatars << " avatars, ";
+			report(label.str() + "render thread", serial_time, BENCH_FRAMES);
+			std::ostringstream threaded;
+			threaded << NUM_THREADS << " geometry threads";
+			report(label.str() + threaded.str(), threaded_time, BENCH_FRAMES);
+
+			pool.shutdown();
+			for (U32 a = 0; a < num_avatars; a++)
+			{
+				delete avatars[a];
+			}
+		}
+	};
+
+	SkinningBenchmark sSkinningBenchmark;
+}
@@ -0,0 +1,243 @@
+/** 
+ * @file llthreadpool_tut.cpp
+ * @brief LLThreadPool test cases.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include <tut/tut.hpp>
+#include "linden_common.h"
+#include "lltut.h"
+
+#include <vector>
+#include "llthreadpool.h"
+#include "lltimer.h"
+
+namespace
+{
+	// Stands in for a pooled static vertex buffer: workers write into the
+	// client copy, which is uploaded and freed when the buffer is unmapped.
+	struct ArenaBuffer
+	{
+		ArenaBuffer(U32 size) : mSize(size)
+		{
+			mClientData = new U8[size];
+			memset(mClientData, 0, size);
+		}
+		~ArenaBuffer()
+		{
+			delete [] mClientData;
+		}
+
+		void unmap()
+		{
+			mUploaded.assign(mClientData, mClientData + mSize);
+			delete [] mClientData;
+			mClientData = NULL;
+		}
+
+		U8* mClientData;
+		U32 mSize;
+		std::vector<U8> mUploaded;
+	};
+
+	class FillJob : public LLThreadPool::Job
+	{
+	public:
+		FillJob() : mDest(NULL), mCount(0), mValue(0), mDone(0) { }
+		FillJob(U8* dest, U32 count, U8 value)
+			: mDest(dest), mCount(count), mValue(value), mDone(0) { }
+
+		/*virtual*/ void run()
+		{
+			for (U32 i = 0; i < mCount; i++)
+			{
+				mDest[i] = mValue;
+			}
+			mDone = 1;
+		}
+
+		U8* mDest;
+		U32 mCount;
+		U8 mValue;
+		volatile S32 mDone;
+	};
+}
+
+namespace tut
+{
+	struct llthreadpool_data
+	{
+		enum { NUM_JOBS = 64, JOB_BYTES = 4096 };
+
+		// queues one job per slice of buffer, the way flushVolumeGeometry()
+		// hands out face batches
+		void queueFill(LLThreadPool& pool, ArenaBuffer& buffer, std::vector<FillJob>& jobs)
+		{
+			jobs.resize(NUM_JOBS);
+			for (U32 i = 0; i < NUM_JOBS; i++)
+			{
+				jobs[i] = FillJob(buffer.mClientData + i * JOB_BYTES, JOB_BYTES, (U8) (i + 1));
+			}
+			for (U32 i = 0; i < NUM_JOBS; i++)
+			{
+				pool.addJob(&jobs[i]);
+			}
+		}
+
+		void ensureFilled(const std::vector<U8>& data)
+		{
+			for (U32 i = 0; i < NUM_JOBS; i++)
+			{
+				for (U32 j = 0; j < JOB_BYTES; j++)
+				{
+					if (data[i * JOB_BYTES + j] != (U8) (i + 1))
+					{
+						fail("slice not written before the buffer was unmapped");
+					}
+				}
+			}
+		}
+	};
+	typedef test_group<llthreadpool_data> llthreadpool_test;
+	typedef llthreadpool_test::object llthreadpool_object;
+	tut::llthreadpool_test llthreadpool_testcase("threadpool");
+
+	template<> template<>
+	void llthreadpool_object::test<1>()
+	{
+		// threaded writers into an arena buffer: once waitForJobs() returns
+		// every slice has been written, so unmapping then uploads it all
+		LLThreadPool pool("threadpool test", 2);
+		ArenaBuffer buffer(NUM_JOBS * JOB_BYTES);
+		std::vector<FillJob> jobs;
+		queueFill(pool, buffer, jobs);
+		pool.waitForJobs();
+		ensure_equals("nothing pending", pool.getPending(), 0);
+		buffer.unmap();
+		ensureFilled(buffer.mUploaded);
+		pool.shutdown();
+	}
+
+	template<> template<>
+	void llthreadpool_object::test<2>()
+	{
+		// unthreaded pools run their jobs inside waitForJobs()
+		LLThreadPool pool("threadpool test", 2, false);
+		ArenaBuffer buffer(NUM_JOBS * JOB_BYTES);
+		std::vector<FillJob> jobs;
+		queueFill(pool, buffer, jobs);
+		ensure_equals("not run by addJob", (S32) jobs[0].mDone, 0);
+		pool.waitForJobs();
+		buffer.unmap();
+		ensureFilled(buffer.mUploaded);
+		pool.shutdown();
+	}
+
+	template<> template<>
+	void llthreadpool_object::test<3>()
+	{
+		// reapJobs() only reports zero once every job has run
+		LLThreadPool pool("threadpool test", 2);
+		ArenaBuffer buffer(NUM_JOBS * JOB_BYTES);
+		std::vector<FillJob> jobs;
+		queueFill(pool, buffer, jobs);
+		while (pool.reapJobs() > 0)
+		{
+			ms_sleep(1);
+		}
+		for (U32 i = 0; i < NUM_JOBS; i++)
+		{
+			ensure_equals("job ran", (S32) jobs[i].mDone, 1);
+		}
+		buffer.unmap();
+		ensureFilled(buffer.mUploaded);
+		pool.shutdown();
+	}
+
+	template<> template<>
+	void llthreadpool_object::test<4>()
+	{
+		// waitForJob() lets one client finish its own jobs and unmap its
+		// buffer while another client's jobs are still queued
+		LLThreadPool pool("threadpool test", 2);
+		ArenaBuffer mine(NUM_JOBS * JOB_BYTES);
+		ArenaBuffer theirs(NUM_JOBS * JOB_BYTES);
+		std::vector<FillJob> my_jobs;
+		std::vector<FillJob> their_jobs;
+		queueFill(pool, mine, my_jobs);
+		queueFill(pool, theirs, their_jobs);
+
+		for (U32 i = 0; i < NUM_JOBS; i++)
+		{
+			pool.waitForJob(&my_jobs[i]);
+			ensure_equals("job ran", (S32) my_jobs[i].mDone, 1);
+		}
+		ensure_equals("other jobs still tracked", pool.getPending(), (S32) NUM_JOBS);
+		mine.unmap();
+		ensureFilled(mine.mUploaded);
+
+		pool.waitForJobs();
+		ensure_equals("nothing pending", pool.getPending(), 0);
+		theirs.unmap();
+		ensureFilled(theirs.mUploaded);
+		pool.shutdown();
+	}
+
+	template<> template<>
+	void llthreadpool_object::test<5>()
+	{
+		// unthreaded, waitForJob() runs just that job
+		LLThreadPool pool("threadpool test", 2, false);
+		ArenaBuffer mine(NUM_JOBS * JOB_BYTES);
+		ArenaBuffer theirs(NUM_JOBS * JOB_BYTES);
+		std::vector<FillJob> my_jobs;
+		std::vector<FillJob> their_jobs;
+		queueFill(pool, mine, my_jobs);
+		queueFill(pool, theirs, their_jobs);
+
+		for (U32 i = 0; i < NUM_JOBS; i++)
+		{
+			pool.waitForJob(&my_jobs[i]);
+		}
+		for (U32 i = 0; i < NUM_JOBS; i++)
+		{
+			ensure_equals("other job not run", (S32) their_jobs[i].mDone, 0);
+		}
+		mine.unmap();
+		ensureFilled(mine.mUploaded);
+
+		// waiting again for a finished job is harmless
+		pool.waitForJob(&my_jobs[0]);
+		pool.waitForJobs();
+		theirs.unmap();
+		ensureFilled(theirs.mUploaded);
+		pool.shutdown();
+	}
+}
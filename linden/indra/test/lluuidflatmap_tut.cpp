@@ -0,0 +1,161 @@
+/** 
+ * @file lluuidflatmap_tut.cpp
+ * @brief LLUUIDFlatMap test cases.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include <tut/tut.hpp>
+#include "linden_common.h"
+#include "lltut.h"
+
+#include <map>
+#include "lluuidflatmap.h"
+
+namespace tut
+{
+	struct lluuidflatmap_data
+	{
+		lluuidflatmap_data()
+		{
+			for (U32 i = 0; i < 2000; i++)
+			{
+				LLUUID id;
+				id.generate();
+				mIDs.push_back(id);
+			}
+		}
+
+		// the flat map holds exactly what the reference map holds
+		void checkSame()
+		{
+			ensure_equals("size", mMap.size(), (U32)mReference.size());
+			U32 count = 0;
+			for (flat_map_t::iterator iter = mMap.begin(); iter != mMap.end(); ++iter)
+			{
+				std::map<LLUUID, U32>::iterator found = mReference.find(iter->first);
+				ensure("iterated key known", found != mReference.end());
+				ensure_equals("iterated value", iter->second, found->second);
+				count++;
+			}
+			ensure_equals("iteration count", count, (U32)mReference.size());
+			for (std::map<LLUUID, U32>::iterator iter = mReference.begin(); iter != mReference.end(); ++iter)
+			{
+				ensure_equals("lookup", mMap.getIfThere(iter->first, 0), iter->second);
+			}
+		}
+
+		typedef LLUUIDFlatMap<U32> flat_map_t;
+		flat_map_t mMap;
+		std::map<LLUUID, U32> mReference;
+		std::vector<LLUUID> mIDs;
+	};
+	typedef test_group<lluuidflatmap_data> lluuidflatmap_test;
+	typedef lluuidflatmap_test::object lluuidflatmap_object;
+	tut::lluuidflatmap_test lluuidflatmap_testcase("lluuidflatmap");
+
+	template<> template<>
+	void lluuidflatmap_object::test<1>()
+	{
+		ensure("new map empty", mMap.empty());
+		ensure("begin is end", mMap.begin() == mMap.end());
+		ensure("find in empty map", mMap.find(mIDs[0]) == mMap.end());
+		ensure_equals("erase from empty map", mMap.erase(mIDs[0]), (U32)0);
+
+		ensure("insert", mMap.insert(mIDs[0], 7));
+		ensure("second insert refused", !mMap.insert(mIDs[0], 8));
+		ensure_equals("first value kept", mMap.getIfThere(mIDs[0], 0), (U32)7);
+		ensure("null id is an ordinary key", mMap.insert(LLUUID::null, 9));
+		ensure_equals("null id value", mMap[LLUUID::null], (U32)9);
+		mMap[mIDs[1]] = 11;
+		ensure_equals("operator[] inserts", mMap.size(), (U32)3);
+		ensure("count", mMap.count(mIDs[1]));
+		ensure("find", mMap.find(mIDs[1])->second == 11);
+
+		mMap.clear();
+		ensure("cleared", mMap.empty());
+		ensure("nothing found after clear", !mMap.count(mIDs[0]));
+	}
+
+	template<> template<>
+	void lluuidflatmap_object::test<2>()
+	{
+		// grow through several rehashes, then erase in a different order
+		// than insertion so backward shifts cross the end of the table
+		for (U32 i = 0; i < mIDs.size(); i++)
+		{
+			mMap[mIDs[i]] = i;
+			mReference[mIDs[i]] = i;
+		}
+		checkSame();
+
+		for (U32 i = 0; i < mIDs.size(); i += 3)
+		{
+			ensure_equals("erase", mMap.erase(mIDs[i]), (U32)1);
+			ensure_equals("second erase", mMap.erase(mIDs[i]), (U32)0);
+			mReference.erase(mIDs[i]);
+		}
+		checkSame();
+
+		for (U32 i = 0; i < mIDs.size(); i += 3)
+		{
+			mMap.insert(mIDs[i], i + 1);
+			mReference[mIDs[i]] = i + 1;
+		}
+		checkSame();
+
+		for (U32 i = mIDs.size(); i > 0; i--)
+		{
+			mMap.erase(mIDs[i - 1]);
+		}
+		ensure("all erased", mMap.empty());
+		ensure("begin is end once emptied", mMap.begin() == mMap.end());
+	}
+
+	template<> template<>
+	void lluuidflatmap_object::test<3>()
+	{
+		// ids that collide in the hash still need their own slots
+		for (U32 i = 0; i < 64; i++)
+		{
+			LLUUID id;
+			id.mData[4] = (U8)i;
+			mMap[id] = i;
+			mReference[id] = i;
+		}
+		checkSame();
+		for (U32 i = 0; i < 64; i += 2)
+		{
+			LLUUID id;
+			id.mData[4] = (U8)i;
+			mMap.erase(id);
+			mReference.erase(id);
+		}
+		checkSame();
+	}
+}
@@ -0,0 +1,157 @@
+/** 
+ * @file llv4skin_tut.cpp
+ * @brief Tests for the weight run skinning kernel.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include <tut/tut.hpp>
+#include "linden_common.h"
+#include "lltut.h"
+
+#include <boost/random/lagged_fibonacci.hpp>
+#include "llv4skin.h"
+#include "m4math.h"
+
+namespace tut
+{
+	struct llv4skin_data
+	{
+		enum { NUM_JOINTS = 8, NUM_VERTICES = 203 };
+
+		LLV4Matrix4 mJoints[NUM_JOINTS];
+		F32 mWeights[NUM_VERTICES];
+		LLVector3 mCoords[NUM_VERTICES];
+		LLVector3 mNormals[NUM_VERTICES];
+
+		// fixed seed, so a failure reproduces
+		llv4skin_data()
+			: mRandom(4321)
+		{
+			for (S32 j = 0; j < NUM_JOINTS; ++j)
+			{
+				LLMatrix4 mat;
+				for (S32 r = 0; r < 4; ++r)
+				{
+					for (S32 c = 0; c < 3; ++c)
+					{
+						mat.mMatrix[r][c] = frand(2.f) - 1.f;
+					}
+				}
+				mJoints[j] = mat;
+			}
+			// a handful of distinct weights scattered through the mesh,
+			// as the avatar meshes have
+			static const F32 weights[] = { 0.f, 1.f, 1.25f, 2.5f, 3.f, 5.75f, 6.f };
+			for (S32 i = 0; i < NUM_VERTICES; ++i)
+			{
+				mWeights[i] = weights[(S32) frand((F32) LL_ARRAY_SIZE(weights))];
+				mCoords[i].setVec(frand(4.f) - 2.f, frand(4.f) - 2.f, frand(4.f) - 2.f);
+				mNormals[i].setVec(frand(2.f) - 1.f, frand(2.f) - 1.f, frand(2.f) - 1.f);
+				mNormals[i].normVec();
+			}
+		}
+
+		F32 frand(F32 val)
+		{
+			return (F32) (mRandom() * val);
+		}
+
+		boost::lagged_fibonacci607 mRandom;
+	};
+	typedef test_group<llv4skin_data> llv4skin_test;
+	typedef llv4skin_test::object llv4skin_object;
+	tut::llv4skin_test llv4skin_testcase("llv4skin");
+
+	template<> template<>
+	void llv4skin_object::test<1>()
+	{
+		std::vector<U32> order;
+		std::vector<LLV4SkinRun> runs;
+		llv4skin_build_runs(mWeights, NUM_VERTICES, order, runs);
+
+		ensure_equals("order covers every vertex", order.size(), (size_t)NUM_VERTICES);
+		U32 next = 0;
+		for (U32 r = 0; r < runs.size(); ++r)
+		{
+			ensure_equals("runs are contiguous", runs[r].mStart, next);
+			ensure("runs are not empty", runs[r].mCount > 0);
+			if (r > 0)
+			{
+				ensure("runs are sorted by weight", runs[r - 1].mWeight < runs[r].mWeight);
+			}
+			for (U32 i = runs[r].mStart; i < runs[r].mStart + runs[r].mCount; ++i)
+			{
+				ensure_equals("vertex belongs to its run", mWeights[order[i]], runs[r].mWeight);
+				if (i > runs[r].mStart)
+				{
+					ensure("run keeps vertex order", order[i - 1] < order[i]);
+				}
+			}
+			next += runs[r].mCount;
+		}
+		ensure_equals("runs cover every vertex", next, (U32)NUM_VERTICES);
+	}
+
+	template<> template<>
+	void llv4skin_object::test<2>()
+	{
+		std::vector<U32> order;
+		std::vector<LLV4SkinRun> runs;
+		llv4skin_build_runs(mWeights, NUM_VERTICES, order, runs);
+
+		LLVector3 vertices[NUM_VERTICES];
+		LLVector3 normals[NUM_VERTICES];
+		LLStrider<LLVector3> o_vertices;
+		LLStrider<LLVector3> o_normals;
+		o_vertices = vertices;
+		o_normals = normals;
+		llv4skin_runs(mJoints, &runs[0], runs.size(), &order[0],
+					  mCoords, mNormals, o_vertices, o_normals);
+
+		// the run kernel does the same multiply-adds in the same order as
+		// the per vertex kernel, so the results must match exactly
+		LLV4Matrix4 blend_mat;
+		for (S32 i = 0; i < NUM_VERTICES; ++i)
+		{
+			S32 joint = llfloor(mWeights[i]);
+			blend_mat.lerp(mJoints[joint], mJoints[joint + 1], mWeights[i] - joint);
+			LLVector3 vertex;
+			LLVector3 normal;
+			blend_mat.multiply(mCoords[i], vertex);
+			((LLV4Matrix3)blend_mat).multiply(mNormals[i], normal);
+
+			for (S32 c = 0; c < 3; ++c)
+			{
+				ensure_equals("vertex", vertices[i].mV[c], vertex.mV[c]);
+				ensure_equals("normal", normals[i].mV[c], normal.mV[c]);
+			}
+		}
+	}
+}